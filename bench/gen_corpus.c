@@ -0,0 +1,444 @@
+﻿/*
+ * ============================================================================
+ * 文件名: gen_corpus.c
+ * 描述  : 基准测试语料生成器
+ *
+ * 按给定行数与形状生成确定性的汇编源文件（相同参数与种子得到逐字节相同的输出），
+ * 供 make bench 测量各规模下的吞吐量与内存峰值。
+ *
+ * 每个文件都能被汇编：.COM 映像不超过 64KB，标签引用数低于 codegen 的重定位上限。
+ * 生成时按保守估计累计每个文件的代码字节数与标签引用数，预算用完后跳转改为
+ * 普通指令、代码行改为注释。--split 时按形状估算单个文件能容纳的行数，把语料
+ * 拆成多个这样的文件（各自为独立程序），并写出可供 subas --batch @FILE 使用的
+ * 文件列表；这样拆出的文件通常用不完预算，形状保持不变。
+ *
+ * 用法：
+ *   gen_corpus [选项] LINES
+ *     --shape NAME     预设形状：mixed（默认）、labels、forward、data、comments、jumpchain
+ *     --labels PCT     代码行中标签定义的比例
+ *     --forward PCT    跳转中前向引用（目标在后面定义）的比例
+ *     --data PCT       DB 数据行的比例
+ *     --comments PCT   注释行的比例
+ *     --chain PCT      跳转链行（标签后紧跟跳向下一标签的 JMP）的比例
+ *     --seed N         随机种子（默认 1）
+ *     -o FILE          输出文件（默认标准输出；超出单个文件预算的行退化为注释）
+ *     --split PREFIX   拆分为 PREFIX-0000.asm、PREFIX-0001.asm ...，
+ *                      文件列表写入 PREFIX.rsp（每行一个）
+ *
+ * 生成的源文件只保证能被汇编，不保证运行语义。
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FORWARD_WINDOW   8      /* 前向引用的目标最多在 8 个标签之后 */
+#define HEADER_LINES     6
+#define FOOTER_LINES     5
+
+/* 单个文件的预算（低于 codegen 的 1000 条重定位与 64KB 代码缓冲区） */
+#define FILE_REFERENCES  900    /* 标签引用数 */
+#define FILE_CODE_BYTES  0xF000 /* 代码字节数（按保守估计累计） */
+#define INSN_MAX_BYTES   6      /* 生成的单条指令（含跳转链行）字节数上限 */
+#define DATA_MAX_BYTES   16     /* 一行 DB 的字节数上限 */
+#define DATA_AVG_BYTES   10
+#define MAX_FILE_LINES   20000  /* --split 时单个文件的行数上限 */
+#define SPLIT_PATH_MAX   1024
+
+/* 语料形状（各项为百分比） */
+typedef struct {
+    const char* name;
+    unsigned labels;
+    unsigned forward;
+    unsigned data;
+    unsigned comments;
+    unsigned chain;
+} CorpusShape;
+
+static const CorpusShape g_shapes[] = {
+    /* name         labels forward data comments chain */
+    { "mixed",      10,    50,     5,   10,      0  },
+    { "labels",     40,    50,     0,   0,       0  },
+    { "forward",    10,    90,     0,   0,       0  },
+    { "data",       5,     50,     60,  5,       0  },
+    { "comments",   5,     50,     0,   60,      0  },
+    { "jumpchain",  0,     100,    0,   0,       80 }
+};
+
+#define SHAPE_COUNT (sizeof(g_shapes) / sizeof(g_shapes[0]))
+
+static const char* const g_regs[] = { "AX", "BX", "CX", "DX", "SI", "DI" };
+static const char* const g_alu[] = { "ADD", "SUB", "AND", "OR", "XOR", "CMP" };
+static const char* const g_jumps[] = { "JMP", "JZ", "JNZ", "JC", "JNC", "CALL" };
+
+static const char* const g_words[] = {
+    "load", "the", "next", "value", "into", "register", "and", "compare",
+    "against", "limit", "branch", "when", "carry", "is", "set", "loop"
+};
+
+/* 生成器状态 */
+typedef struct {
+    FILE* out;
+    unsigned long long rng;
+    unsigned next_label;        /* 下一个要定义的代码标签编号 */
+    unsigned max_referenced;    /* 被引用过的最大标签编号 + 1 */
+    unsigned data_count;
+    unsigned references;        /* 本文件已生成的标签引用数 */
+    unsigned long code_bytes;   /* 本文件代码字节数的保守估计 */
+} Generator;
+
+/* ========================================================================= */
+/* 内部辅助函数 */
+/* ========================================================================= */
+
+/*
+ * xorshift64：跨平台确定性的伪随机数
+ */
+static unsigned rand_next(Generator* gen) {
+    gen->rng ^= gen->rng << 13;
+    gen->rng ^= gen->rng >> 7;
+    gen->rng ^= gen->rng << 17;
+    return (unsigned)(gen->rng >> 32);
+}
+
+static unsigned rand_below(Generator* gen, unsigned bound) {
+    return rand_next(gen) % bound;
+}
+
+static int rand_percent(Generator* gen, unsigned pct) {
+    return rand_below(gen, 100) < pct;
+}
+
+#define PICK(gen, table) ((table)[rand_below((gen), sizeof(table) / sizeof((table)[0]))])
+
+static void emit_comment(Generator* gen) {
+    unsigned words = 3 + rand_below(gen, 8);
+
+    fputs("    ;", gen->out);
+    for (unsigned i = 0; i < words; i++) {
+        fprintf(gen->out, " %s", PICK(gen, g_words));
+    }
+    fputc('\n', gen->out);
+}
+
+/*
+ * 本文件是否还能再放一个引用 / 一行 size 字节的代码
+ */
+static int reference_fits(const Generator* gen) {
+    return gen->references < FILE_REFERENCES;
+}
+
+static int code_fits(const Generator* gen, unsigned size) {
+    return gen->code_bytes + size <= FILE_CODE_BYTES;
+}
+
+static void add_reference(Generator* gen, unsigned target) {
+    gen->references++;
+    if (target + 1 > gen->max_referenced) {
+        gen->max_referenced = target + 1;
+    }
+}
+
+static void emit_data(Generator* gen) {
+    unsigned count = 4 + rand_below(gen, 13);
+
+    gen->code_bytes += count;
+    fprintf(gen->out, "d%u DB ", gen->data_count++);
+    for (unsigned i = 0; i < count; i++) {
+        fprintf(gen->out, "%s0%02Xh", (i > 0) ? "," : "", rand_below(gen, 256));
+    }
+    fputc('\n', gen->out);
+}
+
+/*
+ * 生成跳转；remaining 为含本行在内的剩余正文行数。
+ * 前向目标之前的标签都要在剩余行中定义，放不下时改为后向引用。
+ */
+static void emit_jump(Generator* gen, const CorpusShape* shape, unsigned remaining) {
+    unsigned target;
+
+    if (gen->next_label > 0 && !rand_percent(gen, shape->forward)) {
+        target = rand_below(gen, gen->next_label);
+    } else {
+        target = gen->next_label + rand_below(gen, FORWARD_WINDOW);
+        unsigned end = (target + 1 > gen->max_referenced) ? target + 1 : gen->max_referenced;
+        if (end - gen->next_label > remaining - 1) {
+            if (gen->next_label == 0) {
+                fputs("    NOP\n", gen->out);
+                return;
+            }
+            target = rand_below(gen, gen->next_label);
+        }
+    }
+
+    add_reference(gen, target);
+    fprintf(gen->out, "    %s L%u\n", PICK(gen, g_jumps), target);
+}
+
+static void emit_instruction(Generator* gen, const CorpusShape* shape, unsigned remaining) {
+    /* 引用预算用完后只生成不引用标签的指令 */
+    unsigned kinds = reference_fits(gen) ? 8 : 6;
+
+    gen->code_bytes += INSN_MAX_BYTES;
+    switch (rand_below(gen, kinds)) {
+        case 0:
+        case 1:
+            fprintf(gen->out, "    MOV %s, %uh\n", PICK(gen, g_regs), rand_below(gen, 0x1000));
+            break;
+        case 2:
+        case 3:
+            fprintf(gen->out, "    %s %s, %s\n", PICK(gen, g_alu), PICK(gen, g_regs),
+                    PICK(gen, g_regs));
+            break;
+        case 4:
+            fprintf(gen->out, "    %s %s\n", rand_below(gen, 2) ? "PUSH" : "POP",
+                    PICK(gen, g_regs));
+            break;
+        case 5:
+            fprintf(gen->out, "    %s %s, %u\n", rand_below(gen, 2) ? "SHL" : "SHR",
+                    PICK(gen, g_regs), 1 + rand_below(gen, 3));
+            break;
+        default:
+            emit_jump(gen, shape, remaining);
+            break;
+    }
+}
+
+/*
+ * 生成一行正文（标签、跳转链、数据、注释或普通指令）
+ */
+static void emit_body_line(Generator* gen, const CorpusShape* shape, unsigned remaining) {
+    unsigned roll = rand_below(gen, 100);
+
+    /* 剩余行只够定义被引用过的标签时，依次补齐 */
+    if (gen->next_label < gen->max_referenced &&
+        remaining <= gen->max_referenced - gen->next_label) {
+        fprintf(gen->out, "L%u:\n", gen->next_label++);
+        return;
+    }
+
+    if (roll < shape->chain && remaining >= 2 && reference_fits(gen) &&
+        code_fits(gen, INSN_MAX_BYTES)) {
+        /* 跳转链：标签后接跳向下一个标签的 JMP（下一个标签至少还要一行） */
+        fprintf(gen->out, "L%u:", gen->next_label++);
+        add_reference(gen, gen->next_label);
+        gen->code_bytes += INSN_MAX_BYTES;
+        fprintf(gen->out, " JMP L%u\n", gen->next_label);
+    } else if (roll < shape->chain + shape->labels) {
+        fprintf(gen->out, "L%u:\n", gen->next_label++);
+    } else if (roll < shape->chain + shape->labels + shape->data &&
+               code_fits(gen, DATA_MAX_BYTES)) {
+        emit_data(gen);
+    } else if (roll < shape->chain + shape->labels + shape->data + shape->comments ||
+               !code_fits(gen, INSN_MAX_BYTES)) {
+        /* 代码预算用完后余下的行都是注释 */
+        emit_comment(gen);
+    } else {
+        emit_instruction(gen, shape, remaining);
+    }
+}
+
+/*
+ * 生成一个完整的程序（lines 行，其中正文 lines - HEADER_LINES - FOOTER_LINES 行）
+ */
+static void emit_program(Generator* gen, const CorpusShape* shape, unsigned long lines,
+                         unsigned long long seed) {
+    unsigned long body = lines - HEADER_LINES - FOOTER_LINES;
+
+    gen->next_label = 0;
+    gen->max_referenced = 0;
+    gen->data_count = 0;
+    gen->references = 0;
+    gen->code_bytes = INSN_MAX_BYTES * 2;       /* 结尾的 MOV 与 INT */
+
+    fprintf(gen->out, "; gen_corpus shape=%s lines=%lu seed=%llu\n", shape->name, lines, seed);
+    fputs("SEGMENT CODE\n", gen->out);
+    fputs("    ASSUME CS:CODE\n", gen->out);
+    fputs("    ORG 100h\n", gen->out);
+    fputs("main PROC\n", gen->out);
+    fputs("start:\n", gen->out);
+
+    for (unsigned long n = 0; n < body; n++) {
+        emit_body_line(gen, shape, (unsigned)(body - n));
+    }
+
+    fputs("    MOV AX, 4C00h\n", gen->out);
+    fputs("    INT 21h\n", gen->out);
+    fputs("main ENDP\n", gen->out);
+    fputs("SEGMENT ENDS\n", gen->out);
+    fputs("END main\n", gen->out);
+}
+
+/*
+ * 估算一个文件在预算内能容纳的行数（按各类行的比例取期望值，留 1/4 余量）
+ */
+static unsigned long file_lines(const CorpusShape* shape) {
+    unsigned instructions = 100 - shape->chain - shape->labels - shape->data - shape->comments;
+    unsigned long refs = shape->chain * 8 + instructions * 2;               /* 每 800 行 */
+    unsigned long bytes = (shape->chain + instructions) * INSN_MAX_BYTES +
+                          shape->data * DATA_AVG_BYTES;                      /* 每 100 行 */
+    unsigned long lines = MAX_FILE_LINES;
+
+    if (refs > 0 && FILE_REFERENCES * 800UL * 3 / 4 / refs < lines) {
+        lines = FILE_REFERENCES * 800UL * 3 / 4 / refs;
+    }
+    if (bytes > 0 && FILE_CODE_BYTES * 100UL * 3 / 4 / bytes < lines) {
+        lines = FILE_CODE_BYTES * 100UL * 3 / 4 / bytes;
+    }
+    return lines;
+}
+
+/*
+ * 把 lines 行语料拆成多个文件：PREFIX-NNNN.asm 与列表文件 PREFIX.rsp
+ */
+static int emit_split(Generator* gen, const CorpusShape* shape, unsigned long lines,
+                      unsigned long long seed, const char* prefix) {
+    char path[SPLIT_PATH_MAX];
+    unsigned long per_file = file_lines(shape);
+    unsigned long files = (lines + per_file - 1) / per_file;
+    FILE* list;
+
+    snprintf(path, sizeof(path), "%s.rsp", prefix);
+    list = fopen(path, "w");
+    if (list == NULL) {
+        fprintf(stderr, "Cannot create '%s'\n", path);
+        return 1;
+    }
+
+    /* 行数均分到各文件，总行数与请求一致 */
+    for (unsigned long i = 0; i < files; i++) {
+        unsigned long count = lines / files + (i < lines % files ? 1 : 0);
+
+        snprintf(path, sizeof(path), "%s-%04lu.asm", prefix, i);
+        gen->out = fopen(path, "w");
+        if (gen->out == NULL) {
+            fprintf(stderr, "Cannot create '%s'\n", path);
+            fclose(list);
+            return 1;
+        }
+        emit_program(gen, shape, count, seed);
+        if (fclose(gen->out) != 0) {
+            fprintf(stderr, "Write to '%s' failed\n", path);
+            fclose(list);
+            return 1;
+        }
+        fprintf(list, "%s\n", path);
+    }
+
+    if (fclose(list) != 0) {
+        fprintf(stderr, "Write to '%s.rsp' failed\n", prefix);
+        return 1;
+    }
+    return 0;
+}
+
+static void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [--shape NAME] [--labels PCT] [--forward PCT] [--data PCT]\n"
+                    "       [--comments PCT] [--chain PCT] [--seed N] [-o FILE | --split PREFIX] LINES\n",
+            program);
+    fprintf(stderr, "Shapes:");
+    for (unsigned i = 0; i < SHAPE_COUNT; i++) {
+        fprintf(stderr, " %s", g_shapes[i].name);
+    }
+    fputc('\n', stderr);
+}
+
+static const CorpusShape* find_shape(const char* name) {
+    for (unsigned i = 0; i < SHAPE_COUNT; i++) {
+        if (strcmp(g_shapes[i].name, name) == 0) {
+            return &g_shapes[i];
+        }
+    }
+    return NULL;
+}
+
+/* ========================================================================= */
+/* 主函数 */
+/* ========================================================================= */
+
+int main(int argc, char* argv[]) {
+    CorpusShape shape = g_shapes[0];
+    CorpusShape overrides = { NULL, 101, 101, 101, 101, 101 };   /* 101 = 未指定 */
+    unsigned long long seed = 1;
+    unsigned long lines = 0;
+    const char* output = NULL;
+    const char* prefix = NULL;
+    Generator gen;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (arg[0] != '-') {
+            lines = strtoul(arg, NULL, 10);
+            continue;
+        }
+        if (value == NULL) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        i++;
+        if (strcmp(arg, "--shape") == 0) {
+            const CorpusShape* found = find_shape(value);
+            if (found == NULL) {
+                fprintf(stderr, "Unknown shape '%s'\n", value);
+                print_usage(argv[0]);
+                return 1;
+            }
+            shape = *found;
+        } else if (strcmp(arg, "--labels") == 0) {
+            overrides.labels = (unsigned)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--forward") == 0) {
+            overrides.forward = (unsigned)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--data") == 0) {
+            overrides.data = (unsigned)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--comments") == 0) {
+            overrides.comments = (unsigned)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--chain") == 0) {
+            overrides.chain = (unsigned)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--seed") == 0) {
+            seed = strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "-o") == 0) {
+            output = value;
+        } else if (strcmp(arg, "--split") == 0) {
+            prefix = value;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    /* 显式比例覆盖预设 */
+    if (overrides.labels <= 100) shape.labels = overrides.labels;
+    if (overrides.forward <= 100) shape.forward = overrides.forward;
+    if (overrides.data <= 100) shape.data = overrides.data;
+    if (overrides.comments <= 100) shape.comments = overrides.comments;
+    if (overrides.chain <= 100) shape.chain = overrides.chain;
+
+    if (lines < HEADER_LINES + FOOTER_LINES + FORWARD_WINDOW ||
+        shape.labels + shape.data + shape.comments + shape.chain > 100 ||
+        (output != NULL && prefix != NULL)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    gen.rng = (seed == 0) ? 0x9E3779B97F4A7C15ULL : seed * 0x9E3779B97F4A7C15ULL;
+    if (prefix != NULL) {
+        return emit_split(&gen, &shape, lines, seed, prefix);
+    }
+
+    gen.out = (output != NULL) ? fopen(output, "w") : stdout;
+    if (gen.out == NULL) {
+        fprintf(stderr, "Cannot create '%s'\n", output);
+        return 1;
+    }
+    emit_program(&gen, &shape, lines, seed);
+
+    if (gen.out != stdout && fclose(gen.out) != 0) {
+        fprintf(stderr, "Write to '%s' failed\n", output);
+        return 1;
+    }
+    return 0;
+}
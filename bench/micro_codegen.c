@@ -0,0 +1,109 @@
+﻿/*
+ * ============================================================================
+ * 文件名: micro_codegen.c
+ * 描述  : 编码器微基准：对预先构建的 IR 反复调用 codegen_emit_instruction
+ *
+ * IR（PassOne）在计时前由词法分析与第一遍扫描生成一次；每轮把代码缓冲区与
+ * 重定位表清空后重新编码全部指令，另测一次重定位解决（codegen_resolve_reference）。
+ *
+ * ============================================================================
+ */
+
+#include "microbench.h"
+#include "../include/lexer.h"
+#include "../include/semantic.h"
+#include "../include/codegen.h"
+#include "../include/tables.h"
+#include "../include/error.h"
+
+#define CODEGEN_BLOCKS  200     /* 每块 4 个标签引用，保持在 CODEGEN_MAX_RELOCATIONS 以内 */
+
+static u32 bench_emit(void* arg) {
+    CodeGen* codegen = (CodeGen*)arg;
+    const PassOne* pass_one = codegen->pass_one;
+
+    codegen->code_size = 0;
+    codegen->relocation_count = 0;
+    for (u32 i = 0; i < pass_one->instruction_count; i++) {
+        g_micro_sink += (u64)codegen_emit_instruction(codegen, &pass_one->instructions[i]);
+    }
+    g_micro_sink += codegen->code_size;
+    return pass_one->instruction_count;
+}
+
+static u32 bench_resolve(void* arg) {
+    CodeGen* codegen = (CodeGen*)arg;
+
+    g_micro_sink += (u64)codegen_resolve_reference(codegen);
+    return codegen->relocation_count;
+}
+
+/*
+ * 词法分析 + 第一遍扫描，得到 IR
+ */
+static PassOne* build_ir(const char* source, u32 len, Token** out_tokens, u32* out_count) {
+    Lexer* lexer = lexer_create_from_buffer(source, len);
+    u32 capacity = 1024;
+    u32 count = 0;
+    Token* tokens = (Token*)util_malloc(sizeof(Token) * capacity);
+    Token tok;
+
+    if (lexer == NULL_PTR || tokens == NULL_PTR) {
+        lexer_destroy(lexer);
+        util_free(tokens);
+        return NULL_PTR;
+    }
+
+    do {
+        tok = lexer_next_token(lexer);
+        if (count == capacity) {
+            Token* grown = (Token*)util_malloc(sizeof(Token) * capacity * 2);
+            for (u32 i = 0; i < count; i++) {
+                grown[i] = tokens[i];
+            }
+            util_free(tokens);
+            tokens = grown;
+            capacity *= 2;
+        }
+        tokens[count++] = tok;
+    } while (tok.type != TOK_EOF);
+    lexer_destroy(lexer);
+
+    *out_tokens = tokens;
+    *out_count = count;
+    return semantic_pass_one(tokens, count);
+}
+
+int main(void) {
+    Token* tokens = NULL_PTR;
+    u32 token_count = 0;
+    u32 len;
+    char* source;
+    PassOne* pass_one;
+    CodeGen* codegen;
+
+    error_init();
+    tables_init();
+
+    source = micro_build_source(CODEGEN_BLOCKS, &len);
+    pass_one = (source != NULL_PTR) ? build_ir(source, len, &tokens, &token_count) : NULL_PTR;
+    codegen = (pass_one != NULL_PTR) ? codegen_create(pass_one) : NULL_PTR;
+    if (codegen == NULL_PTR || error_get_count() > 0) {
+        printf("Failed to build IR for the codegen benchmark\n");
+        return 1;
+    }
+
+    printf("Codegen microbenchmark: %u instructions\n", pass_one->instruction_count);
+    micro_header("codegen");
+    micro_run("emit_instruction", bench_emit, codegen);
+    micro_run("resolve_reference (per reloc)", bench_resolve, codegen);
+
+    codegen_destroy(codegen);
+    semantic_pass_one_destroy(pass_one);
+    for (u32 i = 0; i < token_count; i++) {
+        token_dispose(&tokens[i]);
+    }
+    util_free(tokens);
+    util_free(source);
+    return (error_get_count() == 0) ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+﻿/*
+ * ============================================================================
+ * 文件名: micro_hash.c
+ * 描述  : 哈希表微基准：不同元素个数下的 util_ht_insert / util_ht_lookup
+ *
+ * 桶数固定为符号表默认值（256），元素增多时链长随之增长，
+ * 可以直接看到装载因子对插入与查找成本的影响。
+ *
+ * ============================================================================
+ */
+
+#include "microbench.h"
+
+#define HASH_BUCKETS        256     /* 与 symtab_create 的默认容量一致 */
+#define HASH_MIN_INSERTS    50000   /* 插入基准每轮至少插入的键数 */
+#define HASH_LOOKUPS        20000   /* 查找基准每轮的查找次数 */
+
+typedef struct {
+    char** keys;
+    char** missing;
+    u32 size;
+    UtilHashTable* table;
+} HashBench;
+
+static u32 bench_insert(void* arg) {
+    HashBench* bench = (HashBench*)arg;
+    u32 ops = 0;
+
+    /* 每次建一张新表插入 size 个键，直到操作数足够 */
+    while (ops < HASH_MIN_INSERTS) {
+        UtilHashTable* table = util_ht_create(HASH_BUCKETS);
+        for (u32 i = 0; i < bench->size; i++) {
+            util_ht_insert(table, bench->keys[i], bench->keys[i]);
+        }
+        g_micro_sink += table->element_count;
+        util_ht_destroy(table);
+        ops += bench->size;
+    }
+    return ops;
+}
+
+static u32 bench_lookup_hit(void* arg) {
+    HashBench* bench = (HashBench*)arg;
+
+    for (u32 i = 0; i < HASH_LOOKUPS; i++) {
+        g_micro_sink += (util_ht_lookup(bench->table, bench->keys[i % bench->size]) != NULL_PTR);
+    }
+    return HASH_LOOKUPS;
+}
+
+static u32 bench_lookup_miss(void* arg) {
+    HashBench* bench = (HashBench*)arg;
+
+    for (u32 i = 0; i < HASH_LOOKUPS; i++) {
+        g_micro_sink += (util_ht_lookup(bench->table, bench->missing[i % bench->size]) == NULL_PTR);
+    }
+    return HASH_LOOKUPS;
+}
+
+static char** make_keys(const char* prefix, u32 count) {
+    char** keys = (char**)util_malloc(sizeof(char*) * count);
+    char name[32];
+
+    for (u32 i = 0; i < count; i++) {
+        snprintf(name, sizeof(name), "%s%u", prefix, i);
+        keys[i] = util_strdup(name);
+    }
+    return keys;
+}
+
+static void free_keys(char** keys, u32 count) {
+    for (u32 i = 0; i < count; i++) {
+        util_free(keys[i]);
+    }
+    util_free(keys);
+}
+
+int main(void) {
+    static const u32 sizes[] = { 16, 256, 4096, 16384 };
+    const u32 max_size = sizes[sizeof(sizes) / sizeof(sizes[0]) - 1];
+    HashBench bench;
+    char label[64];
+
+    bench.keys = make_keys("label_", max_size);
+    bench.missing = make_keys("undefined_", max_size);
+
+    printf("Hash table microbenchmark: %u buckets\n", HASH_BUCKETS);
+    micro_header("util_ht_insert / util_ht_lookup");
+    for (u32 s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        bench.size = sizes[s];
+        bench.table = util_ht_create(HASH_BUCKETS);
+        for (u32 i = 0; i < bench.size; i++) {
+            util_ht_insert(bench.table, bench.keys[i], bench.keys[i]);
+        }
+
+        snprintf(label, sizeof(label), "insert n=%u", bench.size);
+        micro_run(label, bench_insert, &bench);
+        snprintf(label, sizeof(label), "lookup hit n=%u", bench.size);
+        micro_run(label, bench_lookup_hit, &bench);
+        snprintf(label, sizeof(label), "lookup miss n=%u", bench.size);
+        micro_run(label, bench_lookup_miss, &bench);
+
+        util_ht_destroy(bench.table);
+    }
+
+    free_keys(bench.keys, max_size);
+    free_keys(bench.missing, max_size);
+    return 0;
+}
@@ -0,0 +1,58 @@
+﻿/*
+ * ============================================================================
+ * 文件名: micro_lexer.c
+ * 描述  : 词法分析微基准：对固定缓冲区反复调用 lexer_next_token
+ *
+ * 词法器在计时前创建一次，每轮只把读取位置重置到开头，
+ * 因此结果不含源文本复制；Token 的词素释放计入每次操作。
+ *
+ * ============================================================================
+ */
+
+#include "microbench.h"
+#include "../include/lexer.h"
+#include "../include/error.h"
+
+#define LEXER_BLOCKS  500
+
+static u32 bench_next_token(void* arg) {
+    Lexer* lexer = (Lexer*)arg;
+    u32 count = 0;
+    Token tok;
+
+    lexer->pos = 0;
+    lexer->line = 1;
+    do {
+        tok = lexer_next_token(lexer);
+        g_micro_sink += (u64)tok.type;
+        token_dispose(&tok);
+        count++;
+    } while (tok.type != TOK_EOF);
+
+    return count;
+}
+
+int main(void) {
+    Lexer* lexer;
+    u32 len;
+    char* source;
+
+    error_init();
+    source = micro_build_source(LEXER_BLOCKS, &len);
+    if (source == NULL_PTR) {
+        return 1;
+    }
+    lexer = lexer_create_from_buffer(source, len);
+    if (lexer == NULL_PTR) {
+        util_free(source);
+        return 1;
+    }
+
+    printf("Lexer microbenchmark: %u bytes of source\n", len);
+    micro_header("lexer_next_token");
+    micro_run("next_token + token_dispose", bench_next_token, lexer);
+
+    lexer_destroy(lexer);
+    util_free(source);
+    return (error_get_count() == 0) ? 0 : 1;
+}
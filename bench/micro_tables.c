@@ -0,0 +1,98 @@
+﻿/*
+ * ============================================================================
+ * 文件名: micro_tables.c
+ * 描述  : 指令表微基准：按典型助记符分布调用 tables_lookup_instruction
+ *
+ * 助记符序列模拟 Pass 1 的实际调用：常用指令居多，另含伪指令、
+ * 小写写法以及标签名（语义分析会用它们查表并得到未命中）。
+ *
+ * ============================================================================
+ */
+
+#include "microbench.h"
+#include "../include/tables.h"
+
+#define TABLES_LOOKUPS_PER_ROUND  200000
+
+/* 单个查找键与该键在序列中出现的次数 */
+typedef struct {
+    const char* mnemonic;
+    u32 weight;
+} MnemonicWeight;
+
+static const MnemonicWeight g_mix[] = {
+    { "MOV", 30 }, { "ADD", 8 }, { "SUB", 5 }, { "CMP", 8 }, { "JMP", 6 },
+    { "JZ", 5 }, { "JNZ", 5 }, { "PUSH", 5 }, { "POP", 5 }, { "CALL", 4 },
+    { "RET", 3 }, { "INT", 2 }, { "DB", 4 }, { "PROC", 1 }, { "ENDP", 1 },
+    { "mov", 2 }, { "loop_start", 3 }, { "data_area", 3 }
+};
+
+typedef struct {
+    const char* keys[128];
+    u32 key_count;
+} TablesBench;
+
+static u32 bench_lookup(void* arg) {
+    TablesBench* bench = (TablesBench*)arg;
+
+    for (u32 i = 0; i < TABLES_LOOKUPS_PER_ROUND; i++) {
+        const InstructionInfo* info = tables_lookup_instruction(bench->keys[i % bench->key_count]);
+        g_micro_sink += (info != NULL_PTR) ? info->opcode : 0;
+    }
+    return TABLES_LOOKUPS_PER_ROUND;
+}
+
+/* 只查找表中第一条与最后一条指令，显示线性查找的最好与最坏情况 */
+static u32 bench_lookup_first(void* arg) {
+    const char* key = tables_get_instruction_by_index(0)->mnemonic;
+    (void)arg;
+    for (u32 i = 0; i < TABLES_LOOKUPS_PER_ROUND; i++) {
+        g_micro_sink += tables_lookup_instruction(key)->opcode;
+    }
+    return TABLES_LOOKUPS_PER_ROUND;
+}
+
+static u32 bench_lookup_last(void* arg) {
+    const char* key = tables_get_instruction_by_index(tables_get_instruction_count() - 1)->mnemonic;
+    (void)arg;
+    for (u32 i = 0; i < TABLES_LOOKUPS_PER_ROUND; i++) {
+        g_micro_sink += tables_lookup_instruction(key)->opcode;
+    }
+    return TABLES_LOOKUPS_PER_ROUND;
+}
+
+static u32 bench_lookup_miss(void* arg) {
+    (void)arg;
+    for (u32 i = 0; i < TABLES_LOOKUPS_PER_ROUND; i++) {
+        g_micro_sink += (tables_lookup_instruction("no_such_label") == NULL_PTR);
+    }
+    return TABLES_LOOKUPS_PER_ROUND;
+}
+
+int main(void) {
+    TablesBench bench;
+
+    tables_init();
+
+    /* 按权重展开为查找序列，再以步长 37 打乱（总权重 100 与 37 互素，仍是一个排列） */
+    const char* ordered[128];
+    u32 count = 0;
+    for (u32 i = 0; i < sizeof(g_mix) / sizeof(g_mix[0]); i++) {
+        for (u32 w = 0; w < g_mix[i].weight && count < 128; w++) {
+            ordered[count++] = g_mix[i].mnemonic;
+        }
+    }
+    for (u32 i = 0; i < count; i++) {
+        bench.keys[i] = ordered[(i * 37) % count];
+    }
+    bench.key_count = count;
+
+    printf("Tables microbenchmark: %u instructions in table, %u-key mix\n",
+           tables_get_instruction_count(), count);
+    micro_header("tables_lookup_instruction");
+    micro_run("mnemonic mix", bench_lookup, &bench);
+    micro_run("first entry", bench_lookup_first, NULL_PTR);
+    micro_run("last entry", bench_lookup_last, NULL_PTR);
+    micro_run("miss (label name)", bench_lookup_miss, NULL_PTR);
+    return 0;
+}
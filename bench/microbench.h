@@ -0,0 +1,110 @@
+﻿/*
+ * ============================================================================
+ * 文件名: microbench.h
+ * 描述  : 组件微基准测试公共框架（仅供 bench/micro_*.c 包含）
+ *
+ * 每个基准先预热 MICRO_WARMUP_ROUNDS 轮，再计时 MICRO_ROUNDS 轮；
+ * 每轮由基准函数执行一批操作并返回操作数，按轮计算 ns/op，
+ * 输出最小值、中位数与最大值（比较优化效果时以中位数为准）。
+ *
+ * ============================================================================
+ */
+
+#ifndef __MICROBENCH_H__
+#define __MICROBENCH_H__
+
+#include <stdio.h>
+#include "../include/utils.h"
+
+#define MICRO_WARMUP_ROUNDS  3
+#define MICRO_ROUNDS         15
+
+/* 执行一轮基准，返回本轮完成的操作数 */
+typedef u32 (*MicroFunc)(void* arg);
+
+/* 结果汇聚点：防止编译器把被测调用当作无用代码删除 */
+static volatile u64 g_micro_sink;
+
+static void micro_header(const char* title) {
+    printf("\n=== %s ===\n", title);
+    printf("  %-32s %10s %10s %10s %10s\n", "benchmark", "ops/round", "min ns/op",
+           "median", "max");
+}
+
+static void micro_run(const char* name, MicroFunc fn, void* arg) {
+    u64 samples[MICRO_ROUNDS];
+    u32 ops = 0;
+
+    for (u32 r = 0; r < MICRO_WARMUP_ROUNDS; r++) {
+        (void)fn(arg);
+    }
+
+    for (u32 r = 0; r < MICRO_ROUNDS; r++) {
+        u64 start = util_time_ns();
+        ops = fn(arg);
+        samples[r] = util_time_ns() - start;
+    }
+
+    /* 插入排序取中位数 */
+    for (u32 i = 1; i < MICRO_ROUNDS; i++) {
+        u64 value = samples[i];
+        u32 j = i;
+        while (j > 0 && samples[j - 1] > value) {
+            samples[j] = samples[j - 1];
+            j--;
+        }
+        samples[j] = value;
+    }
+
+    if (ops == 0) {
+        ops = 1;
+    }
+    printf("  %-32s %10u %10.2f %10.2f %10.2f\n", name, ops,
+           (double)samples[0] / ops, (double)samples[MICRO_ROUNDS / 2] / ops,
+           (double)samples[MICRO_ROUNDS - 1] / ops);
+}
+
+/*
+ * 生成由 blocks 个代码块组成的源文本（标签按块编号，互不重复）；
+ * 调用者以 util_free 释放
+ */
+static inline char* micro_build_source(u32 blocks, u32* out_len) {
+    static const char* const header = "SEGMENT CODE\n    ORG 100h\nmain PROC\n";
+    static const char* const footer = "    INT 21h\nmain ENDP\nSEGMENT ENDS\nEND main\n";
+    const u32 block_max = 320;
+    u32 capacity = (u32)util_strlen(header) + (u32)util_strlen(footer) + blocks * block_max + 1;
+    char* text = (char*)util_malloc(capacity);
+    u32 len;
+
+    if (text == NULL_PTR) {
+        return NULL_PTR;
+    }
+
+    len = (u32)snprintf(text, capacity, "%s", header);
+    for (u32 b = 0; b < blocks; b++) {
+        len += (u32)snprintf(text + len, capacity - len,
+            "blk%u:\n"
+            "    MOV AX, 1234h\n"
+            "    ADD AX, BX\n"
+            "    CMP AX, 200h\n"
+            "    JZ done%u\n"
+            "    MOV CX, 10\n"
+            "loop%u:\n"
+            "    PUSH CX\n"
+            "    SHL AX, 1\n"
+            "    POP CX\n"
+            "    LOOP loop%u\n"
+            "    ; advance to the next block\n"
+            "    XOR DX, DX\n"
+            "    CALL blk%u\n"
+            "done%u:\n"
+            "    SUB AX, 0FFh\n",
+            b, b, b, b, b, b);
+    }
+    len += (u32)snprintf(text + len, capacity - len, "%s", footer);
+
+    *out_len = len;
+    return text;
+}
+
+#endif /* __MICROBENCH_H__ */
@@ -0,0 +1,135 @@
+#!/bin/sh
+# ============================================================================
+# 文件名: run_bench.sh
+# 描述  : 合成语料基准测试（由 make bench / make bench-baseline 调用）
+#
+# 对每种语料形状与规模：生成语料，用 --batch --stats=json 汇编 BENCH_REPEAT 次取最快一次，
+# 记录行/秒、字节/秒、堆峰值以及各阶段对峰值的贡献，并与基线比较。
+# 生成器按 .COM 的 64KB 映像与重定位上限把语料拆成多个文件（列表为 <形状>-<行数>.rsp），
+# 因此每种规模都能汇编；行数与字节数为全部文件之和。
+# 吞吐量按汇编阶段的耗时计算（总耗时减去读文件与写文件），文件系统抖动不计入。
+#
+# 环境变量：
+#   SUBAS            汇编器路径（默认 ./subas）
+#   GEN              语料生成器路径（默认 build/bench/gen_corpus）
+#   BENCH_DIR        语料与结果目录（默认 build/bench）
+#   BENCH_SIZES      行数列表（默认 "1000 10000 100000 1000000 10000000"）
+#   BENCH_SHAPES     形状列表（默认全部）
+#   BENCH_REPEAT     每项重复次数（默认 5）
+#   BENCH_BASELINE   基线文件（默认 bench/baseline.tsv）
+#   BENCH_TOLERANCE  允许的吞吐量下降百分比（默认 15）
+#   BENCH_UPDATE     为 1 时把本次结果写为新基线
+#
+# 结果文件每行：shape lines bytes status asm_ns lines_per_sec bytes_per_sec
+#               peak_bytes peak_phase phase_peaks
+# status 为 ok 或 fail:<错误码>（生成的语料都应能汇编，失败说明汇编器出错）。
+# ============================================================================
+
+SUBAS=${SUBAS:-./subas}
+GEN=${GEN:-build/bench/gen_corpus}
+BENCH_DIR=${BENCH_DIR:-build/bench}
+BENCH_SIZES=${BENCH_SIZES:-"1000 10000 100000 1000000 10000000"}
+BENCH_SHAPES=${BENCH_SHAPES:-"mixed labels forward data comments jumpchain"}
+BENCH_REPEAT=${BENCH_REPEAT:-5}
+BENCH_BASELINE=${BENCH_BASELINE:-bench/baseline.tsv}
+BENCH_TOLERANCE=${BENCH_TOLERANCE:-15}
+
+RESULTS="$BENCH_DIR/results.tsv"
+mkdir -p "$BENCH_DIR" || exit 1
+printf '# shape\tlines\tbytes\tstatus\tasm_ns\tlines_per_sec\tbytes_per_sec\tpeak_bytes\tpeak_phase\tphase_peaks\n' > "$RESULTS"
+
+# 从单行 JSON 中取数值字段
+json_num() {
+    printf '%s\n' "$2" | sed -n "s/.*\"$1\":\([0-9][0-9]*\).*/\1/p"
+}
+
+# 汇编阶段耗时：total_ns 减去 read / write 阶段
+asm_ns() {
+    total=$(json_num total_ns "$1")
+    read_ns=$(printf '%s\n' "$1" | sed -n 's/.*"read":{"ns":\([0-9]*\).*/\1/p')
+    write_ns=$(printf '%s\n' "$1" | sed -n 's/.*"write":{"ns":\([0-9]*\).*/\1/p')
+    echo $((total - ${read_ns:-0} - ${write_ns:-0}))
+}
+
+for shape in $BENCH_SHAPES; do
+    for lines in $BENCH_SIZES; do
+        list="$BENCH_DIR/$shape-$lines.rsp"
+        if [ ! -f "$list" ]; then
+            "$GEN" --shape "$shape" --split "$BENCH_DIR/$shape-$lines" "$lines" || exit 1
+        fi
+        bytes=$(xargs cat < "$list" | wc -c | tr -d ' ')
+
+        best_ns=
+        best_json=
+        status=ok
+        run=0
+        while [ $run -lt "$BENCH_REPEAT" ]; do
+            out=$("$SUBAS" --batch --stats=json @"$list" 2>&1)
+            if [ $? -ne 0 ]; then
+                code=$(printf '%s\n' "$out" | sed -n 's/.*Error \(E[0-9]*\).*/\1/p' | head -n 1)
+                status="fail:${code:-unknown}"
+                break
+            fi
+            json=$(printf '%s\n' "$out" | grep '^{"files"')
+            ns=$(asm_ns "$json")
+            if [ -z "$best_ns" ] || [ "$ns" -lt "$best_ns" ]; then
+                best_ns=$ns
+                best_json=$json
+            fi
+            run=$((run + 1))
+        done
+
+        if [ "$status" != ok ]; then
+            printf '%s\t%s\t%s\t%s\t-\t-\t-\t-\t-\t-\n' "$shape" "$lines" "$bytes" "$status" >> "$RESULTS"
+            continue
+        fi
+
+        [ "$best_ns" -gt 0 ] || best_ns=1
+        lps=$(awk -v n="$lines" -v t="$best_ns" 'BEGIN { printf "%.0f", n * 1e9 / t }')
+        bps=$(awk -v n="$bytes" -v t="$best_ns" 'BEGIN { printf "%.0f", n * 1e9 / t }')
+        peak=$(json_num peak_bytes "$best_json")
+        phases=$(printf '%s\n' "$best_json" | grep -o '"[a-z_]*":{"ns":[^}]*}' |
+                 sed -n 's/^"\([a-z_]*\)":.*"peak_growth":\([0-9]*\).*/\1:\2/p')
+        peak_phase=$(printf '%s\n' "$phases" | sort -t: -k2 -n -r | head -n 1 | cut -d: -f1)
+        phase_peaks=$(printf '%s\n' "$phases" | paste -s -d, -)
+        printf '%s\t%s\t%s\tok\t%s\t%s\t%s\t%s\t%s\t%s\n' "$shape" "$lines" "$bytes" \
+            "$best_ns" "$lps" "$bps" "${peak:-0}" "${peak_phase:--}" "${phase_peaks:--}" >> "$RESULTS"
+    done
+done
+
+if [ "${BENCH_UPDATE:-0}" = 1 ]; then
+    cp "$RESULTS" "$BENCH_BASELINE" || exit 1
+    echo "Baseline written to $BENCH_BASELINE"
+fi
+
+# 输出结果并与基线比较：吞吐量下降超过容差、或基线可汇编而本次失败，均视为回退
+awk -F '\t' -v tol="$BENCH_TOLERANCE" '
+    FNR == 1 && /^#/ { next }
+    FILENAME == base { base_status[$1 "/" $2] = $4; base_lps[$1 "/" $2] = $6; next }
+    {
+        key = $1 "/" $2
+        delta = "-"
+        flag = ""
+        if (key in base_status && base_status[key] == "ok") {
+            if ($4 != "ok") {
+                flag = "REGRESSION"
+            } else {
+                delta = sprintf("%+.1f%%", ($6 - base_lps[key]) * 100 / base_lps[key])
+                if ($6 < base_lps[key] * (100 - tol) / 100) flag = "REGRESSION"
+            }
+        }
+        if (flag != "") regressions++
+        if ($4 == "ok") {
+            printf "%-10s %9s %8.2f ms %12s lines/s %7.2f MB/s  peak %10s B (%s)  %8s %s\n",
+                   $1, $2, $5 / 1e6, $6, $7 / 1e6, $8, $9, delta, flag
+        } else {
+            printf "%-10s %9s  %s  %s\n", $1, $2, $4, flag
+        }
+    }
+    END {
+        if (regressions > 0) {
+            printf "%d throughput regression(s) against baseline (tolerance %d%%)\n", regressions, tol
+            exit 1
+        }
+    }
+' base="$BENCH_BASELINE" "$([ -f "$BENCH_BASELINE" ] && echo "$BENCH_BASELINE" || echo /dev/null)" "$RESULTS"
@@ -0,0 +1,132 @@
+﻿/*
+ * ============================================================================
+ * 文件名: cache.h
+ * 描述  : 构建缓存模块 - 按内容哈希缓存汇编产物
+ *
+ * 功能：
+ *  - 以源文本、汇编器版本与影响输出的选项计算 SHA-256 内容键
+ *  - 命中时把缓存中的产物复制（或 reflink）到输出路径，跳过词法与两遍扫描
+ *  - 未命中时由调用者汇编，再把产物存入缓存
+ *  - 统计命中 / 未命中次数（批量模式下多个工作线程共享同一缓存）
+ *
+ * 设计：
+ *  - 缓存目录中每个条目为一个文件：<64 位十六进制摘要>.<扩展名>
+ *  - 条目文件头记录源文本长度与完整摘要，读取时逐项核对，不符按未命中处理
+ *  - 条目与命中产物都先写临时文件再 rename：并发写入不会读到半个条目，
+ *    复制失败也不会留下被截断的输出文件
+ *  - 目前没有 INCLUDE 指令，源文本即全部输入；支持包含文件后需把其内容并入键
+ *
+ * ============================================================================
+ */
+
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include "utils.h"
+
+#define CACHE_PATH_MAX      1024        /* 条目路径的最大长度 */
+#define CACHE_KEY_TEXT      (UTIL_SHA256_SIZE * 2 + 1)  /* 键的十六进制文本长度（含结尾 0） */
+
+/* ========================================================================= */
+/* 数据结构定义 */
+/* ========================================================================= */
+
+/* 构建缓存句柄（不透明类型） */
+typedef struct BuildCache BuildCache;
+
+/* 缓存键 */
+typedef struct {
+    u32 source_size;                    /* 源文本字节数 */
+    u8 digest[UTIL_SHA256_SIZE];        /* SHA-256(签名、源文本长度、源文本) */
+} CacheKey;
+
+/* ========================================================================= */
+/* API 函数声明 */
+/* ========================================================================= */
+
+/*
+ * cache_open
+ *
+ * 功能：打开缓存目录（不存在时创建）
+ *
+ * 返回值：
+ *   - BuildCache* : 缓存句柄
+ *   - NULL: 目录无法创建或访问
+ */
+BuildCache* cache_open(const char* dir);
+
+/*
+ * cache_key
+ *
+ * 功能：计算一次汇编的缓存键
+ *
+ * 参数：
+ *   - source: 源文本
+ *   - size: 源文本字节数
+ *   - signature: 汇编器版本与影响输出的选项组成的字符串
+ *   - out: 输出参数，返回缓存键
+ */
+void cache_key(const char* source, u32 size, const char* signature, CacheKey* out);
+
+/*
+ * cache_key_text
+ *
+ * 功能：把缓存键格式化为十六进制摘要文本（与条目文件名一致）
+ *
+ * 参数：
+ *   - text: 输出缓冲区，至少 CACHE_KEY_TEXT 字节
+ */
+void cache_key_text(const CacheKey* key, char* text);
+
+/*
+ * cache_fetch
+ *
+ * 功能：查找缓存条目，命中时把产物写到 output_path
+ *
+ * 参数：
+ *   - cache: 缓存句柄
+ *   - key: 缓存键（条目记录的源文本长度与摘要须与之一致）
+ *   - ext: 产物扩展名（如 "com"）
+ *   - output_path: 输出路径
+ *   - out_size: 输出参数，命中时返回产物字节数
+ *
+ * 返回值：
+ *   - 0: 命中，output_path 已整体替换为产物
+ *   - -1: 未命中（条目不符或复制失败也按未命中处理，output_path 保持原样）
+ */
+int cache_fetch(BuildCache* cache, const CacheKey* key, const char* ext,
+                const char* output_path, u32* out_size);
+
+/*
+ * cache_load
+ *
+ * 功能：把条目内容读入内存（核对同 cache_fetch；不计入命中统计）
+ *
+ * 返回值：
+ *   - u8* : 条目内容（调用者以 util_free 释放），*out_size 为字节数
+ *   - NULL: 条目不存在、不符或内存不足
+ */
+u8* cache_load(BuildCache* cache, const CacheKey* key, const char* ext, u32* out_size);
+
+/*
+ * cache_store
+ *
+ * 功能：把产物存入缓存（失败时静默放弃，不影响汇编结果）
+ */
+void cache_store(BuildCache* cache, const CacheKey* key, const char* ext, const u8* data, u32 size);
+
+/*
+ * cache_get_stats
+ *
+ * 功能：获取命中与未命中次数
+ */
+void cache_get_stats(const BuildCache* cache, u32* out_hits, u32* out_misses);
+
+/*
+ * cache_close
+ *
+ * 功能：关闭缓存句柄
+ */
+void cache_close(BuildCache* cache);
+
+#endif /* __CACHE_H__ */
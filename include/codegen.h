@@ -38,12 +38,25 @@
 /* 数据结构定义 */
 /* ========================================================================= */
 
+/*
+ * 重定位种类（由 codegen_resolve_reference 确定）
+ */
+typedef enum {
+    RELOC_OFFSET = 0,           /* 标签引用：填入符号地址 */
+    RELOC_SEGMENT = 1,          /* 段名引用：填入段基址，由 MZ 装载器按装载段修正 */
+    RELOC_EXTERNAL = 2          /* EXTRN 符号引用：填入 0，由链接器按目标模块中的定义修正 */
+} RelocationKind;
+
+/* codegen_check_relocations 的允许集合：每种重定位占一位 */
+#define CODEGEN_RELOC_MASK(kind)    (1u << (u32)(kind))
+
 /*
  * 重定位记录（处理前向和向后标签引用）
  * 用于在生成代码时记录需要后续修复的引用
  */
 typedef struct {
     u32 offset;                 /* 代码中需要修复的位置偏移 */
+    RelocationKind kind;        /* 重定位种类 */
     u32 instruction_index;      /* 对应的指令索引 */
     u32 operand_index;          /* 对应的操作数索引 */
     s8 symbol_name[128];        /* 符号名 */
@@ -58,13 +71,43 @@ typedef struct {
     u32 code_size;              /* 当前代码大小（字节） */
     Relocation* relocations;    /* 重定位记录数组 */
     u32 relocation_count;       /* 重定位记录数 */
+    u32* segment_fixups;        /* 段基址字在 code_buffer 中的偏移（按代码顺序） */
+    u32 segment_fixup_count;    /* 段基址修正数 */
+    u32* instruction_offsets;   /* 按指令索引记录的机器码实际起始偏移，第 i 条占
+                                 * [offsets[i], offsets[i + 1])；第一遍的 address 只是估计 */
+    u32 instruction_offset_capacity;    /* instruction_offsets 容量 */
     u32 has_errors;             /* 是否发生错误 */
 } CodeGen;
 
+/*
+ * 第二遍扫描的逐条指令回调（如生成列表文件），在标签引用解决之后调用：
+ *   index            - 指令在第一遍指令列表中的索引
+ *   code_start       - 该指令机器码在 code_buffer 中的起始偏移
+ *                      （即 instruction_offsets[index]，长度为 instruction_offsets[index + 1] - code_start）
+ *   first_relocation - 该指令记录的第一条重定位；同一指令的重定位连续排列，
+ *                      instruction_index 均为 index
+ */
+typedef void (*CodeGenListener)(void* user, const CodeGen* codegen, u32 index,
+                                u32 code_start, u32 first_relocation);
+
 /* ========================================================================= */
 /* API 函数声明 */
 /* ========================================================================= */
 
+/*
+ * codegen_create
+ *
+ * 功能：创建空的代码生成上下文（供逐条或分批生成使用）
+ *
+ * 参数：
+ *   - pass_one: 第一遍扫描结果（codegen_resolve_reference 时须已完整）
+ *
+ * 返回值：
+ *   - CodeGen* : 上下文
+ *   - NULL: 内存不足
+ */
+CodeGen* codegen_create(const PassOne* pass_one);
+
 /*
  * codegen_pass_two
  *
@@ -75,15 +118,35 @@ typedef struct {
  *
  * 返回值：
  *   - CodeGen* : 第二遍扫描上下文，包含生成的代码
- *   - NULL: 发生错误
+ *   - NULL: 发生错误（本遍或第一遍）
  *
  * 描述：
  *   遍历第一遍扫描收集的指令列表，依次生成机器码。
  *   如遇到标签引用，先记录重定位信息；当遍历完后，
  *   利用完整的符号表填充所有标签引用。
+ *   出错的指令不会中断扫描，错误占位条目被跳过，因此即使第一遍
+ *   已有错误，本遍仍报告其余各行的独立错误。
  */
 CodeGen* codegen_pass_two(const PassOne* pass_one);
 
+/*
+ * codegen_pass_two_listed
+ *
+ * 功能：执行第二遍扫描，并在引用解决后对每条指令调用 listener
+ *
+ * 参数：
+ *   - pass_one: 第一遍扫描结果
+ *   - listener: 逐条指令回调（NULL 时等同于 codegen_pass_two）
+ *   - user: 传给回调的用户数据
+ *
+ * 返回值：同 codegen_pass_two
+ *
+ * 描述：
+ *   回调在全部指令生成、标签引用解决之后按指令顺序调用，此时机器码中的
+ *   标签地址已是实际偏移；错误占位条目也会回调（机器码长度为 0）。
+ */
+CodeGen* codegen_pass_two_listed(const PassOne* pass_one, CodeGenListener listener, void* user);
+
 /*
  * codegen_emit_instruction
  *
@@ -100,9 +163,30 @@ CodeGen* codegen_pass_two(const PassOne* pass_one);
  * 描述：
  *   根据指令类型和操作数，将指令编码为机器码。
  *   如果操作数为标签引用，记录重定位信息。
+ *   失败原因已通过 error_report 报告；错误占位条目不生成代码。
  */
 int codegen_emit_instruction(CodeGen* codegen, const InstructionEntry* entry);
 
+/*
+ * codegen_emit_instruction_at
+ *
+ * 功能：生成单条指令的机器码，指令索引由调用者给出
+ *
+ * 参数：
+ *   - codegen: 代码生成上下文
+ *   - entry: 指令信息（不要求位于 pass_one->instructions 中）
+ *   - index: 指令在第一遍扫描中的索引（写入重定位记录）
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: 失败
+ *
+ * 描述：
+ *   与 codegen_emit_instruction 相同，但不访问 pass_one，
+ *   因此可以在第一遍扫描仍在进行时由流水线编码线程调用。
+ */
+int codegen_emit_instruction_at(CodeGen* codegen, const InstructionEntry* entry, u32 index);
+
 /*
  * codegen_resolve_reference
  *
@@ -116,11 +200,36 @@ int codegen_emit_instruction(CodeGen* codegen, const InstructionEntry* entry);
  *   - -1: 存在未定义符号或其他错误
  *
  * 描述：
- *   遍历重定位记录表，对每条记录查找符号表中的地址，
- *   填充到代码缓冲区相应位置，完成标签引用解决。
+  *   先把各标签的符号地址改为其所在指令的实际起始偏移（instruction_offsets；
+ *   第一遍的地址只是估计），再遍历重定位记录表，对每条记录查找符号表中的地址，
+ *   填充到代码缓冲区相应位置，完成标签引用解决。此后符号地址即为映像中的偏移。
+ *   EXTRN 声明的外部符号写为 0，种类记为 RELOC_EXTERNAL，由链接器修正。
+ *   不在符号表中、但由 SEGMENT 声明的名字是段名引用：所有段在映像中
+ *   连续排列、组成同一个组，标签地址均相对映像开头，因此段基址写为 0，
+ *   其偏移记入 segment_fixups，由 MZ 装载器加上装载段。
+ *   未定义符号在首次引用所在行报告一次，同名的后续引用不再重复报告。
  */
 int codegen_resolve_reference(CodeGen* codegen);
 
+/*
+ * codegen_check_relocations
+ *
+ * 功能：检查已解决的重定位能否由目标格式表示
+ *
+ * 参数：
+ *   - codegen: 已完成 codegen_resolve_reference 的上下文
+ *   - allowed: 允许的种类，由 CODEGEN_RELOC_MASK 组合
+ *
+ * 返回值：
+ *   - 0: 全部重定位都属于允许的种类
+ *   - -1: 存在其它种类（已在首次出现所在行报告）
+ *
+ * 描述：
+ *   .COM 文件没有重定位表，只允许标签引用；段名引用需要 EXE 或 OBJ
+ *   输出（报告 E2006），EXTRN 符号引用只能由链接器解决，需要 OBJ 输出（E2007）。
+ */
+int codegen_check_relocations(const CodeGen* codegen, u32 allowed);
+
 /*
  * codegen_get_code_buffer
  *
@@ -151,6 +260,25 @@ u8* codegen_get_code_buffer(const CodeGen* codegen, u32* out_size);
  */
 Relocation* codegen_get_relocation_info(const CodeGen* codegen, u32* out_count);
 
+/*
+ * codegen_get_instruction_offsets
+ *
+ * 功能：获取各指令机器码在代码缓冲区中的实际起始偏移
+ *
+ * 参数：
+ *   - codegen: 已按指令顺序生成完毕的上下文
+ *
+ * 返回值：
+ *   - u32* : 数组（指令数 + 1 项，第 i 条指令占 [offsets[i], offsets[i + 1])，
+ *            末项等于 code_size）
+ *   - NULL: 尚未生成任何指令
+ *
+ * 描述：
+ *   第一遍扫描按估计长度分配 address，与实际编码长度不一致；标签的符号地址、
+ *   列表文件、行号表与映像文件中代码的位置都以此处记录的偏移为准。
+ */
+const u32* codegen_get_instruction_offsets(const CodeGen* codegen);
+
 /*
  * codegen_destroy
  *
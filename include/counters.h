@@ -0,0 +1,114 @@
+﻿/*
+ * ============================================================================
+ * 文件名: counters.h
+ * 描述  : 热路径计数器 - 查找、探测、冲突与重定位的事件计数
+ *
+ * 功能：
+ *  - tables_lookup_instruction：调用次数、字符串比较次数、未命中次数
+ *  - util_ht_lookup / util_ht_insert：调用次数、探测（链上节点）次数、
+ *    最长链长度、最大装载因子
+ *  - lexer_next_token：按 Token 类型计数
+ *  - 重定位：记录数、解决数与解决耗时
+ *
+ * 设计：
+ *  - 编译期开关：仅在定义 SUBAS_COUNTERS 时（make COUNTERS=1）生效，
+ *    否则 COUNTER_* 宏展开为空语句，热路径上没有任何额外指令
+ *  - 计数器为进程级原子量（relaxed），批量模式下多线程累加同一组计数
+ *  - --stats 输出时附带计数器（文本或 JSON）
+ *
+ * ============================================================================
+ */
+
+#ifndef __COUNTERS_H__
+#define __COUNTERS_H__
+
+#include <stdio.h>
+#include "utils.h"
+#include "lexer.h"
+
+/* ========================================================================= */
+/* 数据结构定义 */
+/* ========================================================================= */
+
+#define COUNTER_TOKEN_TYPES  (TOK_OTHER + 1)
+
+/*
+ * 计数器编号
+ */
+typedef enum {
+    COUNTER_INSN_LOOKUPS = 0,       /* tables_lookup_instruction 调用次数 */
+    COUNTER_INSN_COMPARES,          /* 其中的助记符比较次数 */
+    COUNTER_INSN_MISSES,            /* 未找到的查找次数 */
+    COUNTER_HT_LOOKUPS,             /* util_ht_lookup 调用次数 */
+    COUNTER_HT_LOOKUP_PROBES,       /* 查找时访问的链节点数 */
+    COUNTER_HT_LOOKUP_MISSES,       /* 查找未命中次数 */
+    COUNTER_HT_INSERTS,             /* util_ht_insert 调用次数 */
+    COUNTER_HT_INSERT_PROBES,       /* 插入时访问的链节点数 */
+    COUNTER_HT_MAX_CHAIN,           /* 插入后观察到的最长链（最大值） */
+    COUNTER_HT_MAX_LOAD,            /* 最大装载因子 x1000（最大值） */
+    COUNTER_RELOCATIONS,            /* 记录的重定位数 */
+    COUNTER_RELOC_RESOLVED,         /* 成功解决的重定位数 */
+    COUNTER_RELOC_RESOLVE_NS,       /* 解决重定位的耗时（纳秒） */
+    COUNTER_TOKENS,                 /* lexer_next_token 调用次数 */
+    COUNTER_TOKEN_BASE,             /* 按类型计数：COUNTER_TOKEN_BASE + TokenType */
+    COUNTER_COUNT = COUNTER_TOKEN_BASE + COUNTER_TOKEN_TYPES
+} CounterId;
+
+/* ========================================================================= */
+/* 插桩宏 */
+/* ========================================================================= */
+
+#ifdef SUBAS_COUNTERS
+#define COUNTERS_ENABLED        1
+#define COUNTER_ADD(id, n)      counters_add((id), (u64)(n))
+#define COUNTER_MAX(id, v)      counters_max((id), (u64)(v))
+#define COUNTER_ONLY(code)      code
+#else
+#define COUNTERS_ENABLED        0
+#define COUNTER_ADD(id, n)      ((void)0)
+#define COUNTER_MAX(id, v)      ((void)0)
+#define COUNTER_ONLY(code)
+#endif
+
+/* ========================================================================= */
+/* API 函数声明 */
+/* ========================================================================= */
+
+/*
+ * counters_add / counters_max
+ *
+ * 功能：累加计数 / 把计数提升为 value 与当前值的较大者
+ *       （通常经由 COUNTER_ADD / COUNTER_MAX 调用）
+ */
+void counters_add(CounterId id, u64 value);
+void counters_max(CounterId id, u64 value);
+
+/*
+ * counters_get
+ *
+ * 功能：读取计数器当前值
+ */
+u64 counters_get(CounterId id);
+
+/*
+ * counters_name
+ *
+ * 功能：返回计数器名称（Token 类型计数为 "token_<类型>"）
+ */
+const char* counters_name(CounterId id);
+
+/*
+ * counters_reset
+ *
+ * 功能：清零全部计数器
+ */
+void counters_reset(void);
+
+/*
+ * counters_write_json
+ *
+ * 功能：以 JSON 对象输出全部非零计数器（不含换行）
+ */
+void counters_write_json(FILE* fp);
+
+#endif /* __COUNTERS_H__ */
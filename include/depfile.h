@@ -0,0 +1,81 @@
+﻿/*
+ * ============================================================================
+ * 文件名: depfile.h
+ * 描述  : 依赖文件模块 - 生成 make 兼容的依赖文件（-MD / -MF）
+ *
+ * 功能：
+ *  - 记录汇编器为生成某个输出而读取的每一个文件
+ *  - 以 make 规则格式输出：<目标>: <依赖 1> <依赖 2> ...
+ *
+ * 设计：
+ *  - 流式写入：打开时写出目标，每记录一个依赖立即追加一行，不在内存中累积
+ *  - 路径中的空格、'#' 按 make 规则以反斜杠转义，'$' 写作 "$$"
+ *  - 汇编失败时调用 depfile_abort 删除不完整的依赖文件
+ *  - 目前没有 INCLUDE 指令，依赖只有源文件本身；支持包含文件后在读取处调用 depfile_add
+ *
+ * ============================================================================
+ */
+
+#ifndef __DEPFILE_H__
+#define __DEPFILE_H__
+
+#include <stdio.h>
+#include "utils.h"
+
+/* ========================================================================= */
+/* 数据结构定义 */
+/* ========================================================================= */
+
+/*
+ * 依赖文件写入器
+ */
+typedef struct {
+    FILE* fp;                   /* 依赖文件 */
+    char* path;                 /* 依赖文件路径（abort 时删除） */
+} DepFile;
+
+/* ========================================================================= */
+/* API 函数声明 */
+/* ========================================================================= */
+
+/*
+ * depfile_open
+ *
+ * 功能：创建依赖文件并写出规则目标
+ *
+ * 参数：
+ *   - path: 依赖文件路径
+ *   - target: 规则目标（汇编输出文件）
+ *
+ * 返回值：
+ *   - DepFile* : 写入器
+ *   - NULL: 无法创建文件
+ */
+DepFile* depfile_open(const char* path, const char* target);
+
+/*
+ * depfile_add
+ *
+ * 功能：追加一个依赖（汇编器读取过的文件）
+ */
+void depfile_add(DepFile* dep, const char* file);
+
+/*
+ * depfile_close
+ *
+ * 功能：结束规则并关闭依赖文件
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: 写入失败（文件已删除）
+ */
+int depfile_close(DepFile* dep);
+
+/*
+ * depfile_abort
+ *
+ * 功能：关闭并删除依赖文件（汇编失败时使用）
+ */
+void depfile_abort(DepFile* dep);
+
+#endif /* __DEPFILE_H__ */
@@ -32,6 +32,8 @@ typedef enum {
     ERR_PARSE_UNK_MNEMONIC  = 2003,  /* 未知指令助记符 */
     ERR_PARSE_DUP_LABEL     = 2004,  /* 标签重复定义 */
     ERR_PARSE_UNDEFINED_LBL = 2005,  /* 符号未定义 (通常在 Pass 2 报错) */
+    ERR_PARSE_SEGMENT_REF   = 2006,  /* 段引用需要 EXE 或 OBJ 输出 (Pass 2 报错) */
+    ERR_PARSE_EXTERN_REF    = 2007,  /* 外部符号引用需要 OBJ 输出 (Pass 2 报错) */
 
     /* 系统/资源错误 (System Errors) */
     ERR_SYS_OUT_OF_MEM      = 3001,  /* 内存溢出 */
@@ -44,13 +46,15 @@ typedef enum {
 
 /*
  * 函数: error_init
- * 描述: 初始化错误处理模块，重置错误计数。
+ * 描述: 初始化错误处理模块，重置当前线程所绑定错误上下文的计数与记录。
  */
 void error_init(void);
 
 /*
  * 函数: error_report
- * 描述: 向标准错误流报告一个错误。
+ * 描述: 报告一个错误。输出到 stderr 的诊断先缓存在当前错误上下文中，
+ *       由 error_flush 一次性写出；完全相同的诊断（行号、错误码、详情均相同）
+ *       只保留第一条，超过上限的诊断只计数不保存。
  * 参数: line_num - 发生错误的源代码行号
  * code     - 错误码 (ErrorCode 枚举)
  * detail   - 额外的详细描述信息 (可选，可为 NULL_PTR)
@@ -64,6 +68,13 @@ void error_report(u32 line_num, ErrorCode code, const char* detail);
  */
 u32 error_get_count(void);
 
+/*
+ * 函数: error_get_message
+ * 描述: 获取错误码对应的提示文本（与诊断输出中的文本相同）。
+ * 返回: 常量字符串，未知错误码返回通用提示
+ */
+const char* error_get_message(ErrorCode code);
+
 /*
  * 函数: error_has_failed
  * 描述: 检查编译是否失败（错误数 > 0）。
@@ -71,6 +82,134 @@ u32 error_get_count(void);
  */
 bool_t error_has_failed(void);
 
+/* --------------------------------------------------------------------------
+ * 3. 诊断捕获接口 (用于多线程流水线)
+ * 捕获期间当前线程的 error_report 不直接输出、也不计数，而是记录到缓冲区；
+ * 调用者随后在单一线程中按需回放，保证诊断顺序与串行执行一致。
+ * -------------------------------------------------------------------------- */
+
+/* 一条被捕获的诊断 */
+typedef struct {
+    u32 line;                   /* 源代码行号 */
+    ErrorCode code;             /* 错误码 */
+    char* detail;               /* 详细信息副本（可为 NULL_PTR） */
+} ErrorRecord;
+
+/* 诊断缓冲区 */
+typedef struct ErrorBuffer {
+    ErrorRecord* records;
+    u32 count;
+    u32 capacity;
+    struct ErrorBuffer* outer;  /* 捕获期间被遮蔽的外层缓冲区（error_capture_end 时恢复） */
+} ErrorBuffer;
+
+/*
+ * 函数: error_buffer_init
+ * 描述: 初始化一个空的诊断缓冲区。
+ */
+void error_buffer_init(ErrorBuffer* buffer);
+
+/*
+ * 函数: error_capture_begin
+ * 描述: 当前线程此后的诊断写入 buffer，直到调用 error_capture_end。
+ *       捕获可以嵌套：内层结束后恢复外层捕获。
+ */
+void error_capture_begin(ErrorBuffer* buffer);
+
+/*
+ * 函数: error_capture_end
+ * 描述: 结束当前线程最内层的诊断捕获，恢复外层捕获或直接输出。
+ */
+void error_capture_end(void);
+
+/*
+ * 函数: error_buffer_replay
+ * 描述: 按记录顺序逐条调用 error_report 回放缓冲区中的诊断。
+ */
+void error_buffer_replay(const ErrorBuffer* buffer);
+
+/*
+ * 函数: error_buffer_dispose
+ * 描述: 释放缓冲区中的所有记录并重置为空。
+ */
+void error_buffer_dispose(ErrorBuffer* buffer);
+
+/* --------------------------------------------------------------------------
+ * 4. 错误上下文接口 (用于同一进程内并发汇编多个源文件)
+ * 每个错误上下文拥有独立的计数和诊断记录。线程绑定某个上下文后，
+ * 该线程的 error_report / error_get_count 等均作用于该上下文；
+ * 未绑定的线程使用进程级默认上下文（输出到 stderr，与原行为一致）。
+ * -------------------------------------------------------------------------- */
+
+/* 诊断输出目标：error_flush 把格式化好的诊断文本整块交给它 */
+typedef void (*ErrorSink)(void* user, const char* text, u32 len);
+
+/* 错误上下文 */
+typedef struct {
+    u32 count;                  /* 已报告错误数（含被去重与超限的诊断） */
+    int echo;                   /* 是否同时输出到 stderr */
+    int record;                 /* 是否把诊断保存到 log */
+    ErrorBuffer log;            /* 诊断记录（record 为真时有效） */
+    u32 limit;                  /* 保存/输出的诊断上限（0 表示不限） */
+    u32 kept;                   /* 已保存/输出的不同诊断数 */
+    u32 duplicates;             /* 被去重丢弃的诊断数 */
+    u32 suppressed;             /* 因超过上限而丢弃的诊断数 */
+    ErrorBuffer pending;        /* 等待 error_flush 输出的诊断（echo 为真时有效） */
+    UtilHashTable* seen;        /* 去重集合（首次报告时创建） */
+    const char* source;         /* 源文本，用于输出源代码片段（可为 NULL_PTR） */
+    u32 source_len;
+    const u32* line_starts;     /* 行首偏移索引，line_starts[i] 为第 i + 1 行 */
+    u32 line_count;
+    ErrorSink sink;             /* 诊断输出目标（NULL_PTR 表示 stderr） */
+    void* sink_user;            /* 传给 sink 的用户数据 */
+} ErrorContext;
+
+#define ERROR_DEFAULT_LIMIT     100     /* 命令行默认的诊断上限 */
+
+/*
+ * 函数: error_context_init
+ * 描述: 初始化错误上下文。
+ * 参数: ctx    - 上下文
+ *       echo   - 非 0 时诊断同时输出到 stderr
+ *       record - 非 0 时诊断保存到 ctx->log
+ */
+void error_context_init(ErrorContext* ctx, int echo, int record);
+
+/*
+ * 函数: error_context_dispose
+ * 描述: 释放错误上下文中保存的诊断记录。
+ */
+void error_context_dispose(ErrorContext* ctx);
+
+/*
+ * 函数: error_bind
+ * 描述: 把当前线程绑定到 ctx（NULL_PTR 表示恢复默认上下文）。
+ * 返回: 先前绑定的上下文（默认上下文返回 NULL_PTR），便于调用者恢复
+ */
+ErrorContext* error_bind(ErrorContext* ctx);
+
+/*
+ * 函数: error_set_limit
+ * 描述: 设置当前错误上下文保存/输出的诊断上限（0 表示不限）。
+ */
+void error_set_limit(u32 limit);
+
+/*
+ * 函数: error_set_source
+ * 描述: 为当前错误上下文登记源文本与行首偏移索引，error_flush 据此在每条
+ *       诊断后附上对应的源代码行。源文本须保持有效直到下一次 error_flush；
+ *       传入 NULL_PTR 取消登记。
+ */
+void error_set_source(const char* source, u32 len, const u32* line_starts, u32 line_count);
+
+/*
+ * 函数: error_flush
+ * 描述: 把当前错误上下文中缓存的诊断格式化到一块内存，以一次写操作输出到
+ *       stderr（上下文设置了 sink 时交给 sink），并附上被去重/超限的数量摘要。
+ *       输出后清空缓存与源文本登记。
+ */
+void error_flush(void);
+
 
 #endif /* __ERROR_H__ */
 
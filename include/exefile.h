@@ -0,0 +1,113 @@
+﻿/*
+ * ============================================================================
+ * 文件名: exefile.h
+ * 描述  : EXE 文件模块 - 写出 DOS MZ 格式的可执行文件（--exe）
+ *
+ * 文件布局：
+ *   ExeHeader (28 字节) | 重定位表 (每项 偏移:段 各 16 位) | 填充到 16 字节 | 映像
+ *
+ * 设计：
+ *  - 重定位表的每一项指向映像中的一个段基址字（codegen 记录的 segment_fixups），
+ *    装载时 DOS 把装载段加到该字上
+ *  - 所有段在映像中连续排列、组成同一个组：CS 与段名引用都取映像开头，
+ *    标签地址与 .COM 输出一样相对映像开头
+ *  - 栈放在映像之后：SS 为映像所占的节数，SP 为栈大小，最小附加内存恰好容纳栈
+ *  - 头部各字段只依赖映像大小、修正数与入口，可以一次顺序写出：
+ *    头部 → 逐项写出重定位表 → 填充 → 映像，不在内存中拼装整个文件
+ *
+ * ============================================================================
+ */
+
+#ifndef __EXEFILE_H__
+#define __EXEFILE_H__
+
+#include "utils.h"
+#include "semantic.h"
+
+/* ========================================================================= */
+/* 常量定义 */
+/* ========================================================================= */
+
+#define EXEFILE_HEADER_SIZE     28          /* 固定头部字节数（重定位表紧随其后） */
+#define EXEFILE_PAGE_SIZE       512         /* e_cp / e_cblp 的页大小 */
+#define EXEFILE_PARAGRAPH       16          /* 节大小 */
+#define EXEFILE_DEFAULT_STACK   0x400       /* 默认栈大小（字节） */
+
+/* ========================================================================= */
+/* 数据结构定义 */
+/* ========================================================================= */
+
+/*
+ * MZ 文件头（各字段均为小端 16 位）
+ */
+typedef struct {
+    u16 magic;                  /* "MZ" */
+    u16 last_page_bytes;        /* 最后一页的字节数（0 表示整页） */
+    u16 page_count;             /* 文件所占的 512 字节页数（含头部） */
+    u16 relocation_count;       /* 重定位项数 */
+    u16 header_paragraphs;      /* 头部（含重定位表与填充）所占节数 */
+    u16 min_alloc;              /* 映像之后至少需要的附加节数 */
+    u16 max_alloc;              /* 映像之后最多需要的附加节数 */
+    u16 initial_ss;             /* SS 初值（相对装载段） */
+    u16 initial_sp;             /* SP 初值 */
+    u16 checksum;               /* 校验和（未使用，写 0） */
+    u16 initial_ip;             /* IP 初值 */
+    u16 initial_cs;             /* CS 初值（相对装载段） */
+    u16 relocation_offset;      /* 重定位表的文件偏移 */
+    u16 overlay;                /* 覆盖号（主程序为 0） */
+} ExeHeader;
+
+/*
+ * 待写出的映像
+ */
+typedef struct {
+    const u8* code;             /* 映像（机器码） */
+    u32 size;                   /* 映像字节数 */
+    const u32* fixups;          /* 段基址字在映像中的偏移 */
+    u32 fixup_count;            /* 段基址修正数 */
+    u32 entry;                  /* 入口相对映像开头的偏移 */
+    u32 stack_size;             /* 栈字节数（0 表示 EXEFILE_DEFAULT_STACK） */
+} ExeImage;
+
+/* ========================================================================= */
+/* API 函数声明 */
+/* ========================================================================= */
+
+/*
+ * exefile_entry_point
+ *
+ * 功能：取 END 伪指令所指定的入口标签的地址
+ *
+ * 参数：
+ *   - pass_one: 第一遍扫描结果
+ *   - offsets: 各指令机器码的实际起始偏移（AsmOutput.instruction_offsets）；
+ *              入口取标签所在指令的偏移，而非第一遍估计的 address
+ *
+ * 返回值：
+ *   - 入口地址；没有 "END label" 或标签未定义时为 0（映像开头）
+ */
+u32 exefile_entry_point(const PassOne* pass_one, const u32* offsets);
+
+/*
+ * exefile_build_header
+ *
+ * 功能：按映像计算 MZ 头部
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: 超出格式限制（修正超出映像，入口、栈或文件过大）
+ */
+int exefile_build_header(const ExeImage* image, ExeHeader* out);
+
+/*
+ * exefile_write
+ *
+ * 功能：一次顺序写出 EXE 文件
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: 超出格式限制或写入失败（不完整的文件被删除）
+ */
+int exefile_write(const char* path, const ExeImage* image);
+
+#endif /* __EXEFILE_H__ */
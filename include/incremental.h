@@ -0,0 +1,169 @@
+﻿/*
+ * ============================================================================
+ * 文件名: incremental.h
+ * 描述  : 增量汇编模块 - 编辑源文本后只重新处理被改动的行
+ *
+ * 功能：
+ *  - 创建时对整份源文本做一次完整汇编，保留行索引、IR 条目、符号表与机器码
+ *  - 每次编辑以 (偏移, 删除长度, 插入文本) 描述，只重新词法分析并解析受影响的行，
+ *    把新条目拼接进指令序列，顺延其后条目的行号与地址
+ *  - 只重新编码被编辑的指令，其余机器码按字节平移；最后重新解析全部重定位，
+ *    仅改写值发生变化的引用
+ *
+ * 设计：
+ *  - 第一遍扫描与行内容以外的上下文无关（标签除外），地址为条目长度的累加，
+ *    因此被编辑行之外的条目无需重新解析
+ *  - 出错的行与完整汇编一样保留为占位条目，各行的诊断随条目保存、随行号平移，
+ *    因此输入过程中源文本暂时有错误时仍以增量方式完成
+ *  - 以下情况退回完整汇编，保证结果与 subas_assemble 完全一致：
+ *    上一次完整汇编因内存不足等中途失败、编辑涉及 EXTRN/PUBLIC 行、
+ *    新标签与其后行的标签重名、被撤销的标签另有重名条目、代码缓冲区或重定位表溢出
+ *  - 每次编辑后把当前源文本的全部诊断报告到当前线程的错误上下文
+ *
+ * ============================================================================
+ */
+
+#ifndef __INCREMENTAL_H__
+#define __INCREMENTAL_H__
+
+#include "utils.h"
+#include "semantic.h"
+#include "symtab.h"
+
+/* ========================================================================= */
+/* 数据结构定义 */
+/* ========================================================================= */
+
+/* 增量汇编会话（不透明类型） */
+typedef struct IncrementalAsm IncrementalAsm;
+
+/* 增量汇编统计（last_* 为最近一次编辑的工作量） */
+typedef struct {
+    u32 full_builds;            /* 完整汇编次数（含创建时的一次） */
+    u32 incremental_edits;      /* 以增量方式完成的编辑次数 */
+    u32 last_relexed_lines;     /* 重新词法分析的行数 */
+    u32 last_reparsed;          /* 重新解析得到的 IR 条目数 */
+    u32 last_readdressed;       /* 重新计算地址的条目数 */
+    u32 last_reencoded;         /* 重新编码的指令数 */
+    u32 last_patched;           /* 改写的重定位数 */
+} IncrementalStats;
+
+/* 一个 IR 条目的只读视图（行号、地址等取自会话维护的列数组） */
+typedef struct {
+    const InstructionEntry* entry;  /* 条目内容（助记符、操作数、标签） */
+    u32 line;                   /* 所在行号 */
+    u32 address;                /* 地址（机器码在映像中的实际偏移） */
+    u32 length;                 /* 第一遍估计的长度 */
+    const u8* code;             /* 机器码（当前源文本有错误时为 NULL_PTR） */
+    u32 code_length;            /* 机器码字节数 */
+} IncrementalEntry;
+
+/* ========================================================================= */
+/* API 函数声明 */
+/* ========================================================================= */
+
+/*
+ * incremental_create
+ *
+ * 功能：创建增量汇编会话并完整汇编源文本（源文本被复制）
+ *
+ * 返回值：
+ *   - IncrementalAsm*: 会话（即使源文本有错误也返回，见 incremental_has_errors）
+ *   - NULL: 内存不足
+ */
+IncrementalAsm* incremental_create(const char* source, u32 len);
+
+/*
+ * incremental_edit
+ *
+ * 功能：把源文本 [offset, offset + remove_len) 替换为 text 并更新汇编结果
+ *
+ * 返回值：
+ *   - 0: 编辑后的源文本汇编成功
+ *   - -1: 汇编失败（错误已报告），或编辑范围越界（源文本不变）
+ */
+int incremental_edit(IncrementalAsm* inc, u32 offset, u32 remove_len, const char* text, u32 text_len);
+
+/*
+ * incremental_has_errors
+ *
+ * 功能：当前源文本是否有汇编错误
+ */
+int incremental_has_errors(const IncrementalAsm* inc);
+
+/*
+ * incremental_get_code
+ *
+ * 功能：获取当前机器码
+ *
+ * 返回值：
+ *   - const u8*: 代码缓冲区（下一次编辑后失效）
+ *   - NULL: 当前源文本有错误
+ */
+const u8* incremental_get_code(const IncrementalAsm* inc, u32* out_size);
+
+/*
+ * incremental_get_source
+ *
+ * 功能：获取当前源文本（不以 '\0' 结尾）
+ */
+const char* incremental_get_source(const IncrementalAsm* inc, u32* out_len);
+
+/*
+ * incremental_get_line_starts
+ *
+ * 功能：获取当前源文本的行首偏移（第 i + 1 行起始于 starts[i]，供诊断输出源代码行）
+ */
+const u32* incremental_get_line_starts(const IncrementalAsm* inc, u32* out_count);
+
+/*
+ * incremental_get_entry_count
+ *
+ * 功能：获取当前 IR 条目数（有错误时为完整汇编解析到的条目，错误行为占位条目）
+ */
+u32 incremental_get_entry_count(const IncrementalAsm* inc);
+
+/*
+ * incremental_get_entry
+ *
+ * 功能：读取第 index 个条目（视图在下一次编辑后失效）
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: index 越界
+ */
+int incremental_get_entry(const IncrementalAsm* inc, u32 index, IncrementalEntry* out);
+
+/*
+ * incremental_find_line
+ *
+ * 功能：二分查找第一个行号不小于 line 的条目索引（不存在时返回条目数）
+ */
+u32 incremental_find_line(const IncrementalAsm* inc, u32 line);
+
+/*
+ * incremental_lookup_symbol
+ *
+ * 功能：按名称查找当前符号表中的符号（地址随编辑更新）
+ *
+ * 返回值：
+ *   - const SymbolInfo*: 符号（下一次编辑后失效）
+ *   - NULL: 未定义
+ */
+const SymbolInfo* incremental_lookup_symbol(const IncrementalAsm* inc, const char* name);
+
+/*
+ * incremental_get_stats
+ *
+ * 功能：获取增量汇编统计
+ */
+const IncrementalStats* incremental_get_stats(const IncrementalAsm* inc);
+
+/*
+ * incremental_destroy
+ *
+ * 功能：销毁会话并释放全部资源
+ */
+void incremental_destroy(IncrementalAsm* inc);
+
+#endif /* __INCREMENTAL_H__ */
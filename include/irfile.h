@@ -0,0 +1,197 @@
+﻿/*
+ * ============================================================================
+ * 文件名: irfile.h
+ * 描述  : IR 文件模块 - 第一遍扫描结果（PassOne）的序列化与映射加载
+ *
+ * 功能：
+ *  - 把 PassOne（指令列表、符号表）写成带版本号、不含指针的紧凑二进制文件
+ *  - 以一次 mmap 映射 IR 文件，校验后解码为 PassOne 交给第二遍扫描，不再词法与语法分析
+ *  - 为外部工具提供稳定、无需解析源文本的程序视图
+ *
+ * 文件格式（小端，所有位置均为相对文件开头的字节偏移，不含指针）：
+ *
+ *   IrHeader                    固定 56 字节，见下
+ *   IrInstruction[count]        指令：地址、长度、行号、助记符与标签的字符串偏移、操作数区间
+ *   IrOperand[operand_count]    各指令实际使用的操作数，按指令顺序连续存放
+ *   IrSymbol[symbol_count]      符号表，按定义所在的指令顺序（EXTRN 声明的外部符号
+ *                               地址为 0，数组不按地址排序）
+ *   char strings[strings_size]  字符串池：助记符、标签、操作数名与符号名，每个不同的
+ *                               字符串只存一份，以 '\0' 结尾
+ *
+ *   各段按 8 字节对齐，映射后可直接按数组下标访问。
+ *
+ * 设计：
+ *  - 内存中的 InstructionEntry 为操作数与名字预留定长数组（约 4.5KB），按原样写出时
+ *    1KB 的源文件对应数百 KB 的 IR；文件中每条指令只占 IrInstruction 加实际操作数，
+ *    名字经字符串池驻留，典型指令约 50 字节
+ *  - 版本号或字节序标记不符即拒绝加载（调用者回退到完整汇编）；映射时校验全部
+ *    操作数区间与字符串偏移，加载不会越界或截断名字
+ *  - 只写入无错误的 PassOne；加载时解码出自有的指令列表，符号表由符号数组重建
+ *    （O(指令数 + 符号数)），加载完成后即可解除映射
+ *
+ * ============================================================================
+ */
+
+#ifndef __IRFILE_H__
+#define __IRFILE_H__
+
+#include "utils.h"
+#include "semantic.h"
+
+/* ========================================================================= */
+/* 常量定义 */
+/* ========================================================================= */
+
+#define IRFILE_MAGIC            "SUBASIR"       /* 8 字节魔数（含结尾 '\0'） */
+#define IRFILE_VERSION          2               /* 格式变化时递增 */
+#define IRFILE_BYTE_ORDER       0x01020304u     /* 按本机字节序写入，用于检测字节序 */
+#define IRFILE_NO_STRING        0xFFFFFFFFu     /* 无标签、无名字的操作数 */
+
+/* ========================================================================= */
+/* 数据结构定义 */
+/* ========================================================================= */
+
+/*
+ * IR 文件头（56 字节）
+ */
+typedef struct {
+    char magic[8];              /* IRFILE_MAGIC */
+    u32 version;                /* IRFILE_VERSION */
+    u32 byte_order;             /* IRFILE_BYTE_ORDER */
+    u32 instruction_count;      /* 指令条数 */
+    u32 operand_count;          /* 操作数数组项数 */
+    u32 symbol_count;           /* 符号数 */
+    u32 code_size;              /* 第一遍结束时的地址（代码长度） */
+    u32 line_count;             /* 第一遍结束时的行号 */
+    u32 strings_size;           /* 字符串池字节数 */
+    u32 instructions_offset;    /* 指令数组偏移 */
+    u32 operands_offset;        /* 操作数数组偏移 */
+    u32 symbols_offset;         /* 符号数组偏移 */
+    u32 strings_offset;         /* 字符串池偏移 */
+} IrHeader;
+
+/*
+ * IR 文件中的一条指令
+ */
+typedef struct {
+    u32 address;                /* 第一遍分配的地址 */
+    u32 length;                 /* 第一遍估计的长度 */
+    u32 line;                   /* 源代码行号 */
+    u32 mnemonic;               /* 助记符在字符串池中的偏移 */
+    u32 label;                  /* 标签名的偏移，无标签时为 IRFILE_NO_STRING */
+    u32 first_operand;          /* 第一个操作数在操作数数组中的下标 */
+    u32 operand_count;          /* 操作数个数 */
+} IrInstruction;
+
+/*
+ * IR 文件中的一个操作数
+ */
+typedef struct {
+    u32 type;                   /* OperandType */
+    u32 value;                  /* 寄存器号、立即数等 */
+    u32 name;                   /* 符号名的偏移，无名字时为 IRFILE_NO_STRING */
+} IrOperand;
+
+/*
+ * IR 文件中的一个符号
+ */
+typedef struct {
+    u32 name;                   /* 名称在字符串池中的偏移 */
+    u32 type;                   /* SymbolType */
+    u32 address;                /* 地址 */
+    u32 line_defined;           /* 定义行号 */
+} IrSymbol;
+
+/*
+ * 已映射的 IR 文件
+ */
+typedef struct {
+    const u8* base;             /* 映射起始地址 */
+    u64 size;                   /* 映射字节数 */
+    const IrHeader* header;     /* 文件头（base 处） */
+    const IrInstruction* instructions;
+    const IrOperand* operands;
+    const IrSymbol* symbols;
+    const char* strings;
+} IrFile;
+
+/* ========================================================================= */
+/* API 函数声明 */
+/* ========================================================================= */
+
+/*
+ * irfile_serialize
+ *
+ * 功能：把第一遍扫描结果序列化为一块连续内存
+ *
+ * 参数：
+ *   - pass_one: 无错误的第一遍扫描结果
+ *   - out_size: 输出参数，返回字节数
+ *
+ * 返回值：
+ *   - u8* : 序列化结果（调用者以 util_free 释放）
+ *   - NULL: pass_one 含错误、超出 u32 大小或内存不足
+ */
+u8* irfile_serialize(const PassOne* pass_one, u32* out_size);
+
+/*
+ * irfile_write
+ *
+ * 功能：把第一遍扫描结果写到 path（先写临时文件再 rename）
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: 失败
+ */
+int irfile_write(const PassOne* pass_one, const char* path);
+
+/*
+ * irfile_map
+ *
+ * 功能：以一次只读 mmap 映射 IR 文件并校验文件头与各段边界
+ *
+ * 参数：
+ *   - path: IR 文件路径
+ *   - out: 输出参数，成功时填充
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: 文件不存在、格式不符或已损坏
+ */
+int irfile_map(const char* path, IrFile* out);
+
+/*
+ * irfile_view
+ *
+ * 功能：校验内存中的 IR 内容（如从构建缓存读出）并填充 IrFile
+ *
+ * 参数：
+ *   - data: IR 内容，须 8 字节对齐且在 IrFile 使用期间有效（不接管所有权）
+ *   - size: 字节数
+ *   - out: 输出参数，成功时填充（无需 irfile_unmap）
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: 格式不符或已损坏
+ */
+int irfile_view(const u8* data, u64 size, IrFile* out);
+
+/*
+ * irfile_unmap
+ *
+ * 功能：解除映射（由其加载的 PassOne 须先销毁）
+ */
+void irfile_unmap(IrFile* file);
+
+/*
+ * irfile_load
+ *
+ * 功能：由已映射的 IR 文件构造 PassOne，供 codegen_pass_two 直接使用
+ *
+ * 返回值：
+ *   - PassOne* : 解码得到的 PassOne，不引用映射（以 semantic_pass_one_destroy 释放）
+ *   - NULL: 内存不足
+ */
+PassOne* irfile_load(const IrFile* file);
+
+#endif /* __IRFILE_H__ */
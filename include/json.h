@@ -0,0 +1,141 @@
+﻿/*
+ * ============================================================================
+ * 文件名: json.h
+ * 描述  : 最小 JSON 模块 - 解析为值树、生成 JSON 文本（语言服务器协议使用）
+ *
+ * 功能：
+ *  - json_parse：把一段 JSON 文本解析为 JsonValue 树（字符串解码为 UTF-8）
+ *  - json_get / json_get_int / json_get_string：按成员名读取对象
+ *  - JsonWriter：向可增长的缓冲区追加 JSON 片段，字符串自动转义
+ *
+ * 限制：
+ *  - 数字只保留整数部分（协议中的行号、列号、id 等均为整数）
+ *  - 嵌套深度超过 JSON_MAX_DEPTH 视为语法错误
+ *
+ * ============================================================================
+ */
+
+#ifndef __JSON_H__
+#define __JSON_H__
+
+#include "utils.h"
+
+/* ========================================================================= */
+/* 常量定义 */
+/* ========================================================================= */
+
+#define JSON_MAX_DEPTH      64
+
+/* ========================================================================= */
+/* 数据结构定义 */
+/* ========================================================================= */
+
+/* JSON 值类型 */
+typedef enum {
+    JSON_NULL = 0,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+} JsonType;
+
+/* JSON 值 */
+typedef struct JsonValue {
+    JsonType type;
+    s64 integer;                /* JSON_NUMBER 的整数部分；JSON_BOOL 为 0 / 1 */
+    char* string;               /* JSON_STRING：解码后的文本（'\0' 结尾） */
+    u32 length;                 /* JSON_STRING：字节数 */
+    struct JsonValue* items;    /* JSON_ARRAY 的元素 / JSON_OBJECT 的成员值 */
+    char** keys;                /* JSON_OBJECT 的成员名 */
+    u32 count;                  /* 元素数 / 成员数 */
+} JsonValue;
+
+/* JSON 文本生成器 */
+typedef struct {
+    char* data;                 /* 已生成的文本（不以 '\0' 结尾） */
+    u32 len;
+    u32 capacity;
+    int failed;                 /* 内存不足后置位，其后的追加被忽略 */
+} JsonWriter;
+
+/* ========================================================================= */
+/* API 函数声明 */
+/* ========================================================================= */
+
+/*
+ * json_parse
+ *
+ * 功能：解析 JSON 文本
+ *
+ * 返回值：
+ *   - JsonValue*: 值树根（由 json_free 释放）
+ *   - NULL: 语法错误或内存不足
+ */
+JsonValue* json_parse(const char* text, u32 len);
+
+/*
+ * json_free
+ *
+ * 功能：释放 json_parse 返回的值树
+ */
+void json_free(JsonValue* value);
+
+/*
+ * json_get
+ *
+ * 功能：读取对象成员；value 不是对象或成员不存在时返回 NULL
+ */
+const JsonValue* json_get(const JsonValue* value, const char* key);
+
+/*
+ * json_get_int
+ *
+ * 功能：读取整数成员；不存在或不是数字时返回 fallback
+ */
+s64 json_get_int(const JsonValue* value, const char* key, s64 fallback);
+
+/*
+ * json_get_string
+ *
+ * 功能：读取字符串成员；不存在或不是字符串时返回 NULL
+ */
+const char* json_get_string(const JsonValue* value, const char* key);
+
+/*
+ * json_writer_init / json_writer_dispose
+ *
+ * 功能：初始化空的生成器 / 释放其缓冲区
+ */
+void json_writer_init(JsonWriter* writer);
+void json_writer_dispose(JsonWriter* writer);
+
+/*
+ * json_write_raw
+ *
+ * 功能：原样追加一段已是 JSON 语法的文本（'\0' 结尾）
+ */
+void json_write_raw(JsonWriter* writer, const char* text);
+
+/*
+ * json_write_string
+ *
+ * 功能：追加一个 JSON 字符串（加引号并转义）
+ */
+void json_write_string(JsonWriter* writer, const char* text, u32 len);
+
+/*
+ * json_write_int
+ *
+ * 功能：追加一个整数
+ */
+void json_write_int(JsonWriter* writer, s64 value);
+
+/*
+ * json_write_value
+ *
+ * 功能：把值树重新生成为 JSON 文本（用于原样回送请求 id 等）
+ */
+void json_write_value(JsonWriter* writer, const JsonValue* value);
+
+#endif /* __JSON_H__ */
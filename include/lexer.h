@@ -45,12 +45,38 @@ typedef struct {
     s32 int_value;  /* 若为数字，可填充其整数值（十进制/十六进制） */
 } Token;
 
+/*
+ * 行偏移索引：starts[i] 为第 i + 1 行首字符在源文本中的偏移，
+ * 由词法器在扫描换行时顺带建立，诊断输出据此 O(1) 取出源代码行
+ */
+typedef struct {
+    u32* starts;
+    u32 count;      /* 已记录的行数 */
+    u32 capacity;
+} LineIndex;
+
+/*
+ * 流式输入回调：向 dest 写入至多 capacity 字节，返回写入的字节数；
+ * 返回 0 表示输入结束（读取错误由回调自行记录）。
+ */
+typedef u32 (*LexerReadFunc)(void* user, char* dest, u32 capacity);
+
+#define LEXER_STREAM_WINDOW     (64 * 1024)     /* 流式输入窗口的默认大小 */
+
 /* 词法器状态结构体 */
 typedef struct Lexer {
-    char* buffer;   /* 源文本副本（以便安全访问） */
-    u32 pos;        /* 当前读取位置（0 起始） */
+    char* buffer;   /* 源文本副本（以便安全访问）；流式模式下为输入窗口 */
+    u32 pos;        /* 当前读取位置（0 起始，相对 buffer） */
     u32 len;        /* buffer 的长度（不含隐式终止符） */
     u32 line;       /* 当前行号（1 起始） */
+    LineIndex* lines; /* 行偏移索引（可为 NULL_PTR，见 lexer_set_line_index） */
+    /* 流式输入（read 为 NULL_PTR 时为整块缓冲区模式） */
+    LexerReadFunc read;
+    void* read_user;
+    u32 capacity;   /* 窗口容量（单个 Token 超过窗口时翻倍） */
+    u32 mark;       /* 当前 Token 的起始位置：补充窗口时保留其后的内容 */
+    u64 base;       /* buffer[0] 在整个输入中的偏移 */
+    int eof;        /* 回调已报告输入结束 */
 } Lexer;
 
 /* API 函数 */
@@ -61,6 +87,23 @@ typedef struct Lexer {
  */
 Lexer* lexer_create_from_string(const char* src);
 
+/*
+ * 创建词法器：从给定长度的源文本（不要求以 \0 结尾）创建 Lexer 对象并复制源文本。
+ * 返回已分配的 Lexer*，失败返回 NULL_PTR。
+ */
+Lexer* lexer_create_from_buffer(const char* src, u32 len);
+
+/*
+ * 创建词法器：从流式输入读取源文本，只保留大小为 window（0 表示
+ * LEXER_STREAM_WINDOW）的可补充窗口，内存占用与输入长度无关。
+ * 跨越窗口边界的 Token 在补充时整体前移保留，结果与整块模式一致。
+ * 返回已分配的 Lexer*，失败返回 NULL_PTR。
+ */
+Lexer* lexer_create_from_stream(LexerReadFunc read, void* user, u32 window);
+
+/* 返回目前为止读入的输入字节数（整块模式下为源文本长度） */
+u64 lexer_bytes_read(const Lexer* lx);
+
 /* 释放词法器以及内部缓冲区 */
 void lexer_destroy(Lexer* lx);
 
@@ -73,6 +116,17 @@ Token lexer_next_token(Lexer* lx);
 /* 释放单个 Token 占用的内存（主要是 lexeme） */
 void token_dispose(Token* tok);
 
+/* 初始化 / 清空 / 释放行偏移索引 */
+void line_index_init(LineIndex* index);
+void line_index_reset(LineIndex* index);
+void line_index_dispose(LineIndex* index);
+
+/*
+ * 让词法器在扫描过程中把行首偏移追加到 index（应在读取第一个 Token 前调用）。
+ * index 先被清空并记录第 1 行；其生命周期由调用者管理。
+ */
+void lexer_set_line_index(Lexer* lx, LineIndex* index);
+
 #endif /* __LEXER_H__ */
 
 
@@ -0,0 +1,164 @@
+﻿/*
+ * ============================================================================
+ * 文件名: linetab.h
+ * 描述  : 行号表模块 - 地址 → 源代码行的紧凑调试表（--emit-lines / --addr2line）
+ *
+ * 功能：
+ *  - 由第二遍扫描记录的实际偏移与第一遍扫描记录的 line 生成增量编码的行号表
+ *  - 以一次 mmap 映射行号表，按地址二分查找块索引后在块内顺序解码
+ *
+ * 文件格式（小端，所有位置均为相对文件开头的字节偏移）：
+ *
+ *   LineTableHeader             固定 32 字节，见下
+ *   char name[name_size]        源文件名（不含 '\0'），补齐到 4 字节
+ *   LineTableBlock[block_count] 块索引：每块首行的地址、行号与其在行流中的偏移
+ *   u8 stream[stream_size]      行流：每块除首行外的各行，相对前一行增量编码
+ *
+ * 行流操作码（每块从块索引给出的状态开始解码）：
+ *   0x00        一般行：其后为 ULEB128 地址增量与 SLEB128 行号增量
+ *   0x01..0x7F  重复 n 次上一行的地址增量与行号增量
+ *   0x80..0xFF  特殊行：地址增量为低 5 位（1..31），行号增量为 bit5..6 + 1（1..4）
+ *
+ * 设计：
+ *  - 每个生成机器码的条目一行；零长度条目（标签行、ORG 等）与错误占位条目不入表
+ *  - 逐行汇编的典型程序每行只占 1 字节，重复的指令模式合并为一个重复操作码
+ *  - 块索引每 LINETAB_BLOCK_ROWS 行一项，查找为 O(log 块数 + 块内行数)
+ *
+ * ============================================================================
+ */
+
+#ifndef __LINETAB_H__
+#define __LINETAB_H__
+
+#include "utils.h"
+#include "semantic.h"
+#include "codegen.h"
+
+/* ========================================================================= */
+/* 常量定义 */
+/* ========================================================================= */
+
+#define LINETAB_MAGIC           "SBLT"          /* 4 字节魔数（不含结尾 '\0'） */
+#define LINETAB_VERSION         1               /* 格式变化时递增 */
+#define LINETAB_BYTE_ORDER      0x01020304u     /* 按本机字节序写入，用于检测字节序 */
+#define LINETAB_BLOCK_ROWS      64              /* 每个索引块的行数 */
+
+/* ========================================================================= */
+/* 数据结构定义 */
+/* ========================================================================= */
+
+/*
+ * 行号表文件头（32 字节）
+ */
+typedef struct {
+    char magic[4];              /* LINETAB_MAGIC */
+    u32 version;                /* LINETAB_VERSION */
+    u32 byte_order;             /* LINETAB_BYTE_ORDER */
+    u32 row_count;              /* 行数 */
+    u32 block_count;            /* 块索引项数 */
+    u32 end_address;            /* 最后一行覆盖范围的结束地址（不含） */
+    u32 name_size;              /* 源文件名字节数 */
+    u32 stream_size;            /* 行流字节数 */
+} LineTableHeader;
+
+/*
+ * 块索引项
+ */
+typedef struct {
+    u32 address;                /* 块首行地址 */
+    u32 line;                   /* 块首行行号 */
+    u32 offset;                 /* 块内第二行在行流中的偏移 */
+} LineTableBlock;
+
+/*
+ * 行号表视图（映射的文件或内存中的序列化结果）
+ */
+typedef struct {
+    const u8* base;             /* 起始地址 */
+    u64 size;                   /* 字节数 */
+    int mapped;                 /* 是否由 linetab_map 映射 */
+    const LineTableHeader* header;
+    const char* name;           /* 源文件名（不以 '\0' 结尾，长度见 header->name_size） */
+    const LineTableBlock* blocks;
+    const u8* stream;
+} LineTable;
+
+/* ========================================================================= */
+/* API 函数声明 */
+/* ========================================================================= */
+
+/*
+ * linetab_serialize
+ *
+ * 功能：由汇编结果生成行号表
+ *
+ * 参数：
+ *   - pass_one: 第一遍扫描结果（提供行号）
+ *   - offsets: 各指令机器码的实际起始偏移（codegen_get_instruction_offsets，
+ *              即 AsmOutput.instruction_offsets；第一遍的 address 只是估计）
+ *   - name: 源文件名（写入表中供 --addr2line 输出，可为 NULL）
+ *   - out_size: 输出参数，返回字节数
+ *
+ * 返回值：
+ *   - u8* : 行号表（调用者以 util_free 释放）
+ *   - NULL: 内存不足
+ */
+u8* linetab_serialize(const PassOne* pass_one, const u32* offsets, const char* name, u32* out_size);
+
+/*
+ * linetab_write
+ *
+ * 功能：生成行号表并写到 path（先写临时文件再 rename）
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: 失败
+ */
+int linetab_write(const PassOne* pass_one, const u32* offsets, const char* name, const char* path);
+
+/*
+ * linetab_open
+ *
+ * 功能：在一块内存上建立行号表视图并校验
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: 格式不符或已损坏
+ */
+int linetab_open(const void* data, u64 size, LineTable* out);
+
+/*
+ * linetab_map
+ *
+ * 功能：以一次只读 mmap 映射行号表文件并校验
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: 文件不存在、格式不符或已损坏
+ */
+int linetab_map(const char* path, LineTable* out);
+
+/*
+ * linetab_unmap
+ *
+ * 功能：解除 linetab_map 建立的映射
+ */
+void linetab_unmap(LineTable* table);
+
+/*
+ * linetab_lookup
+ *
+ * 功能：查找覆盖 address 的源代码行
+ *
+ * 参数：
+ *   - table: 行号表
+ *   - address: 地址
+ *   - out_line: 输出参数，成功时返回行号
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: address 不在任何行的范围内
+ */
+int linetab_lookup(const LineTable* table, u32 address, u32* out_line);
+
+#endif /* __LINETAB_H__ */
@@ -0,0 +1,102 @@
+﻿/*
+ * ============================================================================
+ * 文件名: listing.h
+ * 描述  : 列表文件模块 - 在第二遍扫描中流式生成 MASM 风格的 .LST 列表
+ *
+ * 功能：
+ *  - 每个源代码行一行：行号、地址（机器码在映像中的实际偏移）、机器码字节、源代码原文
+ *  - 标签引用字段显示为填充后的地址（未定义符号显示为 ??）
+ *  - 文件末尾附按名字排序的符号表
+ *
+ * 设计：
+ *  - listing_instruction 作为 CodeGenListener 挂在 codegen_pass_two_listed 上，
+ *    引用解决后逐条写出对应行，不再另外遍历指令列表
+ *  - 源文本以游标顺序前进，没有指令的行（注释、空行）在遇到下一条指令时补写
+ *  - 行地址、重定位字段与符号表附录的地址都取机器码的实际偏移（第二遍已把
+ *    标签的符号地址改为所在指令的偏移），列表与映像逐字节一致
+ *  - 输出先累积在大块缓冲区中，写满才调用一次 fwrite
+ *
+ * ============================================================================
+ */
+
+#ifndef __LISTING_H__
+#define __LISTING_H__
+
+#include <stdio.h>
+#include "utils.h"
+#include "symtab.h"
+#include "codegen.h"
+
+/* ========================================================================= */
+/* 常量定义 */
+/* ========================================================================= */
+
+#define LISTING_BUFFER_SIZE     (256 * 1024)    /* 输出缓冲区大小 */
+#define LISTING_BYTES_PER_ROW   6               /* 每行显示的机器码字节数，超出部分续行 */
+
+/* ========================================================================= */
+/* 数据结构定义 */
+/* ========================================================================= */
+
+/*
+ * 列表文件写入器
+ */
+typedef struct {
+    FILE* fp;                   /* 列表文件 */
+    char* buffer;               /* 输出缓冲区 */
+    u32 used;                   /* 缓冲区已用字节数 */
+    int failed;                 /* 是否发生写入错误 */
+    const char* source;         /* 源文本（调用者保证在 listing_close 前有效） */
+    u32 source_len;             /* 源文本字节数 */
+    u32 cursor;                 /* 下一个未写出的源代码行的起始偏移 */
+    u32 next_line;              /* cursor 处的行号（1 起始） */
+} Listing;
+
+/* ========================================================================= */
+/* API 函数声明 */
+/* ========================================================================= */
+
+/*
+ * listing_open
+ *
+ * 功能：创建列表文件并写出标题
+ *
+ * 参数：
+ *   - path: 列表文件路径
+ *   - title: 标题（通常为源文件名）
+ *   - source: 源文本（不要求以 '\0' 结尾）
+ *   - source_len: 源文本字节数
+ *
+ * 返回值：
+ *   - Listing* : 写入器
+ *   - NULL: 无法创建文件或内存不足
+ */
+Listing* listing_open(const char* path, const char* title, const char* source, u32 source_len);
+
+/*
+ * listing_instruction
+ *
+ * 功能：写出一条指令所在的行（CodeGenListener，user 为 Listing*）
+ *
+ * 描述：
+ *   先补写该指令之前没有指令的源代码行；同一行上的后续条目只写地址与字节。
+ */
+void listing_instruction(void* user, const CodeGen* codegen, u32 index,
+                         u32 code_start, u32 first_relocation);
+
+/*
+ * listing_close
+ *
+ * 功能：写出剩余源代码行与符号表，关闭列表文件
+ *
+ * 参数：
+ *   - listing: 写入器
+ *   - symtab: 符号表（NULL 表示汇编失败，不附符号表）
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: 写入失败
+ */
+int listing_close(Listing* listing, SymbolTable* symtab);
+
+#endif /* __LISTING_H__ */
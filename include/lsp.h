@@ -0,0 +1,96 @@
+﻿/*
+ * ============================================================================
+ * 文件名: lsp.h
+ * 描述  : 语言服务器模块 - 经标准输入输出提供 Language Server Protocol
+ *
+ * 功能：
+ *  - 每个打开的文档常驻一个增量汇编会话（IncrementalAsm）：源文本、行索引、
+ *    IR 条目、符号表与机器码随编辑增量更新，不按键重跑整个汇编器
+ *  - textDocument/definition：由符号表直接找到标签定义行
+ *  - textDocument/references：按需建立 符号名 → 引用行 的索引，编辑后失效
+ *  - textDocument/hover：符号的类型与地址，所在行各条目的地址、长度与机器码
+ *  - textDocument/publishDiagnostics：每次打开 / 修改后发布全部诊断
+ *
+ * 设计：
+ *  - 协议层与传输分离：lsp_handle_message 处理一条 JSON-RPC 消息，输出经回调写出；
+ *    lsp_run 负责 Content-Length 分帧
+ *  - 位置的 character 按 UTF-16 码元计算（协议默认编码）
+ *
+ * ============================================================================
+ */
+
+#ifndef __LSP_H__
+#define __LSP_H__
+
+#include <stdio.h>
+#include "utils.h"
+
+/* ========================================================================= */
+/* 常量定义 */
+/* ========================================================================= */
+
+#define LSP_CONTINUE        0       /* 继续处理后续消息 */
+#define LSP_EXIT            1       /* 收到 exit 通知 */
+#define LSP_MAX_MESSAGE     (64u * 1024 * 1024)    /* 单条消息的上限 */
+
+/* ========================================================================= */
+/* 数据结构定义 */
+/* ========================================================================= */
+
+/* 语言服务器（不透明类型） */
+typedef struct LspServer LspServer;
+
+/* 输出回调：message 为一条完整的 JSON-RPC 消息（不含分帧头） */
+typedef void (*LspWriteFunc)(void* user, const char* message, u32 len);
+
+/* ========================================================================= */
+/* API 函数声明 */
+/* ========================================================================= */
+
+/*
+ * lsp_create
+ *
+ * 功能：创建语言服务器，响应与通知经 write 写出
+ *
+ * 返回值：
+ *   - LspServer*: 服务器
+ *   - NULL: 内存不足
+ */
+LspServer* lsp_create(LspWriteFunc write, void* user);
+
+/*
+ * lsp_handle_message
+ *
+ * 功能：处理一条 JSON-RPC 消息
+ *
+ * 返回值：
+ *   - LSP_CONTINUE: 继续
+ *   - LSP_EXIT: 收到 exit 通知，调用者应结束
+ */
+int lsp_handle_message(LspServer* server, const char* message, u32 len);
+
+/*
+ * lsp_exit_code
+ *
+ * 功能：进程退出码（exit 之前收到过 shutdown 请求为 0，否则为 1）
+ */
+int lsp_exit_code(const LspServer* server);
+
+/*
+ * lsp_destroy
+ *
+ * 功能：关闭全部文档并销毁服务器
+ */
+void lsp_destroy(LspServer* server);
+
+/*
+ * lsp_run
+ *
+ * 功能：从 in 读取 Content-Length 分帧的消息并逐条处理，响应写到 out，
+ *       直到收到 exit 通知或输入结束
+ *
+ * 返回值：进程退出码（见 lsp_exit_code）
+ */
+int lsp_run(FILE* in, FILE* out);
+
+#endif /* __LSP_H__ */
@@ -0,0 +1,119 @@
+﻿/*
+ * ============================================================================
+ * 文件名: mapfile.h
+ * 描述  : 映像文件模块 - 生成链接器风格的 MAP 文件（-Map=FILE）
+ *
+ * 功能：
+ *  - 段表：每个段的起始地址、字节数与符号数，以及合计
+ *  - 符号表：按地址排序，列出所在段、地址、类型（label / variable / procedure）、
+ *    过程大小与定义行号
+ *
+ * 设计：
+ *  - 一次遍历第一遍扫描的指令列表：SEGMENT / ENDS 维护当前段并累计段内字节数，
+ *    带标签的条目取出符号表中的 SymbolInfo 追加到紧凑数组，PROC / ENDP 以栈
+ *    配对得到过程大小
+ *  - 之后对紧凑数组做一次稳定排序（地址相同时保持源代码顺序），不再反复扫描哈希表
+ *  - 地址与字节数都取第二遍扫描记录的实际偏移，段合计等于映像大小，与列表文件
+ *    和行号表一致（第一遍按估计长度分配的 address 会偏离机器码的位置）；
+ *    不在任何段中的字节与符号归入 "(none)"
+ *
+ * ============================================================================
+ */
+
+#ifndef __MAPFILE_H__
+#define __MAPFILE_H__
+
+#include "utils.h"
+#include "symtab.h"
+#include "semantic.h"
+
+/* ========================================================================= */
+/* 常量定义 */
+/* ========================================================================= */
+
+#define MAPFILE_NO_SEGMENT      "(none)"    /* 段外内容所归入的段名 */
+#define MAPFILE_MAX_PROC_DEPTH  32          /* PROC 嵌套的最大深度，更深的不计大小 */
+
+/* ========================================================================= */
+/* 数据结构定义 */
+/* ========================================================================= */
+
+/*
+ * 段统计
+ */
+typedef struct {
+    const char* name;           /* 段名（指向指令条目中的操作数名） */
+    u32 start;                  /* 第一次打开该段时的偏移 */
+    u32 size;                   /* 段内各条目机器码字节数之和（同名段多次打开时累加） */
+    u32 symbol_count;           /* 段内定义的符号数 */
+} MapSegment;
+
+/*
+ * 映像中的一个符号
+ */
+typedef struct {
+    const SymbolInfo* info;     /* 符号表中的符号 */
+    u32 address;                /* 定义所在条目的机器码在映像中的实际偏移 */
+    u32 segment;                /* 所在段在 segments 中的下标 */
+    u32 size;                   /* 过程大小（ENDP 偏移 - PROC 偏移），其余类型为 0 */
+} MapSymbol;
+
+/*
+ * 映像：段表与按地址排序的符号数组
+ */
+typedef struct {
+    MapSegment* segments;       /* 段表，下标 0 为 "(none)" */
+    u32 segment_count;          /* 段数 */
+    u32 segment_capacity;       /* 段表容量 */
+    MapSymbol* symbols;         /* 按偏移稳定排序的符号 */
+    u32 symbol_count;           /* 符号数 */
+} MapFile;
+
+/* ========================================================================= */
+/* API 函数声明 */
+/* ========================================================================= */
+
+/*
+ * mapfile_build
+ *
+ * 功能：由汇编结果建立映像
+ *
+ * 参数：
+ *   - pass_one: 第一遍扫描结果（须无错误；结果引用其中的字符串，须比映像存活更久）
+ *   - offsets: 各指令机器码的实际起始偏移（AsmOutput.instruction_offsets）；
+ *              段的起点与大小、符号与过程的位置都按它计算，而非第一遍估计的 address
+ *   - out: 输出映像
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: 内存不足
+ */
+int mapfile_build(const PassOne* pass_one, const u32* offsets, MapFile* out);
+
+/*
+ * mapfile_free
+ *
+ * 功能：释放 mapfile_build 分配的数组
+ */
+void mapfile_free(MapFile* map);
+
+/*
+ * mapfile_write
+ *
+ * 功能：建立映像并写出 MAP 文件
+ *
+ * 参数：
+ *   - pass_one: 第一遍扫描结果
+ *   - offsets: 各指令机器码的实际起始偏移（同 mapfile_build）
+ *   - title: 标题（通常为源文件名）
+ *   - image_size: 生成的机器码字节数（写在段表之后）
+ *   - path: MAP 文件路径
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: 内存不足或写入失败
+ */
+int mapfile_write(const PassOne* pass_one, const u32* offsets, const char* title, u32 image_size,
+                  const char* path);
+
+#endif /* __MAPFILE_H__ */
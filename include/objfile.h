@@ -0,0 +1,100 @@
+﻿/*
+ * ============================================================================
+ * 文件名: objfile.h
+ * 描述  : OBJ 文件模块 - 写出 OMF 格式的可重定位目标模块（--obj）
+ *
+ * 记录顺序：
+ *   THEADR | LNAMES | SEGDEF | EXTDEF* | PUBDEF* | (LEDATA FIXUPP?)* | MODEND
+ *
+ * 设计：
+ *  - 整个映像是一个公共代码段：段名取第一个 SEGMENT 声明的名字（没有时为 _TEXT），
+ *    类名 CODE；标签地址与 .COM 输出一样相对映像开头，即段内偏移
+ *  - EXTRN 声明的外部符号按名字顺序写成 EXTDEF，外部符号索引从 1 开始
+ *  - PUBLIC 列出的符号在源代码顺序下写成 PUBDEF；名字未定义或是外部符号时报告 E2005
+ *  - 映像按不超过 OBJFILE_MAX_DATA 字节分块写成 LEDATA，一个字不跨块；
+ *    块内的重定位紧随其后写成 FIXUPP：标签引用是段内偏移修正，段名引用是段基址修正，
+ *    外部符号引用以外部符号为目标。修正目标都不带位移，机器码中已有的字作为加数；
+ *    转移与调用指令（JMP / Jcc / LOOP / CALL）的位移字段写成自相对修正（M=0），
+ *    其余为段相对修正（M=1）
+ *  - END 指定入口时 MODEND 标记为主模块并带入口地址
+ *  - 先在内存中组装整个模块：产物可以原样存入构建缓存
+ *
+ * ============================================================================
+ */
+
+#ifndef __OBJFILE_H__
+#define __OBJFILE_H__
+
+#include "utils.h"
+#include "semantic.h"
+#include "codegen.h"
+
+/* ========================================================================= */
+/* 常量定义 */
+/* ========================================================================= */
+
+#define OBJFILE_MAX_DATA        1024        /* 每个 LEDATA 记录的最大数据字节数 */
+#define OBJFILE_MAX_RECORD      1024        /* EXTDEF / PUBDEF / FIXUPP 记录内容的上限 */
+#define OBJFILE_DEFAULT_SEGMENT "_TEXT"     /* 没有 SEGMENT 声明时的段名 */
+#define OBJFILE_CLASS_NAME      "CODE"      /* 段的类名 */
+
+/* OMF 记录类型 */
+#define OMF_THEADR              0x80
+#define OMF_EXTDEF              0x8C
+#define OMF_PUBDEF              0x90
+#define OMF_LNAMES              0x96
+#define OMF_SEGDEF              0x98
+#define OMF_FIXUPP              0x9C
+#define OMF_LEDATA              0xA0
+#define OMF_MODEND              0x8A
+
+/* ========================================================================= */
+/* 数据结构定义 */
+/* ========================================================================= */
+
+/*
+ * 待写出的目标模块
+ */
+typedef struct {
+    const char* source;         /* 源文件路径：THEADR 取其去掉目录与扩展名的文件名 */
+    const PassOne* pass_one;    /* 符号表与 SEGMENT / PUBLIC / END 声明 */
+    const u8* code;             /* 映像（机器码） */
+    u32 size;                   /* 映像字节数 */
+    const u32* offsets;         /* 各指令机器码的实际起始偏移（AsmOutput.instruction_offsets）；
+                                 * PUBDEF 与 MODEND 的标签偏移按它取，而非第一遍估计的 address */
+    const Relocation* relocations;  /* 已解决的重定位（按代码顺序） */
+    u32 relocation_count;       /* 重定位数 */
+} ObjModule;
+
+/* ========================================================================= */
+/* API 函数声明 */
+/* ========================================================================= */
+
+/*
+ * objfile_build
+ *
+ * 功能：在内存中组装 OMF 目标模块
+ *
+ * 参数：
+ *   - module: 待写出的模块
+ *   - out_data: 输出参数，模块内容（调用者以 util_free 释放）
+ *   - out_size: 输出参数，模块字节数
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: PUBLIC 名字无效（已报告）、映像超出 64KB 或内存不足
+ */
+int objfile_build(const ObjModule* module, u8** out_data, u32* out_size);
+
+/*
+ * objfile_write
+ *
+ * 功能：组装并写出 OBJ 文件
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: 组装或写入失败（不完整的文件被删除）
+ */
+int objfile_write(const char* path, const ObjModule* module);
+
+#endif /* __OBJFILE_H__ */
@@ -0,0 +1,96 @@
+﻿/*
+ * ============================================================================
+ * 文件名: pipeline.h
+ * 描述  : 流水线汇编模块 - 单文件多线程流水线
+ *
+ * 功能：
+ *  - 词法分析、第一遍扫描、代码生成三个阶段在不同线程上重叠执行
+ *  - 阶段之间通过 SPSC 无锁队列传递按行对齐的批次
+ *  - 标签引用全部留给最后的重定位步骤统一修补
+ *
+ * 设计：
+ *  - 词法线程：把 Token 按行切成批次（TokenBatch）送入队列
+ *  - 扫描线程：semantic_pass_one_feed 处理每个批次，产出指令批次（IrBatch）
+ *  - 编码线程：指令地址在第一遍扫描中即确定，收到批次立即生成机器码
+ *  - 各阶段诊断先捕获，结束后按串行执行的顺序回放，输出与串行模式一致
+ *
+ * ============================================================================
+ */
+
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include "utils.h"
+#include "error.h"
+#include "lexer.h"
+#include "semantic.h"
+#include "codegen.h"
+
+/* ========================================================================= */
+/* 常量定义 */
+/* ========================================================================= */
+
+#define PIPELINE_TOKEN_BATCH    1024    /* 每个 Token 批次的最少 Token 数（在行尾切分） */
+#define PIPELINE_QUEUE_DEPTH    64      /* 阶段间队列深度（批次数） */
+
+/* ========================================================================= */
+/* 数据结构定义 */
+/* ========================================================================= */
+
+/*
+ * 流水线汇编结果
+ */
+typedef struct {
+    PassOne* pass_one;          /* 第一遍扫描结果 */
+    CodeGen* codegen;           /* 代码生成结果（重定位已解决） */
+    u32 token_count;            /* 词法分析产生的 Token 总数 */
+} PipelineResult;
+
+/* ========================================================================= */
+/* API 函数声明 */
+/* ========================================================================= */
+
+/*
+ * pipeline_assemble
+ *
+ * 功能：以三阶段流水线汇编一个源文件
+ *
+ * 参数：
+ *   - source: 源文本（不要求以 '\0' 结尾）
+ *   - len: 源文本字节数
+ *   - lines: 行首偏移索引，由词法阶段顺带填充（可为 NULL_PTR）
+ *   - out: 输出参数，成功时填充汇编结果
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: 发生错误（诊断已通过 error_report 报告）
+ *
+ * 描述：
+ *   无法创建工作线程时退化为串行执行，结果相同。
+ */
+int pipeline_assemble(const char* source, u32 len, LineIndex* lines, PipelineResult* out);
+
+/*
+ * pipeline_assemble_lexer
+ *
+ * 功能：同 pipeline_assemble，但从调用者创建的词法器读取源文本
+ *
+ * 参数：
+ *   - lexer: 词法器（整块或流式输入，所有权转交本函数）
+ *   - lines: 行首偏移索引（可为 NULL_PTR）
+ *   - out: 输出参数，成功时填充汇编结果
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: 发生错误
+ */
+int pipeline_assemble_lexer(Lexer* lexer, LineIndex* lines, PipelineResult* out);
+
+/*
+ * pipeline_result_destroy
+ *
+ * 功能：释放流水线汇编结果
+ */
+void pipeline_result_destroy(PipelineResult* result);
+
+#endif /* __PIPELINE_H__ */
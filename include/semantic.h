@@ -33,6 +33,7 @@
 #define SEMANTIC_MAX_OPERANDS    32
 #define SEMANTIC_MAX_INSTRUCTION_LEN  15
 #define SEMANTIC_CODE_SECTION_SIZE    0x10000
+#define SEMANTIC_PARALLEL_MIN_CHUNK_TOKENS  4096   /* 并行扫描时每块最少 Token 数 */
 
 /* ========================================================================= */
 /* 数据结构定义 */
@@ -71,6 +72,7 @@ typedef struct {
     u32 operand_count;          /* 实际操作数数量 */
     u32 has_label;              /* 是否具有标签前缀 */
     s8 label[128];              /* 标签名 */
+    u32 has_error;              /* 该行解析失败：错误占位条目，长度为 0，不生成代码 */
 } InstructionEntry;
 
 /*
@@ -101,14 +103,67 @@ typedef struct {
  *
  * 返回值：
  *   - PassOne* : 第一遍扫描上下文，包含符号表和指令列表
- *   - NULL: 发生错误
+ *   - NULL: 内存不足
  *
  * 描述：
  *   遍历 Token 流，识别指令和伪指令，建立符号表，
  *   计算每条指令的地址和长度。
+ *   某行无法解析时报告错误、在该行写入错误占位条目（保留行首标签的定义，
+ *   避免引用它的指令连带报告未定义），并跳到下一行继续扫描；
+ *   扫描总是进行到底，结果中 has_errors 置位，由调用者决定是否放弃。
  */
 PassOne* semantic_pass_one(const Token* tokens, u32 token_count);
 
+/*
+ * semantic_pass_one_begin
+ *
+ * 功能：创建一个空的第一遍扫描上下文，用于分批增量扫描
+ *
+ * 返回值：
+ *   - PassOne* : 空上下文（地址 0，行号 1）
+ *   - NULL: 内存不足
+ */
+PassOne* semantic_pass_one_begin(void);
+
+/*
+ * semantic_pass_one_feed
+ *
+ * 功能：扫描一批 Token，把解析出的指令追加到上下文
+ *
+ * 参数：
+ *   - pass_one: semantic_pass_one_begin 创建的上下文
+ *   - tokens: Token 批次，必须在行边界结束（末尾为 TOK_NEWLINE 或 TOK_EOF）
+ *   - token_count: 批次中的 Token 数
+ *
+ * 描述：
+ *   地址与行号从上一批结束处继续累加。错误照常通过 error_report 报告，
+ *   并置位 pass_one->has_errors，由调用者决定是否放弃结果。
+ */
+void semantic_pass_one_feed(PassOne* pass_one, const Token* tokens, u32 token_count);
+
+/*
+ * semantic_pass_one_parallel
+ *
+ * 功能：分块并行执行第一遍扫描
+ *
+ * 参数：
+ *   - tokens: Token 数组
+ *   - token_count: Token 总数
+ *   - thread_count: 工作线程数（0 表示使用全部处理器核心）
+ *
+ * 返回值：
+ *   - PassOne* : 与 semantic_pass_one 结果一致的第一遍扫描上下文
+ *   - NULL: 内存不足
+ *
+ * 描述：
+ *   按行边界把 Token 流切分为若干块，各线程以块内相对地址
+ *   扫描并建立局部符号表；随后对各块的代码长度和行数做前缀和，
+ *   重定位地址与行号，并按源代码顺序合并局部符号表。
+ *   重复标签等诊断按源代码顺序报告，行号与串行扫描一致。
+ *   Token 数较少时直接退化为 semantic_pass_one。
+ */
+PassOne* semantic_pass_one_parallel(const Token* tokens, u32 token_count, u32 thread_count);
+
 /*
  * semantic_analyze_instruction
  *
@@ -126,7 +181,8 @@ PassOne* semantic_pass_one(const Token* tokens, u32 token_count);
  *
  * 描述：
  *   从指定 Token 位置开始，解析一条指令或伪指令，
- *   填充 out_entry 结构。
+ *   填充 out_entry 结构。解析在 TOK_NEWLINE/TOK_EOF 处停止，
+ *   因此 Token 数组必须以 TOK_EOF 结尾。
  */
 int semantic_analyze_instruction(
     PassOne* pass_one,
@@ -158,6 +214,21 @@ u32 semantic_get_instruction_length(
     u32 operand_count
 );
 
+/*
+ * semantic_label_type
+ *
+ * 功能：按标签所在行的助记符确定其符号类型
+ *
+ * 参数：
+ *   - entry: 带标签的指令条目
+ *
+ * 返回值：
+ *   - SYM_PROCEDURE: "name PROC"
+ *   - SYM_VARIABLE : 标签所在行为 DB 数据定义（"name DB ..." 或 "name: DB ..."）
+ *   - SYM_LABEL    : 其余（"name:" 后跟指令或空行）
+ */
+SymbolType semantic_label_type(const InstructionEntry* entry);
+
 /*
  * semantic_validate_operand
  *
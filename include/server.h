@@ -0,0 +1,135 @@
+﻿/*
+ * ============================================================================
+ * 文件名: server.h
+ * 描述  : 汇编服务模块 - 常驻进程经 Unix 域套接字接受汇编请求
+ *
+ * 功能：
+ *  - 服务端（subas --server SOCKET）：多个工作线程各持一个常驻的 AsmContext，
+ *    并发处理请求，Token 缓冲区等随上下文跨请求复用
+ *  - 客户端（subas --connect SOCKET ...）：把源文本发给服务端，取回机器码、
+ *    错误数与诊断文本，命令行的输出文件、诊断格式与退出码保持不变
+ *
+ * 协议（同一台机器上的进程之间，字段按本机字节序）：
+ *  - 请求：ServerRequestHeader + payload_size 字节的载荷（源文本或源文件路径）
+ *  - 应答：ServerResponseHeader + code_size 字节机器码 + diagnostics_size 字节诊断文本
+ *  - 一个连接上可以依次发送多个请求；服务端在对端关闭连接后结束该连接
+ *
+ * 设计：
+ *  - 各工作线程直接在同一个监听套接字上 accept，无需额外的分发队列
+ *  - 诊断经 subas_set_diagnostic_sink 收集，文本与命令行写到 stderr 的完全相同
+ *  - 关闭请求使服务端停止 accept、等待处理中的请求完成后删除套接字文件
+ *
+ * ============================================================================
+ */
+
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include "utils.h"
+#include "subas.h"
+
+/* ========================================================================= */
+/* 常量定义 */
+/* ========================================================================= */
+
+#define SERVER_REQUEST_MAGIC    0x51524253u     /* "SBRQ" */
+#define SERVER_RESPONSE_MAGIC   0x53524253u     /* "SBRS" */
+#define SERVER_PROTOCOL_VERSION 1
+#define SERVER_MAX_PAYLOAD      (256u * 1024 * 1024)   /* 单个请求载荷的上限 */
+#define SERVER_LISTEN_BACKLOG   128
+
+/* ========================================================================= */
+/* 数据结构定义 */
+/* ========================================================================= */
+
+/* 请求类型 */
+typedef enum {
+    SERVER_REQ_ASSEMBLE = 1,    /* 载荷为源文本 */
+    SERVER_REQ_ASSEMBLE_PATH,   /* 载荷为源文件路径（由服务端读取） */
+    SERVER_REQ_SHUTDOWN         /* 关闭服务端（无载荷） */
+} ServerRequestKind;
+
+/* 请求头 */
+typedef struct {
+    u32 magic;                  /* SERVER_REQUEST_MAGIC */
+    u32 version;                /* SERVER_PROTOCOL_VERSION */
+    u32 kind;                   /* ServerRequestKind */
+    u32 max_errors;             /* 诊断上限（0 表示不限） */
+    u32 payload_size;           /* 载荷字节数 */
+} ServerRequestHeader;
+
+/* 应答头 */
+typedef struct {
+    u32 magic;                  /* SERVER_RESPONSE_MAGIC */
+    u32 version;                /* SERVER_PROTOCOL_VERSION */
+    s32 status;                 /* 0 成功，-1 失败 */
+    u32 error_count;            /* 错误总数（含被去重与超限的诊断） */
+    u32 code_size;              /* 机器码字节数 */
+    u32 diagnostics_size;       /* 诊断文本字节数 */
+} ServerResponseHeader;
+
+/* 客户端收到的应答 */
+typedef struct {
+    int status;                 /* 0 成功，-1 失败 */
+    u32 error_count;            /* 错误总数 */
+    u8* code;                   /* 机器码（失败时为 NULL_PTR） */
+    u32 code_size;
+    char* diagnostics;          /* 诊断文本（不以 '\0' 结尾，可为 NULL_PTR） */
+    u32 diagnostics_size;
+} ServerReply;
+
+/* ========================================================================= */
+/* API 函数声明 */
+/* ========================================================================= */
+
+/*
+ * server_run
+ *
+ * 功能：在 socket_path 上监听并处理请求，直到收到关闭请求
+ *
+ * 参数：
+ *   - socket_path: 套接字文件路径（残留的失效套接字文件会被替换）
+ *   - workers: 工作线程数（0 表示全部核心）
+ *   - options: 汇编选项（progress 被忽略；max_errors 由每个请求给出）
+ *
+ * 返回值：
+ *   - 0: 正常关闭
+ *   - -1: 无法监听（路径过长、已有服务端在运行等），原因已打印
+ */
+int server_run(const char* socket_path, u32 workers, const AsmOptions* options);
+
+/*
+ * server_assemble
+ *
+ * 功能：请求服务端汇编
+ *
+ * 参数：
+ *   - kind: SERVER_REQ_ASSEMBLE（payload 为源文本）或 SERVER_REQ_ASSEMBLE_PATH（payload 为路径）
+ *   - reply: 输出参数，成功时由调用者以 server_reply_dispose 释放
+ *
+ * 返回值：
+ *   - 0: 收到应答（汇编是否成功见 reply->status）
+ *   - -1: 无法连接服务端或通信失败（调用者可退回本地汇编）
+ */
+int server_assemble(const char* socket_path, ServerRequestKind kind, const char* payload,
+                    u32 payload_size, u32 max_errors, ServerReply* reply);
+
+/*
+ * server_shutdown
+ *
+ * 功能：请求服务端关闭
+ *
+ * 返回值：
+ *   - 0: 服务端已确认
+ *   - -1: 无法连接服务端
+ */
+int server_shutdown(const char* socket_path);
+
+/*
+ * server_reply_dispose
+ *
+ * 功能：释放应答中的缓冲区
+ */
+void server_reply_dispose(ServerReply* reply);
+
+#endif /* __SERVER_H__ */
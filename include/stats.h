@@ -0,0 +1,144 @@
+﻿/*
+ * ============================================================================
+ * 文件名: stats.h
+ * 描述  : 统计模块 - 各阶段耗时、吞吐量与跟踪输出
+ *
+ * 功能：
+ *  - 以单调时钟纳秒计时每个阶段（读取、表初始化、词法、Pass 1、Pass 2、写出）
+ *  - 记录各阶段处理的 Token / 指令 / 字节数，用于计算吞吐量
+ *  - 以 JSON 输出统计结果（--stats=json），便于跨版本追踪性能回退
+ *  - 以 Chrome trace-event 格式输出各阶段时间线（--trace FILE）
+ *  - 开启分配记账时记录各阶段把内存峰值推高了多少，找出决定峰值的阶段
+ *
+ * 设计：
+ *  - AsmStats 为普通值类型，每次汇编一份；批量模式用 stats_merge 汇总
+ *  - 记录阶段开始时刻与执行线程，跟踪文件中每个线程一条时间线
+ *
+ * ============================================================================
+ */
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdio.h>
+#include "utils.h"
+
+/* ========================================================================= */
+/* 数据结构定义 */
+/* ========================================================================= */
+
+/*
+ * 汇编阶段
+ */
+typedef enum {
+    STATS_PHASE_READ = 0,       /* 读取源文件 */
+    STATS_PHASE_TABLES,         /* 表初始化 */
+    STATS_PHASE_LEX,            /* 词法分析 */
+    STATS_PHASE_PASS_ONE,       /* 第一遍扫描 */
+    STATS_PHASE_PASS_TWO,       /* 第二遍扫描（代码生成） */
+    STATS_PHASE_PIPELINE,       /* 流水线模式下重叠执行的词法 + 两遍扫描 */
+    STATS_PHASE_WRITE,          /* 写出输出文件 */
+    STATS_PHASE_COUNT
+} StatsPhase;
+
+/*
+ * 一次（或汇总后多次）汇编的统计
+ */
+typedef struct {
+    u64 start_ns[STATS_PHASE_COUNT];    /* 阶段开始时刻（0 表示未执行） */
+    u64 elapsed_ns[STATS_PHASE_COUNT];  /* 阶段累计耗时 */
+    u32 thread_id[STATS_PHASE_COUNT];   /* 执行该阶段的线程编号 */
+    u64 peak_base[STATS_PHASE_COUNT];   /* 阶段开始时的内存峰值 */
+    u64 peak_growth[STATS_PHASE_COUNT]; /* 阶段内内存峰值的增量（字节） */
+    u32 files;                          /* 汇编的文件数 */
+    u64 source_bytes;                   /* 源文本字节数 */
+    u64 tokens;                         /* Token 数 */
+    u64 instructions;                   /* 指令数 */
+    u64 symbols;                        /* 符号数 */
+    u64 code_bytes;                     /* 生成的机器码字节数 */
+    u64 relocations;                    /* 重定位记录数 */
+} AsmStats;
+
+/* Chrome 跟踪文件写入器（不透明类型） */
+typedef struct TraceFile TraceFile;
+
+/* ========================================================================= */
+/* API 函数声明 */
+/* ========================================================================= */
+
+/*
+ * stats_init
+ *
+ * 功能：清零统计
+ */
+void stats_init(AsmStats* stats);
+
+/*
+ * stats_phase_begin / stats_phase_end
+ *
+ * 功能：记录阶段开始 / 结束，耗时累加到 elapsed_ns，
+ *       阶段内 util_malloc 峰值的增量累加到 peak_growth
+ */
+void stats_phase_begin(AsmStats* stats, StatsPhase phase);
+void stats_phase_end(AsmStats* stats, StatsPhase phase);
+
+/*
+ * stats_merge
+ *
+ * 功能：把 from 的耗时与计数累加到 into（开始时刻取较早者）
+ */
+void stats_merge(AsmStats* into, const AsmStats* from);
+
+/*
+ * stats_phase_name
+ *
+ * 功能：返回阶段名称（用于文本、JSON 与跟踪输出）
+ */
+const char* stats_phase_name(StatsPhase phase);
+
+/*
+ * stats_phase_items
+ *
+ * 功能：返回阶段处理的条目数及其单位，用于计算吞吐量
+ *       （读取 / 写出为字节，词法为 Token，Pass 1 为指令，Pass 2 为机器码字节）
+ */
+u64 stats_phase_items(const AsmStats* stats, StatsPhase phase, const char** out_unit);
+
+/*
+ * stats_write_json
+ *
+ * 功能：以单行 JSON 对象输出统计结果（开启分配记账时附带 "memory" 对象，
+ *       以 SUBAS_COUNTERS 编译时附带 "counters" 对象）
+ */
+void stats_write_json(FILE* fp, const AsmStats* stats);
+
+/*
+ * trace_open
+ *
+ * 功能：创建 Chrome trace-event 文件（chrome://tracing 或 Perfetto 可打开）
+ *
+ * 返回值：
+ *   - TraceFile* : 写入器
+ *   - NULL: 无法创建文件
+ */
+TraceFile* trace_open(const char* path);
+
+/*
+ * trace_add
+ *
+ * 功能：把一次汇编的各阶段写为完整事件（ph = "X"），label 作为事件参数
+ */
+void trace_add(TraceFile* trace, const AsmStats* stats, const char* label);
+
+/*
+ * trace_close
+ *
+ * 功能：结束事件数组并关闭文件
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: 写入失败
+ */
+int trace_close(TraceFile* trace);
+
+#endif /* __STATS_H__ */
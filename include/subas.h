@@ -0,0 +1,273 @@
+﻿/*
+ * ============================================================================
+ * 文件名: subas.h
+ * 描述  : SUBAS 汇编器库接口 (libsubas)
+ *
+ * 功能：
+ *  - 以可重入的方式在进程内汇编源文本，无需 fork/exec 子进程
+ *  - 每个 AsmContext 拥有独立的诊断、选项、缓冲区与汇编结果
+ *  - 不同线程可同时使用各自的 AsmContext 并发汇编
+ *
+ * 设计：
+ *  - AsmOptions: 汇编选项（线程数、流水线模式、进度输出等）
+ *  - AsmContext: 汇编上下文，跨多次汇编复用其 Token 缓冲区
+ *  - subas_assemble: 依次执行 词法 → Pass 1 → Pass 2
+ *  - subas_assemble_ir: 映射 IR 文件（序列化的 Pass 1 结果）后直接执行 Pass 2
+ *  - subas_assemble_ir_data: 同上，IR 内容已在内存中
+ *  - 指令表为只读常量表，所有上下文共享
+ *
+ * ============================================================================
+ */
+
+#ifndef __SUBAS_H__
+#define __SUBAS_H__
+
+#include "utils.h"
+#include "error.h"
+#include "lexer.h"
+#include "semantic.h"
+#include "codegen.h"
+#include "stats.h"
+#include "irfile.h"
+
+/* ========================================================================= */
+/* 常量定义 */
+/* ========================================================================= */
+
+#define SUBAS_VERSION           "0.1.0"
+#define SUBAS_INITIAL_TOKENS    4096    /* Token 缓冲区初始容量（不足时扩容） */
+#define SUBAS_STREAM_BATCH      1024    /* 流式输入每批交给第一遍扫描的最少 Token 数（在行尾切分） */
+
+/* ========================================================================= */
+/* 数据结构定义 */
+/* ========================================================================= */
+
+/*
+ * 输出格式
+ */
+typedef enum {
+    SUBAS_FORMAT_COM = 0,       /* 平坦 .COM 映像：不允许段名引用 */
+    SUBAS_FORMAT_EXE = 1,       /* MZ .EXE：段名引用成为段基址修正（AsmOutput.segment_fixups） */
+    SUBAS_FORMAT_OBJ = 2        /* OMF .OBJ：另允许 EXTRN 符号引用，全部重定位交给链接器 */
+} AsmFormat;
+
+/*
+ * 汇编选项
+ */
+typedef struct {
+    u32 pass_one_threads;       /* 第一遍扫描线程数（1 为串行，0 为全部核心） */
+    int pipeline;               /* 非 0 时以流水线模式汇编 */
+    int progress;               /* 非 0 时向 stdout 打印各步骤进度（命令行使用） */
+    int verbose;                /* 非 0 时打印额外的中间信息（需 progress） */
+    int echo_diagnostics;       /* 非 0 时诊断同时输出到 stderr（汇编结束时一次性写出） */
+    u32 max_errors;             /* 保存/输出的诊断上限（0 表示不限） */
+    CodeGenListener listener;   /* 第二遍扫描逐条指令回调，如 listing_instruction（NULL 表示无）；
+                                 * 设置后流水线模式退回串行执行 */
+    void* listener_user;        /* 传给 listener 的用户数据 */
+    AsmFormat format;           /* 输出格式（默认 SUBAS_FORMAT_COM） */
+} AsmOptions;
+
+/*
+ * 汇编上下文
+ */
+typedef struct {
+    AsmOptions options;         /* 汇编选项 */
+    ErrorContext diagnostics;   /* 本上下文的诊断（计数与记录） */
+    Token* tokens;              /* Token 缓冲区（跨多次汇编复用） */
+    u32 token_capacity;         /* Token 缓冲区容量 */
+    u32 token_count;            /* 最近一次汇编的 Token 数 */
+    PassOne* pass_one;          /* 最近一次汇编的第一遍扫描结果 */
+    CodeGen* codegen;           /* 最近一次汇编的代码生成结果 */
+    AsmStats stats;             /* 最近一次汇编的各阶段耗时与计数 */
+    LineIndex lines;            /* 最近一次汇编的行首偏移索引（诊断源代码片段） */
+} AsmContext;
+
+/*
+ * 汇编输出（缓冲区归 AsmContext 所有，下次汇编或销毁上下文时失效）
+ */
+typedef struct {
+    const u8* code;             /* 机器码 */
+    u32 size;                   /* 机器码字节数 */
+    const u32* segment_fixups;  /* 段基址字在 code 中的偏移（COM 格式下恒为空） */
+    u32 segment_fixup_count;    /* 段基址修正数 */
+    const Relocation* relocations;  /* 已解决的全部重定位（按代码顺序，OBJ 输出写成 FIXUPP） */
+    u32 relocation_count;       /* 重定位数 */
+    const u32* instruction_offsets; /* 各指令机器码在 code 中的实际起始偏移（指令数 + 1 项，
+                                     * 见 codegen_get_instruction_offsets） */
+} AsmOutput;
+
+/* ========================================================================= */
+/* API 函数声明 */
+/* ========================================================================= */
+
+/*
+ * subas_options_init
+ *
+ * 功能：以默认值填充汇编选项（串行、无进度输出、诊断仅记录）
+ */
+void subas_options_init(AsmOptions* options);
+
+/*
+ * subas_context_create
+ *
+ * 功能：创建汇编上下文
+ *
+ * 参数：
+ *   - options: 汇编选项（NULL 表示使用默认值）
+ *
+ * 返回值：
+ *   - AsmContext* : 上下文
+ *   - NULL: 内存不足
+ */
+AsmContext* subas_context_create(const AsmOptions* options);
+
+/*
+ * subas_assemble
+ *
+ * 功能：汇编一段源文本
+ *
+ * 参数：
+ *   - ctx: 汇编上下文
+ *   - src: 源文本（不要求以 '\0' 结尾）
+ *   - len: 源文本字节数
+ *   - out: 输出参数，成功时填充机器码
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: 失败（诊断见 subas_get_diagnostics）
+ *
+ * 描述：
+ *   执行期间当前线程绑定到 ctx 的诊断上下文，结束后恢复原绑定，
+ *   因此多个线程可以同时对各自的上下文调用本函数。
+ *   上一次汇编的结果在本次开始时被释放。
+ */
+int subas_assemble(AsmContext* ctx, const char* src, u32 len, AsmOutput* out);
+
+/*
+ * subas_assemble_stream
+ *
+ * 功能：汇编经回调流式读入的源文本
+ *
+ * 参数：
+ *   - ctx: 汇编上下文
+ *   - read: 读取回调，返回 0 表示输入结束（见 LexerReadFunc）
+ *   - user: 传给回调的用户数据
+ *   - out: 输出参数，成功时填充机器码
+ *
+ * 返回值：同 subas_assemble
+ *
+ * 描述：
+ *   词法器只保留固定大小的输入窗口，源文本不会整体驻留内存，
+ *   因此没有源文件大小上限；诊断不附源代码片段。
+ *   串行第一遍扫描（pass_one_threads 为 1）且不用流水线时，Token 在行尾按
+ *   SUBAS_STREAM_BATCH 分批交给第一遍扫描后即释放；第一遍扫描结果与机器码
+ *   仍随指令数增长。
+ */
+int subas_assemble_stream(AsmContext* ctx, LexerReadFunc read, void* user, AsmOutput* out);
+
+/*
+ * subas_assemble_ir
+ *
+ * 功能：跳过词法与第一遍扫描，由 IR 文件直接生成机器码
+ *
+ * 参数：
+ *   - ctx: 汇编上下文
+ *   - path: irfile_write 写出的 IR 文件
+ *   - out: 输出参数，成功时填充机器码
+ *
+ * 返回值：
+ *   - 0: 成功
+ *   - -1: 失败（诊断见 subas_get_diagnostics）
+ *   - 1: IR 文件不存在、版本不符或已损坏（不报告诊断，调用者可回退到 subas_assemble）
+ *
+ * 描述：
+ *   IR 文件以一次 mmap 映射，解码出第一遍扫描结果后即解除映射。
+ */
+int subas_assemble_ir(AsmContext* ctx, const char* path, AsmOutput* out);
+
+/*
+ * subas_assemble_ir_data
+ *
+ * 功能：同 subas_assemble_ir，IR 内容已在内存中（如 cache_load 读出的缓存条目）
+ *
+ * 参数：
+ *   - data: IR 内容（8 字节对齐，调用期间有效）
+ *   - size: 字节数
+ *
+ * 返回值：同 subas_assemble_ir（1 表示内容格式不符或已损坏）
+ */
+int subas_assemble_ir_data(AsmContext* ctx, const u8* data, u32 size, AsmOutput* out);
+
+/*
+ * subas_get_pass_one
+ *
+ * 功能：获取最近一次成功汇编的第一遍扫描结果（可交给 irfile_serialize 保存）
+ *
+ * 返回值：
+ *   - PassOne* : 归 ctx 所有，下次汇编或销毁上下文时失效
+ *   - NULL: 最近一次汇编失败
+ */
+const PassOne* subas_get_pass_one(const AsmContext* ctx);
+
+/*
+ * subas_get_error_count
+ *
+ * 功能：获取最近一次汇编报告的错误数
+ */
+u32 subas_get_error_count(const AsmContext* ctx);
+
+/*
+ * subas_get_diagnostics
+ *
+ * 功能：获取最近一次汇编的诊断记录
+ *
+ * 参数：
+ *   - ctx: 汇编上下文
+ *   - out_count: 输出参数，返回记录数
+ *
+ * 返回值：
+ *   - ErrorRecord* : 诊断记录数组（归 ctx 所有）
+ */
+const ErrorRecord* subas_get_diagnostics(const AsmContext* ctx, u32* out_count);
+
+/*
+ * subas_get_stats
+ *
+ * 功能：获取最近一次汇编的统计（表初始化、词法、两遍扫描的耗时与计数）
+ */
+const AsmStats* subas_get_stats(const AsmContext* ctx);
+
+/*
+ * subas_take_diagnostics
+ *
+ * 功能：取走最近一次汇编的诊断记录
+ *
+ * 参数：
+ *   - ctx: 汇编上下文
+ *   - out: 输出参数，接收诊断记录（由调用者以 error_buffer_dispose 释放）
+ *
+ * 描述：
+ *   记录的所有权转移给调用者，上下文的诊断记录随之清空，
+ *   便于批量模式在复用同一上下文的同时保留每个文件的诊断。
+ */
+void subas_take_diagnostics(AsmContext* ctx, ErrorBuffer* out);
+
+/*
+ * subas_set_diagnostic_sink
+ *
+ * 功能：把本上下文输出的诊断（echo_diagnostics 为真时）交给 sink，而不是写 stderr
+ *
+ * 描述：
+ *   每次汇编结束时 sink 至多被调用一次，收到的文本与命令行输出到 stderr 的完全相同
+ *   （含源代码片段与去重 / 超限摘要）；sink 为 NULL_PTR 时恢复输出到 stderr。
+ */
+void subas_set_diagnostic_sink(AsmContext* ctx, ErrorSink sink, void* user);
+
+/*
+ * subas_context_destroy
+ *
+ * 功能：销毁汇编上下文及其持有的全部结果
+ */
+void subas_context_destroy(AsmContext* ctx);
+
+#endif /* __SUBAS_H__ */
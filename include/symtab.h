@@ -8,6 +8,8 @@
  *  - 记录符号的地址、类型、定义行号等属性
  *  - 支持两遍扫描：Pass 1 建立完整符号表，Pass 2 解决前向引用
  *  - 便于后续报告"未定义符号"等错误
+ *  - 维护两个随插入增量更新的辅助索引：按名字有序的基数树（前缀查询、
+ *    有序遍历）与按地址排序的数组（地址 → 最近符号的 O(log n) 反查）
  *
  * 符号表结构：
  *  - 标签（Label）：普通标签，指向某个地址
@@ -27,7 +29,8 @@
 typedef enum {
     SYM_LABEL = 0,
     SYM_VARIABLE = 1,
-    SYM_PROCEDURE = 2
+    SYM_PROCEDURE = 2,
+    SYM_EXTERNAL = 3            /* EXTRN 声明：地址由链接器填入 */
 } SymbolType;
 
 /*
@@ -46,6 +49,9 @@ typedef struct {
  * 符号表结构体
  * ============================================================================ */
 
+/* 基数树节点：实现细节仅在 symtab.c 中可见 */
+struct SymbolRadixNode;
+
 /*
  * 前向声明：符号表的实现细节对外部隐藏
  * 外部仅通过 SymbolTable* 指针操作符号表
@@ -54,8 +60,17 @@ typedef struct SymbolTable {
     UtilHashTable* symbols;     /* 哈希表：key = 符号名，value = SymbolInfo* */
     u32 total_symbols;          /* 符号总数 */
     u32 next_address;           /* 下一个可用地址（用于自动分配） */
+    struct SymbolRadixNode* name_index;  /* 按名字有序的路径压缩基数树 */
+    SymbolInfo** by_address;    /* 按地址非降序排列的符号数组 */
+    u32 address_count;          /* by_address 中的符号数 */
+    u32 address_capacity;       /* by_address 的容量 */
 } SymbolTable;
 
+/*
+ * 符号遍历回调：返回非零值时提前结束遍历
+ */
+typedef int (*SymbolVisitFunc)(void* user, const SymbolInfo* info);
+
 /* ============================================================================
  * 公共接口函数
  * ============================================================================ */
@@ -87,6 +102,24 @@ void symtab_destroy(SymbolTable* symtab);
  */
 int symtab_insert(SymbolTable* symtab, const char* name, SymbolType type, u32 address, u32 line);
 
+/*
+ * 函数: symtab_adopt
+ * 描述: 将一个已分配好的符号信息移交给符号表（用于合并局部符号表）
+ * 参数: symtab - 目标符号表
+ *       info   - 符号信息（成功后所有权归 symtab）
+ * 返回: 成功返回 0，表中已存在同名符号返回 1（所有权不转移），失败返回 -1
+ */
+int symtab_adopt(SymbolTable* symtab, SymbolInfo* info);
+
+/*
+ * 函数: symtab_remove
+ * 描述: 删除符号并释放其 SymbolInfo（用于增量汇编撤销被编辑行的标签定义）
+ * 参数: symtab - 符号表指针
+ *       name   - 符号名
+ * 返回: 成功返回 0，符号不存在返回 -1
+ */
+int symtab_remove(SymbolTable* symtab, const char* name);
+
 /*
  * 函数: symtab_lookup
  * 描述: 查找符号
@@ -98,11 +131,18 @@ SymbolInfo* symtab_lookup(SymbolTable* symtab, const char* name);
 
 /*
  * 函数: symtab_update_address
- * 描述: 更新符号的地址（用于前向引用解决）
+ * 描述: 更新符号的地址（用于前向引用解决），同时调整其在地址索引中的位置
  * 返回: 成功返回 0，符号不存在返回 -1
  */
 int symtab_update_address(SymbolTable* symtab, const char* name, u32 new_address);
 
+/*
+ * 函数: symtab_reindex_addresses
+ * 描述: 直接改写多个符号的 address 之后恢复地址索引的顺序；
+ *       同地址的符号保持原有的相对顺序
+ */
+void symtab_reindex_addresses(SymbolTable* symtab);
+
 /*
  * 函数: symtab_mark_defined
  * 描述: 标记符号为已定义（区分声明和定义）
@@ -116,6 +156,32 @@ int symtab_mark_defined(SymbolTable* symtab, const char* name);
  */
 u32 symtab_get_symbol_count(SymbolTable* symtab);
 
+/*
+ * 函数: symtab_iterate_prefix
+ * 描述: 按名字的字节序遍历以 prefix 开头的全部符号
+ * 参数: symtab - 符号表指针
+ *       prefix - 名字前缀（空串表示遍历全部符号）
+ *       visit  - 回调，返回非零值时停止遍历
+ *       user   - 传给回调的用户数据
+ * 返回: 已访问的符号数（含令遍历停止的那一个）
+ */
+u32 symtab_iterate_prefix(SymbolTable* symtab, const char* prefix, SymbolVisitFunc visit, void* user);
+
+/*
+ * 函数: symtab_find_by_address
+ * 描述: 查找地址不超过 address 的最近符号（地址→符号反查）
+ * 返回: 最近符号；多个符号地址相同时返回最先登记的一个；
+ *       address 低于所有符号时返回 NULL_PTR
+ */
+SymbolInfo* symtab_find_by_address(SymbolTable* symtab, u32 address);
+
+/*
+ * 函数: symtab_get_by_address
+ * 描述: 获取按地址非降序排列的符号数组（只读，插入或删除符号后失效）
+ * 参数: count - 输出数组长度
+ */
+SymbolInfo* const* symtab_get_by_address(SymbolTable* symtab, u32* count);
+
 /*
  * 函数: symtab_clear
  * 描述: 清空符号表（重置地址计数但保留表结构）
@@ -72,6 +72,8 @@ typedef enum {
     PSEUDO_PROC    = 0x85,
     PSEUDO_ENDP    = 0x86,
     PSEUDO_END     = 0x87,
+    PSEUDO_PUBLIC  = 0x88,
+    PSEUDO_EXTRN   = 0x89,
 
     /* 特殊 */
     INSTR_NONE = 0xFF
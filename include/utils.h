@@ -21,6 +21,8 @@ typedef unsigned int       u32;
 typedef signed char        s8;
 typedef signed short       s16;
 typedef signed int         s32;
+typedef unsigned long long u64;
+typedef signed long long   s64;
 
 typedef int                bool_t;
 #define TRUE               1
@@ -47,6 +49,86 @@ void* util_malloc(u32 size);
  */
 void util_free(void* ptr);
 
+/*
+ * 分配记账（运行时默认关闭，--stats 时开启）
+ * 每块内存前有一个 16 字节的头部记录大小与标签；开启记账后统计分配次数、
+ * 存活字节数、峰值、按 2 的幂分桶的大小直方图以及各子系统的占用。
+ * 子系统标签为线程局部状态：阶段入口调用 util_mem_set_tag 设定，
+ * 其后本线程的分配都计入该标签。开启前分配的内存释放时不参与统计。
+ *
+ * 头部在记账关闭时同样存在：每次分配多 16 字节，外加一次原子读。
+ * 以 make MEMSTATS=0（定义 SUBAS_NO_MEM_ACCOUNTING）编译时去掉头部与记账，
+ * util_malloc 直接转发给 malloc，统计恒为 0（--stats 不再输出内存一节，
+ * 基准测试的堆峰值列为 0）。
+ */
+#ifdef SUBAS_NO_MEM_ACCOUNTING
+#define UTIL_MEM_ACCOUNTING    0
+#else
+#define UTIL_MEM_ACCOUNTING    1
+#endif
+
+typedef enum {
+    UTIL_MEM_GENERAL = 0,       /* 未归类（命令行、诊断、I/O 等） */
+    UTIL_MEM_LEXER,             /* 词法分析：Token 与词素 */
+    UTIL_MEM_SYMTAB,            /* 符号表 */
+    UTIL_MEM_IR,                /* 第一遍扫描的指令表（中间表示） */
+    UTIL_MEM_CODEGEN,           /* 代码生成：机器码与重定位 */
+    UTIL_MEM_TAG_COUNT
+} UtilMemTag;
+
+#define UTIL_MEM_BUCKETS   32   /* 直方图桶 i 统计大小在 [2^i, 2^(i+1)) 的分配 */
+
+typedef struct {
+    u64 allocs;                             /* 累计分配次数 */
+    u64 frees;                              /* 累计释放次数 */
+    u64 total_bytes;                        /* 累计分配字节数 */
+    u64 live_bytes;                         /* 当前存活字节数 */
+    u64 peak_bytes;                         /* 存活字节数峰值 */
+    UtilMemTag peak_tag;                    /* 推高峰值的最后一次分配的标签 */
+    u64 tag_allocs[UTIL_MEM_TAG_COUNT];     /* 各标签分配次数 */
+    u64 tag_live[UTIL_MEM_TAG_COUNT];       /* 各标签当前存活字节数 */
+    u64 tag_peak[UTIL_MEM_TAG_COUNT];       /* 各标签自身的峰值 */
+    u64 tag_at_peak[UTIL_MEM_TAG_COUNT];    /* 全局峰值时刻各标签的存活字节数 */
+    u64 histogram[UTIL_MEM_BUCKETS];        /* 分配大小直方图 */
+} UtilMemStats;
+
+/*
+ * 函数: util_mem_accounting
+ * 描述: 开启或关闭分配记账（关闭时仅保留头部，不更新计数）。
+ */
+void util_mem_accounting(int enable);
+
+/*
+ * 函数: util_mem_set_tag
+ * 描述: 设定本线程后续分配的子系统标签。
+ * 返回: 之前的标签，便于调用者恢复
+ */
+UtilMemTag util_mem_set_tag(UtilMemTag tag);
+
+/*
+ * 函数: util_mem_get_stats
+ * 描述: 读取记账快照（并发分配时各字段之间只保证近似一致）。
+ */
+void util_mem_get_stats(UtilMemStats* out);
+
+/*
+ * 函数: util_mem_peak_bytes
+ * 描述: 返回当前的存活字节数峰值（供统计模块按阶段计算峰值增量）。
+ */
+u64 util_mem_peak_bytes(void);
+
+/*
+ * 函数: util_mem_tag_name
+ * 描述: 返回标签名称。
+ */
+const char* util_mem_tag_name(UtilMemTag tag);
+
+/*
+ * 函数: util_peak_rss_kb
+ * 描述: 返回进程常驻内存峰值（KB，来自 getrusage；不可用时为 0）。
+ */
+u64 util_peak_rss_kb(void);
+
 
 /* --------------------------------------------------------------------------
  * 3. 基础字符串处理接口 (替代 <string.h>)
@@ -130,6 +212,15 @@ void util_ht_insert(UtilHashTable* table, const char* key, void* value);
  */
 void* util_ht_lookup(UtilHashTable* table, const char* key);
 
+/*
+ * 函数: util_ht_remove
+ * 描述: 从哈希表中删除键，释放其节点与键副本。
+ * 参数: table - 哈希表指针
+ * key   - 要删除的键
+ * 返回: 被删除键对应的值指针（由调用者释放），未找到返回 NULL_PTR
+ */
+void* util_ht_remove(UtilHashTable* table, const char* key);
+
 /*
  * 函数: util_ht_destroy
  * 描述: 销毁哈希表并释放所有相关内存。注意：此函数不释放 value 指针指向的内存。
@@ -137,6 +228,142 @@ void* util_ht_lookup(UtilHashTable* table, const char* key);
  */
 void util_ht_destroy(UtilHashTable* table);
 
+/*
+ * 函数: util_hash64
+ * 描述: 计算字节序列的 64 位 FNV-1a 哈希（用于内容寻址，如构建缓存的键）。
+ * 参数: data - 数据，size - 字节数，seed - 初始值（链式计算多段数据时传入上一段结果）
+ */
+u64 util_hash64(const void* data, u32 size, u64 seed);
+
+/* util_hash64 的标准初始值（FNV-1a 64 位偏移基数） */
+#define UTIL_HASH64_SEED    0xcbf29ce484222325ULL
+
+/* SHA-256 摘要字节数 */
+#define UTIL_SHA256_SIZE    32
+
+/* SHA-256 增量计算状态（用于需要抗碰撞的内容校验，如构建缓存条目） */
+typedef struct {
+    u32 state[8];               /* 中间哈希值 */
+    u64 length;                 /* 已输入字节数 */
+    u8 block[64];               /* 未满一块的输入 */
+    u32 used;                   /* block 中的字节数 */
+} UtilSha256;
+
+/*
+ * 函数: util_sha256_init / util_sha256_update / util_sha256_final
+ * 描述: 分段计算 SHA-256：init 后多次 update，final 写出 32 字节摘要。
+ */
+void util_sha256_init(UtilSha256* sha);
+void util_sha256_update(UtilSha256* sha, const void* data, u32 size);
+void util_sha256_final(UtilSha256* sha, u8 digest[UTIL_SHA256_SIZE]);
+
+
+/* --------------------------------------------------------------------------
+ * 5. 线程接口 (封装平台线程库，上层模块不直接包含 <pthread.h>)
+ * 线程对象对外不透明，便于日后替换为其他平台实现。
+ * -------------------------------------------------------------------------- */
+
+/* 线程句柄（不透明类型） */
+typedef struct UtilThread UtilThread;
+
+/* 线程入口函数原型 */
+typedef void (*UtilThreadFunc)(void* arg);
+
+/*
+ * 函数: util_thread_create
+ * 描述: 创建并启动一个线程执行 func(arg)。
+ * 返回: 线程句柄；创建失败返回 NULL_PTR（调用者可退化为在当前线程执行）
+ */
+UtilThread* util_thread_create(UtilThreadFunc func, void* arg);
+
+/*
+ * 函数: util_thread_join
+ * 描述: 等待线程结束并释放线程句柄。
+ */
+void util_thread_join(UtilThread* thread);
+
+/*
+ * 函数: util_cpu_count
+ * 描述: 获取可用的处理器核心数（至少为 1）。
+ */
+u32 util_cpu_count(void);
+
+/*
+ * 函数: util_thread_yield
+ * 描述: 让出当前线程的处理器时间片（用于自旋等待）。
+ */
+void util_thread_yield(void);
+
+/*
+ * 函数: util_thread_id
+ * 描述: 返回当前线程的编号（进程内从 1 开始按首次调用顺序分配，用于跟踪输出）。
+ */
+u32 util_thread_id(void);
+
+
+/* --------------------------------------------------------------------------
+ * 6. 单生产者单消费者无锁队列 (用于流水线各阶段之间传递批次)
+ * 环形缓冲区 + 原子读写下标，仅允许一个线程入队、一个线程出队。
+ * -------------------------------------------------------------------------- */
+
+/* 队列句柄（不透明类型） */
+typedef struct UtilSpscQueue UtilSpscQueue;
+
+/*
+ * 函数: util_spsc_create
+ * 描述: 创建队列，容量向上取整为 2 的幂。
+ * 返回: 队列指针，失败返回 NULL_PTR
+ */
+UtilSpscQueue* util_spsc_create(u32 capacity);
+
+/*
+ * 函数: util_spsc_push
+ * 描述: 入队一个元素（非空指针）；队列满时自旋让出直到有空位。
+ */
+void util_spsc_push(UtilSpscQueue* queue, void* item);
+
+/*
+ * 函数: util_spsc_pop
+ * 描述: 出队一个元素；队列空时自旋让出直到有元素可取。
+ */
+void* util_spsc_pop(UtilSpscQueue* queue);
+
+/*
+ * 函数: util_spsc_destroy
+ * 描述: 销毁队列（不释放队列中残留元素）。
+ */
+void util_spsc_destroy(UtilSpscQueue* queue);
+
+
+/* --------------------------------------------------------------------------
+ * 7. 工作窃取并行循环 (用于批量汇编多个源文件)
+ * 任务下标区间预先平均分给各工作线程；线程先从自己区间的头部取任务，
+ * 自己的区间取空后从其他线程区间的尾部窃取一半，直到所有区间为空。
+ * -------------------------------------------------------------------------- */
+
+/* 任务函数原型：worker 为工作线程编号（0 ~ workers-1），index 为任务下标 */
+typedef void (*UtilTaskFunc)(void* arg, u32 worker, u32 index);
+
+/*
+ * 函数: util_parallel_for
+ * 描述: 以 workers 个工作线程执行 func(arg, worker, index)，index 取遍 0 ~ count-1，
+ *       每个下标恰好执行一次；全部完成后返回。
+ * 参数: workers - 工作线程数（0 表示全部核心）；编号 0 的工作线程即调用线程，
+ *                 其余线程创建失败时其任务由已运行的线程窃取完成
+ */
+void util_parallel_for(u32 count, u32 workers, UtilTaskFunc func, void* arg);
+
+
+/* --------------------------------------------------------------------------
+ * 8. 计时接口 (用于各阶段耗时统计)
+ * -------------------------------------------------------------------------- */
+
+/*
+ * 函数: util_time_ns
+ * 描述: 返回单调时钟的当前时刻（纳秒），只用于计算时间间隔。
+ */
+u64 util_time_ns(void);
+
 
 #endif /* __UTILS_H__ */
 
@@ -0,0 +1,84 @@
+﻿/*
+ * ============================================================================
+ * 文件名: watch.h
+ * 描述  : 文件监视模块 - 以 inotify 等待源文件被改写（--watch）
+ *
+ * 功能：
+ *  - 登记一组文件，阻塞等待其中任意文件被写完或被替换
+ *  - 一次返回本轮发生变化的全部文件（同一文件的多个事件合并为一个）
+ *
+ * 设计：
+ *  - 监视文件所在目录而非文件本身：编辑器常以"写临时文件再 rename"的方式保存，
+ *    被替换的文件 inode 随之失效，目录监视不受影响
+ *  - 关心 IN_CLOSE_WRITE（原地写完）与 IN_MOVED_TO（替换），事件按文件名匹配
+ *  - 收到首个事件后再等待一小段时间收集同一次保存产生的其余事件
+ *  - 仅 Linux 可用；其它平台 watch_create 返回 NULL_PTR
+ *
+ * ============================================================================
+ */
+
+#ifndef __WATCH_H__
+#define __WATCH_H__
+
+#include "utils.h"
+
+#define WATCH_SETTLE_MS     20          /* 收到首个事件后继续收集的时间（毫秒） */
+
+/* ========================================================================= */
+/* 数据结构定义 */
+/* ========================================================================= */
+
+/* 文件监视集合（不透明类型） */
+typedef struct WatchSet WatchSet;
+
+/* ========================================================================= */
+/* API 函数声明 */
+/* ========================================================================= */
+
+/*
+ * watch_create
+ *
+ * 功能：创建空的监视集合
+ *
+ * 返回值：
+ *   - WatchSet*: 监视集合
+ *   - NULL: 平台不支持或 inotify 初始化失败
+ */
+WatchSet* watch_create(void);
+
+/*
+ * watch_add
+ *
+ * 功能：登记一个文件（所在目录须已存在）
+ *
+ * 返回值：
+ *   - >= 0: 文件在集合中的序号（按登记顺序从 0 计）
+ *   - -1: 无法监视
+ */
+int watch_add(WatchSet* set, const char* path);
+
+/*
+ * watch_wait
+ *
+ * 功能：等待登记的文件发生变化
+ *
+ * 参数：
+ *   - timeout_ms: 等待上限（毫秒，负数表示一直等待）
+ *   - changed: 输出本轮变化的文件序号（按序号升序，不重复）
+ *   - capacity: changed 的容量（超出的文件留待下一次调用返回）
+ *
+ * 返回值：
+ *   - > 0: 变化的文件数
+ *   - 0: 超时
+ *   - -1: 出错（如被信号中断）
+ */
+int watch_wait(WatchSet* set, int timeout_ms, u32* changed, u32 capacity);
+
+/*
+ * watch_destroy
+ *
+ * 功能：关闭 inotify 并释放监视集合
+ */
+void watch_destroy(WatchSet* set);
+
+#endif /* __WATCH_H__ */
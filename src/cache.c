@@ -0,0 +1,351 @@
+﻿/*
+ * ============================================================================
+ * 文件名: cache.c
+ * 描述  : 构建缓存实现
+ *
+ * 关键流程：
+ *  1. cache_key: 依次把签名、源文本长度与源文本并入 SHA-256
+ *  2. cache_fetch: 核对条目头中的源文本长度与摘要，把产物复制到输出路径旁的
+ *     临时文件（优先 reflink，否则逐块复制）后 rename 为输出文件
+ *  3. cache_store: 写临时文件后 rename 为条目文件
+ *
+ * 条目文件布局：
+ *  - 偏移 0：CacheEntryHeader（魔数、源文本长度、产物长度、摘要）
+ *  - 偏移 CACHE_PAYLOAD_OFFSET：产物。对齐到块大小使 reflink 可以只克隆产物
+ *    部分；条目头之后的空隙以 lseek 跳过，在支持稀疏文件的文件系统上不占空间
+ *
+ * 命中 / 未命中计数为原子量，批量模式的工作线程可并发访问同一缓存。
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+#include "../include/cache.h"
+
+#define CACHE_COPY_CHUNK    (64 * 1024)
+#define CACHE_PAYLOAD_OFFSET 4096               /* 产物在条目文件中的偏移 */
+#define CACHE_ENTRY_MAGIC   0x43424153u         /* "SABC" */
+
+/* 构建缓存 */
+struct BuildCache {
+    char* dir;                  /* 缓存目录 */
+    _Atomic u32 hits;           /* 命中次数 */
+    _Atomic u32 misses;         /* 未命中次数 */
+    _Atomic u32 temp_serial;    /* 临时文件序号 */
+};
+
+/* 条目文件头（本机字节序；缓存目录不跨机器共享） */
+typedef struct {
+    u32 magic;                          /* CACHE_ENTRY_MAGIC */
+    u32 source_size;                    /* 键的源文本字节数 */
+    u32 payload_size;                   /* 产物字节数 */
+    u32 reserved;
+    u8 digest[UTIL_SHA256_SIZE];        /* 键的摘要 */
+} CacheEntryHeader;
+
+/* ========================================================================= */
+/* 内部辅助函数 */
+/* ========================================================================= */
+
+/*
+ * 生成条目文件路径
+ */
+static void entry_path(const BuildCache* cache, const CacheKey* key, const char* ext,
+                       char* path, u32 capacity) {
+    char text[CACHE_KEY_TEXT];
+
+    cache_key_text(key, text);
+    snprintf(path, capacity, "%s/%s.%s", cache->dir, text, ext);
+}
+
+/*
+ * 打开条目并核对条目头与键、文件长度是否一致
+ *
+ * 返回值：文件描述符（*out_size 为产物字节数），不存在或不符时返回 -1
+ */
+static int open_entry(const BuildCache* cache, const CacheKey* key, const char* ext,
+                      u32* out_size) {
+    char path[CACHE_PATH_MAX];
+    CacheEntryHeader header;
+    struct stat info;
+    int same;
+    int fd;
+    u32 i;
+
+    entry_path(cache, key, ext, path, sizeof(path));
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    same = (pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+            fstat(fd, &info) == 0 &&
+            header.magic == CACHE_ENTRY_MAGIC &&
+            header.source_size == key->source_size &&
+            (u64)info.st_size == (u64)CACHE_PAYLOAD_OFFSET + header.payload_size);
+    for (i = 0; same && i < UTIL_SHA256_SIZE; i++) {
+        same = (header.digest[i] == key->digest[i]);
+    }
+    if (!same) {
+        close(fd);
+        return -1;
+    }
+
+    *out_size = header.payload_size;
+    return fd;
+}
+
+/*
+ * 从 src_fd 的 offset 处读满 size 字节
+ */
+static int read_at(int src_fd, u8* dest, u32 size, u64 offset) {
+    u32 done = 0;
+
+    while (done < size) {
+        ssize_t got = pread(src_fd, dest + done, size - done, (off_t)(offset + done));
+        if (got <= 0) {
+            return -1;
+        }
+        done += (u32)got;
+    }
+    return 0;
+}
+
+/*
+ * 把数据完整写入文件描述符
+ */
+static int write_all(int fd, const u8* data, u32 size) {
+    u32 done = 0;
+
+    while (done < size) {
+        ssize_t put = write(fd, data + done, size - done);
+        if (put < 0) {
+            return -1;
+        }
+        done += (u32)put;
+    }
+    return 0;
+}
+
+/*
+ * 把条目中的产物写入 dst_fd：先尝试 reflink，再退化为逐块复制
+ */
+static int copy_payload(int src_fd, int dst_fd, u32 size) {
+    u8 buffer[CACHE_COPY_CHUNK];
+    u32 done = 0;
+
+#ifdef FICLONERANGE
+    struct file_clone_range range;
+
+    range.src_fd = src_fd;
+    range.src_offset = CACHE_PAYLOAD_OFFSET;
+    range.src_length = 0;               /* 到文件末尾 */
+    range.dest_offset = 0;
+    if (ioctl(dst_fd, FICLONERANGE, &range) == 0) {
+        return 0;
+    }
+#endif
+
+    while (done < size) {
+        u32 chunk = (size - done < sizeof(buffer)) ? size - done : (u32)sizeof(buffer);
+        if (read_at(src_fd, buffer, chunk, (u64)CACHE_PAYLOAD_OFFSET + done) != 0 ||
+            write_all(dst_fd, buffer, chunk) != 0) {
+            return -1;
+        }
+        done += chunk;
+    }
+    return 0;
+}
+
+/*
+ * 生成与 path 同目录的临时文件名（进程号加序号，并发写入互不干扰）
+ */
+static void temp_path(BuildCache* cache, const char* path, char* temp, u32 capacity) {
+    u32 serial = atomic_fetch_add(&cache->temp_serial, 1);
+
+    snprintf(temp, capacity, "%s.tmp%ld.%u", path, (long)getpid(), serial);
+}
+
+/* ========================================================================= */
+/* API 函数实现 */
+/* ========================================================================= */
+
+BuildCache* cache_open(const char* dir) {
+    BuildCache* cache;
+    struct stat info;
+
+    if (dir == NULL_PTR) {
+        return NULL_PTR;
+    }
+
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        return NULL_PTR;
+    }
+    if (stat(dir, &info) != 0 || !S_ISDIR(info.st_mode)) {
+        return NULL_PTR;
+    }
+
+    cache = (BuildCache*)util_malloc(sizeof(BuildCache));
+    if (cache == NULL_PTR) {
+        return NULL_PTR;
+    }
+
+    cache->dir = util_strdup(dir);
+    if (cache->dir == NULL_PTR) {
+        util_free(cache);
+        return NULL_PTR;
+    }
+
+    atomic_init(&cache->hits, 0);
+    atomic_init(&cache->misses, 0);
+    atomic_init(&cache->temp_serial, 0);
+    return cache;
+}
+
+void cache_key(const char* source, u32 size, const char* signature, CacheKey* out) {
+    UtilSha256 sha;
+
+    util_sha256_init(&sha);
+    util_sha256_update(&sha, signature, util_strlen(signature) + 1);
+    util_sha256_update(&sha, &size, sizeof(size));
+    util_sha256_update(&sha, source, size);
+    util_sha256_final(&sha, out->digest);
+    out->source_size = size;
+}
+
+void cache_key_text(const CacheKey* key, char* text) {
+    static const char hex[] = "0123456789abcdef";
+    u32 i;
+
+    for (i = 0; i < UTIL_SHA256_SIZE; i++) {
+        text[i * 2] = hex[key->digest[i] >> 4];
+        text[i * 2 + 1] = hex[key->digest[i] & 0x0F];
+    }
+    text[UTIL_SHA256_SIZE * 2] = '\0';
+}
+
+int cache_fetch(BuildCache* cache, const CacheKey* key, const char* ext,
+                const char* output_path, u32* out_size) {
+    char temp[CACHE_PATH_MAX + 32];
+    u32 size = 0;
+    int src_fd;
+    int dst_fd;
+    int result;
+
+    src_fd = open_entry(cache, key, ext, &size);
+    if (src_fd < 0) {
+        atomic_fetch_add(&cache->misses, 1);
+        return -1;
+    }
+
+    /* 先写到输出文件旁的临时文件，复制完整后才替换输出文件 */
+    temp_path(cache, output_path, temp, sizeof(temp));
+    dst_fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (dst_fd < 0) {
+        close(src_fd);
+        atomic_fetch_add(&cache->misses, 1);
+        return -1;
+    }
+
+    result = copy_payload(src_fd, dst_fd, size);
+    close(src_fd);
+    if (close(dst_fd) != 0) {
+        result = -1;
+    }
+
+    if (result != 0 || rename(temp, output_path) != 0) {
+        unlink(temp);
+        atomic_fetch_add(&cache->misses, 1);
+        return -1;
+    }
+
+    *out_size = size;
+    atomic_fetch_add(&cache->hits, 1);
+    return 0;
+}
+
+u8* cache_load(BuildCache* cache, const CacheKey* key, const char* ext, u32* out_size) {
+    u32 size = 0;
+    u8* data;
+    int fd;
+
+    fd = open_entry(cache, key, ext, &size);
+    if (fd < 0) {
+        return NULL_PTR;
+    }
+
+    data = (u8*)util_malloc(size > 0 ? size : 1);
+    if (data != NULL_PTR && read_at(fd, data, size, CACHE_PAYLOAD_OFFSET) != 0) {
+        util_free(data);
+        data = NULL_PTR;
+    }
+    close(fd);
+
+    *out_size = size;
+    return data;
+}
+
+void cache_store(BuildCache* cache, const CacheKey* key, const char* ext, const u8* data, u32 size) {
+    char path[CACHE_PATH_MAX];
+    char temp[CACHE_PATH_MAX + 32];
+    CacheEntryHeader header;
+    int fd;
+    int result;
+    u32 i;
+
+    entry_path(cache, key, ext, path, sizeof(path));
+    temp_path(cache, path, temp, sizeof(temp));
+
+    util_memset(&header, 0, sizeof(header));
+    header.magic = CACHE_ENTRY_MAGIC;
+    header.source_size = key->source_size;
+    header.payload_size = size;
+    for (i = 0; i < UTIL_SHA256_SIZE; i++) {
+        header.digest[i] = key->digest[i];
+    }
+
+    fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return;
+    }
+
+    result = write_all(fd, (const u8*)&header, sizeof(header));
+    if (result == 0 && lseek(fd, CACHE_PAYLOAD_OFFSET, SEEK_SET) != (off_t)CACHE_PAYLOAD_OFFSET) {
+        result = -1;
+    }
+    if (result == 0) {
+        result = write_all(fd, data, size);
+    }
+    /* 空产物时 lseek 不会延长文件，显式补足到产物偏移 */
+    if (result == 0 && ftruncate(fd, (off_t)CACHE_PAYLOAD_OFFSET + size) != 0) {
+        result = -1;
+    }
+    if (close(fd) != 0) {
+        result = -1;
+    }
+
+    if (result != 0 || rename(temp, path) != 0) {
+        unlink(temp);
+    }
+}
+
+void cache_get_stats(const BuildCache* cache, u32* out_hits, u32* out_misses) {
+    *out_hits = atomic_load(&cache->hits);
+    *out_misses = atomic_load(&cache->misses);
+}
+
+void cache_close(BuildCache* cache) {
+    if (cache == NULL_PTR) return;
+
+    util_free(cache->dir);
+    util_free(cache);
+}
@@ -7,13 +7,14 @@
  *  1. 遍历第一遍扫描的指令列表
  *  2. 对每条指令生成机器码
  *  3. 记录标签引用的重定位信息
- *  4. 在代码生成完毕后，利用符号表解决所有标签引用
+ *  4. 在代码生成完毕后，把标签地址改为实际偏移，利用符号表解决所有标签引用
  *
  * ============================================================================
  */
 
 #include <stdio.h>
 #include "../include/codegen.h"
+#include "../include/counters.h"
 
 /* ========================================================================= */
 /* 内部辅助函数声明 */
@@ -36,27 +37,93 @@ static int record_relocation(
 
     Relocation* rel = &codegen->relocations[codegen->relocation_count];
     rel->offset = offset;
+    rel->kind = RELOC_OFFSET;
     rel->instruction_index = instruction_index;
     rel->operand_index = operand_index;
     util_strcpy(rel->symbol_name, symbol_name);
 
     codegen->relocation_count++;
+    COUNTER_ADD(COUNTER_RELOCATIONS, 1);
     return 0;
 }
 
-/* ========================================================================= */
-/* API 函数实现 */
-/* ========================================================================= */
+/*
+ * 记录第 index 条指令的起始偏移（容量不足时扩容；结束偏移先记为同一位置）
+ */
+static int record_instruction_offset(CodeGen* codegen, u32 index) {
+    if (index + 2 > codegen->instruction_offset_capacity) {
+        u32 capacity = codegen->instruction_offset_capacity * 2;
+        if (capacity < index + 2) {
+            capacity = index + 2;
+        }
+        u32* grown = (u32*)util_malloc(sizeof(u32) * capacity);
+        if (grown == NULL) {
+            error_report(0, ERR_SYS_OUT_OF_MEM, "无法分配指令偏移表");
+            return -1;
+        }
+        for (u32 i = 0; i < codegen->instruction_offset_capacity; i++) {
+            grown[i] = codegen->instruction_offsets[i];
+        }
+        util_free(codegen->instruction_offsets);
+        codegen->instruction_offsets = grown;
+        codegen->instruction_offset_capacity = capacity;
+    }
+
+    codegen->instruction_offsets[index] = codegen->code_size;
+    codegen->instruction_offsets[index + 1] = codegen->code_size;
+    return 0;
+}
 
 /*
- * codegen_pass_two: 执行第二遍扫描（代码生成）
+ * 收集 SEGMENT 声明的段名（解决重定位时首次遇到符号表之外的名字才建立）
  */
-CodeGen* codegen_pass_two(const PassOne* pass_one) {
-    if (pass_one == NULL) {
-        error_report(0, ERR_SYS_OUT_OF_MEM, "Pass One 为 NULL");
+static UtilHashTable* collect_segment_names(const PassOne* pass_one) {
+    UtilHashTable* names = util_ht_create(16);
+    if (names == NULL) {
         return NULL;
     }
+    for (u32 i = 0; i < pass_one->instruction_count; i++) {
+        const InstructionEntry* entry = &pass_one->instructions[i];
+        if (!entry->has_error && entry->operand_count > 0 &&
+            entry->operands[0].type == OPERAND_LABEL &&
+            util_strcmp((const char*)entry->mnemonic, "SEGMENT") == 0) {
+            util_ht_insert(names, (const char*)entry->operands[0].name, (void*)entry);
+        }
+    }
+    return names;
+}
+
+/*
+ * 把各标签的地址改为其所在指令的实际起始偏移（第一遍的地址只是按指令长度的估计）。
+ * 重名标签只有首个定义者拥有符号；改写后恢复符号表地址索引的顺序
+ */
+static void place_symbols(CodeGen* codegen) {
+    const PassOne* pass_one = codegen->pass_one;
+
+    if (codegen->instruction_offsets == NULL) {
+        return;
+    }
+    for (u32 i = 0; i < pass_one->instruction_count; i++) {
+        const InstructionEntry* entry = &pass_one->instructions[i];
+        if (!entry->has_label) {
+            continue;
+        }
+        SymbolInfo* info = symtab_lookup(pass_one->symtab, (const char*)entry->label);
+        if (info != NULL && info->type != SYM_EXTERNAL && info->line_defined == entry->line) {
+            info->address = codegen->instruction_offsets[i];
+        }
+    }
+    symtab_reindex_addresses(pass_one->symtab);
+}
+
+/* ========================================================================= */
+/* API 函数实现 */
+/* ========================================================================= */
 
+/*
+ * codegen_create: 创建代码生成上下文
+ */
+CodeGen* codegen_create(const PassOne* pass_one) {
     CodeGen* codegen = (CodeGen*)util_malloc(sizeof(CodeGen));
     if (codegen == NULL) {
         error_report(0, ERR_SYS_OUT_OF_MEM, "无法分配 CodeGen 结构");
@@ -73,7 +140,10 @@ CodeGen* codegen_pass_two(const PassOne* pass_one) {
     codegen->relocations = (Relocation*)util_malloc(
         sizeof(Relocation) * CODEGEN_MAX_RELOCATIONS
     );
-    if (codegen->relocations == NULL) {
+    codegen->segment_fixups = (u32*)util_malloc(sizeof(u32) * CODEGEN_MAX_RELOCATIONS);
+    if (codegen->relocations == NULL || codegen->segment_fixups == NULL) {
+        util_free(codegen->relocations);
+        util_free(codegen->segment_fixups);
         util_free(codegen->code_buffer);
         util_free(codegen);
         error_report(0, ERR_SYS_OUT_OF_MEM, "无法分配重定位表");
@@ -83,15 +153,39 @@ CodeGen* codegen_pass_two(const PassOne* pass_one) {
     codegen->pass_one = pass_one;
     codegen->code_size = 0;
     codegen->relocation_count = 0;
+    codegen->segment_fixup_count = 0;
+    codegen->instruction_offsets = NULL;
+    codegen->instruction_offset_capacity = 0;
     codegen->has_errors = 0;
 
-    /* 遍历第一遍收集的指令，生成代码 */
-    for (u32 i = 0; i < pass_one->instruction_count; i++) {
-        const InstructionEntry* entry = &pass_one->instructions[i];
+    return codegen;
+}
+
+/*
+ * codegen_pass_two: 执行第二遍扫描（代码生成）
+ */
+CodeGen* codegen_pass_two(const PassOne* pass_one) {
+    return codegen_pass_two_listed(pass_one, NULL, NULL);
+}
 
-        if (codegen_emit_instruction(codegen, entry) < 0) {
+/*
+ * codegen_pass_two_listed: 执行第二遍扫描，每条指令生成后回调 listener
+ */
+CodeGen* codegen_pass_two_listed(const PassOne* pass_one, CodeGenListener listener, void* user) {
+    if (pass_one == NULL) {
+        error_report(0, ERR_SYS_OUT_OF_MEM, "Pass One 为 NULL");
+        return NULL;
+    }
+
+    CodeGen* codegen = codegen_create(pass_one);
+    if (codegen == NULL) {
+        return NULL;
+    }
+
+    /* 遍历第一遍收集的指令，生成代码；出错的指令已报告，继续处理后续各行 */
+    for (u32 i = 0; i < pass_one->instruction_count; i++) {
+        if (codegen_emit_instruction_at(codegen, &pass_one->instructions[i], i) < 0) {
             codegen->has_errors = 1;
-            error_report(entry->line, ERR_PARSE_UNK_MNEMONIC, "未知指令");
         }
     }
 
@@ -100,7 +194,19 @@ CodeGen* codegen_pass_two(const PassOne* pass_one) {
         codegen->has_errors = 1;
     }
 
-    if (codegen->has_errors) {
+    /* 标签的实际偏移在全部指令生成后才确定：引用解决之后再逐条回调 */
+    if (listener != NULL && codegen->instruction_offsets != NULL) {
+        u32 first_relocation = 0;
+        for (u32 i = 0; i < pass_one->instruction_count; i++) {
+            listener(user, codegen, i, codegen->instruction_offsets[i], first_relocation);
+            while (first_relocation < codegen->relocation_count &&
+                   codegen->relocations[first_relocation].instruction_index == i) {
+                first_relocation++;
+            }
+        }
+    }
+
+    if (codegen->has_errors || pass_one->has_errors) {
         codegen_destroy(codegen);
         return NULL;
     }
@@ -112,6 +218,23 @@ CodeGen* codegen_pass_two(const PassOne* pass_one) {
  * codegen_emit_instruction: 生成单条指令的机器码
  */
 int codegen_emit_instruction(CodeGen* codegen, const InstructionEntry* entry) {
+    return codegen_emit_instruction_at(codegen, entry,
+        (u32)(entry - codegen->pass_one->instructions));
+}
+
+/*
+ * codegen_emit_instruction_at: 生成单条指令的机器码（显式给出指令索引）
+ */
+int codegen_emit_instruction_at(CodeGen* codegen, const InstructionEntry* entry, u32 index) {
+    if (record_instruction_offset(codegen, index) < 0) {
+        return -1;
+    }
+
+    /* 错误占位条目：第一遍已报告，不生成代码 */
+    if (entry->has_error) {
+        return 0;
+    }
+
     if (codegen->code_size + SEMANTIC_MAX_INSTRUCTION_LEN >= CODEGEN_OUTPUT_BUFFER_SIZE) {
         error_report(0, ERR_SYS_OUT_OF_MEM, "代码缓冲区溢出");
         return -1;
@@ -163,8 +286,7 @@ int codegen_emit_instruction(CodeGen* codegen, const InstructionEntry* entry) {
                 /* 标签引用 - 记录重定位信息，暂时填充 0 */
                 if (operand->type == OPERAND_LABEL && util_strlen((const char*)operand->name) > 0) {
                     if (record_relocation(codegen, codegen->code_size + emitted,
-                                        entry - codegen->pass_one->instructions, i,
-                                        operand->name) < 0) {
+                                        index, i, operand->name) < 0) {
                         return -1;
                     }
                 }
@@ -175,6 +297,7 @@ int codegen_emit_instruction(CodeGen* codegen, const InstructionEntry* entry) {
     }
 
     codegen->code_size += emitted;
+    codegen->instruction_offsets[index + 1] = codegen->code_size;
     return 0;
 }
 
@@ -182,27 +305,85 @@ int codegen_emit_instruction(CodeGen* codegen, const InstructionEntry* entry) {
  * codegen_resolve_reference: 解决所有标签引用
  */
 int codegen_resolve_reference(CodeGen* codegen) {
+    UtilHashTable* reported = NULL;    /* 已报告的未定义符号（首次出现时创建） */
+    UtilHashTable* segments = NULL;    /* 段名（首次遇到符号表之外的名字时建立） */
+    int result = 0;
+    COUNTER_ONLY(u64 start_ns = util_time_ns();)
+
+    place_symbols(codegen);
+    codegen->segment_fixup_count = 0;
     for (u32 i = 0; i < codegen->relocation_count; i++) {
-        const Relocation* rel = &codegen->relocations[i];
+        Relocation* rel = &codegen->relocations[i];
 
         /* 从符号表查找符号地址 */
         SymbolInfo* symbol = symtab_lookup(codegen->pass_one->symtab, (const char*)rel->symbol_name);
         if (symbol == NULL) {
-            error_report(0, ERR_PARSE_UNDEFINED_LBL, (const char*)rel->symbol_name);
-            return -1;
+            if (segments == NULL) {
+                segments = collect_segment_names(codegen->pass_one);
+            }
+            if (segments != NULL && util_ht_lookup(segments, (const char*)rel->symbol_name) != NULL) {
+                /* 段名引用：段基址相对映像开头为 0，由装载器修正 */
+                rel->kind = RELOC_SEGMENT;
+                codegen->code_buffer[rel->offset] = 0x00;
+                codegen->code_buffer[rel->offset + 1] = 0x00;
+                codegen->segment_fixups[codegen->segment_fixup_count++] = rel->offset;
+                continue;
+            }
+        }
+        if (symbol == NULL || !symbol->is_defined) {
+            /* 每个未定义符号只在首次引用处报告，后续引用视为连带错误 */
+            const char* name = (const char*)rel->symbol_name;
+            result = -1;
+            if (reported == NULL) {
+                reported = util_ht_create(64);
+            }
+            if (reported != NULL && util_ht_lookup(reported, name) != NULL) {
+                continue;
+            }
+            if (reported != NULL) {
+                util_ht_insert(reported, name, codegen);
+            }
+            error_report(codegen->pass_one->instructions[rel->instruction_index].line,
+                         ERR_PARSE_UNDEFINED_LBL, name);
+            continue;
         }
 
-        if (!symbol->is_defined) {
-            error_report(0, ERR_PARSE_UNDEFINED_LBL, "标签未定义");
-            return -1;
+        if (symbol->type == SYM_EXTERNAL) {
+            /* 外部符号：地址在链接时确定 */
+            rel->kind = RELOC_EXTERNAL;
+            codegen->code_buffer[rel->offset] = 0x00;
+            codegen->code_buffer[rel->offset + 1] = 0x00;
+            COUNTER_ADD(COUNTER_RELOC_RESOLVED, 1);
+            continue;
         }
 
         /* 填充地址 */
         u32 address = symbol->address;
+        rel->kind = RELOC_OFFSET;
         codegen->code_buffer[rel->offset] = (u8)(address & 0xFF);
         codegen->code_buffer[rel->offset + 1] = (u8)((address >> 8) & 0xFF);
+        COUNTER_ADD(COUNTER_RELOC_RESOLVED, 1);
     }
 
+    util_ht_destroy(reported);
+    util_ht_destroy(segments);
+    COUNTER_ADD(COUNTER_RELOC_RESOLVE_NS, util_time_ns() - start_ns);
+    return result;
+}
+
+/*
+ * codegen_check_relocations: 目标格式无法表示的重定位在首次出现处报告
+ */
+int codegen_check_relocations(const CodeGen* codegen, u32 allowed) {
+    for (u32 i = 0; i < codegen->relocation_count; i++) {
+        const Relocation* rel = &codegen->relocations[i];
+        if ((allowed & CODEGEN_RELOC_MASK(rel->kind)) == 0) {
+            error_report(codegen->pass_one->instructions[rel->instruction_index].line,
+                         (rel->kind == RELOC_EXTERNAL) ? ERR_PARSE_EXTERN_REF : ERR_PARSE_SEGMENT_REF,
+                         (const char*)rel->symbol_name);
+            return -1;
+        }
+    }
     return 0;
 }
 
@@ -232,6 +413,13 @@ Relocation* codegen_get_relocation_info(const CodeGen* codegen, u32* out_count)
     return codegen->relocations;
 }
 
+/*
+ * codegen_get_instruction_offsets: 获取各指令机器码的实际起始偏移
+ */
+const u32* codegen_get_instruction_offsets(const CodeGen* codegen) {
+    return (codegen != NULL) ? codegen->instruction_offsets : NULL;
+}
+
 /*
  * codegen_destroy: 销毁代码生成上下文
  */
@@ -246,6 +434,9 @@ void codegen_destroy(CodeGen* codegen) {
         util_free(codegen->relocations);
     }
 
+    util_free(codegen->segment_fixups);
+    util_free(codegen->instruction_offsets);
+
     util_free(codegen);
 }
 
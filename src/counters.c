@@ -0,0 +1,94 @@
+﻿/*
+ * ============================================================================
+ * 文件名: counters.c
+ * 描述  : 热路径计数器实现
+ *
+ * 计数器始终编译进库，插桩点是否生效由 SUBAS_COUNTERS 决定；
+ * 未开启时所有计数器保持为 0。
+ *
+ * ============================================================================
+ */
+
+#include <stdatomic.h>
+#include "../include/counters.h"
+
+/* 计数器名称（与 CounterId 一一对应；Token 类型与 lexer.h 的 TokenType 顺序一致） */
+static const char* const g_counter_names[] = {
+    "insn_lookups",
+    "insn_compares",
+    "insn_misses",
+    "ht_lookups",
+    "ht_lookup_probes",
+    "ht_lookup_misses",
+    "ht_inserts",
+    "ht_insert_probes",
+    "ht_max_chain",
+    "ht_max_load_x1000",
+    "relocations",
+    "reloc_resolved",
+    "reloc_resolve_ns",
+    "tokens",
+    "token_eof",
+    "token_newline",
+    "token_identifier",
+    "token_number",
+    "token_string",
+    "token_comma",
+    "token_colon",
+    "token_lbracket",
+    "token_rbracket",
+    "token_lparen",
+    "token_rparen",
+    "token_plus",
+    "token_minus",
+    "token_asterisk",
+    "token_slash",
+    "token_other"
+};
+
+_Static_assert(sizeof(g_counter_names) / sizeof(g_counter_names[0]) == COUNTER_COUNT,
+               "g_counter_names must match CounterId");
+
+static atomic_ullong g_counters[COUNTER_COUNT];
+
+void counters_add(CounterId id, u64 value) {
+    atomic_fetch_add_explicit(&g_counters[id], value, memory_order_relaxed);
+}
+
+void counters_max(CounterId id, u64 value) {
+    unsigned long long seen = atomic_load_explicit(&g_counters[id], memory_order_relaxed);
+    while (value > seen &&
+           !atomic_compare_exchange_weak_explicit(&g_counters[id], &seen, value,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+}
+
+u64 counters_get(CounterId id) {
+    return atomic_load_explicit(&g_counters[id], memory_order_relaxed);
+}
+
+const char* counters_name(CounterId id) {
+    return g_counter_names[id];
+}
+
+void counters_reset(void) {
+    for (u32 i = 0; i < COUNTER_COUNT; i++) {
+        atomic_store_explicit(&g_counters[i], 0, memory_order_relaxed);
+    }
+}
+
+void counters_write_json(FILE* fp) {
+    int first = 1;
+
+    fputc('{', fp);
+    for (u32 i = 0; i < COUNTER_COUNT; i++) {
+        u64 value = counters_get((CounterId)i);
+        if (value == 0) {
+            continue;
+        }
+        fprintf(fp, "%s\"%s\":%llu", first ? "" : ",", g_counter_names[i], value);
+        first = 0;
+    }
+    fputc('}', fp);
+}
@@ -0,0 +1,106 @@
+﻿/*
+ * ============================================================================
+ * 文件名: depfile.c
+ * 描述  : 依赖文件实现
+ *
+ * 输出格式（与 gcc -MD 相同）：
+ *   out.com: \
+ *     src/a.asm \
+ *     src/inc/b.inc
+ *
+ * ============================================================================
+ */
+
+#include "../include/depfile.h"
+
+/* ========================================================================= */
+/* 内部辅助函数 */
+/* ========================================================================= */
+
+/*
+ * 按 make 规则转义并写出一个路径
+ */
+static void write_escaped(FILE* fp, const char* path) {
+    for (const char* p = path; *p != '\0'; p++) {
+        if (*p == ' ' || *p == '#') {
+            fputc('\\', fp);
+        } else if (*p == '$') {
+            fputc('$', fp);
+        }
+        fputc(*p, fp);
+    }
+}
+
+/*
+ * 关闭文件并释放写入器
+ */
+static int release(DepFile* dep) {
+    int result = (fclose(dep->fp) == 0) ? 0 : -1;
+    util_free(dep->path);
+    util_free(dep);
+    return result;
+}
+
+/* ========================================================================= */
+/* API 函数实现 */
+/* ========================================================================= */
+
+DepFile* depfile_open(const char* path, const char* target) {
+    DepFile* dep = (DepFile*)util_malloc(sizeof(DepFile));
+    if (dep == NULL_PTR) {
+        return NULL_PTR;
+    }
+
+    dep->path = util_strdup(path);
+    dep->fp = fopen(path, "w");
+    if (dep->path == NULL_PTR || dep->fp == NULL_PTR) {
+        if (dep->fp != NULL_PTR) fclose(dep->fp);
+        util_free(dep->path);
+        util_free(dep);
+        return NULL_PTR;
+    }
+
+    write_escaped(dep->fp, target);
+    fputc(':', dep->fp);
+    return dep;
+}
+
+void depfile_add(DepFile* dep, const char* file) {
+    if (dep == NULL_PTR || file == NULL_PTR) return;
+
+    fputs(" \\\n  ", dep->fp);
+    write_escaped(dep->fp, file);
+}
+
+int depfile_close(DepFile* dep) {
+    char* path;
+    int failed;
+
+    if (dep == NULL_PTR) return 0;
+
+    fputc('\n', dep->fp);
+    failed = ferror(dep->fp);
+
+    path = dep->path;
+    dep->path = NULL_PTR;
+    if (release(dep) != 0) {
+        failed = 1;
+    }
+    if (failed) {
+        remove(path);
+    }
+    util_free(path);
+    return failed ? -1 : 0;
+}
+
+void depfile_abort(DepFile* dep) {
+    char* path;
+
+    if (dep == NULL_PTR) return;
+
+    path = dep->path;
+    dep->path = NULL_PTR;
+    release(dep);
+    remove(path);
+    util_free(path);
+}
@@ -2,94 +2,471 @@
  * ============================================================================
  * 文件名: error.c
  * 描述  : 统一错误处理与报告模块的实现。
- * 内部维护错误计数器，并根据错误码映射对应的标准提示信息。
+ * 错误计数与诊断记录保存在错误上下文中，每个线程可绑定独立的上下文；
+ * 并根据错误码映射对应的标准提示信息。
+ * 输出到 stderr 的诊断先去重、限量后缓存，由 error_flush 一次性写出。
  * ============================================================================
  */
 
 #include "../include/error.h"
 #include <stdio.h> /* 仅用于向 stderr 输出信息 */
 
+#define ERROR_SEEN_BUCKETS      256     /* 去重集合的桶数 */
+#define ERROR_SNIPPET_MAX       120     /* 源代码片段最多输出的字符数 */
+
 /* --------------------------------------------------------------------------
  * 1. 静态内部状态
  * -------------------------------------------------------------------------- */
-static u32 g_error_count = 0;
 
-/* * 错误码与提示信息的映射结构体
- */
-typedef struct {
-    ErrorCode code;
-    const char* message;
-} ErrorMapping;
+/* 进程级默认错误上下文：输出到 stderr，不保存记录 */
+static ErrorContext g_default_context = { .echo = 1 };
+
+/* 当前线程绑定的错误上下文（NULL 表示使用默认上下文） */
+static _Thread_local ErrorContext* t_context = NULL_PTR;
+
+/* 当前线程的诊断捕获缓冲区（NULL 表示直接输出） */
+static _Thread_local ErrorBuffer* t_capture = NULL_PTR;
+
+/* 当前线程是否正在追加诊断记录（防止内存不足时递归） */
+static _Thread_local int t_appending = 0;
 
 /* * 错误信息表驱动设计
- * 便于后续扩展错误类型，无需修改逻辑代码。
+ * 按错误码的千位分类、低三位编号直接索引，便于后续扩展错误类型，无需修改逻辑代码。
  */
-static const ErrorMapping g_error_table[] = {
-    { ERR_LEX_INVALID_CHAR,    "Lexical Error: Invalid character encountered" },
-    { ERR_LEX_UNCLOSED_STR,    "Lexical Error: Unclosed string literal" },
-    { ERR_LEX_INVALID_NUM,     "Lexical Error: Invalid numeric constant" },
+static const char* const g_lex_messages[] = {
+    NULL_PTR,
+    "Lexical Error: Invalid character encountered",         /* 1001 */
+    "Lexical Error: Unclosed string literal",               /* 1002 */
+    "Lexical Error: Invalid numeric constant",              /* 1003 */
+};
 
-    { ERR_PARSE_EXPECTED_OP,   "Syntax Error: Expected operand missing" },
-    { ERR_PARSE_INVALID_REG,   "Syntax Error: Invalid register name" },
-    { ERR_PARSE_UNK_MNEMONIC,  "Syntax Error: Unknown instruction mnemonic" },
-    { ERR_PARSE_DUP_LABEL,     "Symbol Error: Duplicate label definition" },
-    { ERR_PARSE_UNDEFINED_LBL, "Symbol Error: Undefined reference to label" },
+static const char* const g_parse_messages[] = {
+    NULL_PTR,
+    "Syntax Error: Expected operand missing",               /* 2001 */
+    "Syntax Error: Invalid register name",                  /* 2002 */
+    "Syntax Error: Unknown instruction mnemonic",           /* 2003 */
+    "Symbol Error: Duplicate label definition",             /* 2004 */
+    "Symbol Error: Undefined reference to label",           /* 2005 */
+    "Symbol Error: Segment reference requires EXE or OBJ output", /* 2006 */
+    "Symbol Error: External reference requires OBJ output", /* 2007 */
+};
 
-    { ERR_SYS_OUT_OF_MEM,      "System Error: Memory allocation failed" },
-    { ERR_SYS_FILE_IO,         "System Error: File I/O operation failed" },
+static const char* const g_sys_messages[] = {
+    NULL_PTR,
+    "System Error: Memory allocation failed",               /* 3001 */
+    "System Error: File I/O operation failed",              /* 3002 */
+};
+
+/* 分类表：下标为错误码的千位 */
+typedef struct {
+    const char* const* messages;
+    u32 count;
+} ErrorCategory;
 
-    { ERR_NONE,                NULL_PTR } /* 结束标记 */
+static const ErrorCategory g_error_table[] = {
+    { NULL_PTR, 0 },
+    { g_lex_messages,   sizeof(g_lex_messages) / sizeof(g_lex_messages[0]) },
+    { g_parse_messages, sizeof(g_parse_messages) / sizeof(g_parse_messages[0]) },
+    { g_sys_messages,   sizeof(g_sys_messages) / sizeof(g_sys_messages[0]) },
 };
 
+#define ERROR_CATEGORY_COUNT    (sizeof(g_error_table) / sizeof(g_error_table[0]))
+
+/* error_flush 使用的可增长文本缓冲区 */
+typedef struct {
+    char* data;
+    u32 len;
+    u32 capacity;
+    int failed;                 /* 扩容失败后不再追加 */
+} TextBuffer;
+
 /* --------------------------------------------------------------------------
  * 2. 内部辅助函数
  * -------------------------------------------------------------------------- */
 
 /*
  * 函数: find_error_msg
- * 描述: 根据错误码在表中检索对应的字符串提示。
+ * 描述: 根据错误码直接索引对应的字符串提示。
  */
 static const char* find_error_msg(ErrorCode code) {
-    u32 i = 0;
-    while (g_error_table[i].message != NULL_PTR) {
-        if (g_error_table[i].code == code) {
-            return g_error_table[i].message;
-        }
-        i++;
+    u32 category = (u32)code / 1000;
+    u32 index = (u32)code % 1000;
+
+    if (category < ERROR_CATEGORY_COUNT && index < g_error_table[category].count &&
+        g_error_table[category].messages[index] != NULL_PTR) {
+        return g_error_table[category].messages[index];
     }
     return "Unknown Error Occurred";
 }
 
+/*
+ * 函数: buffer_append
+ * 描述: 把一条诊断追加到诊断缓冲区。扩容时若内存不足，util_malloc 的报错
+ *       会再次进入本函数，此时直接丢弃该条记录以避免无限递归。
+ */
+static void buffer_append(ErrorBuffer* buffer, u32 line_num, ErrorCode code, const char* detail) {
+    ErrorRecord* record;
+
+    if (t_appending) {
+        return;
+    }
+    t_appending = 1;
+
+    if (buffer->count >= buffer->capacity) {
+        u32 new_capacity = (buffer->capacity == 0) ? 16 : buffer->capacity * 2;
+        ErrorRecord* grown = (ErrorRecord*)util_malloc(sizeof(ErrorRecord) * new_capacity);
+        u32 i;
+        if (grown == NULL_PTR) {
+            t_appending = 0;
+            return;
+        }
+        for (i = 0; i < buffer->count; i++) {
+            grown[i] = buffer->records[i];
+        }
+        util_free(buffer->records);
+        buffer->records = grown;
+        buffer->capacity = new_capacity;
+    }
+
+    record = &buffer->records[buffer->count++];
+    record->line = line_num;
+    record->code = code;
+    record->detail = util_strdup(detail);
+
+    t_appending = 0;
+}
+
+/*
+ * 函数: current_context
+ * 描述: 返回当前线程生效的错误上下文。
+ */
+static ErrorContext* current_context(void) {
+    return (t_context != NULL_PTR) ? t_context : &g_default_context;
+}
+
+/*
+ * 函数: copy_bytes
+ * 描述: 复制 size 个字节（避免依赖 string.h）。
+ */
+static void copy_bytes(char* dest, const char* src, u32 size) {
+    u32 i;
+    for (i = 0; i < size; i++) {
+        dest[i] = src[i];
+    }
+}
+
+/*
+ * 函数: is_duplicate
+ * 描述: 检查一条诊断是否与先前报告的完全相同，首次出现时记入去重集合。
+ *       去重集合内存不足时不去重（与 buffer_append 相同的递归保护）。
+ */
+static int is_duplicate(ErrorContext* ctx, u32 line_num, ErrorCode code, const char* detail) {
+    char key_head[32];
+    char* key;
+    u32 head_len;
+    u32 detail_len;
+    int duplicate;
+
+    if (t_appending) {
+        return 0;
+    }
+    t_appending = 1;
+
+    if (ctx->seen == NULL_PTR) {
+        ctx->seen = util_ht_create(ERROR_SEEN_BUCKETS);
+        if (ctx->seen == NULL_PTR) {
+            t_appending = 0;
+            return 0;
+        }
+    }
+
+    /* 键: "行号 错误码 详情"，以 \x1f 分隔 */
+    head_len = (u32)snprintf(key_head, sizeof(key_head), "%u\x1f%d\x1f",
+                             (unsigned int)line_num, (int)code);
+    detail_len = (detail != NULL_PTR) ? util_strlen(detail) : 0;
+    key = (char*)util_malloc(head_len + detail_len + 1);
+    if (key == NULL_PTR) {
+        t_appending = 0;
+        return 0;
+    }
+    copy_bytes(key, key_head, head_len);
+    if (detail_len > 0) {
+        copy_bytes(key + head_len, detail, detail_len);
+    }
+    key[head_len + detail_len] = '\0';
+
+    duplicate = (util_ht_lookup(ctx->seen, key) != NULL_PTR);
+    if (!duplicate) {
+        util_ht_insert(ctx->seen, key, ctx);
+    }
+    util_free(key);
+
+    t_appending = 0;
+    return duplicate;
+}
+
+/*
+ * 函数: text_reserve
+ * 描述: 确保文本缓冲区还能追加 extra 个字符（外加终止符）。
+ */
+static int text_reserve(TextBuffer* text, u32 extra) {
+    if (text->failed) {
+        return 0;
+    }
+    if (text->len + extra + 1 > text->capacity) {
+        u32 new_capacity = (text->capacity == 0) ? 4096 : text->capacity;
+        char* grown;
+        while (text->len + extra + 1 > new_capacity) {
+            new_capacity *= 2;
+        }
+        grown = (char*)util_malloc(new_capacity);
+        if (grown == NULL_PTR) {
+            text->failed = 1;
+            return 0;
+        }
+        if (text->len > 0) {
+            copy_bytes(grown, text->data, text->len);
+        }
+        util_free(text->data);
+        text->data = grown;
+        text->capacity = new_capacity;
+    }
+    return 1;
+}
+
+/*
+ * 函数: text_append
+ * 描述: 向文本缓冲区追加 len 个字符。
+ */
+static void text_append(TextBuffer* text, const char* str, u32 len) {
+    if (!text_reserve(text, len)) {
+        return;
+    }
+    copy_bytes(text->data + text->len, str, len);
+    text->len += len;
+    text->data[text->len] = '\0';
+}
+
+/*
+ * 函数: append_snippet
+ * 描述: 通过行首偏移索引 O(1) 定位第 line_num 行，追加 "   N | 源代码" 一行。
+ */
+static void append_snippet(TextBuffer* text, const ErrorContext* ctx, u32 line_num) {
+    char prefix[24];
+    u32 start;
+    u32 end;
+    int prefix_len;
+
+    if (ctx->source == NULL_PTR || line_num == 0 || line_num > ctx->line_count) {
+        return;
+    }
+
+    start = ctx->line_starts[line_num - 1];
+    end = start;
+    while (end < ctx->source_len && ctx->source[end] != '\n' &&
+           end - start < ERROR_SNIPPET_MAX) {
+        end++;
+    }
+    if (end > start && ctx->source[end - 1] == '\r') {
+        end--;
+    }
+    if (end == start) {
+        return;
+    }
+
+    prefix_len = snprintf(prefix, sizeof(prefix), "%8u | ", (unsigned int)line_num);
+    text_append(text, prefix, (u32)prefix_len);
+    text_append(text, ctx->source + start, end - start);
+    text_append(text, "\n", 1);
+}
+
 /* --------------------------------------------------------------------------
  * 3. 公共接口实现
  * -------------------------------------------------------------------------- */
 
 void error_init(void) {
-    g_error_count = 0;
+    ErrorContext* ctx = current_context();
+    ctx->count = 0;
+    ctx->kept = 0;
+    ctx->duplicates = 0;
+    ctx->suppressed = 0;
+    error_buffer_dispose(&ctx->log);
+    error_buffer_dispose(&ctx->pending);
+    util_ht_destroy(ctx->seen);
+    ctx->seen = NULL_PTR;
 }
 
 void error_report(u32 line_num, ErrorCode code, const char* detail) {
-    const char* base_msg;
+    ErrorContext* ctx;
 
-    base_msg = find_error_msg(code);
-    g_error_count++;
+    if (t_capture != NULL_PTR) {
+        buffer_append(t_capture, line_num, code, detail);
+        return;
+    }
 
-    /* 统一错误格式输出: [Line XXX] Error E1001: Message (Detail) */
-    fprintf(stderr, "[Line %u] Error E%d: %s", (unsigned int)line_num, (int)code, base_msg);
+    ctx = current_context();
+    ctx->count++;
+
+    /* 超过上限后只计数，不再去重（去重集合大小因此也受上限约束） */
+    if (ctx->limit != 0 && ctx->kept >= ctx->limit) {
+        ctx->suppressed++;
+        return;
+    }
+    if (is_duplicate(ctx, line_num, code, detail)) {
+        ctx->duplicates++;
+        return;
+    }
+    ctx->kept++;
 
-    if (detail != NULL_PTR) {
-        fprintf(stderr, " -> %s", detail);
+    if (ctx->record) {
+        buffer_append(&ctx->log, line_num, code, detail);
     }
+    if (ctx->echo) {
+        buffer_append(&ctx->pending, line_num, code, detail);
+    }
+}
 
-    fprintf(stderr, "\n");
+const char* error_get_message(ErrorCode code) {
+    return find_error_msg(code);
 }
 
 u32 error_get_count(void) {
-    return g_error_count;
+    return current_context()->count;
 }
 
 bool_t error_has_failed(void) {
-    return (g_error_count > 0) ? TRUE : FALSE;
+    return (current_context()->count > 0) ? TRUE : FALSE;
+}
+
+void error_buffer_init(ErrorBuffer* buffer) {
+    buffer->records = NULL_PTR;
+    buffer->count = 0;
+    buffer->capacity = 0;
+    buffer->outer = NULL_PTR;
+}
+
+void error_capture_begin(ErrorBuffer* buffer) {
+    buffer->outer = t_capture;
+    t_capture = buffer;
+}
+
+void error_capture_end(void) {
+    if (t_capture != NULL_PTR) {
+        t_capture = t_capture->outer;
+    }
+}
+
+void error_buffer_replay(const ErrorBuffer* buffer) {
+    u32 i;
+    for (i = 0; i < buffer->count; i++) {
+        error_report(buffer->records[i].line, buffer->records[i].code,
+                     buffer->records[i].detail);
+    }
+}
+
+void error_buffer_dispose(ErrorBuffer* buffer) {
+    u32 i;
+    for (i = 0; i < buffer->count; i++) {
+        util_free(buffer->records[i].detail);
+    }
+    util_free(buffer->records);
+    error_buffer_init(buffer);
 }
 
+void error_context_init(ErrorContext* ctx, int echo, int record) {
+    ctx->count = 0;
+    ctx->echo = echo;
+    ctx->record = record;
+    error_buffer_init(&ctx->log);
+    ctx->limit = 0;
+    ctx->kept = 0;
+    ctx->duplicates = 0;
+    ctx->suppressed = 0;
+    error_buffer_init(&ctx->pending);
+    ctx->seen = NULL_PTR;
+    ctx->source = NULL_PTR;
+    ctx->source_len = 0;
+    ctx->line_starts = NULL_PTR;
+    ctx->line_count = 0;
+    ctx->sink = NULL_PTR;
+    ctx->sink_user = NULL_PTR;
+}
+
+void error_context_dispose(ErrorContext* ctx) {
+    error_buffer_dispose(&ctx->log);
+    error_buffer_dispose(&ctx->pending);
+    util_ht_destroy(ctx->seen);
+    ctx->seen = NULL_PTR;
+    ctx->count = 0;
+    ctx->kept = 0;
+}
+
+ErrorContext* error_bind(ErrorContext* ctx) {
+    ErrorContext* previous = t_context;
+    t_context = ctx;
+    return previous;
+}
+
+void error_set_limit(u32 limit) {
+    current_context()->limit = limit;
+}
 
+void error_set_source(const char* source, u32 len, const u32* line_starts, u32 line_count) {
+    ErrorContext* ctx = current_context();
+    ctx->source = (line_starts != NULL_PTR) ? source : NULL_PTR;
+    ctx->source_len = len;
+    ctx->line_starts = line_starts;
+    ctx->line_count = (ctx->source != NULL_PTR) ? line_count : 0;
+}
+
+void error_flush(void) {
+    ErrorContext* ctx = current_context();
+    TextBuffer text = { NULL_PTR, 0, 0, 0 };
+    char line[64];
+    u32 i;
+
+    if (!ctx->echo || (ctx->pending.count == 0 && ctx->duplicates == 0 && ctx->suppressed == 0)) {
+        error_set_source(NULL_PTR, 0, NULL_PTR, 0);
+        return;
+    }
+
+    /* 统一错误格式输出: [Line XXX] Error E1001: Message -> Detail */
+    for (i = 0; i < ctx->pending.count; i++) {
+        const ErrorRecord* record = &ctx->pending.records[i];
+        const char* base_msg = find_error_msg(record->code);
+        int len = snprintf(line, sizeof(line), "[Line %u] Error E%d: ",
+                           (unsigned int)record->line, (int)record->code);
+        text_append(&text, line, (u32)len);
+        text_append(&text, base_msg, util_strlen(base_msg));
+        if (record->detail != NULL_PTR) {
+            text_append(&text, " -> ", 4);
+            text_append(&text, record->detail, util_strlen(record->detail));
+        }
+        text_append(&text, "\n", 1);
+        append_snippet(&text, ctx, record->line);
+    }
+
+    if (ctx->duplicates > 0) {
+        int len = snprintf(line, sizeof(line), "(%u duplicate error(s) omitted)\n",
+                           (unsigned int)ctx->duplicates);
+        text_append(&text, line, (u32)len);
+    }
+    if (ctx->suppressed > 0) {
+        int len = snprintf(line, sizeof(line), "... %u more error(s) not shown (limit %u)\n",
+                           (unsigned int)ctx->suppressed, (unsigned int)ctx->limit);
+        text_append(&text, line, (u32)len);
+    }
+
+    if (text.len > 0 && ctx->sink != NULL_PTR) {
+        ctx->sink(ctx->sink_user, text.data, text.len);
+    } else if (text.len > 0) {
+        fwrite(text.data, 1, text.len, stderr);
+        fflush(stderr);
+    }
+    util_free(text.data);
+
+    error_buffer_dispose(&ctx->pending);
+    ctx->duplicates = 0;
+    ctx->suppressed = 0;
+    error_set_source(NULL_PTR, 0, NULL_PTR, 0);
+}
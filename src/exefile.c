@@ -0,0 +1,182 @@
+﻿/*
+ * ============================================================================
+ * 文件名: exefile.c
+ * 描述  : EXE 文件实现
+ *
+ * 关键算法：
+ *  1. 由映像大小与修正数算出头部所占节数、文件页数与栈的位置
+ *  2. 按小端顺序写出 28 字节头部
+ *  3. 每个段基址修正规格化为 段:偏移（偏移 < 16）后分批写出
+ *  4. 以 0 填充到节边界，再写出映像
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include "../include/exefile.h"
+
+#define EXEFILE_FIXUP_BATCH     256     /* 每次 fwrite 写出的重定位项数 */
+
+/* ========================================================================= */
+/* 内部辅助函数 */
+/* ========================================================================= */
+
+static u8* put_u16(u8* out, u32 value) {
+    out[0] = (u8)(value & 0xFF);
+    out[1] = (u8)((value >> 8) & 0xFF);
+    return out + 2;
+}
+
+static u32 round_up(u32 value, u32 unit) {
+    return (value + unit - 1) / unit;
+}
+
+/*
+ * 标签所在指令机器码的实际起始偏移（重名标签取拥有符号的首个定义者）
+ */
+static u32 label_offset(const PassOne* pass_one, const u32* offsets, const SymbolInfo* info) {
+    for (u32 i = 0; i < pass_one->instruction_count; i++) {
+        const InstructionEntry* entry = &pass_one->instructions[i];
+        if (entry->has_label && entry->line == info->line_defined &&
+            util_strcmp((const char*)entry->label, info->name) == 0) {
+            return offsets[i];
+        }
+    }
+    return 0;
+}
+
+/*
+ * 写出头部之后的各部分；失败返回 -1
+ */
+static int write_body(FILE* fp, const ExeHeader* header, const ExeImage* image) {
+    u8 buffer[EXEFILE_FIXUP_BATCH * 4];
+    u8* out = buffer;
+    u32 written = EXEFILE_HEADER_SIZE;
+
+    /* 重定位表：偏移 < 16 的 段:偏移 */
+    for (u32 i = 0; i < image->fixup_count; i++) {
+        out = put_u16(out, image->fixups[i] & 0xF);
+        out = put_u16(out, image->fixups[i] >> 4);
+        if (out == buffer + sizeof(buffer) || i + 1 == image->fixup_count) {
+            u32 len = (u32)(out - buffer);
+            if (fwrite(buffer, 1, len, fp) != len) {
+                return -1;
+            }
+            written += len;
+            out = buffer;
+        }
+    }
+
+    /* 填充到头部所占的节数 */
+    u32 padding = (u32)header->header_paragraphs * EXEFILE_PARAGRAPH - written;
+    util_memset(buffer, 0, EXEFILE_PARAGRAPH);
+    if (padding > 0 && fwrite(buffer, 1, padding, fp) != padding) {
+        return -1;
+    }
+
+    if (image->size > 0 && fwrite(image->code, 1, image->size, fp) != image->size) {
+        return -1;
+    }
+    return 0;
+}
+
+/* ========================================================================= */
+/* API 函数实现 */
+/* ========================================================================= */
+
+u32 exefile_entry_point(const PassOne* pass_one, const u32* offsets) {
+    for (u32 i = pass_one->instruction_count; i > 0; i--) {
+        const InstructionEntry* entry = &pass_one->instructions[i - 1];
+        if (!entry->has_error && util_strcmp((const char*)entry->mnemonic, "END") == 0) {
+            if (entry->operand_count == 0 || entry->operands[0].type != OPERAND_LABEL) {
+                return 0;
+            }
+            const SymbolInfo* info = symtab_lookup(pass_one->symtab,
+                                                   (const char*)entry->operands[0].name);
+            if (info == NULL_PTR || !info->is_defined || info->type == SYM_EXTERNAL) {
+                return 0;
+            }
+            return label_offset(pass_one, offsets, info);
+        }
+    }
+    return 0;
+}
+
+int exefile_build_header(const ExeImage* image, ExeHeader* out) {
+    u32 stack = (image->stack_size != 0) ? image->stack_size : EXEFILE_DEFAULT_STACK;
+    u32 header_paragraphs = round_up(EXEFILE_HEADER_SIZE + image->fixup_count * 4, EXEFILE_PARAGRAPH);
+    u32 image_paragraphs = round_up(image->size, EXEFILE_PARAGRAPH);
+    u32 file_size = header_paragraphs * EXEFILE_PARAGRAPH + image->size;
+
+    /* 栈保持字对齐 */
+    stack = (stack + 1) & ~1u;
+    if (image->fixup_count > 0xFFFF || stack > 0xFFFE || image_paragraphs > 0xFFFF ||
+        header_paragraphs > 0xFFFF || round_up(file_size, EXEFILE_PAGE_SIZE) > 0xFFFF ||
+        image->entry > 0xFFFF) {
+        return -1;
+    }
+    for (u32 i = 0; i < image->fixup_count; i++) {
+        if (image->fixups[i] + 2 > image->size) {
+            return -1;
+        }
+    }
+
+    out->magic = 0x5A4D;
+    out->last_page_bytes = (u16)(file_size % EXEFILE_PAGE_SIZE);
+    out->page_count = (u16)round_up(file_size, EXEFILE_PAGE_SIZE);
+    out->relocation_count = (u16)image->fixup_count;
+    out->header_paragraphs = (u16)header_paragraphs;
+    out->min_alloc = (u16)round_up(stack, EXEFILE_PARAGRAPH);
+    out->max_alloc = 0xFFFF;
+    out->initial_ss = (u16)image_paragraphs;
+    out->initial_sp = (u16)stack;
+    out->checksum = 0;
+    out->initial_ip = (u16)image->entry;
+    out->initial_cs = 0;
+    out->relocation_offset = EXEFILE_HEADER_SIZE;
+    out->overlay = 0;
+    return 0;
+}
+
+int exefile_write(const char* path, const ExeImage* image) {
+    ExeHeader header;
+    u8 bytes[EXEFILE_HEADER_SIZE];
+    u8* out = bytes;
+
+    if (exefile_build_header(image, &header) != 0) {
+        return -1;
+    }
+
+    out = put_u16(out, header.magic);
+    out = put_u16(out, header.last_page_bytes);
+    out = put_u16(out, header.page_count);
+    out = put_u16(out, header.relocation_count);
+    out = put_u16(out, header.header_paragraphs);
+    out = put_u16(out, header.min_alloc);
+    out = put_u16(out, header.max_alloc);
+    out = put_u16(out, header.initial_ss);
+    out = put_u16(out, header.initial_sp);
+    out = put_u16(out, header.checksum);
+    out = put_u16(out, header.initial_ip);
+    out = put_u16(out, header.initial_cs);
+    out = put_u16(out, header.relocation_offset);
+    out = put_u16(out, header.overlay);
+
+    FILE* fp = fopen(path, "wb");
+    if (fp == NULL_PTR) {
+        return -1;
+    }
+
+    int result = 0;
+    if (fwrite(bytes, 1, EXEFILE_HEADER_SIZE, fp) != EXEFILE_HEADER_SIZE ||
+        write_body(fp, &header, image) != 0) {
+        result = -1;
+    }
+    if (fclose(fp) != 0) {
+        result = -1;
+    }
+    if (result != 0) {
+        remove(path);
+    }
+    return result;
+}
@@ -0,0 +1,1051 @@
+﻿/*
+ * ============================================================================
+ * 文件名: incremental.c
+ * 描述  : 增量汇编实现
+ *
+ * 一次编辑的处理流程：
+ *  1. 按编辑前的行索引确定受影响的整行区间 [k0, k1]，修改源文本
+ *  2. 只对该区间的新文本做词法分析与第一遍扫描（行号、地址从区间起点继续）
+ *  3. 撤销区间内旧条目定义的标签，登记新标签
+ *  4. 把新条目拼接进条目列数组，其后各条目的行号整体平移，
+ *     地址从区间起点按长度重新累加，直到与旧地址重合为止
+ *  5. 新条目编码到暂存缓冲区后拼入机器码，其后字节与重定位按差值平移
+ *  6. 区间内的诊断替换会话保存的旧诊断，其后行号平移；重新报告全部诊断
+ *  7. 重新解析全部重定位，只改写值发生变化的两个字节
+ *
+ * 出错的行与完整汇编一样保留为占位条目（不生成代码），因此有错误的状态同样可以增量编辑；
+ * 各行的诊断按行号升序保存在会话中，未定义符号等跨行诊断每次编辑后重新计算。
+ *
+ * 条目的行号、地址、长度与机器码位置以列数组保存，平移时顺序扫描连续内存；
+ * 条目结构体内的 address / line 字段在增量编辑后不再维护。
+ *
+ * ============================================================================
+ */
+
+#include "../include/incremental.h"
+#include "../include/lexer.h"
+#include "../include/semantic.h"
+#include "../include/codegen.h"
+
+#define INCREMENTAL_MIN_ENTRIES     256
+#define INCREMENTAL_MIN_TOKENS      256
+
+/* 增量汇编会话 */
+struct IncrementalAsm {
+    char* source;               /* 当前源文本 */
+    u32 length;                 /* 源文本字节数 */
+    u32 source_capacity;        /* 源文本缓冲区容量 */
+    LineIndex lines;            /* 当前源文本的行首偏移 */
+
+    PassOne* pass_one;          /* 最近一次完整汇编的结果：拥有符号表与初始条目数组 */
+    InstructionEntry** entries; /* 条目指针：指向 pass_one 的条目数组或单独分配的新条目 */
+    u32* entry_line;            /* 条目所在行号 */
+    u32* entry_address;         /* 条目的第一遍估计地址（标签地址取 code_offset） */
+    u32* entry_length;          /* 条目长度 */
+    u32* code_offset;           /* 条目机器码在代码缓冲区中的偏移 */
+    u32* code_length;           /* 条目机器码字节数 */
+    SymbolInfo** owner;         /* 条目定义的符号（无标签或非首个定义者为 NULL_PTR） */
+    u32 count;                  /* 条目数 */
+    u32 capacity;               /* 列数组容量 */
+    u32 end_address;            /* 最后一个条目之后的地址 */
+
+    CodeGen* codegen;           /* 全部机器码与重定位 */
+    CodeGen* scratch;           /* 被编辑条目的暂存编码 */
+    ErrorBuffer diagnostics;    /* 各行的诊断（按行号升序，不含重定位解析的诊断） */
+    u32 orphan_labels;          /* 标签与它行重名、不拥有符号的条目数 */
+    int incomplete;             /* 上一次完整汇编中途失败（内存不足等），下一次编辑须完整汇编 */
+    int has_errors;             /* 当前源文本有汇编错误 */
+    IncrementalStats stats;
+};
+
+/* 一次编辑所涉及的行区间（行号从 0 计） */
+typedef struct {
+    u32 first_line;             /* 受影响的首行 k0 */
+    u32 old_lines;              /* 编辑前区间行数 */
+    u32 span_start;             /* 区间起始偏移（编辑前后相同） */
+    u32 span_end;               /* 编辑后区间结束偏移 */
+} EditSpan;
+
+/* ========================================================================= */
+/* 内部辅助函数 */
+/* ========================================================================= */
+
+/*
+ * 在 base 指向的数组内把 [from, from + n) 移到 to 处（区间可重叠）
+ */
+static void move_elements(void* base, u32 elem_size, u32 from, u32 to, u32 n) {
+    u8* bytes = (u8*)base;
+    u32 size = n * elem_size;
+    u8* src = bytes + (u64)from * elem_size;
+    u8* dst = bytes + (u64)to * elem_size;
+
+    if (to < from) {
+        for (u32 i = 0; i < size; i++) dst[i] = src[i];
+    } else if (to > from) {
+        for (u32 i = size; i > 0; i--) dst[i - 1] = src[i - 1];
+    }
+}
+
+/*
+ * 把列数组扩容到 capacity 个元素并复制前 count 个；失败时原数组不变
+ */
+static int grow_column(void** column, u32 elem_size, u32 count, u32 capacity) {
+    u8* grown = (u8*)util_malloc(elem_size * capacity);
+    if (grown == NULL_PTR) {
+        return -1;
+    }
+    if (*column != NULL_PTR) {
+        const u8* old = (const u8*)*column;
+        for (u32 i = 0; i < count * elem_size; i++) grown[i] = old[i];
+        util_free(*column);
+    }
+    *column = grown;
+    return 0;
+}
+
+/*
+ * 确保列数组至少容纳 needed 个条目
+ */
+static int reserve_entries(IncrementalAsm* inc, u32 needed) {
+    u32 capacity = (inc->capacity == 0) ? INCREMENTAL_MIN_ENTRIES : inc->capacity;
+
+    if (needed <= inc->capacity) {
+        return 0;
+    }
+    while (capacity < needed) {
+        if (capacity > 0xFFFFFFFFu / 2 / sizeof(InstructionEntry*)) {
+            return -1;
+        }
+        capacity *= 2;
+    }
+
+    if (grow_column((void**)&inc->entries, sizeof(InstructionEntry*), inc->count, capacity) != 0 ||
+        grow_column((void**)&inc->owner, sizeof(SymbolInfo*), inc->count, capacity) != 0 ||
+        grow_column((void**)&inc->entry_line, sizeof(u32), inc->count, capacity) != 0 ||
+        grow_column((void**)&inc->entry_address, sizeof(u32), inc->count, capacity) != 0 ||
+        grow_column((void**)&inc->entry_length, sizeof(u32), inc->count, capacity) != 0 ||
+        grow_column((void**)&inc->code_offset, sizeof(u32), inc->count, capacity) != 0 ||
+        grow_column((void**)&inc->code_length, sizeof(u32), inc->count, capacity) != 0) {
+        /* 部分列已扩容也无妨：容量仍记为旧值，下次调用重新分配全部列 */
+        return -1;
+    }
+    inc->capacity = capacity;
+    return 0;
+}
+
+/*
+ * 条目是否位于最近一次完整汇编的条目数组内（这些条目不单独释放）
+ */
+static int is_pass_one_entry(const IncrementalAsm* inc, const InstructionEntry* entry) {
+    const InstructionEntry* base = inc->pass_one->instructions;
+    return entry >= base && entry < base + inc->pass_one->instruction_count;
+}
+
+/*
+ * 释放全部条目、符号表与机器码
+ */
+static void release_entries(IncrementalAsm* inc) {
+    for (u32 i = 0; i < inc->count; i++) {
+        if (inc->pass_one == NULL_PTR || !is_pass_one_entry(inc, inc->entries[i])) {
+            util_free(inc->entries[i]);
+        }
+    }
+    inc->count = 0;
+    inc->end_address = 0;
+    inc->orphan_labels = 0;
+    error_buffer_dispose(&inc->diagnostics);
+
+    semantic_pass_one_destroy(inc->pass_one);
+    inc->pass_one = NULL_PTR;
+
+    inc->codegen->pass_one = NULL_PTR;
+    inc->codegen->code_size = 0;
+    inc->codegen->relocation_count = 0;
+    inc->codegen->has_errors = 0;
+}
+
+/*
+ * 对 text 做词法分析，Token 行号加上 line_base；lines 非空时同时建立行索引
+ */
+static Token* lex_text(const char* text, u32 len, LineIndex* lines, u32 line_base, u32* out_count) {
+    u32 capacity = INCREMENTAL_MIN_TOKENS;
+    u32 count = 0;
+    int has_eof = 0;
+
+    UtilMemTag previous = util_mem_set_tag(UTIL_MEM_LEXER);
+    Lexer* lexer = lexer_create_from_buffer(text, len);
+    Token* tokens = (Token*)util_malloc(sizeof(Token) * capacity);
+    if (lexer == NULL_PTR || tokens == NULL_PTR) {
+        lexer_destroy(lexer);
+        util_free(tokens);
+        util_mem_set_tag(previous);
+        return NULL_PTR;
+    }
+    if (lines != NULL_PTR) {
+        lexer_set_line_index(lexer, lines);
+    }
+
+    while (!has_eof) {
+        Token tok = lexer_next_token(lexer);
+
+        if (count >= capacity) {
+            Token* grown = NULL_PTR;
+            if (capacity <= 0xFFFFFFFFu / 2 / sizeof(Token)) {
+                grown = (Token*)util_malloc(sizeof(Token) * capacity * 2);
+            }
+            if (grown == NULL_PTR) {
+                token_dispose(&tok);
+                for (u32 t = 0; t < count; t++) token_dispose(&tokens[t]);
+                util_free(tokens);
+                lexer_destroy(lexer);
+                util_mem_set_tag(previous);
+                return NULL_PTR;
+            }
+            for (u32 t = 0; t < count; t++) {
+                grown[t] = tokens[t];
+            }
+            util_free(tokens);
+            tokens = grown;
+            capacity *= 2;
+        }
+
+        tok.line += line_base;
+        tokens[count++] = tok;
+        has_eof = (tok.type == TOK_EOF);
+    }
+    lexer_destroy(lexer);
+    util_mem_set_tag(previous);
+
+    *out_count = count;
+    return tokens;
+}
+
+static void dispose_tokens(Token* tokens, u32 count) {
+    for (u32 t = 0; t < count; t++) {
+        token_dispose(&tokens[t]);
+    }
+    util_free(tokens);
+}
+
+/*
+ * 条目所拥有的符号：带标签且符号表中的定义行就是该条目所在行
+ */
+static SymbolInfo* owned_symbol(SymbolTable* symtab, const InstructionEntry* entry, u32 line) {
+    if (!entry->has_label) {
+        return NULL_PTR;
+    }
+    SymbolInfo* info = symtab_lookup(symtab, (const char*)entry->label);
+    return (info != NULL_PTR && info->line_defined == line) ? info : NULL_PTR;
+}
+
+/*
+ * 条目是否为 EXTRN/PUBLIC 声明：它们登记的外部符号不归任何标签所有，
+ * 编辑涉及这类行时退回完整汇编
+ */
+static int is_linkage_entry(const InstructionEntry* entry) {
+    return util_strcmp((const char*)entry->mnemonic, "EXTRN") == 0 ||
+           util_strcmp((const char*)entry->mnemonic, "PUBLIC") == 0;
+}
+
+/*
+ * [e0, e1) 之外是否有条目以 name 为标签却不拥有符号（与它行的标签重名）
+ */
+static int has_orphan_label(const IncrementalAsm* inc, const char* name, u32 e0, u32 e1) {
+    for (u32 i = 0; i < inc->count; i++) {
+        if ((i < e0 || i >= e1) && inc->owner[i] == NULL_PTR && inc->entries[i]->has_label &&
+            util_strcmp((const char*)inc->entries[i]->label, name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * 是否含系统错误（内存不足、缓冲区溢出等，不属于任何源代码行）
+ */
+static int has_system_error(const ErrorBuffer* buffer) {
+    for (u32 i = 0; i < buffer->count; i++) {
+        if (buffer->records[i].code == ERR_SYS_OUT_OF_MEM || buffer->records[i].code == ERR_SYS_FILE_IO) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * 把 from 的诊断按行号归并进 into（两者均按行号升序，同一行 into 在前），from 被清空；
+ * 内存不足时返回 -1，两者不变
+ */
+static int merge_diagnostics(ErrorBuffer* into, ErrorBuffer* from) {
+    u32 total = into->count + from->count;
+    u32 a = 0;
+    u32 b = 0;
+
+    if (from->count == 0) {
+        return 0;
+    }
+    ErrorRecord* merged = (ErrorRecord*)util_malloc(sizeof(ErrorRecord) * total);
+    if (merged == NULL_PTR) {
+        return -1;
+    }
+    for (u32 k = 0; k < total; k++) {
+        if (b == from->count || (a < into->count && into->records[a].line <= from->records[b].line)) {
+            merged[k] = into->records[a++];
+        } else {
+            merged[k] = from->records[b++];
+        }
+    }
+    util_free(into->records);
+    into->records = merged;
+    into->count = total;
+    into->capacity = total;
+
+    /* 记录的 detail 已转移到 into */
+    from->count = 0;
+    error_buffer_dispose(from);
+    return 0;
+}
+
+/*
+ * 用 fresh（区间内新行的诊断）替换会话中旧区间 [first, first + old_lines) 行的诊断，
+ * 其后诊断的行号平移
+ */
+static int splice_diagnostics(IncrementalAsm* inc, u32 first, u32 old_lines, u32 new_lines, ErrorBuffer* fresh) {
+    ErrorBuffer* kept = &inc->diagnostics;
+    u32 n = 0;
+
+    for (u32 i = 0; i < kept->count; i++) {
+        ErrorRecord record = kept->records[i];
+        if (record.line >= first && record.line < first + old_lines) {
+            util_free(record.detail);
+            continue;
+        }
+        if (record.line >= first + old_lines) {
+            record.line = record.line - old_lines + new_lines;
+        }
+        kept->records[n++] = record;
+    }
+    kept->count = n;
+    return merge_diagnostics(kept, fresh);
+}
+
+/*
+ * 完整汇编当前源文本，重建全部状态。
+ * 各阶段的诊断先捕获、按行号归并后随行保存，再统一报告；重定位解析的诊断直接报告
+ */
+static int full_build(IncrementalAsm* inc) {
+    ErrorBuffer phases[3];      /* 词法分析、第一遍扫描、编码 */
+    u32 token_count = 0;
+    int failed = 1;
+    int encoded = 0;
+    int kept = 1;
+    Token* tokens;
+
+    release_entries(inc);
+    inc->has_errors = 1;
+    inc->incomplete = 1;
+    inc->stats.full_builds++;
+    for (u32 p = 0; p < 3; p++) {
+        error_buffer_init(&phases[p]);
+    }
+
+    error_capture_begin(&phases[0]);
+    tokens = lex_text(inc->source, inc->length, &inc->lines, 0, &token_count);
+    error_capture_end();
+    if (tokens != NULL_PTR) {
+        error_capture_begin(&phases[1]);
+        inc->pass_one = semantic_pass_one(tokens, token_count);
+        error_capture_end();
+        dispose_tokens(tokens, token_count);
+    }
+
+    /* 编码全部条目，记录各自的机器码位置；出错的条目保留为占位条目，继续处理以报告其余错误 */
+    PassOne* pass_one = inc->pass_one;
+    CodeGen* codegen = inc->codegen;
+    error_capture_begin(&phases[2]);
+    if (pass_one != NULL_PTR && reserve_entries(inc, pass_one->instruction_count) != 0) {
+        error_report(0, ERR_SYS_OUT_OF_MEM, "无法扩展增量汇编条目表");
+    } else if (pass_one != NULL_PTR) {
+        failed = pass_one->has_errors;
+        codegen->pass_one = pass_one;
+        for (u32 i = 0; i < pass_one->instruction_count; i++) {
+            InstructionEntry* entry = &pass_one->instructions[i];
+            u32 offset = codegen->code_size;
+
+            inc->entries[i] = entry;
+            inc->entry_line[i] = entry->line;
+            inc->entry_address[i] = entry->address;
+            inc->entry_length[i] = entry->length;
+            inc->owner[i] = owned_symbol(pass_one->symtab, entry, entry->line);
+            inc->orphan_labels += (entry->has_label && inc->owner[i] == NULL_PTR);
+
+            if (codegen_emit_instruction_at(codegen, entry, i) < 0) {
+                failed = 1;
+            }
+            inc->code_offset[i] = offset;
+            inc->code_length[i] = codegen->code_size - offset;
+        }
+        inc->count = pass_one->instruction_count;
+        inc->end_address = pass_one->current_address;
+        encoded = 1;
+    }
+    error_capture_end();
+
+    /* 内存不足无法保存时直接报告，状态保持不完整 */
+    for (u32 p = 0; p < 3; p++) {
+        if (merge_diagnostics(&inc->diagnostics, &phases[p]) != 0) {
+            error_buffer_replay(&phases[p]);
+            error_buffer_dispose(&phases[p]);
+            kept = 0;
+        }
+    }
+    error_buffer_replay(&inc->diagnostics);
+    if (tokens == NULL_PTR) {
+        error_report(0, ERR_SYS_OUT_OF_MEM, "无法完成词法分析");
+        return -1;
+    }
+    if (!encoded) {
+        return -1;
+    }
+
+    /* 增量汇编维护的是 .COM 映像：段名与外部符号引用与 subas_assemble 的默认格式一样报错 */
+    if (codegen_resolve_reference(codegen) < 0 ||
+        codegen_check_relocations(codegen, CODEGEN_RELOC_MASK(RELOC_OFFSET)) < 0) {
+        failed = 1;
+    }
+
+    inc->incomplete = !kept || has_system_error(&inc->diagnostics);
+    inc->has_errors = failed || inc->diagnostics.count > 0;
+    inc->stats.last_relexed_lines = inc->lines.count;
+    inc->stats.last_reparsed = inc->count;
+    inc->stats.last_readdressed = inc->count;
+    inc->stats.last_reencoded = inc->count;
+    inc->stats.last_patched = codegen->relocation_count;
+    return inc->has_errors ? -1 : 0;
+}
+
+/*
+ * 第一个满足 entry_line[i] >= line 的条目索引
+ */
+static u32 first_entry_at_line(const IncrementalAsm* inc, u32 line) {
+    u32 lo = 0;
+    u32 hi = inc->count;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (inc->entry_line[mid] < line) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * 第一个满足 instruction_index >= index 的重定位索引（重定位按指令顺序记录）
+ */
+static u32 first_relocation_at(const CodeGen* codegen, u32 index) {
+    u32 lo = 0;
+    u32 hi = codegen->relocation_count;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (codegen->relocations[mid].instruction_index < index) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * 偏移 pos 所在的行（行号从 0 计）
+ */
+static u32 line_of_offset(const LineIndex* lines, u32 pos) {
+    u32 lo = 0;
+    u32 hi = lines->count;
+    while (hi - lo > 1) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (lines->starts[mid] <= pos) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * 用 span_lines（区间内相对行首，共 new_lines 行）替换行索引中的旧区间，其后行首平移
+ */
+static int splice_line_index(IncrementalAsm* inc, const EditSpan* span, const LineIndex* span_lines,
+                             u32 new_lines, u32 old_span_len, u32 new_span_len) {
+    LineIndex* lines = &inc->lines;
+    u32 tail = span->first_line + span->old_lines;
+    u32 total = lines->count - span->old_lines + new_lines;
+
+    if (total > lines->capacity) {
+        u32 capacity = (lines->capacity == 0) ? 64 : lines->capacity;
+        while (capacity < total) capacity *= 2;
+        if (grow_column((void**)&lines->starts, sizeof(u32), lines->count, capacity) != 0) {
+            return -1;
+        }
+        lines->capacity = capacity;
+    }
+
+    move_elements(lines->starts, sizeof(u32), tail, span->first_line + new_lines, lines->count - tail);
+    for (u32 k = 0; k < new_lines; k++) {
+        lines->starts[span->first_line + k] = span->span_start + span_lines->starts[k];
+    }
+    for (u32 k = span->first_line + new_lines; k < total; k++) {
+        lines->starts[k] = lines->starts[k] - old_span_len + new_span_len;
+    }
+    lines->count = total;
+    return 0;
+}
+
+/*
+ * 把解析好的区间条目并入会话（local 的条目已编码到 scratch，第 k 条位于 offsets[k]）。
+ * 新标签与其它行重名时的诊断归并进 fresh；*out_r0、*out_r1 给出新条目的重定位区间。
+ * 返回 0 表示完成；-1 表示需要退回完整汇编（状态可能已部分修改，由完整汇编重建）。
+ */
+static int splice_edit(IncrementalAsm* inc, const EditSpan* span, u32 new_lines,
+                       const PassOne* local, const u32* offsets, ErrorBuffer* fresh,
+                       u32* out_r0, u32* out_r1) {
+    CodeGen* codegen = inc->codegen;
+    CodeGen* scratch = inc->scratch;
+    SymbolTable* symtab = inc->pass_one->symtab;
+    u32 first_line = span->first_line + 1;
+    u32 e0 = first_entry_at_line(inc, first_line);
+    u32 e1 = first_entry_at_line(inc, first_line + span->old_lines);
+    u32 old_n = e1 - e0;
+    u32 new_n = local->instruction_count;
+    u32 old_count = inc->count;
+    u32 old_code_start = (e0 < old_count) ? inc->code_offset[e0] : codegen->code_size;
+    u32 old_code_len = ((e1 < old_count) ? inc->code_offset[e1] : codegen->code_size) - old_code_start;
+    u32 new_code_len = scratch->code_size;
+    u32 new_code_size = codegen->code_size - old_code_len + new_code_len;
+    u32 r0 = first_relocation_at(codegen, e0);
+    u32 r1 = first_relocation_at(codegen, e1);
+    u32 new_relocations = codegen->relocation_count - (r1 - r0) + scratch->relocation_count;
+
+    /* 超出代码缓冲区或重定位表：由完整汇编报告 */
+    if (new_code_size + SEMANTIC_MAX_INSTRUCTION_LEN >= CODEGEN_OUTPUT_BUFFER_SIZE ||
+        new_relocations > CODEGEN_MAX_RELOCATIONS ||
+        reserve_entries(inc, old_count - old_n + new_n) != 0) {
+        return -1;
+    }
+
+    /* 被撤销的标签另有重名条目时，由完整汇编决定新的定义者 */
+    for (u32 i = e0; i < e1 && inc->orphan_labels > 0; i++) {
+        if (inc->owner[i] != NULL_PTR && has_orphan_label(inc, inc->owner[i]->name, e0, e1)) {
+            return -1;
+        }
+    }
+
+    /* 1. 撤销旧条目定义的标签，释放单独分配的旧条目 */
+    for (u32 i = e0; i < e1; i++) {
+        if (inc->owner[i] != NULL_PTR) {
+            symtab_remove(symtab, inc->owner[i]->name);
+        } else if (inc->entries[i]->has_label) {
+            inc->orphan_labels--;
+        }
+        if (!is_pass_one_entry(inc, inc->entries[i])) {
+            util_free(inc->entries[i]);
+        }
+    }
+
+    /* 2. 拼接条目列：新条目单独分配，其后条目的行号与机器码偏移平移 */
+    u32 tail_count = old_count - e1;
+    move_elements(inc->entries, sizeof(InstructionEntry*), e1, e0 + new_n, tail_count);
+    move_elements(inc->owner, sizeof(SymbolInfo*), e1, e0 + new_n, tail_count);
+    move_elements(inc->entry_line, sizeof(u32), e1, e0 + new_n, tail_count);
+    move_elements(inc->entry_address, sizeof(u32), e1, e0 + new_n, tail_count);
+    move_elements(inc->entry_length, sizeof(u32), e1, e0 + new_n, tail_count);
+    move_elements(inc->code_offset, sizeof(u32), e1, e0 + new_n, tail_count);
+    move_elements(inc->code_length, sizeof(u32), e1, e0 + new_n, tail_count);
+    inc->count = old_count - old_n + new_n;
+
+    int failed = 0;
+    for (u32 k = 0; k < new_n; k++) {
+        u32 j = e0 + k;
+        const InstructionEntry* parsed = &local->instructions[k];
+        InstructionEntry* entry = failed ? NULL_PTR : (InstructionEntry*)util_malloc(sizeof(InstructionEntry));
+
+        failed |= (entry == NULL_PTR);
+        if (entry != NULL_PTR) {
+            *entry = *parsed;
+        }
+        inc->entries[j] = entry;
+        inc->owner[j] = NULL_PTR;
+        inc->entry_line[j] = parsed->line;
+        inc->entry_length[j] = parsed->length;
+        inc->code_offset[j] = old_code_start + offsets[k];
+        inc->code_length[j] = offsets[k + 1] - offsets[k];
+    }
+    if (failed) {
+        return -1;
+    }
+
+    for (u32 j = e0 + new_n; j < inc->count; j++) {
+        inc->entry_line[j] = inc->entry_line[j] - span->old_lines + new_lines;
+        inc->code_offset[j] = inc->code_offset[j] - old_code_len + new_code_len;
+        /* 标签地址即机器码偏移：后续条目整体平移同一偏移量，符号地址索引的顺序不受影响，可直接改写 */
+        if (inc->owner[j] != NULL_PTR) {
+            inc->owner[j]->line_defined = inc->entry_line[j];
+            inc->owner[j]->address = inc->code_offset[j];
+        }
+    }
+
+    /* 3. 从区间起点重新累加估计地址（供后续编辑的第一遍使用），与旧地址重合后其余条目不变 */
+    u32 address = (e0 > 0) ? inc->entry_address[e0 - 1] + inc->entry_length[e0 - 1] : 0;
+    u32 j = e0;
+    while (j < inc->count && (j < e0 + new_n || inc->entry_address[j] != address)) {
+        inc->entry_address[j] = address;
+        address += inc->entry_length[j];
+        j++;
+    }
+    if (j == inc->count) {
+        inc->end_address = address;
+    }
+    inc->stats.last_readdressed = j - e0;
+
+    /* 4. 按机器码偏移登记新标签。与之前的行重名时与完整汇编一样保留先定义者、在本行报告；
+     *    与之后的行重名时定义者将改变，由完整汇编处理 */
+    ErrorBuffer duplicates;
+    error_buffer_init(&duplicates);
+    for (u32 k = e0; k < e0 + new_n; k++) {
+        const InstructionEntry* entry = inc->entries[k];
+        if (!entry->has_label) {
+            continue;
+        }
+        const char* label = (const char*)entry->label;
+        if (symtab_insert(symtab, label, semantic_label_type(entry), inc->code_offset[k],
+                          inc->entry_line[k]) == 0) {
+            inc->owner[k] = symtab_lookup(symtab, label);
+            continue;
+        }
+        const SymbolInfo* defined = symtab_lookup(symtab, label);
+        if (defined == NULL_PTR || defined->line_defined > inc->entry_line[k]) {
+            error_buffer_dispose(&duplicates);
+            return -1;
+        }
+        inc->orphan_labels++;
+        /* 区间内的重名已由第一遍扫描报告 */
+        const SymbolInfo* parsed = symtab_lookup(local->symtab, label);
+        if (parsed != NULL_PTR && parsed->line_defined == inc->entry_line[k]) {
+            error_capture_begin(&duplicates);
+            error_report(inc->entry_line[k], ERR_PARSE_DUP_LABEL, "标签重复定义");
+            error_capture_end();
+        }
+    }
+    if (merge_diagnostics(fresh, &duplicates) != 0) {
+        error_buffer_dispose(&duplicates);
+        return -1;
+    }
+
+    /* 5. 拼接机器码与重定位 */
+    move_elements(codegen->code_buffer, 1, old_code_start + old_code_len,
+                  old_code_start + new_code_len, codegen->code_size - old_code_start - old_code_len);
+    for (u32 b = 0; b < new_code_len; b++) {
+        codegen->code_buffer[old_code_start + b] = scratch->code_buffer[b];
+    }
+    codegen->code_size = new_code_size;
+
+    u32 old_relocations = codegen->relocation_count;
+    u32 new_r1 = r0 + scratch->relocation_count;
+    move_elements(codegen->relocations, sizeof(Relocation), r1, new_r1, old_relocations - r1);
+    for (u32 r = 0; r < scratch->relocation_count; r++) {
+        codegen->relocations[r0 + r] = scratch->relocations[r];
+        codegen->relocations[r0 + r].offset += old_code_start;
+    }
+    codegen->relocation_count = new_relocations;
+    for (u32 r = new_r1; r < new_relocations; r++) {
+        Relocation* rel = &codegen->relocations[r];
+        rel->offset = rel->offset - old_code_len + new_code_len;
+        rel->instruction_index = rel->instruction_index - old_n + new_n;
+    }
+
+    *out_r0 = r0;
+    *out_r1 = new_r1;
+    inc->stats.last_reparsed = new_n;
+    inc->stats.last_reencoded = new_n;
+    return 0;
+}
+
+/*
+ * SEGMENT 声明的段名（解析重定位时首次遇到符号表之外的名字才建立）
+ */
+static UtilHashTable* collect_segment_names(const IncrementalAsm* inc) {
+    UtilHashTable* names = util_ht_create(16);
+    if (names == NULL_PTR) {
+        return NULL_PTR;
+    }
+    for (u32 i = 0; i < inc->count; i++) {
+        const InstructionEntry* entry = inc->entries[i];
+        if (!entry->has_error && entry->operand_count > 0 &&
+            entry->operands[0].type == OPERAND_LABEL &&
+            util_strcmp((const char*)entry->mnemonic, "SEGMENT") == 0) {
+            util_ht_insert(names, (const char*)entry->operands[0].name, (void*)entry);
+        }
+    }
+    return names;
+}
+
+/*
+ * 重新解析全部重定位，只改写值发生变化的引用（[r0, r1) 为刚编码的引用，不计入改写数）。
+ * 诊断与 codegen_resolve_reference + codegen_check_relocations 一致：未定义符号在首次引用处
+ * 各报告一次；全部解析后报告首个 .COM 无法表示的段名或外部符号引用。
+ * 返回 0 表示全部解析；-1 表示有错误（未定义符号的引用保持原值）
+ */
+static int resolve_relocations(IncrementalAsm* inc, u32 r0, u32 r1) {
+    CodeGen* codegen = inc->codegen;
+    SymbolTable* symtab = inc->pass_one->symtab;
+    UtilHashTable* reported = NULL_PTR;    /* 已报告的未定义符号（首次出现时创建） */
+    UtilHashTable* segments = NULL_PTR;    /* 段名（首次遇到符号表之外的名字时建立） */
+    u32 patched = 0;
+    int result = 0;
+
+    for (u32 r = 0; r < codegen->relocation_count; r++) {
+        Relocation* rel = &codegen->relocations[r];
+        const char* name = (const char*)rel->symbol_name;
+        SymbolInfo* symbol = symtab_lookup(symtab, name);
+        u32 address = 0;
+
+        if (symbol == NULL_PTR && segments == NULL_PTR) {
+            segments = collect_segment_names(inc);
+        }
+        if (symbol == NULL_PTR && segments != NULL_PTR && util_ht_lookup(segments, name) != NULL_PTR) {
+            rel->kind = RELOC_SEGMENT;
+        } else if (symbol == NULL_PTR || !symbol->is_defined) {
+            result = -1;
+            if (reported == NULL_PTR) {
+                reported = util_ht_create(64);
+            }
+            if (reported != NULL_PTR && util_ht_lookup(reported, name) != NULL_PTR) {
+                continue;
+            }
+            if (reported != NULL_PTR) {
+                util_ht_insert(reported, name, inc);
+            }
+            error_report(inc->entry_line[rel->instruction_index], ERR_PARSE_UNDEFINED_LBL, name);
+            continue;
+        } else if (symbol->type == SYM_EXTERNAL) {
+            rel->kind = RELOC_EXTERNAL;
+        } else {
+            rel->kind = RELOC_OFFSET;
+            address = symbol->address;
+        }
+
+        u8 lo = (u8)(address & 0xFF);
+        u8 hi = (u8)((address >> 8) & 0xFF);
+        u8* code = codegen->code_buffer + rel->offset;
+        if (r < r0 || r >= r1) {
+            patched += (code[0] != lo || code[1] != hi);
+        }
+        code[0] = lo;
+        code[1] = hi;
+    }
+
+    for (u32 r = 0; result == 0 && r < codegen->relocation_count; r++) {
+        const Relocation* rel = &codegen->relocations[r];
+        if (rel->kind != RELOC_OFFSET) {
+            error_report(inc->entry_line[rel->instruction_index],
+                         (rel->kind == RELOC_EXTERNAL) ? ERR_PARSE_EXTERN_REF : ERR_PARSE_SEGMENT_REF,
+                         (const char*)rel->symbol_name);
+            result = -1;
+        }
+    }
+
+    util_ht_destroy(reported);
+    util_ht_destroy(segments);
+    inc->stats.last_patched = patched;
+    return result;
+}
+
+/*
+ * 增量处理一次编辑（源文本已修改）：只重新词法分析、解析并编码受影响的行，
+ * 再报告全部诊断。返回 0 表示完成；-1 表示需要退回完整汇编（尚未报告任何诊断）。
+ */
+static int apply_edit(IncrementalAsm* inc, const EditSpan* span, u32 old_span_len) {
+    u32 new_span_len = span->span_end - span->span_start;
+    u32 first_line = span->first_line + 1;
+    u32 e0 = first_entry_at_line(inc, first_line);
+    u32 e1 = first_entry_at_line(inc, first_line + span->old_lines);
+    CodeGen* scratch = inc->scratch;
+    ErrorBuffer lexed;          /* 区间的词法诊断 */
+    ErrorBuffer parsed;         /* 区间的第一遍扫描诊断 */
+    ErrorBuffer encoded;        /* 区间的编码诊断 */
+    LineIndex span_lines;
+    u32 token_count = 0;
+    u32* offsets = NULL_PTR;
+    int linkage = 0;
+    int result = -1;
+
+    /* 重新词法分析、解析并编码区间；诊断先捕获，确定以增量方式完成后才随行保存 */
+    error_buffer_init(&lexed);
+    error_buffer_init(&parsed);
+    error_buffer_init(&encoded);
+    line_index_init(&span_lines);
+
+    error_capture_begin(&lexed);
+    Token* tokens = lex_text(inc->source + span->span_start, new_span_len, &span_lines,
+                             span->first_line, &token_count);
+    error_capture_end();
+    /* 词法分析器按区间内的相对行号报告 */
+    for (u32 i = 0; i < lexed.count; i++) {
+        lexed.records[i].line += span->first_line;
+    }
+
+    error_capture_begin(&parsed);
+    PassOne* local = (tokens != NULL_PTR) ? semantic_pass_one_begin() : NULL_PTR;
+    if (local != NULL_PTR) {
+        local->current_line = first_line;
+        local->current_address = (e0 > 0) ? inc->entry_address[e0 - 1] + inc->entry_length[e0 - 1] : 0;
+        semantic_pass_one_feed(local, tokens, token_count);
+    }
+    error_capture_end();
+
+    /* 出错的条目同样编码：占位条目不生成代码 */
+    error_capture_begin(&encoded);
+    if (local != NULL_PTR) {
+        offsets = (u32*)util_malloc(sizeof(u32) * (local->instruction_count + 1));
+        scratch->code_size = 0;
+        scratch->relocation_count = 0;
+        for (u32 k = 0; k < local->instruction_count && offsets != NULL_PTR; k++) {
+            offsets[k] = scratch->code_size;
+            codegen_emit_instruction_at(scratch, &local->instructions[k], e0 + k);
+        }
+        if (offsets != NULL_PTR) {
+            offsets[local->instruction_count] = scratch->code_size;
+        }
+        /* 新旧区间含 EXTRN/PUBLIC 行时交给完整汇编 */
+        for (u32 k = 0; k < local->instruction_count; k++) {
+            linkage |= is_linkage_entry(&local->instructions[k]);
+        }
+        for (u32 i = e0; i < e1; i++) {
+            linkage |= is_linkage_entry(inc->entries[i]);
+        }
+    }
+    error_capture_end();
+    if (tokens != NULL_PTR) {
+        dispose_tokens(tokens, token_count);
+    }
+
+    int usable = local != NULL_PTR && offsets != NULL_PTR && !linkage &&
+                 !has_system_error(&lexed) && !has_system_error(&parsed) && !has_system_error(&encoded) &&
+                 merge_diagnostics(&lexed, &parsed) == 0 && merge_diagnostics(&lexed, &encoded) == 0;
+    if (usable) {
+        /* 区间内的行首：区间不到源文本末尾时，末尾换行之后的行首属于下一行 */
+        u32 new_lines = 0;
+        u32 r0 = 0;
+        u32 r1 = 0;
+        while (new_lines < span_lines.count &&
+               (span_lines.starts[new_lines] < new_span_len || span->span_end == inc->length)) {
+            new_lines++;
+        }
+
+        if (splice_edit(inc, span, new_lines, local, offsets, &lexed, &r0, &r1) == 0 &&
+            splice_line_index(inc, span, &span_lines, new_lines, old_span_len, new_span_len) == 0 &&
+            splice_diagnostics(inc, first_line, span->old_lines, new_lines, &lexed) == 0) {
+            /* 每次编辑后报告全部诊断：保存的各行诊断在前，重定位解析的诊断在后 */
+            error_buffer_replay(&inc->diagnostics);
+            int unresolved = resolve_relocations(inc, r0, r1);
+            inc->has_errors = (inc->diagnostics.count > 0 || unresolved != 0);
+            inc->stats.last_relexed_lines = new_lines;
+            result = 0;
+        }
+    }
+
+    util_free(offsets);
+    semantic_pass_one_destroy(local);
+    line_index_dispose(&span_lines);
+    error_buffer_dispose(&lexed);
+    error_buffer_dispose(&parsed);
+    error_buffer_dispose(&encoded);
+    return result;
+}
+
+/*
+ * 把源文本 [offset, offset + remove_len) 替换为 text
+ */
+static int replace_text(IncrementalAsm* inc, u32 offset, u32 remove_len, const char* text, u32 text_len) {
+    u32 tail = inc->length - offset - remove_len;
+    u32 new_length = inc->length - remove_len + text_len;
+
+    if (new_length < text_len) {
+        return -1;  /* 长度溢出 */
+    }
+    if (new_length > inc->source_capacity || inc->source == NULL_PTR) {
+        u32 capacity = (inc->source_capacity == 0) ? 256 : inc->source_capacity;
+        while (capacity < new_length) {
+            if (capacity > 0x7FFFFFFFu) {
+                capacity = new_length;
+                break;
+            }
+            capacity *= 2;
+        }
+        if (grow_column((void**)&inc->source, 1, inc->length, capacity) != 0) {
+            return -1;
+        }
+        inc->source_capacity = capacity;
+    }
+
+    move_elements(inc->source, 1, offset + remove_len, offset + text_len, tail);
+    for (u32 i = 0; i < text_len; i++) {
+        inc->source[offset + i] = text[i];
+    }
+    inc->length = new_length;
+    return 0;
+}
+
+/* ========================================================================= */
+/* API 函数实现 */
+/* ========================================================================= */
+
+/*
+ * incremental_create: 创建会话并完整汇编
+ */
+IncrementalAsm* incremental_create(const char* source, u32 len) {
+    IncrementalAsm* inc;
+
+    if (source == NULL_PTR && len > 0) {
+        return NULL_PTR;
+    }
+
+    inc = (IncrementalAsm*)util_malloc(sizeof(IncrementalAsm));
+    if (inc == NULL_PTR) {
+        return NULL_PTR;
+    }
+    util_memset(inc, 0, sizeof(IncrementalAsm));
+    line_index_init(&inc->lines);
+    error_buffer_init(&inc->diagnostics);
+    tables_init();
+
+    inc->codegen = codegen_create(NULL_PTR);
+    inc->scratch = codegen_create(NULL_PTR);
+    if (inc->codegen == NULL_PTR || inc->scratch == NULL_PTR ||
+        replace_text(inc, 0, 0, source, len) != 0) {
+        incremental_destroy(inc);
+        return NULL_PTR;
+    }
+
+    full_build(inc);
+    return inc;
+}
+
+/*
+ * incremental_edit: 替换一段源文本并更新汇编结果
+ */
+int incremental_edit(IncrementalAsm* inc, u32 offset, u32 remove_len, const char* text, u32 text_len) {
+    EditSpan span;
+    u32 old_span_end;
+
+    if (inc == NULL_PTR || offset > inc->length || remove_len > inc->length - offset ||
+        (text == NULL_PTR && text_len > 0)) {
+        return -1;
+    }
+
+    /* 上次完整汇编中途失败（如未能完成词法分析）：修改文本后完整汇编 */
+    if (inc->incomplete || inc->lines.count == 0) {
+        if (replace_text(inc, offset, remove_len, text, text_len) != 0) {
+            error_report(0, ERR_SYS_OUT_OF_MEM, "无法扩展源文本缓冲区");
+            return -1;
+        }
+        return full_build(inc);
+    }
+
+    /* 受影响的整行区间：编辑起点所在行到编辑终点所在行（按编辑前的行索引） */
+    u32 k0 = line_of_offset(&inc->lines, offset);
+    u32 k1 = line_of_offset(&inc->lines, offset + remove_len);
+    span.first_line = k0;
+    span.old_lines = k1 - k0 + 1;
+    span.span_start = inc->lines.starts[k0];
+    old_span_end = (k1 + 1 < inc->lines.count) ? inc->lines.starts[k1 + 1] : inc->length;
+
+    if (replace_text(inc, offset, remove_len, text, text_len) != 0) {
+        error_report(0, ERR_SYS_OUT_OF_MEM, "无法扩展源文本缓冲区");
+        return -1;
+    }
+    span.span_end = old_span_end - remove_len + text_len;
+
+    if (apply_edit(inc, &span, old_span_end - span.span_start) == 0) {
+        inc->stats.incremental_edits++;
+        return inc->has_errors ? -1 : 0;
+    }
+    return full_build(inc);
+}
+
+int incremental_has_errors(const IncrementalAsm* inc) {
+    return (inc == NULL_PTR) || inc->has_errors;
+}
+
+const u8* incremental_get_code(const IncrementalAsm* inc, u32* out_size) {
+    if (inc == NULL_PTR || inc->has_errors) {
+        if (out_size != NULL_PTR) *out_size = 0;
+        return NULL_PTR;
+    }
+    return codegen_get_code_buffer(inc->codegen, out_size);
+}
+
+const char* incremental_get_source(const IncrementalAsm* inc, u32* out_len) {
+    if (out_len != NULL_PTR) {
+        *out_len = (inc != NULL_PTR) ? inc->length : 0;
+    }
+    return (inc != NULL_PTR) ? inc->source : NULL_PTR;
+}
+
+const u32* incremental_get_line_starts(const IncrementalAsm* inc, u32* out_count) {
+    if (out_count != NULL_PTR) {
+        *out_count = (inc != NULL_PTR) ? inc->lines.count : 0;
+    }
+    return (inc != NULL_PTR) ? inc->lines.starts : NULL_PTR;
+}
+
+u32 incremental_get_entry_count(const IncrementalAsm* inc) {
+    return (inc != NULL_PTR) ? inc->count : 0;
+}
+
+int incremental_get_entry(const IncrementalAsm* inc, u32 index, IncrementalEntry* out) {
+    if (inc == NULL_PTR || out == NULL_PTR || index >= inc->count) {
+        return -1;
+    }
+    out->entry = inc->entries[index];
+    out->line = inc->entry_line[index];
+    out->address = inc->code_offset[index];
+    out->length = inc->entry_length[index];
+    /* 有错误时重定位未解析，机器码不完整 */
+    out->code = inc->has_errors ? NULL_PTR : inc->codegen->code_buffer + inc->code_offset[index];
+    out->code_length = inc->has_errors ? 0 : inc->code_length[index];
+    return 0;
+}
+
+u32 incremental_find_line(const IncrementalAsm* inc, u32 line) {
+    return (inc != NULL_PTR) ? first_entry_at_line(inc, line) : 0;
+}
+
+const SymbolInfo* incremental_lookup_symbol(const IncrementalAsm* inc, const char* name) {
+    if (inc == NULL_PTR || inc->pass_one == NULL_PTR || name == NULL_PTR) {
+        return NULL_PTR;
+    }
+    return symtab_lookup(inc->pass_one->symtab, name);
+}
+
+const IncrementalStats* incremental_get_stats(const IncrementalAsm* inc) {
+    return (inc != NULL_PTR) ? &inc->stats : NULL_PTR;
+}
+
+/*
+ * incremental_destroy: 销毁会话
+ */
+void incremental_destroy(IncrementalAsm* inc) {
+    if (inc == NULL_PTR) return;
+
+    if (inc->codegen != NULL_PTR) {
+        release_entries(inc);
+        codegen_destroy(inc->codegen);
+    }
+    codegen_destroy(inc->scratch);
+    util_free(inc->entries);
+    util_free(inc->owner);
+    util_free(inc->entry_line);
+    util_free(inc->entry_address);
+    util_free(inc->entry_length);
+    util_free(inc->code_offset);
+    util_free(inc->code_length);
+    util_free(inc->source);
+    line_index_dispose(&inc->lines);
+    error_buffer_dispose(&inc->diagnostics);
+    util_free(inc);
+}
@@ -0,0 +1,472 @@
+﻿/*
+ * ============================================================================
+ * 文件名: irfile.c
+ * 描述  : IR 文件模块实现
+ *
+ * 关键流程：
+ *  - 序列化：一次遍历指令列表，把指令、实际使用的操作数与各标签和 EXTRN 外部符号的
+ *    首个定义写入临时数组，名字经字符串池驻留；计算各段偏移后一次分配、逐段复制
+ *  - 加载：open + fstat + 一次 mmap，逐项校验文件头、段边界、操作数区间与字符串偏移，
+ *    再解码为 InstructionEntry 数组，符号表由符号数组重建
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../include/irfile.h"
+
+#define IRFILE_ALIGN        8
+#define IRFILE_PATH_MAX     1024
+
+/*
+ * 序列化时的字符串池：每个不同的字符串只分配一次偏移
+ * （哈希表的值指向 offsets 中的槽位，容量按上界一次分配，槽位地址不变）
+ */
+typedef struct {
+    UtilHashTable* index;       /* 字符串 → offsets 中的槽位 */
+    u32* offsets;               /* 第 k 个不同字符串在池中的偏移 */
+    const char** texts;         /* 第 k 个不同字符串（指向 PassOne，写出时复制） */
+    u32 count;                  /* 不同字符串数 */
+    u32 capacity;               /* 槽位容量 */
+    u64 size;                   /* 池字节数 */
+} StringPool;
+
+/* ========================================================================= */
+/* 内部辅助函数 */
+/* ========================================================================= */
+
+/*
+ * 向上对齐到 IRFILE_ALIGN
+ */
+static u64 align_up(u64 value) {
+    return (value + IRFILE_ALIGN - 1) & ~(u64)(IRFILE_ALIGN - 1);
+}
+
+/*
+ * 逐字节复制（不依赖 string.h）
+ */
+static void copy_bytes(u8* dest, const void* src, u64 size) {
+    const u8* from = (const u8*)src;
+    for (u64 i = 0; i < size; i++) {
+        dest[i] = from[i];
+    }
+}
+
+/*
+ * 条目所定义的符号：带标签的指令定义其标签，EXTRN 定义所声明的外部符号；
+ * 重复定义的后继者不拥有符号。返回写入 out 的个数
+ */
+static u32 defined_symbols(const PassOne* pass_one, const InstructionEntry* entry, SymbolInfo** out) {
+    SymbolInfo* info;
+    u32 count = 0;
+
+    if (entry->has_label) {
+        info = symtab_lookup(pass_one->symtab, (const char*)entry->label);
+        if (info != NULL_PTR && info->line_defined == entry->line) {
+            out[count++] = info;
+        }
+    }
+    if (util_strcmp((const char*)entry->mnemonic, "EXTRN") == 0) {
+        for (u32 k = 0; k < entry->operand_count; k++) {
+            if (entry->operands[k].type != OPERAND_LABEL) {
+                continue;
+            }
+            info = symtab_lookup(pass_one->symtab, (const char*)entry->operands[k].name);
+            if (info != NULL_PTR && info->type == SYM_EXTERNAL && info->line_defined == entry->line) {
+                out[count++] = info;
+            }
+        }
+    }
+    return count;
+}
+
+static int pool_init(StringPool* pool, u32 capacity) {
+    pool->index = util_ht_create(1024);
+    pool->offsets = (u32*)util_malloc(sizeof(u32) * capacity);
+    pool->texts = (const char**)util_malloc((u32)sizeof(const char*) * capacity);
+    pool->count = 0;
+    pool->capacity = capacity;
+    pool->size = 0;
+    return (pool->index != NULL_PTR && pool->offsets != NULL_PTR && pool->texts != NULL_PTR) ? 0 : -1;
+}
+
+static void pool_dispose(StringPool* pool) {
+    util_ht_destroy(pool->index);
+    util_free(pool->offsets);
+    util_free(pool->texts);
+}
+
+/*
+ * 驻留 text，返回其在池中的偏移（空串或池已满时返回 IRFILE_NO_STRING）
+ */
+static u32 pool_intern(StringPool* pool, const char* text) {
+    if (text[0] == '\0') {
+        return IRFILE_NO_STRING;
+    }
+
+    const u32* slot = (const u32*)util_ht_lookup(pool->index, text);
+    if (slot != NULL_PTR) {
+        return *slot;
+    }
+    if (pool->count == pool->capacity) {
+        return IRFILE_NO_STRING;
+    }
+
+    u32 k = pool->count++;
+    pool->offsets[k] = (u32)pool->size;
+    pool->texts[k] = text;
+    pool->size += util_strlen(text) + 1;
+    util_ht_insert(pool->index, text, &pool->offsets[k]);
+    return pool->offsets[k];
+}
+
+/*
+ * 校验 [offset, offset + size) 位于映射之内
+ */
+static int section_fits(u64 offset, u64 size, u64 file_size) {
+    return offset % IRFILE_ALIGN == 0 && offset <= file_size && size <= file_size - offset;
+}
+
+/*
+ * 校验字符串偏移：落在池内，且长度小于解码目标字段 limit（IRFILE_NO_STRING 仅在 optional 时允许）
+ */
+static int string_fits(const IrHeader* header, const char* strings, u32 offset, u32 limit, int optional) {
+    if (offset == IRFILE_NO_STRING) {
+        return optional;
+    }
+    if (offset >= header->strings_size) {
+        return 0;
+    }
+    /* 池以 '\0' 结尾（已校验），长度计算不会越界 */
+    return util_strlen(strings + offset) < limit;
+}
+
+/*
+ * 把池内字符串复制到定长字段（长度已在映射时校验）
+ */
+static void copy_string(s8* dest, const IrFile* file, u32 offset) {
+    if (offset == IRFILE_NO_STRING) {
+        dest[0] = '\0';
+        return;
+    }
+    util_strcpy((char*)dest, file->strings + offset);
+}
+
+/*
+ * 映射后的全面校验：段边界、操作数区间、字符串偏移与长度
+ */
+static int validate(const u8* base, u64 size) {
+    const IrHeader* header = (const IrHeader*)base;
+    int valid = header->version == IRFILE_VERSION &&
+                header->byte_order == IRFILE_BYTE_ORDER;
+
+    for (u32 i = 0; valid && i < sizeof(IRFILE_MAGIC); i++) {
+        valid = (header->magic[i] == IRFILE_MAGIC[i]);
+    }
+    valid = valid &&
+        section_fits(header->instructions_offset,
+                     (u64)sizeof(IrInstruction) * header->instruction_count, size) &&
+        section_fits(header->operands_offset, (u64)sizeof(IrOperand) * header->operand_count, size) &&
+        section_fits(header->symbols_offset, (u64)sizeof(IrSymbol) * header->symbol_count, size) &&
+        section_fits(header->strings_offset, header->strings_size, size);
+    if (!valid) {
+        return 0;
+    }
+
+    const IrInstruction* instructions = (const IrInstruction*)(base + header->instructions_offset);
+    const IrOperand* operands = (const IrOperand*)(base + header->operands_offset);
+    const IrSymbol* symbols = (const IrSymbol*)(base + header->symbols_offset);
+    const char* strings = (const char*)base + header->strings_offset;
+    const InstructionEntry* shape = NULL_PTR;      /* 仅用于 sizeof */
+
+    valid = (header->strings_size == 0 || strings[header->strings_size - 1] == '\0');
+    for (u32 i = 0; valid && i < header->instruction_count; i++) {
+        const IrInstruction* ins = &instructions[i];
+        valid = ins->operand_count <= SEMANTIC_MAX_OPERANDS &&
+                ins->first_operand <= header->operand_count &&
+                ins->operand_count <= header->operand_count - ins->first_operand &&
+                string_fits(header, strings, ins->mnemonic, sizeof(shape->mnemonic), 0) &&
+                string_fits(header, strings, ins->label, sizeof(shape->label), 1);
+    }
+    for (u32 i = 0; valid && i < header->operand_count; i++) {
+        valid = string_fits(header, strings, operands[i].name, sizeof(shape->operands[0].name), 1);
+    }
+    for (u32 i = 0; valid && i < header->symbol_count; i++) {
+        valid = string_fits(header, strings, symbols[i].name, 0xFFFFFFFFu, 0);
+    }
+    return valid;
+}
+
+/* ========================================================================= */
+/* API 函数实现 */
+/* ========================================================================= */
+
+u8* irfile_serialize(const PassOne* pass_one, u32* out_size) {
+    IrHeader header;
+    StringPool pool;
+    SymbolInfo* owned[SEMANTIC_MAX_OPERANDS + 1];
+    u32 operand_count = 0;
+    u32 symbol_count = 0;
+    u8* data = NULL_PTR;
+
+    if (pass_one == NULL_PTR || pass_one->has_errors) {
+        return NULL_PTR;
+    }
+
+    /* 第一次遍历只计数：确定临时数组与字符串池槽位的上界 */
+    for (u32 i = 0; i < pass_one->instruction_count; i++) {
+        operand_count += pass_one->instructions[i].operand_count;
+        symbol_count += defined_symbols(pass_one, &pass_one->instructions[i], owned);
+    }
+    u64 slots = (u64)pass_one->instruction_count * 2 + operand_count + symbol_count + 1;
+    u64 fixed = (u64)sizeof(IrInstruction) * pass_one->instruction_count +
+                (u64)sizeof(IrOperand) * operand_count + (u64)sizeof(IrSymbol) * symbol_count;
+    /* util_malloc 以 u32 计字节 */
+    if (slots * sizeof(const char*) > 0xFFFFFFFFu || fixed > 0xFFFFFFFFu) {
+        return NULL_PTR;
+    }
+
+    IrInstruction* instructions = (IrInstruction*)util_malloc(
+        (u32)sizeof(IrInstruction) * pass_one->instruction_count + 1);
+    IrOperand* operands = (IrOperand*)util_malloc((u32)sizeof(IrOperand) * operand_count + 1);
+    IrSymbol* symbols = (IrSymbol*)util_malloc((u32)sizeof(IrSymbol) * symbol_count + 1);
+    int ready = pool_init(&pool, (u32)slots) == 0 &&
+                instructions != NULL_PTR && operands != NULL_PTR && symbols != NULL_PTR;
+
+    /* 第二次遍历：写指令、操作数与符号，名字驻留到字符串池 */
+    u32 next_operand = 0;
+    u32 next_symbol = 0;
+    for (u32 i = 0; ready && i < pass_one->instruction_count; i++) {
+        const InstructionEntry* entry = &pass_one->instructions[i];
+        IrInstruction* ins = &instructions[i];
+
+        ins->address = entry->address;
+        ins->length = entry->length;
+        ins->line = entry->line;
+        ins->mnemonic = pool_intern(&pool, (const char*)entry->mnemonic);
+        ins->label = entry->has_label ? pool_intern(&pool, (const char*)entry->label) : IRFILE_NO_STRING;
+        ins->first_operand = next_operand;
+        ins->operand_count = entry->operand_count;
+        for (u32 k = 0; k < entry->operand_count; k++) {
+            IrOperand* op = &operands[next_operand++];
+            op->type = (u32)entry->operands[k].type;
+            op->value = entry->operands[k].value;
+            op->name = pool_intern(&pool, (const char*)entry->operands[k].name);
+        }
+
+        u32 count = defined_symbols(pass_one, entry, owned);
+        for (u32 k = 0; k < count; k++) {
+            const SymbolInfo* info = owned[k];
+            symbols[next_symbol].name = pool_intern(&pool, info->name);
+            symbols[next_symbol].type = (u32)info->type;
+            symbols[next_symbol].address = info->address;
+            symbols[next_symbol].line_defined = info->line_defined;
+            next_symbol++;
+        }
+    }
+
+    util_memset(&header, 0, sizeof(header));
+    for (u32 i = 0; i < 8; i++) {
+        header.magic[i] = (i < sizeof(IRFILE_MAGIC)) ? IRFILE_MAGIC[i] : '\0';
+    }
+    header.version = IRFILE_VERSION;
+    header.byte_order = IRFILE_BYTE_ORDER;
+    header.instruction_count = pass_one->instruction_count;
+    header.operand_count = operand_count;
+    header.symbol_count = symbol_count;
+    header.code_size = pass_one->current_address;
+    header.line_count = pass_one->current_line;
+
+    u64 instructions_offset = align_up(sizeof(IrHeader));
+    u64 operands_offset = align_up(instructions_offset +
+                                   (u64)sizeof(IrInstruction) * pass_one->instruction_count);
+    u64 symbols_offset = align_up(operands_offset + (u64)sizeof(IrOperand) * operand_count);
+    u64 strings_offset = align_up(symbols_offset + (u64)sizeof(IrSymbol) * symbol_count);
+    u64 total = align_up(strings_offset + pool.size);
+
+    if (ready && total <= 0xFFFFFFFFu) {
+        data = (u8*)util_malloc((u32)total);
+    }
+    if (data != NULL_PTR) {
+        util_memset(data, 0, (u32)total);
+        header.strings_size = (u32)pool.size;
+        header.instructions_offset = (u32)instructions_offset;
+        header.operands_offset = (u32)operands_offset;
+        header.symbols_offset = (u32)symbols_offset;
+        header.strings_offset = (u32)strings_offset;
+
+        copy_bytes(data, &header, sizeof(header));
+        copy_bytes(data + instructions_offset, instructions,
+                   (u64)sizeof(IrInstruction) * pass_one->instruction_count);
+        copy_bytes(data + operands_offset, operands, (u64)sizeof(IrOperand) * operand_count);
+        copy_bytes(data + symbols_offset, symbols, (u64)sizeof(IrSymbol) * symbol_count);
+        for (u32 k = 0; k < pool.count; k++) {
+            copy_bytes(data + strings_offset + pool.offsets[k], pool.texts[k],
+                       util_strlen(pool.texts[k]) + 1);
+        }
+        *out_size = (u32)total;
+    }
+
+    pool_dispose(&pool);
+    util_free(instructions);
+    util_free(operands);
+    util_free(symbols);
+    return data;
+}
+
+int irfile_write(const PassOne* pass_one, const char* path) {
+    char temp[IRFILE_PATH_MAX + 32];
+    u32 size = 0;
+    u8* data;
+    FILE* fp;
+    int result = 0;
+
+    data = irfile_serialize(pass_one, &size);
+    if (data == NULL_PTR) {
+        return -1;
+    }
+
+    snprintf(temp, sizeof(temp), "%s.tmp%ld", path, (long)getpid());
+    fp = fopen(temp, "wb");
+    if (fp == NULL_PTR) {
+        util_free(data);
+        return -1;
+    }
+    if (fwrite(data, 1, size, fp) != size) {
+        result = -1;
+    }
+    if (fclose(fp) != 0) {
+        result = -1;
+    }
+    util_free(data);
+
+    if (result != 0 || rename(temp, path) != 0) {
+        remove(temp);
+        return -1;
+    }
+    return 0;
+}
+
+int irfile_map(const char* path, IrFile* out) {
+    struct stat info;
+    void* base;
+    u64 size;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &info) != 0 || (u64)info.st_size < sizeof(IrHeader)) {
+        close(fd);
+        return -1;
+    }
+
+    size = (u64)info.st_size;
+    base = mmap(NULL_PTR, (size_t)size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+
+    /* 任何不符都按未命中处理，由调用者回退到完整汇编 */
+    if (irfile_view((const u8*)base, size, out) != 0) {
+        munmap(base, (size_t)size);
+        return -1;
+    }
+    return 0;
+}
+
+int irfile_view(const u8* data, u64 size, IrFile* out) {
+    const IrHeader* header = (const IrHeader*)data;
+
+    if (size < sizeof(IrHeader) || !validate(data, size)) {
+        return -1;
+    }
+
+    out->base = data;
+    out->size = size;
+    out->header = header;
+    out->instructions = (const IrInstruction*)(out->base + header->instructions_offset);
+    out->operands = (const IrOperand*)(out->base + header->operands_offset);
+    out->symbols = (const IrSymbol*)(out->base + header->symbols_offset);
+    out->strings = (const char*)(out->base + header->strings_offset);
+    return 0;
+}
+
+void irfile_unmap(IrFile* file) {
+    if (file == NULL_PTR || file->base == NULL_PTR) return;
+
+    munmap((void*)file->base, (size_t)file->size);
+    file->base = NULL_PTR;
+    file->size = 0;
+}
+
+PassOne* irfile_load(const IrFile* file) {
+    const IrHeader* header = file->header;
+    PassOne* pass_one;
+
+    /* util_malloc 以 u32 计字节 */
+    if ((u64)sizeof(InstructionEntry) * header->instruction_count > 0xFFFFFFFFu) {
+        return NULL_PTR;
+    }
+
+    pass_one = (PassOne*)util_malloc(sizeof(PassOne));
+    if (pass_one == NULL_PTR) {
+        return NULL_PTR;
+    }
+
+    pass_one->symtab = symtab_create(header->symbol_count * 2 + 1);
+    pass_one->instructions = (InstructionEntry*)util_malloc(
+        (u32)sizeof(InstructionEntry) * (header->instruction_count > 0 ? header->instruction_count : 1));
+    if (pass_one->symtab == NULL_PTR || pass_one->instructions == NULL_PTR) {
+        symtab_destroy(pass_one->symtab);
+        util_free(pass_one->instructions);
+        util_free(pass_one);
+        return NULL_PTR;
+    }
+
+    for (u32 i = 0; i < header->symbol_count; i++) {
+        const IrSymbol* symbol = &file->symbols[i];
+        if (symtab_insert(pass_one->symtab, file->strings + symbol->name,
+                          (SymbolType)symbol->type, symbol->address,
+                          symbol->line_defined) < 0) {
+            symtab_destroy(pass_one->symtab);
+            util_free(pass_one->instructions);
+            util_free(pass_one);
+            return NULL_PTR;
+        }
+    }
+
+    /* 只填第二遍扫描读取的字段：操作数数组只解码实际使用的前 operand_count 项 */
+    for (u32 i = 0; i < header->instruction_count; i++) {
+        const IrInstruction* ins = &file->instructions[i];
+        InstructionEntry* entry = &pass_one->instructions[i];
+
+        entry->address = ins->address;
+        entry->length = ins->length;
+        entry->line = ins->line;
+        copy_string(entry->mnemonic, file, ins->mnemonic);
+        entry->has_label = (ins->label != IRFILE_NO_STRING);
+        copy_string(entry->label, file, ins->label);
+        entry->operand_count = ins->operand_count;
+        entry->has_error = 0;
+        for (u32 k = 0; k < ins->operand_count; k++) {
+            const IrOperand* op = &file->operands[ins->first_operand + k];
+            entry->operands[k].type = (OperandType)op->type;
+            entry->operands[k].value = op->value;
+            copy_string(entry->operands[k].name, file, op->name);
+        }
+    }
+
+    pass_one->instruction_count = header->instruction_count;
+    pass_one->max_instructions = (header->instruction_count > 0) ? header->instruction_count : 1;
+    pass_one->current_address = header->code_size;
+    pass_one->current_line = header->line_count;
+    pass_one->has_errors = 0;
+    return pass_one;
+}
@@ -0,0 +1,507 @@
+﻿/*
+ * ============================================================================
+ * 文件名: json.c
+ * 描述  : 最小 JSON 模块实现
+ *
+ * 解析器为递归下降：数组元素与对象成员先收集到可增长数组，结束时定长。
+ * 字符串中的 \uXXXX（含代理对）解码为 UTF-8。
+ *
+ * ============================================================================
+ */
+
+#include "../include/json.h"
+
+/* 解析状态 */
+typedef struct {
+    const char* text;
+    u32 len;
+    u32 pos;
+    u32 depth;
+} JsonParser;
+
+/* ========================================================================= */
+/* 内部辅助函数 */
+/* ========================================================================= */
+
+static int parse_value(JsonParser* p, JsonValue* out);
+static void dispose_value(JsonValue* value);
+
+static void skip_space(JsonParser* p) {
+    while (p->pos < p->len) {
+        char c = p->text[p->pos];
+        if (c != ' ' && c != '\t' && c != '\r' && c != '\n') break;
+        p->pos++;
+    }
+}
+
+/*
+ * 匹配字面量（true / false / null）
+ */
+static int match_literal(JsonParser* p, const char* word) {
+    u32 n = util_strlen(word);
+
+    if (p->len - p->pos < n) return 0;
+    for (u32 i = 0; i < n; i++) {
+        if (p->text[p->pos + i] != word[i]) return 0;
+    }
+    p->pos += n;
+    return 1;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/*
+ * 读取 \u 之后的 4 位十六进制数
+ */
+static int read_hex4(JsonParser* p, u32* out) {
+    u32 value = 0;
+
+    if (p->len - p->pos < 4) return -1;
+    for (u32 i = 0; i < 4; i++) {
+        int digit = hex_value(p->text[p->pos + i]);
+        if (digit < 0) return -1;
+        value = (value << 4) | (u32)digit;
+    }
+    p->pos += 4;
+    *out = value;
+    return 0;
+}
+
+/*
+ * 把码点编码为 UTF-8 写入 dest，返回字节数
+ */
+static u32 encode_utf8(u32 cp, char* dest) {
+    if (cp < 0x80) {
+        dest[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        dest[0] = (char)(0xC0 | (cp >> 6));
+        dest[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        dest[0] = (char)(0xE0 | (cp >> 12));
+        dest[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        dest[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    dest[0] = (char)(0xF0 | (cp >> 18));
+    dest[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    dest[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    dest[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+/*
+ * 解析字符串（p->pos 指向开头的引号）；解码结果不会长于原文
+ */
+static int parse_string(JsonParser* p, char** out, u32* out_len) {
+    u32 start = ++p->pos;
+    u32 end = start;
+    u32 n = 0;
+
+    while (end < p->len && p->text[end] != '"') {
+        end += (p->text[end] == '\\') ? 2 : 1;
+    }
+    if (end >= p->len) return -1;
+
+    char* buffer = (char*)util_malloc(end - start + 1);
+    if (buffer == NULL_PTR) return -1;
+
+    while (p->pos < end) {
+        char c = p->text[p->pos++];
+        if ((unsigned char)c < 0x20) {
+            util_free(buffer);
+            return -1;
+        }
+        if (c != '\\') {
+            buffer[n++] = c;
+            continue;
+        }
+        c = p->text[p->pos++];
+        switch (c) {
+            case '"':  buffer[n++] = '"';  break;
+            case '\\': buffer[n++] = '\\'; break;
+            case '/':  buffer[n++] = '/';  break;
+            case 'b':  buffer[n++] = '\b'; break;
+            case 'f':  buffer[n++] = '\f'; break;
+            case 'n':  buffer[n++] = '\n'; break;
+            case 'r':  buffer[n++] = '\r'; break;
+            case 't':  buffer[n++] = '\t'; break;
+            case 'u': {
+                u32 cp;
+                u32 low;
+                if (read_hex4(p, &cp) != 0) {
+                    util_free(buffer);
+                    return -1;
+                }
+                /* 代理对合成一个码点；落单的代理项替换为 U+FFFD */
+                if (cp >= 0xD800 && cp < 0xDC00 && p->pos + 6 <= end &&
+                    p->text[p->pos] == '\\' && p->text[p->pos + 1] == 'u') {
+                    u32 saved = p->pos;
+                    p->pos += 2;
+                    if (read_hex4(p, &low) == 0 && low >= 0xDC00 && low < 0xE000) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    } else {
+                        p->pos = saved;
+                    }
+                }
+                if (cp >= 0xD800 && cp < 0xE000) {
+                    cp = 0xFFFD;
+                }
+                n += encode_utf8(cp, buffer + n);
+                break;
+            }
+            default:
+                util_free(buffer);
+                return -1;
+        }
+    }
+    p->pos = end + 1;
+    buffer[n] = '\0';
+    *out = buffer;
+    *out_len = n;
+    return 0;
+}
+
+/*
+ * 解析数字，只保留整数部分
+ */
+static int parse_number(JsonParser* p, JsonValue* out) {
+    int negative = 0;
+    s64 value = 0;
+    u32 digits = 0;
+
+    if (p->text[p->pos] == '-') {
+        negative = 1;
+        p->pos++;
+    }
+    while (p->pos < p->len && p->text[p->pos] >= '0' && p->text[p->pos] <= '9') {
+        value = value * 10 + (p->text[p->pos++] - '0');
+        digits++;
+    }
+    if (digits == 0) return -1;
+    if (p->pos < p->len && p->text[p->pos] == '.') {
+        p->pos++;
+        while (p->pos < p->len && p->text[p->pos] >= '0' && p->text[p->pos] <= '9') p->pos++;
+    }
+    if (p->pos < p->len && (p->text[p->pos] == 'e' || p->text[p->pos] == 'E')) {
+        p->pos++;
+        if (p->pos < p->len && (p->text[p->pos] == '+' || p->text[p->pos] == '-')) p->pos++;
+        while (p->pos < p->len && p->text[p->pos] >= '0' && p->text[p->pos] <= '9') p->pos++;
+    }
+    out->type = JSON_NUMBER;
+    out->integer = negative ? -value : value;
+    return 0;
+}
+
+/*
+ * 向数组 / 对象追加一项（成员名 key 可为 NULL_PTR）
+ */
+static int append_item(JsonValue* container, u32* capacity, const JsonValue* item, char* key) {
+    if (container->count >= *capacity) {
+        u32 grown_capacity = (*capacity == 0) ? 4 : *capacity * 2;
+        JsonValue* items = (JsonValue*)util_malloc(sizeof(JsonValue) * grown_capacity);
+        char** keys = NULL_PTR;
+        if (items == NULL_PTR) return -1;
+        if (container->type == JSON_OBJECT) {
+            keys = (char**)util_malloc(sizeof(char*) * grown_capacity);
+            if (keys == NULL_PTR) {
+                util_free(items);
+                return -1;
+            }
+        }
+        for (u32 i = 0; i < container->count; i++) {
+            items[i] = container->items[i];
+            if (keys != NULL_PTR) keys[i] = container->keys[i];
+        }
+        util_free(container->items);
+        util_free(container->keys);
+        container->items = items;
+        container->keys = keys;
+        *capacity = grown_capacity;
+    }
+    container->items[container->count] = *item;
+    if (container->keys != NULL_PTR) {
+        container->keys[container->count] = key;
+    }
+    container->count++;
+    return 0;
+}
+
+/*
+ * 解析数组或对象（p->pos 指向 '[' 或 '{'）
+ */
+static int parse_container(JsonParser* p, JsonValue* out, int is_object) {
+    char close = is_object ? '}' : ']';
+    u32 capacity = 0;
+
+    out->type = is_object ? JSON_OBJECT : JSON_ARRAY;
+    if (++p->depth > JSON_MAX_DEPTH) return -1;
+    p->pos++;
+
+    skip_space(p);
+    if (p->pos < p->len && p->text[p->pos] == close) {
+        p->pos++;
+        p->depth--;
+        return 0;
+    }
+
+    for (;;) {
+        JsonValue item;
+        char* key = NULL_PTR;
+        u32 key_len;
+
+        skip_space(p);
+        if (is_object) {
+            if (p->pos >= p->len || p->text[p->pos] != '"' || parse_string(p, &key, &key_len) != 0) {
+                return -1;
+            }
+            skip_space(p);
+            if (p->pos >= p->len || p->text[p->pos] != ':') {
+                util_free(key);
+                return -1;
+            }
+            p->pos++;
+        }
+        if (parse_value(p, &item) != 0) {
+            dispose_value(&item);
+            util_free(key);
+            return -1;
+        }
+        if (append_item(out, &capacity, &item, key) != 0) {
+            dispose_value(&item);
+            util_free(key);
+            return -1;
+        }
+
+        skip_space(p);
+        if (p->pos < p->len && p->text[p->pos] == ',') {
+            p->pos++;
+            continue;
+        }
+        if (p->pos < p->len && p->text[p->pos] == close) {
+            p->pos++;
+            p->depth--;
+            return 0;
+        }
+        return -1;
+    }
+}
+
+static int parse_value(JsonParser* p, JsonValue* out) {
+    util_memset(out, 0, sizeof(JsonValue));
+    skip_space(p);
+    if (p->pos >= p->len) return -1;
+
+    switch (p->text[p->pos]) {
+        case '{': return parse_container(p, out, 1);
+        case '[': return parse_container(p, out, 0);
+        case '"':
+            out->type = JSON_STRING;
+            return parse_string(p, &out->string, &out->length);
+        case 't':
+            out->type = JSON_BOOL;
+            out->integer = 1;
+            return match_literal(p, "true") ? 0 : -1;
+        case 'f':
+            out->type = JSON_BOOL;
+            return match_literal(p, "false") ? 0 : -1;
+        case 'n':
+            return match_literal(p, "null") ? 0 : -1;
+        default:
+            return parse_number(p, out);
+    }
+}
+
+static void dispose_value(JsonValue* value) {
+    for (u32 i = 0; i < value->count; i++) {
+        dispose_value(&value->items[i]);
+        if (value->keys != NULL_PTR) util_free(value->keys[i]);
+    }
+    util_free(value->items);
+    util_free(value->keys);
+    util_free(value->string);
+}
+
+/*
+ * 确保生成器还能追加 extra 字节
+ */
+static int writer_reserve(JsonWriter* writer, u32 extra) {
+    if (writer->failed) return -1;
+    if (writer->len + extra <= writer->capacity) return 0;
+
+    u32 capacity = (writer->capacity == 0) ? 256 : writer->capacity;
+    while (capacity < writer->len + extra) {
+        capacity *= 2;
+    }
+    char* grown = (char*)util_malloc(capacity);
+    if (grown == NULL_PTR) {
+        writer->failed = 1;
+        return -1;
+    }
+    for (u32 i = 0; i < writer->len; i++) grown[i] = writer->data[i];
+    util_free(writer->data);
+    writer->data = grown;
+    writer->capacity = capacity;
+    return 0;
+}
+
+static void writer_append(JsonWriter* writer, const char* text, u32 len) {
+    if (writer_reserve(writer, len) != 0) return;
+    for (u32 i = 0; i < len; i++) {
+        writer->data[writer->len + i] = text[i];
+    }
+    writer->len += len;
+}
+
+/* ========================================================================= */
+/* API 函数实现 */
+/* ========================================================================= */
+
+JsonValue* json_parse(const char* text, u32 len) {
+    JsonParser p;
+    JsonValue* root;
+
+    if (text == NULL_PTR) return NULL_PTR;
+    root = (JsonValue*)util_malloc(sizeof(JsonValue));
+    if (root == NULL_PTR) return NULL_PTR;
+
+    p.text = text;
+    p.len = len;
+    p.pos = 0;
+    p.depth = 0;
+    int result = parse_value(&p, root);
+    skip_space(&p);
+    if (result != 0 || p.pos != p.len) {
+        json_free(root);
+        return NULL_PTR;
+    }
+    return root;
+}
+
+void json_free(JsonValue* value) {
+    if (value == NULL_PTR) return;
+    dispose_value(value);
+    util_free(value);
+}
+
+const JsonValue* json_get(const JsonValue* value, const char* key) {
+    if (value == NULL_PTR || value->type != JSON_OBJECT || key == NULL_PTR) {
+        return NULL_PTR;
+    }
+    for (u32 i = 0; i < value->count; i++) {
+        if (util_strcmp(value->keys[i], key) == 0) {
+            return &value->items[i];
+        }
+    }
+    return NULL_PTR;
+}
+
+s64 json_get_int(const JsonValue* value, const char* key, s64 fallback) {
+    const JsonValue* member = json_get(value, key);
+    return (member != NULL_PTR && member->type == JSON_NUMBER) ? member->integer : fallback;
+}
+
+const char* json_get_string(const JsonValue* value, const char* key) {
+    const JsonValue* member = json_get(value, key);
+    return (member != NULL_PTR && member->type == JSON_STRING) ? member->string : NULL_PTR;
+}
+
+void json_writer_init(JsonWriter* writer) {
+    writer->data = NULL_PTR;
+    writer->len = 0;
+    writer->capacity = 0;
+    writer->failed = 0;
+}
+
+void json_writer_dispose(JsonWriter* writer) {
+    util_free(writer->data);
+    json_writer_init(writer);
+}
+
+void json_write_raw(JsonWriter* writer, const char* text) {
+    writer_append(writer, text, util_strlen(text));
+}
+
+void json_write_string(JsonWriter* writer, const char* text, u32 len) {
+    static const char hex[] = "0123456789abcdef";
+
+    writer_append(writer, "\"", 1);
+    for (u32 i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c == '"' || c == '\\') {
+            char escaped[2] = { '\\', (char)c };
+            writer_append(writer, escaped, 2);
+        } else if (c == '\n') {
+            writer_append(writer, "\\n", 2);
+        } else if (c == '\r') {
+            writer_append(writer, "\\r", 2);
+        } else if (c == '\t') {
+            writer_append(writer, "\\t", 2);
+        } else if (c < 0x20) {
+            char escaped[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+            writer_append(writer, escaped, 6);
+        } else {
+            writer_append(writer, (const char*)&text[i], 1);
+        }
+    }
+    writer_append(writer, "\"", 1);
+}
+
+void json_write_int(JsonWriter* writer, s64 value) {
+    char digits[24];
+    u32 n = 0;
+    u64 magnitude = (value < 0) ? (u64)0 - (u64)value : (u64)value;
+
+    do {
+        digits[n++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0) {
+        digits[n++] = '-';
+    }
+    while (n > 0) {
+        writer_append(writer, &digits[--n], 1);
+    }
+}
+
+void json_write_value(JsonWriter* writer, const JsonValue* value) {
+    if (value == NULL_PTR) {
+        json_write_raw(writer, "null");
+        return;
+    }
+    switch (value->type) {
+        case JSON_NULL:
+            json_write_raw(writer, "null");
+            break;
+        case JSON_BOOL:
+            json_write_raw(writer, value->integer ? "true" : "false");
+            break;
+        case JSON_NUMBER:
+            json_write_int(writer, value->integer);
+            break;
+        case JSON_STRING:
+            json_write_string(writer, value->string, value->length);
+            break;
+        case JSON_ARRAY:
+        case JSON_OBJECT:
+            json_write_raw(writer, value->type == JSON_ARRAY ? "[" : "{");
+            for (u32 i = 0; i < value->count; i++) {
+                if (i > 0) json_write_raw(writer, ",");
+                if (value->type == JSON_OBJECT) {
+                    json_write_string(writer, value->keys[i], util_strlen(value->keys[i]));
+                    json_write_raw(writer, ":");
+                }
+                json_write_value(writer, &value->items[i]);
+            }
+            json_write_raw(writer, value->type == JSON_ARRAY ? "]" : "}");
+            break;
+    }
+}
@@ -17,6 +17,7 @@
 #include "../include/lexer.h"
 #include "../include/utils.h"
 #include "../include/error.h"
+#include "../include/counters.h"
 
 /* 内部辅助函数声明 */
 static int is_alpha(char c);
@@ -25,6 +26,8 @@ static int is_alnum(char c);
 static char peek_char(Lexer* lx);
 static char advance_char(Lexer* lx);
 static void skip_whitespace_and_comments(Lexer* lx);
+static void line_index_add(LineIndex* index, u32 offset);
+static int refill(Lexer* lx);
 
 /* 判断字母（仅 ASCII） */
 static int is_alpha(char c) {
@@ -41,23 +44,81 @@ static int is_alnum(char c) {
     return is_alpha(c) || is_digit(c);
 }
 
+/*
+ * 流式模式下补充输入窗口：把当前 Token 起点之前的内容丢弃、其后的内容前移，
+ * 再读入新数据；Token 长度达到窗口容量时把窗口翻倍。
+ * 返回 1 表示读到了新数据，0 表示输入结束（整块模式总是返回 0）。
+ */
+static int refill(Lexer* lx) {
+    u32 keep;
+    u32 got;
+
+    if (lx->read == NULL_PTR || lx->eof) return 0;
+
+    keep = lx->len - lx->mark;
+    if (lx->mark > 0) {
+        u32 i;
+        for (i = 0; i < keep; i++) lx->buffer[i] = lx->buffer[lx->mark + i];
+        lx->base += lx->mark;
+        lx->pos -= lx->mark;
+        lx->len = keep;
+        lx->mark = 0;
+    }
+
+    if (lx->len >= lx->capacity) {
+        u32 new_capacity = lx->capacity * 2;
+        char* grown = (char*)util_malloc(new_capacity + 1);
+        u32 i;
+        if (grown == NULL_PTR) {
+            error_report(lx->line, ERR_SYS_OUT_OF_MEM, "Token exceeds input window");
+            lx->eof = 1;
+            return 0;
+        }
+        for (i = 0; i < lx->len; i++) grown[i] = lx->buffer[i];
+        util_free(lx->buffer);
+        lx->buffer = grown;
+        lx->capacity = new_capacity;
+    }
+
+    got = lx->read(lx->read_user, lx->buffer + lx->len, lx->capacity - lx->len);
+    if (got == 0) {
+        lx->eof = 1;
+        return 0;
+    }
+    lx->len += got;
+    lx->buffer[lx->len] = '\0';
+    return 1;
+}
+
+/* 是否还有未读字符（必要时补充窗口） */
+static int has_input(Lexer* lx) {
+    return lx->pos < lx->len || refill(lx);
+}
+
 /* 返回当前字符但不前进 */
 static char peek_char(Lexer* lx) {
-    if (lx->pos >= lx->len) return '\0';
+    if (!has_input(lx)) return '\0';
     return lx->buffer[lx->pos];
 }
 
-/* 返回当前字符并前进位置 */
+/* 返回当前字符之后的一个字符但不前进 */
+static char peek_next_char(Lexer* lx) {
+    while (lx->pos + 1 >= lx->len) {
+        if (!refill(lx)) return '\0';
+    }
+    return lx->buffer[lx->pos + 1];
+}
+
+/* 返回当前字符并前进位置（以长度判断结束，源文本中的 '\0' 也会被跳过） */
 static char advance_char(Lexer* lx) {
-    char c = peek_char(lx);
-    if (c == '\0') return '\0';
-    lx->pos++;
-    return c;
+    if (!has_input(lx)) return '\0';
+    return lx->buffer[lx->pos++];
 }
 
 /* 跳过空白与注释；注释以 ';' 开始至行尾 */
 static void skip_whitespace_and_comments(Lexer* lx) {
     for (;;) {
+        lx->mark = lx->pos; /* 空白与注释无需保留，补充窗口时可丢弃 */
         char c = peek_char(lx);
         if (c == ' ' || c == '\t' || c == '\r') {
             advance_char(lx);
@@ -67,6 +128,7 @@ static void skip_whitespace_and_comments(Lexer* lx) {
             /* 注释：跳到行尾或文件结束 */
             while (peek_char(lx) != '\0' && peek_char(lx) != '\n') {
                 advance_char(lx);
+                lx->mark = lx->pos;
             }
             continue; /* 继续外层循环以处理可能的空白 */
         }
@@ -76,6 +138,12 @@ static void skip_whitespace_and_comments(Lexer* lx) {
 
 /* 创建词法器：复制输入文本以便本模块管理其生命周期 */
 Lexer* lexer_create_from_string(const char* src) {
+    if (src == NULL_PTR) return NULL_PTR;
+    return lexer_create_from_buffer(src, util_strlen(src));
+}
+
+/* 创建词法器：按给定长度复制输入文本 */
+Lexer* lexer_create_from_buffer(const char* src, u32 len) {
     Lexer* lx;
     if (src == NULL_PTR) return NULL_PTR;
 
@@ -85,7 +153,7 @@ Lexer* lexer_create_from_string(const char* src) {
         return NULL_PTR;
     }
 
-    lx->len = util_strlen(src);
+    lx->len = len;
     lx->buffer = util_malloc(lx->len + 1);
     if (lx->buffer == NULL_PTR) {
         error_report(0, ERR_SYS_OUT_OF_MEM, NULL_PTR);
@@ -101,9 +169,53 @@ Lexer* lexer_create_from_string(const char* src) {
 
     lx->pos = 0;
     lx->line = 1;
+    lx->lines = NULL_PTR;
+    lx->read = NULL_PTR;
+    lx->read_user = NULL_PTR;
+    lx->capacity = len;
+    lx->mark = 0;
+    lx->base = 0;
+    lx->eof = 1;
+    return lx;
+}
+
+/* 创建词法器：从流式输入读取，只保留固定大小的窗口 */
+Lexer* lexer_create_from_stream(LexerReadFunc read, void* user, u32 window) {
+    Lexer* lx;
+    if (read == NULL_PTR) return NULL_PTR;
+    if (window == 0) window = LEXER_STREAM_WINDOW;
+
+    lx = (Lexer*)util_malloc(sizeof(Lexer));
+    if (lx == NULL_PTR) {
+        error_report(0, ERR_SYS_OUT_OF_MEM, NULL_PTR);
+        return NULL_PTR;
+    }
+
+    lx->buffer = (char*)util_malloc(window + 1);
+    if (lx->buffer == NULL_PTR) {
+        error_report(0, ERR_SYS_OUT_OF_MEM, NULL_PTR);
+        util_free(lx);
+        return NULL_PTR;
+    }
+    lx->buffer[0] = '\0';
+
+    lx->pos = 0;
+    lx->len = 0;
+    lx->line = 1;
+    lx->lines = NULL_PTR;
+    lx->read = read;
+    lx->read_user = user;
+    lx->capacity = window;
+    lx->mark = 0;
+    lx->base = 0;
+    lx->eof = 0;
     return lx;
 }
 
+u64 lexer_bytes_read(const Lexer* lx) {
+    return lx->base + lx->len;
+}
+
 /* 销毁词法器，释放内部缓冲区 */
 void lexer_destroy(Lexer* lx) {
     if (lx == NULL_PTR) return;
@@ -122,9 +234,9 @@ void token_dispose(Token* tok) {
 
 /* 解析下一个标识符/关键字 */
 static Token lex_identifier(Lexer* lx) {
-    u32 start = lx->pos;
     while (is_alnum(peek_char(lx))) advance_char(lx);
 
+    u32 start = lx->mark; /* 扫描中可能补充过窗口，起点以 mark 为准 */
     u32 len = lx->pos - start;
     char* buf = (char*)util_malloc(len + 1);
     if (buf == NULL_PTR) {
@@ -153,16 +265,14 @@ static Token lex_identifier(Lexer* lx) {
  *   3. 纯数字：十进制
  */
 static Token lex_number(Lexer* lx) {
-    u32 start = lx->pos;
+    u32 start;
     int is_c_hex = 0;
 
     /* 检查 0x/0X 前缀 */
     if (peek_char(lx) == '0') {
-        if (lx->pos + 1 < lx->len) {
-            char c1 = lx->buffer[lx->pos + 1];
-            if (c1 == 'x' || c1 == 'X') {
-                is_c_hex = 1;
-            }
+        char c1 = peek_next_char(lx);
+        if (c1 == 'x' || c1 == 'X') {
+            is_c_hex = 1;
         }
     }
 
@@ -188,6 +298,7 @@ static Token lex_number(Lexer* lx) {
             error_report(lx->line, ERR_LEX_INVALID_NUM, "invalid hex literal");
         }
 
+        start = lx->mark;
         u32 len = lx->pos - start;
         char* buf = (char*)util_malloc(len + 1);
         if (buf == NULL_PTR) {
@@ -206,7 +317,7 @@ static Token lex_number(Lexer* lx) {
 
     /* MASM 或十进制 */
     u32 cnt = 0;
-    u32 num_end = lx->pos;
+    u32 num_len = 0;    /* 数字部分长度（相对 Token 起点，不受补充窗口影响） */
 
     /* 读取数字和潜在的 A-F 字符 */
     while (1) {
@@ -214,7 +325,7 @@ static Token lex_number(Lexer* lx) {
         if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')) {
             advance_char(lx);
             cnt++;
-            num_end = lx->pos;
+            num_len = lx->pos - lx->mark;
         } else {
             break;
         }
@@ -230,8 +341,9 @@ static Token lex_number(Lexer* lx) {
     if (peek_char(lx) == 'h' || peek_char(lx) == 'H') {
         advance_char(lx);
         /* 作为十六进制解析 */
+        start = lx->mark;
         u32 val = 0;
-        for (u32 i = start; i < num_end; i++) {
+        for (u32 i = start; i < start + num_len; i++) {
             char c = lx->buffer[i];
             u32 digit = 0;
             if (c >= '0' && c <= '9') digit = (u32)(c - '0');
@@ -257,6 +369,7 @@ static Token lex_number(Lexer* lx) {
     }
 
     /* 纯十进制 */
+    start = lx->mark;
     u32 val = 0;
     for (u32 i = start; i < lx->pos; i++) {
         char c = lx->buffer[i];
@@ -284,16 +397,19 @@ static Token lex_number(Lexer* lx) {
 /* 解析字符串文字；支持单引号或双引号，遇到 EOF 报错 */
 static Token lex_string(Lexer* lx) {
     char quote = advance_char(lx); /* 吃掉起始引号 */
-    u32 start = lx->pos;
 
     while (peek_char(lx) != '\0' && peek_char(lx) != quote) {
         if (peek_char(lx) == '\n') {
             /* 字符串跨行：更新行计数并继续 */
             lx->line++;
+            if (lx->lines != NULL_PTR) {
+                line_index_add(lx->lines, (u32)(lx->base + lx->pos + 1));
+            }
         }
         advance_char(lx);
     }
 
+    u32 start = lx->mark + 1;  /* 起始引号之后 */
     u32 len = lx->pos - start; /* 计算不含结束引号的长度 */
 
     if (peek_char(lx) != quote) {
@@ -320,8 +436,26 @@ static Token lex_string(Lexer* lx) {
     return t;
 }
 
-/* 主接口：返回下一个 token */
-Token lexer_next_token(Lexer* lx) {
+/* 追加一行的行首偏移；内存不足时停止记录（只影响诊断中的源代码片段） */
+static void line_index_add(LineIndex* index, u32 offset) {
+    if (index->count >= index->capacity) {
+        u32 new_capacity = (index->capacity == 0) ? 256 : index->capacity * 2;
+        u32* grown = (u32*)util_malloc(sizeof(u32) * new_capacity);
+        if (grown == NULL_PTR) {
+            return;
+        }
+        for (u32 i = 0; i < index->count; i++) {
+            grown[i] = index->starts[i];
+        }
+        util_free(index->starts);
+        index->starts = grown;
+        index->capacity = new_capacity;
+    }
+    index->starts[index->count++] = offset;
+}
+
+/* 扫描下一个 token */
+static Token scan_token(Lexer* lx) {
     Token tok;
     tok.lexeme = NULL_PTR;
     tok.type = TOK_EOF;
@@ -331,7 +465,8 @@ Token lexer_next_token(Lexer* lx) {
     if (lx == NULL_PTR) return tok;
 
     for (;;) {
-        if (lx->pos >= lx->len) {
+        lx->mark = lx->pos;
+        if (!has_input(lx)) {
             tok.type = TOK_EOF;
             tok.lexeme = NULL_PTR;
             tok.line = lx->line;
@@ -341,7 +476,7 @@ Token lexer_next_token(Lexer* lx) {
         /* 先处理空白和注释（不会吞掉换行） */
         skip_whitespace_and_comments(lx);
 
-        if (lx->pos >= lx->len) {
+        if (!has_input(lx)) {
             tok.type = TOK_EOF;
             tok.lexeme = NULL_PTR;
             tok.line = lx->line;
@@ -354,6 +489,9 @@ Token lexer_next_token(Lexer* lx) {
         if (c == '\n') {
             advance_char(lx);
             lx->line++;
+            if (lx->lines != NULL_PTR) {
+                line_index_add(lx->lines, (u32)(lx->base + lx->pos));
+            }
             tok.type = TOK_NEWLINE;
             tok.lexeme = util_strdup("\n");
             tok.line = lx->line - 1; /* 返回发生换行前的行号 */
@@ -387,16 +525,49 @@ Token lexer_next_token(Lexer* lx) {
             return lex_identifier(lx);
         }
 
-        /* 未识别字符：报告错误并跳过该字符 */
+        /* 未识别字符：报告错误并作为 TOK_OTHER 返回，语法分析据此跳过该行而不再连带报错 */
         {
             char badch[2];
             badch[0] = c; badch[1] = '\0';
             error_report(lx->line, ERR_LEX_INVALID_CHAR, badch);
             advance_char(lx);
-            /* 跳过后继续获取下一个 token */
-            continue;
+            tok.type = TOK_OTHER;
+            tok.lexeme = util_strdup(badch);
+            tok.line = lx->line;
+            return tok;
         }
     }
 }
 
+void line_index_init(LineIndex* index) {
+    index->starts = NULL_PTR;
+    index->count = 0;
+    index->capacity = 0;
+}
+
+void line_index_reset(LineIndex* index) {
+    index->count = 0;
+}
+
+void line_index_dispose(LineIndex* index) {
+    util_free(index->starts);
+    line_index_init(index);
+}
+
+void lexer_set_line_index(Lexer* lx, LineIndex* index) {
+    lx->lines = index;
+    if (index != NULL_PTR) {
+        line_index_reset(index);
+        line_index_add(index, 0);
+    }
+}
+
+/* 主接口：返回下一个 token */
+Token lexer_next_token(Lexer* lx) {
+    Token tok = scan_token(lx);
+    COUNTER_ADD(COUNTER_TOKENS, 1);
+    COUNTER_ADD(COUNTER_TOKEN_BASE + tok.type, 1);
+    return tok;
+}
+
 
@@ -0,0 +1,415 @@
+﻿/*
+ * ============================================================================
+ * 文件名: linetab.c
+ * 描述  : 行号表实现
+ *
+ * 实现要点：
+ *  - 生成：一次遍历指令列表，把每行编码进按上界预分配的行流，再拼成文件
+ *  - 查找：在块索引上二分出不晚于目标地址的最后一块，再从该块首行起解码；
+ *    重复操作码按整段跳过，不逐行展开
+ *  - 解码时对行流做边界检查，损坏的表只会让查找失败而不会越界读取
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../include/linetab.h"
+
+#define LINETAB_PATH_MAX        4096
+#define LINETAB_ROW_MAX_BYTES   11      /* 一般行：操作码 + 两个至多 5 字节的 LEB128 */
+#define LINETAB_OP_GENERAL      0x00
+#define LINETAB_OP_REPEAT_MAX   0x7F
+#define LINETAB_OP_SPECIAL      0x80
+
+/* ========================================================================= */
+/* 内部辅助函数 */
+/* ========================================================================= */
+
+static u32 align4(u32 value) {
+    return (value + 3u) & ~3u;
+}
+
+/*
+ * 行流编码器：记录上一行的增量与尚未写出的重复次数
+ */
+typedef struct {
+    u8* out;                    /* 行流缓冲区 */
+    u32 size;                   /* 已写字节数 */
+    int has_previous;           /* 块内是否已有编码过的行（重复操作码的前提） */
+    u32 previous_address;       /* 上一行的地址增量 */
+    s32 previous_line;          /* 上一行的行号增量 */
+    u32 repeat;                 /* 待写出的重复次数 */
+} RowEncoder;
+
+static void put_uleb(RowEncoder* enc, u32 value) {
+    do {
+        u8 byte = (u8)(value & 0x7F);
+        value >>= 7;
+        enc->out[enc->size++] = (value != 0) ? (u8)(byte | 0x80) : byte;
+    } while (value != 0);
+}
+
+static void put_sleb(RowEncoder* enc, s32 value) {
+    int more = 1;
+    while (more) {
+        u8 byte = (u8)(value & 0x7F);
+        value >>= 7;    /* 算术右移 */
+        more = !((value == 0 && (byte & 0x40) == 0) || (value == -1 && (byte & 0x40) != 0));
+        enc->out[enc->size++] = more ? (u8)(byte | 0x80) : byte;
+    }
+}
+
+static void flush_repeat(RowEncoder* enc) {
+    if (enc->repeat > 0) {
+        enc->out[enc->size++] = (u8)enc->repeat;
+        enc->repeat = 0;
+    }
+}
+
+static void encode_row(RowEncoder* enc, u32 address_delta, s32 line_delta) {
+    if (enc->has_previous && address_delta == enc->previous_address &&
+        line_delta == enc->previous_line) {
+        if (++enc->repeat == LINETAB_OP_REPEAT_MAX) {
+            flush_repeat(enc);
+        }
+        return;
+    }
+
+    flush_repeat(enc);
+    if (address_delta >= 1 && address_delta <= 31 && line_delta >= 1 && line_delta <= 4) {
+        enc->out[enc->size++] = (u8)(LINETAB_OP_SPECIAL | ((u32)(line_delta - 1) << 5) | address_delta);
+    } else {
+        enc->out[enc->size++] = LINETAB_OP_GENERAL;
+        put_uleb(enc, address_delta);
+        put_sleb(enc, line_delta);
+    }
+    enc->has_previous = 1;
+    enc->previous_address = address_delta;
+    enc->previous_line = line_delta;
+}
+
+static int get_uleb(const u8* stream, u32* pos, u32 end, u32* out) {
+    u32 value = 0;
+    u32 shift = 0;
+    u8 byte;
+
+    do {
+        if (*pos >= end || shift > 28) return -1;
+        byte = stream[(*pos)++];
+        value |= (u32)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    *out = value;
+    return 0;
+}
+
+static int get_sleb(const u8* stream, u32* pos, u32 end, s32* out) {
+    u32 value = 0;
+    u32 shift = 0;
+    u8 byte;
+
+    do {
+        if (*pos >= end || shift > 28) return -1;
+        byte = stream[(*pos)++];
+        value |= (u32)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    if (shift < 32 && (byte & 0x40)) {
+        value |= ~0u << shift;  /* 符号扩展 */
+    }
+    *out = (s32)value;
+    return 0;
+}
+
+/*
+ * 第 index 个条目是否构成一行：无错误且第二遍实际生成了机器码
+ */
+static int is_row(const PassOne* pass_one, const u32* offsets, u32 index) {
+    return !pass_one->instructions[index].has_error && offsets[index + 1] > offsets[index];
+}
+
+/* ========================================================================= */
+/* API 函数实现 */
+/* ========================================================================= */
+
+u8* linetab_serialize(const PassOne* pass_one, const u32* offsets, const char* name, u32* out_size) {
+    RowEncoder enc;
+    u32 row_count = 0;
+    u32 name_size = (name != NULL_PTR) ? util_strlen(name) : 0;
+
+    if (pass_one == NULL_PTR || offsets == NULL_PTR || out_size == NULL_PTR) {
+        return NULL_PTR;
+    }
+
+    for (u32 i = 0; i < pass_one->instruction_count; i++) {
+        row_count += is_row(pass_one, offsets, i);
+    }
+
+    u32 block_count = (row_count + LINETAB_BLOCK_ROWS - 1) / LINETAB_BLOCK_ROWS;
+    LineTableBlock* blocks = (LineTableBlock*)util_malloc(
+        (block_count > 0 ? block_count : 1) * (u32)sizeof(LineTableBlock));
+    enc.out = (u8*)util_malloc(row_count * LINETAB_ROW_MAX_BYTES + 1);
+    if (blocks == NULL_PTR || enc.out == NULL_PTR) {
+        util_free(blocks);
+        util_free(enc.out);
+        return NULL_PTR;
+    }
+    enc.size = 0;
+    enc.repeat = 0;
+    enc.has_previous = 0;
+    enc.previous_address = 0;
+    enc.previous_line = 0;
+
+    /* 逐行编码；第二遍按指令顺序连续生成机器码，行地址严格递增 */
+    u32 rows = 0;
+    u32 address = 0;
+    u32 line = 0;
+    u32 end_address = 0;
+    for (u32 i = 0; i < pass_one->instruction_count; i++) {
+        const InstructionEntry* entry = &pass_one->instructions[i];
+        if (!is_row(pass_one, offsets, i)) {
+            continue;
+        }
+
+        if (rows % LINETAB_BLOCK_ROWS == 0) {
+            flush_repeat(&enc);
+            enc.has_previous = 0;
+            blocks[rows / LINETAB_BLOCK_ROWS].address = offsets[i];
+            blocks[rows / LINETAB_BLOCK_ROWS].line = entry->line;
+            blocks[rows / LINETAB_BLOCK_ROWS].offset = enc.size;
+        } else {
+            encode_row(&enc, offsets[i] - address, (s32)(entry->line - line));
+        }
+        address = offsets[i];
+        line = entry->line;
+        end_address = offsets[i + 1];
+        rows++;
+    }
+    flush_repeat(&enc);
+    block_count = (rows + LINETAB_BLOCK_ROWS - 1) / LINETAB_BLOCK_ROWS;
+
+    u32 blocks_offset = align4((u32)sizeof(LineTableHeader) + name_size);
+    u32 stream_offset = blocks_offset + block_count * (u32)sizeof(LineTableBlock);
+    u32 total = stream_offset + enc.size;
+    u8* data = (u8*)util_malloc(total);
+    if (data == NULL_PTR) {
+        util_free(blocks);
+        util_free(enc.out);
+        return NULL_PTR;
+    }
+    util_memset(data, 0, total);
+
+    LineTableHeader* header = (LineTableHeader*)data;
+    for (u32 i = 0; i < 4; i++) {
+        header->magic[i] = LINETAB_MAGIC[i];
+    }
+    header->version = LINETAB_VERSION;
+    header->byte_order = LINETAB_BYTE_ORDER;
+    header->row_count = rows;
+    header->block_count = block_count;
+    header->end_address = end_address;
+    header->name_size = name_size;
+    header->stream_size = enc.size;
+
+    for (u32 i = 0; i < name_size; i++) {
+        data[sizeof(LineTableHeader) + i] = (u8)name[i];
+    }
+    LineTableBlock* out_blocks = (LineTableBlock*)(data + blocks_offset);
+    for (u32 b = 0; b < block_count; b++) {
+        out_blocks[b] = blocks[b];
+    }
+    for (u32 i = 0; i < enc.size; i++) {
+        data[stream_offset + i] = enc.out[i];
+    }
+
+    util_free(blocks);
+    util_free(enc.out);
+    *out_size = total;
+    return data;
+}
+
+int linetab_write(const PassOne* pass_one, const u32* offsets, const char* name, const char* path) {
+    char temp[LINETAB_PATH_MAX + 32];
+    u32 size = 0;
+    u8* data;
+    FILE* fp;
+    int result = 0;
+
+    data = linetab_serialize(pass_one, offsets, name, &size);
+    if (data == NULL_PTR) {
+        return -1;
+    }
+
+    snprintf(temp, sizeof(temp), "%s.tmp%ld", path, (long)getpid());
+    fp = fopen(temp, "wb");
+    if (fp == NULL_PTR) {
+        util_free(data);
+        return -1;
+    }
+    if (fwrite(data, 1, size, fp) != size) {
+        result = -1;
+    }
+    if (fclose(fp) != 0) {
+        result = -1;
+    }
+    util_free(data);
+
+    if (result != 0 || rename(temp, path) != 0) {
+        remove(temp);
+        return -1;
+    }
+    return 0;
+}
+
+int linetab_open(const void* data, u64 size, LineTable* out) {
+    const LineTableHeader* header = (const LineTableHeader*)data;
+
+    if (data == NULL_PTR || size < sizeof(LineTableHeader)) {
+        return -1;
+    }
+
+    int valid = header->version == LINETAB_VERSION && header->byte_order == LINETAB_BYTE_ORDER;
+    for (u32 i = 0; valid && i < 4; i++) {
+        valid = (header->magic[i] == LINETAB_MAGIC[i]);
+    }
+
+    /* 各段恰好铺满文件；块数与行数一致 */
+    u64 blocks_offset = ((u64)sizeof(LineTableHeader) + header->name_size + 3u) & ~(u64)3u;
+    u64 stream_offset = blocks_offset + (u64)sizeof(LineTableBlock) * header->block_count;
+    valid = valid && stream_offset + header->stream_size == size &&
+            header->block_count == (header->row_count + LINETAB_BLOCK_ROWS - 1) / LINETAB_BLOCK_ROWS;
+
+    /* 块索引地址严格递增、偏移不减且落在行流内 */
+    const LineTableBlock* blocks = (const LineTableBlock*)((const u8*)data + blocks_offset);
+    for (u32 b = 0; valid && b < header->block_count; b++) {
+        valid = blocks[b].offset <= header->stream_size &&
+                blocks[b].address < header->end_address &&
+                (b == 0 || (blocks[b].address > blocks[b - 1].address &&
+                            blocks[b].offset >= blocks[b - 1].offset));
+    }
+    if (!valid) {
+        return -1;
+    }
+
+    out->base = (const u8*)data;
+    out->size = size;
+    out->mapped = 0;
+    out->header = header;
+    out->name = (const char*)data + sizeof(LineTableHeader);
+    out->blocks = blocks;
+    out->stream = (const u8*)data + stream_offset;
+    return 0;
+}
+
+int linetab_map(const char* path, LineTable* out) {
+    struct stat info;
+    void* base;
+    u64 size;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &info) != 0 || (u64)info.st_size < sizeof(LineTableHeader)) {
+        close(fd);
+        return -1;
+    }
+
+    size = (u64)info.st_size;
+    base = mmap(NULL_PTR, (size_t)size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+
+    if (linetab_open(base, size, out) != 0) {
+        munmap(base, (size_t)size);
+        return -1;
+    }
+    out->mapped = 1;
+    return 0;
+}
+
+void linetab_unmap(LineTable* table) {
+    if (table == NULL_PTR || table->base == NULL_PTR) return;
+
+    if (table->mapped) {
+        munmap((void*)table->base, (size_t)table->size);
+    }
+    table->base = NULL_PTR;
+    table->size = 0;
+}
+
+int linetab_lookup(const LineTable* table, u32 address, u32* out_line) {
+    const LineTableHeader* header = table->header;
+
+    if (header->block_count == 0 || address < table->blocks[0].address ||
+        address >= header->end_address) {
+        return -1;
+    }
+
+    /* 二分：首地址不超过 address 的最后一块 */
+    u32 lo = 0;
+    u32 hi = header->block_count;
+    while (hi - lo > 1) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (table->blocks[mid].address <= address) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    const LineTableBlock* block = &table->blocks[lo];
+    u32 end = (lo + 1 < header->block_count) ? table->blocks[lo + 1].offset : header->stream_size;
+    u32 pos = block->offset;
+    u32 current = block->address;
+    u32 line = block->line;
+    u32 address_delta = 0;
+    s32 line_delta = 0;
+    int has_previous = 0;
+
+    while (pos < end) {
+        u8 op = table->stream[pos++];
+        u32 count = 1;
+
+        if (op >= LINETAB_OP_SPECIAL) {
+            address_delta = op & 0x1F;
+            line_delta = (s32)((op >> 5) & 0x3) + 1;
+            has_previous = 1;
+        } else if (op == LINETAB_OP_GENERAL) {
+            if (get_uleb(table->stream, &pos, end, &address_delta) != 0 ||
+                get_sleb(table->stream, &pos, end, &line_delta) != 0) {
+                return -1;
+            }
+            has_previous = 1;
+        } else if (has_previous) {
+            count = op;
+        } else {
+            return -1;  /* 块内第一个操作不能是重复 */
+        }
+
+        if (address_delta == 0) {
+            return -1;
+        }
+
+        /* 整段跳过：目标地址落在本段内时直接算出所在行 */
+        u32 reachable = (address - current) / address_delta;
+        if (reachable < count) {
+            *out_line = line + (u32)((s32)reachable * line_delta);
+            return 0;
+        }
+        current += count * address_delta;
+        line += (u32)((s32)count * line_delta);
+    }
+
+    *out_line = line;
+    return 0;
+}
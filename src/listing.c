@@ -0,0 +1,318 @@
+﻿/*
+ * ============================================================================
+ * 文件名: listing.c
+ * 描述  : 列表文件实现
+ *
+ * 输出格式：
+ *   SUBAS listing: prog.asm
+ *
+ *    Line  Addr  Code               Source
+ *       1                           ; 注释
+ *       2  0000  B8 34 12           START: MOV AX, 1234H
+ *       3  0003  E9 00 00           JMP START
+ *
+ *   Symbols:
+ *
+ *   Name                             Type       Addr  Line
+ *   START                            label      0000     2
+ *
+ * ============================================================================
+ */
+
+#include "../include/listing.h"
+
+/* 行首列宽：行号 5 + 2 + 地址 4 + 2 + 字节区 + 1 */
+#define LISTING_CODE_WIDTH      (LISTING_BYTES_PER_ROW * 3)
+#define LISTING_ROW_MAX         64      /* 源代码原文之前的前缀最大长度 */
+#define LISTING_NAME_WIDTH      32
+#define LISTING_ENTRY_MAX       (1 + SEMANTIC_MAX_OPERANDS * 2)   /* 单条指令最多生成的字节数 */
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+/* ========================================================================= */
+/* 内部辅助函数 */
+/* ========================================================================= */
+
+/*
+ * 把缓冲区写入文件
+ */
+static void flush_buffer(Listing* listing) {
+    if (listing->used > 0 &&
+        fwrite(listing->buffer, 1, listing->used, listing->fp) != listing->used) {
+        listing->failed = 1;
+    }
+    listing->used = 0;
+}
+
+/*
+ * 追加任意长度的文本
+ */
+static void put_text(Listing* listing, const char* text, u32 len) {
+    while (len > 0) {
+        if (listing->used == LISTING_BUFFER_SIZE) {
+            flush_buffer(listing);
+        }
+        u32 room = LISTING_BUFFER_SIZE - listing->used;
+        u32 chunk = (len < room) ? len : room;
+        for (u32 i = 0; i < chunk; i++) {
+            listing->buffer[listing->used + i] = text[i];
+        }
+        listing->used += chunk;
+        text += chunk;
+        len -= chunk;
+    }
+}
+
+static void put_string(Listing* listing, const char* text) {
+    put_text(listing, text, util_strlen(text));
+}
+
+/*
+ * 以下写入函数直接操作缓冲区，调用前须用 reserve 保证空间
+ */
+static char* reserve(Listing* listing, u32 len) {
+    if (LISTING_BUFFER_SIZE - listing->used < len) {
+        flush_buffer(listing);
+    }
+    return listing->buffer + listing->used;
+}
+
+static char* put_spaces(char* out, u32 count) {
+    for (u32 i = 0; i < count; i++) {
+        *out++ = ' ';
+    }
+    return out;
+}
+
+/* 右对齐的十进制数，宽度不足时按实际长度输出 */
+static char* put_decimal(char* out, u32 value, u32 width) {
+    char digits[10];
+    u32 n = 0;
+
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    out = put_spaces(out, (n < width) ? width - n : 0);
+    while (n > 0) {
+        *out++ = digits[--n];
+    }
+    return out;
+}
+
+static char* put_hex16(char* out, u32 value) {
+    *out++ = hex_digits[(value >> 12) & 0xF];
+    *out++ = hex_digits[(value >> 8) & 0xF];
+    *out++ = hex_digits[(value >> 4) & 0xF];
+    *out++ = hex_digits[value & 0xF];
+    return out;
+}
+
+/*
+ * 取出 cursor 处的源代码行（不含换行符与行尾 '\r'）并前进到下一行
+ */
+static u32 take_source_line(Listing* listing, const char** text) {
+    u32 start = listing->cursor;
+    u32 end = start;
+
+    while (end < listing->source_len && listing->source[end] != '\n') {
+        end++;
+    }
+    listing->cursor = (end < listing->source_len) ? end + 1 : end;
+    listing->next_line++;
+
+    *text = listing->source + start;
+    if (end > start && listing->source[end - 1] == '\r') {
+        end--;
+    }
+    return end - start;
+}
+
+/*
+ * 写出一行：line 为 0 时不写行号；bytes 为 NULL 时不写地址与字节区；
+ * unresolved[k] 非 0 的字节显示为 ??
+ */
+static void put_row(Listing* listing, u32 line, const u32* address, const u8* bytes,
+                    const u8* unresolved, u32 count, const char* text, u32 text_len) {
+    char* start = reserve(listing, LISTING_ROW_MAX);
+    char* out = start;
+
+    if (line > 0) {
+        out = put_decimal(out, line, 5);
+    } else {
+        out = put_spaces(out, 5);
+    }
+    out = put_spaces(out, 2);
+
+    if (address != NULL_PTR) {
+        out = put_hex16(out, *address);
+    } else {
+        out = put_spaces(out, 4);
+    }
+    out = put_spaces(out, 2);
+
+    for (u32 k = 0; k < count; k++) {
+        if (unresolved[k]) {
+            *out++ = '?';
+            *out++ = '?';
+        } else {
+            *out++ = hex_digits[bytes[k] >> 4];
+            *out++ = hex_digits[bytes[k] & 0xF];
+        }
+        *out++ = ' ';
+    }
+    out = put_spaces(out, (LISTING_BYTES_PER_ROW - count) * 3 + 1);
+
+    listing->used += (u32)(out - start);
+    if (text_len > 0) {
+        put_text(listing, text, text_len);
+    } else {
+        /* 去掉没有原文时的行尾空格 */
+        while (listing->used > 0 && listing->buffer[listing->used - 1] == ' ') {
+            listing->used--;
+        }
+    }
+    put_text(listing, "\n", 1);
+}
+
+/*
+ * 补写 cursor 到 line 之前没有指令的源代码行
+ */
+static void put_source_until(Listing* listing, u32 line) {
+    while (listing->next_line < line && listing->cursor < listing->source_len) {
+        const char* text;
+        u32 number = listing->next_line;
+        u32 len = take_source_line(listing, &text);
+        put_row(listing, number, NULL_PTR, NULL_PTR, NULL_PTR, 0, text, len);
+    }
+}
+
+/*
+ * 符号表附录的遍历回调
+ */
+static int put_symbol(void* user, const SymbolInfo* info) {
+    static const char* const type_names[] = { "label", "variable", "procedure", "external" };
+    Listing* listing = (Listing*)user;
+    u32 name_len = util_strlen(info->name);
+    const char* type = ((u32)info->type < 4) ? type_names[info->type] : "?";
+    u32 type_len = util_strlen(type);
+
+    put_text(listing, info->name, name_len);
+
+    char* start = reserve(listing, LISTING_ROW_MAX);
+    char* out = put_spaces(start, (name_len < LISTING_NAME_WIDTH) ? LISTING_NAME_WIDTH - name_len : 0);
+    *out++ = ' ';
+    for (u32 i = 0; i < type_len; i++) {
+        *out++ = type[i];
+    }
+    out = put_spaces(out, 11 - type_len);
+    out = put_hex16(out, info->address);
+    out = put_decimal(out, info->line_defined, 6);
+    *out++ = '\n';
+    listing->used += (u32)(out - start);
+    return 0;
+}
+
+/* ========================================================================= */
+/* API 函数实现 */
+/* ========================================================================= */
+
+Listing* listing_open(const char* path, const char* title, const char* source, u32 source_len) {
+    Listing* listing = (Listing*)util_malloc(sizeof(Listing));
+    if (listing == NULL_PTR) {
+        return NULL_PTR;
+    }
+
+    listing->buffer = (char*)util_malloc(LISTING_BUFFER_SIZE);
+    listing->fp = (listing->buffer != NULL_PTR) ? fopen(path, "w") : NULL_PTR;
+    if (listing->fp == NULL_PTR) {
+        util_free(listing->buffer);
+        util_free(listing);
+        return NULL_PTR;
+    }
+
+    listing->used = 0;
+    listing->failed = 0;
+    listing->source = source;
+    listing->source_len = (source != NULL_PTR) ? source_len : 0;
+    listing->cursor = 0;
+    listing->next_line = 1;
+
+    put_string(listing, "SUBAS listing: ");
+    put_string(listing, (title != NULL_PTR) ? title : "");
+    put_string(listing, "\n\n Line  Addr  Code               Source\n");
+    return listing;
+}
+
+void listing_instruction(void* user, const CodeGen* codegen, u32 index,
+                         u32 code_start, u32 first_relocation) {
+    Listing* listing = (Listing*)user;
+    const InstructionEntry* entry = &codegen->pass_one->instructions[index];
+    u32 length = codegen->instruction_offsets[index + 1] - code_start;
+    u8 bytes[LISTING_ENTRY_MAX];
+    u8 unresolved[LISTING_ENTRY_MAX];
+    const char* text = NULL_PTR;
+    u32 text_len = 0;
+    u32 line = 0;
+
+    if (length > LISTING_ENTRY_MAX) {
+        length = LISTING_ENTRY_MAX;
+    }
+    for (u32 k = 0; k < length; k++) {
+        bytes[k] = codegen->code_buffer[code_start + k];
+        unresolved[k] = 0;
+    }
+
+    /* 重定位字段已按实际偏移填充，与映像中的字节相同；只需标出未定义符号的引用 */
+    for (u32 r = first_relocation; r < codegen->relocation_count &&
+                                   codegen->relocations[r].instruction_index == index; r++) {
+        const Relocation* rel = &codegen->relocations[r];
+        u32 at = rel->offset - code_start;
+        SymbolInfo* symbol = symtab_lookup(codegen->pass_one->symtab, (const char*)rel->symbol_name);
+
+        if (at + 1 < length && (symbol == NULL_PTR || !symbol->is_defined)) {
+            unresolved[at] = 1;
+            unresolved[at + 1] = 1;
+        }
+    }
+
+    /* 本条目所在的行尚未写出时带上原文，否则只写地址与字节 */
+    put_source_until(listing, entry->line);
+    if (entry->line == listing->next_line && listing->cursor < listing->source_len) {
+        line = entry->line;
+        text_len = take_source_line(listing, &text);
+    }
+
+    /* 地址取第二遍的实际偏移，与符号表附录中标签的地址同源 */
+    u32 address = code_start;
+    u32 shown = (length < LISTING_BYTES_PER_ROW) ? length : LISTING_BYTES_PER_ROW;
+    put_row(listing, line, &address, bytes, unresolved, shown, text, text_len);
+    for (u32 k = shown; k < length; k += LISTING_BYTES_PER_ROW) {
+        u32 count = (length - k < LISTING_BYTES_PER_ROW) ? length - k : LISTING_BYTES_PER_ROW;
+        address = code_start + k;
+        put_row(listing, 0, &address, bytes + k, unresolved + k, count, NULL_PTR, 0);
+    }
+}
+
+int listing_close(Listing* listing, SymbolTable* symtab) {
+    int failed;
+
+    if (listing == NULL_PTR) return 0;
+
+    put_source_until(listing, 0xFFFFFFFFu);
+
+    if (symtab != NULL_PTR) {
+        put_string(listing, "\nSymbols:\n\nName                             Type       Addr  Line\n");
+        (void)symtab_iterate_prefix(symtab, "", put_symbol, listing);
+    }
+
+    flush_buffer(listing);
+    failed = listing->failed;
+    if (fclose(listing->fp) != 0) {
+        failed = 1;
+    }
+    util_free(listing->buffer);
+    util_free(listing);
+    return failed ? -1 : 0;
+}
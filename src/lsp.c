@@ -0,0 +1,902 @@
+﻿/*
+ * ============================================================================
+ * 文件名: lsp.c
+ * 描述  : 语言服务器实现（stdio JSON-RPC）
+ *
+ * 每个文档的状态：
+ *  - inc：增量汇编会话，didChange 的每个区间编辑直接交给 incremental_edit
+ *  - diagnostics：最近一次编辑捕获的诊断。无论以增量方式完成还是退回完整汇编，
+ *    每次编辑都报告整份文本的全部诊断，因此最后一次编辑的捕获结果即为完整诊断集
+ *  - refs：符号名 → 引用行（升序）的索引，首次查询引用时建立，编辑后失效
+ *
+ * 定义与悬停只用符号表查找与按行二分，不遍历条目。
+ *
+ * ============================================================================
+ */
+
+#include "../include/lsp.h"
+#include "../include/json.h"
+#include "../include/incremental.h"
+#include "../include/subas.h"
+#include "../include/error.h"
+
+#define LSP_DOCUMENT_BUCKETS    61
+#define LSP_REFERENCE_BUCKETS   4093
+#define LSP_HEADER_MAX          256
+#define LSP_HOVER_MAX_BYTES     16      /* 悬停提示中每个条目最多显示的机器码字节数 */
+#define LSP_MAX_OCCURRENCES     32      /* 一行中最多报告的出现次数 */
+#define LSP_NAME_MAX            128     /* 与 Operand.name 容量一致 */
+
+/* JSON-RPC 错误码 */
+#define LSP_ERR_PARSE           (-32700)
+#define LSP_ERR_METHOD          (-32601)
+
+/* 一个符号的引用行 */
+typedef struct {
+    u32* lines;
+    u32 count;
+    u32 capacity;
+} RefList;
+
+/* 打开的文档 */
+typedef struct {
+    char* uri;
+    s64 version;
+    IncrementalAsm* inc;
+    ErrorBuffer diagnostics;    /* 最近一次编辑捕获的诊断 */
+    UtilHashTable* refs;        /* 引用索引（NULL_PTR 表示需要重建） */
+} LspDocument;
+
+/* 语言服务器 */
+struct LspServer {
+    LspWriteFunc write;
+    void* user;
+    UtilHashTable* documents;   /* uri → LspDocument* */
+    int shutdown_requested;
+    JsonWriter out;             /* 输出消息缓冲区（跨消息复用） */
+};
+
+/* 源文本中的字节区间 [start, end) */
+typedef struct {
+    u32 start;
+    u32 end;
+} TextSpan;
+
+/* ========================================================================= */
+/* 文本与位置 */
+/* ========================================================================= */
+
+/* 与词法分析器一致的标识符字符 */
+static int is_ident_start(char c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_' || c == '.' || c == '$';
+}
+
+static int is_ident_char(char c) {
+    return is_ident_start(c) || (c >= '0' && c <= '9');
+}
+
+/*
+ * 第 line 行（从 1 开始）的字节区间，不含行尾换行
+ */
+static int line_span(const IncrementalAsm* inc, u32 line, TextSpan* out) {
+    u32 len;
+    u32 count;
+    const char* src = incremental_get_source(inc, &len);
+    const u32* starts = incremental_get_line_starts(inc, &count);
+
+    if (line == 0 || line > count) {
+        return -1;
+    }
+    out->start = starts[line - 1];
+    out->end = (line < count) ? starts[line] : len;
+    while (out->end > out->start && (src[out->end - 1] == '\n' || src[out->end - 1] == '\r')) {
+        out->end--;
+    }
+    return 0;
+}
+
+/*
+ * 字节偏移所在的行号（从 1 开始）
+ */
+static u32 line_at(const IncrementalAsm* inc, u32 offset) {
+    u32 count;
+    const u32* starts = incremental_get_line_starts(inc, &count);
+    u32 lo = 0;
+    u32 hi = count;
+
+    /* 最后一个满足 starts[i] <= offset 的 i */
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (starts[mid] <= offset) lo = mid + 1;
+        else hi = mid;
+    }
+    return (lo == 0) ? 1 : lo;
+}
+
+/*
+ * [from, to) 的 UTF-16 码元数
+ */
+static u32 utf16_units(const char* text, u32 from, u32 to) {
+    u32 units = 0;
+
+    for (u32 i = from; i < to; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if ((c & 0xC0) == 0x80) continue;   /* UTF-8 续字节 */
+        units += (c >= 0xF0) ? 2 : 1;
+    }
+    return units;
+}
+
+/*
+ * 协议位置 {line, character} → 字节偏移（越界时收拢到行尾 / 文本末尾）
+ */
+static u32 position_offset(const IncrementalAsm* inc, const JsonValue* position) {
+    u32 len;
+    u32 count;
+    const char* src = incremental_get_source(inc, &len);
+    const u32* starts = incremental_get_line_starts(inc, &count);
+    s64 line = json_get_int(position, "line", 0);
+    s64 character = json_get_int(position, "character", 0);
+
+    if (line < 0) return 0;
+    if (line >= (s64)count) return len;
+
+    u32 pos = starts[line];
+    u32 end = (line + 1 < (s64)count) ? starts[line + 1] : len;
+    s64 units = 0;
+    while (pos < end && src[pos] != '\n' && units < character) {
+        unsigned char c = (unsigned char)src[pos];
+        u32 step = (c >= 0xF0) ? 4 : (c >= 0xE0) ? 3 : (c >= 0xC0) ? 2 : 1;
+        units += (step == 4) ? 2 : 1;
+        pos += step;
+    }
+    return (pos > end) ? end : pos;
+}
+
+/*
+ * 偏移处（或紧邻其左侧）的标识符，复制到 name
+ */
+static int word_at(const IncrementalAsm* inc, u32 offset, TextSpan* out, char* name) {
+    u32 len;
+    const char* src = incremental_get_source(inc, &len);
+    u32 start = offset;
+    u32 end = offset;
+
+    while (start > 0 && is_ident_char(src[start - 1])) start--;
+    while (end < len && is_ident_char(src[end])) end++;
+    /* 以数字开头的是数值，不是符号 */
+    if (start == end || !is_ident_start(src[start]) || end - start >= LSP_NAME_MAX) {
+        return -1;
+    }
+    for (u32 i = start; i < end; i++) {
+        name[i - start] = src[i];
+    }
+    name[end - start] = '\0';
+    out->start = start;
+    out->end = end;
+    return 0;
+}
+
+/*
+ * 在一行中查找 name 作为完整标识符的出现位置（跳过字符串与 ';' 之后的注释）
+ */
+static u32 find_occurrences(const char* src, const TextSpan* line, const char* name,
+                            u32* positions, u32 capacity) {
+    u32 n = util_strlen(name);
+    u32 found = 0;
+    char quote = 0;
+    u32 i = line->start;
+
+    while (i < line->end && found < capacity) {
+        char c = src[i];
+        if (quote != 0) {
+            if (c == quote) quote = 0;
+            i++;
+        } else if (c == '\'' || c == '"') {
+            quote = c;
+            i++;
+        } else if (c == ';') {
+            break;
+        } else if (is_ident_char(c)) {
+            /* 整段标识符或数值一起跳过，数值中的字母不会被误认作符号 */
+            u32 j = i;
+            while (j < line->end && is_ident_char(src[j])) j++;
+            if (is_ident_start(c) && j - i == n) {
+                u32 k = 0;
+                while (k < n && src[i + k] == name[k]) k++;
+                if (k == n) positions[found++] = i;
+            }
+            i = j;
+        } else {
+            i++;
+        }
+    }
+    return found;
+}
+
+/* ========================================================================= */
+/* 输出 */
+/* ========================================================================= */
+
+static void begin_response(LspServer* server, const JsonValue* id) {
+    server->out.len = 0;
+    server->out.failed = 0;
+    json_write_raw(&server->out, "{\"jsonrpc\":\"2.0\",\"id\":");
+    json_write_value(&server->out, id);
+    json_write_raw(&server->out, ",\"result\":");
+}
+
+static void begin_notification(LspServer* server, const char* method) {
+    server->out.len = 0;
+    server->out.failed = 0;
+    json_write_raw(&server->out, "{\"jsonrpc\":\"2.0\",\"method\":");
+    json_write_string(&server->out, method, util_strlen(method));
+    json_write_raw(&server->out, ",\"params\":");
+}
+
+static void end_message(LspServer* server) {
+    json_write_raw(&server->out, "}");
+    if (!server->out.failed) {
+        server->write(server->user, server->out.data, server->out.len);
+    }
+}
+
+static void send_error(LspServer* server, const JsonValue* id, int code, const char* message) {
+    server->out.len = 0;
+    server->out.failed = 0;
+    json_write_raw(&server->out, "{\"jsonrpc\":\"2.0\",\"id\":");
+    json_write_value(&server->out, id);
+    json_write_raw(&server->out, ",\"error\":{\"code\":");
+    json_write_int(&server->out, code);
+    json_write_raw(&server->out, ",\"message\":");
+    json_write_string(&server->out, message, util_strlen(message));
+    json_write_raw(&server->out, "}");
+    end_message(server);
+}
+
+/*
+ * 写出第 line 行中 [start, end) 的范围
+ */
+static void write_range(JsonWriter* w, const IncrementalAsm* inc, u32 line, u32 start, u32 end) {
+    TextSpan span;
+    const char* src = incremental_get_source(inc, NULL_PTR);
+
+    if (line_span(inc, line, &span) != 0) {
+        span.start = start = end = 0;
+    }
+    json_write_raw(w, "{\"start\":{\"line\":");
+    json_write_int(w, (line > 0) ? line - 1 : 0);
+    json_write_raw(w, ",\"character\":");
+    json_write_int(w, utf16_units(src, span.start, start));
+    json_write_raw(w, "},\"end\":{\"line\":");
+    json_write_int(w, (line > 0) ? line - 1 : 0);
+    json_write_raw(w, ",\"character\":");
+    json_write_int(w, utf16_units(src, span.start, end));
+    json_write_raw(w, "}}");
+}
+
+static void write_location(JsonWriter* w, const LspDocument* doc, u32 line, u32 start, u32 end) {
+    json_write_raw(w, "{\"uri\":");
+    json_write_string(w, doc->uri, util_strlen(doc->uri));
+    json_write_raw(w, ",\"range\":");
+    write_range(w, doc->inc, line, start, end);
+    json_write_raw(w, "}");
+}
+
+/*
+ * 发布文档的全部诊断
+ */
+static void publish_diagnostics(LspServer* server, const LspDocument* doc, int clear) {
+    JsonWriter* w = &server->out;
+    u32 count = clear ? 0 : doc->diagnostics.count;
+
+    begin_notification(server, "textDocument/publishDiagnostics");
+    json_write_raw(w, "{\"uri\":");
+    json_write_string(w, doc->uri, util_strlen(doc->uri));
+    if (!clear) {
+        json_write_raw(w, ",\"version\":");
+        json_write_int(w, doc->version);
+    }
+    json_write_raw(w, ",\"diagnostics\":[");
+    for (u32 i = 0; i < count; i++) {
+        const ErrorRecord* record = &doc->diagnostics.records[i];
+        const char* message = error_get_message(record->code);
+        char code[16];
+        TextSpan span;
+        u32 line = (record->line > 0) ? record->line : 1;
+
+        if (line_span(doc->inc, line, &span) != 0) {
+            span.start = span.end = 0;
+        }
+        snprintf(code, sizeof(code), "E%d", (int)record->code);
+
+        if (i > 0) json_write_raw(w, ",");
+        json_write_raw(w, "{\"range\":");
+        write_range(w, doc->inc, line, span.start, span.end);
+        json_write_raw(w, ",\"severity\":1,\"source\":\"subas\",\"code\":");
+        json_write_string(w, code, util_strlen(code));
+        json_write_raw(w, ",\"message\":");
+        if (record->detail != NULL_PTR) {
+            /* 与命令行诊断相同的 "提示 -> 详细信息" 形式 */
+            u32 a = util_strlen(message);
+            u32 b = util_strlen(record->detail);
+            char* text = (char*)util_malloc(a + b + 4);
+            if (text != NULL_PTR) {
+                for (u32 k = 0; k < a; k++) text[k] = message[k];
+                text[a] = ' ';
+                text[a + 1] = '-';
+                text[a + 2] = '>';
+                text[a + 3] = ' ';
+                for (u32 k = 0; k < b; k++) text[a + 4 + k] = record->detail[k];
+                json_write_string(w, text, a + b + 4);
+                util_free(text);
+            } else {
+                json_write_string(w, message, a);
+            }
+        } else {
+            json_write_string(w, message, util_strlen(message));
+        }
+        json_write_raw(w, "}");
+    }
+    json_write_raw(w, "]}");
+    end_message(server);
+}
+
+/* ========================================================================= */
+/* 文档 */
+/* ========================================================================= */
+
+static void invalidate_references(LspDocument* doc) {
+    UtilHashTable* refs = doc->refs;
+
+    if (refs == NULL_PTR) return;
+    for (u32 b = 0; b < refs->bucket_count; b++) {
+        for (UtilHashNode* node = refs->buckets[b]; node != NULL_PTR; node = node->next) {
+            RefList* list = (RefList*)node->value;
+            util_free(list->lines);
+            util_free(list);
+        }
+    }
+    util_ht_destroy(refs);
+    doc->refs = NULL_PTR;
+}
+
+static void destroy_document(LspDocument* doc) {
+    if (doc == NULL_PTR) return;
+    invalidate_references(doc);
+    incremental_destroy(doc->inc);
+    error_buffer_dispose(&doc->diagnostics);
+    util_free(doc->uri);
+    util_free(doc);
+}
+
+/*
+ * 编辑前：清空诊断并开始捕获
+ */
+static void begin_update(LspDocument* doc) {
+    invalidate_references(doc);
+    error_buffer_dispose(&doc->diagnostics);
+    error_buffer_init(&doc->diagnostics);
+    error_capture_begin(&doc->diagnostics);
+}
+
+static LspDocument* find_document(LspServer* server, const JsonValue* params) {
+    const char* uri = json_get_string(json_get(params, "textDocument"), "uri");
+    return (uri != NULL_PTR) ? (LspDocument*)util_ht_lookup(server->documents, uri) : NULL_PTR;
+}
+
+/*
+ * 记录 name 在 line 行被引用（同一行只记一次）
+ */
+static int add_reference(UtilHashTable* refs, const char* name, u32 line) {
+    RefList* list = (RefList*)util_ht_lookup(refs, name);
+
+    if (list == NULL_PTR) {
+        list = (RefList*)util_malloc(sizeof(RefList));
+        if (list == NULL_PTR) return -1;
+        list->lines = NULL_PTR;
+        list->count = 0;
+        list->capacity = 0;
+        util_ht_insert(refs, name, list);
+    }
+    if (list->count > 0 && list->lines[list->count - 1] == line) {
+        return 0;
+    }
+    if (list->count >= list->capacity) {
+        u32 capacity = (list->capacity == 0) ? 4 : list->capacity * 2;
+        u32* grown = (u32*)util_malloc(sizeof(u32) * capacity);
+        if (grown == NULL_PTR) return -1;
+        for (u32 i = 0; i < list->count; i++) grown[i] = list->lines[i];
+        util_free(list->lines);
+        list->lines = grown;
+        list->capacity = capacity;
+    }
+    list->lines[list->count++] = line;
+    return 0;
+}
+
+/*
+ * 引用索引：按条目顺序扫描一遍操作数，各符号的引用行自然升序
+ */
+static UtilHashTable* reference_index(LspDocument* doc) {
+    u32 count = incremental_get_entry_count(doc->inc);
+
+    if (doc->refs != NULL_PTR) {
+        return doc->refs;
+    }
+    doc->refs = util_ht_create(LSP_REFERENCE_BUCKETS);
+    if (doc->refs == NULL_PTR) {
+        return NULL_PTR;
+    }
+    for (u32 i = 0; i < count; i++) {
+        IncrementalEntry view;
+        if (incremental_get_entry(doc->inc, i, &view) != 0 || view.entry == NULL_PTR) {
+            continue;
+        }
+        const InstructionEntry* entry = view.entry;
+        u32 operands = (entry->operand_count < SEMANTIC_MAX_OPERANDS) ? entry->operand_count
+                                                                     : SEMANTIC_MAX_OPERANDS;
+        for (u32 k = 0; k < operands; k++) {
+            const Operand* op = &entry->operands[k];
+            if ((op->type == OPERAND_LABEL || op->type == OPERAND_MEMORY) && op->name[0] != '\0' &&
+                add_reference(doc->refs, (const char*)op->name, view.line) != 0) {
+                invalidate_references(doc);
+                return NULL_PTR;
+            }
+        }
+    }
+    return doc->refs;
+}
+
+/* ========================================================================= */
+/* 请求与通知 */
+/* ========================================================================= */
+
+static void handle_initialize(LspServer* server, const JsonValue* id) {
+    begin_response(server, id);
+    json_write_raw(&server->out,
+                   "{\"capabilities\":{\"positionEncoding\":\"utf-16\","
+                   "\"textDocumentSync\":{\"openClose\":true,\"change\":2},"
+                   "\"definitionProvider\":true,\"referencesProvider\":true,\"hoverProvider\":true},"
+                   "\"serverInfo\":{\"name\":\"subas\",\"version\":\"" SUBAS_VERSION "\"}}");
+    end_message(server);
+}
+
+static void handle_did_open(LspServer* server, const JsonValue* params) {
+    const JsonValue* item = json_get(params, "textDocument");
+    const char* uri = json_get_string(item, "uri");
+    const JsonValue* text = json_get(item, "text");
+    LspDocument* doc;
+
+    if (uri == NULL_PTR || text == NULL_PTR || text->type != JSON_STRING) {
+        return;
+    }
+    destroy_document((LspDocument*)util_ht_remove(server->documents, uri));
+
+    doc = (LspDocument*)util_malloc(sizeof(LspDocument));
+    if (doc == NULL_PTR) return;
+    doc->uri = util_strdup(uri);
+    doc->version = json_get_int(item, "version", 0);
+    doc->refs = NULL_PTR;
+    error_buffer_init(&doc->diagnostics);
+
+    begin_update(doc);
+    doc->inc = incremental_create(text->string, text->length);
+    error_capture_end();
+    if (doc->uri == NULL_PTR || doc->inc == NULL_PTR) {
+        destroy_document(doc);
+        return;
+    }
+
+    util_ht_insert(server->documents, uri, doc);
+    publish_diagnostics(server, doc, 0);
+}
+
+static void handle_did_change(LspServer* server, const JsonValue* params) {
+    LspDocument* doc = find_document(server, params);
+    const JsonValue* changes = json_get(params, "contentChanges");
+
+    if (doc == NULL_PTR || changes == NULL_PTR || changes->type != JSON_ARRAY) {
+        return;
+    }
+    doc->version = json_get_int(json_get(params, "textDocument"), "version", doc->version);
+
+    for (u32 i = 0; i < changes->count; i++) {
+        const JsonValue* change = &changes->items[i];
+        const JsonValue* text = json_get(change, "text");
+        const JsonValue* range = json_get(change, "range");
+        u32 start = 0;
+        u32 end;
+
+        if (text == NULL_PTR || text->type != JSON_STRING) continue;
+        if (range != NULL_PTR) {
+            start = position_offset(doc->inc, json_get(range, "start"));
+            end = position_offset(doc->inc, json_get(range, "end"));
+            if (end < start) end = start;
+        } else {
+            incremental_get_source(doc->inc, &end);    /* 整体替换 */
+        }
+
+        begin_update(doc);
+        incremental_edit(doc->inc, start, end - start, text->string, text->length);
+        error_capture_end();
+    }
+    publish_diagnostics(server, doc, 0);
+}
+
+static void handle_did_close(LspServer* server, const JsonValue* params) {
+    const char* uri = json_get_string(json_get(params, "textDocument"), "uri");
+    LspDocument* doc = (uri != NULL_PTR) ? (LspDocument*)util_ht_remove(server->documents, uri)
+                                         : NULL_PTR;
+
+    if (doc != NULL_PTR) {
+        publish_diagnostics(server, doc, 1);
+        destroy_document(doc);
+    }
+}
+
+/*
+ * 请求位置处的符号名；同时给出名称区间
+ */
+static int request_word(const LspDocument* doc, const JsonValue* params, TextSpan* span, char* name) {
+    u32 offset = position_offset(doc->inc, json_get(params, "position"));
+    return word_at(doc->inc, offset, span, name);
+}
+
+/*
+ * 写出定义位置：定义行中第一次出现的名称（找不到时为行首）
+ */
+static void write_definition(JsonWriter* w, const LspDocument* doc, const SymbolInfo* symbol) {
+    const char* src = incremental_get_source(doc->inc, NULL_PTR);
+    TextSpan line;
+    u32 position = 0;
+    u32 n = util_strlen(symbol->name);
+
+    if (line_span(doc->inc, symbol->line_defined, &line) == 0 &&
+        find_occurrences(src, &line, symbol->name, &position, 1) == 1) {
+        write_location(w, doc, symbol->line_defined, position, position + n);
+    } else {
+        write_location(w, doc, symbol->line_defined, 0, 0);
+    }
+}
+
+static void handle_definition(LspServer* server, const JsonValue* id, const JsonValue* params) {
+    LspDocument* doc = find_document(server, params);
+    const SymbolInfo* symbol = NULL_PTR;
+    TextSpan span;
+    char name[LSP_NAME_MAX];
+
+    if (doc != NULL_PTR && request_word(doc, params, &span, name) == 0) {
+        symbol = incremental_lookup_symbol(doc->inc, name);
+    }
+
+    begin_response(server, id);
+    if (symbol != NULL_PTR && symbol->is_defined) {
+        write_definition(&server->out, doc, symbol);
+    } else {
+        json_write_raw(&server->out, "null");
+    }
+    end_message(server);
+}
+
+/*
+ * 写出一行中的全部引用；is_definition 为真且不含声明时跳过行首的标签本身
+ */
+static int write_line_references(JsonWriter* w, const LspDocument* doc, u32 line, const char* name,
+                                 int is_definition, int include_declaration, int first) {
+    const char* src = incremental_get_source(doc->inc, NULL_PTR);
+    u32 positions[LSP_MAX_OCCURRENCES];
+    u32 n = util_strlen(name);
+    TextSpan span;
+
+    if (line_span(doc->inc, line, &span) != 0) {
+        return first;
+    }
+    u32 found = find_occurrences(src, &span, name, positions, LSP_MAX_OCCURRENCES);
+    u32 indent = span.start;
+    while (indent < span.end && (src[indent] == ' ' || src[indent] == '\t')) indent++;
+
+    for (u32 i = 0; i < found; i++) {
+        if (is_definition && !include_declaration && positions[i] == indent) {
+            continue;
+        }
+        if (!first) json_write_raw(w, ",");
+        write_location(w, doc, line, positions[i], positions[i] + n);
+        first = 0;
+    }
+    return first;
+}
+
+static void handle_references(LspServer* server, const JsonValue* id, const JsonValue* params) {
+    LspDocument* doc = find_document(server, params);
+    JsonWriter* w = &server->out;
+    TextSpan span;
+    char name[LSP_NAME_MAX];
+
+    if (doc == NULL_PTR || request_word(doc, params, &span, name) != 0) {
+        begin_response(server, id);
+        json_write_raw(w, "null");
+        end_message(server);
+        return;
+    }
+
+    int include_declaration = 0;
+    const JsonValue* flag = json_get(json_get(params, "context"), "includeDeclaration");
+    if (flag != NULL_PTR && flag->type == JSON_BOOL) {
+        include_declaration = (int)flag->integer;
+    }
+
+    const SymbolInfo* symbol = incremental_lookup_symbol(doc->inc, name);
+    UtilHashTable* refs = reference_index(doc);
+    const RefList* list = (refs != NULL_PTR) ? (const RefList*)util_ht_lookup(refs, name) : NULL_PTR;
+    u32 count = (list != NULL_PTR) ? list->count : 0;
+    u32 definition = (symbol != NULL_PTR && symbol->is_defined) ? symbol->line_defined : 0;
+    int first = 1;
+
+    /* 引用行升序；定义行按顺序插入其中（与引用同行时只输出一次） */
+    begin_response(server, id);
+    json_write_raw(w, "[");
+    for (u32 i = 0; i <= count; i++) {
+        u32 line = (i < count) ? list->lines[i] : 0xFFFFFFFFu;
+        if (definition != 0 && definition <= line) {
+            first = write_line_references(w, doc, definition, name, 1, include_declaration, first);
+            if (definition == line) {
+                definition = 0;
+                continue;
+            }
+            definition = 0;
+        }
+        if (i < count) {
+            first = write_line_references(w, doc, line, name, 0, include_declaration, first);
+        }
+    }
+    json_write_raw(w, "]");
+    end_message(server);
+}
+
+/*
+ * 悬停文本：一行中各条目的地址、长度与机器码
+ */
+static int describe_line(JsonWriter* text, const LspDocument* doc, u32 line) {
+    u32 count = incremental_get_entry_count(doc->inc);
+    u32 described = 0;
+    char buffer[64];
+
+    for (u32 i = incremental_find_line(doc->inc, line); i < count; i++) {
+        IncrementalEntry view;
+        if (incremental_get_entry(doc->inc, i, &view) != 0 || view.line != line) break;
+        if (view.entry == NULL_PTR || view.entry->has_error) continue;
+
+        /* 已编码时以实际机器码字节数为准 */
+        u32 size = (view.code != NULL_PTR) ? view.code_length : view.length;
+        snprintf(buffer, sizeof(buffer), "%04Xh  %u byte%s ", (unsigned int)view.address,
+                 (unsigned int)size, size == 1 ? "" : "s");
+        json_write_raw(text, buffer);
+        if (view.code == NULL_PTR) {
+            json_write_raw(text, " (not encoded: document has errors)");
+        }
+        for (u32 k = 0; view.code != NULL_PTR && k < view.code_length; k++) {
+            if (k == LSP_HOVER_MAX_BYTES) {
+                json_write_raw(text, " ...");
+                break;
+            }
+            snprintf(buffer, sizeof(buffer), " %02X", (unsigned int)view.code[k]);
+            json_write_raw(text, buffer);
+        }
+        json_write_raw(text, "\n");
+        described++;
+    }
+    return described > 0;
+}
+
+static void handle_hover(LspServer* server, const JsonValue* id, const JsonValue* params) {
+    static const char* const type_names[] = { "label", "variable", "procedure", "external" };
+    LspDocument* doc = find_document(server, params);
+    const SymbolInfo* symbol = NULL_PTR;
+    JsonWriter text;
+    TextSpan span;
+    char name[LSP_NAME_MAX];
+    char buffer[LSP_NAME_MAX + 64];
+    u32 line = 0;
+    int has_word = 0;
+    int has_content = 0;
+
+    json_writer_init(&text);
+    if (doc != NULL_PTR) {
+        u32 offset = position_offset(doc->inc, json_get(params, "position"));
+        line = line_at(doc->inc, offset);
+        has_word = (word_at(doc->inc, offset, &span, name) == 0);
+        if (has_word) {
+            symbol = incremental_lookup_symbol(doc->inc, name);
+        }
+    }
+
+    json_write_raw(&text, "```\n");
+    if (symbol != NULL_PTR && symbol->is_defined) {
+        /* 符号：类型、地址、定义行及其编码 */
+        u32 type = (u32)symbol->type < 4 ? (u32)symbol->type : 0;
+        snprintf(buffer, sizeof(buffer), "%s  %s  %04Xh  (line %u)\n", name, type_names[type],
+                 (unsigned int)symbol->address, (unsigned int)symbol->line_defined);
+        json_write_raw(&text, buffer);
+        describe_line(&text, doc, symbol->line_defined);
+        has_content = 1;
+    } else if (doc != NULL_PTR) {
+        has_content = describe_line(&text, doc, line);
+        has_word = 0;
+    }
+    json_write_raw(&text, "```");
+
+    begin_response(server, id);
+    if (has_content && !text.failed) {
+        json_write_raw(&server->out, "{\"contents\":{\"kind\":\"markdown\",\"value\":");
+        json_write_string(&server->out, text.data, text.len);
+        json_write_raw(&server->out, "}");
+        if (has_word) {
+            json_write_raw(&server->out, ",\"range\":");
+            write_range(&server->out, doc->inc, line, span.start, span.end);
+        }
+        json_write_raw(&server->out, "}");
+    } else {
+        json_write_raw(&server->out, "null");
+    }
+    end_message(server);
+    json_writer_dispose(&text);
+}
+
+/* ========================================================================= */
+/* API 函数实现 */
+/* ========================================================================= */
+
+LspServer* lsp_create(LspWriteFunc write, void* user) {
+    LspServer* server;
+
+    if (write == NULL_PTR) return NULL_PTR;
+    server = (LspServer*)util_malloc(sizeof(LspServer));
+    if (server == NULL_PTR) return NULL_PTR;
+
+    server->write = write;
+    server->user = user;
+    server->shutdown_requested = 0;
+    json_writer_init(&server->out);
+    server->documents = util_ht_create(LSP_DOCUMENT_BUCKETS);
+    if (server->documents == NULL_PTR) {
+        util_free(server);
+        return NULL_PTR;
+    }
+    return server;
+}
+
+int lsp_handle_message(LspServer* server, const char* message, u32 len) {
+    JsonValue* root;
+    const char* method;
+    const JsonValue* id;
+    const JsonValue* params;
+
+    if (server == NULL_PTR) return LSP_EXIT;
+
+    root = json_parse(message, len);
+    if (root == NULL_PTR) {
+        send_error(server, NULL_PTR, LSP_ERR_PARSE, "Parse error");
+        return LSP_CONTINUE;
+    }
+    method = json_get_string(root, "method");
+    id = json_get(root, "id");
+    params = json_get(root, "params");
+
+    if (method == NULL_PTR) {
+        /* 客户端对服务器请求的应答：本服务器不发请求，忽略 */
+    } else if (util_strcmp(method, "exit") == 0) {
+        json_free(root);
+        return LSP_EXIT;
+    } else if (id == NULL_PTR) {
+        /* 通知 */
+        if (util_strcmp(method, "textDocument/didOpen") == 0) {
+            handle_did_open(server, params);
+        } else if (util_strcmp(method, "textDocument/didChange") == 0) {
+            handle_did_change(server, params);
+        } else if (util_strcmp(method, "textDocument/didClose") == 0) {
+            handle_did_close(server, params);
+        }
+    } else if (util_strcmp(method, "initialize") == 0) {
+        handle_initialize(server, id);
+    } else if (util_strcmp(method, "shutdown") == 0) {
+        server->shutdown_requested = 1;
+        begin_response(server, id);
+        json_write_raw(&server->out, "null");
+        end_message(server);
+    } else if (util_strcmp(method, "textDocument/definition") == 0) {
+        handle_definition(server, id, params);
+    } else if (util_strcmp(method, "textDocument/references") == 0) {
+        handle_references(server, id, params);
+    } else if (util_strcmp(method, "textDocument/hover") == 0) {
+        handle_hover(server, id, params);
+    } else {
+        send_error(server, id, LSP_ERR_METHOD, "Method not found");
+    }
+
+    json_free(root);
+    return LSP_CONTINUE;
+}
+
+int lsp_exit_code(const LspServer* server) {
+    return (server != NULL_PTR && server->shutdown_requested) ? 0 : 1;
+}
+
+void lsp_destroy(LspServer* server) {
+    if (server == NULL_PTR) return;
+
+    UtilHashTable* documents = server->documents;
+    for (u32 b = 0; b < documents->bucket_count; b++) {
+        for (UtilHashNode* node = documents->buckets[b]; node != NULL_PTR; node = node->next) {
+            destroy_document((LspDocument*)node->value);
+        }
+    }
+    util_ht_destroy(documents);
+    json_writer_dispose(&server->out);
+    util_free(server);
+}
+
+/*
+ * 以 Content-Length 分帧写出一条消息
+ */
+static void write_framed(void* user, const char* message, u32 len) {
+    FILE* out = (FILE*)user;
+
+    fprintf(out, "Content-Length: %u\r\n\r\n", (unsigned int)len);
+    fwrite(message, 1, len, out);
+    fflush(out);
+}
+
+/*
+ * 读取一条消息的头部，得到正文长度；输入结束或头部无效时返回 -1
+ */
+static int read_header(FILE* in, u32* out_len) {
+    char line[LSP_HEADER_MAX];
+    static const char field[] = "Content-Length:";
+    u32 length = 0;
+    int has_length = 0;
+
+    while (fgets(line, sizeof(line), in) != NULL_PTR) {
+        if (line[0] == '\r' || line[0] == '\n') {
+            if (has_length) {
+                *out_len = length;
+                return 0;
+            }
+            continue;
+        }
+        u32 i = 0;
+        while (field[i] != '\0' && line[i] == field[i]) i++;
+        if (field[i] != '\0') continue;     /* 其它头部（如 Content-Type）忽略 */
+
+        while (line[i] == ' ') i++;
+        length = 0;
+        while (line[i] >= '0' && line[i] <= '9') {
+            length = length * 10 + (u32)(line[i++] - '0');
+            if (length > LSP_MAX_MESSAGE) return -1;
+        }
+        has_length = 1;
+    }
+    return -1;
+}
+
+int lsp_run(FILE* in, FILE* out) {
+    LspServer* server = lsp_create(write_framed, out);
+    u32 len;
+
+    if (server == NULL_PTR) return 1;
+
+    while (read_header(in, &len) == 0) {
+        char* body = (char*)util_malloc(len + 1);
+        if (body == NULL_PTR || fread(body, 1, len, in) != len) {
+            util_free(body);
+            break;
+        }
+        int status = lsp_handle_message(server, body, len);
+        util_free(body);
+        if (status == LSP_EXIT) break;
+    }
+
+    int code = lsp_exit_code(server);
+    lsp_destroy(server);
+    return code;
+}
@@ -6,28 +6,70 @@
  * 功能：
  *  - 解析命令行参数
  *  - 读取源文件
- *  - 初始化各个模块
- *  - 按顺序调用 lexer → semantic → codegen
+ *  - 创建 libsubas 汇编上下文
+ *  - 调用 subas_assemble 完成 lexer → semantic → codegen
  *  - 生成输出文件或二进制代码
  *  - 清理资源并报告编译结果
+ *  - 批量模式：在同一进程内用线程池汇编多个文件
  *
  * 使用方法：
- *   subas [-o OUTPUT] [-v] INPUT_FILE
+ *   subas [-o OUTPUT] [-v] [-j N] [--pipeline] INPUT_FILE
+ *   subas --batch [-j N] [--pipeline] INPUT_FILE... [@RESPONSE_FILE...]
+ *   subas --watch [-o OUTPUT] INPUT_FILE...
+ *   subas --server SOCKET [-j N]           （常驻汇编服务）
+ *   subas --connect SOCKET [-o OUTPUT] INPUT_FILE（由服务端汇编）
+ *   subas --lsp                            （语言服务器，经标准输入输出通信）
+ *   以上两种用法均可附加 --cache DIR 启用构建缓存、-MD 生成依赖文件、
+ *   --stats[=json] 输出各阶段耗时、--trace FILE 输出 Chrome 跟踪文件
  *
  * 参数：
- *   INPUT_FILE   : 源代码文件（.asm）
+ *   INPUT_FILE   : 源代码文件（.asm）；"-" 表示标准输入（仅单文件模式）
  *   -o OUTPUT    : 输出文件路径（默认为 input.com）
  *   -v          : 详细模式，打印中间结果
+ *   -j N        : 第一遍扫描使用 N 个线程（0 表示全部核心）
+ *   --pipeline  : 词法 / Pass 1 / Pass 2 以多线程流水线方式重叠执行
+ *   --batch     : 批量模式，-j 指定工作线程数（默认全部核心）
+ *   @FILE       : 响应文件，其中以空白分隔的每一项都视为输入文件
+ *   --cache DIR : 构建缓存目录；源文本未变时直接复用缓存中的产物
+ *   -MD         : 在输出文件旁生成 make 依赖文件（output.d）
+ *   -MF FILE    : 依赖文件路径（隐含 -MD，仅单文件模式）
+ *   --stats     : 打印各阶段耗时与吞吐量（--stats=json 输出单行 JSON）
+ *   --trace FILE: 输出 Chrome trace-event 跟踪文件（批量模式下每个线程一条时间线）
+ *   --stream    : 流式读入源文本，源文本与 Token 流都不整体驻留内存，内存随指令数增长（仅单文件模式）
+ *   --emit-ir FILE: 把第一遍扫描结果写成 IR 文件（仅单文件模式）
+ *   --listing FILE: 第二遍扫描的同时写出列表文件（地址、机器码、源代码、符号表；仅单文件模式）
+ *   --emit-lines FILE: 写出 地址 → 源代码行 的紧凑行号表（仅单文件模式）
+ *   -Map=FILE   : 写出按地址排序的符号映像与各段字节数（仅单文件模式）
+ *   --exe       : 输出 MZ .EXE（段名引用写入重定位表，默认 input.exe；仅单文件模式）
+ *   --obj       : 输出 OMF .OBJ（PUBLIC / EXTRN 交给链接器，默认 input.obj；可用于批量模式与缓存）
+ *   --addr2line TABLE [ADDR...]: 由行号表查询地址所在的源代码行（无地址参数时读标准输入）
+ *   --watch     : 常驻监视输入文件，文件被保存后立即以增量汇编重新生成输出
+ *   --server SOCKET : 在 Unix 域套接字上常驻接受汇编请求，-j 指定工作线程数
+ *   --connect SOCKET: 把源文本交给服务端汇编；服务端不可用时退回本地汇编
+ *   --shutdown  : 与 --connect 一起使用，关闭服务端
+ *   --lsp       : 以 Language Server Protocol 经标准输入输出为编辑器提供
+ *                 诊断、跳转定义、查找引用与悬停信息
+ *   启用缓存时第一遍扫描结果也以 IR 文件存入缓存：产物未命中而源文本未变时
+ *   映射 IR 直接执行第二遍扫描
  *
  * ============================================================================
  */
 
 #include <stdio.h>
 #include <stdlib.h>
-#include "../include/lexer.h"
-#include "../include/semantic.h"
-#include "../include/codegen.h"
-#include "../include/tables.h"
+#include "../include/subas.h"
+#include "../include/cache.h"
+#include "../include/depfile.h"
+#include "../include/listing.h"
+#include "../include/mapfile.h"
+#include "../include/exefile.h"
+#include "../include/objfile.h"
+#include "../include/linetab.h"
+#include "../include/counters.h"
+#include "../include/incremental.h"
+#include "../include/watch.h"
+#include "../include/server.h"
+#include "../include/lsp.h"
 #include "../include/error.h"
 #include "../include/utils.h"
 
@@ -35,10 +77,28 @@
 /* 常量定义 */
 /* ========================================================================= */
 
-#define MAX_SOURCE_SIZE     (64 * 1024)    /* 最大源文件大小：64KB */
-#define MAX_TOKENS          (4096)         /* 最大 Token 数 */
-#define SUBAS_VERSION       "0.1.0"
+#define READ_CHUNK_SIZE     (64 * 1024)    /* 整块读入源文件时的初始缓冲区大小 */
+#define STDIN_NAME          "-"            /* 表示标准输入的输入文件名 */
 #define DEFAULT_OUTPUT_EXT  ".com"
+#define INITIAL_INPUTS      16             /* 输入文件列表初始容量 */
+#define MAX_PATH_LENGTH     1024           /* 响应文件中单个路径的最大长度 */
+#define OUTPUT_EXT          "com"          /* 缓存条目扩展名 */
+#define EXE_EXT             "exe"          /* --exe 的默认输出扩展名 */
+#define OBJ_EXT             "obj"          /* --obj 的输出与缓存条目扩展名 */
+#define DEPFILE_EXT         "d"            /* 依赖文件扩展名 */
+#define IR_EXT              "ir"           /* 缓存中 IR 文件的扩展名 */
+
+/* 统计输出方式 */
+#define STATS_MODE_NONE     0
+#define STATS_MODE_TEXT     1              /* --stats */
+#define STATS_MODE_JSON     2              /* --stats=json */
+
+/* 缓存签名：汇编器版本与影响输出内容的选项（-j / --pipeline 不改变输出） */
+#define CACHE_SIGNATURE     "SUBAS " SUBAS_VERSION " format=com"
+#define OBJ_CACHE_SIGNATURE "SUBAS " SUBAS_VERSION " format=obj"
+
+/* IR 缓存签名：第一遍扫描结果与输出格式等选项无关，只随汇编器版本变化 */
+#define IR_CACHE_SIGNATURE  "SUBAS " SUBAS_VERSION " ir"
 
 /* ========================================================================= */
 /* 类型定义 */
@@ -48,12 +108,81 @@
  * 命令行参数结构
  */
 typedef struct {
-    char* input_file;           /* 输入源文件路径 */
+    char* input_file;           /* 输入源文件路径（单文件模式） */
     char* output_file;          /* 输出文件路径 */
     int verbose;                /* 详细模式标志 */
+    u32 threads;                /* 第一遍扫描线程数（1 为串行，0 为全部核心） */
+    int threads_given;          /* 是否显式指定了 -j */
+    int pipeline;               /* 流水线模式标志 */
+    int batch;                  /* 批量模式标志 */
+    char* cache_dir;            /* 构建缓存目录（NULL 表示不启用） */
+    int depfile;                /* 是否生成依赖文件（-MD） */
+    char* depfile_path;         /* 依赖文件路径（-MF，NULL 表示由输出文件名推导） */
+    int stats_mode;             /* 统计输出方式（STATS_MODE_*） */
+    char* trace_path;           /* Chrome 跟踪文件路径（NULL 表示不输出） */
+    u32 max_errors;             /* 输出的诊断上限（0 表示不限） */
+    int stream;                 /* 流式读入源文本（--stream） */
+    char* ir_path;              /* IR 文件输出路径（--emit-ir，NULL 表示不输出） */
+    char* listing_path;         /* 列表文件路径（--listing，NULL 表示不输出） */
+    char* lines_path;           /* 行号表输出路径（--emit-lines，NULL 表示不输出） */
+    char* map_path;             /* 映像文件路径（-Map=FILE，NULL 表示不输出） */
+    int exe;                    /* 是否输出 MZ .EXE（--exe） */
+    int obj;                    /* 是否输出 OMF .OBJ（--obj） */
+    char* addr2line_path;       /* 地址查询模式读取的行号表（--addr2line） */
+    int watch;                  /* 监视模式标志 */
+    char* server_path;          /* 服务模式监听的套接字路径（--server） */
+    char* connect_path;         /* 客户端模式连接的套接字路径（--connect） */
+    int shutdown;               /* 关闭服务端（--shutdown） */
+    int lsp;                    /* 语言服务器模式（--lsp） */
     int help;                   /* 显示帮助标志 */
+    char** inputs;              /* 全部输入文件（含响应文件展开结果，均为副本） */
+    u32 input_count;            /* 输入文件数 */
+    u32 input_capacity;         /* 输入文件列表容量 */
 } CommandLine;
 
+/*
+ * 流式输入：作为 LexerReadFunc 的用户数据
+ */
+typedef struct {
+    FILE* fp;                   /* 输入文件（或 stdin） */
+    u64 bytes;                  /* 已读取的字节数 */
+    int failed;                 /* 是否发生读取错误 */
+} InputStream;
+
+/*
+ * 批量模式中单个文件的汇编结果
+ */
+typedef struct {
+    const char* input_file;     /* 输入源文件路径 */
+    char* output_file;          /* 输出文件路径 */
+    u32 size;                   /* 生成的机器码字节数 */
+    int status;                 /* 0 成功，-1 失败 */
+    int cached;                 /* 是否由缓存命中得到 */
+    AsmStats stats;             /* 本文件各阶段耗时与计数 */
+    ErrorBuffer diagnostics;    /* 本文件的诊断（含文件读写错误，汇编诊断已按上限截断） */
+    u32 errors;                 /* 本文件的错误总数（含被去重与超限的诊断） */
+} BatchJob;
+
+/*
+ * 监视模式中的单个文件：常驻的增量汇编状态
+ */
+typedef struct {
+    const char* input_file;     /* 输入源文件路径 */
+    char* output_file;          /* 输出文件路径 */
+    IncrementalAsm* inc;        /* 汇编状态（首次读取成功前为 NULL） */
+} WatchTarget;
+
+/*
+ * 批量模式共享状态（工作线程只读，除各自的上下文与各自的任务外）
+ */
+typedef struct {
+    BatchJob* jobs;             /* 按输入顺序排列的任务 */
+    AsmContext** contexts;      /* 每个工作线程一个汇编上下文 */
+    BuildCache* cache;          /* 构建缓存（NULL 表示不启用） */
+    int depfiles;               /* 是否为每个输出生成依赖文件 */
+    int obj;                    /* 输出 OMF .OBJ（--obj）而不是 .COM */
+} BatchRun;
+
 /* ========================================================================= */
 /* 内部函数声明 */
 /* ========================================================================= */
@@ -73,29 +202,190 @@ static void print_version(void);
  */
 static int parse_command_line(int argc, char* argv[], CommandLine* cmd);
 
+/*
+ * 是否请求了由单个文件的汇编结果派生的附加输出（--emit-ir / --listing / --emit-lines / -Map）
+ * 或 .EXE 输出（--exe）：这些只在单文件模式下生成，且不直接复用缓存的 .COM 产物
+ */
+static int has_program_outputs(const CommandLine* cmd);
+
+/*
+ * 参数是否以 prefix 开头（用于 -Map=FILE 这类连写的选项）
+ */
+static int has_prefix(const char* arg, const char* prefix);
+
+/*
+ * 解析十进制无符号整数参数
+ */
+static int parse_u32(const char* text, u32* out_value);
+
+/*
+ * 把一个输入文件路径（副本）加入输入列表
+ */
+static int add_input(CommandLine* cmd, const char* path);
+
+/*
+ * 展开响应文件：以空白分隔的每一项加入输入列表
+ */
+static int load_response_file(CommandLine* cmd, const char* filename);
+
+/*
+ * 释放命令行解析时分配的资源
+ */
+static void free_command_line(CommandLine* cmd);
+
 /*
  * 读取源文件内容
  */
-static char* read_source_file(const char* filename);
+static char* read_source_file(const char* filename, u32* out_size);
+
+/*
+ * 打开输入文件（STDIN_NAME 表示标准输入），失败时报告错误并返回 NULL
+ */
+static FILE* open_input(const char* filename);
+
+/*
+ * 流式输入的读取回调（LexerReadFunc）
+ */
+static u32 read_input_stream(void* user, char* dest, u32 capacity);
 
 /*
  * 生成输出文件名
  */
-static char* generate_output_filename(const char* input_file);
+static char* generate_output_filename(const char* input_file, const char* ext);
+
+/*
+ * 把路径的扩展名替换为 ext（没有扩展名时追加）
+ */
+static char* replace_extension(const char* path, const char* ext);
+
+/*
+ * 打开依赖文件（dep_path 为 NULL 时由输出文件名推导），失败时报告错误
+ */
+static DepFile* open_depfile(const char* dep_path, const char* output_file);
 
 /*
  * 写入二进制文件
  */
 static int write_output_file(const char* filename, const u8* code, u32 size);
 
+/*
+ * 写出 MZ .EXE：映像、段基址修正与 END 指定的入口
+ */
+static int write_exe_file(const char* filename, const PassOne* pass_one, const AsmOutput* output);
+
+/*
+ * 组装并写出 OMF .OBJ；成功时 *out_data 为模块内容（调用者释放，供存入缓存）
+ */
+static int write_obj_file(const char* filename, const char* source_name, const PassOne* pass_one,
+                          const AsmOutput* output, u8** out_data, u32* out_size);
+
+/*
+ * 打开命令行指定的构建缓存（未指定或无法打开时返回 NULL）
+ */
+static BuildCache* open_build_cache(const CommandLine* cmdline);
+
+/*
+ * 打印缓存命中统计
+ */
+static void print_cache_stats(const BuildCache* cache);
+
+/*
+ * 输出产物的缓存键
+ */
+static void output_cache_key(const char* source, u32 source_size, int obj, const char* input_file,
+                             CacheKey* out);
+
+/*
+ * 从缓存取出扩展名为 ext 的产物（计入写出阶段耗时）
+ */
+static int fetch_cached(BuildCache* cache, const CacheKey* key, const char* ext,
+                        const char* output_file, AsmStats* stats, u32* out_size);
+
+/*
+ * 汇编一个已读入的源文件：启用缓存时优先载入缓存中的 IR 跳过词法与第一遍扫描，
+ * 否则完整汇编并把第一遍扫描结果存入缓存
+ */
+static int assemble_source(AsmContext* ctx, BuildCache* cache, const char* source,
+                           u32 source_size, AsmOutput* output);
+
+/*
+ * 客户端模式的第 1-5 步：由服务端汇编，写输出文件并存入缓存
+ * （返回 1 表示服务端不可用，调用者改为本地汇编）
+ */
+static int assemble_remote(const CommandLine* cmdline, const char* source, u32 source_size,
+                           const char* output_file, BuildCache* cache, const CacheKey* key,
+                           AsmStats* stats, u32* out_size, u32* out_errors);
+
+/*
+ * 单文件模式的第 1-5 步：汇编、写输出文件并存入缓存
+ */
+static int assemble_to_file(const CommandLine* cmdline, const char* source, u32 source_size,
+                            InputStream* stream, const char* output_file, BuildCache* cache,
+                            const CacheKey* key, AsmStats* stats, u32* out_size, u32* out_errors);
+
+/*
+ * 打开命令行指定的跟踪文件（未指定或无法创建时返回 NULL）
+ */
+static TraceFile* open_trace(const CommandLine* cmdline);
+
+/*
+ * 按命令行选项输出统计（文本或 JSON）
+ */
+static void report_statistics(const CommandLine* cmdline, const AsmStats* stats);
+
+/*
+ * 单文件模式：汇编一个文件并打印各步骤进度
+ */
+static int run_single(const CommandLine* cmdline);
+
+/*
+ * 批量模式：用工作窃取线程池汇编全部输入文件
+ */
+static int run_batch(const CommandLine* cmdline);
+
+/*
+ * 批量模式：查缓存或汇编一个已读入的文件并写出输出
+ */
+static void batch_assemble(BatchRun* run, AsmContext* ctx, BatchJob* job,
+                           const char* source, u32 source_size);
+
+/*
+ * 批量模式的任务函数：在工作线程上汇编一个文件
+ */
+static void batch_task(void* arg, u32 worker, u32 index);
+
+/*
+ * 服务模式：在套接字上常驻处理汇编请求，直到收到关闭请求
+ */
+static int run_server(const CommandLine* cmdline);
+
+/*
+ * 请求服务端关闭
+ */
+static int run_shutdown(const CommandLine* cmdline);
+
+/*
+ * 地址查询模式：由行号表把地址（参数或标准输入中的十六进制数）映射为源代码行
+ */
+static int run_addr2line(const CommandLine* cmdline);
+static void print_address_line(const LineTable* table, const char* text);
+
+/*
+ * 监视模式：汇编全部输入，此后每当文件被保存只重新处理改动的行
+ */
+static int run_watch(const CommandLine* cmdline);
+
+/*
+ * 重新读取并汇编一个被监视的文件，输出一行结果
+ */
+static void watch_rebuild(const CommandLine* cmdline, WatchTarget* target);
+
 /*
  * 打印编译统计信息
  */
-static void print_statistics(
-    const PassOne* pass_one,
-    const CodeGen* codegen,
-    int times_ms
-);
+static void print_statistics(const AsmStats* stats);
+static void print_memory_statistics(const AsmStats* stats);
+static void print_counters(void);
 
 /* ========================================================================= */
 /* 实现 */
@@ -107,11 +397,42 @@ static void print_usage(const char* program_name) {
     printf("Options:\n");
     printf("  -o FILE     Output file path (default: input.com)\n");
     printf("  -v          Verbose mode (print intermediate results)\n");
+    printf("  -j N        Use N threads for pass 1 (0 = all cores, default: 1)\n");
+    printf("  --pipeline  Overlap lexing, pass 1 and pass 2 on separate threads\n");
+    printf("  --batch     Assemble every input file in one process (-j = workers)\n");
+    printf("  @FILE       Read input file names from FILE (whitespace separated)\n");
+    printf("  --cache DIR Reuse outputs of unchanged sources from cache directory DIR\n");
+    printf("  -MD         Write a make dependency file next to each output (.d)\n");
+    printf("  -MF FILE    Write the dependency file to FILE (implies -MD)\n");
+    printf("  --stats     Print per-phase timing and throughput (--stats=json for JSON)\n");
+    printf("  --trace FILE  Write a Chrome trace-event file of all phases\n");
+    printf("  --max-errors N  Show at most N distinct errors (0 = unlimited, default: %u)\n",
+           (unsigned int)ERROR_DEFAULT_LIMIT);
+    printf("  --stream    Read the source through a fixed-size window (no size limit)\n");
+    printf("  --emit-ir FILE  Write the parsed program (pass 1 result) as an IR file\n");
+    printf("  --listing FILE  Write an assembly listing (address, code, source, symbols)\n");
+    printf("  --emit-lines FILE  Write a compact address-to-line table\n");
+    printf("  -Map=FILE   Write a map of symbols sorted by address with segment sizes\n");
+    printf("  --exe       Write an MZ .EXE with a segment relocation table (default: input.exe)\n");
+    printf("  --obj       Write a relocatable OMF .OBJ with PUBLIC/EXTRN (default: input.obj)\n");
+    printf("  --addr2line TABLE [ADDR...]  Map hex addresses (or stdin) to source lines\n");
+    printf("  --watch     Keep running and reassemble each input as soon as it is saved\n");
+    printf("  --server SOCKET   Serve assembly requests on a Unix socket (-j = workers)\n");
+    printf("  --connect SOCKET  Let the server at SOCKET assemble INPUT_FILE\n");
+    printf("  --shutdown  With --connect: stop the server\n");
+    printf("  --lsp       Run as a language server on standard input/output\n");
+    printf("  -           As INPUT_FILE: read the source from standard input\n");
     printf("  -h, --help  Show this help message\n");
     printf("  --version   Show version information\n");
     printf("\nExample:\n");
     printf("  %s program.asm              (Generate program.com)\n", program_name);
     printf("  %s -o out.bin program.asm   (Generate out.bin)\n", program_name);
+    printf("  %s --batch -j 8 @files.rsp  (Assemble every listed file)\n", program_name);
+    printf("  gen | %s --stream -o out.com -  (Assemble a generated source)\n", program_name);
+    printf("  %s --watch boot.asm kernel.asm  (Reassemble on every save)\n", program_name);
+    printf("  %s --server /tmp/subas.sock &   (Start a resident assembler)\n", program_name);
+    printf("  %s --connect /tmp/subas.sock program.asm  (Assemble through it)\n",
+           program_name);
 }
 
 static void print_version(void) {
@@ -127,11 +448,42 @@ static int parse_command_line(int argc, char* argv[], CommandLine* cmd) {
     cmd->input_file = NULL_PTR;
     cmd->output_file = NULL_PTR;
     cmd->verbose = 0;
+    cmd->threads = 1;
+    cmd->threads_given = 0;
+    cmd->pipeline = 0;
+    cmd->batch = 0;
+    cmd->cache_dir = NULL_PTR;
+    cmd->depfile = 0;
+    cmd->depfile_path = NULL_PTR;
+    cmd->stats_mode = STATS_MODE_NONE;
+    cmd->trace_path = NULL_PTR;
+    cmd->max_errors = ERROR_DEFAULT_LIMIT;
+    cmd->stream = 0;
+    cmd->ir_path = NULL_PTR;
+    cmd->listing_path = NULL_PTR;
+    cmd->lines_path = NULL_PTR;
+    cmd->map_path = NULL_PTR;
+    cmd->exe = 0;
+    cmd->obj = 0;
+    cmd->addr2line_path = NULL_PTR;
+    cmd->watch = 0;
+    cmd->server_path = NULL_PTR;
+    cmd->connect_path = NULL_PTR;
+    cmd->shutdown = 0;
+    cmd->lsp = 0;
     cmd->help = 0;
+    cmd->inputs = NULL_PTR;
+    cmd->input_count = 0;
+    cmd->input_capacity = 0;
 
     /* 查找选项和输入文件 */
     for (i = 1; i < argc; i++) {
-        if (argv[i][0] == '-') {
+        if (util_strcmp(argv[i], STDIN_NAME) == 0) {
+            /* 标准输入 */
+            if (add_input(cmd, argv[i]) != 0) {
+                return -1;
+            }
+        } else if (argv[i][0] == '-') {
             /* 选项处理 */
             if (util_strcmp(argv[i], "-o") == 0) {
                 /* -o 输出文件 */
@@ -143,6 +495,125 @@ static int parse_command_line(int argc, char* argv[], CommandLine* cmd) {
             } else if (util_strcmp(argv[i], "-v") == 0) {
                 /* 详细模式 */
                 cmd->verbose = 1;
+            } else if (util_strcmp(argv[i], "-j") == 0) {
+                /* -j 第一遍扫描线程数 */
+                if (i + 1 >= argc || parse_u32(argv[i + 1], &cmd->threads) != 0) {
+                    printf("Error: -j requires a numeric argument\n");
+                    return -1;
+                }
+                cmd->threads_given = 1;
+                i++;
+            } else if (util_strcmp(argv[i], "--pipeline") == 0) {
+                /* 流水线模式 */
+                cmd->pipeline = 1;
+            } else if (util_strcmp(argv[i], "--batch") == 0) {
+                /* 批量模式 */
+                cmd->batch = 1;
+            } else if (util_strcmp(argv[i], "--cache") == 0) {
+                /* --cache 构建缓存目录 */
+                if (i + 1 >= argc) {
+                    printf("Error: --cache requires a directory\n");
+                    return -1;
+                }
+                cmd->cache_dir = argv[++i];
+            } else if (util_strcmp(argv[i], "-MD") == 0) {
+                /* 生成依赖文件 */
+                cmd->depfile = 1;
+            } else if (util_strcmp(argv[i], "-MF") == 0) {
+                /* -MF 依赖文件路径 */
+                if (i + 1 >= argc) {
+                    printf("Error: -MF requires an argument\n");
+                    return -1;
+                }
+                cmd->depfile = 1;
+                cmd->depfile_path = argv[++i];
+            } else if (util_strcmp(argv[i], "--stats") == 0) {
+                /* 文本统计 */
+                cmd->stats_mode = STATS_MODE_TEXT;
+            } else if (util_strcmp(argv[i], "--stats=json") == 0) {
+                /* JSON 统计 */
+                cmd->stats_mode = STATS_MODE_JSON;
+            } else if (util_strcmp(argv[i], "--trace") == 0) {
+                /* --trace 跟踪文件 */
+                if (i + 1 >= argc) {
+                    printf("Error: --trace requires an argument\n");
+                    return -1;
+                }
+                cmd->trace_path = argv[++i];
+            } else if (util_strcmp(argv[i], "--max-errors") == 0) {
+                /* --max-errors 诊断上限 */
+                if (i + 1 >= argc || parse_u32(argv[i + 1], &cmd->max_errors) != 0) {
+                    printf("Error: --max-errors requires a numeric argument\n");
+                    return -1;
+                }
+                i++;
+            } else if (util_strcmp(argv[i], "--stream") == 0) {
+                /* 流式输入 */
+                cmd->stream = 1;
+            } else if (util_strcmp(argv[i], "--emit-ir") == 0) {
+                /* --emit-ir IR 文件 */
+                if (i + 1 >= argc) {
+                    printf("Error: --emit-ir requires an argument\n");
+                    return -1;
+                }
+                cmd->ir_path = argv[++i];
+            } else if (util_strcmp(argv[i], "--listing") == 0) {
+                /* --listing 列表文件 */
+                if (i + 1 >= argc) {
+                    printf("Error: --listing requires an argument\n");
+                    return -1;
+                }
+                cmd->listing_path = argv[++i];
+            } else if (util_strcmp(argv[i], "--emit-lines") == 0) {
+                /* --emit-lines 行号表 */
+                if (i + 1 >= argc) {
+                    printf("Error: --emit-lines requires an argument\n");
+                    return -1;
+                }
+                cmd->lines_path = argv[++i];
+            } else if (has_prefix(argv[i], "-Map=")) {
+                /* -Map=FILE 映像文件 */
+                if (argv[i][5] == '\0') {
+                    printf("Error: -Map= requires a file name\n");
+                    return -1;
+                }
+                cmd->map_path = argv[i] + 5;
+            } else if (util_strcmp(argv[i], "--exe") == 0) {
+                /* MZ EXE 输出 */
+                cmd->exe = 1;
+            } else if (util_strcmp(argv[i], "--obj") == 0) {
+                /* OMF OBJ 输出 */
+                cmd->obj = 1;
+            } else if (util_strcmp(argv[i], "--addr2line") == 0) {
+                /* --addr2line 行号表，其余参数为待查询的地址 */
+                if (i + 1 >= argc) {
+                    printf("Error: --addr2line requires a line table\n");
+                    return -1;
+                }
+                cmd->addr2line_path = argv[++i];
+            } else if (util_strcmp(argv[i], "--watch") == 0) {
+                /* 监视模式 */
+                cmd->watch = 1;
+            } else if (util_strcmp(argv[i], "--server") == 0) {
+                /* --server 服务模式 */
+                if (i + 1 >= argc) {
+                    printf("Error: --server requires a socket path\n");
+                    return -1;
+                }
+                cmd->server_path = argv[++i];
+            } else if (util_strcmp(argv[i], "--connect") == 0) {
+                /* --connect 客户端模式 */
+                if (i + 1 >= argc) {
+                    printf("Error: --connect requires a socket path\n");
+                    return -1;
+                }
+                cmd->connect_path = argv[++i];
+            } else if (util_strcmp(argv[i], "--shutdown") == 0) {
+                /* 关闭服务端 */
+                cmd->shutdown = 1;
+            } else if (util_strcmp(argv[i], "--lsp") == 0) {
+                /* 语言服务器模式 */
+                cmd->lsp = 1;
             } else if (util_strcmp(argv[i], "-h") == 0 ||
                        util_strcmp(argv[i], "--help") == 0) {
                 cmd->help = 1;
@@ -153,403 +624,1565 @@ static int parse_command_line(int argc, char* argv[], CommandLine* cmd) {
                 printf("Error: Unknown option '%s'\n", argv[i]);
                 return -1;
             }
+        } else if (argv[i][0] == '@') {
+            /* 响应文件 */
+            if (load_response_file(cmd, argv[i] + 1) != 0) {
+                return -1;
+            }
         } else {
             /* 非选项参数视为输入文件 */
-            if (cmd->input_file != NULL_PTR) {
-                printf("Error: Multiple input files specified\n");
+            if (add_input(cmd, argv[i]) != 0) {
                 return -1;
             }
-            cmd->input_file = argv[i];
         }
     }
 
-    return 0;
-}
-
-static char* read_source_file(const char* filename) {
-    FILE* fp;
-    char* buffer;
-    u32 size;
-    u32 bytes_read;
-
-    if (filename == NULL_PTR) {
-        error_report(0, ERR_SYS_FILE_IO, "No input file specified");
-        return NULL_PTR;
+    if (cmd->exe && cmd->obj) {
+        printf("Error: --exe cannot be used with --obj\n");
+        return -1;
     }
 
-    /* 打开文件 */
-    fp = fopen(filename, "rb");
-    if (fp == NULL_PTR) {
-        error_report(0, ERR_SYS_FILE_IO, "Cannot open input file");
-        return NULL_PTR;
+    if (cmd->addr2line_path != NULL_PTR) {
+        /* 地址查询模式：非选项参数是地址而不是输入文件 */
+        if (cmd->output_file != NULL_PTR || cmd->batch || cmd->watch || cmd->stream ||
+            cmd->cache_dir != NULL_PTR || cmd->depfile || has_program_outputs(cmd) || cmd->obj ||
+            cmd->trace_path != NULL_PTR || cmd->lsp ||
+            cmd->server_path != NULL_PTR || cmd->connect_path != NULL_PTR) {
+            printf("Error: --addr2line takes only addresses\n");
+            return -1;
+        }
+        return 0;
     }
 
-    /* 获取文件大小 */
-    fseek(fp, 0, SEEK_END);
-    size = (u32)ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-
-    if (size > MAX_SOURCE_SIZE) {
-        error_report(0, ERR_SYS_FILE_IO, "Input file too large");
-        fclose(fp);
-        return NULL_PTR;
+    if (cmd->lsp) {
+        /* 语言服务器从协议中获得文档，不接受输入文件与其它模式 */
+        if (cmd->input_count > 0 || cmd->output_file != NULL_PTR || cmd->batch ||
+            cmd->watch || cmd->stream || cmd->cache_dir != NULL_PTR || cmd->depfile ||
+            has_program_outputs(cmd) || cmd->obj ||
+            cmd->trace_path != NULL_PTR ||
+            cmd->server_path != NULL_PTR || cmd->connect_path != NULL_PTR) {
+            printf("Error: --lsp takes no input files or other modes\n");
+            return -1;
+        }
+    } else if (cmd->server_path != NULL_PTR || cmd->shutdown) {
+        /* 服务模式与关闭请求不处理输入文件 */
+        if (cmd->input_count > 0 || cmd->output_file != NULL_PTR || cmd->batch ||
+            cmd->watch || cmd->stream || cmd->cache_dir != NULL_PTR || cmd->depfile ||
+            has_program_outputs(cmd) || cmd->obj ||
+            cmd->trace_path != NULL_PTR) {
+            printf("Error: --server and --shutdown take no input files or output options\n");
+            return -1;
+        }
+        if (cmd->server_path != NULL_PTR && cmd->connect_path != NULL_PTR) {
+            printf("Error: --server cannot be used with --connect\n");
+            return -1;
+        }
+        if (cmd->shutdown && cmd->connect_path == NULL_PTR) {
+            printf("Error: --shutdown requires --connect\n");
+            return -1;
+        }
+        /* 服务模式下 -j 指定工作线程数，默认使用全部核心 */
+        if (!cmd->threads_given) {
+            cmd->threads = 0;
+        }
+    } else if (cmd->connect_path != NULL_PTR &&
+               (cmd->batch || cmd->watch || cmd->stream || has_program_outputs(cmd) || cmd->obj)) {
+        /* 客户端只取回机器码，不经过本地的流式输入与两遍扫描 */
+        printf("Error: --connect cannot be used with --batch, --watch, --stream, --emit-ir, "
+               "--listing, --emit-lines, -Map, --exe or --obj\n");
+        return -1;
+    } else if (cmd->watch) {
+        /* 监视模式只维护内存中的汇编状态与输出文件 */
+        if (cmd->batch || cmd->stream || cmd->cache_dir != NULL_PTR || cmd->depfile ||
+            has_program_outputs(cmd) || cmd->obj ||
+            cmd->trace_path != NULL_PTR) {
+            printf("Error: --watch cannot be used with --batch, --stream, --cache, -MD, -MF, "
+                   "--emit-ir, --listing, --emit-lines, -Map, --exe, --obj or --trace\n");
+            return -1;
+        }
+        if (cmd->output_file != NULL_PTR && cmd->input_count > 1) {
+            printf("Error: -o cannot be used with --watch and multiple input files\n");
+            return -1;
+        }
+        for (u32 k = 0; k < cmd->input_count; k++) {
+            if (util_strcmp(cmd->inputs[k], STDIN_NAME) == 0) {
+                printf("Error: Standard input cannot be used with --watch\n");
+                return -1;
+            }
+        }
+    } else if (cmd->batch) {
+        if (cmd->output_file != NULL_PTR) {
+            printf("Error: -o cannot be used with --batch\n");
+            return -1;
+        }
+        if (cmd->depfile_path != NULL_PTR) {
+            printf("Error: -MF cannot be used with --batch (use -MD)\n");
+            return -1;
+        }
+        if (cmd->stream) {
+            printf("Error: --stream cannot be used with --batch\n");
+            return -1;
+        }
+        if (has_program_outputs(cmd)) {
+            printf("Error: --emit-ir, --listing, --emit-lines, -Map and --exe cannot be used with --batch\n");
+            return -1;
+        }
+        for (u32 k = 0; k < cmd->input_count; k++) {
+            if (util_strcmp(cmd->inputs[k], STDIN_NAME) == 0) {
+                printf("Error: Standard input cannot be used with --batch\n");
+                return -1;
+            }
+        }
+        /* 批量模式下 -j 指定工作线程数，默认使用全部核心 */
+        if (!cmd->threads_given) {
+            cmd->threads = 0;
+        }
+    } else if (cmd->input_count > 1) {
+        printf("Error: Multiple input files specified\n");
+        return -1;
     }
 
-    /* 分配缓冲区 */
-    buffer = (char*)util_malloc(size + 1);
-    if (buffer == NULL_PTR) {
-        error_report(0, ERR_SYS_OUT_OF_MEM, "Cannot allocate buffer");
-        fclose(fp);
-        return NULL_PTR;
+    /* 缓存键需要完整的源文本，流式输入不保留源文本 */
+    if (cmd->stream && cmd->cache_dir != NULL_PTR) {
+        printf("Error: --stream cannot be used with --cache\n");
+        return -1;
     }
 
-    /* 读取文件 */
-    bytes_read = (u32)fread(buffer, 1, size, fp);
-    if (bytes_read != size) {
-        error_report(0, ERR_SYS_FILE_IO, "File read error");
-        util_free(buffer);
-        fclose(fp);
-        return NULL_PTR;
+    /* 列表文件逐行引用源文本，流式输入不保留源文本 */
+    if (cmd->stream && cmd->listing_path != NULL_PTR) {
+        printf("Error: --stream cannot be used with --listing\n");
+        return -1;
     }
 
-    buffer[size] = '\0';
-    fclose(fp);
+    if (cmd->input_count > 0) {
+        cmd->input_file = cmd->inputs[0];
+    }
 
-    return buffer;
+    return 0;
 }
 
-static char* generate_output_filename(const char* input_file) {
-    char* output;
-    u32 len;
-    u32 i;
-
-    if (input_file == NULL_PTR) {
-        return util_strdup("output.com");
-    }
+static int has_program_outputs(const CommandLine* cmd) {
+    return cmd->ir_path != NULL_PTR || cmd->listing_path != NULL_PTR ||
+           cmd->lines_path != NULL_PTR || cmd->map_path != NULL_PTR || cmd->exe;
+}
 
-    len = util_strlen(input_file);
-    output = (char*)util_malloc(len + 10);
-    if (output == NULL_PTR) {
-        return util_strdup("output.com");
+static int has_prefix(const char* arg, const char* prefix) {
+    while (*prefix != '\0') {
+        if (*arg++ != *prefix++) {
+            return 0;
+        }
     }
+    return 1;
+}
 
-    util_strcpy(output, input_file);
+static int add_input(CommandLine* cmd, const char* path) {
+    char* copy;
 
-    /* 替换扩展名为 .com */
-    for (i = len; i > 0; i--) {
-        if (output[i - 1] == '.') {
-            output[i] = 'c';
-            output[i + 1] = 'o';
-            output[i + 2] = 'm';
-            output[i + 3] = '\0';
-            return output;
+    if (cmd->input_count >= cmd->input_capacity) {
+        u32 new_capacity = (cmd->input_capacity == 0) ? INITIAL_INPUTS : cmd->input_capacity * 2;
+        char** grown = (char**)util_malloc(sizeof(char*) * new_capacity);
+        if (grown == NULL_PTR) {
+            return -1;
         }
+        for (u32 i = 0; i < cmd->input_count; i++) {
+            grown[i] = cmd->inputs[i];
+        }
+        util_free(cmd->inputs);
+        cmd->inputs = grown;
+        cmd->input_capacity = new_capacity;
     }
 
-    /* 没有扩展名，直接附加 */
-    output[len] = '.';
-    output[len + 1] = 'c';
-    output[len + 2] = 'o';
-    output[len + 3] = 'm';
-    output[len + 4] = '\0';
-
-    return output;
+    copy = util_strdup(path);
+    if (copy == NULL_PTR) {
+        return -1;
+    }
+    cmd->inputs[cmd->input_count++] = copy;
+    return 0;
 }
 
-static int write_output_file(const char* filename, const u8* code, u32 size) {
+static int load_response_file(CommandLine* cmd, const char* filename) {
     FILE* fp;
-    u32 bytes_written;
+    char path[MAX_PATH_LENGTH];
+    u32 len = 0;
+    int ch;
 
-    if (filename == NULL_PTR || code == NULL_PTR || size == 0) {
-        error_report(0, ERR_SYS_FILE_IO, "Invalid output parameters");
-        return -1;
-    }
-
-    fp = fopen(filename, "wb");
+    fp = fopen(filename, "rb");
     if (fp == NULL_PTR) {
-        error_report(0, ERR_SYS_FILE_IO, "Cannot create output file");
+        printf("Error: Cannot open response file '%s'\n", filename);
         return -1;
     }
 
-    bytes_written = (u32)fwrite(code, 1, size, fp);
-    if (bytes_written != size) {
-        error_report(0, ERR_SYS_FILE_IO, "File write error");
-        fclose(fp);
-        return -1;
-    }
+    /* 逐字符读取，遇到空白即结束一项 */
+    do {
+        ch = fgetc(fp);
+        if (ch == EOF || ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n') {
+            if (len > 0) {
+                path[len] = '\0';
+                if (add_input(cmd, path) != 0) {
+                    fclose(fp);
+                    return -1;
+                }
+                len = 0;
+            }
+        } else if (len + 1 < MAX_PATH_LENGTH) {
+            path[len++] = (char)ch;
+        } else {
+            printf("Error: Path too long in response file '%s'\n", filename);
+            fclose(fp);
+            return -1;
+        }
+    } while (ch != EOF);
 
     fclose(fp);
     return 0;
 }
 
-static void print_statistics(
-    const PassOne* pass_one,
-    const CodeGen* codegen,
-    int times_ms
-) {
-    u32 code_size = 0;
-    u32 reloc_count = 0;
+static void free_command_line(CommandLine* cmd) {
+    for (u32 i = 0; i < cmd->input_count; i++) {
+        util_free(cmd->inputs[i]);
+    }
+    util_free(cmd->inputs);
+    cmd->inputs = NULL_PTR;
+    cmd->input_count = 0;
+    cmd->input_file = NULL_PTR;
+}
+
+static int parse_u32(const char* text, u32* out_value) {
+    u32 value = 0;
 
-    if (pass_one != NULL_PTR) {
-        printf("  Instructions: %u\n", pass_one->instruction_count);
-        printf("  Symbol count: %u\n", symtab_get_symbol_count(pass_one->symtab));
+    if (text == NULL_PTR || *text == '\0') {
+        return -1;
     }
 
-    if (codegen != NULL_PTR) {
-        (void)codegen_get_code_buffer(codegen, &code_size);
-        (void)codegen_get_relocation_info(codegen, &reloc_count);
-        printf("  Code size: %u bytes\n", code_size);
-        printf("  Relocations: %u\n", reloc_count);
+    while (*text != '\0') {
+        if (*text < '0' || *text > '9') {
+            return -1;
+        }
+        value = value * 10 + (u32)(*text - '0');
+        text++;
     }
 
-    printf("  Compilation time: %d ms\n", times_ms);
+    *out_value = value;
+    return 0;
 }
 
-/* ========================================================================= */
-/* 主程序入口 */
-/* ========================================================================= */
-
-int main(int argc, char* argv[]) {
-    CommandLine cmdline;
-    char* source;
-    Lexer* lexer;
-    Token* tokens;
-    u32 token_count;
-    u32 token_capacity;
-    int has_eof;
-    PassOne* pass_one;
-    CodeGen* codegen;
-    char* output_file;
-    u8* code_buffer;
-    u32 code_size;
-    int error_count;
+static char* read_source_file(const char* filename, u32* out_size) {
+    FILE* fp;
+    char* buffer;
+    u32 capacity = READ_CHUNK_SIZE;
+    u32 size = 0;
+    int failed;
 
-    printf("========================================\n");
-    printf("  SUBAS v%s - Assembler\n", SUBAS_VERSION);
-    printf("========================================\n\n");
+    fp = open_input(filename);
+    if (fp == NULL_PTR) {
+        return NULL_PTR;
+    }
 
-    /* 解析命令行参数 */
-    if (parse_command_line(argc, argv, &cmdline) != 0) {
-        print_usage(argv[0]);
-        return 1;
+    /* 不依赖 ftell：管道与标准输入没有预先可知的长度，缓冲区按需翻倍 */
+    buffer = (char*)util_malloc(capacity + 1);
+    while (buffer != NULL_PTR) {
+        size += (u32)fread(buffer + size, 1, capacity - size, fp);
+        if (size < capacity) {
+            break;
+        }
+        if (capacity > 0x7FFFFFFFu) {
+            util_free(buffer);
+            buffer = NULL_PTR;
+            break;
+        }
+        char* grown = (char*)util_malloc(capacity * 2 + 1);
+        if (grown != NULL_PTR) {
+            for (u32 i = 0; i < size; i++) grown[i] = buffer[i];
+        }
+        util_free(buffer);
+        buffer = grown;
+        capacity *= 2;
     }
 
-    if (cmdline.help) {
-        print_usage(argv[0]);
-        return 0;
+    failed = ferror(fp);
+    if (fp != stdin) {
+        fclose(fp);
+    }
+    if (buffer == NULL_PTR) {
+        error_report(0, ERR_SYS_OUT_OF_MEM, "Cannot allocate buffer");
+        return NULL_PTR;
+    }
+    if (failed) {
+        error_report(0, ERR_SYS_FILE_IO, "File read error");
+        util_free(buffer);
+        return NULL_PTR;
     }
 
-    if (cmdline.input_file == NULL_PTR) {
-        printf("Error: No input file specified\n\n");
-        print_usage(argv[0]);
-        return 1;
+    buffer[size] = '\0';
+    *out_size = size;
+
+    return buffer;
+}
+
+static FILE* open_input(const char* filename) {
+    FILE* fp;
+
+    if (filename == NULL_PTR) {
+        error_report(0, ERR_SYS_FILE_IO, "No input file specified");
+        return NULL_PTR;
+    }
+    if (util_strcmp(filename, STDIN_NAME) == 0) {
+        return stdin;
     }
 
-    /* 初始化错误系统 */
-    error_init();
+    fp = fopen(filename, "rb");
+    if (fp == NULL_PTR) {
+        error_report(0, ERR_SYS_FILE_IO, "Cannot open input file");
+    }
+    return fp;
+}
 
-    if (cmdline.verbose) {
-        printf("Configuration:\n");
-        printf("  Input file: %s\n", cmdline.input_file);
-        printf("  Output file: %s\n", cmdline.output_file != NULL_PTR ?
-               cmdline.output_file : "(auto-generated)");
-        printf("  Verbose mode: ON\n\n");
+static u32 read_input_stream(void* user, char* dest, u32 capacity) {
+    InputStream* stream = (InputStream*)user;
+    u32 got = (u32)fread(dest, 1, capacity, stream->fp);
+
+    if (got < capacity && ferror(stream->fp)) {
+        stream->failed = 1;
     }
+    stream->bytes += got;
+    return got;
+}
 
-    /* ===== 第 0 步：读取源文件 ===== */
-    printf("Step 0: Reading source file...\n");
-    source = read_source_file(cmdline.input_file);
-    if (source == NULL_PTR) {
-        printf("Compilation failed!\n");
-        return 1;
+static char* generate_output_filename(const char* input_file, const char* ext) {
+    char* output = NULL_PTR;
+
+    if (input_file != NULL_PTR && util_strcmp(input_file, STDIN_NAME) != 0) {
+        output = replace_extension(input_file, ext);
+    }
+    if (output == NULL_PTR) {
+        return replace_extension("output", ext);
+    }
+    return output;
+}
+
+static char* replace_extension(const char* path, const char* ext) {
+    char* output;
+    u32 len = util_strlen(path);
+    u32 stem = len;
+    u32 i;
+
+    /* 只在最后一个路径分隔符之后查找扩展名 */
+    for (i = len; i > 0; i--) {
+        if (path[i - 1] == '/' || path[i - 1] == '\\') {
+            break;
+        }
+        if (path[i - 1] == '.') {
+            stem = i - 1;
+            break;
+        }
     }
 
-    if (cmdline.verbose) {
-        printf("  Source file size: %u bytes\n\n", (u32)util_strlen(source));
+    output = (char*)util_malloc(stem + util_strlen(ext) + 2);
+    if (output == NULL_PTR) {
+        return NULL_PTR;
     }
 
-    /* ===== 第 1 步：初始化表驱动系统 ===== */
-    printf("Step 1: Initializing tables...\n");
-    tables_init();
-    if (cmdline.verbose) {
-        printf("  Instructions loaded: %u\n\n", tables_get_instruction_count());
+    for (i = 0; i < stem; i++) {
+        output[i] = path[i];
     }
+    output[stem] = '.';
+    util_strcpy(output + stem + 1, ext);
+    return output;
+}
 
-    /* ===== 第 2 步：词法分析 (Lexing) ===== */
-    printf("Step 2: Lexical analysis (Lexing)...\n");
-    lexer = lexer_create_from_string(source);
-    if (lexer == NULL_PTR) {
-        printf("ERROR: Cannot create lexer\n");
-        printf("Compilation failed!\n");
-        util_free(source);
-        return 1;
+static DepFile* open_depfile(const char* dep_path, const char* output_file) {
+    char* derived = NULL_PTR;
+    DepFile* dep;
+
+    if (dep_path == NULL_PTR) {
+        derived = replace_extension(output_file, DEPFILE_EXT);
+        dep_path = derived;
     }
 
-    /* 收集所有 Token */
-    token_capacity = MAX_TOKENS;
-    tokens = (Token*)util_malloc(sizeof(Token) * token_capacity);
-    if (tokens == NULL_PTR) {
-        error_report(0, ERR_SYS_OUT_OF_MEM, "Cannot allocate token buffer");
-        printf("Compilation failed!\n");
-        lexer_destroy(lexer);
-        util_free(source);
-        return 1;
+    dep = (dep_path != NULL_PTR) ? depfile_open(dep_path, output_file) : NULL_PTR;
+    if (dep == NULL_PTR) {
+        error_report(0, ERR_SYS_FILE_IO, "Cannot create dependency file");
     }
 
-    token_count = 0;
-    has_eof = 0;
-    while (!has_eof) {
-        Token tok = lexer_next_token(lexer);
+    util_free(derived);
+    return dep;
+}
 
-        if (token_count >= token_capacity) {
-            printf("ERROR: Too many tokens\n");
-            printf("Compilation failed!\n");
-            util_free(tokens);
-            lexer_destroy(lexer);
-            util_free(source);
-            return 1;
+static int write_output_file(const char* filename, const u8* code, u32 size) {
+    FILE* fp;
+    u32 bytes_written;
+
+    if (filename == NULL_PTR || code == NULL_PTR || size == 0) {
+        error_report(0, ERR_SYS_FILE_IO, "Invalid output parameters");
+        return -1;
+    }
+
+    fp = fopen(filename, "wb");
+    if (fp == NULL_PTR) {
+        error_report(0, ERR_SYS_FILE_IO, "Cannot create output file");
+        return -1;
+    }
+
+    bytes_written = (u32)fwrite(code, 1, size, fp);
+    if (bytes_written != size) {
+        error_report(0, ERR_SYS_FILE_IO, "File write error");
+        fclose(fp);
+        return -1;
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+static int write_exe_file(const char* filename, const PassOne* pass_one, const AsmOutput* output) {
+    ExeImage image;
+
+    image.code = output->code;
+    image.size = output->size;
+    image.fixups = output->segment_fixups;
+    image.fixup_count = output->segment_fixup_count;
+    image.entry = exefile_entry_point(pass_one, output->instruction_offsets);
+    image.stack_size = 0;
+
+    if (exefile_write(filename, &image) != 0) {
+        error_report(0, ERR_SYS_FILE_IO, "Cannot write EXE file");
+        return -1;
+    }
+    return 0;
+}
+
+static int write_obj_file(const char* filename, const char* source_name, const PassOne* pass_one,
+                          const AsmOutput* output, u8** out_data, u32* out_size) {
+    ObjModule module;
+
+    module.source = source_name;
+    module.pass_one = pass_one;
+    module.code = output->code;
+    module.size = output->size;
+    module.offsets = output->instruction_offsets;
+    module.relocations = output->relocations;
+    module.relocation_count = output->relocation_count;
+
+    /* PUBLIC 名字无效与内存不足已由 objfile_build 报告 */
+    if (objfile_build(&module, out_data, out_size) != 0) {
+        return -1;
+    }
+    if (write_output_file(filename, *out_data, *out_size) != 0) {
+        util_free(*out_data);
+        *out_data = NULL_PTR;
+        return -1;
+    }
+    return 0;
+}
+
+static void print_statistics(const AsmStats* stats) {
+    u64 total_ns = 0;
+
+    printf("Statistics:\n");
+    if (stats->files > 1) {
+        printf("  Files: %u\n", stats->files);
+    }
+    printf("  Instructions: %llu\n", stats->instructions);
+    printf("  Symbol count: %llu\n", stats->symbols);
+    printf("  Code size: %llu bytes\n", stats->code_bytes);
+    printf("  Relocations: %llu\n", stats->relocations);
+
+    printf("  Phase            Time (ms)   Throughput\n");
+    for (u32 i = 0; i < STATS_PHASE_COUNT; i++) {
+        const char* unit;
+        u64 items;
+
+        if (stats->start_ns[i] == 0) {
+            continue;
+        }
+
+        items = stats_phase_items(stats, (StatsPhase)i, &unit);
+        total_ns += stats->elapsed_ns[i];
+        printf("  %-14s %11.3f", stats_phase_name((StatsPhase)i),
+               (double)stats->elapsed_ns[i] / 1e6);
+        if (*unit != '\0' && stats->elapsed_ns[i] > 0) {
+            printf("   %.0f %s/s", (double)items * 1e9 / (double)stats->elapsed_ns[i], unit);
         }
+        printf("\n");
+    }
+
+    printf("  Compilation time: %.3f ms\n", (double)total_ns / 1e6);
+    print_memory_statistics(stats);
+    print_counters();
+}
+
+static void print_memory_statistics(const AsmStats* stats) {
+    UtilMemStats mem;
+    u32 driver = STATS_PHASE_COUNT;
+
+    util_mem_get_stats(&mem);
+    if (mem.allocs == 0) {
+        return;
+    }
 
-        tokens[token_count] = tok;
+    printf("Memory:\n");
+    printf("  Allocations: %llu (%llu bytes), frees: %llu\n",
+           mem.allocs, mem.total_bytes, mem.frees);
+    printf("  Peak heap: %llu bytes (last raised by %s), peak RSS: %llu KB\n",
+           mem.peak_bytes, util_mem_tag_name(mem.peak_tag), util_peak_rss_kb());
 
-        if (tok.type == TOK_EOF) {
-            has_eof = 1;
+    printf("  Subsystem        Allocs    Peak (B)   At peak (B)\n");
+    for (u32 t = 0; t < UTIL_MEM_TAG_COUNT; t++) {
+        printf("  %-12s %10llu %11llu %13llu\n", util_mem_tag_name((UtilMemTag)t),
+               mem.tag_allocs[t], mem.tag_peak[t], mem.tag_at_peak[t]);
+    }
+
+    /* 峰值增量最大的阶段即决定峰值内存的阶段 */
+    printf("  Peak growth by phase:");
+    for (u32 i = 0; i < STATS_PHASE_COUNT; i++) {
+        if (stats->start_ns[i] == 0) {
+            continue;
         }
+        printf(" %s %llu", stats_phase_name((StatsPhase)i), stats->peak_growth[i]);
+        if (driver == STATS_PHASE_COUNT || stats->peak_growth[i] > stats->peak_growth[driver]) {
+            driver = i;
+        }
+    }
+    printf("\n");
+    if (driver != STATS_PHASE_COUNT) {
+        printf("  Peak driven by: %s\n", stats_phase_name((StatsPhase)driver));
+    }
 
-        token_count++;
+    printf("  Allocation sizes:");
+    for (u32 b = 0; b < UTIL_MEM_BUCKETS; b++) {
+        if (mem.histogram[b] > 0) {
+            printf(" %llu+:%llu", 1ULL << b, mem.histogram[b]);
+        }
     }
+    printf("\n");
+}
 
-    printf("  Tokens: %u\n", token_count);
-    error_count = error_get_count();
-    if (error_count > 0) {
-        printf("Lexical errors detected! (%d)\n", error_count);
-        printf("Compilation failed!\n");
-        util_free(tokens);
-        util_free(source);
-        return 1;
+/*
+ * 输出热路径计数器（仅在以 COUNTERS=1 编译时）
+ */
+static void print_counters(void) {
+    u64 lookups;
+    u64 inserts;
+
+    if (!COUNTERS_ENABLED) {
+        return;
+    }
+
+    printf("Counters:\n");
+    lookups = counters_get(COUNTER_INSN_LOOKUPS);
+    printf("  Instruction lookups: %llu, compares/lookup: %.1f, misses: %llu\n", lookups,
+           lookups ? (double)counters_get(COUNTER_INSN_COMPARES) / (double)lookups : 0.0,
+           counters_get(COUNTER_INSN_MISSES));
+
+    lookups = counters_get(COUNTER_HT_LOOKUPS);
+    inserts = counters_get(COUNTER_HT_INSERTS);
+    printf("  Hash lookups: %llu, probes/lookup: %.2f, misses: %llu\n", lookups,
+           lookups ? (double)counters_get(COUNTER_HT_LOOKUP_PROBES) / (double)lookups : 0.0,
+           counters_get(COUNTER_HT_LOOKUP_MISSES));
+    printf("  Hash inserts: %llu, probes/insert: %.2f, max chain: %llu, max load: %.3f\n",
+           inserts,
+           inserts ? (double)counters_get(COUNTER_HT_INSERT_PROBES) / (double)inserts : 0.0,
+           counters_get(COUNTER_HT_MAX_CHAIN),
+           (double)counters_get(COUNTER_HT_MAX_LOAD) / 1000.0);
+
+    printf("  Tokens: %llu\n", counters_get(COUNTER_TOKENS));
+    for (u32 t = 0; t < COUNTER_TOKEN_TYPES; t++) {
+        u64 count = counters_get((CounterId)(COUNTER_TOKEN_BASE + t));
+        if (count > 0) {
+            printf("    %-18s %llu\n", counters_name((CounterId)(COUNTER_TOKEN_BASE + t)), count);
+        }
     }
-    lexer_destroy(lexer);
 
-    /* ===== 第 3 步：语义分析 (Pass 1) ===== */
-    printf("Step 3: Semantic analysis (Pass 1)...\n");
-    pass_one = semantic_pass_one(tokens, token_count);
+    printf("  Relocations: %llu, resolved: %llu, resolve time: %.3f ms\n",
+           counters_get(COUNTER_RELOCATIONS), counters_get(COUNTER_RELOC_RESOLVED),
+           (double)counters_get(COUNTER_RELOC_RESOLVE_NS) / 1e6);
+}
 
-    if (pass_one == NULL_PTR) {
-        printf("ERROR: Semantic analysis failed (pass_one is NULL)\n");
-        printf("Compilation failed!\n");
-        util_free(tokens);
-        util_free(source);
-        return 1;
+static TraceFile* open_trace(const CommandLine* cmdline) {
+    TraceFile* trace;
+
+    if (cmdline->trace_path == NULL_PTR) {
+        return NULL_PTR;
     }
 
-    printf("  Instructions: %u\n", pass_one->instruction_count);
-    printf("  Code size: 0x%04X\n", pass_one->current_address);
-    printf("  Symbols: %u\n", symtab_get_symbol_count(pass_one->symtab));
+    trace = trace_open(cmdline->trace_path);
+    if (trace == NULL_PTR) {
+        printf("Warning: Cannot create trace file '%s'\n", cmdline->trace_path);
+    }
+    return trace;
+}
 
-    error_count = error_get_count();
-    if (error_count > 0) {
-        printf("Semantic errors detected! (%d)\n", error_count);
-        printf("Compilation failed!\n");
-        semantic_pass_one_destroy(pass_one);
-        util_free(tokens);
-        util_free(source);
-        return 1;
+static void report_statistics(const CommandLine* cmdline, const AsmStats* stats) {
+    if (cmdline->stats_mode == STATS_MODE_TEXT) {
+        print_statistics(stats);
+    } else if (cmdline->stats_mode == STATS_MODE_JSON) {
+        stats_write_json(stdout, stats);
     }
+}
 
-    if (cmdline.verbose) {
-        printf("\n");
+static BuildCache* open_build_cache(const CommandLine* cmdline) {
+    BuildCache* cache;
+
+    if (cmdline->cache_dir == NULL_PTR) {
+        return NULL_PTR;
     }
 
-    /* ===== 第 4 步：代码生成 (Pass 2) ===== */
-    printf("Step 4: Code generation (Pass 2)...\n");
-    codegen = codegen_pass_two(pass_one);
-    if (codegen == NULL_PTR) {
-        printf("ERROR: Code generation failed\n");
-        printf("Compilation failed!\n");
-        semantic_pass_one_destroy(pass_one);
-        util_free(tokens);
-        util_free(source);
-        return 1;
+    cache = cache_open(cmdline->cache_dir);
+    if (cache == NULL_PTR) {
+        printf("Warning: Cannot use cache directory '%s', caching disabled\n", cmdline->cache_dir);
     }
+    return cache;
+}
 
-    code_buffer = codegen_get_code_buffer(codegen, &code_size);
-    printf("  Generated code size: %u bytes\n", code_size);
+static void print_cache_stats(const BuildCache* cache) {
+    u32 hits;
+    u32 misses;
 
-    error_count = error_get_count();
-    if (error_count > 0) {
-        printf("Code generation errors detected! (%d)\n", error_count);
-        printf("Compilation failed!\n");
-        codegen_destroy(codegen);
-        semantic_pass_one_destroy(pass_one);
-        util_free(tokens);
-        util_free(source);
-        return 1;
+    cache_get_stats(cache, &hits, &misses);
+    printf("Cache: %u hit(s), %u miss(es)\n", hits, misses);
+}
+
+static void output_cache_key(const char* source, u32 source_size, int obj, const char* input_file,
+                             CacheKey* out) {
+    char signature[MAX_PATH_LENGTH + 64];
+
+    if (!obj) {
+        cache_key(source, source_size, CACHE_SIGNATURE, out);
+        return;
     }
+    /* THEADR 记录由文件名得到的模块名：同一源文本在不同文件名下是不同的产物 */
+    snprintf(signature, sizeof(signature), "%s %s", OBJ_CACHE_SIGNATURE, input_file);
+    cache_key(source, source_size, signature, out);
+}
 
-    if (cmdline.verbose) {
-        printf("\n");
+static int fetch_cached(BuildCache* cache, const CacheKey* key, const char* ext,
+                        const char* output_file, AsmStats* stats, u32* out_size) {
+    int result;
+
+    stats_phase_begin(stats, STATS_PHASE_WRITE);
+    result = cache_fetch(cache, key, ext, output_file, out_size);
+    stats_phase_end(stats, STATS_PHASE_WRITE);
+    if (result == 0) {
+        stats->code_bytes = *out_size;
+    } else {
+        /* 未命中：丢弃这次查找的计时，写出阶段由随后的汇编重新记录 */
+        stats->start_ns[STATS_PHASE_WRITE] = 0;
+        stats->elapsed_ns[STATS_PHASE_WRITE] = 0;
+    }
+    return result;
+}
+
+static int assemble_source(AsmContext* ctx, BuildCache* cache, const char* source,
+                           u32 source_size, AsmOutput* output) {
+    CacheKey key;
+    u8* ir;
+    u32 ir_size = 0;
+    int result = 1;
+
+    if (cache == NULL_PTR) {
+        return subas_assemble(ctx, source, source_size, output);
+    }
+
+    cache_key(source, source_size, IR_CACHE_SIGNATURE, &key);
+    ir = cache_load(cache, &key, IR_EXT, &ir_size);
+    if (ir != NULL_PTR) {
+        result = subas_assemble_ir_data(ctx, ir, ir_size, output);
+        util_free(ir);
+    }
+    if (result != 1) {
+        return result;
+    }
+
+    /* IR 不存在或不可用：完整汇编，成功后保存第一遍扫描结果 */
+    result = subas_assemble(ctx, source, source_size, output);
+    if (result == 0) {
+        u32 size = 0;
+        u8* data = irfile_serialize(subas_get_pass_one(ctx), &size);
+        if (data != NULL_PTR) {
+            cache_store(cache, &key, IR_EXT, data, size);
+            util_free(data);
+        }
+    }
+    return result;
+}
+
+static int assemble_to_file(const CommandLine* cmdline, const char* source, u32 source_size,
+                            InputStream* stream, const char* output_file, BuildCache* cache,
+                            const CacheKey* key, AsmStats* stats, u32* out_size, u32* out_errors) {
+    int status;
+    int written;
+    AsmOptions options;
+    AsmContext* ctx;
+    AsmOutput output;
+    Listing* listing = NULL_PTR;
+    u8* object = NULL_PTR;
+    u32 object_size = 0;
+
+    /* 客户端模式：服务端不可用时继续本地汇编，输出与退出码不变 */
+    if (cmdline->connect_path != NULL_PTR) {
+        status = assemble_remote(cmdline, source, source_size, output_file, cache, key,
+                                 stats, out_size, out_errors);
+        if (status <= 0) {
+            return status;
+        }
+        printf("WARNING: Cannot reach server at %s, assembling locally\n",
+               cmdline->connect_path);
+    }
+
+    /* ===== 第 1-4 步：由 libsubas 完成（表初始化、词法、Pass 1、Pass 2） ===== */
+    subas_options_init(&options);
+    options.pass_one_threads = cmdline->threads;
+    options.pipeline = cmdline->pipeline;
+    options.progress = 1;
+    options.verbose = cmdline->verbose;
+    options.echo_diagnostics = 1;
+    options.max_errors = cmdline->max_errors;
+    options.format = cmdline->exe ? SUBAS_FORMAT_EXE :
+                     cmdline->obj ? SUBAS_FORMAT_OBJ : SUBAS_FORMAT_COM;
+
+    /* 列表文件在第二遍扫描中逐条指令写出 */
+    if (cmdline->listing_path != NULL_PTR) {
+        listing = listing_open(cmdline->listing_path, cmdline->input_file, source, source_size);
+        if (listing == NULL_PTR) {
+            error_report(0, ERR_SYS_FILE_IO, "Cannot create listing file");
+            return -1;
+        }
+        options.listener = listing_instruction;
+        options.listener_user = listing;
+    }
+
+    ctx = subas_context_create(&options);
+    if (ctx == NULL_PTR) {
+        listing_close(listing, NULL_PTR);
+        return -1;
+    }
+
+    if (stream != NULL_PTR) {
+        status = subas_assemble_stream(ctx, read_input_stream, stream, &output);
+        stats->source_bytes = stream->bytes;
+        if (stream->failed) {
+            error_report(0, ERR_SYS_FILE_IO, "File read error");
+            status = -1;
+        }
+    } else {
+        status = assemble_source(ctx, cache, source, source_size, &output);
+    }
+
+    /* 汇编失败时列表仍保留已生成的各行，只是不附符号表 */
+    if (listing != NULL_PTR &&
+        listing_close(listing, (status == 0) ? subas_get_pass_one(ctx)->symtab : NULL_PTR) != 0) {
+        error_report(0, ERR_SYS_FILE_IO, "Cannot write listing file");
+        status = -1;
+    }
+    if (status != 0) {
+        subas_context_destroy(ctx);
+        return -1;
+    }
+    stats_merge(stats, subas_get_stats(ctx));
+
+    /* 由 IR 缓存得到的结果同样可以写出：IR 文件内容相同 */
+    if (cmdline->ir_path != NULL_PTR &&
+        irfile_write(subas_get_pass_one(ctx), cmdline->ir_path) != 0) {
+        error_report(0, ERR_SYS_FILE_IO, "Cannot write IR file");
+        subas_context_destroy(ctx);
+        return -1;
+    }
+    if (cmdline->lines_path != NULL_PTR &&
+        linetab_write(subas_get_pass_one(ctx), output.instruction_offsets, cmdline->input_file,
+                      cmdline->lines_path) != 0) {
+        error_report(0, ERR_SYS_FILE_IO, "Cannot write line table");
+        subas_context_destroy(ctx);
+        return -1;
+    }
+    if (cmdline->map_path != NULL_PTR &&
+        mapfile_write(subas_get_pass_one(ctx), output.instruction_offsets, cmdline->input_file,
+                      output.size, cmdline->map_path) != 0) {
+        error_report(0, ERR_SYS_FILE_IO, "Cannot write map file");
+        subas_context_destroy(ctx);
+        return -1;
     }
 
     /* ===== 第 5 步：输出文件生成 ===== */
     printf("Step 5: Output file generation...\n");
 
-    if (cmdline.output_file == NULL_PTR) {
-        output_file = generate_output_filename(cmdline.input_file);
+    stats_phase_begin(stats, STATS_PHASE_WRITE);
+    if (cmdline->exe) {
+        written = write_exe_file(output_file, subas_get_pass_one(ctx), &output);
+    } else if (cmdline->obj) {
+        written = write_obj_file(output_file, cmdline->input_file, subas_get_pass_one(ctx),
+                                 &output, &object, &object_size);
     } else {
-        output_file = cmdline.output_file;
+        written = write_output_file(output_file, output.code, output.size);
+    }
+    stats_phase_end(stats, STATS_PHASE_WRITE);
+    if (written != 0) {
+        printf("ERROR: Cannot write output file\n");
+        subas_context_destroy(ctx);
+        return -1;
     }
 
-    if (write_output_file(output_file, code_buffer, code_size) != 0) {
+    /* 缓存条目是 .COM 或 .OBJ 产物：.EXE 只经由 IR 缓存加速 */
+    if (cmdline->obj) {
+        if (cache != NULL_PTR) {
+            cache_store(cache, key, OBJ_EXT, object, object_size);
+        }
+        util_free(object);
+    } else if (cache != NULL_PTR && !cmdline->exe) {
+        cache_store(cache, key, OUTPUT_EXT, output.code, output.size);
+    }
+
+    *out_size = cmdline->obj ? object_size : output.size;
+    *out_errors = subas_get_error_count(ctx);
+    subas_context_destroy(ctx);
+    return 0;
+}
+
+static int assemble_remote(const CommandLine* cmdline, const char* source, u32 source_size,
+                           const char* output_file, BuildCache* cache, const CacheKey* key,
+                           AsmStats* stats, u32* out_size, u32* out_errors) {
+    ServerReply reply;
+    int written;
+
+    if (server_assemble(cmdline->connect_path, SERVER_REQ_ASSEMBLE, source, source_size,
+                        cmdline->max_errors, &reply) != 0) {
+        return 1;
+    }
+    printf("Step 1-4: Assembled by server (%s)\n", cmdline->connect_path);
+
+    /* 服务端收集的诊断文本与本地汇编写到 stderr 的完全相同 */
+    if (reply.diagnostics_size > 0) {
+        fwrite(reply.diagnostics, 1, reply.diagnostics_size, stderr);
+        fflush(stderr);
+    }
+    if (reply.status != 0) {
+        server_reply_dispose(&reply);
+        return -1;
+    }
+
+    /* ===== 第 5 步：输出文件生成 ===== */
+    printf("Step 5: Output file generation...\n");
+
+    stats_phase_begin(stats, STATS_PHASE_WRITE);
+    written = write_output_file(output_file, reply.code, reply.code_size);
+    stats_phase_end(stats, STATS_PHASE_WRITE);
+    if (written != 0) {
         printf("ERROR: Cannot write output file\n");
+        server_reply_dispose(&reply);
+        return -1;
+    }
+
+    if (cache != NULL_PTR) {
+        cache_store(cache, key, OUTPUT_EXT, reply.code, reply.code_size);
+    }
+
+    *out_size = reply.code_size;
+    *out_errors = reply.error_count;
+    server_reply_dispose(&reply);
+    return 0;
+}
+
+static int run_single(const CommandLine* cmdline) {
+    char* source = NULL_PTR;
+    u32 source_size = 0;
+    InputStream stream;
+    InputStream* input = NULL_PTR;
+    char* output_file;
+    BuildCache* cache;
+    DepFile* dep = NULL_PTR;
+    TraceFile* trace;
+    AsmStats stats;
+    CacheKey key;
+    char key_text[CACHE_KEY_TEXT];
+    u32 output_size = 0;
+    u32 error_count = 0;
+    int result = 0;
+
+    if (cmdline->verbose) {
+        printf("Configuration:\n");
+        printf("  Input file: %s\n", cmdline->input_file);
+        printf("  Output file: %s\n", cmdline->output_file != NULL_PTR ?
+               cmdline->output_file : "(auto-generated)");
+        printf("  Pass 1 threads: %u\n", cmdline->threads);
+        printf("  Pipeline mode: %s\n", cmdline->pipeline ? "ON" : "OFF");
+        if (cmdline->cache_dir != NULL_PTR) {
+            printf("  Cache directory: %s\n", cmdline->cache_dir);
+        }
+        if (cmdline->depfile) {
+            printf("  Dependency file: %s\n", cmdline->depfile_path != NULL_PTR ?
+                   cmdline->depfile_path : "(auto-generated)");
+        }
+        printf("  Verbose mode: ON\n\n");
+    }
+
+    /* 跟踪文件以此刻为时间零点 */
+    trace = open_trace(cmdline);
+    stats_init(&stats);
+    stats.files = 1;
+
+    /* ===== 第 0 步：读取源文件 ===== */
+    /* 流式模式只打开输入，源文本在词法分析时分块读入 */
+    printf("Step 0: Reading source file...\n");
+    stats_phase_begin(&stats, STATS_PHASE_READ);
+    if (cmdline->stream) {
+        stream.fp = open_input(cmdline->input_file);
+        stream.bytes = 0;
+        stream.failed = 0;
+        input = (stream.fp != NULL_PTR) ? &stream : NULL_PTR;
+    } else {
+        source = read_source_file(cmdline->input_file, &source_size);
+    }
+    stats_phase_end(&stats, STATS_PHASE_READ);
+    if (source == NULL_PTR && input == NULL_PTR) {
+        error_flush();
+        printf("Compilation failed!\n");
+        trace_close(trace);
+        return 1;
+    }
+    stats.source_bytes = source_size;
+
+    if (cmdline->verbose && input == NULL_PTR) {
+        printf("  Source file size: %u bytes\n\n", source_size);
+    }
+
+    if (cmdline->output_file == NULL_PTR) {
+        output_file = generate_output_filename(cmdline->input_file,
+                                               cmdline->exe ? EXE_EXT :
+                                               cmdline->obj ? OBJ_EXT : OUTPUT_EXT);
+    } else {
+        output_file = cmdline->output_file;
+    }
+
+    /* 依赖文件随读取流式写出：目前只有源文件本身 */
+    if (cmdline->depfile) {
+        dep = open_depfile(cmdline->depfile_path, output_file);
+        if (dep == NULL_PTR) {
+            result = -1;
+        }
+        if (util_strcmp(cmdline->input_file, STDIN_NAME) != 0) {
+            depfile_add(dep, cmdline->input_file);
+        }
+    }
+
+    /* 缓存命中时跳过词法分析与两遍扫描；附加输出（IR、列表、行号表、映像）由
+       汇编结果派生，请求它们时只复用 IR */
+    cache = open_build_cache(cmdline);
+    if (cache != NULL_PTR) {
+        output_cache_key(source, source_size, cmdline->obj, cmdline->input_file, &key);
+    }
+
+    if (result == 0 && cache != NULL_PTR && !has_program_outputs(cmdline) &&
+        fetch_cached(cache, &key, cmdline->obj ? OBJ_EXT : OUTPUT_EXT, output_file,
+                     &stats, &output_size) == 0) {
+        cache_key_text(&key, key_text);
+        printf("Step 1-4: Cache hit (%.16s), assembly skipped\n", key_text);
+        printf("Step 5: Output file generation...\n");
+    } else if (result == 0) {
+        result = assemble_to_file(cmdline, source, source_size, input, output_file, cache,
+                                  &key, &stats, &output_size, &error_count);
+    }
+    if (input != NULL_PTR && input->fp != stdin) {
+        fclose(input->fp);
+    }
+
+    if (result == 0) {
+        result = depfile_close(dep);
+        dep = NULL_PTR;
+        if (result != 0) {
+            error_report(0, ERR_SYS_FILE_IO, "Cannot write dependency file");
+        }
+    }
+
+    if (result != 0) {
+        error_flush();
         printf("Compilation failed!\n");
-        if (cmdline.output_file == NULL_PTR) {
+        depfile_abort(dep);
+        if (cmdline->output_file == NULL_PTR) {
             util_free(output_file);
         }
-        codegen_destroy(codegen);
-        semantic_pass_one_destroy(pass_one);
-        util_free(tokens);
+        cache_close(cache);
+        trace_close(trace);
         util_free(source);
         return 1;
     }
 
-    printf("  Output file: %s (%u bytes)\n", output_file, code_size);
+    printf("  Output file: %s (%u bytes)\n", output_file, output_size);
+    trace_add(trace, &stats, cmdline->input_file);
+    if (trace_close(trace) != 0) {
+        printf("Warning: Cannot write trace file '%s'\n", cmdline->trace_path);
+    }
 
     /* ===== 清理资源 ===== */
     printf("\nStep 6: Cleanup...\n");
-    codegen_destroy(codegen);
-    semantic_pass_one_destroy(pass_one);
-
-    /* 释放 Token 的 lexeme */
-    for (u32 i = 0; i < token_count; i++) {
-        if (tokens[i].lexeme != NULL_PTR) {
-            util_free(tokens[i].lexeme);
-        }
-    }
-    util_free(tokens);
     util_free(source);
 
-    if (cmdline.output_file == NULL_PTR) {
-        util_free(output_file);
+    if (cmdline->stats_mode == STATS_MODE_TEXT) {
+        printf("\n");
+        report_statistics(cmdline, &stats);
     }
 
     /* ===== 编译完成 ===== */
-    error_count = error_get_count();
-
     printf("\n========================================\n");
     printf("COMPILATION COMPLETE\n");
     printf("========================================\n");
-    printf("Errors: %d\n", error_count);
+    printf("Errors: %u\n", error_count);
+    if (cache != NULL_PTR) {
+        print_cache_stats(cache);
+        cache_close(cache);
+    }
 
     if (error_count == 0) {
         printf("Status: SUCCESS ✓\n");
         printf("\nOutput file '%s' generated successfully!\n", output_file);
         printf("========================================\n");
-        return 0;
     } else {
         printf("Status: FAILED ✗\n");
         printf("========================================\n");
+    }
+
+    /* JSON 统计作为最后一行输出，便于脚本截取 */
+    if (cmdline->stats_mode == STATS_MODE_JSON) {
+        report_statistics(cmdline, &stats);
+    }
+
+    if (cmdline->output_file == NULL_PTR) {
+        util_free(output_file);
+    }
+
+    return (error_count == 0) ? 0 : 1;
+}
+
+static void batch_assemble(BatchRun* run, AsmContext* ctx, BatchJob* job,
+                           const char* source, u32 source_size) {
+    AsmOutput output;
+    CacheKey key;
+
+    /* 缓存命中时跳过词法分析与两遍扫描 */
+    if (run->cache != NULL_PTR) {
+        output_cache_key(source, source_size, run->obj, job->input_file, &key);
+        if (fetch_cached(run->cache, &key, run->obj ? OBJ_EXT : OUTPUT_EXT, job->output_file,
+                         &job->stats, &job->size) == 0) {
+            job->status = 0;
+            job->cached = 1;
+            return;
+        }
+    }
+
+    /* 汇编诊断保存在本工作线程的上下文中，完成后移交给本文件（此时记录为空） */
+    if (assemble_source(ctx, run->cache, source, source_size, &output) == 0) {
+        u8* object = NULL_PTR;
+        u32 object_size = 0;
+        int written;
+
+        stats_merge(&job->stats, subas_get_stats(ctx));
+        error_capture_begin(&job->diagnostics);
+        stats_phase_begin(&job->stats, STATS_PHASE_WRITE);
+        if (run->obj) {
+            written = write_obj_file(job->output_file, job->input_file, subas_get_pass_one(ctx),
+                                     &output, &object, &object_size);
+        } else {
+            written = write_output_file(job->output_file, output.code, output.size);
+        }
+        stats_phase_end(&job->stats, STATS_PHASE_WRITE);
+        if (written == 0 && run->obj) {
+            job->size = object_size;
+            job->status = 0;
+            if (run->cache != NULL_PTR) {
+                cache_store(run->cache, &key, OBJ_EXT, object, object_size);
+            }
+            util_free(object);
+        } else if (written == 0) {
+            job->size = output.size;
+            job->status = 0;
+            if (run->cache != NULL_PTR) {
+                cache_store(run->cache, &key, OUTPUT_EXT, output.code, output.size);
+            }
+        }
+        error_capture_end();
+    } else {
+        job->errors = subas_get_error_count(ctx);
+        subas_take_diagnostics(ctx, &job->diagnostics);
+    }
+}
+
+static void batch_task(void* arg, u32 worker, u32 index) {
+    BatchRun* run = (BatchRun*)arg;
+    BatchJob* job = &run->jobs[index];
+    char* source;
+    u32 source_size = 0;
+    DepFile* dep = NULL_PTR;
+
+    job->output_file = generate_output_filename(job->input_file, run->obj ? OBJ_EXT : OUTPUT_EXT);
+    job->size = 0;
+    job->status = -1;
+    job->cached = 0;
+    stats_init(&job->stats);
+    job->stats.files = 1;
+    error_buffer_init(&job->diagnostics);
+    job->errors = 0;
+
+    /* 文件读取错误记入本文件的诊断，而不是直接输出 */
+    error_capture_begin(&job->diagnostics);
+    stats_phase_begin(&job->stats, STATS_PHASE_READ);
+    source = read_source_file(job->input_file, &source_size);
+    stats_phase_end(&job->stats, STATS_PHASE_READ);
+    if (source != NULL_PTR && run->depfiles) {
+        dep = open_depfile(NULL_PTR, job->output_file);
+    }
+    error_capture_end();
+    if (source == NULL_PTR || (run->depfiles && dep == NULL_PTR)) {
+        util_free(source);
+        return;
+    }
+    depfile_add(dep, job->input_file);
+    job->stats.source_bytes = source_size;
+
+    batch_assemble(run, run->contexts[worker], job, source, source_size);
+    util_free(source);
+
+    if (job->status != 0) {
+        depfile_abort(dep);
+    } else if (depfile_close(dep) != 0) {
+        error_capture_begin(&job->diagnostics);
+        error_report(0, ERR_SYS_FILE_IO, "Cannot write dependency file");
+        error_capture_end();
+        job->status = -1;
+    }
+}
+
+static int run_batch(const CommandLine* cmdline) {
+    BatchRun run;
+    AsmOptions options;
+    TraceFile* trace;
+    AsmStats totals;
+    u32 workers = cmdline->threads;
+    u32 failed = 0;
+
+    if (workers == 0) {
+        workers = util_cpu_count();
+    }
+    if (workers > cmdline->input_count) {
+        workers = cmdline->input_count;
+    }
+
+    printf("Batch mode: %u file(s), %u worker(s)\n\n", cmdline->input_count, workers);
+
+    run.jobs = (BatchJob*)util_malloc(sizeof(BatchJob) * cmdline->input_count);
+    run.contexts = (AsmContext**)util_malloc(sizeof(AsmContext*) * workers);
+    run.cache = open_build_cache(cmdline);
+    run.depfiles = cmdline->depfile;
+    run.obj = cmdline->obj;
+    if (run.jobs == NULL_PTR || run.contexts == NULL_PTR) {
+        printf("Compilation failed!\n");
+        util_free(run.jobs);
+        util_free(run.contexts);
+        cache_close(run.cache);
         return 1;
     }
+
+    /* 每个工作线程一个上下文：诊断互不干扰，Token 缓冲区跨文件复用 */
+    subas_options_init(&options);
+    options.pipeline = cmdline->pipeline;
+    options.max_errors = cmdline->max_errors;
+    options.format = cmdline->obj ? SUBAS_FORMAT_OBJ : SUBAS_FORMAT_COM;
+    for (u32 w = 0; w < workers; w++) {
+        run.contexts[w] = subas_context_create(&options);
+        if (run.contexts[w] == NULL_PTR) {
+            printf("Compilation failed!\n");
+            for (u32 k = 0; k < w; k++) {
+                subas_context_destroy(run.contexts[k]);
+            }
+            util_free(run.jobs);
+            util_free(run.contexts);
+            cache_close(run.cache);
+            return 1;
+        }
+    }
+
+    for (u32 i = 0; i < cmdline->input_count; i++) {
+        run.jobs[i].input_file = cmdline->inputs[i];
+    }
+
+    /* 各文件的诊断已由工作线程上下文按上限截断，回放时不再累计限量 */
+    error_set_limit(0);
+    trace = open_trace(cmdline);
+    stats_init(&totals);
+    util_parallel_for(cmdline->input_count, workers, batch_task, &run);
+
+    /* 按输入顺序汇总：结果与诊断的输出顺序与调度无关 */
+    for (u32 i = 0; i < cmdline->input_count; i++) {
+        BatchJob* job = &run.jobs[i];
+
+        if (job->status == 0 && job->diagnostics.count == 0) {
+            printf("  [OK]   %s -> %s (%u bytes%s)\n", job->input_file, job->output_file,
+                   job->size, job->cached ? ", cached" : "");
+        } else {
+            if (job->errors < job->diagnostics.count) {
+                job->errors = job->diagnostics.count;
+            }
+            printf("  [FAIL] %s (%u errors)\n", job->input_file, job->errors);
+            failed++;
+        }
+
+        /* 先刷新 stdout，保证诊断紧跟在所属文件之后 */
+        fflush(stdout);
+        error_buffer_replay(&job->diagnostics);
+        error_flush();
+
+        stats_merge(&totals, &job->stats);
+        trace_add(trace, &job->stats, job->input_file);
+
+        error_buffer_dispose(&job->diagnostics);
+        util_free(job->output_file);
+    }
+
+    if (trace_close(trace) != 0) {
+        printf("Warning: Cannot write trace file '%s'\n", cmdline->trace_path);
+    }
+    if (cmdline->stats_mode == STATS_MODE_TEXT) {
+        printf("\n");
+        report_statistics(cmdline, &totals);
+    }
+
+    for (u32 w = 0; w < workers; w++) {
+        subas_context_destroy(run.contexts[w]);
+    }
+    util_free(run.jobs);
+    util_free(run.contexts);
+
+    printf("\n========================================\n");
+    printf("BATCH COMPLETE\n");
+    printf("========================================\n");
+    printf("Files: %u\n", cmdline->input_count);
+    printf("Succeeded: %u\n", cmdline->input_count - failed);
+    printf("Failed: %u\n", failed);
+    printf("Errors: %u\n", error_get_count());
+    if (run.cache != NULL_PTR) {
+        print_cache_stats(run.cache);
+        cache_close(run.cache);
+    }
+    printf("Status: %s\n", (failed == 0) ? "SUCCESS ✓" : "FAILED ✗");
+    printf("========================================\n");
+
+    /* JSON 统计作为最后一行输出，便于脚本截取 */
+    if (cmdline->stats_mode == STATS_MODE_JSON) {
+        report_statistics(cmdline, &totals);
+    }
+
+    return (failed == 0) ? 0 : 1;
+}
+
+static void watch_rebuild(const CommandLine* cmdline, WatchTarget* target) {
+    ErrorContext diagnostics;
+    ErrorContext* previous;
+    u64 start = util_time_ns();
+    u32 source_size = 0;
+    char* source;
+    const char* mode = "full build";
+    int status = -1;
+
+    /* 每次重新汇编使用独立的诊断上下文：计数、去重与上限互不影响 */
+    error_context_init(&diagnostics, 1, 0);
+    previous = error_bind(&diagnostics);
+    error_set_limit(cmdline->max_errors);
+
+    source = read_source_file(target->input_file, &source_size);
+    if (source != NULL_PTR && target->inc == NULL_PTR) {
+        target->inc = incremental_create(source, source_size);
+        if (target->inc == NULL_PTR) {
+            error_report(0, ERR_SYS_OUT_OF_MEM, "Cannot create assembly state");
+        }
+    } else if (source != NULL_PTR) {
+        /* 与内存中的源文本比较，去掉公共前后缀，剩余部分作为一次编辑 */
+        u32 old_size = 0;
+        const char* old = incremental_get_source(target->inc, &old_size);
+        u32 limit = (old_size < source_size) ? old_size : source_size;
+        u32 prefix = 0;
+        u32 suffix = 0;
+        u32 builds = incremental_get_stats(target->inc)->full_builds;
+
+        while (prefix < limit && old[prefix] == source[prefix]) prefix++;
+        while (suffix < limit - prefix &&
+               old[old_size - 1 - suffix] == source[source_size - 1 - suffix]) suffix++;
+
+        /* 内容未变（如只更新了时间戳）：输出保持不变 */
+        if (prefix == old_size && prefix == source_size) {
+            error_bind(previous);
+            error_context_dispose(&diagnostics);
+            util_free(source);
+            return;
+        }
+        incremental_edit(target->inc, prefix, old_size - prefix - suffix,
+                         source + prefix, source_size - prefix - suffix);
+        if (incremental_get_stats(target->inc)->full_builds == builds) {
+            mode = "incremental";
+        }
+    }
+
+    if (target->inc != NULL_PTR && !incremental_has_errors(target->inc)) {
+        u32 size = 0;
+        const u8* code = incremental_get_code(target->inc, &size);
+        status = write_output_file(target->output_file, code, size);
+        if (status == 0) {
+            printf("[watch] %s -> %s (%u bytes, %s, %.2f ms)\n", target->input_file,
+                   target->output_file, size, mode, (double)(util_time_ns() - start) / 1e6);
+        }
+    }
+
+    /* 诊断附带源代码行：源文本与行索引来自常驻状态 */
+    if (target->inc != NULL_PTR) {
+        u32 source_len = 0;
+        u32 line_count = 0;
+        const char* text = incremental_get_source(target->inc, &source_len);
+        const u32* starts = incremental_get_line_starts(target->inc, &line_count);
+        error_set_source(text, source_len, starts, line_count);
+    }
+    if (status != 0) {
+        printf("[watch] %s: %u error(s)\n", target->input_file, diagnostics.count);
+    }
+    fflush(stdout);
+    error_flush();
+
+    error_bind(previous);
+    error_context_dispose(&diagnostics);
+    util_free(source);
+}
+
+static int run_watch(const CommandLine* cmdline) {
+    WatchSet* set = watch_create();
+    WatchTarget* targets;
+    u32* changed;
+    u32 count = cmdline->input_count;
+    int result = 0;
+
+    if (set == NULL_PTR) {
+        printf("Error: File watching is not available on this system\n");
+        return 1;
+    }
+
+    targets = (WatchTarget*)util_malloc(sizeof(WatchTarget) * count);
+    changed = (u32*)util_malloc(sizeof(u32) * count);
+    if (targets == NULL_PTR || changed == NULL_PTR) {
+        util_free(targets);
+        util_free(changed);
+        watch_destroy(set);
+        return 1;
+    }
+
+    for (u32 i = 0; i < count; i++) {
+        WatchTarget* target = &targets[i];
+        target->input_file = cmdline->inputs[i];
+        target->output_file = (cmdline->output_file != NULL_PTR) ?
+            util_strdup(cmdline->output_file) :
+            generate_output_filename(cmdline->inputs[i], OUTPUT_EXT);
+        target->inc = NULL_PTR;
+    }
+    for (u32 i = 0; i < count && result == 0; i++) {
+        if (targets[i].output_file == NULL_PTR || watch_add(set, targets[i].input_file) != (int)i) {
+            printf("Error: Cannot watch '%s'\n", targets[i].input_file);
+            result = 1;
+        }
+    }
+
+    if (result == 0) {
+        for (u32 i = 0; i < count; i++) {
+            watch_rebuild(cmdline, &targets[i]);
+        }
+        printf("Watching %u file(s) for changes (Ctrl+C to stop)...\n", count);
+        fflush(stdout);
+
+        /* 常驻循环：只重新处理被保存的文件，其余文件的状态保持不变 */
+        for (;;) {
+            int n = watch_wait(set, -1, changed, count);
+            if (n < 0) {
+                printf("Error: Waiting for file changes failed\n");
+                result = 1;
+                break;
+            }
+            for (int k = 0; k < n; k++) {
+                watch_rebuild(cmdline, &targets[changed[k]]);
+            }
+        }
+    }
+
+    for (u32 i = 0; i < count; i++) {
+        incremental_destroy(targets[i].inc);
+        util_free(targets[i].output_file);
+    }
+    util_free(targets);
+    util_free(changed);
+    watch_destroy(set);
+    return result;
 }
 
+static int run_server(const CommandLine* cmdline) {
+    AsmOptions options;
+    u32 workers = (cmdline->threads == 0) ? util_cpu_count() : cmdline->threads;
+
+    subas_options_init(&options);
+    options.pipeline = cmdline->pipeline;
 
+    printf("Serving on %s (%u worker(s)); stop with --connect %s --shutdown\n",
+           cmdline->server_path, workers, cmdline->server_path);
+    fflush(stdout);
+
+    if (server_run(cmdline->server_path, workers, &options) != 0) {
+        return 1;
+    }
+    printf("Server stopped\n");
+    return 0;
+}
+
+static int run_shutdown(const CommandLine* cmdline) {
+    if (server_shutdown(cmdline->connect_path) != 0) {
+        printf("Error: Cannot reach server at %s\n", cmdline->connect_path);
+        return 1;
+    }
+    printf("Server at %s stopped\n", cmdline->connect_path);
+    return 0;
+}
+
+static void print_address_line(const LineTable* table, const char* text) {
+    const char* p = text;
+    u32 address = 0;
+    u32 line = 0;
+    int valid = 1;
+
+    /* 接受 1A2B、0x1A2B 与 1A2BH 三种写法 */
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        p += 2;
+    }
+    valid = (*p != '\0');
+    for (; valid && *p != '\0'; p++) {
+        char c = *p;
+        u32 digit;
+        if (c >= '0' && c <= '9') {
+            digit = (u32)(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            digit = (u32)(c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            digit = (u32)(c - 'A' + 10);
+        } else if ((c == 'h' || c == 'H') && p[1] == '\0' && p != text) {
+            break;
+        } else {
+            valid = 0;
+            break;
+        }
+        valid = (address <= 0x0FFFFFFFu);
+        address = (address << 4) | digit;
+    }
+
+    if (valid && linetab_lookup(table, address, &line) == 0) {
+        printf("%.*s:%u\n", (int)table->header->name_size, table->name, line);
+    } else {
+        printf("??:0\n");
+    }
+}
+
+static int run_addr2line(const CommandLine* cmdline) {
+    LineTable table;
+    char word[64];
+
+    if (linetab_map(cmdline->addr2line_path, &table) != 0) {
+        printf("Error: Cannot read line table '%s'\n", cmdline->addr2line_path);
+        return 1;
+    }
+
+    /* 没有地址参数（或为 "-"）时逐个读取标准输入中以空白分隔的地址 */
+    if (cmdline->input_count == 0 ||
+        (cmdline->input_count == 1 && util_strcmp(cmdline->inputs[0], STDIN_NAME) == 0)) {
+        while (scanf("%63s", word) == 1) {
+            print_address_line(&table, word);
+        }
+    } else {
+        for (u32 i = 0; i < cmdline->input_count; i++) {
+            print_address_line(&table, cmdline->inputs[i]);
+        }
+    }
+
+    linetab_unmap(&table);
+    return 0;
+}
+
+/* ========================================================================= */
+/* 主程序入口 */
+/* ========================================================================= */
+
+int main(int argc, char* argv[]) {
+    CommandLine cmdline;
+    int result;
+    int quiet = 0;
+
+    /* 语言服务器模式下标准输出是协议通道、地址查询的输出供脚本解析，不打印标题 */
+    for (int i = 1; i < argc; i++) {
+        if (util_strcmp(argv[i], "--lsp") == 0 || util_strcmp(argv[i], "--addr2line") == 0) {
+            quiet = 1;
+        }
+    }
+    if (!quiet) {
+        printf("========================================\n");
+        printf("  SUBAS v%s - Assembler\n", SUBAS_VERSION);
+        printf("========================================\n\n");
+    }
+
+    /* 解析命令行参数 */
+    if (parse_command_line(argc, argv, &cmdline) != 0) {
+        print_usage(argv[0]);
+        free_command_line(&cmdline);
+        return 1;
+    }
+
+    if (cmdline.help) {
+        print_usage(argv[0]);
+        free_command_line(&cmdline);
+        return 0;
+    }
+
+    if (cmdline.addr2line_path != NULL_PTR) {
+        result = run_addr2line(&cmdline);
+        free_command_line(&cmdline);
+        return result;
+    }
+    if (cmdline.lsp) {
+        result = lsp_run(stdin, stdout);
+        free_command_line(&cmdline);
+        return result;
+    }
+    if (cmdline.server_path != NULL_PTR) {
+        result = run_server(&cmdline);
+        free_command_line(&cmdline);
+        return result;
+    }
+    if (cmdline.shutdown) {
+        result = run_shutdown(&cmdline);
+        free_command_line(&cmdline);
+        return result;
+    }
+
+    if (cmdline.input_file == NULL_PTR) {
+        printf("Error: No input file specified\n\n");
+        print_usage(argv[0]);
+        free_command_line(&cmdline);
+        return 1;
+    }
+
+    /* 初始化错误系统 */
+    error_init();
+    error_set_limit(cmdline.max_errors);
+
+    /* 统计输出包含分配记账 */
+    if (cmdline.stats_mode != STATS_MODE_NONE) {
+        util_mem_accounting(1);
+    }
+
+    if (cmdline.watch) {
+        result = run_watch(&cmdline);
+    } else if (cmdline.batch) {
+        result = run_batch(&cmdline);
+    } else {
+        result = run_single(&cmdline);
+    }
+    error_flush();
+
+    free_command_line(&cmdline);
+    return result;
+}
@@ -0,0 +1,278 @@
+﻿/*
+ * ============================================================================
+ * 文件名: mapfile.c
+ * 描述  : 映像文件实现
+ *
+ * 输出格式：
+ *   SUBAS map: prog.asm
+ *
+ *   Segments:
+ *
+ *   Name                             Start  Size  Symbols
+ *   CODE                             0000   0021        3
+ *   DATA                             0021   0003        1
+ *   Total                                   0024        4
+ *
+ *   Image size: 36 bytes
+ *
+ *   Symbols by address:
+ *
+ *   Addr  Segment          Type       Size  Line  Name
+ *   0000  CODE             procedure  0021     6  main
+ *   0009  CODE             label      0000    11  test_loop
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include "../include/mapfile.h"
+
+#define MAPFILE_NAME_WIDTH      32
+#define MAPFILE_SEGMENT_WIDTH   16
+
+static const char* const type_names[] = { "label", "variable", "procedure", "external" };
+
+/* ========================================================================= */
+/* 内部辅助函数 */
+/* ========================================================================= */
+
+/*
+ * 查找或追加一个段，返回其下标；内存不足返回 -1
+ */
+static s32 find_segment(MapFile* map, const char* name, u32 address) {
+    for (u32 i = 0; i < map->segment_count; i++) {
+        if (util_strcmp(map->segments[i].name, name) == 0) {
+            return (s32)i;
+        }
+    }
+
+    if (map->segment_count == map->segment_capacity) {
+        u32 capacity = map->segment_capacity * 2;
+        MapSegment* grown = (MapSegment*)util_malloc(capacity * sizeof(MapSegment));
+        if (grown == NULL_PTR) {
+            return -1;
+        }
+        for (u32 i = 0; i < map->segment_count; i++) {
+            grown[i] = map->segments[i];
+        }
+        util_free(map->segments);
+        map->segments = grown;
+        map->segment_capacity = capacity;
+    }
+
+    MapSegment* segment = &map->segments[map->segment_count];
+    segment->name = name;
+    segment->start = address;
+    segment->size = 0;
+    segment->symbol_count = 0;
+    return (s32)map->segment_count++;
+}
+
+/*
+ * SEGMENT / ENDS 行的段名：两种写法（"CODE SEGMENT"、"SEGMENT CODE"）都解析为首个操作数
+ */
+static const char* segment_name(const InstructionEntry* entry) {
+    if (entry->operand_count > 0 && entry->operands[0].type == OPERAND_LABEL) {
+        return (const char*)entry->operands[0].name;
+    }
+    return MAPFILE_NO_SEGMENT;
+}
+
+/*
+ * 稳定的自底向上归并排序：按偏移升序，相同偏移保持源代码顺序
+ */
+static void sort_by_address(MapSymbol* items, MapSymbol* scratch, u32 count) {
+    MapSymbol* src = items;
+    MapSymbol* dst = scratch;
+
+    for (u32 width = 1; width < count; width *= 2) {
+        for (u32 left = 0; left < count; left += 2 * width) {
+            u32 mid = (left + width < count) ? left + width : count;
+            u32 right = (mid + width < count) ? mid + width : count;
+            u32 i = left;
+            u32 j = mid;
+            u32 k = left;
+            while (i < mid && j < right) {
+                if (src[j].address < src[i].address) {
+                    dst[k++] = src[j++];
+                } else {
+                    dst[k++] = src[i++];
+                }
+            }
+            while (i < mid) dst[k++] = src[i++];
+            while (j < right) dst[k++] = src[j++];
+        }
+        MapSymbol* swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != items) {
+        for (u32 i = 0; i < count; i++) {
+            items[i] = src[i];
+        }
+    }
+}
+
+/*
+ * 按宽度左对齐写出文本，至少留一个空格
+ */
+static void put_padded(FILE* fp, const char* text, u32 width) {
+    u32 len = util_strlen(text);
+    fputs(text, fp);
+    do {
+        fputc(' ', fp);
+        len++;
+    } while (len < width);
+}
+
+/* ========================================================================= */
+/* API 函数实现 */
+/* ========================================================================= */
+
+int mapfile_build(const PassOne* pass_one, const u32* offsets, MapFile* out) {
+    u32 procs[MAPFILE_MAX_PROC_DEPTH];
+    u32 proc_depth = 0;
+    u32 capacity = pass_one->symtab->total_symbols;
+    u32 current = 0;
+
+    util_memset(out, 0, sizeof(MapFile));
+    out->segment_capacity = 8;
+    out->segments = (MapSegment*)util_malloc(out->segment_capacity * sizeof(MapSegment));
+    out->symbols = (MapSymbol*)util_malloc((capacity + 1) * sizeof(MapSymbol));
+    if (out->segments == NULL_PTR || out->symbols == NULL_PTR) {
+        mapfile_free(out);
+        return -1;
+    }
+    find_segment(out, MAPFILE_NO_SEGMENT, 0);
+
+    /* 一次遍历：段归属、段内字节数、符号与过程大小 */
+    for (u32 i = 0; i < pass_one->instruction_count; i++) {
+        const InstructionEntry* entry = &pass_one->instructions[i];
+        if (entry->has_error) {
+            continue;
+        }
+
+        if (util_strcmp((const char*)entry->mnemonic, "SEGMENT") == 0) {
+            s32 index = find_segment(out, segment_name(entry), offsets[i]);
+            if (index < 0) {
+                mapfile_free(out);
+                return -1;
+            }
+            current = (u32)index;
+        } else if (util_strcmp((const char*)entry->mnemonic, "ENDS") == 0) {
+            current = 0;
+        } else if (util_strcmp((const char*)entry->mnemonic, "ENDP") == 0 && proc_depth > 0) {
+            /* 与最近的同名 PROC 配对；未写名字时与栈顶配对 */
+            u32 depth = proc_depth;
+            if (entry->operand_count > 0) {
+                while (depth > 0 &&
+                       util_strcmp(out->symbols[procs[depth - 1]].info->name,
+                                   (const char*)entry->operands[0].name) != 0) {
+                    depth--;
+                }
+            }
+            if (depth > 0) {
+                MapSymbol* proc = &out->symbols[procs[depth - 1]];
+                proc->size = offsets[i] - proc->address;
+                proc_depth = depth - 1;
+            }
+        }
+        out->segments[current].size += offsets[i + 1] - offsets[i];
+
+        if (entry->has_label && out->symbol_count < capacity) {
+            const SymbolInfo* info = symtab_lookup(pass_one->symtab, (const char*)entry->label);
+            if (info == NULL_PTR || info->line_defined != entry->line) {
+                continue;
+            }
+            MapSymbol* symbol = &out->symbols[out->symbol_count];
+            symbol->info = info;
+            symbol->address = offsets[i];
+            symbol->segment = current;
+            symbol->size = 0;
+            out->segments[current].symbol_count++;
+            if (info->type == SYM_PROCEDURE && proc_depth < MAPFILE_MAX_PROC_DEPTH) {
+                procs[proc_depth++] = out->symbol_count;
+            }
+            out->symbol_count++;
+        }
+    }
+
+    /* 一次排序：偏移随源代码顺序递增，排序保证输出不依赖这一点 */
+    MapSymbol* scratch = (MapSymbol*)util_malloc((out->symbol_count + 1) * sizeof(MapSymbol));
+    if (scratch == NULL_PTR) {
+        mapfile_free(out);
+        return -1;
+    }
+    sort_by_address(out->symbols, scratch, out->symbol_count);
+    util_free(scratch);
+    return 0;
+}
+
+void mapfile_free(MapFile* map) {
+    if (map == NULL_PTR) {
+        return;
+    }
+    util_free(map->segments);
+    util_free(map->symbols);
+    util_memset(map, 0, sizeof(MapFile));
+}
+
+int mapfile_write(const PassOne* pass_one, const u32* offsets, const char* title, u32 image_size,
+                  const char* path) {
+    MapFile map;
+    u32 total_size = 0;
+    u32 total_symbols = 0;
+
+    if (mapfile_build(pass_one, offsets, &map) != 0) {
+        return -1;
+    }
+
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL_PTR) {
+        mapfile_free(&map);
+        return -1;
+    }
+
+    fprintf(fp, "SUBAS map: %s\n\n", (title != NULL_PTR) ? title : "");
+
+    fputs("Segments:\n\n", fp);
+    put_padded(fp, "Name", MAPFILE_NAME_WIDTH + 1);
+    fputs("Start  Size  Symbols\n", fp);
+    for (u32 i = 0; i < map.segment_count; i++) {
+        const MapSegment* segment = &map.segments[i];
+        /* 段外没有内容时省略 "(none)" */
+        if (i == 0 && segment->size == 0 && segment->symbol_count == 0) {
+            continue;
+        }
+        put_padded(fp, segment->name, MAPFILE_NAME_WIDTH + 1);
+        fprintf(fp, "%04X   %04X  %7u\n", (unsigned int)segment->start,
+                (unsigned int)segment->size, (unsigned int)segment->symbol_count);
+        total_size += segment->size;
+        total_symbols += segment->symbol_count;
+    }
+    put_padded(fp, "Total", MAPFILE_NAME_WIDTH + 8);
+    fprintf(fp, "%04X  %7u\n\n", (unsigned int)total_size, (unsigned int)total_symbols);
+    fprintf(fp, "Image size: %u bytes\n\n", (unsigned int)image_size);
+
+    fputs("Symbols by address:\n\n", fp);
+    fputs("Addr  ", fp);
+    put_padded(fp, "Segment", MAPFILE_SEGMENT_WIDTH + 1);
+    fputs("Type       Size  Line  Name\n", fp);
+    for (u32 i = 0; i < map.symbol_count; i++) {
+        const MapSymbol* symbol = &map.symbols[i];
+        const char* type = ((u32)symbol->info->type < 4) ? type_names[symbol->info->type] : "?";
+        fprintf(fp, "%04X  ", (unsigned int)symbol->address);
+        put_padded(fp, map.segments[symbol->segment].name, MAPFILE_SEGMENT_WIDTH + 1);
+        put_padded(fp, type, 11);
+        fprintf(fp, "%04X  %4u  %s\n", (unsigned int)symbol->size,
+                (unsigned int)symbol->info->line_defined, symbol->info->name);
+    }
+
+    int failed = ferror(fp);
+    if (fclose(fp) != 0) {
+        failed = 1;
+    }
+    mapfile_free(&map);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,500 @@
+﻿/*
+ * ============================================================================
+ * 文件名: objfile.c
+ * 描述  : OBJ 文件实现
+ *
+ * 关键算法：
+ *  1. 记录写入可增长的缓冲区：先写类型与占位长度，内容写完后回填长度与校验和
+ *     （整条记录各字节之和为 0 mod 256）
+ *  2. 外部符号经名字索引按字节序遍历一次，同时建立 名字 → EXTDEF 索引 的哈希表
+ *  3. 映像分块时块尾不切开重定位字；重定位按代码顺序，与分块同步前进
+ *  4. EXTDEF / PUBDEF / FIXUPP 内容达到上限时另起一条同类型记录
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include "../include/objfile.h"
+
+#define OBJFILE_INITIAL_CAPACITY    1024
+#define OBJFILE_NO_MODULE_NAME      "noname"
+
+/* FIXUPP 的 locat 字节：修正标志与段相对标志（M=0 为自相对） */
+#define OMF_LOCAT_FIXUP             0x80
+#define OMF_LOCAT_SEGMENT_RELATIVE  0x40
+
+/* FIXUPP 的定位类型（locat 字节第 2-5 位） */
+#define OMF_LOC_OFFSET              1       /* 16 位偏移 */
+#define OMF_LOC_BASE                2       /* 16 位段基址 */
+
+/* 修正数据字节：帧取目标所在帧（F5），无目标位移（P=1），目标为段（T0）或外部符号（T2） */
+#define OMF_FIXDAT_SEGMENT          0x54
+#define OMF_FIXDAT_EXTERNAL         0x56
+
+/*
+ * 可增长的输出缓冲区；record 为当前记录的起始偏移
+ */
+typedef struct {
+    u8* data;
+    u32 size;
+    u32 capacity;
+    u32 record;
+    int failed;
+} ObjBuffer;
+
+/*
+ * EXTDEF 遍历状态
+ */
+typedef struct {
+    ObjBuffer* out;
+    UtilHashTable* index;       /* 名字 → numbers 中的 EXTDEF 索引 */
+    u32* numbers;               /* 第 k 个外部符号的索引 k + 1 */
+    u32 count;
+} ExternVisit;
+
+/* ========================================================================= */
+/* 内部辅助函数 */
+/* ========================================================================= */
+
+static int reserve(ObjBuffer* out, u32 extra) {
+    if (out->failed) {
+        return -1;
+    }
+    if (out->size + extra <= out->capacity) {
+        return 0;
+    }
+
+    u32 capacity = (out->capacity == 0) ? OBJFILE_INITIAL_CAPACITY : out->capacity;
+    while (capacity < out->size + extra) {
+        capacity *= 2;
+    }
+    u8* grown = (u8*)util_malloc(capacity);
+    if (grown == NULL_PTR) {
+        out->failed = 1;
+        return -1;
+    }
+    for (u32 i = 0; i < out->size; i++) {
+        grown[i] = out->data[i];
+    }
+    util_free(out->data);
+    out->data = grown;
+    out->capacity = capacity;
+    return 0;
+}
+
+static void put_u8(ObjBuffer* out, u32 value) {
+    if (reserve(out, 1) == 0) {
+        out->data[out->size++] = (u8)(value & 0xFF);
+    }
+}
+
+static void put_u16(ObjBuffer* out, u32 value) {
+    put_u8(out, value);
+    put_u8(out, value >> 8);
+}
+
+/* 索引字段：小于 0x80 占一字节，否则两字节且首字节最高位置位 */
+static void put_index(ObjBuffer* out, u32 index) {
+    if (index < 0x80) {
+        put_u8(out, index);
+    } else {
+        put_u8(out, 0x80 | (index >> 8));
+        put_u8(out, index);
+    }
+}
+
+/* 名字字段：长度字节 + 字符 */
+static void put_name(ObjBuffer* out, const char* name, u32 length) {
+    put_u8(out, length);
+    for (u32 i = 0; i < length; i++) {
+        put_u8(out, (u8)name[i]);
+    }
+}
+
+static void begin_record(ObjBuffer* out, u32 type) {
+    out->record = out->size;
+    put_u8(out, type);
+    put_u16(out, 0);
+}
+
+/* 回填记录长度（内容 + 校验和字节）并追加校验和 */
+static void end_record(ObjBuffer* out) {
+    if (reserve(out, 1) != 0) {
+        return;
+    }
+    u32 length = out->size - out->record - 3 + 1;
+    out->data[out->record + 1] = (u8)(length & 0xFF);
+    out->data[out->record + 2] = (u8)((length >> 8) & 0xFF);
+
+    u8 sum = 0;
+    for (u32 i = out->record; i < out->size; i++) {
+        sum = (u8)(sum + out->data[i]);
+    }
+    out->data[out->size++] = (u8)(0 - sum);
+}
+
+/* 当前记录的内容字节数 */
+static u32 record_content(const ObjBuffer* out) {
+    return out->size - out->record - 3;
+}
+
+/* THEADR 的模块名：源文件名去掉目录与扩展名 */
+static void put_module_name(ObjBuffer* out, const char* source) {
+    const char* name = source;
+    u32 length = 0;
+
+    if (source != NULL_PTR) {
+        for (const char* p = source; *p != '\0'; p++) {
+            if (*p == '/' || *p == '\\') {
+                name = p + 1;
+            }
+        }
+        while (name[length] != '\0' && name[length] != '.') {
+            length++;
+        }
+    }
+    if (length == 0 || util_strcmp(name, "-") == 0) {
+        name = OBJFILE_NO_MODULE_NAME;
+        length = util_strlen(name);
+    }
+    put_name(out, name, (length > 255) ? 255 : length);
+}
+
+static const char* segment_name(const PassOne* pass_one) {
+    for (u32 i = 0; i < pass_one->instruction_count; i++) {
+        const InstructionEntry* entry = &pass_one->instructions[i];
+        if (!entry->has_error && util_strcmp((const char*)entry->mnemonic, "SEGMENT") == 0 &&
+            entry->operand_count > 0 && entry->operands[0].type == OPERAND_LABEL) {
+            return (const char*)entry->operands[0].name;
+        }
+    }
+    return OBJFILE_DEFAULT_SEGMENT;
+}
+
+/*
+ * 写出一个外部符号；EXTDEF 内容达到上限时另起一条记录
+ */
+static int visit_extern(void* user, const SymbolInfo* info) {
+    ExternVisit* visit = (ExternVisit*)user;
+    u32 length = util_strlen(info->name);
+
+    if (info->type != SYM_EXTERNAL) {
+        return 0;
+    }
+    if (visit->count == 0 || record_content(visit->out) + length + 2 > OBJFILE_MAX_RECORD) {
+        if (visit->count > 0) {
+            end_record(visit->out);
+        }
+        begin_record(visit->out, OMF_EXTDEF);
+    }
+    put_name(visit->out, info->name, length);
+    put_index(visit->out, 0);   /* 类型索引 */
+
+    visit->numbers[visit->count] = visit->count + 1;
+    util_ht_insert(visit->index, info->name, &visit->numbers[visit->count]);
+    visit->count++;
+    return visit->out->failed;
+}
+
+/*
+ * 标签名 → 所在指令机器码实际起始偏移的索引（值指向 offsets 中的项）；
+ * 重名标签只登记拥有符号的首个定义者
+ */
+static UtilHashTable* index_labels(const ObjModule* module) {
+    const PassOne* pass_one = module->pass_one;
+    UtilHashTable* labels = util_ht_create(64);
+
+    for (u32 i = 0; labels != NULL_PTR && i < pass_one->instruction_count; i++) {
+        const InstructionEntry* entry = &pass_one->instructions[i];
+        if (!entry->has_label) {
+            continue;
+        }
+        const SymbolInfo* info = symtab_lookup(pass_one->symtab, (const char*)entry->label);
+        if (info != NULL_PTR && info->type != SYM_EXTERNAL && info->line_defined == entry->line) {
+            util_ht_insert(labels, (const char*)entry->label, (void*)&module->offsets[i]);
+        }
+    }
+    return labels;
+}
+
+/* 已定义标签的实际偏移 */
+static u32 label_offset(UtilHashTable* labels, const char* name) {
+    const u32* offset = (const u32*)util_ht_lookup(labels, name);
+    return (offset != NULL_PTR) ? *offset : 0;
+}
+
+/*
+ * PUBDEF：PUBLIC 列出的名字按源代码顺序写出，重复的只写一次
+ */
+static int put_publics(ObjBuffer* out, const PassOne* pass_one, UtilHashTable* labels) {
+    UtilHashTable* seen = NULL_PTR;
+    u32 count = 0;
+    int result = 0;
+
+    for (u32 i = 0; i < pass_one->instruction_count; i++) {
+        const InstructionEntry* entry = &pass_one->instructions[i];
+        if (entry->has_error || util_strcmp((const char*)entry->mnemonic, "PUBLIC") != 0) {
+            continue;
+        }
+
+        for (u32 k = 0; k < entry->operand_count; k++) {
+            const char* name = (const char*)entry->operands[k].name;
+            const SymbolInfo* info = (entry->operands[k].type == OPERAND_LABEL)
+                ? symtab_lookup(pass_one->symtab, name) : NULL_PTR;
+
+            if (info == NULL_PTR || !info->is_defined || info->type == SYM_EXTERNAL) {
+                error_report(entry->line, ERR_PARSE_UNDEFINED_LBL, name);
+                result = -1;
+                continue;
+            }
+            if (seen == NULL_PTR) {
+                seen = util_ht_create(64);
+            }
+            if (seen == NULL_PTR) {
+                out->failed = 1;
+                break;
+            }
+            if (util_ht_lookup(seen, name) != NULL_PTR) {
+                continue;
+            }
+            util_ht_insert(seen, name, (void*)info);
+
+            u32 length = util_strlen(name);
+            if (count == 0 || record_content(out) + length + 4 > OBJFILE_MAX_RECORD) {
+                if (count > 0) {
+                    end_record(out);
+                }
+                begin_record(out, OMF_PUBDEF);
+                put_index(out, 0);      /* 组索引 */
+                put_index(out, 1);      /* 段索引 */
+            }
+            put_name(out, name, length);
+            put_u16(out, label_offset(labels, name));
+            put_index(out, 0);          /* 类型索引 */
+            count++;
+        }
+    }
+    if (count > 0) {
+        end_record(out);
+    }
+    util_ht_destroy(seen);
+    return result;
+}
+
+/*
+ * 重定位字是否为转移或调用指令的位移字段（由链接器按自相对方式修正）
+ */
+static int is_displacement(const ObjModule* module, const Relocation* rel) {
+    const InstructionEntry* entry = &module->pass_one->instructions[rel->instruction_index];
+    const InstructionInfo* info = tables_lookup_instruction((const char*)entry->mnemonic);
+
+    if (info == NULL_PTR || rel->kind == RELOC_SEGMENT) {
+        return 0;
+    }
+    return (info->type >= INSTR_JMP && info->type <= INSTR_LOOP) || info->type == INSTR_CALL;
+}
+
+/*
+ * 一个 LEDATA 块内的重定位 [first, last) 写成 FIXUPP
+ */
+static void put_fixups(ObjBuffer* out, const ObjModule* module, UtilHashTable* externs,
+                       u32 block_start, u32 first, u32 last) {
+    for (u32 r = first; r < last; r++) {
+        const Relocation* rel = &module->relocations[r];
+        u32 offset = rel->offset - block_start;
+        u32 location = (rel->kind == RELOC_SEGMENT) ? OMF_LOC_BASE : OMF_LOC_OFFSET;
+
+        if (r == first || record_content(out) + 5 > OBJFILE_MAX_RECORD) {
+            if (r != first) {
+                end_record(out);
+            }
+            begin_record(out, OMF_FIXUPP);
+        }
+        /* locat：修正标志 | 段相对（M）| 定位类型 | 块内偏移高 2 位；
+         * 转移与调用的位移字段为自相对：链接器写入 目标 - (字段位置 + 2) 加上字段原值，
+         * 段内标签的字段原值是其实际段内偏移（第二遍已按机器码位置解决），
+         * 结果即相对下一条指令的位移 */
+        u32 mode = is_displacement(module, rel) ? 0 : OMF_LOCAT_SEGMENT_RELATIVE;
+        put_u8(out, OMF_LOCAT_FIXUP | mode | (location << 2) | (offset >> 8));
+        put_u8(out, offset);
+        if (rel->kind == RELOC_EXTERNAL) {
+            put_u8(out, OMF_FIXDAT_EXTERNAL);
+            const u32* index = (const u32*)util_ht_lookup(externs, (const char*)rel->symbol_name);
+            put_index(out, (index != NULL_PTR) ? *index : 0);
+        } else {
+            put_u8(out, OMF_FIXDAT_SEGMENT);
+            put_index(out, 1);
+        }
+    }
+    end_record(out);
+}
+
+/*
+ * LEDATA 与 FIXUPP：分块写出映像，块尾不切开重定位字
+ */
+static void put_data(ObjBuffer* out, const ObjModule* module, UtilHashTable* externs) {
+    u32 start = 0;
+    u32 r = 0;
+
+    while (start < module->size) {
+        u32 end = (module->size - start > OBJFILE_MAX_DATA) ? start + OBJFILE_MAX_DATA : module->size;
+        u32 first = r;
+
+        while (r < module->relocation_count && module->relocations[r].offset < end) {
+            if (module->relocations[r].offset + 2 > end) {
+                end = module->relocations[r].offset;
+                break;
+            }
+            r++;
+        }
+
+        begin_record(out, OMF_LEDATA);
+        put_index(out, 1);
+        put_u16(out, start);
+        for (u32 i = start; i < end; i++) {
+            put_u8(out, module->code[i]);
+        }
+        end_record(out);
+
+        if (r > first) {
+            put_fixups(out, module, externs, start, first, r);
+        }
+        start = end;
+    }
+}
+
+/*
+ * MODEND：END 指定了已定义的入口标签时标记为主模块并带入口地址
+ */
+static void put_modend(ObjBuffer* out, const PassOne* pass_one, UtilHashTable* labels) {
+    const SymbolInfo* entry_point = NULL_PTR;
+
+    for (u32 i = pass_one->instruction_count; i > 0; i--) {
+        const InstructionEntry* entry = &pass_one->instructions[i - 1];
+        if (!entry->has_error && util_strcmp((const char*)entry->mnemonic, "END") == 0) {
+            if (entry->operand_count > 0 && entry->operands[0].type == OPERAND_LABEL) {
+                entry_point = symtab_lookup(pass_one->symtab, (const char*)entry->operands[0].name);
+            }
+            break;
+        }
+    }
+    if (entry_point != NULL_PTR && (!entry_point->is_defined || entry_point->type == SYM_EXTERNAL)) {
+        entry_point = NULL_PTR;
+    }
+
+    begin_record(out, OMF_MODEND);
+    if (entry_point != NULL_PTR) {
+        put_u8(out, 0xC1);          /* 主模块 | 带入口 | 逻辑地址 */
+        put_u8(out, 0x00);          /* 帧 F0（段索引）、目标 T0（段索引）、带位移 */
+        put_index(out, 1);
+        put_index(out, 1);
+        put_u16(out, label_offset(labels, entry_point->name));
+    } else {
+        put_u8(out, 0x00);
+    }
+    end_record(out);
+}
+
+/* ========================================================================= */
+/* API 函数实现 */
+/* ========================================================================= */
+
+int objfile_build(const ObjModule* module, u8** out_data, u32* out_size) {
+    const PassOne* pass_one = module->pass_one;
+    ObjBuffer out;
+    ExternVisit visit;
+    UtilHashTable* labels;
+    int result = 0;
+
+    *out_data = NULL_PTR;
+    *out_size = 0;
+    if (module->size > 0x10000) {
+        return -1;
+    }
+    util_memset(&out, 0, sizeof(out));
+
+    begin_record(&out, OMF_THEADR);
+    put_module_name(&out, module->source);
+    end_record(&out);
+
+    /* 名字 1 为空名（无覆盖名），2 为段名，3 为类名 */
+    const char* segment = segment_name(pass_one);
+    begin_record(&out, OMF_LNAMES);
+    put_name(&out, "", 0);
+    put_name(&out, segment, util_strlen(segment));
+    put_name(&out, OBJFILE_CLASS_NAME, util_strlen(OBJFILE_CLASS_NAME));
+    end_record(&out);
+
+    /* ACBP：节对齐、公共合并、64KB 时置 B 位（长度写 0） */
+    begin_record(&out, OMF_SEGDEF);
+    put_u8(&out, (3 << 5) | (2 << 2) | ((module->size == 0x10000) ? 0x02 : 0x00));
+    put_u16(&out, module->size & 0xFFFF);
+    put_index(&out, 2);
+    put_index(&out, 3);
+    put_index(&out, 1);
+    end_record(&out);
+
+    visit.out = &out;
+    visit.index = util_ht_create(64);
+    visit.numbers = (u32*)util_malloc((symtab_get_symbol_count(pass_one->symtab) + 1) * sizeof(u32));
+    visit.count = 0;
+    labels = index_labels(module);
+    if (visit.index == NULL_PTR || visit.numbers == NULL_PTR || labels == NULL_PTR) {
+        error_report(0, ERR_SYS_OUT_OF_MEM, "无法组装目标模块");
+        util_ht_destroy(visit.index);
+        util_ht_destroy(labels);
+        util_free(visit.numbers);
+        util_free(out.data);
+        return -1;
+    }
+    (void)symtab_iterate_prefix(pass_one->symtab, "", visit_extern, &visit);
+    if (visit.count > 0) {
+        end_record(&out);
+    }
+
+    result = put_publics(&out, pass_one, labels);
+    put_data(&out, module, visit.index);
+    put_modend(&out, pass_one, labels);
+    util_ht_destroy(visit.index);
+    util_ht_destroy(labels);
+    util_free(visit.numbers);
+
+    if (out.failed) {
+        error_report(0, ERR_SYS_OUT_OF_MEM, "无法组装目标模块");
+    }
+    if (result != 0 || out.failed) {
+        util_free(out.data);
+        return -1;
+    }
+    *out_data = out.data;
+    *out_size = out.size;
+    return 0;
+}
+
+int objfile_write(const char* path, const ObjModule* module) {
+    u8* data;
+    u32 size;
+
+    if (objfile_build(module, &data, &size) != 0) {
+        return -1;
+    }
+
+    FILE* fp = fopen(path, "wb");
+    if (fp == NULL_PTR) {
+        util_free(data);
+        return -1;
+    }
+
+    int result = 0;
+    if (fwrite(data, 1, size, fp) != size) {
+        result = -1;
+    }
+    if (fclose(fp) != 0) {
+        result = -1;
+    }
+    if (result != 0) {
+        remove(path);
+    }
+    util_free(data);
+    return result;
+}
@@ -0,0 +1,367 @@
+﻿/*
+ * ============================================================================
+ * 文件名: pipeline.c
+ * 描述  : 流水线汇编模块实现
+ *
+ * 关键算法：
+ *  1. 调用线程执行词法分析，按行对齐切分 Token 批次并入队
+ *  2. 扫描线程逐批执行第一遍扫描，复制新产生的指令为指令批次并入队
+ *  3. 编码线程逐批生成机器码，标签引用记入重定位表
+ *  4. 三个阶段结束后，按 词法 → 扫描 → 编码 的顺序回放诊断，
+ *     无错误时用完整符号表解决所有重定位
+ *
+ * 每个队列以流水线结构体中内嵌的结束批次作为结束标记，
+ * 内存不足时也总能发出结束标记，下游线程不会永久等待。
+ *
+ * ============================================================================
+ */
+
+#include "../include/pipeline.h"
+
+/* ========================================================================= */
+/* 内部数据结构 */
+/* ========================================================================= */
+
+/*
+ * Token 批次：以换行（或 EOF）结尾的一组 Token
+ */
+typedef struct {
+    Token* tokens;
+    u32 count;
+    u32 capacity;
+} TokenBatch;
+
+/*
+ * 指令批次：第一遍扫描新产生指令的副本
+ */
+typedef struct {
+    InstructionEntry* entries;
+    u32 first_index;            /* 第一条指令在 PassOne 中的索引 */
+    u32 count;
+} IrBatch;
+
+/*
+ * 流水线共享状态
+ */
+typedef struct {
+    Lexer* lexer;
+    UtilSpscQueue* token_queue; /* 词法 → 扫描 */
+    UtilSpscQueue* ir_queue;    /* 扫描 → 编码 */
+    TokenBatch token_end;       /* Token 队列结束标记 */
+    IrBatch ir_end;             /* 指令队列结束标记 */
+    PassOne* pass_one;          /* 仅扫描线程写入 */
+    CodeGen* codegen;           /* 仅编码线程写入 */
+    u32 token_count;
+    ErrorBuffer lex_errors;
+    ErrorBuffer parse_errors;
+    ErrorBuffer encode_errors;
+} Pipeline;
+
+/* ========================================================================= */
+/* 内部辅助函数 */
+/* ========================================================================= */
+
+static TokenBatch* token_batch_create(void) {
+    TokenBatch* batch = (TokenBatch*)util_malloc(sizeof(TokenBatch));
+    if (batch == NULL_PTR) return NULL_PTR;
+
+    batch->capacity = PIPELINE_TOKEN_BATCH * 2;
+    batch->count = 0;
+    batch->tokens = (Token*)util_malloc(sizeof(Token) * batch->capacity);
+    if (batch->tokens == NULL_PTR) {
+        util_free(batch);
+        return NULL_PTR;
+    }
+    return batch;
+}
+
+/*
+ * 追加一个 Token；单行 Token 过多时按两倍扩容
+ */
+static int token_batch_append(TokenBatch* batch, Token tok) {
+    if (batch->count >= batch->capacity) {
+        Token* grown = (Token*)util_malloc(sizeof(Token) * batch->capacity * 2);
+        if (grown == NULL_PTR) return -1;
+        for (u32 i = 0; i < batch->count; i++) {
+            grown[i] = batch->tokens[i];
+        }
+        util_free(batch->tokens);
+        batch->tokens = grown;
+        batch->capacity *= 2;
+    }
+    batch->tokens[batch->count++] = tok;
+    return 0;
+}
+
+static void token_batch_destroy(TokenBatch* batch) {
+    for (u32 i = 0; i < batch->count; i++) {
+        token_dispose(&batch->tokens[i]);
+    }
+    util_free(batch->tokens);
+    util_free(batch);
+}
+
+/* ========================================================================= */
+/* 流水线阶段 */
+/* ========================================================================= */
+
+/*
+ * 词法阶段：在调用线程上执行
+ */
+static void lexer_stage(Pipeline* p) {
+    TokenBatch* batch;
+    UtilMemTag previous = util_mem_set_tag(UTIL_MEM_LEXER);
+
+    error_capture_begin(&p->lex_errors);
+    batch = token_batch_create();
+    if (batch == NULL_PTR) {
+        error_report(0, ERR_SYS_OUT_OF_MEM, "无法分配 Token 批次");
+    }
+    while (batch != NULL_PTR) {
+        Token tok = lexer_next_token(p->lexer);
+        int is_eof = (tok.type == TOK_EOF);
+        int is_newline = (tok.type == TOK_NEWLINE);
+
+        if (token_batch_append(batch, tok) != 0) {
+            token_dispose(&tok);
+            error_report(tok.line, ERR_SYS_OUT_OF_MEM, "无法扩展 Token 批次");
+            token_batch_destroy(batch);
+            break;
+        }
+        p->token_count++;
+
+        if (is_eof) {
+            util_spsc_push(p->token_queue, batch);
+            break;
+        }
+        if (is_newline && batch->count >= PIPELINE_TOKEN_BATCH) {
+            util_spsc_push(p->token_queue, batch);
+            batch = token_batch_create();
+            if (batch == NULL_PTR) {
+                error_report(tok.line, ERR_SYS_OUT_OF_MEM, "无法分配 Token 批次");
+            }
+        }
+    }
+    error_capture_end();
+    util_mem_set_tag(previous);
+
+    util_spsc_push(p->token_queue, &p->token_end);
+}
+
+/*
+ * 第一遍扫描阶段：逐批扫描并把新指令转交编码阶段
+ */
+static void parse_stage(void* arg) {
+    Pipeline* p = (Pipeline*)arg;
+
+    util_mem_set_tag(UTIL_MEM_IR);
+    error_capture_begin(&p->parse_errors);
+    for (;;) {
+        TokenBatch* batch = (TokenBatch*)util_spsc_pop(p->token_queue);
+        if (batch == &p->token_end) break;
+
+        u32 first = p->pass_one->instruction_count;
+        semantic_pass_one_feed(p->pass_one, batch->tokens, batch->count);
+        u32 produced = p->pass_one->instruction_count - first;
+
+        if (produced > 0) {
+            IrBatch* ir = (IrBatch*)util_malloc(sizeof(IrBatch));
+            InstructionEntry* entries = (InstructionEntry*)util_malloc(
+                sizeof(InstructionEntry) * produced);
+            if (ir != NULL_PTR && entries != NULL_PTR) {
+                for (u32 k = 0; k < produced; k++) {
+                    entries[k] = p->pass_one->instructions[first + k];
+                }
+                ir->entries = entries;
+                ir->first_index = first;
+                ir->count = produced;
+                util_spsc_push(p->ir_queue, ir);
+            } else {
+                p->pass_one->has_errors = 1;
+                util_free(ir);
+                util_free(entries);
+            }
+        }
+
+        token_batch_destroy(batch);
+    }
+    error_capture_end();
+
+    util_spsc_push(p->ir_queue, &p->ir_end);
+}
+
+/*
+ * 编码阶段：地址已确定，收到批次即生成机器码
+ */
+static void encode_stage(void* arg) {
+    Pipeline* p = (Pipeline*)arg;
+
+    util_mem_set_tag(UTIL_MEM_CODEGEN);
+    error_capture_begin(&p->encode_errors);
+    for (;;) {
+        IrBatch* ir = (IrBatch*)util_spsc_pop(p->ir_queue);
+        if (ir == &p->ir_end) break;
+
+        for (u32 k = 0; k < ir->count; k++) {
+            if (codegen_emit_instruction_at(p->codegen, &ir->entries[k],
+                                            ir->first_index + k) < 0) {
+                p->codegen->has_errors = 1;
+            }
+        }
+
+        util_free(ir->entries);
+        util_free(ir);
+    }
+    error_capture_end();
+}
+
+/*
+ * 串行退化路径：无法创建线程时使用
+ */
+static int assemble_serial(Pipeline* p, PipelineResult* out) {
+    TokenBatch* all = token_batch_create();
+    PassOne* pass_one;
+    CodeGen* codegen;
+    int has_eof = 0;
+
+    if (all == NULL_PTR) return -1;
+
+    while (!has_eof) {
+        Token tok = lexer_next_token(p->lexer);
+        has_eof = (tok.type == TOK_EOF);
+        if (token_batch_append(all, tok) != 0) {
+            token_dispose(&tok);
+            token_batch_destroy(all);
+            error_report(0, ERR_SYS_OUT_OF_MEM, "无法分配 Token 缓冲区");
+            return -1;
+        }
+    }
+    out->token_count = all->count;
+
+    /* 词法错误不中断：后续两遍继续报告其余各行的错误 */
+    pass_one = semantic_pass_one(all->tokens, all->count);
+    token_batch_destroy(all);
+    if (pass_one == NULL_PTR) return -1;
+
+    codegen = codegen_pass_two(pass_one);
+    if (codegen == NULL_PTR || error_has_failed()) {
+        codegen_destroy(codegen);
+        semantic_pass_one_destroy(pass_one);
+        return -1;
+    }
+
+    out->pass_one = pass_one;
+    out->codegen = codegen;
+    return 0;
+}
+
+/*
+ * 启动流水线并收集结果；资源由调用者统一释放
+ */
+static int run_pipeline(Pipeline* p, PipelineResult* out) {
+    UtilThread* encoder;
+    UtilThread* parser;
+
+    /* 先启动下游线程：下游创建失败时上游尚未开始，可安全退化 */
+    encoder = util_thread_create(encode_stage, p);
+    if (encoder == NULL_PTR) {
+        return assemble_serial(p, out);
+    }
+    parser = util_thread_create(parse_stage, p);
+    if (parser == NULL_PTR) {
+        util_spsc_push(p->ir_queue, &p->ir_end);
+        util_thread_join(encoder);
+        return assemble_serial(p, out);
+    }
+
+    lexer_stage(p);
+    util_thread_join(parser);
+    util_thread_join(encoder);
+    out->token_count = p->token_count;
+
+    /* 按串行执行的顺序回放各阶段诊断；任一阶段出错时各阶段仍已运行到底 */
+    error_buffer_replay(&p->lex_errors);
+    error_buffer_replay(&p->parse_errors);
+    error_buffer_replay(&p->encode_errors);
+
+    /* 与 codegen_pass_two 一致：编码出错后仍解决重定位以报告未定义符号 */
+    if (codegen_resolve_reference(p->codegen) < 0) {
+        p->codegen->has_errors = 1;
+    }
+    if (p->lex_errors.count > 0 || p->parse_errors.count > 0 || p->pass_one->has_errors ||
+        p->encode_errors.count > 0 || p->codegen->has_errors) {
+        return -1;
+    }
+
+    /* 所有权转交调用者 */
+    out->pass_one = p->pass_one;
+    out->codegen = p->codegen;
+    p->pass_one = NULL_PTR;
+    p->codegen = NULL_PTR;
+    return 0;
+}
+
+/* ========================================================================= */
+/* API 函数实现 */
+/* ========================================================================= */
+
+int pipeline_assemble(const char* source, u32 len, LineIndex* lines, PipelineResult* out) {
+    Lexer* lexer = lexer_create_from_buffer(source, len);
+
+    if (lexer == NULL_PTR) {
+        out->pass_one = NULL_PTR;
+        out->codegen = NULL_PTR;
+        out->token_count = 0;
+        return -1;
+    }
+    return pipeline_assemble_lexer(lexer, lines, out);
+}
+
+int pipeline_assemble_lexer(Lexer* lexer, LineIndex* lines, PipelineResult* out) {
+    Pipeline p;
+    int result = -1;
+
+    out->pass_one = NULL_PTR;
+    out->codegen = NULL_PTR;
+    out->token_count = 0;
+
+    p.lexer = lexer;
+    if (p.lexer == NULL_PTR) return -1;
+    lexer_set_line_index(p.lexer, lines);
+
+    p.token_queue = util_spsc_create(PIPELINE_QUEUE_DEPTH);
+    p.ir_queue = util_spsc_create(PIPELINE_QUEUE_DEPTH);
+    UtilMemTag previous = util_mem_set_tag(UTIL_MEM_IR);
+    p.pass_one = semantic_pass_one_begin();
+    util_mem_set_tag(UTIL_MEM_CODEGEN);
+    p.codegen = (p.pass_one != NULL_PTR) ? codegen_create(p.pass_one) : NULL_PTR;
+    util_mem_set_tag(previous);
+    p.token_count = 0;
+    error_buffer_init(&p.lex_errors);
+    error_buffer_init(&p.parse_errors);
+    error_buffer_init(&p.encode_errors);
+
+    if (p.token_queue != NULL_PTR && p.ir_queue != NULL_PTR &&
+        p.pass_one != NULL_PTR && p.codegen != NULL_PTR) {
+        result = run_pipeline(&p, out);
+    }
+
+    error_buffer_dispose(&p.lex_errors);
+    error_buffer_dispose(&p.parse_errors);
+    error_buffer_dispose(&p.encode_errors);
+    codegen_destroy(p.codegen);
+    semantic_pass_one_destroy(p.pass_one);
+    util_spsc_destroy(p.token_queue);
+    util_spsc_destroy(p.ir_queue);
+    lexer_destroy(p.lexer);
+    return result;
+}
+
+void pipeline_result_destroy(PipelineResult* result) {
+    if (result == NULL_PTR) return;
+
+    codegen_destroy(result->codegen);
+    semantic_pass_one_destroy(result->pass_one);
+    result->codegen = NULL_PTR;
+    result->pass_one = NULL_PTR;
+}
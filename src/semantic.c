@@ -45,31 +45,58 @@ static u32 estimate_instruction_length(const char* mnemonic, u32 operand_count)
     if (util_strcmp(mnemonic, "PROC") == 0) return 0;
     if (util_strcmp(mnemonic, "ENDP") == 0) return 0;
     if (util_strcmp(mnemonic, "END") == 0) return 0;
+    if (util_strcmp(mnemonic, "PUBLIC") == 0) return 0;
+    if (util_strcmp(mnemonic, "EXTRN") == 0) return 0;
     return 3;
 }
 
-/* ========================================================================= */
-/* API 函数实现 */
-/* ========================================================================= */
+/*
+ * 延迟诊断记录：并行工作线程不直接调用 error_report，
+ * 而是先记录下来，合并阶段按源代码顺序统一回放。
+ */
+typedef struct {
+    u32 seq;                    /* 出错时块内已解析的指令数（回放顺序依据） */
+    u32 line;                   /* 行号 */
+    u32 line_is_relative;       /* 行号是否为块内相对行号（需在合并时重定位） */
+    ErrorCode code;             /* 错误码 */
+    const char* detail;         /* 详细信息（指向 Token 词素或常量字符串） */
+} DeferredError;
+
+typedef struct {
+    DeferredError* items;
+    u32 count;
+    u32 capacity;
+} DeferredErrorList;
 
 /*
- * semantic_pass_one: 执行第一遍扫描
+ * 并行第一遍扫描的分块上下文
  */
-PassOne* semantic_pass_one(const Token* tokens, u32 token_count) {
+typedef struct {
+    const Token* tokens;        /* 完整 Token 数组 */
+    u32 begin;                  /* 块起始 Token 索引（含） */
+    u32 end;                    /* 块结束 Token 索引（不含），总在换行之后 */
+    PassOne* local;             /* 块内上下文：相对地址/行号 + 局部符号表 */
+    DeferredErrorList errors;   /* 块内延迟诊断 */
+} PassOneChunk;
+
+/*
+ * 创建一个空的第一遍扫描上下文
+ */
+static PassOne* pass_one_create(u32 symtab_capacity, u32 max_instructions) {
     PassOne* pass_one = (PassOne*)util_malloc(sizeof(PassOne));
     if (pass_one == NULL) {
         error_report(0, ERR_SYS_OUT_OF_MEM, "无法分配 PassOne 结构");
         return NULL;
     }
 
-    pass_one->symtab = symtab_create(256);
+    pass_one->symtab = symtab_create(symtab_capacity);
     if (pass_one->symtab == NULL) {
         util_free(pass_one);
         error_report(0, ERR_SYS_OUT_OF_MEM, "无法创建符号表");
         return NULL;
     }
 
-    pass_one->max_instructions = 512;
+    pass_one->max_instructions = max_instructions;
     pass_one->instructions = (InstructionEntry*)util_malloc(
         sizeof(InstructionEntry) * pass_one->max_instructions
     );
@@ -85,72 +112,461 @@ PassOne* semantic_pass_one(const Token* tokens, u32 token_count) {
     pass_one->current_line = 1;
     pass_one->has_errors = 0;
 
-    /* 遍历 Token 流，提取指令 */
-    u32 i = 0;
-    while (i < token_count) {
+    return pass_one;
+}
+
+/*
+ * 指令列表已满时按两倍扩容
+ */
+static int ensure_instruction_capacity(PassOne* pass_one) {
+    InstructionEntry* grown;
+    u32 new_max;
+
+    if (pass_one->instruction_count < pass_one->max_instructions) {
+        return 0;
+    }
+
+    /* util_malloc 以 u32 计字节：源文件不再限长，须防止乘积溢出后分配过小的缓冲区 */
+    if (pass_one->max_instructions > 0xFFFFFFFFu / 2 / sizeof(InstructionEntry)) {
+        return -1;
+    }
+    new_max = pass_one->max_instructions * 2;
+    grown = (InstructionEntry*)util_malloc(sizeof(InstructionEntry) * new_max);
+    if (grown == NULL) {
+        return -1;
+    }
+
+    for (u32 i = 0; i < pass_one->instruction_count; i++) {
+        grown[i] = pass_one->instructions[i];
+    }
+
+    util_free(pass_one->instructions);
+    pass_one->instructions = grown;
+    pass_one->max_instructions = new_max;
+    return 0;
+}
+
+/*
+ * 报告第一遍扫描错误：defer 为 NULL 时立即报告，否则记入延迟列表
+ */
+static void pass_one_error(
+    PassOne* pass_one,
+    DeferredErrorList* defer,
+    u32 line,
+    u32 line_is_relative,
+    ErrorCode code,
+    const char* detail
+) {
+    pass_one->has_errors = 1;
+
+    if (defer == NULL) {
+        error_report(line, code, detail);
+        return;
+    }
+
+    if (defer->count >= defer->capacity) {
+        u32 new_capacity = (defer->capacity == 0) ? 16 : defer->capacity * 2;
+        DeferredError* grown = (DeferredError*)util_malloc(sizeof(DeferredError) * new_capacity);
+        if (grown == NULL) {
+            return;
+        }
+        for (u32 i = 0; i < defer->count; i++) {
+            grown[i] = defer->items[i];
+        }
+        util_free(defer->items);
+        defer->items = grown;
+        defer->capacity = new_capacity;
+    }
+
+    DeferredError* item = &defer->items[defer->count++];
+    item->seq = pass_one->instruction_count;
+    item->line = line;
+    item->line_is_relative = line_is_relative;
+    item->code = code;
+    item->detail = detail;
+}
+
+/*
+ * 无法解析的行：报告一次错误（report 为 0 时该行已有词法错误，不再报告），
+ * 写入错误占位条目并返回行尾 Token 索引。
+ * 行首形如 "标签:" 时仍登记该标签，使其它行对它的引用不会连带报错。
+ */
+static u32 recover_line(
+    PassOne* pass_one,
+    const Token* tokens,
+    u32 index,
+    u32 end,
+    InstructionEntry* entry,
+    DeferredErrorList* defer,
+    int report
+) {
+    u32 bad = index;
+
+    util_memset(entry, 0, sizeof(*entry));
+    entry->address = pass_one->current_address;
+    entry->line = pass_one->current_line;
+    entry->has_error = 1;
+
+    if (tokens[index].type == TOK_IDENTIFIER && tokens[index + 1].type == TOK_COLON) {
+        entry->has_label = 1;
+        util_strcpy((char*)entry->label, (const char*)tokens[index].lexeme);
+        bad = index + 2;
+    }
+
+    /* 报告首个无法解析的 Token，以便调试 */
+    if (!report) {
+        pass_one->has_errors = 1;
+    } else if (tokens[bad].lexeme != NULL) {
+        pass_one_error(pass_one, defer, tokens[bad].line, 0,
+            ERR_PARSE_EXPECTED_OP, (const char*)tokens[bad].lexeme);
+    } else {
+        pass_one_error(pass_one, defer, pass_one->current_line, 1,
+            ERR_PARSE_EXPECTED_OP, "无法解析的指令或伪指令");
+    }
+
+    /* 在行边界重新同步：同一行的其余 Token 不再产生诊断 */
+    while (index < end && tokens[index].type != TOK_NEWLINE && tokens[index].type != TOK_EOF) {
+        index++;
+    }
+    return index;
+}
+
+/*
+ * 把 EXTRN 声明的名字登记为外部符号（地址为 0，由链接器填入）；
+ * 操作数名去掉 "name:NEAR" 中的类型后缀，之后即为符号名。
+ * 与标签或其它 EXTRN 重名时按重复定义报告
+ */
+static void declare_externals(PassOne* pass_one, InstructionEntry* entry, DeferredErrorList* defer) {
+    for (u32 k = 0; k < entry->operand_count; k++) {
+        Operand* operand = &entry->operands[k];
+        u32 n = 0;
+
+        while (operand->name[n] != '\0' && operand->name[n] != ':') {
+            n++;
+        }
+        operand->name[n] = '\0';
+        if (operand->type != OPERAND_LABEL || n == 0) {
+            operand->type = OPERAND_NONE;
+            pass_one_error(pass_one, defer, entry->line, 1,
+                ERR_PARSE_EXPECTED_OP, "EXTRN 需要符号名");
+        } else if (symtab_insert(pass_one->symtab, (const char*)operand->name, SYM_EXTERNAL, 0,
+                                 entry->line) != 0) {
+            pass_one_error(pass_one, defer, entry->line, 1,
+                ERR_PARSE_DUP_LABEL, "标签重复定义");
+        }
+    }
+}
+
+/*
+ * 扫描 Token 区间 [begin, end)，把解析出的指令追加到 pass_one。
+ * 地址与行号从 pass_one 当前值继续累加；标签登记到 pass_one->symtab。
+ */
+static void parse_token_range(
+    PassOne* pass_one,
+    const Token* tokens,
+    u32 begin,
+    u32 end,
+    DeferredErrorList* defer
+) {
+    u32 i = begin;
+    u32 line_end = begin;       /* 当前行行尾 Token 索引 */
+    int line_poisoned = 0;      /* 当前行含词法错误（TOK_OTHER） */
+
+    while (i < end) {
         if (tokens[i].type == TOK_NEWLINE || tokens[i].type == TOK_EOF) {
             i++;
             pass_one->current_line++;
             continue;
         }
 
+        /* 进入新行时检查是否含词法错误：这样的行整体替换为占位条目 */
+        if (i >= line_end) {
+            line_end = i;
+            line_poisoned = 0;
+            while (line_end < end && tokens[line_end].type != TOK_NEWLINE &&
+                   tokens[line_end].type != TOK_EOF) {
+                line_poisoned |= (tokens[line_end].type == TOK_OTHER);
+                line_end++;
+            }
+        }
+
         /* 尝试解析一条指令 */
-        if (pass_one->instruction_count >= pass_one->max_instructions) {
-            pass_one->has_errors = 1;
-            error_report(tokens[i].line, ERR_PARSE_EXPECTED_OP, "指令数超过限制");
+        if (ensure_instruction_capacity(pass_one) != 0) {
+            pass_one_error(pass_one, defer, tokens[i].line, 0,
+                ERR_SYS_OUT_OF_MEM, "无法扩展指令列表");
             break;
         }
 
         InstructionEntry* entry = &pass_one->instructions[pass_one->instruction_count];
-        int tokens_consumed = semantic_analyze_instruction(pass_one, tokens, i, entry);
+        int tokens_consumed = line_poisoned ? -1 :
+            semantic_analyze_instruction(pass_one, tokens, i, entry);
+        u32 next;
 
         if (tokens_consumed < 0) {
-            pass_one->has_errors = 1;
-            /* 报告无法解析的 token，以便调试 */
-            if (i < token_count && tokens[i].lexeme != NULL) {
-                error_report(tokens[i].line, ERR_PARSE_EXPECTED_OP, (const char*)tokens[i].lexeme);
-            } else {
-                error_report(pass_one->current_line, ERR_PARSE_EXPECTED_OP, "无法解析的指令或伪指令");
-            }
-            i++;
-            continue;
-        }
-
-        entry->address = pass_one->current_address;
-        entry->line = pass_one->current_line;
+            next = recover_line(pass_one, tokens, i, end, entry, defer, !line_poisoned);
+        } else {
+            entry->address = pass_one->current_address;
+            entry->line = pass_one->current_line;
 
-        /* 预估指令长度 */
-        entry->length = estimate_instruction_length(entry->mnemonic, entry->operand_count);
-        pass_one->current_address += entry->length;
+            /* 预估指令长度 */
+            entry->length = estimate_instruction_length(entry->mnemonic, entry->operand_count);
+            pass_one->current_address += entry->length;
+            next = i + (u32)tokens_consumed;
+        }
 
         /* 如果指令有标签，登记到符号表 */
         if (entry->has_label) {
             int result = symtab_insert(
                 pass_one->symtab,
                 entry->label,
-                SYM_LABEL,
+                semantic_label_type(entry),
                 entry->address,
                 entry->line
             );
             if (result != 0) {
-                pass_one->has_errors = 1;
-                error_report(entry->line, ERR_PARSE_DUP_LABEL,
-                    "标签重复定义");
+                pass_one_error(pass_one, defer, entry->line, 1,
+                    ERR_PARSE_DUP_LABEL, "标签重复定义");
             }
         }
+        if (!entry->has_error && util_strcmp((const char*)entry->mnemonic, "EXTRN") == 0) {
+            declare_externals(pass_one, entry, defer);
+        }
 
         pass_one->instruction_count++;
-        i += tokens_consumed;
+        i = next;
     }
+}
 
-    if (pass_one->has_errors) {
-        semantic_pass_one_destroy(pass_one);
+/*
+ * 并行工作线程入口：以块内相对地址扫描一个块
+ */
+static void pass_one_chunk_worker(void* arg) {
+    PassOneChunk* chunk = (PassOneChunk*)arg;
+    util_mem_set_tag(UTIL_MEM_IR);
+    parse_token_range(chunk->local, chunk->tokens, chunk->begin, chunk->end, &chunk->errors);
+}
+
+/*
+ * 回放一条延迟诊断
+ */
+static void replay_deferred_error(const DeferredError* item, u32 line_base) {
+    u32 line = item->line_is_relative ? item->line + line_base : item->line;
+    error_report(line, item->code, item->detail);
+}
+
+/*
+ * 并入块内 EXTRN 声明的外部符号：地址固定为 0，只平移定义行
+ */
+static void adopt_externals(PassOne* result, PassOne* local, const InstructionEntry* entry, u32 line_base) {
+    for (u32 k = 0; k < entry->operand_count; k++) {
+        if (entry->operands[k].type != OPERAND_LABEL) {
+            continue;
+        }
+        SymbolInfo* info = symtab_lookup(local->symtab, (const char*)entry->operands[k].name);
+        if (info == NULL || info->type != SYM_EXTERNAL || info->line_defined != entry->line) {
+            continue;
+        }
+        info->line_defined += line_base;
+        if (symtab_adopt(result->symtab, info) != 0) {
+            result->has_errors = 1;
+            error_report(entry->line + line_base, ERR_PARSE_DUP_LABEL, "标签重复定义");
+            util_free(info->name);
+            util_free(info);
+        }
+    }
+}
+
+/*
+ * 把一个块并入最终结果：重定位地址/行号，按指令顺序合并局部符号表，
+ * 并把块内延迟诊断与跨块重复标签按源代码顺序交错报告。
+ */
+static void merge_chunk(PassOne* result, PassOneChunk* chunk, u32 address_base, u32 line_base) {
+    PassOne* local = chunk->local;
+    u32 next_error = 0;
+
+    if (local->has_errors) {
+        result->has_errors = 1;
+    }
+
+    for (u32 n = 0; n < local->instruction_count; n++) {
+        while (next_error < chunk->errors.count && chunk->errors.items[next_error].seq <= n) {
+            replay_deferred_error(&chunk->errors.items[next_error++], line_base);
+        }
+
+        InstructionEntry* entry = &result->instructions[result->instruction_count++];
+        *entry = local->instructions[n];
+
+        if (entry->has_label) {
+            SymbolInfo* info = symtab_lookup(local->symtab, (const char*)entry->label);
+
+            /* 块内重复定义的标签已记入延迟诊断，只有首个定义者拥有符号 */
+            if (info != NULL && info->line_defined == entry->line) {
+                info->address += address_base;
+                info->line_defined += line_base;
+                if (symtab_adopt(result->symtab, info) != 0) {
+                    result->has_errors = 1;
+                    error_report(entry->line + line_base, ERR_PARSE_DUP_LABEL, "标签重复定义");
+                    util_free(info->name);
+                    util_free(info);
+                }
+            }
+        }
+        if (!entry->has_error && util_strcmp((const char*)entry->mnemonic, "EXTRN") == 0) {
+            adopt_externals(result, local, entry, line_base);
+        }
+
+        entry->address += address_base;
+        entry->line += line_base;
+    }
+
+    while (next_error < chunk->errors.count) {
+        replay_deferred_error(&chunk->errors.items[next_error++], line_base);
+    }
+}
+
+/* ========================================================================= */
+/* API 函数实现 */
+/* ========================================================================= */
+
+/*
+ * semantic_pass_one: 执行第一遍扫描
+ */
+PassOne* semantic_pass_one(const Token* tokens, u32 token_count) {
+    PassOne* pass_one = semantic_pass_one_begin();
+    if (pass_one == NULL) {
         return NULL;
     }
 
+    /* 遍历 Token 流，提取指令；出错的行以占位条目保留，结果交由调用者判断 */
+    semantic_pass_one_feed(pass_one, tokens, token_count);
     return pass_one;
 }
 
+/*
+ * semantic_pass_one_begin: 创建增量第一遍扫描上下文
+ */
+PassOne* semantic_pass_one_begin(void) {
+    return pass_one_create(256, 512);
+}
+
+/*
+ * semantic_pass_one_feed: 扫描一批按行对齐的 Token
+ */
+void semantic_pass_one_feed(PassOne* pass_one, const Token* tokens, u32 token_count) {
+    if (pass_one == NULL || tokens == NULL) return;
+    parse_token_range(pass_one, tokens, 0, token_count, NULL);
+}
+
+/*
+ * semantic_pass_one_parallel: 分块并行执行第一遍扫描
+ */
+PassOne* semantic_pass_one_parallel(const Token* tokens, u32 token_count, u32 thread_count) {
+    PassOneChunk* chunks;
+    UtilThread** threads;
+    PassOne* result;
+    u32 chunk_count;
+    u32 total_instructions;
+    u32 address_base;
+    u32 line_base;
+
+    if (thread_count == 0) {
+        thread_count = util_cpu_count();
+    }
+    if (thread_count > token_count / SEMANTIC_PARALLEL_MIN_CHUNK_TOKENS) {
+        thread_count = token_count / SEMANTIC_PARALLEL_MIN_CHUNK_TOKENS;
+    }
+    if (thread_count <= 1) {
+        return semantic_pass_one(tokens, token_count);
+    }
+
+    chunks = (PassOneChunk*)util_malloc(sizeof(PassOneChunk) * thread_count);
+    threads = (UtilThread**)util_malloc(sizeof(UtilThread*) * thread_count);
+    if (chunks == NULL || threads == NULL) {
+        util_free(chunks);
+        util_free(threads);
+        return semantic_pass_one(tokens, token_count);
+    }
+
+    /* 按行对齐切分：每个块在目标位置之后的第一个换行处结束 */
+    chunk_count = 0;
+    {
+        u32 begin = 0;
+        u32 target = token_count / thread_count;
+        while (begin < token_count && chunk_count < thread_count) {
+            u32 end = token_count;
+            if (chunk_count + 1 < thread_count) {
+                end = begin + target;
+                while (end < token_count && tokens[end - 1].type != TOK_NEWLINE) {
+                    end++;
+                }
+            }
+
+            PassOneChunk* chunk = &chunks[chunk_count];
+            chunk->tokens = tokens;
+            chunk->begin = begin;
+            chunk->end = end;
+            chunk->errors.items = NULL;
+            chunk->errors.count = 0;
+            chunk->errors.capacity = 0;
+            chunk->local = pass_one_create(256, 512);
+            if (chunk->local == NULL) {
+                break;
+            }
+
+            chunk_count++;
+            begin = end;
+        }
+
+        if (begin < token_count) {
+            for (u32 c = 0; c < chunk_count; c++) {
+                semantic_pass_one_destroy(chunks[c].local);
+            }
+            util_free(chunks);
+            util_free(threads);
+            return semantic_pass_one(tokens, token_count);
+        }
+    }
+
+    /* 第 0 块在当前线程执行；线程创建失败时退化为就地执行 */
+    for (u32 c = 1; c < chunk_count; c++) {
+        threads[c] = util_thread_create(pass_one_chunk_worker, &chunks[c]);
+        if (threads[c] == NULL) {
+            pass_one_chunk_worker(&chunks[c]);
+        }
+    }
+    pass_one_chunk_worker(&chunks[0]);
+    for (u32 c = 1; c < chunk_count; c++) {
+        util_thread_join(threads[c]);
+    }
+
+    /* 前缀和：计算每个块的地址与行号基址，再按顺序合并 */
+    total_instructions = 0;
+    for (u32 c = 0; c < chunk_count; c++) {
+        total_instructions += chunks[c].local->instruction_count;
+    }
+
+    result = pass_one_create(256, total_instructions > 0 ? total_instructions : 1);
+    if (result != NULL) {
+        address_base = 0;
+        line_base = 0;
+        for (u32 c = 0; c < chunk_count; c++) {
+            merge_chunk(result, &chunks[c], address_base, line_base);
+            address_base += chunks[c].local->current_address;
+            line_base += chunks[c].local->current_line - 1;
+        }
+        result->current_address = address_base;
+        result->current_line = line_base + 1;
+    }
+
+    for (u32 c = 0; c < chunk_count; c++) {
+        util_free(chunks[c].errors.items);
+        semantic_pass_one_destroy(chunks[c].local);
+    }
+    util_free(chunks);
+    util_free(threads);
+    return result;
+}
+
 /*
  * semantic_analyze_instruction: 分析单条指令
  */
@@ -165,18 +581,19 @@ int semantic_analyze_instruction(
 
     out_entry->operand_count = 0;
     out_entry->has_label = 0;
+    out_entry->has_error = 0;
     util_memset(out_entry->mnemonic, 0, sizeof(out_entry->mnemonic));
     util_memset(out_entry->label, 0, sizeof(out_entry->label));
 
     /* 检查是否有标签前缀 (标签: 指令) */
-    if (tokens[i].type == TOK_IDENTIFIER && i + 1 < 65535 && tokens[i+1].type == TOK_COLON) {
+    if (tokens[i].type == TOK_IDENTIFIER && tokens[i+1].type == TOK_COLON) {
         out_entry->has_label = 1;
         util_strcpy(out_entry->label, (const char*)tokens[i].lexeme);
         i += 2;
         tokens_consumed = 2;
 
         /* 标签后面可能直接是 NEWLINE，这种情况下只有标签，没有指令 */
-        if (i >= 65535 || tokens[i].type == TOK_NEWLINE || tokens[i].type == TOK_EOF) {
+        if (tokens[i].type == TOK_NEWLINE || tokens[i].type == TOK_EOF) {
             /* 创建一个虚拟"NOP"指令来保持标签地址 */
             util_strcpy(out_entry->mnemonic, "NOP");
             out_entry->operand_count = 0;
@@ -185,13 +602,13 @@ int semantic_analyze_instruction(
     }
 
     /* 读取助记符 */
-    if (i >= 65535 || tokens[i].type != TOK_IDENTIFIER) {
+    if (tokens[i].type != TOK_IDENTIFIER) {
         return -1;
     }
 
     /* 支持格式：label PROC  或 label ENDP （标签后直接跟助记符而非冒号）
        如果遇到 IDENT IDENT 且第二个 IDENT 是已知助记符，则第一个为标签 */
-    if (i + 1 < 65535 && tokens[i+1].type == TOK_IDENTIFIER) {
+    if (tokens[i+1].type == TOK_IDENTIFIER) {
         const InstructionInfo* info = tables_lookup_instruction((const char*)tokens[i+1].lexeme);
         /* 如果第二个标识符是已知伪指令：
            - 若为 PROC：第一个为标签定义（label PROC）
@@ -234,7 +651,7 @@ int semantic_analyze_instruction(
     }
 
     /* 解析操作数 */
-    while (i < 65535 && tokens[i].type != TOK_NEWLINE && tokens[i].type != TOK_EOF
+    while (tokens[i].type != TOK_NEWLINE && tokens[i].type != TOK_EOF
            && out_entry->operand_count < SEMANTIC_MAX_OPERANDS) {
 
         Operand* operand = &out_entry->operands[out_entry->operand_count];
@@ -270,7 +687,7 @@ int semantic_analyze_instruction(
                 tokens_consumed++;
             }
             out_entry->operand_count++;
-            if (i < 65535 && tokens[i].type == TOK_COMMA) {
+            if (tokens[i].type == TOK_COMMA) {
                 i++;
                 tokens_consumed++;
             }
@@ -285,7 +702,7 @@ int semantic_analyze_instruction(
         tokens_consumed++;
 
         /* 处理类似 CS:CODE 的语法（伪指令 ASSUME 使用） */
-        if (i < 65535 && tokens[i].type == TOK_COLON && i + 1 < 65535 && tokens[i+1].type == TOK_IDENTIFIER) {
+        if (tokens[i].type == TOK_COLON && tokens[i+1].type == TOK_IDENTIFIER) {
             /* 将冒号和后续标识符并入当前操作数名称，例如 "CS:CODE" */
             char tmp[128];
             util_memset(tmp, 0, sizeof(tmp));
@@ -302,7 +719,7 @@ int semantic_analyze_instruction(
         }
 
         /* 检查是否有逗号分隔的下一个操作数 */
-        if (i < 65535 && tokens[i].type == TOK_COMMA) {
+        if (tokens[i].type == TOK_COMMA) {
             i++;
             tokens_consumed++;
         } else {
@@ -333,6 +750,15 @@ u32 semantic_get_instruction_length(
     return 3;  /* 默认 3 字节 */
 }
 
+/*
+ * semantic_label_type: 由标签行的助记符确定符号类型
+ */
+SymbolType semantic_label_type(const InstructionEntry* entry) {
+    if (util_strcmp((const char*)entry->mnemonic, "PROC") == 0) return SYM_PROCEDURE;
+    if (util_strcmp((const char*)entry->mnemonic, "DB") == 0) return SYM_VARIABLE;
+    return SYM_LABEL;
+}
+
 /*
  * semantic_validate_operand: 验证操作数合法性
  */
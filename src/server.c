@@ -0,0 +1,527 @@
+﻿/*
+ * ============================================================================
+ * 文件名: server.c
+ * 描述  : 汇编服务实现（Unix 域套接字）
+ *
+ * 服务端为每个工作线程创建一个常驻 AsmContext，线程在共享的监听套接字上
+ * accept，逐个处理连接上的请求。诊断经 sink 收集到每线程的文本缓冲区，
+ * 与机器码一起写回客户端。关闭请求置位停止标志并 shutdown 监听套接字，
+ * 阻塞在 accept 中的线程随之返回并退出。
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../include/server.h"
+
+#define SERVER_READ_CHUNK   65536
+
+/* 诊断文本缓冲区（跨请求复用） */
+typedef struct {
+    char* data;
+    u32 len;
+    u32 capacity;
+} ReplyText;
+
+/* 服务端共享状态 */
+typedef struct {
+    int listen_fd;
+    _Atomic int stopping;       /* 已收到关闭请求 */
+} ServerState;
+
+/* 工作线程 */
+typedef struct {
+    ServerState* state;
+    AsmContext* ctx;
+    ReplyText diagnostics;
+} ServerWorker;
+
+/* ========================================================================= */
+/* 内部辅助函数 */
+/* ========================================================================= */
+
+static int fill_address(const char* path, struct sockaddr_un* addr);
+static int write_all(int fd, const void* data, u32 size);
+static int read_all(int fd, void* data, u32 size);
+static void collect_diagnostics(void* user, const char* text, u32 len);
+static char* read_whole_file(const char* path, u32* out_size);
+static void report_file_error(ServerWorker* worker, const char* detail);
+static int handle_request(ServerWorker* worker, int fd, const ServerRequestHeader* request);
+static void serve_connection(ServerWorker* worker, int fd);
+static void worker_main(void* arg);
+static int connect_server(const char* path);
+static int send_request(int fd, ServerRequestKind kind, const char* payload, u32 size,
+                        u32 max_errors);
+
+/*
+ * 填写套接字地址；路径超出 sun_path 容量时返回 -1
+ */
+static int fill_address(const char* path, struct sockaddr_un* addr) {
+    u32 len = util_strlen(path);
+    char* dest = (char*)addr;
+
+    for (u32 i = 0; i < sizeof(*addr); i++) {
+        dest[i] = 0;
+    }
+    if (len == 0 || len >= sizeof(addr->sun_path)) {
+        return -1;
+    }
+    addr->sun_family = AF_UNIX;
+    for (u32 i = 0; i < len; i++) {
+        addr->sun_path[i] = path[i];
+    }
+    return 0;
+}
+
+/*
+ * 写出全部字节（对端已关闭时不产生 SIGPIPE）
+ */
+static int write_all(int fd, const void* data, u32 size) {
+    const char* p = (const char*)data;
+
+    while (size > 0) {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        size -= (u32)n;
+    }
+    return 0;
+}
+
+/*
+ * 读满 size 字节；对端关闭或出错时返回 -1
+ */
+static int read_all(int fd, void* data, u32 size) {
+    char* p = (char*)data;
+
+    while (size > 0) {
+        ssize_t n = recv(fd, p, size, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        size -= (u32)n;
+    }
+    return 0;
+}
+
+/*
+ * 诊断 sink：追加到工作线程的文本缓冲区
+ */
+static void collect_diagnostics(void* user, const char* text, u32 len) {
+    ReplyText* out = (ReplyText*)user;
+
+    if (out->len + len > out->capacity) {
+        u32 capacity = out->capacity ? out->capacity : 1024;
+        while (capacity < out->len + len) {
+            capacity *= 2;
+        }
+        char* grown = (char*)util_malloc(capacity);
+        if (grown == NULL_PTR) return;
+        for (u32 i = 0; i < out->len; i++) grown[i] = out->data[i];
+        util_free(out->data);
+        out->data = grown;
+        out->capacity = capacity;
+    }
+    for (u32 i = 0; i < len; i++) {
+        out->data[out->len + i] = text[i];
+    }
+    out->len += len;
+}
+
+/*
+ * 读取整个源文件（服务端按路径汇编时使用）
+ */
+static char* read_whole_file(const char* path, u32* out_size) {
+    FILE* fp = fopen(path, "rb");
+    u32 capacity = SERVER_READ_CHUNK;
+    u32 size = 0;
+    char* buffer;
+
+    if (fp == NULL_PTR) return NULL_PTR;
+
+    buffer = (char*)util_malloc(capacity);
+    while (buffer != NULL_PTR) {
+        size += (u32)fread(buffer + size, 1, capacity - size, fp);
+        if (size < capacity) break;
+        char* grown = NULL_PTR;
+        if (capacity <= 0x7FFFFFFFu) {
+            grown = (char*)util_malloc(capacity * 2);
+        }
+        if (grown != NULL_PTR) {
+            for (u32 i = 0; i < size; i++) grown[i] = buffer[i];
+        }
+        util_free(buffer);
+        buffer = grown;
+        capacity *= 2;
+    }
+    if (buffer != NULL_PTR && ferror(fp)) {
+        util_free(buffer);
+        buffer = NULL_PTR;
+    }
+    fclose(fp);
+
+    *out_size = size;
+    return buffer;
+}
+
+/*
+ * 以与命令行相同的格式报告源文件读取失败
+ */
+static void report_file_error(ServerWorker* worker, const char* detail) {
+    ErrorContext diagnostics;
+    ErrorContext* previous;
+
+    error_context_init(&diagnostics, 1, 0);
+    diagnostics.sink = collect_diagnostics;
+    diagnostics.sink_user = &worker->diagnostics;
+    previous = error_bind(&diagnostics);
+    error_report(0, ERR_SYS_FILE_IO, detail);
+    error_flush();
+    error_bind(previous);
+    error_context_dispose(&diagnostics);
+}
+
+/*
+ * 处理一个汇编或关闭请求并写回应答；通信失败时返回 -1
+ */
+static int handle_request(ServerWorker* worker, int fd, const ServerRequestHeader* request) {
+    ServerResponseHeader response;
+    AsmOutput out;
+    char* payload = NULL_PTR;
+    char* source = NULL_PTR;
+    u32 source_size = 0;
+    int result;
+
+    out.code = NULL_PTR;
+    out.size = 0;
+    worker->diagnostics.len = 0;
+    response.magic = SERVER_RESPONSE_MAGIC;
+    response.version = SERVER_PROTOCOL_VERSION;
+    response.error_count = 0;
+
+    /* 载荷多留 1 字节：路径请求需要 '\0' 结尾 */
+    payload = (char*)util_malloc(request->payload_size + 1);
+    if (payload == NULL_PTR) return -1;
+    if (read_all(fd, payload, request->payload_size) != 0) {
+        util_free(payload);
+        return -1;
+    }
+    payload[request->payload_size] = '\0';
+
+    if (request->kind == SERVER_REQ_SHUTDOWN) {
+        atomic_store(&worker->state->stopping, 1);
+        shutdown(worker->state->listen_fd, SHUT_RDWR);
+        util_free(payload);
+        response.status = 0;
+        response.code_size = 0;
+        response.diagnostics_size = 0;
+        return write_all(fd, &response, sizeof(response));
+    }
+
+    if (request->kind == SERVER_REQ_ASSEMBLE_PATH) {
+        source = read_whole_file(payload, &source_size);
+        if (source == NULL_PTR) {
+            report_file_error(worker, "Cannot open input file");
+        }
+    } else {
+        source = payload;
+        source_size = request->payload_size;
+        payload = NULL_PTR;
+    }
+
+    if (source != NULL_PTR) {
+        /* 诊断上限按请求设置（与命令行 --max-errors 一致） */
+        worker->ctx->options.max_errors = request->max_errors;
+        worker->ctx->diagnostics.limit = request->max_errors;
+        result = subas_assemble(worker->ctx, source, source_size, &out);
+        response.error_count = subas_get_error_count(worker->ctx);
+    } else {
+        result = -1;
+        response.error_count = 1;
+    }
+
+    response.status = result;
+    response.code_size = (result == 0) ? out.size : 0;
+    response.diagnostics_size = worker->diagnostics.len;
+
+    int sent = write_all(fd, &response, sizeof(response));
+    if (sent == 0 && response.code_size > 0) {
+        sent = write_all(fd, out.code, response.code_size);
+    }
+    if (sent == 0 && response.diagnostics_size > 0) {
+        sent = write_all(fd, worker->diagnostics.data, response.diagnostics_size);
+    }
+
+    util_free(source);
+    util_free(payload);
+    return sent;
+}
+
+/*
+ * 处理一个连接上的全部请求，直到对端关闭、协议错误或收到关闭请求
+ */
+static void serve_connection(ServerWorker* worker, int fd) {
+    ServerRequestHeader request;
+
+    while (read_all(fd, &request, sizeof(request)) == 0) {
+        if (request.magic != SERVER_REQUEST_MAGIC ||
+            request.version != SERVER_PROTOCOL_VERSION ||
+            request.kind < SERVER_REQ_ASSEMBLE || request.kind > SERVER_REQ_SHUTDOWN ||
+            request.payload_size > SERVER_MAX_PAYLOAD) {
+            break;
+        }
+        if (handle_request(worker, fd, &request) != 0 ||
+            request.kind == SERVER_REQ_SHUTDOWN) {
+            break;
+        }
+    }
+}
+
+/*
+ * 工作线程主循环
+ */
+static void worker_main(void* arg) {
+    ServerWorker* worker = (ServerWorker*)arg;
+
+    while (!atomic_load(&worker->state->stopping)) {
+        int fd = accept(worker->state->listen_fd, NULL_PTR, NULL_PTR);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+        serve_connection(worker, fd);
+        close(fd);
+    }
+}
+
+/*
+ * 连接服务端；失败时返回 -1
+ */
+static int connect_server(const char* path) {
+    struct sockaddr_un addr;
+    int fd;
+
+    if (fill_address(path, &addr) != 0) return -1;
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * 发送请求头与载荷
+ */
+static int send_request(int fd, ServerRequestKind kind, const char* payload, u32 size,
+                        u32 max_errors) {
+    ServerRequestHeader request;
+
+    request.magic = SERVER_REQUEST_MAGIC;
+    request.version = SERVER_PROTOCOL_VERSION;
+    request.kind = (u32)kind;
+    request.max_errors = max_errors;
+    request.payload_size = size;
+
+    if (write_all(fd, &request, sizeof(request)) != 0) return -1;
+    if (size > 0 && write_all(fd, payload, size) != 0) return -1;
+    return 0;
+}
+
+/* ========================================================================= */
+/* 服务端 */
+/* ========================================================================= */
+
+int server_run(const char* socket_path, u32 workers, const AsmOptions* options) {
+    struct sockaddr_un addr;
+    ServerState state;
+    AsmOptions worker_options;
+    ServerWorker* pool;
+    UtilThread** threads;
+
+    if (socket_path == NULL_PTR || fill_address(socket_path, &addr) != 0) {
+        printf("ERROR: Invalid socket path\n");
+        return -1;
+    }
+
+    state.listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    atomic_init(&state.stopping, 0);
+    if (state.listen_fd < 0) {
+        printf("ERROR: Cannot create socket\n");
+        return -1;
+    }
+
+    if (bind(state.listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        /* 套接字文件已存在：仍有服务端在监听则放弃，否则视为残留文件替换之 */
+        int probe = (errno == EADDRINUSE) ? connect_server(socket_path) : -1;
+        if (errno != EADDRINUSE || probe >= 0) {
+            if (probe >= 0) close(probe);
+            printf("ERROR: Cannot listen on %s (in use?)\n", socket_path);
+            close(state.listen_fd);
+            return -1;
+        }
+        unlink(socket_path);
+        if (bind(state.listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+            printf("ERROR: Cannot listen on %s\n", socket_path);
+            close(state.listen_fd);
+            return -1;
+        }
+    }
+    if (listen(state.listen_fd, SERVER_LISTEN_BACKLOG) != 0) {
+        printf("ERROR: Cannot listen on %s\n", socket_path);
+        close(state.listen_fd);
+        unlink(socket_path);
+        return -1;
+    }
+
+    if (workers == 0) {
+        workers = util_cpu_count();
+    }
+    if (options != NULL_PTR) {
+        worker_options = *options;
+    } else {
+        subas_options_init(&worker_options);
+    }
+    worker_options.progress = 0;
+    worker_options.verbose = 0;
+    worker_options.echo_diagnostics = 1;
+
+    pool = (ServerWorker*)util_malloc(sizeof(ServerWorker) * workers);
+    threads = (UtilThread**)util_malloc(sizeof(UtilThread*) * workers);
+    if (pool == NULL_PTR || threads == NULL_PTR) {
+        util_free(pool);
+        util_free(threads);
+        close(state.listen_fd);
+        unlink(socket_path);
+        printf("ERROR: Cannot allocate workers\n");
+        return -1;
+    }
+
+    u32 created = 0;
+    for (u32 i = 0; i < workers; i++) {
+        pool[i].state = &state;
+        pool[i].diagnostics.data = NULL_PTR;
+        pool[i].diagnostics.len = 0;
+        pool[i].diagnostics.capacity = 0;
+        pool[i].ctx = subas_context_create(&worker_options);
+        if (pool[i].ctx == NULL_PTR) break;
+        subas_set_diagnostic_sink(pool[i].ctx, collect_diagnostics, &pool[i].diagnostics);
+        created++;
+    }
+
+    /* 第 0 个工作者在当前线程运行；线程创建失败时以较少的工作者继续 */
+    u32 started = 0;
+    for (u32 i = 1; i < created; i++) {
+        threads[i] = util_thread_create(worker_main, &pool[i]);
+        if (threads[i] == NULL_PTR) break;
+        started = i;
+    }
+    if (created > 0) {
+        worker_main(&pool[0]);
+    }
+    for (u32 i = 1; i <= started; i++) {
+        util_thread_join(threads[i]);
+    }
+
+    for (u32 i = 0; i < created; i++) {
+        subas_context_destroy(pool[i].ctx);
+        util_free(pool[i].diagnostics.data);
+    }
+    util_free(pool);
+    util_free(threads);
+    close(state.listen_fd);
+    unlink(socket_path);
+    return (created > 0) ? 0 : -1;
+}
+
+/* ========================================================================= */
+/* 客户端 */
+/* ========================================================================= */
+
+int server_assemble(const char* socket_path, ServerRequestKind kind, const char* payload,
+                    u32 payload_size, u32 max_errors, ServerReply* reply) {
+    ServerResponseHeader response;
+    int fd;
+
+    if (reply == NULL_PTR) return -1;
+    reply->status = -1;
+    reply->error_count = 0;
+    reply->code = NULL_PTR;
+    reply->code_size = 0;
+    reply->diagnostics = NULL_PTR;
+    reply->diagnostics_size = 0;
+
+    if (socket_path == NULL_PTR || payload_size > SERVER_MAX_PAYLOAD ||
+        (kind != SERVER_REQ_ASSEMBLE && kind != SERVER_REQ_ASSEMBLE_PATH)) {
+        return -1;
+    }
+
+    fd = connect_server(socket_path);
+    if (fd < 0) return -1;
+
+    int result = send_request(fd, kind, payload, payload_size, max_errors);
+    if (result == 0) {
+        result = read_all(fd, &response, sizeof(response));
+    }
+    if (result == 0 && (response.magic != SERVER_RESPONSE_MAGIC ||
+                        response.version != SERVER_PROTOCOL_VERSION)) {
+        result = -1;
+    }
+    if (result == 0 && response.code_size > 0) {
+        reply->code = (u8*)util_malloc(response.code_size);
+        result = (reply->code != NULL_PTR) ? read_all(fd, reply->code, response.code_size) : -1;
+        reply->code_size = response.code_size;
+    }
+    if (result == 0 && response.diagnostics_size > 0) {
+        reply->diagnostics = (char*)util_malloc(response.diagnostics_size);
+        result = (reply->diagnostics != NULL_PTR)
+                     ? read_all(fd, reply->diagnostics, response.diagnostics_size) : -1;
+        reply->diagnostics_size = response.diagnostics_size;
+    }
+    close(fd);
+
+    if (result != 0) {
+        server_reply_dispose(reply);
+        reply->status = -1;
+        return -1;
+    }
+    reply->status = response.status;
+    reply->error_count = response.error_count;
+    return 0;
+}
+
+int server_shutdown(const char* socket_path) {
+    ServerResponseHeader response;
+    int fd;
+
+    if (socket_path == NULL_PTR) return -1;
+    fd = connect_server(socket_path);
+    if (fd < 0) return -1;
+
+    int result = send_request(fd, SERVER_REQ_SHUTDOWN, NULL_PTR, 0, 0);
+    if (result == 0) {
+        result = read_all(fd, &response, sizeof(response));
+    }
+    close(fd);
+    if (result == 0 && response.magic != SERVER_RESPONSE_MAGIC) {
+        result = -1;
+    }
+    return result;
+}
+
+void server_reply_dispose(ServerReply* reply) {
+    if (reply == NULL_PTR) return;
+    util_free(reply->code);
+    util_free(reply->diagnostics);
+    reply->code = NULL_PTR;
+    reply->code_size = 0;
+    reply->diagnostics = NULL_PTR;
+    reply->diagnostics_size = 0;
+}
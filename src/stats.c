@@ -0,0 +1,256 @@
+﻿/*
+ * ============================================================================
+ * 文件名: stats.c
+ * 描述  : 统计模块实现
+ *
+ * 跟踪文件格式（Chrome trace-event，JSON 数组）：
+ *   [{"name":"lex","ph":"X","ts":12.3,"dur":4.5,"pid":1,"tid":2,"args":{"file":"a.asm"}}, ...]
+ * 时间单位为微秒，以 trace_open 时刻为零点。
+ *
+ * ============================================================================
+ */
+
+#include "../include/stats.h"
+#include "../include/counters.h"
+
+/* 阶段名称（与 StatsPhase 一一对应） */
+static const char* const g_phase_names[STATS_PHASE_COUNT] = {
+    "read",
+    "tables_init",
+    "lex",
+    "pass_one",
+    "pass_two",
+    "pipeline",
+    "write"
+};
+
+/* Chrome 跟踪文件写入器 */
+struct TraceFile {
+    FILE* fp;
+    u64 origin_ns;              /* 时间零点 */
+    u32 events;                 /* 已写出的事件数 */
+};
+
+/* ========================================================================= */
+/* 内部辅助函数 */
+/* ========================================================================= */
+
+/*
+ * 写出 JSON 字符串（转义引号、反斜杠与控制字符）
+ */
+static void write_json_string(FILE* fp, const char* text) {
+    fputc('"', fp);
+    for (const char* p = text; *p != '\0'; p++) {
+        if (*p == '"' || *p == '\\') {
+            fputc('\\', fp);
+            fputc(*p, fp);
+        } else if ((u8)*p < 0x20) {
+            fprintf(fp, "\\u%04x", (u32)(u8)*p);
+        } else {
+            fputc(*p, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+/*
+ * 写出分配记账（未开启记账时不输出）
+ */
+static void write_memory_json(FILE* fp) {
+    UtilMemStats mem;
+
+    util_mem_get_stats(&mem);
+    if (mem.allocs == 0) {
+        return;
+    }
+
+    fprintf(fp, ",\"memory\":{\"allocs\":%llu,\"frees\":%llu,\"total_bytes\":%llu,"
+                "\"live_bytes\":%llu,\"peak_bytes\":%llu,\"peak_tag\":\"%s\","
+                "\"peak_rss_kb\":%llu,\"tags\":{",
+            mem.allocs, mem.frees, mem.total_bytes, mem.live_bytes, mem.peak_bytes,
+            util_mem_tag_name(mem.peak_tag), util_peak_rss_kb());
+    for (u32 t = 0; t < UTIL_MEM_TAG_COUNT; t++) {
+        fprintf(fp, "%s\"%s\":{\"allocs\":%llu,\"peak\":%llu,\"at_peak\":%llu}",
+                (t > 0) ? "," : "", util_mem_tag_name((UtilMemTag)t),
+                mem.tag_allocs[t], mem.tag_peak[t], mem.tag_at_peak[t]);
+    }
+
+    /* 直方图：键为桶下界（字节），省略空桶 */
+    fputs("},\"histogram\":{", fp);
+    int first = 1;
+    for (u32 b = 0; b < UTIL_MEM_BUCKETS; b++) {
+        if (mem.histogram[b] == 0) {
+            continue;
+        }
+        fprintf(fp, "%s\"%llu\":%llu", first ? "" : ",", 1ULL << b, mem.histogram[b]);
+        first = 0;
+    }
+    fputs("}}", fp);
+}
+
+/* ========================================================================= */
+/* API 函数实现 */
+/* ========================================================================= */
+
+void stats_init(AsmStats* stats) {
+    util_memset(stats, 0, sizeof(AsmStats));
+}
+
+void stats_phase_begin(AsmStats* stats, StatsPhase phase) {
+    stats->start_ns[phase] = util_time_ns();
+    stats->thread_id[phase] = util_thread_id();
+    stats->peak_base[phase] = util_mem_peak_bytes();
+}
+
+void stats_phase_end(AsmStats* stats, StatsPhase phase) {
+    stats->elapsed_ns[phase] += util_time_ns() - stats->start_ns[phase];
+    stats->peak_growth[phase] += util_mem_peak_bytes() - stats->peak_base[phase];
+}
+
+void stats_merge(AsmStats* into, const AsmStats* from) {
+    for (u32 i = 0; i < STATS_PHASE_COUNT; i++) {
+        if (from->start_ns[i] == 0) {
+            continue;
+        }
+        if (into->start_ns[i] == 0 || from->start_ns[i] < into->start_ns[i]) {
+            into->start_ns[i] = from->start_ns[i];
+            into->thread_id[i] = from->thread_id[i];
+        }
+        into->elapsed_ns[i] += from->elapsed_ns[i];
+        into->peak_growth[i] += from->peak_growth[i];
+    }
+
+    into->files += from->files;
+    into->source_bytes += from->source_bytes;
+    into->tokens += from->tokens;
+    into->instructions += from->instructions;
+    into->symbols += from->symbols;
+    into->code_bytes += from->code_bytes;
+    into->relocations += from->relocations;
+}
+
+const char* stats_phase_name(StatsPhase phase) {
+    return g_phase_names[phase];
+}
+
+u64 stats_phase_items(const AsmStats* stats, StatsPhase phase, const char** out_unit) {
+    switch (phase) {
+        case STATS_PHASE_READ:
+            *out_unit = "bytes";
+            return stats->source_bytes;
+        case STATS_PHASE_LEX:
+        case STATS_PHASE_PIPELINE:
+            *out_unit = "tokens";
+            return stats->tokens;
+        case STATS_PHASE_PASS_ONE:
+            *out_unit = "instructions";
+            return stats->instructions;
+        case STATS_PHASE_PASS_TWO:
+        case STATS_PHASE_WRITE:
+            *out_unit = "bytes";
+            return stats->code_bytes;
+        default:
+            *out_unit = "";
+            return 0;
+    }
+}
+
+void stats_write_json(FILE* fp, const AsmStats* stats) {
+    u64 total_ns = 0;
+
+    fprintf(fp, "{\"files\":%u,\"source_bytes\":%llu,\"tokens\":%llu,"
+                "\"instructions\":%llu,\"symbols\":%llu,\"code_bytes\":%llu,"
+                "\"relocations\":%llu,\"phases\":{",
+            stats->files, stats->source_bytes, stats->tokens, stats->instructions,
+            stats->symbols, stats->code_bytes, stats->relocations);
+
+    int first = 1;
+    for (u32 i = 0; i < STATS_PHASE_COUNT; i++) {
+        const char* unit;
+        u64 items;
+
+        if (stats->start_ns[i] == 0) {
+            continue;
+        }
+
+        items = stats_phase_items(stats, (StatsPhase)i, &unit);
+        total_ns += stats->elapsed_ns[i];
+        fprintf(fp, "%s\"%s\":{\"ns\":%llu", first ? "" : ",", g_phase_names[i],
+                stats->elapsed_ns[i]);
+        if (*unit != '\0') {
+            /* 吞吐量：每秒处理的条目数 */
+            double per_sec = (stats->elapsed_ns[i] > 0) ?
+                (double)items * 1e9 / (double)stats->elapsed_ns[i] : 0.0;
+            fprintf(fp, ",\"%s\":%llu,\"%s_per_sec\":%.0f", unit, items, unit, per_sec);
+        }
+        if (stats->peak_growth[i] > 0) {
+            fprintf(fp, ",\"peak_growth\":%llu", stats->peak_growth[i]);
+        }
+        fputc('}', fp);
+        first = 0;
+    }
+
+    fprintf(fp, "},\"total_ns\":%llu", total_ns);
+    write_memory_json(fp);
+    if (COUNTERS_ENABLED) {
+        fputs(",\"counters\":", fp);
+        counters_write_json(fp);
+    }
+    fputs("}\n", fp);
+}
+
+TraceFile* trace_open(const char* path) {
+    TraceFile* trace = (TraceFile*)util_malloc(sizeof(TraceFile));
+    if (trace == NULL_PTR) {
+        return NULL_PTR;
+    }
+
+    trace->fp = fopen(path, "w");
+    if (trace->fp == NULL_PTR) {
+        util_free(trace);
+        return NULL_PTR;
+    }
+
+    trace->origin_ns = util_time_ns();
+    trace->events = 0;
+    fputs("[\n", trace->fp);
+    return trace;
+}
+
+void trace_add(TraceFile* trace, const AsmStats* stats, const char* label) {
+    if (trace == NULL_PTR) return;
+
+    for (u32 i = 0; i < STATS_PHASE_COUNT; i++) {
+        u64 start = stats->start_ns[i];
+
+        if (start == 0) {
+            continue;
+        }
+        if (start < trace->origin_ns) {
+            start = trace->origin_ns;
+        }
+
+        fprintf(trace->fp, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                           "\"pid\":1,\"tid\":%u,\"args\":{\"file\":",
+                (trace->events > 0) ? ",\n" : "", g_phase_names[i],
+                (double)(start - trace->origin_ns) / 1000.0,
+                (double)stats->elapsed_ns[i] / 1000.0, stats->thread_id[i]);
+        write_json_string(trace->fp, label);
+        fputs("}}", trace->fp);
+        trace->events++;
+    }
+}
+
+int trace_close(TraceFile* trace) {
+    int result;
+
+    if (trace == NULL_PTR) return 0;
+
+    fputs("\n]\n", trace->fp);
+    result = ferror(trace->fp) ? -1 : 0;
+    if (fclose(trace->fp) != 0) {
+        result = -1;
+    }
+    util_free(trace);
+    return result;
+}
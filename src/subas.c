@@ -0,0 +1,677 @@
+﻿/*
+ * ============================================================================
+ * 文件名: subas.c
+ * 描述  : SUBAS 汇编器库实现 (libsubas)
+ *
+ * 关键流程：
+ *  1. 把当前线程绑定到上下文自己的诊断（ErrorContext）
+ *  2. 初始化表驱动系统（只读常量表，所有上下文共享）
+ *  3. 词法分析 → 第一遍扫描 → 第二遍扫描；或以流水线模式重叠执行；
+ *     或由 IR 文件加载第一遍扫描结果后只执行第二遍扫描
+ *  4. 每一步结束检查本上下文的错误数，出错即停止
+ *  5. 恢复线程原先绑定的诊断上下文
+ *
+ * 本模块不含任何全局可变状态，不同线程可同时使用各自的 AsmContext。
+ * 源文本既可整块传入（subas_assemble），也可经回调流式读入
+ * （subas_assemble_stream），后者不保留完整的源文本；串行第一遍扫描时
+ * Token 按行分批交给第一遍扫描后即释放，不保留完整的 Token 流。
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include "../include/subas.h"
+#include "../include/pipeline.h"
+#include "../include/tables.h"
+
+/* ========================================================================= */
+/* 内部类型 */
+/* ========================================================================= */
+
+/*
+ * 源文本输入：read 为 NULL_PTR 时使用整块文本 text/len，否则经回调流式读取
+ */
+typedef struct {
+    const char* text;
+    u32 len;
+    LexerReadFunc read;
+    void* user;
+} SourceInput;
+
+/* ========================================================================= */
+/* 内部辅助函数 */
+/* ========================================================================= */
+
+/*
+ * 按输入方式创建词法器
+ */
+static Lexer* open_lexer(const SourceInput* input) {
+    if (input->read != NULL_PTR) {
+        return lexer_create_from_stream(input->read, input->user, 0);
+    }
+    return lexer_create_from_buffer(input->text, input->len);
+}
+
+/*
+ * 释放上一次汇编的结果
+ */
+static void release_results(AsmContext* ctx) {
+    codegen_destroy(ctx->codegen);
+    semantic_pass_one_destroy(ctx->pass_one);
+    ctx->codegen = NULL_PTR;
+    ctx->pass_one = NULL_PTR;
+}
+
+/*
+ * 释放 Token 词素，保留 Token 缓冲区供下次复用
+ */
+static void release_tokens(AsmContext* ctx) {
+    for (u32 i = 0; i < ctx->token_count; i++) {
+        token_dispose(&ctx->tokens[i]);
+    }
+    ctx->token_count = 0;
+}
+
+/*
+ * 把 Token 追加到上下文缓冲区，满时按两倍扩容；失败时释放 tok 并返回 -1
+ */
+static int append_token(AsmContext* ctx, Token tok) {
+    if (ctx->token_count >= ctx->token_capacity) {
+        /* util_malloc 以 u32 计字节，乘积溢出视为内存不足 */
+        Token* grown = NULL_PTR;
+        if (ctx->token_capacity <= 0xFFFFFFFFu / 2 / sizeof(Token)) {
+            grown = (Token*)util_malloc(sizeof(Token) * ctx->token_capacity * 2);
+        }
+        if (grown == NULL_PTR) {
+            if (ctx->options.progress) {
+                printf("ERROR: Too many tokens\n");
+            }
+            token_dispose(&tok);
+            return -1;
+        }
+        for (u32 t = 0; t < ctx->token_count; t++) {
+            grown[t] = ctx->tokens[t];
+        }
+        util_free(ctx->tokens);
+        ctx->tokens = grown;
+        ctx->token_capacity *= 2;
+    }
+
+    ctx->tokens[ctx->token_count++] = tok;
+    return 0;
+}
+
+/*
+ * 第一遍扫描结束：记录统计并输出进度
+ */
+static void report_pass_one(AsmContext* ctx) {
+    ctx->stats.instructions = ctx->pass_one->instruction_count;
+    ctx->stats.symbols = symtab_get_symbol_count(ctx->pass_one->symtab);
+
+    if (ctx->options.progress) {
+        printf("  Instructions: %u\n", ctx->pass_one->instruction_count);
+        printf("  Code size: 0x%04X\n", ctx->pass_one->current_address);
+        printf("  Symbols: %u\n", symtab_get_symbol_count(ctx->pass_one->symtab));
+    }
+
+    /* 出错的行已替换为占位条目，第二遍照常进行以报告其余错误 */
+    if (error_get_count() > 0 && ctx->options.progress) {
+        printf("Semantic errors detected! (%u)\n", error_get_count());
+    }
+
+    if (ctx->options.progress && ctx->options.verbose) {
+        printf("\n");
+    }
+}
+
+/*
+ * 第 2 步：词法分析，把全部 Token 收集到上下文缓冲区
+ */
+static int lex_source(AsmContext* ctx, const SourceInput* input) {
+    Lexer* lexer;
+    int has_eof = 0;
+
+    if (ctx->options.progress) {
+        printf("Step 2: Lexical analysis (Lexing)...\n");
+    }
+
+    stats_phase_begin(&ctx->stats, STATS_PHASE_LEX);
+    UtilMemTag previous = util_mem_set_tag(UTIL_MEM_LEXER);
+    lexer = open_lexer(input);
+    if (lexer == NULL_PTR) {
+        util_mem_set_tag(previous);
+        if (ctx->options.progress) {
+            printf("ERROR: Cannot create lexer\n");
+        }
+        return -1;
+    }
+    lexer_set_line_index(lexer, &ctx->lines);
+
+    while (!has_eof) {
+        Token tok = lexer_next_token(lexer);
+        has_eof = (tok.type == TOK_EOF);
+        if (append_token(ctx, tok) != 0) {
+            lexer_destroy(lexer);
+            util_mem_set_tag(previous);
+            stats_phase_end(&ctx->stats, STATS_PHASE_LEX);
+            return -1;
+        }
+    }
+    lexer_destroy(lexer);
+    util_mem_set_tag(previous);
+    stats_phase_end(&ctx->stats, STATS_PHASE_LEX);
+    ctx->stats.tokens = ctx->token_count;
+
+    if (ctx->options.progress) {
+        printf("  Tokens: %u\n", ctx->token_count);
+    }
+    /* 词法错误不中断：后续两遍继续报告其余各行的错误 */
+    if (error_get_count() > 0 && ctx->options.progress) {
+        printf("Lexical errors detected! (%u)\n", error_get_count());
+    }
+    return 0;
+}
+
+/*
+ * 第 3 步：第一遍扫描
+ */
+static int run_pass_one(AsmContext* ctx) {
+    if (ctx->options.progress) {
+        printf("Step 3: Semantic analysis (Pass 1)...\n");
+    }
+
+    stats_phase_begin(&ctx->stats, STATS_PHASE_PASS_ONE);
+    UtilMemTag previous = util_mem_set_tag(UTIL_MEM_IR);
+    if (ctx->options.pass_one_threads == 1) {
+        ctx->pass_one = semantic_pass_one(ctx->tokens, ctx->token_count);
+    } else {
+        ctx->pass_one = semantic_pass_one_parallel(ctx->tokens, ctx->token_count,
+                                                   ctx->options.pass_one_threads);
+    }
+    util_mem_set_tag(previous);
+    stats_phase_end(&ctx->stats, STATS_PHASE_PASS_ONE);
+
+    if (ctx->pass_one == NULL_PTR) {
+        if (ctx->options.progress) {
+            printf("ERROR: Semantic analysis failed (out of memory)\n");
+        }
+        return -1;
+    }
+    report_pass_one(ctx);
+    return 0;
+}
+
+/*
+ * 第 2-3 步（流式输入、串行第一遍扫描）：词法分析到行尾且满 SUBAS_STREAM_BATCH 个 Token 后
+ * 把这一批交给第一遍扫描并释放，Token 缓冲区的大小与源文本长度无关（单行超过一批时除外）
+ */
+static int scan_stream(AsmContext* ctx, const SourceInput* input) {
+    u64 lex_start = 0;
+    u64 scan_start = 0;
+    u32 total = 0;
+    int has_eof = 0;
+    int result = 0;
+
+    if (ctx->options.progress) {
+        printf("Step 2-3: Lexical analysis and pass 1 in batches (streaming)...\n");
+    }
+
+    UtilMemTag previous = util_mem_set_tag(UTIL_MEM_LEXER);
+    Lexer* lexer = open_lexer(input);
+    util_mem_set_tag(UTIL_MEM_IR);
+    ctx->pass_one = semantic_pass_one_begin();
+    util_mem_set_tag(previous);
+    if (lexer == NULL_PTR || ctx->pass_one == NULL_PTR) {
+        lexer_destroy(lexer);
+        if (ctx->options.progress) {
+            printf("ERROR: Cannot create lexer\n");
+        }
+        return -1;
+    }
+    lexer_set_line_index(lexer, &ctx->lines);
+
+    while (!has_eof && result == 0) {
+        int at_line_end = 0;
+
+        stats_phase_begin(&ctx->stats, STATS_PHASE_LEX);
+        lex_start = (lex_start != 0) ? lex_start : ctx->stats.start_ns[STATS_PHASE_LEX];
+        previous = util_mem_set_tag(UTIL_MEM_LEXER);
+        while (!has_eof && !(at_line_end && ctx->token_count >= SUBAS_STREAM_BATCH)) {
+            Token tok = lexer_next_token(lexer);
+            has_eof = (tok.type == TOK_EOF);
+            at_line_end = (tok.type == TOK_NEWLINE);
+            if (append_token(ctx, tok) != 0) {
+                result = -1;
+                break;
+            }
+        }
+        util_mem_set_tag(previous);
+        stats_phase_end(&ctx->stats, STATS_PHASE_LEX);
+
+        if (result == 0) {
+            stats_phase_begin(&ctx->stats, STATS_PHASE_PASS_ONE);
+            scan_start = (scan_start != 0) ? scan_start : ctx->stats.start_ns[STATS_PHASE_PASS_ONE];
+            previous = util_mem_set_tag(UTIL_MEM_IR);
+            semantic_pass_one_feed(ctx->pass_one, ctx->tokens, ctx->token_count);
+            util_mem_set_tag(previous);
+            stats_phase_end(&ctx->stats, STATS_PHASE_PASS_ONE);
+        }
+        total += ctx->token_count;
+        release_tokens(ctx);
+    }
+    lexer_destroy(lexer);
+
+    /* 各批的耗时已累加；阶段起点取第一批 */
+    ctx->stats.start_ns[STATS_PHASE_LEX] = lex_start;
+    ctx->stats.start_ns[STATS_PHASE_PASS_ONE] = scan_start;
+    ctx->stats.tokens = total;
+    if (result != 0) {
+        return -1;
+    }
+
+    if (ctx->options.progress) {
+        printf("  Tokens: %u\n", total);
+    }
+    report_pass_one(ctx);
+    return 0;
+}
+
+/*
+ * 第 4 步：第二遍扫描（代码生成）
+ */
+static int run_pass_two(AsmContext* ctx) {
+    u32 code_size = 0;
+    u32 reloc_count = 0;
+
+    if (ctx->options.progress) {
+        printf("Step 4: Code generation (Pass 2)...\n");
+    }
+
+    stats_phase_begin(&ctx->stats, STATS_PHASE_PASS_TWO);
+    UtilMemTag previous = util_mem_set_tag(UTIL_MEM_CODEGEN);
+    ctx->codegen = codegen_pass_two_listed(ctx->pass_one, ctx->options.listener,
+                                           ctx->options.listener_user);
+    util_mem_set_tag(previous);
+    stats_phase_end(&ctx->stats, STATS_PHASE_PASS_TWO);
+    if (ctx->codegen == NULL_PTR) {
+        if (ctx->options.progress) {
+            printf("ERROR: Code generation failed\n");
+        }
+        return -1;
+    }
+
+    (void)codegen_get_code_buffer(ctx->codegen, &code_size);
+    (void)codegen_get_relocation_info(ctx->codegen, &reloc_count);
+    ctx->stats.code_bytes = code_size;
+    ctx->stats.relocations = reloc_count;
+    if (ctx->options.progress) {
+        printf("  Generated code size: %u bytes\n", code_size);
+    }
+
+    if (error_get_count() > 0) {
+        if (ctx->options.progress) {
+            printf("Code generation errors detected! (%u)\n", error_get_count());
+        }
+        return -1;
+    }
+
+    if (ctx->options.progress && ctx->options.verbose) {
+        printf("\n");
+    }
+    return 0;
+}
+
+/*
+ * 第 2-4 步：流水线模式
+ */
+static int run_pipeline(AsmContext* ctx, const SourceInput* input) {
+    PipelineResult result;
+    Lexer* lexer;
+    u32 code_size = 0;
+    u32 reloc_count = 0;
+    int status;
+
+    if (ctx->options.progress) {
+        printf("Step 2-4: Pipelined lexing, pass 1 and code generation...\n");
+    }
+
+    stats_phase_begin(&ctx->stats, STATS_PHASE_PIPELINE);
+    UtilMemTag previous = util_mem_set_tag(UTIL_MEM_LEXER);
+    lexer = open_lexer(input);
+    util_mem_set_tag(previous);
+    status = -1;
+    if (lexer != NULL_PTR) {
+        status = pipeline_assemble_lexer(lexer, &ctx->lines, &result);
+    }
+    stats_phase_end(&ctx->stats, STATS_PHASE_PIPELINE);
+    if (status != 0) {
+        return -1;
+    }
+
+    ctx->pass_one = result.pass_one;
+    ctx->codegen = result.codegen;
+    (void)codegen_get_code_buffer(ctx->codegen, &code_size);
+    (void)codegen_get_relocation_info(ctx->codegen, &reloc_count);
+    ctx->stats.tokens = result.token_count;
+    ctx->stats.instructions = ctx->pass_one->instruction_count;
+    ctx->stats.symbols = symtab_get_symbol_count(ctx->pass_one->symtab);
+    ctx->stats.code_bytes = code_size;
+    ctx->stats.relocations = reloc_count;
+
+    if (ctx->options.progress) {
+        printf("  Tokens: %u\n", result.token_count);
+        printf("  Instructions: %u\n", ctx->pass_one->instruction_count);
+        printf("  Code size: 0x%04X\n", ctx->pass_one->current_address);
+        printf("  Symbols: %u\n", symtab_get_symbol_count(ctx->pass_one->symtab));
+        printf("  Generated code size: %u bytes\n", code_size);
+        if (ctx->options.verbose) {
+            printf("\n");
+        }
+    }
+    return 0;
+}
+
+/*
+ * 输出格式能表示的重定位种类
+ */
+static u32 allowed_relocations(AsmFormat format) {
+    u32 allowed = CODEGEN_RELOC_MASK(RELOC_OFFSET);
+    if (format == SUBAS_FORMAT_EXE || format == SUBAS_FORMAT_OBJ) {
+        allowed |= CODEGEN_RELOC_MASK(RELOC_SEGMENT);
+    }
+    if (format == SUBAS_FORMAT_OBJ) {
+        allowed |= CODEGEN_RELOC_MASK(RELOC_EXTERNAL);
+    }
+    return allowed;
+}
+
+/*
+ * 检查输出格式并填充汇编输出；失败时释放本次结果
+ */
+static int finish_output(AsmContext* ctx, int result, AsmOutput* out) {
+    if (result == 0 && codegen_check_relocations(ctx->codegen, allowed_relocations(ctx->options.format)) != 0) {
+        result = -1;
+    }
+    if (result == 0 && error_get_count() > 0) {
+        result = -1;
+    }
+
+    if (result == 0) {
+        out->code = codegen_get_code_buffer(ctx->codegen, &out->size);
+        out->segment_fixups = ctx->codegen->segment_fixups;
+        out->segment_fixup_count = ctx->codegen->segment_fixup_count;
+        out->relocations = codegen_get_relocation_info(ctx->codegen, &out->relocation_count);
+        out->instruction_offsets = codegen_get_instruction_offsets(ctx->codegen);
+    } else {
+        release_results(ctx);
+    }
+    return result;
+}
+
+/* ========================================================================= */
+/* API 函数实现 */
+/* ========================================================================= */
+
+void subas_options_init(AsmOptions* options) {
+    options->pass_one_threads = 1;
+    options->pipeline = 0;
+    options->progress = 0;
+    options->verbose = 0;
+    options->echo_diagnostics = 0;
+    options->max_errors = 0;
+    options->listener = NULL_PTR;
+    options->listener_user = NULL_PTR;
+    options->format = SUBAS_FORMAT_COM;
+}
+
+AsmContext* subas_context_create(const AsmOptions* options) {
+    AsmContext* ctx = (AsmContext*)util_malloc(sizeof(AsmContext));
+    if (ctx == NULL_PTR) {
+        return NULL_PTR;
+    }
+
+    if (options != NULL_PTR) {
+        ctx->options = *options;
+    } else {
+        subas_options_init(&ctx->options);
+    }
+
+    ctx->token_capacity = SUBAS_INITIAL_TOKENS;
+    ctx->tokens = (Token*)util_malloc(sizeof(Token) * ctx->token_capacity);
+    if (ctx->tokens == NULL_PTR) {
+        util_free(ctx);
+        return NULL_PTR;
+    }
+
+    error_context_init(&ctx->diagnostics, ctx->options.echo_diagnostics, 1);
+    ctx->diagnostics.limit = ctx->options.max_errors;
+    line_index_init(&ctx->lines);
+    stats_init(&ctx->stats);
+    ctx->token_count = 0;
+    ctx->pass_one = NULL_PTR;
+    ctx->codegen = NULL_PTR;
+    return ctx;
+}
+
+/*
+ * subas_assemble 与 subas_assemble_stream 的公共实现
+ */
+static int assemble_input(AsmContext* ctx, const SourceInput* input, AsmOutput* out) {
+    ErrorContext* previous;
+    int result;
+
+    out->code = NULL_PTR;
+    out->size = 0;
+    out->segment_fixups = NULL_PTR;
+    out->segment_fixup_count = 0;
+    out->relocations = NULL_PTR;
+    out->relocation_count = 0;
+    out->instruction_offsets = NULL_PTR;
+
+    previous = error_bind(&ctx->diagnostics);
+    error_init();
+    release_results(ctx);
+    line_index_reset(&ctx->lines);
+    stats_init(&ctx->stats);
+
+    /* ===== 第 1 步：初始化表驱动系统 ===== */
+    if (ctx->options.progress) {
+        printf("Step 1: Initializing tables...\n");
+    }
+    stats_phase_begin(&ctx->stats, STATS_PHASE_TABLES);
+    tables_init();
+    stats_phase_end(&ctx->stats, STATS_PHASE_TABLES);
+    if (ctx->options.progress && ctx->options.verbose) {
+        printf("  Instructions loaded: %u\n\n", tables_get_instruction_count());
+    }
+
+    /* ===== 第 2-4 步 ===== */
+    /* 流水线的编码线程不回调 listener，需要逐条回调时串行执行 */
+    if (ctx->options.pipeline && ctx->options.listener == NULL_PTR) {
+        result = run_pipeline(ctx, input);
+    } else {
+        /* 并行第一遍扫描需要完整的 Token 流 */
+        if (input->read != NULL_PTR && ctx->options.pass_one_threads == 1) {
+            result = scan_stream(ctx, input);
+        } else {
+            result = lex_source(ctx, input);
+            if (result == 0) {
+                result = run_pass_one(ctx);
+            }
+        }
+        if (result == 0) {
+            result = run_pass_two(ctx);
+        }
+        release_tokens(ctx);
+    }
+    result = finish_output(ctx, result, out);
+
+    /* 缓存的诊断连同源代码片段一次性输出（流式输入不保留源文本，不附片段） */
+    if (input->read == NULL_PTR) {
+        error_set_source(input->text, input->len, ctx->lines.starts, ctx->lines.count);
+    }
+    error_flush();
+    error_bind(previous);
+    return result;
+}
+
+int subas_assemble(AsmContext* ctx, const char* src, u32 len, AsmOutput* out) {
+    SourceInput input;
+
+    if (ctx == NULL_PTR || src == NULL_PTR || out == NULL_PTR) {
+        return -1;
+    }
+
+    input.text = src;
+    input.len = len;
+    input.read = NULL_PTR;
+    input.user = NULL_PTR;
+    return assemble_input(ctx, &input, out);
+}
+
+int subas_assemble_stream(AsmContext* ctx, LexerReadFunc read, void* user, AsmOutput* out) {
+    SourceInput input;
+
+    if (ctx == NULL_PTR || read == NULL_PTR || out == NULL_PTR) {
+        return -1;
+    }
+
+    input.text = NULL_PTR;
+    input.len = 0;
+    input.read = read;
+    input.user = user;
+    return assemble_input(ctx, &input, out);
+}
+
+/*
+ * subas_assemble_ir 与 subas_assemble_ir_data 的公共实现（path 为 NULL 时使用 data）
+ */
+static int assemble_ir(AsmContext* ctx, const char* path, const u8* data, u32 size,
+                       AsmOutput* out) {
+    ErrorContext* previous;
+    IrFile ir;
+    int loaded;
+    int result = -1;
+
+    out->code = NULL_PTR;
+    out->size = 0;
+    out->segment_fixups = NULL_PTR;
+    out->segment_fixup_count = 0;
+    out->relocations = NULL_PTR;
+    out->relocation_count = 0;
+    out->instruction_offsets = NULL_PTR;
+
+    previous = error_bind(&ctx->diagnostics);
+    error_init();
+    release_results(ctx);
+    line_index_reset(&ctx->lines);
+    stats_init(&ctx->stats);
+
+    /* 文件先映射；内存中的 IR 原地校验 */
+    if (path != NULL_PTR) {
+        loaded = irfile_map(path, &ir);
+    } else {
+        loaded = irfile_view(data, size, &ir);
+    }
+    if (loaded != 0) {
+        error_bind(previous);
+        return 1;
+    }
+
+    if (ctx->options.progress) {
+        printf("Step 1: Initializing tables...\n");
+    }
+    stats_phase_begin(&ctx->stats, STATS_PHASE_TABLES);
+    tables_init();
+    stats_phase_end(&ctx->stats, STATS_PHASE_TABLES);
+
+    /* ===== 第 2-3 步：由 IR 得到第一遍扫描结果 ===== */
+    if (ctx->options.progress) {
+        printf("Step 2-3: Loading pass 1 result from IR file...\n");
+    }
+    stats_phase_begin(&ctx->stats, STATS_PHASE_PASS_ONE);
+    UtilMemTag tag = util_mem_set_tag(UTIL_MEM_IR);
+    ctx->pass_one = irfile_load(&ir);
+    util_mem_set_tag(tag);
+    /* 加载已把指令解码为副本，映射不再需要 */
+    if (path != NULL_PTR) {
+        irfile_unmap(&ir);
+    }
+    stats_phase_end(&ctx->stats, STATS_PHASE_PASS_ONE);
+
+    if (ctx->pass_one == NULL_PTR) {
+        error_report(0, ERR_SYS_OUT_OF_MEM, "Cannot load IR file");
+    } else {
+        ctx->stats.instructions = ctx->pass_one->instruction_count;
+        ctx->stats.symbols = symtab_get_symbol_count(ctx->pass_one->symtab);
+        if (ctx->options.progress) {
+            printf("  Instructions: %u\n", ctx->pass_one->instruction_count);
+            printf("  Symbols: %u\n", symtab_get_symbol_count(ctx->pass_one->symtab));
+        }
+        result = run_pass_two(ctx);
+    }
+    result = finish_output(ctx, result, out);
+
+    error_flush();
+    error_bind(previous);
+    return result;
+}
+
+int subas_assemble_ir(AsmContext* ctx, const char* path, AsmOutput* out) {
+    if (ctx == NULL_PTR || path == NULL_PTR || out == NULL_PTR) {
+        return -1;
+    }
+    return assemble_ir(ctx, path, NULL_PTR, 0, out);
+}
+
+int subas_assemble_ir_data(AsmContext* ctx, const u8* data, u32 size, AsmOutput* out) {
+    if (ctx == NULL_PTR || data == NULL_PTR || out == NULL_PTR) {
+        return -1;
+    }
+    return assemble_ir(ctx, NULL_PTR, data, size, out);
+}
+
+const PassOne* subas_get_pass_one(const AsmContext* ctx) {
+    if (ctx == NULL_PTR) return NULL_PTR;
+    return ctx->pass_one;
+}
+
+u32 subas_get_error_count(const AsmContext* ctx) {
+    if (ctx == NULL_PTR) return 0;
+    return ctx->diagnostics.count;
+}
+
+const ErrorRecord* subas_get_diagnostics(const AsmContext* ctx, u32* out_count) {
+    if (ctx == NULL_PTR) {
+        *out_count = 0;
+        return NULL_PTR;
+    }
+    *out_count = ctx->diagnostics.log.count;
+    return ctx->diagnostics.log.records;
+}
+
+const AsmStats* subas_get_stats(const AsmContext* ctx) {
+    return &ctx->stats;
+}
+
+void subas_take_diagnostics(AsmContext* ctx, ErrorBuffer* out) {
+    *out = ctx->diagnostics.log;
+    error_buffer_init(&ctx->diagnostics.log);
+}
+
+void subas_set_diagnostic_sink(AsmContext* ctx, ErrorSink sink, void* user) {
+    if (ctx == NULL_PTR) return;
+    ctx->diagnostics.sink = sink;
+    ctx->diagnostics.sink_user = user;
+}
+
+void subas_context_destroy(AsmContext* ctx) {
+    if (ctx == NULL_PTR) return;
+
+    release_results(ctx);
+    release_tokens(ctx);
+    util_free(ctx->tokens);
+    error_context_dispose(&ctx->diagnostics);
+    line_index_dispose(&ctx->lines);
+    util_free(ctx);
+}
@@ -8,12 +8,322 @@
  *  - 每个符号的详细信息（名称、类型、地址等）动态分配
  *  - 符号表生命周期管理由调用者负责
  *  - 内存释放时需遍历所有符号并释放各自的 SymbolInfo 结构
+ *  - 两个辅助索引与哈希表同步维护，均引用同一份 SymbolInfo：
+ *      · 路径压缩基数树：边标签为名字片段，子节点按首字节升序排列，
+ *        先序遍历即为按字节序排列的名字；插入时拆分边，删除时合并单子节点
+ *      · 地址数组：按地址非降序排列，新符号插在同地址符号之后；
+ *        Pass 1 按地址递增登记，插入退化为尾部追加
  * ============================================================================
  */
 
 #include "../include/symtab.h"
 #include "../include/utils.h"
 
+/* 基数树节点 */
+typedef struct SymbolRadixNode {
+    char* edge;                         /* 从父节点到本节点的边标签 */
+    u32 edge_len;                       /* 边标签长度（仅根节点为 0） */
+    SymbolInfo* symbol;                 /* 名字恰好终止于本节点的符号 */
+    struct SymbolRadixNode** children;  /* 子节点，按边首字节升序 */
+    u32 child_count;
+    u32 child_capacity;
+} SymbolRadixNode;
+
+static SymbolRadixNode* radix_node_create(const char* edge, u32 edge_len);
+static void radix_node_destroy(SymbolRadixNode* node);
+static u32 radix_child_position(const SymbolRadixNode* node, u8 first, int* found);
+static int radix_add_child(SymbolRadixNode* node, u32 position, SymbolRadixNode* child);
+static int radix_insert(SymbolRadixNode* root, const char* name, SymbolInfo* info);
+static void radix_remove(SymbolRadixNode* node, const char* rest);
+static int radix_walk(const SymbolRadixNode* node, SymbolVisitFunc visit, void* user, u32* visited);
+static u32 address_upper_bound(const SymbolTable* symtab, u32 address);
+static int address_index_insert(SymbolTable* symtab, SymbolInfo* info);
+static void address_index_remove(SymbolTable* symtab, const SymbolInfo* info);
+static int index_symbol(SymbolTable* symtab, SymbolInfo* info);
+
+/* ============================================================================
+ * 基数树（名字索引）
+ * ============================================================================ */
+
+static SymbolRadixNode* radix_node_create(const char* edge, u32 edge_len) {
+    SymbolRadixNode* node = (SymbolRadixNode*)util_malloc(sizeof(SymbolRadixNode));
+    if (node == NULL_PTR) {
+        return NULL_PTR;
+    }
+
+    node->edge = (char*)util_malloc(edge_len + 1);
+    if (node->edge == NULL_PTR) {
+        util_free(node);
+        return NULL_PTR;
+    }
+    for (u32 i = 0; i < edge_len; i++) {
+        node->edge[i] = edge[i];
+    }
+    node->edge[edge_len] = '\0';
+    node->edge_len = edge_len;
+    node->symbol = NULL_PTR;
+    node->children = NULL_PTR;
+    node->child_count = 0;
+    node->child_capacity = 0;
+    return node;
+}
+
+static void radix_node_destroy(SymbolRadixNode* node) {
+    if (node == NULL_PTR) return;
+
+    for (u32 i = 0; i < node->child_count; i++) {
+        radix_node_destroy(node->children[i]);
+    }
+    util_free(node->children);
+    util_free(node->edge);
+    util_free(node);
+}
+
+/* 二分查找首字节为 first 的子节点；未找到时返回应插入的位置 */
+static u32 radix_child_position(const SymbolRadixNode* node, u8 first, int* found) {
+    u32 lo = 0;
+    u32 hi = node->child_count;
+
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        u8 key = (u8)node->children[mid]->edge[0];
+        if (key == first) {
+            *found = 1;
+            return mid;
+        }
+        if (key < first) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *found = 0;
+    return lo;
+}
+
+static int radix_add_child(SymbolRadixNode* node, u32 position, SymbolRadixNode* child) {
+    if (node->child_count == node->child_capacity) {
+        u32 capacity = (node->child_capacity == 0) ? 2 : node->child_capacity * 2;
+        SymbolRadixNode** grown = (SymbolRadixNode**)util_malloc(capacity * (u32)sizeof(SymbolRadixNode*));
+        if (grown == NULL_PTR) {
+            return -1;
+        }
+        for (u32 i = 0; i < node->child_count; i++) {
+            grown[i] = node->children[i];
+        }
+        util_free(node->children);
+        node->children = grown;
+        node->child_capacity = capacity;
+    }
+
+    for (u32 i = node->child_count; i > position; i--) {
+        node->children[i] = node->children[i - 1];
+    }
+    node->children[position] = child;
+    node->child_count++;
+    return 0;
+}
+
+static int radix_insert(SymbolRadixNode* root, const char* name, SymbolInfo* info) {
+    SymbolRadixNode* node = root;
+    const char* rest = name;
+
+    while (*rest != '\0') {
+        int found;
+        u32 position = radix_child_position(node, (u8)rest[0], &found);
+
+        if (!found) {
+            SymbolRadixNode* leaf = radix_node_create(rest, util_strlen(rest));
+            if (leaf == NULL_PTR) {
+                return -1;
+            }
+            leaf->symbol = info;
+            if (radix_add_child(node, position, leaf) != 0) {
+                radix_node_destroy(leaf);
+                return -1;
+            }
+            return 0;
+        }
+
+        SymbolRadixNode* child = node->children[position];
+        u32 common = 1;
+        while (common < child->edge_len && rest[common] == child->edge[common]) {
+            common++;
+        }
+
+        if (common < child->edge_len) {
+            /* 拆分边：新建中间节点承接公共前缀，原子节点保留剩余部分 */
+            SymbolRadixNode* middle = radix_node_create(child->edge, common);
+            char* suffix = (char*)util_malloc(child->edge_len - common + 1);
+            if (middle == NULL_PTR || suffix == NULL_PTR ||
+                radix_add_child(middle, 0, child) != 0) {
+                radix_node_destroy(middle);
+                util_free(suffix);
+                return -1;
+            }
+            for (u32 i = common; i <= child->edge_len; i++) {
+                suffix[i - common] = child->edge[i];
+            }
+            util_free(child->edge);
+            child->edge = suffix;
+            child->edge_len -= common;
+            node->children[position] = middle;
+            child = middle;
+        }
+
+        node = child;
+        rest += common;
+    }
+
+    node->symbol = info;
+    return 0;
+}
+
+/* 沿 rest 摘除符号，回溯时删除空叶并把无符号的单子节点并入其子节点 */
+static void radix_remove(SymbolRadixNode* node, const char* rest) {
+    if (*rest == '\0') {
+        node->symbol = NULL_PTR;
+        return;
+    }
+
+    int found;
+    u32 position = radix_child_position(node, (u8)rest[0], &found);
+    if (!found) return;
+
+    SymbolRadixNode* child = node->children[position];
+    for (u32 i = 0; i < child->edge_len; i++) {
+        if (rest[i] != child->edge[i]) return;
+    }
+    radix_remove(child, rest + child->edge_len);
+
+    if (child->symbol != NULL_PTR || child->child_count > 1) {
+        return;
+    }
+
+    if (child->child_count == 0) {
+        for (u32 i = position; i + 1 < node->child_count; i++) {
+            node->children[i] = node->children[i + 1];
+        }
+        node->child_count--;
+        radix_node_destroy(child);
+        return;
+    }
+
+    /* 单子节点：孙节点继承拼接后的边，取代 child */
+    SymbolRadixNode* grandchild = child->children[0];
+    u32 merged_len = child->edge_len + grandchild->edge_len;
+    char* merged = (char*)util_malloc(merged_len + 1);
+    if (merged == NULL_PTR) {
+        return;  /* 合并失败不影响正确性，仅保留一个冗余节点 */
+    }
+    for (u32 i = 0; i < child->edge_len; i++) {
+        merged[i] = child->edge[i];
+    }
+    for (u32 i = 0; i <= grandchild->edge_len; i++) {
+        merged[child->edge_len + i] = grandchild->edge[i];
+    }
+    util_free(grandchild->edge);
+    grandchild->edge = merged;
+    grandchild->edge_len = merged_len;
+    node->children[position] = grandchild;
+    child->child_count = 0;
+    radix_node_destroy(child);
+}
+
+/* 先序遍历：节点自身的符号先于子树，子节点按首字节升序 */
+static int radix_walk(const SymbolRadixNode* node, SymbolVisitFunc visit, void* user, u32* visited) {
+    if (node->symbol != NULL_PTR) {
+        (*visited)++;
+        if (visit != NULL_PTR && visit(user, node->symbol) != 0) {
+            return 1;
+        }
+    }
+    for (u32 i = 0; i < node->child_count; i++) {
+        if (radix_walk(node->children[i], visit, user, visited) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * 地址索引
+ * ============================================================================ */
+
+/* 第一个地址大于 address 的位置 */
+static u32 address_upper_bound(const SymbolTable* symtab, u32 address) {
+    u32 lo = 0;
+    u32 hi = symtab->address_count;
+
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (symtab->by_address[mid]->address <= address) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static int address_index_insert(SymbolTable* symtab, SymbolInfo* info) {
+    if (symtab->address_count == symtab->address_capacity) {
+        u32 capacity = (symtab->address_capacity == 0) ? 64 : symtab->address_capacity * 2;
+        SymbolInfo** grown = (SymbolInfo**)util_malloc(capacity * (u32)sizeof(SymbolInfo*));
+        if (grown == NULL_PTR) {
+            return -1;
+        }
+        for (u32 i = 0; i < symtab->address_count; i++) {
+            grown[i] = symtab->by_address[i];
+        }
+        util_free(symtab->by_address);
+        symtab->by_address = grown;
+        symtab->address_capacity = capacity;
+    }
+
+    u32 position = address_upper_bound(symtab, info->address);
+    for (u32 i = symtab->address_count; i > position; i--) {
+        symtab->by_address[i] = symtab->by_address[i - 1];
+    }
+    symtab->by_address[position] = info;
+    symtab->address_count++;
+    return 0;
+}
+
+/* 在同地址的符号段内定位 info 并移除 */
+static void address_index_remove(SymbolTable* symtab, const SymbolInfo* info) {
+    u32 i = address_upper_bound(symtab, info->address);
+
+    while (i > 0 && symtab->by_address[i - 1]->address == info->address) {
+        i--;
+        if (symtab->by_address[i] == info) {
+            for (u32 k = i; k + 1 < symtab->address_count; k++) {
+                symtab->by_address[k] = symtab->by_address[k + 1];
+            }
+            symtab->address_count--;
+            return;
+        }
+    }
+}
+
+/* 把新符号登记到哈希表与两个辅助索引；失败时撤销已完成的部分 */
+static int index_symbol(SymbolTable* symtab, SymbolInfo* info) {
+    UtilMemTag previous = util_mem_set_tag(UTIL_MEM_SYMTAB);
+    int result = -1;
+
+    if (radix_insert(symtab->name_index, info->name, info) == 0) {
+        if (address_index_insert(symtab, info) == 0) {
+            util_ht_insert(symtab->symbols, info->name, (void*)info);
+            symtab->total_symbols++;
+            result = 0;
+        } else {
+            radix_remove(symtab->name_index, info->name);
+        }
+    }
+    util_mem_set_tag(previous);
+    return result;
+}
+
 /* ============================================================================
  * 符号表创建和销毁
  * ============================================================================ */
@@ -25,20 +335,31 @@ SymbolTable* symtab_create(u32 initial_capacity) {
         initial_capacity = 256;  /* 默认大小 */
     }
 
+    UtilMemTag previous = util_mem_set_tag(UTIL_MEM_SYMTAB);
     symtab = (SymbolTable*)util_malloc(sizeof(SymbolTable));
     if (symtab == NULL_PTR) {
+        util_mem_set_tag(previous);
         return NULL_PTR;
     }
 
-    /* 创建哈希表 */
+    /* 创建哈希表与名字索引的根节点 */
     symtab->symbols = util_ht_create(initial_capacity);
-    if (symtab->symbols == NULL_PTR) {
+    symtab->name_index = radix_node_create("", 0);
+    util_mem_set_tag(previous);
+    if (symtab->symbols == NULL_PTR || symtab->name_index == NULL_PTR) {
+        if (symtab->symbols != NULL_PTR) {
+            util_ht_destroy(symtab->symbols);
+        }
+        radix_node_destroy(symtab->name_index);
         util_free(symtab);
         return NULL_PTR;
     }
 
     symtab->total_symbols = 0;
     symtab->next_address = 0;
+    symtab->by_address = NULL_PTR;
+    symtab->address_count = 0;
+    symtab->address_capacity = 0;
 
     return symtab;
 }
@@ -59,6 +380,9 @@ void symtab_destroy(SymbolTable* symtab) {
         util_ht_destroy(symtab->symbols);
     }
 
+    /* 辅助索引只引用 SymbolInfo，释放自身结构即可 */
+    radix_node_destroy(symtab->name_index);
+    util_free(symtab->by_address);
     util_free(symtab);
 }
 
@@ -79,9 +403,11 @@ int symtab_insert(SymbolTable* symtab, const char* name, SymbolType type, u32 ad
         return 1;  /* 符号已存在，返回 1 表示重复定义 */
     }
 
-    /* 分配 SymbolInfo 结构体 */
+    /* 分配 SymbolInfo 结构体（计入符号表的内存占用） */
+    UtilMemTag previous = util_mem_set_tag(UTIL_MEM_SYMTAB);
     info = (SymbolInfo*)util_malloc(sizeof(SymbolInfo));
     if (info == NULL_PTR) {
+        util_mem_set_tag(previous);
         return -1;
     }
 
@@ -89,6 +415,7 @@ int symtab_insert(SymbolTable* symtab, const char* name, SymbolType type, u32 ad
     info->name = util_strdup(name);
     if (info->name == NULL_PTR) {
         util_free(info);
+        util_mem_set_tag(previous);
         return -1;
     }
 
@@ -98,15 +425,50 @@ int symtab_insert(SymbolTable* symtab, const char* name, SymbolType type, u32 ad
     info->line_defined = line;
     info->is_defined = 1;
     info->extra_info = NULL_PTR;
+    util_mem_set_tag(previous);
 
-    /* 插入哈希表 */
-    util_ht_insert(symtab->symbols, name, (void*)info);
-
-    symtab->total_symbols++;
+    /* 插入哈希表及辅助索引 */
+    if (index_symbol(symtab, info) != 0) {
+        util_free(info->name);
+        util_free(info);
+        return -1;
+    }
 
     return 0;  /* 成功 */
 }
 
+int symtab_adopt(SymbolTable* symtab, SymbolInfo* info) {
+    if (symtab == NULL_PTR || info == NULL_PTR || info->name == NULL_PTR) {
+        return -1;
+    }
+
+    if (util_ht_lookup(symtab->symbols, info->name) != NULL_PTR) {
+        return 1;  /* 重复定义，由调用者决定如何处理 info */
+    }
+
+    return index_symbol(symtab, info);
+}
+
+int symtab_remove(SymbolTable* symtab, const char* name) {
+    SymbolInfo* info;
+
+    if (symtab == NULL_PTR || name == NULL_PTR) {
+        return -1;
+    }
+
+    info = (SymbolInfo*)util_ht_remove(symtab->symbols, name);
+    if (info == NULL_PTR) {
+        return -1;  /* 符号不存在 */
+    }
+
+    radix_remove(symtab->name_index, info->name);
+    address_index_remove(symtab, info);
+    util_free(info->name);
+    util_free(info);
+    symtab->total_symbols--;
+    return 0;
+}
+
 SymbolInfo* symtab_lookup(SymbolTable* symtab, const char* name) {
     if (symtab == NULL_PTR || name == NULL_PTR) {
         return NULL_PTR;
@@ -127,10 +489,32 @@ int symtab_update_address(SymbolTable* symtab, const char* name, u32 new_address
         return -1;  /* 符号不存在 */
     }
 
+    /* 先按旧地址摘除再按新地址插回，保持地址索引有序 */
+    address_index_remove(symtab, info);
     info->address = new_address;
+    if (address_index_insert(symtab, info) != 0) {
+        return -1;
+    }
     return 0;
 }
 
+void symtab_reindex_addresses(SymbolTable* symtab) {
+    if (symtab == NULL_PTR) {
+        return;
+    }
+
+    /* 稳定的插入排序：地址按源代码顺序改写时索引几乎有序，只需线性时间 */
+    for (u32 i = 1; i < symtab->address_count; i++) {
+        SymbolInfo* info = symtab->by_address[i];
+        u32 k = i;
+        while (k > 0 && symtab->by_address[k - 1]->address > info->address) {
+            symtab->by_address[k] = symtab->by_address[k - 1];
+            k--;
+        }
+        symtab->by_address[k] = info;
+    }
+}
+
 int symtab_mark_defined(SymbolTable* symtab, const char* name) {
     SymbolInfo* info;
 
@@ -147,6 +531,76 @@ int symtab_mark_defined(SymbolTable* symtab, const char* name) {
     return 0;
 }
 
+/* ============================================================================
+ * 有序查询
+ * ============================================================================ */
+
+u32 symtab_iterate_prefix(SymbolTable* symtab, const char* prefix, SymbolVisitFunc visit, void* user) {
+    u32 visited = 0;
+
+    if (symtab == NULL_PTR) {
+        return 0;
+    }
+    if (prefix == NULL_PTR) {
+        prefix = "";
+    }
+
+    /* 沿前缀下行：前缀可能止于某条边的中间，此时整棵子树都匹配 */
+    const SymbolRadixNode* node = symtab->name_index;
+    const char* rest = prefix;
+    while (*rest != '\0') {
+        int found;
+        u32 position = radix_child_position(node, (u8)rest[0], &found);
+        if (!found) {
+            return 0;
+        }
+
+        const SymbolRadixNode* child = node->children[position];
+        u32 i = 0;
+        while (i < child->edge_len && rest[i] != '\0') {
+            if (rest[i] != child->edge[i]) {
+                return 0;
+            }
+            i++;
+        }
+        node = child;
+        rest += i;
+    }
+
+    (void)radix_walk(node, visit, user, &visited);
+    return visited;
+}
+
+SymbolInfo* symtab_find_by_address(SymbolTable* symtab, u32 address) {
+    if (symtab == NULL_PTR) {
+        return NULL_PTR;
+    }
+
+    u32 position = address_upper_bound(symtab, address);
+    if (position == 0) {
+        return NULL_PTR;
+    }
+
+    /* 回退到同地址符号段的开头 */
+    u32 nearest = symtab->by_address[position - 1]->address;
+    position--;
+    while (position > 0 && symtab->by_address[position - 1]->address == nearest) {
+        position--;
+    }
+    return symtab->by_address[position];
+}
+
+SymbolInfo* const* symtab_get_by_address(SymbolTable* symtab, u32* count) {
+    if (symtab == NULL_PTR) {
+        if (count != NULL_PTR) *count = 0;
+        return NULL_PTR;
+    }
+    if (count != NULL_PTR) {
+        *count = symtab->address_count;
+    }
+    return symtab->by_address;
+}
+
 u32 symtab_get_symbol_count(SymbolTable* symtab) {
     if (symtab == NULL_PTR) {
         return 0;
@@ -15,6 +15,7 @@
 
 #include "../include/tables.h"
 #include "../include/utils.h"
+#include "../include/counters.h"
 
 /* ============================================================================
  * 指令定义表（常量表驱动）
@@ -302,6 +303,22 @@ static const InstructionInfo g_instruction_table[] = {
         .is_pseudo = 1,
         .description = "End assembly"
     },
+    {
+        .mnemonic = "PUBLIC",
+        .type = PSEUDO_PUBLIC,
+        .opcode = 0x00,
+        .operand_count = 1,
+        .is_pseudo = 1,
+        .description = "Export symbol to other modules"
+    },
+    {
+        .mnemonic = "EXTRN",
+        .type = PSEUDO_EXTRN,
+        .opcode = 0x00,
+        .operand_count = 1,
+        .is_pseudo = 1,
+        .description = "Import symbol from another module"
+    },
 };
 
 /* 表大小：用于边界检查和遍历 */
@@ -350,13 +367,18 @@ const InstructionInfo* tables_lookup_instruction(const char* mnemonic) {
         return NULL_PTR;
     }
 
+    COUNTER_ADD(COUNTER_INSN_LOOKUPS, 1);
+
     /* 线性查找：比较不区分大小写 */
     for (u32 i = 0; i < g_instruction_count; i++) {
         if (strcasecmp_simple(g_instruction_table[i].mnemonic, mnemonic) == 0) {
+            COUNTER_ADD(COUNTER_INSN_COMPARES, i + 1);
             return &g_instruction_table[i];
         }
     }
 
+    COUNTER_ADD(COUNTER_INSN_COMPARES, g_instruction_count);
+    COUNTER_ADD(COUNTER_INSN_MISSES, 1);
     return NULL_PTR;
 }
 
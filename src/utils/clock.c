@@ -0,0 +1,17 @@
+﻿/*
+ * ============================================================================
+ * 文件名: clock.c
+ * 描述  : 计时接口实现文件。
+ * 使用 POSIX 单调时钟，不受系统时间调整影响。
+ * ============================================================================
+ */
+
+#include "../../include/utils.h"
+#include <time.h>
+
+u64 util_time_ns(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (u64)now.tv_sec * 1000000000ULL + (u64)now.tv_nsec;
+}
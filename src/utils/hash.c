@@ -7,6 +7,7 @@
  */
 
 #include "../../include/utils.h"
+#include "../../include/counters.h"
 
 /*
  * 内部辅助函数: DJB2 字符串哈希算法
@@ -21,6 +22,63 @@ static u32 hash_string_djb2(const char* str) {
     return hash;
 }
 
+/* SHA-256 轮常量（前 64 个素数立方根的小数部分） */
+static const u32 sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define SHA256_ROTR(x, n)   (((x) >> (n)) | ((x) << (32 - (n))))
+
+/*
+ * 内部辅助函数: 压缩一个 64 字节块
+ */
+static void sha256_block(UtilSha256* sha, const u8* block) {
+    u32 w[64];
+    u32 v[8];
+    u32 i;
+
+    for (i = 0; i < 16; i++) {
+        w[i] = ((u32)block[i * 4] << 24) | ((u32)block[i * 4 + 1] << 16) |
+               ((u32)block[i * 4 + 2] << 8) | (u32)block[i * 4 + 3];
+    }
+    for (i = 16; i < 64; i++) {
+        u32 s0 = SHA256_ROTR(w[i - 15], 7) ^ SHA256_ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        u32 s1 = SHA256_ROTR(w[i - 2], 17) ^ SHA256_ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    for (i = 0; i < 8; i++) {
+        v[i] = sha->state[i];
+    }
+    for (i = 0; i < 64; i++) {
+        u32 s1 = SHA256_ROTR(v[4], 6) ^ SHA256_ROTR(v[4], 11) ^ SHA256_ROTR(v[4], 25);
+        u32 ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+        u32 t1 = v[7] + s1 + ch + sha256_k[i] + w[i];
+        u32 s0 = SHA256_ROTR(v[0], 2) ^ SHA256_ROTR(v[0], 13) ^ SHA256_ROTR(v[0], 22);
+        u32 maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+        u32 t2 = s0 + maj;
+
+        v[7] = v[6];
+        v[6] = v[5];
+        v[5] = v[4];
+        v[4] = v[3] + t1;
+        v[3] = v[2];
+        v[2] = v[1];
+        v[1] = v[0];
+        v[0] = t1 + t2;
+    }
+    for (i = 0; i < 8; i++) {
+        sha->state[i] += v[i];
+    }
+}
+
 UtilHashTable* util_ht_create(u32 bucket_count) {
     UtilHashTable* table;
     u32 i;
@@ -54,10 +112,15 @@ void util_ht_insert(UtilHashTable* table, const char* key, void* value) {
     hash_val = hash_string_djb2(key);
     index = hash_val % table->bucket_count;
 
+    COUNTER_ADD(COUNTER_HT_INSERTS, 1);
+    COUNTER_ONLY(u32 chain = 0;)
+
     /* 1. 检查键是否已经存在，如果存在则更新 value */
     node = table->buckets[index];
     while (node != NULL_PTR) {
+        COUNTER_ONLY(chain++;)
         if (util_strcmp(node->key, key) == 0) {
+            COUNTER_ADD(COUNTER_HT_INSERT_PROBES, chain);
             node->value = value;
             return;
         }
@@ -72,6 +135,9 @@ void util_ht_insert(UtilHashTable* table, const char* key, void* value) {
     table->buckets[index] = node;
 
     table->element_count++;
+    COUNTER_ADD(COUNTER_HT_INSERT_PROBES, chain);
+    COUNTER_MAX(COUNTER_HT_MAX_CHAIN, chain + 1);
+    COUNTER_MAX(COUNTER_HT_MAX_LOAD, (u64)table->element_count * 1000 / table->bucket_count);
 }
 
 void* util_ht_lookup(UtilHashTable* table, const char* key) {
@@ -84,14 +150,43 @@ void* util_ht_lookup(UtilHashTable* table, const char* key) {
     hash_val = hash_string_djb2(key);
     index = hash_val % table->bucket_count;
 
+    COUNTER_ADD(COUNTER_HT_LOOKUPS, 1);
     node = table->buckets[index];
     while (node != NULL_PTR) {
+        COUNTER_ADD(COUNTER_HT_LOOKUP_PROBES, 1);
         if (util_strcmp(node->key, key) == 0) {
             return node->value;
         }
         node = node->next;
     }
 
+    COUNTER_ADD(COUNTER_HT_LOOKUP_MISSES, 1);
+    return NULL_PTR; /* 未找到 */
+}
+
+void* util_ht_remove(UtilHashTable* table, const char* key) {
+    u32 index;
+    UtilHashNode** link;
+
+    if (table == NULL_PTR || key == NULL_PTR) return NULL_PTR;
+
+    index = hash_string_djb2(key) % table->bucket_count;
+
+    /* 沿链表查找，通过前驱的 next 指针摘除节点 */
+    link = &table->buckets[index];
+    while (*link != NULL_PTR) {
+        UtilHashNode* node = *link;
+        if (util_strcmp(node->key, key) == 0) {
+            void* value = node->value;
+            *link = node->next;
+            util_free(node->key);
+            util_free(node);
+            table->element_count--;
+            return value;
+        }
+        link = &node->next;
+    }
+
     return NULL_PTR; /* 未找到 */
 }
 
@@ -117,4 +212,70 @@ void util_ht_destroy(UtilHashTable* table) {
     util_free(table);
 }
 
+u64 util_hash64(const void* data, u32 size, u64 seed) {
+    const u8* bytes = (const u8*)data;
+    u64 hash = seed;
+    u32 i;
 
+    for (i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;   /* FNV-1a 64 位素数 */
+    }
+    return hash;
+}
+
+void util_sha256_init(UtilSha256* sha) {
+    sha->state[0] = 0x6a09e667;
+    sha->state[1] = 0xbb67ae85;
+    sha->state[2] = 0x3c6ef372;
+    sha->state[3] = 0xa54ff53a;
+    sha->state[4] = 0x510e527f;
+    sha->state[5] = 0x9b05688c;
+    sha->state[6] = 0x1f83d9ab;
+    sha->state[7] = 0x5be0cd19;
+    sha->length = 0;
+    sha->used = 0;
+}
+
+void util_sha256_update(UtilSha256* sha, const void* data, u32 size) {
+    const u8* bytes = (const u8*)data;
+    u32 i;
+
+    sha->length += size;
+    for (i = 0; i < size; i++) {
+        sha->block[sha->used++] = bytes[i];
+        if (sha->used == sizeof(sha->block)) {
+            sha256_block(sha, sha->block);
+            sha->used = 0;
+        }
+    }
+}
+
+void util_sha256_final(UtilSha256* sha, u8 digest[UTIL_SHA256_SIZE]) {
+    u64 bits = sha->length * 8;
+    u32 i;
+
+    /* 补一个 1 位，再补 0 直到余下 8 字节写入消息位长（大端） */
+    sha->block[sha->used++] = 0x80;
+    if (sha->used > 56) {
+        while (sha->used < 64) {
+            sha->block[sha->used++] = 0;
+        }
+        sha256_block(sha, sha->block);
+        sha->used = 0;
+    }
+    while (sha->used < 56) {
+        sha->block[sha->used++] = 0;
+    }
+    for (i = 0; i < 8; i++) {
+        sha->block[56 + i] = (u8)(bits >> (56 - i * 8));
+    }
+    sha256_block(sha, sha->block);
+
+    for (i = 0; i < 8; i++) {
+        digest[i * 4] = (u8)(sha->state[i] >> 24);
+        digest[i * 4 + 1] = (u8)(sha->state[i] >> 16);
+        digest[i * 4 + 2] = (u8)(sha->state[i] >> 8);
+        digest[i * 4 + 3] = (u8)sha->state[i];
+    }
+}
@@ -9,27 +9,211 @@
 #include "../../include/utils.h"
 #include "../../include/error.h"
 #include <stdlib.h> /* 整个项目中唯一允许出现标准分配器的地方 */
+#include <stdatomic.h>
+#include <sys/resource.h>
 
+#if UTIL_MEM_ACCOUNTING
+/*
+ * 分配头部：位于返回给调用者的指针之前，16 字节以保持 malloc 的对齐。
+ * 每次分配多占 16 字节（小块分配的额外开销最明显）；以 MEMSTATS=0 编译时
+ * 不带头部，util_malloc 直接转发给 malloc。
+ */
+typedef struct {
+    u32 size;                   /* 调用者请求的字节数 */
+    u32 tag;                    /* 子系统标签 | MEM_COUNTED */
+    u64 reserved;
+} MemHeader;
+
+#define MEM_COUNTED   0x80000000u   /* 分配时记账已开启，释放时需扣减 */
+#define MEM_TAG_MASK  0x0000FFFFu
+#endif
+
+/* 记账计数器（全部为原子量，批量模式下多线程同时分配） */
+static struct {
+    atomic_int enabled;
+    atomic_ullong allocs;
+    atomic_ullong frees;
+    atomic_ullong total_bytes;
+    atomic_ullong live_bytes;
+    atomic_ullong peak_bytes;
+    atomic_uint peak_tag;
+    atomic_ullong tag_allocs[UTIL_MEM_TAG_COUNT];
+    atomic_ullong tag_live[UTIL_MEM_TAG_COUNT];
+    atomic_ullong tag_peak[UTIL_MEM_TAG_COUNT];
+    atomic_ullong tag_at_peak[UTIL_MEM_TAG_COUNT];
+    atomic_ullong histogram[UTIL_MEM_BUCKETS];
+} g_mem;
+
+static _Thread_local UtilMemTag t_tag = UTIL_MEM_GENERAL;
+
+static const char* const g_tag_names[UTIL_MEM_TAG_COUNT] = {
+    "general",
+    "lexer",
+    "symtab",
+    "ir",
+    "codegen"
+};
+
+#if UTIL_MEM_ACCOUNTING
+/*
+ * 把 value 提升为 *slot 与 value 中的较大者；成功提升时返回 1
+ */
+static int raise_max(atomic_ullong* slot, u64 value) {
+    unsigned long long seen = atomic_load_explicit(slot, memory_order_relaxed);
+    while (value > seen) {
+        if (atomic_compare_exchange_weak_explicit(slot, &seen, value,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * 返回 size 所在的直方图桶（floor(log2(size))）
+ */
+static u32 size_bucket(u32 size) {
+    u32 bucket = 0;
+    while (size > 1) {
+        size >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static void account_alloc(MemHeader* header, u32 size) {
+    u32 tag = (u32)t_tag;
+    u64 live;
+
+    header->tag |= MEM_COUNTED;
+    atomic_fetch_add_explicit(&g_mem.allocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_mem.total_bytes, size, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_mem.histogram[size_bucket(size)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_mem.tag_allocs[tag], 1, memory_order_relaxed);
+    raise_max(&g_mem.tag_peak[tag],
+              atomic_fetch_add_explicit(&g_mem.tag_live[tag], size, memory_order_relaxed) + size);
+
+    live = atomic_fetch_add_explicit(&g_mem.live_bytes, size, memory_order_relaxed) + size;
+    if (raise_max(&g_mem.peak_bytes, live)) {
+        /* 新峰值：记下推高峰值的子系统与此刻各子系统的占用 */
+        atomic_store_explicit(&g_mem.peak_tag, tag, memory_order_relaxed);
+        for (u32 i = 0; i < UTIL_MEM_TAG_COUNT; i++) {
+            atomic_store_explicit(&g_mem.tag_at_peak[i],
+                                  atomic_load_explicit(&g_mem.tag_live[i], memory_order_relaxed),
+                                  memory_order_relaxed);
+        }
+    }
+}
+
+static void account_free(const MemHeader* header) {
+    u32 tag = header->tag & MEM_TAG_MASK;
+
+    atomic_fetch_add_explicit(&g_mem.frees, 1, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&g_mem.live_bytes, header->size, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&g_mem.tag_live[tag], header->size, memory_order_relaxed);
+}
+
+#endif
+
+#if UTIL_MEM_ACCOUNTING
 void* util_malloc(u32 size) {
-    void* ptr;
+    MemHeader* header;
     if (size == 0) {
         return NULL_PTR;
     }
 
-    ptr = malloc((size_t)size);
-    if (ptr == NULL_PTR) {
+    header = NULL_PTR;
+    if (size <= 0xFFFFFFFFu - sizeof(MemHeader)) {
+        header = (MemHeader*)malloc(sizeof(MemHeader) + (size_t)size);
+    }
+    if (header == NULL_PTR) {
         /* 在完整的编译器架构中，这里应报告致命错误并可选择退出。
          * 此处安全调用 error_report（包含头文件后并不会产生循环依赖），
          * 便于上层模块感知内存分配失败。 */
         error_report(0, ERR_SYS_OUT_OF_MEM, NULL_PTR);
+        return NULL_PTR;
     }
-    return ptr;
+
+    header->size = size;
+    header->tag = (u32)t_tag;
+    header->reserved = 0;
+    if (atomic_load_explicit(&g_mem.enabled, memory_order_relaxed)) {
+        account_alloc(header, size);
+    }
+    return header + 1;
 }
 
 void util_free(void* ptr) {
     if (ptr != NULL_PTR) {
-        free(ptr);
+        MemHeader* header = (MemHeader*)ptr - 1;
+        if (header->tag & MEM_COUNTED) {
+            account_free(header);
+        }
+        free(header);
     }
 }
+#else
+void* util_malloc(u32 size) {
+    void* ptr;
+    if (size == 0) {
+        return NULL_PTR;
+    }
 
+    ptr = malloc((size_t)size);
+    if (ptr == NULL_PTR) {
+        error_report(0, ERR_SYS_OUT_OF_MEM, NULL_PTR);
+    }
+    return ptr;
+}
+
+void util_free(void* ptr) {
+    free(ptr);
+}
+#endif
 
+void util_mem_accounting(int enable) {
+    /* 未编译记账时计数保持为 0 */
+    atomic_store_explicit(&g_mem.enabled, (enable && UTIL_MEM_ACCOUNTING) ? 1 : 0,
+                          memory_order_relaxed);
+}
+
+UtilMemTag util_mem_set_tag(UtilMemTag tag) {
+    UtilMemTag previous = t_tag;
+    t_tag = tag;
+    return previous;
+}
+
+void util_mem_get_stats(UtilMemStats* out) {
+    out->allocs = atomic_load(&g_mem.allocs);
+    out->frees = atomic_load(&g_mem.frees);
+    out->total_bytes = atomic_load(&g_mem.total_bytes);
+    out->live_bytes = atomic_load(&g_mem.live_bytes);
+    out->peak_bytes = atomic_load(&g_mem.peak_bytes);
+    out->peak_tag = (UtilMemTag)atomic_load(&g_mem.peak_tag);
+    for (u32 i = 0; i < UTIL_MEM_TAG_COUNT; i++) {
+        out->tag_allocs[i] = atomic_load(&g_mem.tag_allocs[i]);
+        out->tag_live[i] = atomic_load(&g_mem.tag_live[i]);
+        out->tag_peak[i] = atomic_load(&g_mem.tag_peak[i]);
+        out->tag_at_peak[i] = atomic_load(&g_mem.tag_at_peak[i]);
+    }
+    for (u32 i = 0; i < UTIL_MEM_BUCKETS; i++) {
+        out->histogram[i] = atomic_load(&g_mem.histogram[i]);
+    }
+}
+
+u64 util_mem_peak_bytes(void) {
+    return atomic_load_explicit(&g_mem.peak_bytes, memory_order_relaxed);
+}
+
+const char* util_mem_tag_name(UtilMemTag tag) {
+    return g_tag_names[tag];
+}
+
+u64 util_peak_rss_kb(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return (u64)usage.ru_maxrss;    /* Linux 下单位为 KB */
+}
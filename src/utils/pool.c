@@ -0,0 +1,170 @@
+﻿/*
+ * ============================================================================
+ * 文件名: pool.c
+ * 描述  : 工作窃取并行循环实现文件。
+ * 每个工作线程拥有一个任务区间 [next, end)，打包为一个 64 位原子量：
+ * 所有者从头部取任务（next + 1），窃取者从尾部截走一半（end - half），
+ * 两者都用 CAS 修改同一个原子量，因此无需互斥锁。
+ * ============================================================================
+ */
+
+#include "../../include/utils.h"
+#include <stdatomic.h>
+
+#define POOL_CACHE_LINE 64
+
+/* 工作线程的任务区间（独占一个缓存行，避免伪共享） */
+typedef struct {
+    _Atomic u64 range;                              /* 高 32 位 end，低 32 位 next */
+    char pad[POOL_CACHE_LINE - sizeof(u64)];
+} PoolSlot;
+
+/* 一次并行循环的共享状态 */
+typedef struct {
+    PoolSlot* slots;
+    u32 workers;
+    UtilTaskFunc func;
+    void* arg;
+} Pool;
+
+/* 工作线程入口参数 */
+typedef struct {
+    Pool* pool;
+    u32 worker;
+} PoolWorker;
+
+static u64 pack_range(u32 next, u32 end) {
+    return ((u64)end << 32) | next;
+}
+
+/*
+ * 内部辅助函数: take_own
+ * 描述: 从自己区间的头部取一个任务。
+ * 返回: 成功返回 1 并写入 out_index；区间为空返回 0
+ */
+static int take_own(PoolSlot* slot, u32* out_index) {
+    u64 range = atomic_load_explicit(&slot->range, memory_order_acquire);
+
+    for (;;) {
+        u32 next = (u32)range;
+        u32 end = (u32)(range >> 32);
+        if (next >= end) {
+            return 0;
+        }
+        if (atomic_compare_exchange_weak_explicit(&slot->range, &range,
+                pack_range(next + 1, end), memory_order_acq_rel, memory_order_acquire)) {
+            *out_index = next;
+            return 1;
+        }
+    }
+}
+
+/*
+ * 内部辅助函数: steal
+ * 描述: 依次尝试从其他线程区间的尾部截走一半任务，放入自己的区间。
+ * 返回: 窃取成功返回 1；所有区间都为空返回 0
+ */
+static int steal(Pool* pool, u32 self) {
+    for (u32 k = 1; k < pool->workers; k++) {
+        PoolSlot* victim = &pool->slots[(self + k) % pool->workers];
+        u64 range = atomic_load_explicit(&victim->range, memory_order_acquire);
+
+        for (;;) {
+            u32 next = (u32)range;
+            u32 end = (u32)(range >> 32);
+            u32 half;
+            if (next >= end) {
+                break;
+            }
+            half = (end - next + 1) / 2;
+            if (atomic_compare_exchange_weak_explicit(&victim->range, &range,
+                    pack_range(next, end - half), memory_order_acq_rel, memory_order_acquire)) {
+                atomic_store_explicit(&pool->slots[self].range,
+                                      pack_range(end - half, end), memory_order_release);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * 内部辅助函数: worker_loop
+ * 描述: 反复执行自己区间的任务，取空后窃取，直到找不到任何任务。
+ */
+static void worker_loop(Pool* pool, u32 self) {
+    u32 index;
+
+    do {
+        while (take_own(&pool->slots[self], &index)) {
+            pool->func(pool->arg, self, index);
+        }
+    } while (steal(pool, self));
+}
+
+static void worker_main(void* param) {
+    PoolWorker* worker = (PoolWorker*)param;
+    worker_loop(worker->pool, worker->worker);
+}
+
+void util_parallel_for(u32 count, u32 workers, UtilTaskFunc func, void* arg) {
+    Pool pool;
+    PoolWorker* params;
+    UtilThread** threads;
+
+    if (workers == 0) {
+        workers = util_cpu_count();
+    }
+    if (workers > count) {
+        workers = count;
+    }
+
+    pool.slots = NULL_PTR;
+    params = NULL_PTR;
+    threads = NULL_PTR;
+    if (workers > 1) {
+        pool.slots = (PoolSlot*)util_malloc(sizeof(PoolSlot) * workers);
+        params = (PoolWorker*)util_malloc(sizeof(PoolWorker) * workers);
+        threads = (UtilThread**)util_malloc(sizeof(UtilThread*) * workers);
+    }
+
+    /* 单线程或内存不足：在调用线程上顺序执行 */
+    if (pool.slots == NULL_PTR || params == NULL_PTR || threads == NULL_PTR) {
+        for (u32 i = 0; i < count; i++) {
+            func(arg, 0, i);
+        }
+        util_free(pool.slots);
+        util_free(params);
+        util_free(threads);
+        return;
+    }
+
+    pool.workers = workers;
+    pool.func = func;
+    pool.arg = arg;
+
+    /* 把下标区间平均分给各工作线程 */
+    for (u32 w = 0; w < workers; w++) {
+        u32 begin = (u32)((u64)count * w / workers);
+        u32 end = (u32)((u64)count * (w + 1) / workers);
+        atomic_init(&pool.slots[w].range, pack_range(begin, end));
+        params[w].pool = &pool;
+        params[w].worker = w;
+    }
+
+    for (u32 w = 1; w < workers; w++) {
+        threads[w] = util_thread_create(worker_main, &params[w]);
+    }
+
+    worker_loop(&pool, 0);
+
+    for (u32 w = 1; w < workers; w++) {
+        if (threads[w] != NULL_PTR) {
+            util_thread_join(threads[w]);
+        }
+    }
+
+    util_free(pool.slots);
+    util_free(params);
+    util_free(threads);
+}
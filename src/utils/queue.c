@@ -0,0 +1,76 @@
+﻿/*
+ * ============================================================================
+ * 文件名: queue.c
+ * 描述  : 单生产者单消费者（SPSC）无锁队列实现文件。
+ * 生产者只写 tail、消费者只写 head，两者通过 acquire/release 语义同步，
+ * 无需互斥锁。下标单调递增，按掩码映射到环形槽位。
+ * ============================================================================
+ */
+
+#include "../../include/utils.h"
+#include <stdatomic.h>
+
+#define SPSC_CACHE_LINE 64
+
+struct UtilSpscQueue {
+    void** slots;                                   /* 环形槽位 */
+    u32 mask;                                       /* 容量 - 1 */
+    _Alignas(SPSC_CACHE_LINE) _Atomic u32 head;     /* 消费者下标 */
+    _Alignas(SPSC_CACHE_LINE) _Atomic u32 tail;     /* 生产者下标 */
+};
+
+UtilSpscQueue* util_spsc_create(u32 capacity) {
+    UtilSpscQueue* queue;
+    u32 size = 2;
+
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    queue = (UtilSpscQueue*)util_malloc(sizeof(UtilSpscQueue));
+    if (queue == NULL_PTR) return NULL_PTR;
+
+    queue->slots = (void**)util_malloc(sizeof(void*) * size);
+    if (queue->slots == NULL_PTR) {
+        util_free(queue);
+        return NULL_PTR;
+    }
+
+    queue->mask = size - 1;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    return queue;
+}
+
+void util_spsc_push(UtilSpscQueue* queue, void* item) {
+    u32 tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+    /* 队列满：等待消费者推进 head */
+    while (tail - atomic_load_explicit(&queue->head, memory_order_acquire) > queue->mask) {
+        util_thread_yield();
+    }
+
+    queue->slots[tail & queue->mask] = item;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+}
+
+void* util_spsc_pop(UtilSpscQueue* queue) {
+    u32 head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    void* item;
+
+    /* 队列空：等待生产者推进 tail */
+    while (atomic_load_explicit(&queue->tail, memory_order_acquire) == head) {
+        util_thread_yield();
+    }
+
+    item = queue->slots[head & queue->mask];
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return item;
+}
+
+void util_spsc_destroy(UtilSpscQueue* queue) {
+    if (queue == NULL_PTR) return;
+
+    util_free(queue->slots);
+    util_free(queue);
+}
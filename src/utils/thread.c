@@ -0,0 +1,81 @@
+﻿/*
+ * ============================================================================
+ * 文件名: thread.c
+ * 描述  : 线程接口实现文件。
+ * 整个项目中唯一直接使用 POSIX 线程库的地方，上层模块通过 utils.h 使用。
+ * ============================================================================
+ */
+
+#include "../../include/utils.h"
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+/* 线程句柄：保存平台线程与入口参数 */
+struct UtilThread {
+    pthread_t handle;
+    UtilThreadFunc func;
+    void* arg;
+};
+
+/* 下一个待分配的线程编号 */
+static _Atomic u32 g_next_thread_id = 1;
+
+/* 当前线程的编号（0 表示尚未分配） */
+static _Thread_local u32 t_thread_id = 0;
+
+/*
+ * 内部辅助函数: thread_trampoline
+ * 描述: 适配 pthread 入口签名，转调用户入口函数。
+ */
+static void* thread_trampoline(void* param) {
+    UtilThread* thread = (UtilThread*)param;
+    thread->func(thread->arg);
+    return NULL_PTR;
+}
+
+UtilThread* util_thread_create(UtilThreadFunc func, void* arg) {
+    UtilThread* thread;
+
+    if (func == NULL_PTR) return NULL_PTR;
+
+    thread = (UtilThread*)util_malloc(sizeof(UtilThread));
+    if (thread == NULL_PTR) return NULL_PTR;
+
+    thread->func = func;
+    thread->arg = arg;
+
+    if (pthread_create(&thread->handle, NULL_PTR, thread_trampoline, thread) != 0) {
+        util_free(thread);
+        return NULL_PTR;
+    }
+
+    return thread;
+}
+
+void util_thread_join(UtilThread* thread) {
+    if (thread == NULL_PTR) return;
+
+    pthread_join(thread->handle, NULL_PTR);
+    util_free(thread);
+}
+
+u32 util_cpu_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count < 1) {
+        return 1;
+    }
+    return (u32)count;
+}
+
+void util_thread_yield(void) {
+    sched_yield();
+}
+
+u32 util_thread_id(void) {
+    if (t_thread_id == 0) {
+        t_thread_id = atomic_fetch_add(&g_next_thread_id, 1);
+    }
+    return t_thread_id;
+}
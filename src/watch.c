@@ -0,0 +1,246 @@
+﻿/*
+ * ============================================================================
+ * 文件名: watch.c
+ * 描述  : 文件监视实现（inotify）
+ *
+ * 每个被登记的文件记录所在目录的 watch 描述符与文件名；同一目录只登记一次。
+ * 读到事件时按 (描述符, 文件名) 找到对应文件并置位，本轮结束后按序号输出。
+ *
+ * ============================================================================
+ */
+
+#include "../include/watch.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+#define WATCH_EVENT_BUFFER  4096
+
+/* 被监视的文件 */
+typedef struct {
+    int wd;                     /* 所在目录的 watch 描述符 */
+    char* name;                 /* 目录内的文件名 */
+    int changed;                /* 本轮是否发生变化 */
+} WatchedFile;
+
+/* 文件监视集合 */
+struct WatchSet {
+    int fd;                     /* inotify 描述符 */
+    WatchedFile* files;
+    u32 count;
+    u32 capacity;
+};
+
+/* ========================================================================= */
+/* 内部辅助函数 */
+/* ========================================================================= */
+
+#ifdef __linux__
+
+/*
+ * 把 path 拆成目录与文件名（目录为空时取 "."）；返回新分配的目录字符串
+ */
+static char* split_path(const char* path, const char** out_name) {
+    u32 len = util_strlen(path);
+    u32 slash = len;
+    char* dir;
+
+    while (slash > 0 && path[slash - 1] != '/') {
+        slash--;
+    }
+    *out_name = path + slash;
+
+    if (slash == 0) {
+        return util_strdup(".");
+    }
+    /* 保留根目录的 '/'，其余情况去掉结尾的分隔符 */
+    u32 dir_len = (slash == 1) ? 1 : slash - 1;
+    dir = (char*)util_malloc(dir_len + 1);
+    if (dir == NULL_PTR) {
+        return NULL_PTR;
+    }
+    for (u32 i = 0; i < dir_len; i++) {
+        dir[i] = path[i];
+    }
+    dir[dir_len] = '\0';
+    return dir;
+}
+
+/*
+ * 读取并分派当前可读的全部事件；返回新置位的文件数，出错返回 -1
+ */
+static int drain_events(WatchSet* set) {
+    char buffer[WATCH_EVENT_BUFFER] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int marked = 0;
+    ssize_t got = read(set->fd, buffer, sizeof(buffer));
+
+    if (got <= 0) {
+        return -1;
+    }
+
+    for (ssize_t pos = 0; pos < got; ) {
+        const struct inotify_event* event = (const struct inotify_event*)(buffer + pos);
+        pos += (ssize_t)sizeof(struct inotify_event) + event->len;
+        if (event->len == 0) {
+            continue;
+        }
+        for (u32 i = 0; i < set->count; i++) {
+            WatchedFile* file = &set->files[i];
+            if (file->wd == event->wd && !file->changed &&
+                util_strcmp(file->name, event->name) == 0) {
+                file->changed = 1;
+                marked++;
+            }
+        }
+    }
+    return marked;
+}
+
+#endif
+
+/* ========================================================================= */
+/* API 函数实现 */
+/* ========================================================================= */
+
+WatchSet* watch_create(void) {
+#ifdef __linux__
+    WatchSet* set = (WatchSet*)util_malloc(sizeof(WatchSet));
+    if (set == NULL_PTR) {
+        return NULL_PTR;
+    }
+
+    set->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (set->fd < 0) {
+        util_free(set);
+        return NULL_PTR;
+    }
+    set->files = NULL_PTR;
+    set->count = 0;
+    set->capacity = 0;
+    return set;
+#else
+    return NULL_PTR;
+#endif
+}
+
+int watch_add(WatchSet* set, const char* path) {
+#ifdef __linux__
+    const char* name;
+    char* dir;
+    int wd;
+
+    if (set == NULL_PTR || path == NULL_PTR) {
+        return -1;
+    }
+
+    if (set->count >= set->capacity) {
+        u32 new_capacity = (set->capacity == 0) ? 8 : set->capacity * 2;
+        WatchedFile* grown = (WatchedFile*)util_malloc(sizeof(WatchedFile) * new_capacity);
+        if (grown == NULL_PTR) {
+            return -1;
+        }
+        for (u32 i = 0; i < set->count; i++) {
+            grown[i] = set->files[i];
+        }
+        util_free(set->files);
+        set->files = grown;
+        set->capacity = new_capacity;
+    }
+
+    /* 同一目录重复登记时 inotify 返回同一个描述符 */
+    dir = split_path(path, &name);
+    if (dir == NULL_PTR || name[0] == '\0') {
+        util_free(dir);
+        return -1;
+    }
+    wd = inotify_add_watch(set->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+    util_free(dir);
+    if (wd < 0) {
+        return -1;
+    }
+
+    WatchedFile* file = &set->files[set->count];
+    file->wd = wd;
+    file->name = util_strdup(name);
+    file->changed = 0;
+    if (file->name == NULL_PTR) {
+        return -1;
+    }
+    return (int)set->count++;
+#else
+    (void)set;
+    (void)path;
+    return -1;
+#endif
+}
+
+int watch_wait(WatchSet* set, int timeout_ms, u32* changed, u32 capacity) {
+#ifdef __linux__
+    struct pollfd pfd;
+    int marked = 0;
+    u32 count = 0;
+
+    if (set == NULL_PTR || changed == NULL_PTR) {
+        return -1;
+    }
+
+    pfd.fd = set->fd;
+    pfd.events = POLLIN;
+
+    /* 上一次调用留下的文件直接返回；否则等待首个相关事件（无关文件的事件不结束等待） */
+    for (u32 i = 0; i < set->count; i++) {
+        marked += set->files[i].changed;
+    }
+    while (marked == 0) {
+        int ready = poll(&pfd, 1, timeout_ms);
+        if (ready < 0) {
+            return -1;
+        }
+        if (ready == 0) {
+            return 0;
+        }
+        marked = drain_events(set);
+        if (marked < 0) {
+            return -1;
+        }
+    }
+
+    /* 合并同一次保存产生的后续事件 */
+    while (poll(&pfd, 1, WATCH_SETTLE_MS) > 0) {
+        if (drain_events(set) < 0) {
+            break;
+        }
+    }
+
+    /* 超出 capacity 的文件保持置位，下一次调用立即返回 */
+    for (u32 i = 0; i < set->count && count < capacity; i++) {
+        if (set->files[i].changed) {
+            set->files[i].changed = 0;
+            changed[count++] = i;
+        }
+    }
+    return (int)count;
+#else
+    (void)set;
+    (void)timeout_ms;
+    (void)changed;
+    (void)capacity;
+    return -1;
+#endif
+}
+
+void watch_destroy(WatchSet* set) {
+    if (set == NULL_PTR) return;
+
+#ifdef __linux__
+    close(set->fd);
+#endif
+    for (u32 i = 0; i < set->count; i++) {
+        util_free(set->files[i].name);
+    }
+    util_free(set->files);
+    util_free(set);
+}
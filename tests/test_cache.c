@@ -0,0 +1,215 @@
+﻿/*
+ * ============================================================================
+ * 文件名: test_cache.c
+ * 描述  : 构建缓存 (Cache) 模块单元测试
+ *
+ * 测试覆盖范围：
+ *  - 缓存键：源文本、签名任一变化都得到不同的键
+ *  - 未命中 → 存入 → 命中，命中产物与存入内容一致
+ *  - 条目核对：源文本长度不符或条目被截断时按未命中处理，输出文件保持原样
+ *  - cache_load 读出条目内容
+ *  - 命中 / 未命中统计
+ *
+ * 编译命令（在项目根目录）：
+ *   gcc -o tests/test_cache tests/test_cache.c src/cache.c \
+ *       src/utils/memory.c src/utils/string.c src/utils/hash.c src/error.c \
+ *       -I. -Wall -Wextra
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "../include/cache.h"
+
+#define ASSERT_EQ(actual, expected, msg) \
+    do { \
+        if ((actual) != (expected)) { \
+            printf("  [FAIL] %s: expected %d, got %d\n", (msg), (int)(expected), (int)(actual)); \
+            test_failed++; \
+        } else { \
+            printf("  [PASS] %s\n", (msg)); \
+            test_passed++; \
+        } \
+    } while (0)
+
+static u32 test_passed = 0;
+static u32 test_failed = 0;
+
+static char g_cache_dir[64];
+static char g_output_path[96];
+
+/* ========================================================================= */
+/* 辅助函数 */
+/* ========================================================================= */
+
+static int same_bytes(const u8* a, const u8* b, u32 size) {
+    for (u32 i = 0; i < size; i++) {
+        if (a[i] != b[i]) return 0;
+    }
+    return 1;
+}
+
+static int same_key(const CacheKey* a, const CacheKey* b) {
+    return a->source_size == b->source_size && same_bytes(a->digest, b->digest, UTIL_SHA256_SIZE);
+}
+
+/* 读回文件内容，返回字节数（文件不存在时为 0） */
+static u32 read_file(const char* path, u8* dest, u32 capacity) {
+    FILE* fp = fopen(path, "rb");
+    u32 got = 0;
+
+    if (fp != NULL_PTR) {
+        got = (u32)fread(dest, 1, capacity, fp);
+        fclose(fp);
+    }
+    return got;
+}
+
+/* ========================================================================= */
+/* 测试用例 */
+/* ========================================================================= */
+
+static void test_cache_key(void) {
+    printf("\n=== Cache: Content Keys ===\n");
+
+    const char* a = "MOV AX, 1\n";
+    const char* b = "MOV AX, 2\n";
+    CacheKey key_a;
+    CacheKey other;
+
+    cache_key(a, util_strlen(a), "v1", &key_a);
+    ASSERT_EQ(key_a.source_size, util_strlen(a), "key records source length");
+
+    cache_key(a, util_strlen(a), "v1", &other);
+    ASSERT_EQ(same_key(&key_a, &other), 1, "same input, same key");
+    cache_key(b, util_strlen(b), "v1", &other);
+    ASSERT_EQ(same_key(&key_a, &other), 0, "source change, new key");
+    cache_key(a, util_strlen(a), "v2", &other);
+    ASSERT_EQ(same_key(&key_a, &other), 0, "signature change, new key");
+    cache_key(a, util_strlen(a) - 1, "v1", &other);
+    ASSERT_EQ(same_key(&key_a, &other), 0, "length change, new key");
+}
+
+static void test_cache_roundtrip(void) {
+    printf("\n=== Cache: Miss, Store, Hit ===\n");
+
+    BuildCache* cache = cache_open(g_cache_dir);
+    const u8 code[] = { 0xB8, 0x01, 0x00, 0x90, 0xC3 };
+    CacheKey key;
+    u32 size = 0;
+    u32 hits = 0;
+    u32 misses = 0;
+
+    ASSERT_EQ(cache != NULL_PTR, 1, "cache directory opened");
+    if (cache == NULL_PTR) {
+        return;
+    }
+
+    cache_key("MOV AX, 1\n", 10, "v1", &key);
+    ASSERT_EQ(cache_fetch(cache, &key, "com", g_output_path, &size), -1, "empty cache misses");
+
+    cache_store(cache, &key, "com", code, sizeof(code));
+    ASSERT_EQ(cache_fetch(cache, &key, "com", g_output_path, &size), 0, "stored entry hits");
+    ASSERT_EQ(size, sizeof(code), "hit reports stored size");
+    ASSERT_EQ(cache_fetch(cache, &key, "lst", g_output_path, &size), -1, "other extension misses");
+
+    /* 命中产物与存入内容逐字节一致 */
+    u8 read_back[16];
+    u32 got = read_file(g_output_path, read_back, sizeof(read_back));
+    ASSERT_EQ(got, sizeof(code), "output has stored length");
+    u32 mismatches = 0;
+    for (u32 i = 0; i < got && i < sizeof(code); i++) {
+        if (read_back[i] != code[i]) mismatches++;
+    }
+    ASSERT_EQ(mismatches, 0, "output matches stored bytes");
+
+    cache_get_stats(cache, &hits, &misses);
+    ASSERT_EQ(hits, 1, "one hit counted");
+    ASSERT_EQ(misses, 2, "two misses counted");
+
+    cache_close(cache);
+}
+
+static void test_cache_verify(void) {
+    printf("\n=== Cache: Entry Verification ===\n");
+
+    BuildCache* cache = cache_open(g_cache_dir);
+    const u8 code[] = { 0xCD, 0x20 };
+    const u8 previous[] = { 'o', 'l', 'd' };
+    char text[CACHE_KEY_TEXT];
+    char path[CACHE_PATH_MAX];
+    CacheKey key;
+    CacheKey forged;
+    u8 read_back[16];
+    u32 size = 0;
+
+    if (cache == NULL_PTR) {
+        return;
+    }
+
+    cache_key("INT 20h\n", 8, "v1", &key);
+    cache_store(cache, &key, "com", code, sizeof(code));
+
+    /* 摘要相同而长度不同：命中同一条目文件，但条目头不符 */
+    forged = key;
+    forged.source_size++;
+    ASSERT_EQ(cache_fetch(cache, &forged, "com", g_output_path, &size), -1, "length mismatch misses");
+    ASSERT_EQ(cache_load(cache, &forged, "com", &size) == NULL_PTR, 1, "length mismatch not loaded");
+
+    u8* loaded = cache_load(cache, &key, "com", &size);
+    ASSERT_EQ(loaded != NULL_PTR && size == sizeof(code) && same_bytes(loaded, code, sizeof(code)), 1,
+              "cache_load returns stored bytes");
+    util_free(loaded);
+
+    /* 条目被截断：按未命中处理，已有的输出文件保持原样 */
+    FILE* fp = fopen(g_output_path, "wb");
+    if (fp != NULL_PTR) {
+        fwrite(previous, 1, sizeof(previous), fp);
+        fclose(fp);
+    }
+    cache_key_text(&key, text);
+    snprintf(path, sizeof(path), "%s/%s.com", g_cache_dir, text);
+    ASSERT_EQ(truncate(path, 100), 0, "entry truncated");
+    ASSERT_EQ(cache_fetch(cache, &key, "com", g_output_path, &size), -1, "truncated entry misses");
+    ASSERT_EQ(read_file(g_output_path, read_back, sizeof(read_back)), sizeof(previous),
+              "output left untouched");
+
+    cache_close(cache);
+}
+
+int main(void) {
+    char command[256];
+
+    printf("============================================\n");
+    printf("  CACHE MODULE UNIT TESTS\n");
+    printf("============================================\n");
+
+    snprintf(g_cache_dir, sizeof(g_cache_dir), "/tmp/subas_cache_test.%ld", (long)getpid());
+    snprintf(g_output_path, sizeof(g_output_path), "%s.out", g_cache_dir);
+
+    test_cache_key();
+    test_cache_roundtrip();
+    test_cache_verify();
+
+    snprintf(command, sizeof(command), "rm -rf %s %s", g_cache_dir, g_output_path);
+    if (system(command) != 0) {
+        printf("  (could not remove %s)\n", g_cache_dir);
+    }
+
+    printf("\n============================================\n");
+    printf("TEST RESULTS SUMMARY\n");
+    printf("============================================\n");
+    printf("Passed: %u\n", test_passed);
+    printf("Failed: %u\n", test_failed);
+    printf("Total:  %u\n", test_passed + test_failed);
+
+    if (test_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
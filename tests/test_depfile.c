@@ -0,0 +1,120 @@
+﻿/*
+ * ============================================================================
+ * 文件名: test_depfile.c
+ * 描述  : 依赖文件 (DepFile) 模块单元测试
+ *
+ * 测试覆盖范围：
+ *  - 规则格式：目标、续行、依赖
+ *  - make 转义：空格、'#'、'$'
+ *  - depfile_abort 删除不完整的依赖文件
+ *
+ * 编译命令（在项目根目录）：
+ *   gcc -o tests/test_depfile tests/test_depfile.c src/depfile.c \
+ *       src/utils/memory.c src/utils/string.c src/error.c -I. -Wall -Wextra
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include "../include/depfile.h"
+
+#define ASSERT_EQ(actual, expected, msg) \
+    do { \
+        if ((actual) != (expected)) { \
+            printf("  [FAIL] %s: expected %d, got %d\n", (msg), (int)(expected), (int)(actual)); \
+            test_failed++; \
+        } else { \
+            printf("  [PASS] %s\n", (msg)); \
+            test_passed++; \
+        } \
+    } while (0)
+
+#define ASSERT_STR_EQ(actual, expected, msg) \
+    do { \
+        if (util_strcmp((actual), (expected)) != 0) { \
+            printf("  [FAIL] %s:\n--- expected ---\n%s--- got ---\n%s\n", (msg), (expected), (actual)); \
+            test_failed++; \
+        } else { \
+            printf("  [PASS] %s\n", (msg)); \
+            test_passed++; \
+        } \
+    } while (0)
+
+static u32 test_passed = 0;
+static u32 test_failed = 0;
+
+#define TEST_DEPFILE "tests/test_depfile.d.tmp"
+
+/*
+ * 读回整个文件（不存在时返回空串）
+ */
+static void read_back(char* buffer, u32 size) {
+    FILE* fp = fopen(TEST_DEPFILE, "r");
+    u32 got = 0;
+    if (fp != NULL_PTR) {
+        got = (u32)fread(buffer, 1, size - 1, fp);
+        fclose(fp);
+    }
+    buffer[got] = '\0';
+}
+
+static void test_depfile_format(void) {
+    printf("\n=== DepFile: Rule Format ===\n");
+
+    char text[512];
+    DepFile* dep = depfile_open(TEST_DEPFILE, "out/prog.com");
+    ASSERT_EQ(dep != NULL_PTR, 1, "depfile created");
+    if (dep == NULL_PTR) {
+        return;
+    }
+
+    depfile_add(dep, "src/prog.asm");
+    depfile_add(dep, "inc/my macros.inc");
+    depfile_add(dep, "inc/#odd$.inc");
+    ASSERT_EQ(depfile_close(dep), 0, "depfile closed");
+
+    read_back(text, sizeof(text));
+    ASSERT_STR_EQ(text,
+                  "out/prog.com: \\\n"
+                  "  src/prog.asm \\\n"
+                  "  inc/my\\ macros.inc \\\n"
+                  "  inc/\\#odd$$.inc\n",
+                  "make rule with escaped paths");
+    remove(TEST_DEPFILE);
+}
+
+static void test_depfile_abort(void) {
+    printf("\n=== DepFile: Abort Removes File ===\n");
+
+    char text[64];
+    DepFile* dep = depfile_open(TEST_DEPFILE, "a.com");
+    depfile_add(dep, "a.asm");
+    depfile_abort(dep);
+
+    read_back(text, sizeof(text));
+    ASSERT_EQ(util_strlen(text), 0, "aborted depfile removed");
+}
+
+int main(void) {
+    printf("============================================\n");
+    printf("  DEPFILE MODULE UNIT TESTS\n");
+    printf("============================================\n");
+
+    test_depfile_format();
+    test_depfile_abort();
+
+    printf("\n============================================\n");
+    printf("TEST RESULTS SUMMARY\n");
+    printf("============================================\n");
+    printf("Passed: %u\n", test_passed);
+    printf("Failed: %u\n", test_failed);
+    printf("Total:  %u\n", test_passed + test_failed);
+
+    if (test_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
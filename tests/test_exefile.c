@@ -0,0 +1,286 @@
+﻿/*
+ * ============================================================================
+ * 文件名: test_exefile.c
+ * 描述  : EXE 文件 (ExeFile) 模块单元测试
+ *
+ * 测试覆盖范围：
+ *  - 头部字段：页数与末页字节数（含整页边界）、头部节数、SS:SP、最小附加内存
+ *  - 超出格式限制的映像被拒绝
+ *  - 写出的文件：头部、规格化的重定位项（跨越分批写出的边界）、映像位置
+ *  - 段名引用：EXE 格式下成为段基址修正，.COM 格式与增量汇编下报告 E2006
+ *  - END 指定的入口：取标签所在指令的实际偏移（位于 DB 数据或变长指令之后）
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include "../include/subas.h"
+#include "../include/exefile.h"
+#include "../include/incremental.h"
+
+#define ASSERT_EQ(actual, expected, msg) \
+    do { \
+        if ((actual) != (expected)) { \
+            printf("  [FAIL] %s: expected %d, got %d\n", (msg), (int)(expected), (int)(actual)); \
+            test_failed++; \
+        } else { \
+            printf("  [PASS] %s\n", (msg)); \
+            test_passed++; \
+        } \
+    } while (0)
+
+static u32 test_passed = 0;
+static u32 test_failed = 0;
+
+#define TEST_EXE "tests/test_exefile.exe.tmp"
+
+static const char* segmented_source =
+    "DATA SEGMENT\n"
+    "msg DB 72, 105\n"
+    "DATA ENDS\n"
+    "CODE SEGMENT\n"
+    "start: MOV AX, DATA\n"
+    "    MOV BX, msg\n"
+    "    MOV CX, CODE\n"
+    "    INT 21h\n"
+    "CODE ENDS\n"
+    "END start\n";
+
+static u32 get_u16(const u8* p) {
+    return (u32)p[0] | ((u32)p[1] << 8);
+}
+
+/*
+ * 读回整个文件，返回字节数
+ */
+static u32 read_back(u8* buffer, u32 size) {
+    FILE* fp = fopen(TEST_EXE, "rb");
+    u32 got = 0;
+    if (fp != NULL_PTR) {
+        got = (u32)fread(buffer, 1, size, fp);
+        fclose(fp);
+    }
+    return got;
+}
+
+static void init_image(ExeImage* image, const u8* code, u32 size) {
+    image->code = code;
+    image->size = size;
+    image->fixups = NULL_PTR;
+    image->fixup_count = 0;
+    image->entry = 0;
+    image->stack_size = 0;
+}
+
+static void test_exefile_header(void) {
+    printf("\n=== ExeFile: Header Fields ===\n");
+
+    static u8 code[2048];
+    u32 fixups[3] = { 0, 0x10, 0x7FE };
+    ExeImage image;
+    ExeHeader header;
+
+    /* 28 + 12 字节重定位表 → 3 节头部；48 + 464 = 512 恰为一整页 */
+    init_image(&image, code, 464);
+    image.fixups = fixups;
+    image.fixup_count = 2;
+    image.entry = 0x20;
+    ASSERT_EQ(exefile_build_header(&image, &header), 0, "header built");
+    ASSERT_EQ(header.magic, 0x5A4D, "MZ signature");
+    ASSERT_EQ(header.header_paragraphs, 3, "header rounded up to paragraphs");
+    ASSERT_EQ(header.page_count, 1, "exactly one page");
+    ASSERT_EQ(header.last_page_bytes, 0, "full last page written as 0");
+    ASSERT_EQ(header.relocation_count, 2, "relocation count");
+    ASSERT_EQ(header.relocation_offset, EXEFILE_HEADER_SIZE, "relocation table follows header");
+    ASSERT_EQ(header.initial_ss, 29, "stack segment after the image");
+    ASSERT_EQ(header.initial_sp, EXEFILE_DEFAULT_STACK, "default stack size");
+    ASSERT_EQ(header.min_alloc, EXEFILE_DEFAULT_STACK / 16, "minimum allocation holds the stack");
+    ASSERT_EQ(header.initial_ip, 0x20, "IP is the entry offset");
+    ASSERT_EQ(header.initial_cs, 0, "CS is the image base");
+
+    /* 无重定位项时头部为 2 节：32 + 481 = 513 字节 */
+    init_image(&image, code, 481);
+    image.stack_size = 0x101;
+    ASSERT_EQ(exefile_build_header(&image, &header), 0, "odd-sized header built");
+    ASSERT_EQ(header.header_paragraphs, 2, "bare header is two paragraphs");
+    ASSERT_EQ(header.page_count, 2, "one byte into a second page");
+    ASSERT_EQ(header.last_page_bytes, 1, "bytes in the last page");
+    ASSERT_EQ(header.initial_sp, 0x102, "stack rounded to a word");
+    ASSERT_EQ(header.min_alloc, 0x11, "minimum allocation rounded to paragraphs");
+
+    init_image(&image, code, 0x7FF);
+    image.fixups = fixups;
+    image.fixup_count = 3;
+    ASSERT_EQ(exefile_build_header(&image, &header), -1, "fixup past the image rejected");
+    init_image(&image, code, 16);
+    image.entry = 0x10000;
+    ASSERT_EQ(exefile_build_header(&image, &header), -1, "entry beyond 64K rejected");
+    init_image(&image, code, 16);
+    image.stack_size = 0x10000;
+    ASSERT_EQ(exefile_build_header(&image, &header), -1, "oversized stack rejected");
+}
+
+static void test_exefile_write(void) {
+    printf("\n=== ExeFile: Written File ===\n");
+
+    static u8 code[0x2000];
+    static u32 fixups[300];
+    static u8 file[0x4000];
+    ExeImage image;
+
+    for (u32 i = 0; i < sizeof(code); i++) {
+        code[i] = (u8)(i * 7);
+    }
+    for (u32 i = 0; i < 300; i++) {
+        fixups[i] = i * 27;
+    }
+    init_image(&image, code, sizeof(code));
+    image.fixups = fixups;
+    image.fixup_count = 300;
+    image.entry = 0x1234;
+
+    ASSERT_EQ(exefile_write(TEST_EXE, &image), 0, "file written");
+    u32 size = read_back(file, sizeof(file));
+    u32 header_bytes = get_u16(file + 8) * 16;
+
+    ASSERT_EQ(file[0] == 'M' && file[1] == 'Z', 1, "file starts with MZ");
+    ASSERT_EQ(header_bytes, 1232, "28 + 1200 bytes of relocations rounded to paragraphs");
+    ASSERT_EQ(size, header_bytes + sizeof(code), "file is header plus image");
+    ASSERT_EQ((get_u16(file + 4) - 1) * 512 + get_u16(file + 2), size, "page fields describe file size");
+    ASSERT_EQ(get_u16(file + 6), 300, "relocation count");
+    ASSERT_EQ(get_u16(file + 20), 0x1234, "IP written");
+
+    u32 wrong = 0;
+    for (u32 i = 0; i < 300; i++) {
+        const u8* item = file + get_u16(file + 24) + i * 4;
+        if (get_u16(item) != (fixups[i] & 0xF) || get_u16(item + 2) != (fixups[i] >> 4)) {
+            wrong++;
+        }
+    }
+    ASSERT_EQ(wrong, 0, "relocations normalized to segment:offset across batches");
+    ASSERT_EQ(file[1228] == 0 && file[1231] == 0, 1, "header padded with zeros");
+
+    wrong = 0;
+    for (u32 i = 0; i < sizeof(code); i++) {
+        wrong += (file[header_bytes + i] != code[i]);
+    }
+    ASSERT_EQ(wrong, 0, "image follows the header");
+
+    image.fixups = NULL_PTR;
+    image.fixup_count = 0;
+    ASSERT_EQ(exefile_write("tests/no_such_dir/x.exe", &image), -1, "unwritable path reported");
+    remove(TEST_EXE);
+}
+
+/*
+ * 入口取标签所在指令的实际偏移：DB 数据与 2 字节立即数使第一遍估计的地址偏离
+ */
+static void test_exefile_entry(void) {
+    printf("\n=== ExeFile: Entry Point at the Emitted Offset ===\n");
+
+    AsmOptions options;
+    AsmContext* ctx;
+    AsmOutput output;
+    ExeImage image;
+    ExeHeader header;
+
+    subas_options_init(&options);
+    options.format = SUBAS_FORMAT_EXE;
+    ctx = subas_context_create(&options);
+
+    const char* after_data = "msg DB 1, 2, 3, 4, 5, 6, 7, 8\nSTART: INT 20h\nEND START\n";
+    ASSERT_EQ(subas_assemble(ctx, after_data, util_strlen(after_data), &output), 0, "entry after DB data");
+    ASSERT_EQ(exefile_entry_point(subas_get_pass_one(ctx), output.instruction_offsets), 8,
+              "IP points past the 8 data bytes");
+    ASSERT_EQ(output.code[8], 0xCD, "INT 20h is at the entry");
+
+    const char* after_code = "NOP\nMOV AX, 1234H\nSTART: INT 20h\nEND START\n";
+    ASSERT_EQ(subas_assemble(ctx, after_code, util_strlen(after_code), &output), 0,
+              "entry after a 4-byte instruction");
+    image.code = output.code;
+    image.size = output.size;
+    image.fixups = output.segment_fixups;
+    image.fixup_count = output.segment_fixup_count;
+    image.entry = exefile_entry_point(subas_get_pass_one(ctx), output.instruction_offsets);
+    image.stack_size = 0;
+    ASSERT_EQ(exefile_build_header(&image, &header), 0, "header built");
+    ASSERT_EQ(header.initial_ip, 5, "header IP is the emitted offset");
+    ASSERT_EQ(output.code[header.initial_ip], 0xCD, "INT 20h is at IP");
+    subas_context_destroy(ctx);
+}
+
+static void test_exefile_segments(void) {
+    printf("\n=== ExeFile: Segment References ===\n");
+
+    AsmOptions options;
+    AsmContext* ctx;
+    AsmOutput output;
+    u32 count = 0;
+
+    subas_options_init(&options);
+    options.format = SUBAS_FORMAT_EXE;
+    ctx = subas_context_create(&options);
+    ASSERT_EQ(subas_assemble(ctx, segmented_source, util_strlen(segmented_source), &output), 0,
+              "segment references assemble as EXE");
+    ASSERT_EQ(output.segment_fixup_count, 2, "DATA and CODE references are fixups");
+    ASSERT_EQ(output.segment_fixups[0], 4, "MOV AX, DATA operand word");
+    ASSERT_EQ(output.segment_fixups[1], 12, "MOV CX, CODE operand word");
+    ASSERT_EQ(output.code[4] == 0 && output.code[5] == 0, 1, "segment base is the image base");
+    ASSERT_EQ(exefile_entry_point(subas_get_pass_one(ctx), output.instruction_offsets), 2,
+              "END names the entry");
+
+    const char* undefined = "MOV AX, NOWHERE\n";
+    ASSERT_EQ(subas_assemble(ctx, undefined, util_strlen(undefined), &output), -1,
+              "unknown name still fails");
+    const ErrorRecord* records = subas_get_diagnostics(ctx, &count);
+    ASSERT_EQ(count == 1 && records[0].code == ERR_PARSE_UNDEFINED_LBL, 1, "reported as undefined");
+
+    const char* no_end = "A: NOP\nB: NOP\n";
+    ASSERT_EQ(subas_assemble(ctx, no_end, util_strlen(no_end), &output), 0, "program without END");
+    ASSERT_EQ(exefile_entry_point(subas_get_pass_one(ctx), output.instruction_offsets), 0,
+              "entry defaults to image start");
+    ASSERT_EQ(output.segment_fixup_count, 0, "no fixups without segment references");
+    subas_context_destroy(ctx);
+
+    ctx = subas_context_create(NULL_PTR);
+    ASSERT_EQ(subas_assemble(ctx, segmented_source, util_strlen(segmented_source), &output), -1,
+              "segment references rejected for .COM");
+    records = subas_get_diagnostics(ctx, &count);
+    ASSERT_EQ(count == 1 && records[0].code == ERR_PARSE_SEGMENT_REF && records[0].line == 5, 1,
+              "E2006 on the first reference");
+    subas_context_destroy(ctx);
+
+    IncrementalAsm* inc = incremental_create(segmented_source, util_strlen(segmented_source));
+    ASSERT_EQ(incremental_has_errors(inc), 1, "incremental .COM image reports segment references");
+    incremental_destroy(inc);
+}
+
+/* =========================================================================
+ * 主测试入口
+ * ========================================================================= */
+
+int main(void) {
+    printf("========================================\n");
+    printf("  EXE FILE MODULE UNIT TESTS\n");
+    printf("========================================\n");
+
+    test_exefile_header();
+    test_exefile_write();
+    test_exefile_entry();
+    test_exefile_segments();
+
+    printf("\n========================================\n");
+    printf("TEST RESULTS SUMMARY\n");
+    printf("========================================\n");
+    printf("Passed: %u\n", test_passed);
+    printf("Failed: %u\n", test_failed);
+    printf("Total:  %u\n", test_passed + test_failed);
+
+    if (test_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,390 @@
+﻿/*
+ * ============================================================================
+ * 文件名: test_incremental.c
+ * 描述  : 增量汇编 (IncrementalAsm) 模块单元测试
+ *
+ * 测试覆盖范围：
+ *  - 同长度修改、插入行、删除行、跨行编辑、在末尾追加：以增量方式完成，
+ *    结果与对编辑后源文本做完整汇编逐字节一致
+ *  - 标签被删除（引用未定义）、标签重名、语法错误：以增量方式报告，修正后恢复
+ *  - 出错的行保留为占位条目：其它行的编辑仍以增量方式完成，诊断随行号平移并重新报告
+ *  - 随机编辑序列（含出错的行）：每一步都与完整汇编比对机器码与诊断数
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include "../include/subas.h"
+#include "../include/incremental.h"
+
+#define ASSERT_EQ(actual, expected, msg) \
+    do { \
+        if ((actual) != (expected)) { \
+            printf("  [FAIL] %s: expected %d, got %d\n", (msg), (int)(expected), (int)(actual)); \
+            test_failed++; \
+        } else { \
+            printf("  [PASS] %s\n", (msg)); \
+            test_passed++; \
+        } \
+    } while (0)
+
+static u32 test_passed = 0;
+static u32 test_failed = 0;
+
+static const char* SOURCE =
+    "START: MOV AX, 1\n"
+    "       JMP DONE\n"
+    "MSG:   DB 48h, 69h, 0\n"
+    "LOOP1: ADD AX, 1\n"
+    "       JMP LOOP1\n"
+    "DONE:  INT 20h\n";
+
+/* ========================================================================= */
+/* 辅助函数 */
+/* ========================================================================= */
+
+/*
+ * 在会话的当前源文本中查找 needle，返回偏移（未找到返回 0xFFFFFFFF）
+ */
+static u32 find_text(const IncrementalAsm* inc, const char* needle) {
+    u32 len = 0;
+    const char* text = incremental_get_source(inc, &len);
+    u32 n = util_strlen(needle);
+
+    for (u32 i = 0; i + n <= len; i++) {
+        u32 k = 0;
+        while (k < n && text[i + k] == needle[k]) k++;
+        if (k == n) return i;
+    }
+    return 0xFFFFFFFFu;
+}
+
+/*
+ * 会话的机器码是否与对其当前源文本做完整汇编的结果一致
+ */
+static int matches_full_assembly(const IncrementalAsm* inc) {
+    AsmContext* ctx = subas_context_create(NULL_PTR);
+    AsmOutput output;
+    u32 len = 0;
+    u32 size = 0;
+    const char* text = incremental_get_source(inc, &len);
+    const u8* code = incremental_get_code(inc, &size);
+    int same;
+
+    if (ctx == NULL_PTR) return 0;
+    if (subas_assemble(ctx, text, len, &output) != 0) {
+        same = (code == NULL_PTR);
+    } else {
+        same = (code != NULL_PTR && size == output.size);
+        for (u32 i = 0; same && i < size; i++) {
+            same = (code[i] == output.code[i]);
+        }
+    }
+    subas_context_destroy(ctx);
+    return same;
+}
+
+/*
+ * 对会话的当前源文本做完整汇编，返回报告的错误数
+ */
+static u32 full_assembly_errors(const IncrementalAsm* inc) {
+    AsmContext* ctx = subas_context_create(NULL_PTR);
+    AsmOutput output;
+    u32 len = 0;
+    const char* text = incremental_get_source(inc, &len);
+    u32 count;
+
+    if (ctx == NULL_PTR) return 0xFFFFFFFFu;
+    subas_assemble(ctx, text, len, &output);
+    count = subas_get_error_count(ctx);
+    subas_context_destroy(ctx);
+    return count;
+}
+
+/*
+ * 替换第一处 old_text 为 new_text，诊断写入 captured（调用者释放）
+ */
+static int replace_captured(IncrementalAsm* inc, const char* old_text, const char* new_text,
+                            ErrorBuffer* captured) {
+    u32 offset = find_text(inc, old_text);
+    int result;
+
+    error_buffer_init(captured);
+    error_capture_begin(captured);
+    result = incremental_edit(inc, offset, util_strlen(old_text), new_text, util_strlen(new_text));
+    error_capture_end();
+    return result;
+}
+
+/*
+ * 替换第一处 old_text 为 new_text，诊断被捕获（返回捕获的诊断数）
+ */
+static u32 replace_quiet(IncrementalAsm* inc, const char* old_text, const char* new_text, int* result) {
+    ErrorBuffer captured;
+    u32 count;
+
+    *result = replace_captured(inc, old_text, new_text, &captured);
+    count = captured.count;
+    error_buffer_dispose(&captured);
+    return count;
+}
+
+/* ========================================================================= */
+/* 测试用例 */
+/* ========================================================================= */
+
+static void test_create(void) {
+    printf("\n=== Incremental: Initial Build ===\n");
+
+    IncrementalAsm* inc = incremental_create(SOURCE, util_strlen(SOURCE));
+    ASSERT_EQ(inc != NULL_PTR, 1, "session created");
+    if (inc == NULL_PTR) return;
+
+    ASSERT_EQ(incremental_has_errors(inc), 0, "source assembles");
+    ASSERT_EQ(matches_full_assembly(inc), 1, "code matches full assembly");
+    ASSERT_EQ(incremental_get_stats(inc)->full_builds, 1, "one full build");
+
+    incremental_destroy(inc);
+}
+
+static void test_local_edits(void) {
+    printf("\n=== Incremental: Local Edits ===\n");
+
+    IncrementalAsm* inc = incremental_create(SOURCE, util_strlen(SOURCE));
+    const IncrementalStats* stats = incremental_get_stats(inc);
+    int result = 0;
+
+    /* 同长度修改：只重新解析一行，其后地址不变 */
+    replace_quiet(inc, "MOV AX, 1", "MOV AX, 7", &result);
+    ASSERT_EQ(result, 0, "same-length edit succeeds");
+    ASSERT_EQ(stats->incremental_edits, 1, "handled incrementally");
+    ASSERT_EQ(stats->last_relexed_lines, 1, "one line relexed");
+    ASSERT_EQ(stats->last_reparsed, 1, "one entry reparsed");
+    ASSERT_EQ(stats->last_readdressed, 1, "later addresses unchanged");
+    ASSERT_EQ(stats->last_patched, 0, "no relocation patched");
+    ASSERT_EQ(matches_full_assembly(inc), 1, "matches full assembly");
+
+    /* 估计长度不变、机器码变长：其后标签按实际偏移后移，引用被改写 */
+    replace_quiet(inc, "MOV AX, 7", "MOV AX, 1234h", &result);
+    ASSERT_EQ(result, 0, "wider immediate succeeds");
+    ASSERT_EQ(stats->last_readdressed, 1, "estimated addresses unchanged");
+    ASSERT_EQ(stats->last_patched > 0, 1, "references to later labels patched");
+    ASSERT_EQ(matches_full_assembly(inc), 1, "matches full assembly after widening");
+
+    /* 插入一行：其后标签地址后移，引用被改写 */
+    replace_quiet(inc, "MSG:", "       ADD AX, 2\nMSG:", &result);
+    ASSERT_EQ(result, 0, "line insert succeeds");
+    ASSERT_EQ(stats->incremental_edits, 3, "insert handled incrementally");
+    ASSERT_EQ(stats->last_patched > 0, 1, "shifted references patched");
+    ASSERT_EQ(matches_full_assembly(inc), 1, "matches full assembly after insert");
+
+    /* 删除一行 */
+    replace_quiet(inc, "       ADD AX, 2\n", "", &result);
+    ASSERT_EQ(result, 0, "line delete succeeds");
+    ASSERT_EQ(matches_full_assembly(inc), 1, "matches full assembly after delete");
+
+    /* 跨行编辑：同时改动两行并改名一个标签及其引用 */
+    replace_quiet(inc, "LOOP1: ADD AX, 1\n       JMP LOOP1", "AGAIN: ADD AX, 3\n       JMP AGAIN", &result);
+    ASSERT_EQ(result, 0, "multi-line edit succeeds");
+    ASSERT_EQ(stats->last_relexed_lines, 2, "two lines relexed");
+    ASSERT_EQ(matches_full_assembly(inc), 1, "matches full assembly after rename");
+
+    /* 在末尾追加（源文本以换行结尾） */
+    u32 len = 0;
+    incremental_get_source(inc, &len);
+    result = incremental_edit(inc, len, 0, "       JMP START\n", 17);
+    ASSERT_EQ(result, 0, "append succeeds");
+    ASSERT_EQ(matches_full_assembly(inc), 1, "matches full assembly after append");
+
+    ASSERT_EQ(stats->full_builds, 1, "no full rebuild needed");
+    incremental_destroy(inc);
+}
+
+static void test_errors(void) {
+    printf("\n=== Incremental: Errors and Recovery ===\n");
+
+    IncrementalAsm* inc = incremental_create(SOURCE, util_strlen(SOURCE));
+    const IncrementalStats* stats = incremental_get_stats(inc);
+    int result = 0;
+
+    /* 删除被引用的标签：完整汇编报告未定义符号 */
+    u32 reported = replace_quiet(inc, "DONE:", "     ", &result);
+    ASSERT_EQ(result, -1, "undefined label fails");
+    ASSERT_EQ(reported, 1, "undefined label reported once");
+    ASSERT_EQ(incremental_get_code(inc, NULL_PTR) == NULL_PTR, 1, "no code while in error");
+
+    /* 修正后恢复 */
+    replace_quiet(inc, "     ", "DONE:", &result);
+    ASSERT_EQ(result, 0, "fixed source assembles");
+    ASSERT_EQ(matches_full_assembly(inc), 1, "matches full assembly after fix");
+
+    /* 标签重名 */
+    reported = replace_quiet(inc, "MSG:", "START:", &result);
+    ASSERT_EQ(result, -1, "duplicate label fails");
+    ASSERT_EQ(reported > 0, 1, "duplicate label reported");
+    replace_quiet(inc, "START:   DB", "MSG:   DB", &result);
+    ASSERT_EQ(result, 0, "duplicate removed");
+    ASSERT_EQ(matches_full_assembly(inc), 1, "matches full assembly after recovery");
+
+    /* 语法错误 */
+    reported = replace_quiet(inc, "ADD AX, 1", "ADD AX,, 1", &result);
+    ASSERT_EQ(result, -1, "syntax error fails");
+    ASSERT_EQ(reported > 0, 1, "syntax error reported");
+    ASSERT_EQ(stats->full_builds, 1, "errors handled incrementally");
+
+    /* 越界编辑被拒绝，源文本不变 */
+    u32 len = 0;
+    incremental_get_source(inc, &len);
+    ASSERT_EQ(incremental_edit(inc, len + 1, 0, "X", 1), -1, "out-of-range edit rejected");
+    u32 after = 0;
+    incremental_get_source(inc, &after);
+    ASSERT_EQ(after, len, "source unchanged");
+
+    incremental_destroy(inc);
+}
+
+static void test_error_placeholders(void) {
+    printf("\n=== Incremental: Error Placeholders ===\n");
+
+    IncrementalAsm* inc = incremental_create(SOURCE, util_strlen(SOURCE));
+    const IncrementalStats* stats = incremental_get_stats(inc);
+    ErrorBuffer captured;
+    IncrementalEntry view;
+    int result;
+
+    /* 第 4 行出错：与完整汇编一样保留为占位条目 */
+    result = replace_captured(inc, "ADD AX, 1", "ADD AX,, 1", &captured);
+    ASSERT_EQ(result, -1, "syntax error fails");
+    ASSERT_EQ(captured.count, 1, "syntax error reported once");
+    ASSERT_EQ(captured.count > 0 ? captured.records[0].line : 0, 4, "reported on line 4");
+    error_buffer_dispose(&captured);
+    int placeholder = 0;
+    for (u32 i = incremental_find_line(inc, 4);
+         incremental_get_entry(inc, i, &view) == 0 && view.line == 4; i++) {
+        placeholder |= view.entry->has_error;
+    }
+    ASSERT_EQ(placeholder, 1, "placeholder entry on line 4");
+    ASSERT_EQ(stats->incremental_edits, 1, "error edit handled incrementally");
+
+    /* 编辑其它行：以增量方式完成，诊断随行号平移并重新报告 */
+    result = replace_captured(inc, "START:", "       NOP\nSTART:", &captured);
+    ASSERT_EQ(result, -1, "still failing after unrelated edit");
+    ASSERT_EQ(captured.count, 1, "diagnostic re-reported");
+    ASSERT_EQ(captured.count > 0 ? captured.records[0].line : 0, 5, "diagnostic moved to line 5");
+    error_buffer_dispose(&captured);
+
+    /* 再引入未定义符号：两条诊断，行诊断在前 */
+    result = replace_captured(inc, "JMP DONE", "JMP DON", &captured);
+    ASSERT_EQ(captured.count, 2, "both errors reported");
+    ASSERT_EQ(captured.count == 2 && captured.records[1].code == ERR_PARSE_UNDEFINED_LBL &&
+              captured.records[1].line == 3, 1, "undefined symbol on line 3");
+    error_buffer_dispose(&captured);
+    ASSERT_EQ(full_assembly_errors(inc), 2, "full assembly reports the same count");
+
+    /* 逐个修正后恢复 */
+    replace_quiet(inc, "ADD AX,, 1", "ADD AX, 1", &result);
+    ASSERT_EQ(result, -1, "undefined symbol remains");
+    replace_quiet(inc, "JMP DON", "JMP DONE", &result);
+    ASSERT_EQ(result, 0, "fixed source assembles");
+    ASSERT_EQ(matches_full_assembly(inc), 1, "matches full assembly after fixes");
+    ASSERT_EQ(stats->full_builds, 1, "no full rebuild while in error");
+
+    incremental_destroy(inc);
+}
+
+static void test_random_edits(void) {
+    printf("\n=== Incremental: Random Edit Sequence ===\n");
+
+    static const char* LINES[] = {
+        "       MOV AX, 5\n",
+        "       ADD AX, 1\n",
+        "       JMP DONE\n",
+        "       JMP START\n",
+        "       DB 1, 2, 3\n",
+        "; comment only\n",
+        "\n",
+        "       INT 21h\n",
+        "       ADD AX,, 1\n",
+        "       JMP NOWHERE\n",
+        "       MOV AX, @\n",
+    };
+    IncrementalAsm* inc = incremental_create(SOURCE, util_strlen(SOURCE));
+    u32 seed = 12345;
+    u32 mismatches = 0;
+    u32 failures = 0;
+    u32 miscounts = 0;
+
+    for (u32 step = 0; step < 300; step++) {
+        u32 len = 0;
+        const char* text = incremental_get_source(inc, &len);
+
+        /* 随机选一个行首：插入一行，或删除该行 */
+        seed = seed * 1103515245u + 12345u;
+        u32 target = (seed >> 8) % (len + 1);
+        while (target > 0 && text[target - 1] != '\n') target--;
+        u32 line_end = target;
+        while (line_end < len && text[line_end] != '\n') line_end++;
+
+        seed = seed * 1103515245u + 12345u;
+        u32 choice = (seed >> 8) % 10;
+        int is_label_line = 0;
+        for (u32 i = target; i < line_end; i++) {
+            if (text[i] == ':') is_label_line = 1;
+        }
+
+        ErrorBuffer captured;
+        error_buffer_init(&captured);
+        error_capture_begin(&captured);
+        if (choice < 4 && line_end < len && !is_label_line) {
+            incremental_edit(inc, target, line_end + 1 - target, "", 0);
+        } else {
+            seed = seed * 1103515245u + 12345u;
+            const char* line = LINES[(seed >> 8) % (sizeof(LINES) / sizeof(LINES[0]))];
+            incremental_edit(inc, target, 0, line, util_strlen(line));
+        }
+        error_capture_end();
+
+        failures += (incremental_has_errors(inc) != 0);
+        mismatches += !matches_full_assembly(inc);
+        miscounts += (captured.count != full_assembly_errors(inc));
+        error_buffer_dispose(&captured);
+    }
+
+    ASSERT_EQ(failures > 0, 1, "some steps have errors");
+    ASSERT_EQ(mismatches, 0, "every step matches full assembly");
+    ASSERT_EQ(miscounts, 0, "every step reports as many errors as full assembly");
+    ASSERT_EQ(incremental_get_stats(inc)->full_builds, 1, "all edits incremental");
+
+    incremental_destroy(inc);
+}
+
+/* ========================================================================= */
+/* 主函数 */
+/* ========================================================================= */
+
+int main(void) {
+    printf("============================================\n");
+    printf("  INCREMENTAL ASSEMBLY UNIT TESTS\n");
+    printf("============================================\n");
+
+    test_create();
+    test_local_edits();
+    test_errors();
+    test_error_placeholders();
+    test_random_edits();
+
+    printf("\n============================================\n");
+    printf("TEST RESULTS SUMMARY\n");
+    printf("============================================\n");
+    printf("Passed: %u\n", test_passed);
+    printf("Failed: %u\n", test_failed);
+    printf("Total:  %u\n", test_passed + test_failed);
+
+    if (test_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
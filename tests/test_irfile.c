@@ -0,0 +1,259 @@
+﻿/*
+ * ============================================================================
+ * 文件名: test_irfile.c
+ * 描述  : IR 文件 (IrFile) 模块单元测试
+ *
+ * 测试覆盖范围：
+ *  - 序列化 → 写文件 → 映射 → 加载：指令、符号与第二遍扫描产物与原汇编一致
+ *  - 文件只含实际使用的操作数与驻留后的字符串，远小于 InstructionEntry 数组
+ *  - 版本号不符、文件被截断、字符串偏移越界时拒绝映射
+ *  - subas_assemble_ir：IR 文件缺失时返回 1，存在时跳过词法与第一遍扫描
+ *  - subas_assemble_ir_data：内存中的 IR 与文件结果一致，内容不完整时返回 1
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include "../include/subas.h"
+#include "../include/irfile.h"
+
+#define ASSERT_EQ(actual, expected, msg) \
+    do { \
+        if ((actual) != (expected)) { \
+            printf("  [FAIL] %s: expected %d, got %d\n", (msg), (int)(expected), (int)(actual)); \
+            test_failed++; \
+        } else { \
+            printf("  [PASS] %s\n", (msg)); \
+            test_passed++; \
+        } \
+    } while (0)
+
+static u32 test_passed = 0;
+static u32 test_failed = 0;
+
+static char g_ir_path[64];
+
+static const char* SOURCE =
+    "START: MOV AX, 1\n"
+    "       JMP DONE\n"
+    "MSG:   DB 48h, 69h, 0\n"
+    "LOOP1: ADD AX, 1\n"
+    "       JMP LOOP1\n"
+    "DONE:  INT 20h\n";
+
+/* ========================================================================= */
+/* 辅助函数 */
+/* ========================================================================= */
+
+/*
+ * 把 data 写到 path（覆盖）
+ */
+static int write_file(const char* path, const u8* data, u32 size) {
+    FILE* fp = fopen(path, "wb");
+    int ok;
+    if (fp == NULL_PTR) return -1;
+    ok = (fwrite(data, 1, size, fp) == size);
+    return (fclose(fp) == 0 && ok) ? 0 : -1;
+}
+
+/*
+ * 比较两段机器码
+ */
+static int same_code(const u8* a, u32 a_size, const u8* b, u32 b_size) {
+    if (a_size != b_size) return 0;
+    for (u32 i = 0; i < a_size; i++) {
+        if (a[i] != b[i]) return 0;
+    }
+    return 1;
+}
+
+/* ========================================================================= */
+/* 测试用例 */
+/* ========================================================================= */
+
+static void test_roundtrip(void) {
+    printf("\n=== IrFile: Serialize, Map, Load ===\n");
+
+    AsmContext* ctx = subas_context_create(NULL_PTR);
+    AsmOutput output;
+    IrFile ir;
+
+    ir.base = NULL_PTR;
+    ASSERT_EQ(ctx != NULL_PTR, 1, "context created");
+    if (ctx == NULL_PTR) return;
+
+    ASSERT_EQ(subas_assemble(ctx, SOURCE, util_strlen(SOURCE), &output), 0, "source assembles");
+    const PassOne* original = subas_get_pass_one(ctx);
+    ASSERT_EQ(irfile_write(original, g_ir_path), 0, "IR file written");
+
+    ASSERT_EQ(irfile_map(g_ir_path, &ir), 0, "IR file mapped");
+    if (ir.base == NULL_PTR) {
+        subas_context_destroy(ctx);
+        return;
+    }
+    ASSERT_EQ(ir.header->instruction_count, original->instruction_count, "instruction count");
+    ASSERT_EQ(ir.header->symbol_count, 4, "one symbol per label");
+    ASSERT_EQ(ir.header->code_size, original->current_address, "code size");
+
+    /* 符号按地址升序，名称经字符串池偏移索引 */
+    ASSERT_EQ(util_strcmp(ir.strings + ir.symbols[0].name, "START"), 0, "first symbol name");
+    ASSERT_EQ(util_strcmp(ir.strings + ir.symbols[3].name, "DONE"), 0, "last symbol name");
+    ASSERT_EQ(ir.symbols[3].address, symtab_lookup(original->symtab, "DONE")->address,
+              "symbol address preserved");
+    ASSERT_EQ(ir.instructions[1].line, 2, "instruction read in place");
+    ASSERT_EQ(util_strcmp(ir.strings + ir.instructions[1].mnemonic, "JMP"), 0, "mnemonic interned");
+    ASSERT_EQ(ir.instructions[1].label, IRFILE_NO_STRING, "no label recorded as sentinel");
+    ASSERT_EQ(ir.instructions[2].operand_count, 3, "DB keeps its operands");
+    ASSERT_EQ(ir.operands[ir.instructions[2].first_operand + 1].value, 0x69, "operand value");
+    /* 三处 JMP、两处 LOOP1 共用同一份字符串 */
+    ASSERT_EQ(ir.instructions[1].mnemonic, ir.instructions[4].mnemonic, "mnemonic shared");
+    ASSERT_EQ(ir.operands[ir.instructions[4].first_operand].name, ir.instructions[3].label,
+              "operand name shares label string");
+    ASSERT_EQ(ir.size * 20 < (u64)sizeof(InstructionEntry) * ir.header->instruction_count, 1,
+              "file far smaller than the entry array");
+
+    /* 加载后的 PassOne 直接交给第二遍扫描，产物逐字节一致 */
+    PassOne* loaded = irfile_load(&ir);
+    ASSERT_EQ(loaded != NULL_PTR, 1, "PassOne loaded");
+    if (loaded != NULL_PTR) {
+        CodeGen* codegen = codegen_pass_two(loaded);
+        u32 size = 0;
+        const u8* code = (codegen != NULL_PTR) ? codegen_get_code_buffer(codegen, &size) : NULL_PTR;
+        ASSERT_EQ(code != NULL_PTR && same_code(code, size, output.code, output.size), 1,
+                  "pass 2 on loaded IR matches full assembly");
+        codegen_destroy(codegen);
+        semantic_pass_one_destroy(loaded);
+    }
+
+    irfile_unmap(&ir);
+    subas_context_destroy(ctx);
+}
+
+static void test_rejects_invalid(void) {
+    printf("\n=== IrFile: Invalid Files ===\n");
+
+    AsmContext* ctx = subas_context_create(NULL_PTR);
+    AsmOutput output;
+    IrFile ir;
+    u32 size = 0;
+
+    if (ctx == NULL_PTR || subas_assemble(ctx, SOURCE, util_strlen(SOURCE), &output) != 0) {
+        ASSERT_EQ(0, 1, "source assembles");
+        subas_context_destroy(ctx);
+        return;
+    }
+
+    u8* data = irfile_serialize(subas_get_pass_one(ctx), &size);
+    ASSERT_EQ(data != NULL_PTR, 1, "serialized");
+    if (data == NULL_PTR) {
+        subas_context_destroy(ctx);
+        return;
+    }
+
+    ((IrHeader*)data)->version = IRFILE_VERSION + 1;
+    write_file(g_ir_path, data, size);
+    ASSERT_EQ(irfile_map(g_ir_path, &ir), -1, "version mismatch rejected");
+
+    ((IrHeader*)data)->version = IRFILE_VERSION;
+    write_file(g_ir_path, data, size - 64);
+    ASSERT_EQ(irfile_map(g_ir_path, &ir), -1, "truncated file rejected");
+
+    IrHeader* header = (IrHeader*)data;
+    IrInstruction* first = (IrInstruction*)(data + header->instructions_offset);
+    u32 mnemonic = first->mnemonic;
+    first->mnemonic = header->strings_size;
+    write_file(g_ir_path, data, size);
+    ASSERT_EQ(irfile_map(g_ir_path, &ir), -1, "string offset out of range rejected");
+
+    first->mnemonic = mnemonic;
+    first->first_operand = header->operand_count;
+    write_file(g_ir_path, data, size);
+    ASSERT_EQ(irfile_map(g_ir_path, &ir), -1, "operand range out of bounds rejected");
+
+    ((IrHeader*)data)->magic[0] = 'X';
+    write_file(g_ir_path, data, size);
+    ASSERT_EQ(irfile_map(g_ir_path, &ir), -1, "bad magic rejected");
+
+    util_free(data);
+    subas_context_destroy(ctx);
+}
+
+static void test_assemble_ir(void) {
+    printf("\n=== IrFile: subas_assemble_ir ===\n");
+
+    AsmContext* ctx = subas_context_create(NULL_PTR);
+    AsmOutput full;
+    AsmOutput from_ir;
+    u8 expected[256];
+    u32 expected_size;
+
+    if (ctx == NULL_PTR || subas_assemble(ctx, SOURCE, util_strlen(SOURCE), &full) != 0) {
+        ASSERT_EQ(0, 1, "source assembles");
+        subas_context_destroy(ctx);
+        return;
+    }
+    expected_size = full.size;
+    for (u32 i = 0; i < full.size && i < sizeof(expected); i++) {
+        expected[i] = full.code[i];
+    }
+
+    unlink(g_ir_path);
+    ASSERT_EQ(subas_assemble_ir(ctx, g_ir_path, &from_ir), 1, "missing IR file returns 1");
+    ASSERT_EQ(subas_get_error_count(ctx), 0, "missing IR file reports nothing");
+
+    ASSERT_EQ(subas_assemble(ctx, SOURCE, util_strlen(SOURCE), &full), 0, "reassembled");
+    ASSERT_EQ(irfile_write(subas_get_pass_one(ctx), g_ir_path), 0, "IR file written");
+    ASSERT_EQ(subas_assemble_ir(ctx, g_ir_path, &from_ir), 0, "assembled from IR");
+    ASSERT_EQ(same_code(from_ir.code, from_ir.size, expected, expected_size), 1,
+              "output matches full assembly");
+    ASSERT_EQ(subas_get_stats(ctx)->tokens, 0, "lexer skipped");
+
+    /* 内存中的 IR（构建缓存读出的条目）走同一路径 */
+    u32 size = 0;
+    u8* data = irfile_serialize(subas_get_pass_one(ctx), &size);
+    ASSERT_EQ(data != NULL_PTR, 1, "IR serialized");
+    if (data != NULL_PTR) {
+        ASSERT_EQ(subas_assemble_ir_data(ctx, data, 8, &from_ir), 1, "truncated IR data returns 1");
+        ASSERT_EQ(subas_assemble_ir_data(ctx, data, size, &from_ir), 0, "assembled from IR data");
+        ASSERT_EQ(same_code(from_ir.code, from_ir.size, expected, expected_size), 1,
+                  "IR data output matches full assembly");
+        util_free(data);
+    }
+
+    subas_context_destroy(ctx);
+    unlink(g_ir_path);
+}
+
+/* ========================================================================= */
+/* 主函数 */
+/* ========================================================================= */
+
+int main(void) {
+    printf("============================================\n");
+    printf("  IR FILE MODULE UNIT TESTS\n");
+    printf("============================================\n");
+
+    snprintf(g_ir_path, sizeof(g_ir_path), "/tmp/subas_irfile_test.%ld.ir", (long)getpid());
+
+    test_roundtrip();
+    test_rejects_invalid();
+    test_assemble_ir();
+
+    unlink(g_ir_path);
+
+    printf("\n============================================\n");
+    printf("TEST RESULTS SUMMARY\n");
+    printf("============================================\n");
+    printf("Passed: %u\n", test_passed);
+    printf("Failed: %u\n", test_failed);
+    printf("Total:  %u\n", test_passed + test_failed);
+
+    if (test_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
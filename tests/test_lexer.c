@@ -8,7 +8,8 @@
  *  - 注释处理
  *  - 十进制与十六进制数字
  *  - 错误报告
- *  - 行号跟踪
+ *  - 行号跟踪与行首偏移索引
+ *  - 流式输入（Token 跨越窗口边界、窗口扩容）
  *
  * 编译命令示例（在项目根目录）：
  *   gcc -o test_lexer test_lexer.c src/lexer.c src/error.c src/utils/memory.c \
@@ -332,6 +333,123 @@ static void test_masm_hex_numbers(void) {
     lexer_destroy(lx);
 }
 
+/* 测试 10：行首偏移索引（含跨行字符串） */
+static void test_line_index(void) {
+    const char* src = "MOV AX, 1\nDB 'A\nB'\n\nNOP";
+    const u32 expected[] = { 0, 10, 16, 19, 20 };
+    LineIndex index;
+    Lexer* lx;
+    Token tok;
+    int ok = 1;
+
+    printf("=== Test 10: Line Offset Index ===\n");
+    error_init();
+    line_index_init(&index);
+    lx = lexer_create_from_string(src);
+    if (lx == NULL_PTR) {
+        printf("FAIL: lexer_create_from_string returned NULL\n");
+        return;
+    }
+    lexer_set_line_index(lx, &index);
+
+    do {
+        tok = lexer_next_token(lx);
+        token_dispose(&tok);
+    } while (tok.type != TOK_EOF);
+
+    printf("Lines indexed: %u (expected 5)\n", index.count);
+    ok = (index.count == 5);
+    for (u32 i = 0; ok && i < index.count; i++) {
+        printf("  Line %u starts at %u\n", i + 1, index.starts[i]);
+        ok = (index.starts[i] == expected[i]);
+    }
+    printf("%s\n\n", ok ? "PASS: line index matches" : "FAIL: line index mismatch");
+
+    lexer_destroy(lx);
+    line_index_dispose(&index);
+}
+
+/* 测试 11 的分块读取回调：每次最多交出 3 字节，使 Token 频繁跨越补充边界 */
+typedef struct {
+    const char* text;
+    u32 len;
+    u32 pos;
+} ChunkReader;
+
+static u32 read_chunks(void* user, char* dest, u32 capacity) {
+    ChunkReader* reader = (ChunkReader*)user;
+    u32 n = 0;
+    while (n < capacity && n < 3 && reader->pos < reader->len) {
+        dest[n++] = reader->text[reader->pos++];
+    }
+    return n;
+}
+
+/* 测试 11：流式输入与整块输入产生相同的 Token 序列与行索引 */
+static void test_stream_input(void) {
+    const char* src = "START: MOV AX, 0x1234 ; comment here\n"
+                      "  DB 'multi\nline', 0FFh, 65535\n"
+                      "AVERYLONGIDENTIFIERNAME_EXCEEDING_WINDOW: JMP START\n"
+                      "NOP";
+    ChunkReader reader;
+    LineIndex buffer_lines;
+    LineIndex stream_lines;
+    Lexer* whole;
+    Lexer* stream;
+    Token a;
+    Token b;
+    u32 count = 0;
+    int ok = 1;
+
+    printf("=== Test 11: Streaming Input ===\n");
+    error_init();
+    reader.text = src;
+    reader.len = util_strlen(src);
+    reader.pos = 0;
+    line_index_init(&buffer_lines);
+    line_index_init(&stream_lines);
+    whole = lexer_create_from_string(src);
+    stream = lexer_create_from_stream(read_chunks, &reader, 4);
+    if (whole == NULL_PTR || stream == NULL_PTR) {
+        printf("FAIL: lexer creation returned NULL\n");
+        lexer_destroy(whole);
+        lexer_destroy(stream);
+        return;
+    }
+    lexer_set_line_index(whole, &buffer_lines);
+    lexer_set_line_index(stream, &stream_lines);
+
+    do {
+        a = lexer_next_token(whole);
+        b = lexer_next_token(stream);
+        if (a.type != b.type || a.line != b.line || a.int_value != b.int_value ||
+            (a.lexeme == NULL_PTR) != (b.lexeme == NULL_PTR) ||
+            (a.lexeme != NULL_PTR && util_strcmp(a.lexeme, b.lexeme) != 0)) {
+            printf("  Mismatch at token %u: '%s' vs '%s'\n", count,
+                   a.lexeme ? a.lexeme : "(null)", b.lexeme ? b.lexeme : "(null)");
+            ok = 0;
+        }
+        count++;
+        token_dispose(&a);
+        token_dispose(&b);
+    } while (ok && a.type != TOK_EOF);
+
+    ok = ok && buffer_lines.count == stream_lines.count;
+    for (u32 i = 0; ok && i < buffer_lines.count; i++) {
+        ok = (buffer_lines.starts[i] == stream_lines.starts[i]);
+    }
+    ok = ok && lexer_bytes_read(stream) == reader.len && error_get_count() == 0;
+    printf("Tokens compared: %u, bytes read: %llu\n", count,
+           (unsigned long long)lexer_bytes_read(stream));
+    printf("%s\n\n", ok ? "PASS: stream matches buffer lexing"
+                         : "FAIL: stream differs from buffer lexing");
+
+    lexer_destroy(whole);
+    lexer_destroy(stream);
+    line_index_dispose(&buffer_lines);
+    line_index_dispose(&stream_lines);
+}
+
 /* 主测试入口 */
 int main(void) {
     printf("========================================\n");
@@ -347,6 +465,8 @@ int main(void) {
     test_error_handling();
     test_masm_pseudo();
     test_masm_hex_numbers();
+    test_line_index();
+    test_stream_input();
 
     printf("========================================\n");
     printf("   ALL TESTS COMPLETED\n");
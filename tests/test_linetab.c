@@ -0,0 +1,223 @@
+﻿/*
+ * ============================================================================
+ * 文件名: test_linetab.c
+ * 描述  : 行号表 (LineTable) 模块单元测试
+ *
+ * 测试覆盖范围：
+ *  - 每个地址的查找结果与按第二遍实际偏移暴力查找一致（跨块、特殊行、一般行、重复段）
+ *  - 超出范围的地址查找失败
+ *  - 写文件 + mmap 映射与内存中的序列化结果一致
+ *  - 均匀程序的行流被重复操作码压缩
+ *  - 截断或魔数错误的表被拒绝
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include "../include/subas.h"
+#include "../include/linetab.h"
+
+#define ASSERT_EQ(actual, expected, msg) \
+    do { \
+        if ((actual) != (expected)) { \
+            printf("  [FAIL] %s: expected %d, got %d\n", (msg), (int)(expected), (int)(actual)); \
+            test_failed++; \
+        } else { \
+            printf("  [PASS] %s\n", (msg)); \
+            test_passed++; \
+        } \
+    } while (0)
+
+static u32 test_passed = 0;
+static u32 test_failed = 0;
+
+#define TEST_LINETAB "tests/test_linetab.dbg.tmp"
+
+/*
+ * 暴力查找：机器码实际覆盖 address 的条目
+ */
+static int brute_force_line(const PassOne* pass_one, const u32* offsets, u32 address, u32* line) {
+    for (u32 i = 0; i < pass_one->instruction_count; i++) {
+        if (!pass_one->instructions[i].has_error &&
+            address >= offsets[i] && address < offsets[i + 1]) {
+            *line = pass_one->instructions[i].line;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * 对 [0, end + 4) 的每个地址比对查找结果，返回不一致的个数
+ */
+static u32 count_mismatches(const LineTable* table, const PassOne* pass_one,
+                            const AsmOutput* output) {
+    u32 mismatches = 0;
+    u32 end = output->size + 4;
+
+    for (u32 address = 0; address < end; address++) {
+        u32 expected = 0;
+        u32 got = 0;
+        int expected_found = brute_force_line(pass_one, output->instruction_offsets, address, &expected);
+        int found = linetab_lookup(table, address, &got);
+        if (found != expected_found || (found == 0 && got != expected)) {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+/*
+ * 生成一段各行形状不同的程序：注释与空行造成行号跳跃，DB 行造成大地址增量
+ */
+static char* build_program(u32 lines, u32* out_len) {
+    char* src = (char*)util_malloc(lines * 48 + 1);
+    u32 len = 0;
+    u32 seed = 7;
+
+    for (u32 i = 0; i < lines; i++) {
+        seed = seed * 1103515245u + 12345u;
+        u32 kind = (seed >> 16) % 10;
+        if (kind == 0) {
+            len += (u32)sprintf(src + len, "; comment %u\n", i);
+        } else if (kind == 1) {
+            len += (u32)sprintf(src + len, "\n");
+        } else if (kind == 2) {
+            len += (u32)sprintf(src + len, "L%u: DB 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12\n", i);
+        } else if (kind == 3) {
+            len += (u32)sprintf(src + len, "L%u:\n", i);
+        } else {
+            len += (u32)sprintf(src + len, "    MOV AX, %u\n", i);
+        }
+    }
+    src[len] = '\0';
+    *out_len = len;
+    return src;
+}
+
+static void test_linetab_lookup(void) {
+    printf("\n=== LineTable: Lookup Matches Brute Force ===\n");
+
+    u32 len;
+    char* src = build_program(3000, &len);
+    AsmContext* ctx = subas_context_create(NULL_PTR);
+    AsmOutput output;
+    LineTable table;
+    LineTable mapped;
+    u32 size = 0;
+
+    ASSERT_EQ(subas_assemble(ctx, src, len, &output), 0, "program assembled");
+    const PassOne* pass_one = subas_get_pass_one(ctx);
+
+    u8* data = linetab_serialize(pass_one, output.instruction_offsets, "prog.asm", &size);
+    ASSERT_EQ(data != NULL_PTR, 1, "table serialized");
+    ASSERT_EQ(linetab_open(data, size, &table), 0, "in-memory table opened");
+    ASSERT_EQ(table.header->block_count > 1, 1, "table spans several blocks");
+    ASSERT_EQ(table.header->name_size, 8, "source name stored");
+    ASSERT_EQ(count_mismatches(&table, pass_one, &output), 0, "every address matches brute force");
+    ASSERT_EQ(table.header->end_address, output.size, "table ends at the image size");
+
+    u32 line = 0;
+    ASSERT_EQ(linetab_lookup(&table, output.size, &line), -1, "end address not covered");
+    ASSERT_EQ(linetab_lookup(&table, 0xFFFFFFFFu, &line), -1, "far address not covered");
+
+    ASSERT_EQ(linetab_write(pass_one, output.instruction_offsets, "prog.asm", TEST_LINETAB), 0,
+              "table written");
+    ASSERT_EQ(linetab_map(TEST_LINETAB, &mapped), 0, "table mapped");
+    ASSERT_EQ(mapped.size, size, "mapped size matches serialized size");
+    ASSERT_EQ(count_mismatches(&mapped, pass_one, &output), 0, "mapped table matches brute force");
+    linetab_unmap(&mapped);
+    remove(TEST_LINETAB);
+
+    util_free(data);
+    subas_context_destroy(ctx);
+    util_free(src);
+}
+
+static void test_linetab_compact(void) {
+    printf("\n=== LineTable: Repeated Rows Are Compressed ===\n");
+
+    const u32 lines = 5000;
+    char* src = (char*)util_malloc(lines * 16 + 1);
+    u32 len = 0;
+    AsmContext* ctx = subas_context_create(NULL_PTR);
+    AsmOutput output;
+    LineTable table;
+    u32 size = 0;
+
+    for (u32 i = 0; i < lines; i++) {
+        len += (u32)sprintf(src + len, "    MOV AX, 1\n");
+    }
+    src[len] = '\0';
+
+    ASSERT_EQ(subas_assemble(ctx, src, len, &output), 0, "uniform program assembled");
+    u8* data = linetab_serialize(subas_get_pass_one(ctx), output.instruction_offsets, NULL_PTR, &size);
+    ASSERT_EQ(linetab_open(data, size, &table), 0, "table opened");
+    ASSERT_EQ(table.header->row_count, lines, "one row per instruction");
+    /* 每块：首行在索引中，其余 63 行为一个特殊行加一个重复操作码 */
+    ASSERT_EQ(table.header->stream_size, table.header->block_count * 2, "two stream bytes per block");
+    ASSERT_EQ(size * 10 < output.size, 1, "table under a tenth of the image");
+    ASSERT_EQ(count_mismatches(&table, subas_get_pass_one(ctx), &output), 0,
+              "uniform table matches brute force");
+
+    util_free(data);
+    subas_context_destroy(ctx);
+    util_free(src);
+}
+
+static void test_linetab_reject(void) {
+    printf("\n=== LineTable: Corrupt Tables Rejected ===\n");
+
+    AsmContext* ctx = subas_context_create(NULL_PTR);
+    AsmOutput output;
+    LineTable table;
+    u32 size = 0;
+    const char* src = "A: NOP\nB: MOV AX, 1\n";
+
+    ASSERT_EQ(subas_assemble(ctx, src, util_strlen(src), &output), 0, "small program assembled");
+    u8* data = linetab_serialize(subas_get_pass_one(ctx), output.instruction_offsets, "x.asm", &size);
+
+    /* NOP 只生成 1 字节：第二行从实际偏移 1 开始，而不是第一遍估计的 3 */
+    u32 line = 0;
+    ASSERT_EQ(linetab_open(data, size, &table), 0, "small table opened");
+    ASSERT_EQ(linetab_lookup(&table, 1, &line), 0, "offset 1 covered");
+    ASSERT_EQ(line, 2, "offset 1 is the second line");
+
+    ASSERT_EQ(linetab_open(data, size - 1, &table), -1, "truncated table rejected");
+    ASSERT_EQ(linetab_open(data, 8, &table), -1, "header-only fragment rejected");
+    data[0] = 'X';
+    ASSERT_EQ(linetab_open(data, size, &table), -1, "bad magic rejected");
+    ASSERT_EQ(linetab_map("tests/no_such_table.dbg", &table), -1, "missing file rejected");
+
+    util_free(data);
+    subas_context_destroy(ctx);
+}
+
+/* =========================================================================
+ * 主测试入口
+ * ========================================================================= */
+
+int main(void) {
+    printf("========================================\n");
+    printf("  LINE TABLE MODULE UNIT TESTS\n");
+    printf("========================================\n");
+
+    test_linetab_lookup();
+    test_linetab_compact();
+    test_linetab_reject();
+
+    printf("\n========================================\n");
+    printf("TEST RESULTS SUMMARY\n");
+    printf("========================================\n");
+    printf("Passed: %u\n", test_passed);
+    printf("Failed: %u\n", test_failed);
+    printf("Total:  %u\n", test_passed + test_failed);
+
+    if (test_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,287 @@
+﻿/*
+ * ============================================================================
+ * 文件名: test_listing.c
+ * 描述  : 列表文件 (Listing) 模块单元测试
+ *
+ * 测试覆盖范围：
+ *  - 行格式：行号、地址（第二遍的实际偏移）、机器码、源代码原文；无指令的行原样补写
+ *  - 超过一行宽度的机器码续行显示
+ *  - 重定位字段显示为填充后的地址，与最终机器码一致；未定义符号显示为 ??
+ *  - 符号表附录按名字排序，地址与行地址同源；汇编失败时不附符号表
+ *  - CRLF 与无结尾换行的源文本、流水线选项、超过输出缓冲区的大列表
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include "../include/subas.h"
+#include "../include/listing.h"
+
+#define ASSERT_EQ(actual, expected, msg) \
+    do { \
+        if ((actual) != (expected)) { \
+            printf("  [FAIL] %s: expected %d, got %d\n", (msg), (int)(expected), (int)(actual)); \
+            test_failed++; \
+        } else { \
+            printf("  [PASS] %s\n", (msg)); \
+            test_passed++; \
+        } \
+    } while (0)
+
+#define ASSERT_STR_EQ(actual, expected, msg) \
+    do { \
+        if (util_strcmp((actual), (expected)) != 0) { \
+            printf("  [FAIL] %s:\n--- expected ---\n%s--- got ---\n%s\n", (msg), (expected), (actual)); \
+            test_failed++; \
+        } else { \
+            printf("  [PASS] %s\n", (msg)); \
+            test_passed++; \
+        } \
+    } while (0)
+
+static u32 test_passed = 0;
+static u32 test_failed = 0;
+
+#define TEST_LISTING "tests/test_listing.lst.tmp"
+
+/*
+ * 读回整个文件，返回字节数（不存在时返回 0）
+ */
+static u32 read_back(char* buffer, u32 size) {
+    FILE* fp = fopen(TEST_LISTING, "rb");
+    u32 got = 0;
+    if (fp != NULL_PTR) {
+        got = (u32)fread(buffer, 1, size - 1, fp);
+        fclose(fp);
+    }
+    buffer[got] = '\0';
+    return got;
+}
+
+/*
+ * 汇编 src 并写出列表文件，返回汇编结果
+ */
+static int assemble_listed(const char* src, int pipeline, AsmOutput* output, int* close_result) {
+    AsmOptions options;
+    AsmContext* ctx;
+    Listing* listing;
+    int status;
+
+    listing = listing_open(TEST_LISTING, "prog.asm", src, util_strlen(src));
+    if (listing == NULL_PTR) {
+        *close_result = -1;
+        return -1;
+    }
+
+    subas_options_init(&options);
+    options.pipeline = pipeline;
+    options.listener = listing_instruction;
+    options.listener_user = listing;
+    ctx = subas_context_create(&options);
+
+    status = subas_assemble(ctx, src, util_strlen(src), output);
+    *close_result = listing_close(listing, (status == 0) ? subas_get_pass_one(ctx)->symtab : NULL_PTR);
+
+    /* 机器码属于 ctx：复制出前 64 字节供比对 */
+    static u8 code[64];
+    u32 size = (status == 0 && output->size < sizeof(code)) ? output->size : 0;
+    for (u32 i = 0; i < size; i++) {
+        code[i] = output->code[i];
+    }
+    output->code = code;
+    output->size = size;
+    subas_context_destroy(ctx);
+    return status;
+}
+
+static const char* const PROGRAM =
+    "; listing demo\n"
+    "START:  MOV AX, 1234H\n"
+    "        JMP NEXT\n"
+    "\n"
+    "DATA:   DB 1, 2, 3, 4, 5, 6, 7, 8\n"
+    "NEXT:   MOV BX, DATA\n";
+
+static void test_listing_format(void) {
+    printf("\n=== Listing: Rows and Symbol Appendix ===\n");
+
+    static char text[4096];
+    AsmOutput output;
+    int closed;
+
+    ASSERT_EQ(assemble_listed(PROGRAM, 0, &output, &closed), 0, "program assembled");
+    ASSERT_EQ(closed, 0, "listing closed");
+    read_back(text, sizeof(text));
+    ASSERT_STR_EQ(text,
+                  "SUBAS listing: prog.asm\n"
+                  "\n"
+                  " Line  Addr  Code               Source\n"
+                  "    1                           ; listing demo\n"
+                  "    2  0000  88 C0 34 12        START:  MOV AX, 1234H\n"
+                  "    3  0004  EB 0F 00                   JMP NEXT\n"
+                  "    4\n"
+                  "    5  0007  01 02 03 04 05 06  DATA:   DB 1, 2, 3, 4, 5, 6, 7, 8\n"
+                  "       000D  07 08\n"
+                  "    6  000F  88 C0 07 00        NEXT:   MOV BX, DATA\n"
+                  "\n"
+                  "Symbols:\n"
+                  "\n"
+                  "Name                             Type       Addr  Line\n"
+                  "DATA                             variable   0007     5\n"
+                  "NEXT                             label      000F     6\n"
+                  "START                            label      0000     2\n",
+                  "listing text");
+
+    /* 列表中的重定位字段与最终机器码一致 */
+    ASSERT_EQ(output.size, 19, "code size");
+    ASSERT_EQ(output.code[5], 0x0F, "JMP NEXT low byte matches listing");
+    ASSERT_EQ(output.code[6], 0x00, "JMP NEXT high byte matches listing");
+    ASSERT_EQ(output.code[17], 0x07, "MOV BX, DATA low byte matches listing");
+
+    /* 行地址是机器码的实际位置，而非第一遍估计的地址 */
+    ASSERT_EQ(output.code[0x04], 0xEB, "JMP listed at its emitted offset");
+    ASSERT_EQ(output.code[0x0D], 0x07, "DB continuation listed at its emitted offset");
+    ASSERT_EQ(output.code[0x0F], 0x88, "MOV BX listed at its emitted offset");
+}
+
+/*
+ * 数据之后的标签：行地址、符号表附录与引用字段都是同一个实际偏移
+ * （第一遍按 DB 与指令的估计长度给出的地址与之不同）
+ */
+static void test_listing_label_after_data(void) {
+    printf("\n=== Listing: Label After Data ===\n");
+
+    static char text[4096];
+    AsmOutput output;
+    int closed;
+
+    ASSERT_EQ(assemble_listed("MSG:   DB 1, 2, 3, 4, 5, 6, 7, 8\n"
+                              "START: INT 20h\n"
+                              "       JMP START\n", 0, &output, &closed), 0,
+              "program assembled");
+    read_back(text, sizeof(text));
+    ASSERT_STR_EQ(text,
+                  "SUBAS listing: prog.asm\n"
+                  "\n"
+                  " Line  Addr  Code               Source\n"
+                  "    1  0000  01 02 03 04 05 06  MSG:   DB 1, 2, 3, 4, 5, 6, 7, 8\n"
+                  "       0006  07 08\n"
+                  "    2  0008  CD 20              START: INT 20h\n"
+                  "    3  000A  EB 08 00                  JMP START\n"
+                  "\n"
+                  "Symbols:\n"
+                  "\n"
+                  "Name                             Type       Addr  Line\n"
+                  "MSG                              variable   0000     1\n"
+                  "START                            label      0008     2\n",
+                  "row, reference and appendix agree");
+    ASSERT_EQ(output.code[0x0B] | (output.code[0x0C] << 8), 0x08, "image refers to the listed address");
+}
+
+static void test_listing_failed_assembly(void) {
+    printf("\n=== Listing: Undefined Symbol ===\n");
+
+    static char text[4096];
+    AsmOutput output;
+    int closed;
+
+    ASSERT_EQ(assemble_listed("        JMP NOWHERE\n; tail\n", 0, &output, &closed), -1,
+              "assembly fails");
+    ASSERT_EQ(closed, 0, "listing still written");
+    read_back(text, sizeof(text));
+    ASSERT_STR_EQ(text,
+                  "SUBAS listing: prog.asm\n"
+                  "\n"
+                  " Line  Addr  Code               Source\n"
+                  "    1  0000  EB ?? ??                   JMP NOWHERE\n"
+                  "    2                           ; tail\n",
+                  "unresolved field shown as ??, no symbol appendix");
+}
+
+static void test_listing_line_endings(void) {
+    printf("\n=== Listing: CRLF, Missing Final Newline, Pipeline Option ===\n");
+
+    static char text[4096];
+    AsmOutput output;
+    int closed;
+
+    ASSERT_EQ(assemble_listed("A: NOP\r\n\r\nB: NOP", 1, &output, &closed), 0,
+              "assembled with pipeline option");
+    read_back(text, sizeof(text));
+    ASSERT_STR_EQ(text,
+                  "SUBAS listing: prog.asm\n"
+                  "\n"
+                  " Line  Addr  Code               Source\n"
+                  "    1  0000  90                 A: NOP\n"
+                  "    2\n"
+                  "    3  0001  90                 B: NOP\n"
+                  "\n"
+                  "Symbols:\n"
+                  "\n"
+                  "Name                             Type       Addr  Line\n"
+                  "A                                label      0000     1\n"
+                  "B                                label      0001     3\n",
+                  "CR stripped, last line listed");
+}
+
+static void test_listing_large(void) {
+    printf("\n=== Listing: Larger Than the Output Buffer ===\n");
+
+    const u32 lines = 12000;
+    char* src = (char*)util_malloc(lines * 16 + 1);
+    char* text = (char*)util_malloc(LISTING_BUFFER_SIZE * 4);
+    u32 len = 0;
+    AsmOutput output;
+    int closed;
+
+    for (u32 i = 0; i < lines; i++) {
+        len += (u32)sprintf(src + len, "    NOP ; %05u\n", i);
+    }
+    src[len] = '\0';
+
+    ASSERT_EQ(assemble_listed(src, 0, &output, &closed), 0, "large program assembled");
+    u32 size = read_back(text, LISTING_BUFFER_SIZE * 4);
+    ASSERT_EQ(size > LISTING_BUFFER_SIZE, 1, "listing spans several buffer flushes");
+
+    u32 rows = 0;
+    for (u32 i = 0; i < size; i++) {
+        rows += (text[i] == '\n');
+    }
+    /* 标题 3 行 + 每个源代码行 1 行 + 符号表附录 4 行 */
+    ASSERT_EQ(rows, 3 + lines + 4, "one row per source line");
+
+    util_free(text);
+    util_free(src);
+}
+
+/* =========================================================================
+ * 主测试入口
+ * ========================================================================= */
+
+int main(void) {
+    printf("========================================\n");
+    printf("  LISTING MODULE UNIT TESTS\n");
+    printf("========================================\n");
+
+    test_listing_format();
+    test_listing_label_after_data();
+    test_listing_failed_assembly();
+    test_listing_line_endings();
+    test_listing_large();
+    remove(TEST_LISTING);
+
+    printf("\n========================================\n");
+    printf("TEST RESULTS SUMMARY\n");
+    printf("========================================\n");
+    printf("Passed: %u\n", test_passed);
+    printf("Failed: %u\n", test_failed);
+    printf("Total:  %u\n", test_passed + test_failed);
+
+    if (test_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
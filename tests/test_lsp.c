@@ -0,0 +1,389 @@
+﻿/*
+ * ============================================================================
+ * 文件名: test_lsp.c
+ * 描述  : 语言服务器 (lsp) 与 JSON 模块单元测试
+ *
+ * 测试覆盖范围：
+ *  - JSON：转义与 \uXXXX（含代理对）解码、生成时转义、非法输入被拒绝
+ *  - initialize 声明的能力；未知方法与非法 JSON 的错误应答
+ *  - 打开 / 修改 / 关闭文档时发布的诊断（范围按 UTF-16 计算）
+ *  - 跳转定义、查找引用（含 / 不含声明）、悬停信息，编辑后结果随之更新
+ *  - 大文件上编辑后的查询耗时（打印，不作断言）
+ *  - shutdown / exit 与退出码
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../include/lsp.h"
+#include "../include/json.h"
+
+#define ASSERT_EQ(actual, expected, msg) \
+    do { \
+        if ((actual) != (expected)) { \
+            printf("  [FAIL] %s: expected %d, got %d\n", (msg), (int)(expected), (int)(actual)); \
+            test_failed++; \
+        } else { \
+            printf("  [PASS] %s\n", (msg)); \
+            test_passed++; \
+        } \
+    } while (0)
+
+#define MAX_OUTPUTS         8
+#define LARGE_LINES         50000
+#define LARGE_LABEL_EVERY   100
+
+static u32 test_passed = 0;
+static u32 test_failed = 0;
+
+/* 服务器最近写出的消息 */
+static JsonValue* g_outputs[MAX_OUTPUTS];
+static u32 g_output_count = 0;
+
+static const char* PROGRAM =
+    "ORG 100H\n"
+    "START: MOV AX, 1234H\n"
+    "LOOP1: SUB AX, 1\n"
+    "       JNZ LOOP1\n"
+    "       JMP START\n"
+    "MSG    DB 48H, 49H ; LOOP1 in a comment\n";
+
+/* ========================================================================= */
+/* 辅助函数 */
+/* ========================================================================= */
+
+static void clear_outputs(void) {
+    for (u32 i = 0; i < g_output_count; i++) {
+        json_free(g_outputs[i]);
+    }
+    g_output_count = 0;
+}
+
+static void capture_output(void* user, const char* message, u32 len) {
+    (void)user;
+    if (g_output_count < MAX_OUTPUTS) {
+        g_outputs[g_output_count++] = json_parse(message, len);
+    }
+}
+
+/*
+ * 发送一条消息，返回写出的第一条消息（无输出时为 NULL）
+ */
+static const JsonValue* send(LspServer* server, const char* message) {
+    clear_outputs();
+    lsp_handle_message(server, message, util_strlen(message));
+    return (g_output_count > 0) ? g_outputs[0] : NULL_PTR;
+}
+
+/*
+ * 以 JSON 字符串形式写入 text，用于拼装 didOpen / didChange
+ */
+static char* build_message(const char* prefix, const char* text, const char* suffix) {
+    JsonWriter w;
+
+    json_writer_init(&w);
+    json_write_raw(&w, prefix);
+    json_write_string(&w, text, util_strlen(text));
+    json_write_raw(&w, suffix);
+    json_write_raw(&w, "");
+    char* message = (char*)util_malloc(w.len + 1);
+    for (u32 i = 0; i < w.len; i++) message[i] = w.data[i];
+    message[w.len] = '\0';
+    json_writer_dispose(&w);
+    return message;
+}
+
+static void open_document(LspServer* server, const char* text) {
+    char* message = build_message(
+        "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didOpen\",\"params\":{\"textDocument\":"
+        "{\"uri\":\"file:///test.asm\",\"languageId\":\"asm\",\"version\":1,\"text\":",
+        text, "}}}");
+    send(server, message);
+    util_free(message);
+}
+
+static void change_document(LspServer* server, u32 line0, u32 ch0, u32 line1, u32 ch1,
+                            const char* text) {
+    char prefix[320];
+    snprintf(prefix, sizeof(prefix),
+             "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didChange\",\"params\":{"
+             "\"textDocument\":{\"uri\":\"file:///test.asm\",\"version\":2},\"contentChanges\":"
+             "[{\"range\":{\"start\":{\"line\":%u,\"character\":%u},"
+             "\"end\":{\"line\":%u,\"character\":%u}},\"text\":",
+             line0, ch0, line1, ch1);
+    char* message = build_message(prefix, text, "}]}}");
+    send(server, message);
+    util_free(message);
+}
+
+/*
+ * 发送位置类请求，返回 result
+ */
+static const JsonValue* position_request(LspServer* server, const char* method, u32 line,
+                                         u32 character, const char* extra) {
+    char message[512];
+    snprintf(message, sizeof(message),
+             "{\"jsonrpc\":\"2.0\",\"id\":7,\"method\":\"%s\",\"params\":{\"textDocument\":"
+             "{\"uri\":\"file:///test.asm\"},\"position\":{\"line\":%u,\"character\":%u}%s}}",
+             method, line, character, extra);
+    return json_get(send(server, message), "result");
+}
+
+static s64 range_field(const JsonValue* location, const char* end, const char* field) {
+    return json_get_int(json_get(json_get(location, "range"), end), field, -1);
+}
+
+/*
+ * 最近发布的诊断数组（没有诊断通知时为 NULL）
+ */
+static const JsonValue* published_diagnostics(void) {
+    for (u32 i = 0; i < g_output_count; i++) {
+        const char* method = json_get_string(g_outputs[i], "method");
+        if (method != NULL_PTR && util_strcmp(method, "textDocument/publishDiagnostics") == 0) {
+            return json_get(json_get(g_outputs[i], "params"), "diagnostics");
+        }
+    }
+    return NULL_PTR;
+}
+
+static int contains(const char* text, const char* needle) {
+    u32 n = util_strlen(needle);
+    for (u32 i = 0; text != NULL_PTR && text[i] != '\0'; i++) {
+        u32 k = 0;
+        while (k < n && text[i + k] == needle[k]) k++;
+        if (k == n) return 1;
+    }
+    return 0;
+}
+
+/* ========================================================================= */
+/* 测试用例 */
+/* ========================================================================= */
+
+static void test_json(void) {
+    printf("\n[TEST] JSON\n");
+
+    const char* text = "{\"a\":[1,-2,3.75,true,null],\"s\":\"x\\\"\\n\\u00e9\\ud83d\\ude00\","
+                       "\"o\":{\"k\":\"v\"}}";
+    JsonValue* root = json_parse(text, util_strlen(text));
+    ASSERT_EQ(root != NULL_PTR, 1, "document parsed");
+
+    const JsonValue* a = json_get(root, "a");
+    ASSERT_EQ(a != NULL_PTR && a->type == JSON_ARRAY ? a->count : 0, 5, "array length");
+    ASSERT_EQ(a->items[1].integer, -2, "negative number");
+    ASSERT_EQ(a->items[2].integer, 3, "fraction truncated");
+    ASSERT_EQ(a->items[3].type, JSON_BOOL, "boolean");
+    ASSERT_EQ(a->items[4].type, JSON_NULL, "null");
+
+    const JsonValue* s = json_get(root, "s");
+    /* x " \n é(2) 😀(4) */
+    ASSERT_EQ(s->length, 9, "escapes decoded to UTF-8");
+    ASSERT_EQ((unsigned char)s->string[5], 0xF0, "surrogate pair combined");
+    ASSERT_EQ(util_strcmp(json_get_string(json_get(root, "o"), "k"), "v"), 0, "nested member");
+    ASSERT_EQ(json_get(root, "missing") == NULL_PTR, 1, "missing member");
+
+    JsonWriter w;
+    json_writer_init(&w);
+    json_write_value(&w, root);
+    JsonValue* again = json_parse(w.data, w.len);
+    ASSERT_EQ(again != NULL_PTR && json_get(again, "s")->length == 9, 1, "written text reparses");
+    json_free(again);
+    json_writer_dispose(&w);
+    json_free(root);
+
+    ASSERT_EQ(json_parse("{\"a\":}", 6) == NULL_PTR, 1, "missing value rejected");
+    ASSERT_EQ(json_parse("[1,2", 4) == NULL_PTR, 1, "unterminated array rejected");
+    ASSERT_EQ(json_parse("\"a\" 1", 5) == NULL_PTR, 1, "trailing text rejected");
+}
+
+static void test_protocol(LspServer* server) {
+    printf("\n[TEST] Protocol\n");
+
+    const JsonValue* reply = send(server, "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"initialize\","
+                                          "\"params\":{}}");
+    const JsonValue* caps = json_get(json_get(reply, "result"), "capabilities");
+    ASSERT_EQ(json_get(caps, "hoverProvider") != NULL_PTR, 1, "hover advertised");
+    ASSERT_EQ(json_get_int(json_get(caps, "textDocumentSync"), "change", 0), 2,
+              "incremental sync advertised");
+
+    reply = send(server, "{\"jsonrpc\":\"2.0\",\"id\":\"x\",\"method\":\"workspace/nothing\"}");
+    ASSERT_EQ(json_get_int(json_get(reply, "error"), "code", 0), -32601, "unknown method");
+    ASSERT_EQ(util_strcmp(json_get_string(reply, "id"), "x"), 0, "string id echoed");
+
+    reply = send(server, "{\"jsonrpc\":");
+    ASSERT_EQ(json_get_int(json_get(reply, "error"), "code", 0), -32700, "parse error");
+
+    send(server, "{\"jsonrpc\":\"2.0\",\"method\":\"initialized\",\"params\":{}}");
+    ASSERT_EQ(g_output_count, 0, "notification not answered");
+}
+
+static void test_navigation(LspServer* server) {
+    const JsonValue* result;
+
+    printf("\n[TEST] Definition / references / hover\n");
+
+    open_document(server, PROGRAM);
+    const JsonValue* diagnostics = published_diagnostics();
+    ASSERT_EQ(diagnostics != NULL_PTR ? diagnostics->count : 99, 0, "clean document published");
+
+    /* JNZ LOOP1 → 第 3 行的 LOOP1 */
+    result = position_request(server, "textDocument/definition", 3, 12, "");
+    ASSERT_EQ(range_field(result, "start", "line"), 2, "definition line");
+    ASSERT_EQ(range_field(result, "end", "character"), 5, "definition end");
+
+    result = position_request(server, "textDocument/definition", 3, 2, "");
+    ASSERT_EQ(result != NULL_PTR && result->type == JSON_NULL, 1, "mnemonic has no definition");
+
+    result = position_request(server, "textDocument/references", 2, 1,
+                              ",\"context\":{\"includeDeclaration\":true}");
+    ASSERT_EQ(result->count, 2, "references with declaration (comment ignored)");
+    result = position_request(server, "textDocument/references", 2, 1,
+                              ",\"context\":{\"includeDeclaration\":false}");
+    ASSERT_EQ(result->count, 1, "references without declaration");
+    ASSERT_EQ(range_field(&result->items[0], "start", "character"), 11, "reference column");
+
+    result = position_request(server, "textDocument/hover", 4, 12, "");
+    const char* value = json_get_string(json_get(result, "contents"), "value");
+    ASSERT_EQ(contains(value, "START  label  0000h  (line 2)"), 1, "symbol hover");
+    ASSERT_EQ(range_field(result, "start", "character"), 11, "hover range");
+
+    result = position_request(server, "textDocument/hover", 5, 0, "");
+    value = json_get_string(json_get(result, "contents"), "value");
+    ASSERT_EQ(contains(value, "48 49"), 1, "hover shows encoded bytes");
+
+    result = position_request(server, "textDocument/hover", 40, 0, "");
+    ASSERT_EQ(result != NULL_PTR && result->type == JSON_NULL, 1, "no hover past the end");
+
+    /* 在开头插入两行：定义行随之下移 */
+    change_document(server, 0, 0, 0, 0, "NOP\nNOP\n");
+    ASSERT_EQ(published_diagnostics()->count, 0, "insertion is clean");
+    result = position_request(server, "textDocument/definition", 5, 12, "");
+    ASSERT_EQ(range_field(result, "start", "line"), 4, "definition follows the edit");
+    result = position_request(server, "textDocument/hover", 6, 12, "");
+    value = json_get_string(json_get(result, "contents"), "value");
+    ASSERT_EQ(contains(value, "START  label") && !contains(value, "0000h") &&
+              contains(value, "(line 4)"), 1, "hover address updated");
+}
+
+static void test_diagnostics(LspServer* server) {
+    const JsonValue* diagnostics;
+
+    printf("\n[TEST] Diagnostics\n");
+
+    /* 第 6 行（0 起）"       JMP START" → 未知助记符，注释中的多字节字符按 UTF-16 计宽 */
+    change_document(server, 6, 7, 6, 10, "FOO");
+    change_document(server, 6, 16, 6, 16, " ; \xe2\x82\xac\xf0\x9f\x98\x80");
+    diagnostics = published_diagnostics();
+    ASSERT_EQ(diagnostics->count, 1, "one diagnostic");
+    ASSERT_EQ(util_strcmp(json_get_string(&diagnostics->items[0], "code"), "E2003"), 0,
+              "diagnostic code");
+    ASSERT_EQ(range_field(&diagnostics->items[0], "start", "line"), 6, "diagnostic line");
+    ASSERT_EQ(range_field(&diagnostics->items[0], "end", "character"), 22,
+              "diagnostic end in UTF-16 units");
+
+    /* 有错误时导航仍然可用 */
+    const JsonValue* result = position_request(server, "textDocument/definition", 5, 12, "");
+    ASSERT_EQ(range_field(result, "start", "line"), 4, "definition while broken");
+
+    change_document(server, 6, 7, 6, 10, "JMP");
+    ASSERT_EQ(published_diagnostics()->count, 0, "fix clears diagnostics");
+
+    send(server, "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didClose\",\"params\":"
+                 "{\"textDocument\":{\"uri\":\"file:///test.asm\"}}}");
+    ASSERT_EQ(published_diagnostics() != NULL_PTR, 1, "close clears diagnostics");
+    result = position_request(server, "textDocument/definition", 5, 12, "");
+    ASSERT_EQ(result != NULL_PTR && result->type == JSON_NULL, 1, "closed document forgotten");
+}
+
+static void test_large_document(LspServer* server) {
+    printf("\n[TEST] Large document\n");
+
+    /* 每 LARGE_LABEL_EVERY 行一个标签，其余行跳回 L0 */
+    u32 capacity = LARGE_LINES * 16 + 64;
+    char* text = (char*)util_malloc(capacity);
+    u32 len = 0;
+    for (u32 i = 0; i < LARGE_LINES; i++) {
+        if (i % LARGE_LABEL_EVERY == 0) {
+            len += (u32)snprintf(text + len, capacity - len, "L%u: NOP\n", i / LARGE_LABEL_EVERY);
+        } else if (i % LARGE_LABEL_EVERY == 1) {
+            len += (u32)snprintf(text + len, capacity - len, "  JNZ L0\n");
+        } else {
+            len += (u32)snprintf(text + len, capacity - len, "  NOP\n");
+        }
+    }
+    text[len] = '\0';
+    open_document(server, text);
+    util_free(text);
+    ASSERT_EQ(published_diagnostics()->count, 0, "large document is clean");
+
+    change_document(server, 250, 2, 250, 5, "CLC");
+    ASSERT_EQ(published_diagnostics()->count, 0, "edit is clean");
+
+    u64 t0 = util_time_ns();
+    const JsonValue* result = position_request(server, "textDocument/definition", 1, 7, "");
+    u64 t1 = util_time_ns();
+    ASSERT_EQ(range_field(result, "start", "line"), 0, "definition in large document");
+    result = position_request(server, "textDocument/hover", LARGE_LINES - 1, 3, "");
+    u64 t2 = util_time_ns();
+    ASSERT_EQ(result != NULL_PTR && result->type == JSON_OBJECT, 1, "hover in large document");
+    result = position_request(server, "textDocument/references", 1, 7,
+                              ",\"context\":{\"includeDeclaration\":false}");
+    u64 t3 = util_time_ns();
+    ASSERT_EQ(result->count, LARGE_LINES / LARGE_LABEL_EVERY, "references in large document");
+    result = position_request(server, "textDocument/references", 1, 7,
+                              ",\"context\":{\"includeDeclaration\":false}");
+    u64 t4 = util_time_ns();
+
+    printf("  %u lines: definition %.3f ms, hover %.3f ms, references %.3f ms "
+           "(index build) / %.3f ms (cached)\n", (unsigned int)LARGE_LINES,
+           (t1 - t0) / 1e6, (t2 - t1) / 1e6, (t3 - t2) / 1e6, (t4 - t3) / 1e6);
+}
+
+static void test_shutdown(LspServer* server) {
+    printf("\n[TEST] Shutdown\n");
+
+    ASSERT_EQ(lsp_exit_code(server), 1, "exit code before shutdown");
+    const JsonValue* reply = send(server, "{\"jsonrpc\":\"2.0\",\"id\":9,\"method\":\"shutdown\"}");
+    ASSERT_EQ(json_get(reply, "result") != NULL_PTR, 1, "shutdown answered");
+    ASSERT_EQ(lsp_exit_code(server), 0, "exit code after shutdown");
+    const char* exit_message = "{\"jsonrpc\":\"2.0\",\"method\":\"exit\"}";
+    ASSERT_EQ(lsp_handle_message(server, exit_message, util_strlen(exit_message)), LSP_EXIT,
+              "exit ends the loop");
+}
+
+/* ========================================================================= */
+/* 主程序 */
+/* ========================================================================= */
+
+int main(void) {
+    printf("============================================\n");
+    printf("  LANGUAGE SERVER UNIT TESTS\n");
+    printf("============================================\n");
+
+    test_json();
+
+    LspServer* server = lsp_create(capture_output, NULL_PTR);
+    test_protocol(server);
+    test_navigation(server);
+    test_diagnostics(server);
+    test_large_document(server);
+    test_shutdown(server);
+    lsp_destroy(server);
+    clear_outputs();
+
+    printf("\n============================================\n");
+    printf("TEST RESULTS SUMMARY\n");
+    printf("============================================\n");
+    printf("Passed: %u\n", test_passed);
+    printf("Failed: %u\n", test_failed);
+    printf("Total:  %u\n", test_passed + test_failed);
+
+    if (test_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
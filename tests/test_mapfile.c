@@ -0,0 +1,262 @@
+﻿/*
+ * ============================================================================
+ * 文件名: test_mapfile.c
+ * 描述  : 映像文件 (MapFile) 模块单元测试
+ *
+ * 测试覆盖范围：
+ *  - 符号类型：name PROC 为过程、name DB 为变量、其余为标签（增量汇编同样）
+ *  - 段归属与段内字节数（按实际偏移，合计等于映像大小）：段外内容归入 "(none)"，同名段再次打开时累加
+ *  - 嵌套 PROC / ENDP 配对得到过程大小
+ *  - 符号按地址排序且与符号表一一对应
+ *  - 写出的 MAP 文件内容
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include "../include/subas.h"
+#include "../include/mapfile.h"
+#include "../include/incremental.h"
+
+#define ASSERT_EQ(actual, expected, msg) \
+    do { \
+        if ((actual) != (expected)) { \
+            printf("  [FAIL] %s: expected %d, got %d\n", (msg), (int)(expected), (int)(actual)); \
+            test_failed++; \
+        } else { \
+            printf("  [PASS] %s\n", (msg)); \
+            test_passed++; \
+        } \
+    } while (0)
+
+#define ASSERT_STR_EQ(actual, expected, msg) \
+    do { \
+        if (util_strcmp((actual), (expected)) != 0) { \
+            printf("  [FAIL] %s:\n--- expected ---\n%s--- got ---\n%s\n", (msg), (expected), (actual)); \
+            test_failed++; \
+        } else { \
+            printf("  [PASS] %s\n", (msg)); \
+            test_passed++; \
+        } \
+    } while (0)
+
+static u32 test_passed = 0;
+static u32 test_failed = 0;
+
+#define TEST_MAP "tests/test_mapfile.map.tmp"
+
+static const char* segmented_source =
+    "START: MOV AX, 1\n"        /*  1  0000 段外（实际偏移） */
+    "CODE SEGMENT\n"            /*  2 */
+    "outer PROC\n"              /*  3  0003 */
+    "    MOV AX, 2\n"           /*  4  0003 */
+    "inner PROC\n"              /*  5  0006 */
+    "    NOP\n"                 /*  6  0006 */
+    "inner ENDP\n"              /*  7  0007 */
+    "    RET\n"                 /*  8  0007 */
+    "outer ENDP\n"              /*  9  0008 */
+    "CODE ENDS\n"               /* 10 */
+    "DATA SEGMENT\n"            /* 11 */
+    "msg DB 1, 2\n"             /* 12  0008 */
+    "DATA ENDS\n"               /* 13 */
+    "CODE SEGMENT\n"            /* 14 */
+    "tail: NOP\n"               /* 15  000A */
+    "CODE ENDS\n";              /* 16  000B */
+
+/*
+ * 在映像中按名字找符号
+ */
+static const MapSymbol* find_symbol(const MapFile* map, const char* name) {
+    for (u32 i = 0; i < map->symbol_count; i++) {
+        if (util_strcmp(map->symbols[i].info->name, name) == 0) {
+            return &map->symbols[i];
+        }
+    }
+    return NULL_PTR;
+}
+
+static const char* segment_of(const MapFile* map, const char* name) {
+    const MapSymbol* symbol = find_symbol(map, name);
+    return (symbol != NULL_PTR) ? map->segments[symbol->segment].name : "";
+}
+
+static void test_mapfile_types(void) {
+    printf("\n=== MapFile: Symbol Types ===\n");
+
+    AsmContext* ctx = subas_context_create(NULL_PTR);
+    AsmOutput output;
+
+    ASSERT_EQ(subas_assemble(ctx, segmented_source, util_strlen(segmented_source), &output), 0,
+              "segmented program assembled");
+    SymbolTable* symtab = subas_get_pass_one(ctx)->symtab;
+    ASSERT_EQ(symtab_lookup(symtab, "START")->type, SYM_LABEL, "colon label is a label");
+    ASSERT_EQ(symtab_lookup(symtab, "outer")->type, SYM_PROCEDURE, "PROC name is a procedure");
+    ASSERT_EQ(symtab_lookup(symtab, "msg")->type, SYM_VARIABLE, "DB name is a variable");
+    subas_context_destroy(ctx);
+
+    const char* text = "A: NOP\nB: NOP\n";
+    IncrementalAsm* inc = incremental_create(text, util_strlen(text));
+    ASSERT_EQ(incremental_edit(inc, 7, 0, "v DB 5\n", 7), 0, "incremental edit applied");
+    const SymbolInfo* v = incremental_lookup_symbol(inc, "v");
+    ASSERT_EQ(v != NULL_PTR && v->type == SYM_VARIABLE, 1, "spliced DB name is a variable");
+    incremental_destroy(inc);
+}
+
+static void test_mapfile_build(void) {
+    printf("\n=== MapFile: Segments, Procedures and Order ===\n");
+
+    AsmContext* ctx = subas_context_create(NULL_PTR);
+    AsmOutput output;
+    MapFile map;
+
+    subas_assemble(ctx, segmented_source, util_strlen(segmented_source), &output);
+    ASSERT_EQ(mapfile_build(subas_get_pass_one(ctx), output.instruction_offsets, &map), 0, "map built");
+
+    ASSERT_EQ(map.segment_count, 3, "(none), CODE and DATA segments");
+    ASSERT_STR_EQ(map.segments[1].name, "CODE", "first named segment is CODE");
+    ASSERT_EQ(map.segments[0].size, 3, "bytes outside segments");
+    ASSERT_EQ(map.segments[1].size, 6, "reopened CODE accumulates both parts");
+    ASSERT_EQ(map.segments[1].start, 3, "CODE starts where first opened");
+    ASSERT_EQ(map.segments[2].size, 2, "DATA size");
+    ASSERT_EQ(map.segments[2].start, 8, "DATA starts at its emitted offset");
+    ASSERT_EQ(map.segments[0].size + map.segments[1].size + map.segments[2].size, output.size,
+              "segment sizes add up to the image size");
+    ASSERT_EQ(map.segments[1].symbol_count, 3, "symbols in CODE");
+
+    ASSERT_EQ(map.symbol_count, 5, "every symbol listed once");
+    ASSERT_STR_EQ(map.symbols[0].info->name, "START", "lowest address first");
+    ASSERT_STR_EQ(map.symbols[4].info->name, "tail", "highest address last");
+    ASSERT_STR_EQ(segment_of(&map, "START"), MAPFILE_NO_SEGMENT, "START outside segments");
+    ASSERT_STR_EQ(segment_of(&map, "msg"), "DATA", "msg in DATA");
+    ASSERT_STR_EQ(segment_of(&map, "tail"), "CODE", "tail in reopened CODE");
+    ASSERT_EQ(find_symbol(&map, "outer")->size, 5, "outer PROC size spans inner");
+    ASSERT_EQ(find_symbol(&map, "inner")->size, 1, "nested inner PROC size");
+    ASSERT_EQ(find_symbol(&map, "tail")->address, 0x0A, "tail at its emitted offset");
+    ASSERT_EQ(output.code[find_symbol(&map, "tail")->address], 0x90, "NOP found at the mapped offset");
+    ASSERT_EQ(find_symbol(&map, "tail")->size, 0, "labels have no size");
+
+    mapfile_free(&map);
+    subas_context_destroy(ctx);
+}
+
+static void test_mapfile_sorted(void) {
+    printf("\n=== MapFile: Large Program Sorted by Address ===\n");
+
+    const u32 lines = 4000;
+    char* src = (char*)util_malloc(lines * 32 + 1);
+    u32 len = 0;
+    AsmContext* ctx = subas_context_create(NULL_PTR);
+    AsmOutput output;
+    MapFile map;
+
+    for (u32 i = 0; i < lines; i++) {
+        if (i % 3 == 0) {
+            len += (u32)sprintf(src + len, "L%u: MOV AX, %u\n", i, i);
+        } else if (i % 3 == 1) {
+            len += (u32)sprintf(src + len, "V%u DB %u\n", i, i & 0xFF);
+        } else {
+            len += (u32)sprintf(src + len, "    NOP\n");
+        }
+    }
+    src[len] = '\0';
+
+    ASSERT_EQ(subas_assemble(ctx, src, len, &output), 0, "large program assembled");
+    const PassOne* pass_one = subas_get_pass_one(ctx);
+    ASSERT_EQ(mapfile_build(pass_one, output.instruction_offsets, &map), 0, "map built");
+    ASSERT_EQ(map.symbol_count, pass_one->symtab->total_symbols, "all symbols present");
+
+    u32 unordered = 0;
+    for (u32 i = 1; i < map.symbol_count; i++) {
+        const MapSymbol* prev = &map.symbols[i - 1];
+        const MapSymbol* cur = &map.symbols[i];
+        if (cur->address < prev->address ||
+            (cur->address == prev->address && cur->info->line_defined < prev->info->line_defined)) {
+            unordered++;
+        }
+    }
+    ASSERT_EQ(unordered, 0, "symbols ordered by address, then line");
+    ASSERT_EQ(map.segments[0].size, output.size, "unsegmented program in (none)");
+
+    mapfile_free(&map);
+    subas_context_destroy(ctx);
+    util_free(src);
+}
+
+static void test_mapfile_write(void) {
+    printf("\n=== MapFile: Written File ===\n");
+
+    AsmContext* ctx = subas_context_create(NULL_PTR);
+    AsmOutput output;
+    char buffer[2048];
+    u32 got = 0;
+
+    subas_assemble(ctx, segmented_source, util_strlen(segmented_source), &output);
+    ASSERT_EQ(mapfile_write(subas_get_pass_one(ctx), output.instruction_offsets, "seg.asm",
+                            output.size, TEST_MAP), 0, "map written");
+
+    FILE* fp = fopen(TEST_MAP, "rb");
+    if (fp != NULL_PTR) {
+        got = (u32)fread(buffer, 1, sizeof(buffer) - 1, fp);
+        fclose(fp);
+    }
+    buffer[got] = '\0';
+
+    ASSERT_STR_EQ(buffer,
+        "SUBAS map: seg.asm\n"
+        "\n"
+        "Segments:\n"
+        "\n"
+        "Name                             Start  Size  Symbols\n"
+        "(none)                           0000   0003        1\n"
+        "CODE                             0003   0006        3\n"
+        "DATA                             0008   0002        1\n"
+        "Total                                   000B        5\n"
+        "\n"
+        "Image size: 11 bytes\n"
+        "\n"
+        "Symbols by address:\n"
+        "\n"
+        "Addr  Segment          Type       Size  Line  Name\n"
+        "0000  (none)           label      0000     1  START\n"
+        "0003  CODE             procedure  0005     3  outer\n"
+        "0006  CODE             procedure  0001     5  inner\n"
+        "0008  DATA             variable   0000    12  msg\n"
+        "000A  CODE             label      0000    15  tail\n",
+        "map file contents");
+
+    ASSERT_EQ(mapfile_write(subas_get_pass_one(ctx), output.instruction_offsets, "seg.asm",
+                            output.size, "tests/no_such_dir/x.map"), -1, "unwritable path reported");
+
+    remove(TEST_MAP);
+    subas_context_destroy(ctx);
+}
+
+/* =========================================================================
+ * 主测试入口
+ * ========================================================================= */
+
+int main(void) {
+    printf("========================================\n");
+    printf("  MAP FILE MODULE UNIT TESTS\n");
+    printf("========================================\n");
+
+    test_mapfile_types();
+    test_mapfile_build();
+    test_mapfile_sorted();
+    test_mapfile_write();
+
+    printf("\n========================================\n");
+    printf("TEST RESULTS SUMMARY\n");
+    printf("========================================\n");
+    printf("Passed: %u\n", test_passed);
+    printf("Failed: %u\n", test_failed);
+    printf("Total:  %u\n", test_passed + test_failed);
+
+    if (test_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,549 @@
+﻿/*
+ * ============================================================================
+ * 文件名: test_objfile.c
+ * 描述  : OBJ 文件 (ObjFile) 模块单元测试
+ *
+ * 测试覆盖范围：
+ *  - 记录序列与校验和：THEADR、LNAMES、SEGDEF、EXTDEF、PUBDEF、LEDATA、FIXUPP、MODEND
+ *  - 外部符号按名字编号，三种重定位各自的 FIXUPP 子记录
+ *  - 转移与调用的位移字段为自相对修正，其余标签引用为段相对修正
+ *  - PUBDEF、MODEND 与修正加数取变长代码之后标签的实际偏移
+ *  - LEDATA 分块不切开重定位字，块内偏移正确
+ *  - EXTRN / PUBLIC 的错误：.COM 与 .EXE 下的外部引用（E2007）、重名（E2004）、
+ *    非符号名（E2001）、PUBLIC 未定义或外部的名字（E2005）
+ *  - 并行第一遍扫描、IR 缓存与增量汇编下的外部符号
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include "../include/subas.h"
+#include "../include/objfile.h"
+#include "../include/irfile.h"
+#include "../include/incremental.h"
+
+#define ASSERT_EQ(actual, expected, msg) \
+    do { \
+        if ((actual) != (expected)) { \
+            printf("  [FAIL] %s: expected %d, got %d\n", (msg), (int)(expected), (int)(actual)); \
+            test_failed++; \
+        } else { \
+            printf("  [PASS] %s\n", (msg)); \
+            test_passed++; \
+        } \
+    } while (0)
+
+#define ASSERT_STR_EQ(actual, expected, msg) \
+    do { \
+        if (util_strcmp((actual), (expected)) != 0) { \
+            printf("  [FAIL] %s: expected \"%s\", got \"%s\"\n", (msg), (expected), (actual)); \
+            test_failed++; \
+        } else { \
+            printf("  [PASS] %s\n", (msg)); \
+            test_passed++; \
+        } \
+    } while (0)
+
+static u32 test_passed = 0;
+static u32 test_failed = 0;
+
+#define TEST_OBJ    "tests/test_objfile.obj.tmp"
+#define TEST_IR     "tests/test_objfile.ir.tmp"
+#define MAX_RECORDS 64
+
+static const char* module_source =
+    "CODE SEGMENT\n"
+    "EXTRN helper:NEAR, count\n"
+    "PUBLIC main, exit\n"
+    "main PROC\n"
+    "    CALL helper\n"
+    "    MOV AX, count\n"
+    "    MOV BX, exit\n"
+    "    MOV CX, CODE\n"
+    "exit: INT 21h\n"
+    "main ENDP\n"
+    "CODE ENDS\n"
+    "END main\n";
+
+/*
+ * 解析出的一条记录
+ */
+typedef struct {
+    u32 type;
+    const u8* content;          /* 记录内容（不含类型、长度与校验和） */
+    u32 length;                 /* 内容字节数 */
+} Record;
+
+static u32 get_u16(const u8* p) {
+    return (u32)p[0] | ((u32)p[1] << 8);
+}
+
+/*
+ * 按 类型 | 长度 | 内容 | 校验和 切分模块；长度越界或校验和不为 0 时返回 -1
+ */
+static int split_records(const u8* data, u32 size, Record* records, u32* out_count) {
+    u32 pos = 0;
+    u32 count = 0;
+
+    while (pos < size) {
+        if (pos + 3 > size || count == MAX_RECORDS) {
+            return -1;
+        }
+        u32 length = get_u16(data + pos + 1);
+        if (length == 0 || pos + 3 + length > size) {
+            return -1;
+        }
+        u8 sum = 0;
+        for (u32 i = 0; i < 3 + length; i++) {
+            sum = (u8)(sum + data[pos + i]);
+        }
+        if (sum != 0) {
+            return -1;
+        }
+        records[count].type = data[pos];
+        records[count].content = data + pos + 3;
+        records[count].length = length - 1;
+        count++;
+        pos += 3 + length;
+    }
+    *out_count = count;
+    return 0;
+}
+
+/* 取记录中的长度前缀名字 */
+static const char* get_name(const u8* p, char* buffer) {
+    for (u32 i = 0; i < p[0]; i++) {
+        buffer[i] = (char)p[1 + i];
+    }
+    buffer[p[0]] = '\0';
+    return buffer;
+}
+
+static AsmContext* create_context(AsmFormat format, u32 threads) {
+    AsmOptions options;
+    subas_options_init(&options);
+    options.format = format;
+    options.pass_one_threads = threads;
+    return subas_context_create(&options);
+}
+
+/*
+ * 以 OBJ 格式汇编 source 并组装模块
+ */
+static int build_module(AsmContext* ctx, const char* source, const char* name, u8** data, u32* size) {
+    AsmOutput output;
+    ObjModule module;
+
+    if (subas_assemble(ctx, source, util_strlen(source), &output) != 0) {
+        return -1;
+    }
+    module.source = name;
+    module.pass_one = subas_get_pass_one(ctx);
+    module.code = output.code;
+    module.size = output.size;
+    module.offsets = output.instruction_offsets;
+    module.relocations = output.relocations;
+    module.relocation_count = output.relocation_count;
+    return objfile_build(&module, data, size);
+}
+
+static void test_objfile_records(void) {
+    printf("\n=== ObjFile: Record Sequence ===\n");
+
+    AsmContext* ctx = create_context(SUBAS_FORMAT_OBJ, 1);
+    Record records[MAX_RECORDS];
+    u32 count = 0;
+    u8* data = NULL_PTR;
+    u32 size = 0;
+    char name[256];
+
+    ASSERT_EQ(build_module(ctx, module_source, "src/dir/mod.asm", &data, &size), 0, "module built");
+    ASSERT_EQ(split_records(data, size, records, &count), 0, "lengths and checksums valid");
+    ASSERT_EQ(count, 8, "eight records");
+
+    static const u32 expected_types[] = {
+        OMF_THEADR, OMF_LNAMES, OMF_SEGDEF, OMF_EXTDEF, OMF_PUBDEF, OMF_LEDATA, OMF_FIXUPP, OMF_MODEND
+    };
+    int order_ok = (count == 8);
+    for (u32 i = 0; order_ok && i < count; i++) {
+        order_ok = (records[i].type == expected_types[i]);
+    }
+    ASSERT_EQ(order_ok, 1, "record order");
+    if (!order_ok) {
+        util_free(data);
+        subas_context_destroy(ctx);
+        return;
+    }
+
+    ASSERT_STR_EQ(get_name(records[0].content, name), "mod", "module name from the file name");
+
+    const u8* p = records[1].content;
+    ASSERT_EQ(p[0], 0, "first name is empty");
+    ASSERT_STR_EQ(get_name(p + 1, name), "CODE", "segment name from SEGMENT");
+    ASSERT_STR_EQ(get_name(p + 6, name), OBJFILE_CLASS_NAME, "class name");
+
+    p = records[2].content;
+    ASSERT_EQ(p[0], 0x68, "paragraph-aligned public segment");
+    ASSERT_EQ(get_u16(p + 1), 17, "segment length is the image size");
+    ASSERT_EQ(p[3] == 2 && p[4] == 3 && p[5] == 1, 1, "segment, class and overlay name indices");
+
+    /* 外部符号按名字顺序：count = 1，helper = 2 */
+    p = records[3].content;
+    ASSERT_STR_EQ(get_name(p, name), "count", "first external");
+    ASSERT_STR_EQ(get_name(p + 7, name), "helper", "second external (type suffix dropped)");
+    ASSERT_EQ(records[3].length, 7 + 8, "two EXTDEF entries");
+
+    p = records[4].content;
+    ASSERT_EQ(p[0] == 0 && p[1] == 1, 1, "publics in segment 1 without a group");
+    ASSERT_STR_EQ(get_name(p + 2, name), "main", "first public");
+    ASSERT_EQ(get_u16(p + 7), 0, "main offset");
+    ASSERT_STR_EQ(get_name(p + 10, name), "exit", "second public");
+    ASSERT_EQ(get_u16(p + 15), 15, "exit offset (emitted)");
+
+    p = records[5].content;
+    ASSERT_EQ(p[0] == 1 && get_u16(p + 1) == 0, 1, "data of segment 1 at offset 0");
+    ASSERT_EQ(records[5].length, 3 + 17, "whole image in one LEDATA");
+    ASSERT_EQ(get_u16(p + 3 + 9), 15, "label reference keeps its offset as the addend");
+
+    /* FIXUPP：locat(2) + fixdat(1) + 目标索引(1) */
+    p = records[6].content;
+    ASSERT_EQ(records[6].length, 4 * 4, "four fixups");
+    ASSERT_EQ(p[0] == 0x84 && p[1] == 1 && p[2] == 0x56 && p[3] == 2, 1,
+              "CALL helper: self-relative to external 2");
+    ASSERT_EQ(p[4] == 0xC4 && p[5] == 5 && p[6] == 0x56 && p[7] == 1, 1, "MOV AX, count: external 1");
+    ASSERT_EQ(p[8] == 0xC4 && p[9] == 9 && p[10] == 0x54 && p[11] == 1, 1, "MOV BX, exit: offset in segment 1");
+    ASSERT_EQ(p[12] == 0xC8 && p[13] == 13 && p[14] == 0x54 && p[15] == 1, 1, "MOV CX, CODE: segment base");
+
+    p = records[7].content;
+    ASSERT_EQ(p[0], 0xC1, "main module with a start address");
+    ASSERT_EQ(p[2] == 1 && p[3] == 1 && get_u16(p + 4) == 0, 1, "start address is main");
+
+    util_free(data);
+    subas_context_destroy(ctx);
+}
+
+static void test_objfile_blocks(void) {
+    printf("\n=== ObjFile: LEDATA Blocks ===\n");
+
+    /* 1021 字节数据后的 MOV AX, tail：引用字位于 1023..1024，跨过第一块的边界 */
+    static char source[8192];
+    u32 len = 0;
+    for (u32 i = 0; i < 1021; i++) {
+        const char* line = "DB 7\n";
+        for (u32 k = 0; line[k] != '\0'; k++) {
+            source[len++] = line[k];
+        }
+    }
+    const char* tail = "tail: MOV AX, tail\nEND\n";
+    for (u32 k = 0; tail[k] != '\0'; k++) {
+        source[len++] = tail[k];
+    }
+    source[len] = '\0';
+
+    AsmContext* ctx = create_context(SUBAS_FORMAT_OBJ, 1);
+    Record records[MAX_RECORDS];
+    u32 count = 0;
+    u8* data = NULL_PTR;
+    u32 size = 0;
+    char name[256];
+
+    ASSERT_EQ(build_module(ctx, source, "blocks.asm", &data, &size), 0, "module built");
+    ASSERT_EQ(split_records(data, size, records, &count), 0, "lengths and checksums valid");
+    ASSERT_EQ(count, 7, "seven records");
+    if (count == 7) {
+        ASSERT_STR_EQ(get_name(records[1].content + 1, name), OBJFILE_DEFAULT_SEGMENT,
+                      "default segment name");
+        ASSERT_EQ(records[3].type, OMF_LEDATA, "first block");
+        ASSERT_EQ(records[3].length, 3 + 1023, "first block stops before the reference word");
+        ASSERT_EQ(records[4].type, OMF_LEDATA, "second block follows without fixups");
+        ASSERT_EQ(get_u16(records[4].content + 1), 1023, "second block offset");
+        ASSERT_EQ(records[4].length, 3 + 2, "second block holds the reference word");
+        ASSERT_EQ(records[5].type, OMF_FIXUPP, "fixups after the second block");
+        ASSERT_EQ(records[5].content[0] == 0xC4 && records[5].content[1] == 0, 1,
+                  "fixup at the start of the block");
+        ASSERT_EQ(records[6].type, OMF_MODEND, "module end");
+        ASSERT_EQ(records[6].content[0], 0x00, "END without a label: not a main module");
+    }
+    ASSERT_EQ(records[2].type, OMF_SEGDEF, "no EXTDEF or PUBDEF without declarations");
+
+    util_free(data);
+    subas_context_destroy(ctx);
+}
+
+static void test_objfile_displacements(void) {
+    printf("\n=== ObjFile: Self-Relative Branch Fixups ===\n");
+
+    /* 字段位置：JMP 2、CALL 5、LOOP 8、MOV AX 12 */
+    const char* source =
+        "start: NOP\n"
+        "    JMP start\n"
+        "    CALL start\n"
+        "    LOOP start\n"
+        "    MOV AX, start\n";
+    AsmContext* ctx = create_context(SUBAS_FORMAT_OBJ, 1);
+    Record records[MAX_RECORDS];
+    u32 count = 0;
+    u8* data = NULL_PTR;
+    u32 size = 0;
+
+    ASSERT_EQ(build_module(ctx, source, "branch.asm", &data, &size), 0, "module built");
+    ASSERT_EQ(split_records(data, size, records, &count), 0, "lengths and checksums valid");
+    ASSERT_EQ(count, 6, "six records");
+    if (count == 6) {
+        const u8* p = records[4].content;
+        ASSERT_EQ(records[4].type, OMF_FIXUPP, "fixups follow the data");
+        ASSERT_EQ(records[4].length, 4 * 4, "four fixups");
+        ASSERT_EQ(p[0] == 0x84 && p[1] == 2 && p[2] == 0x54 && p[3] == 1, 1, "JMP: self-relative");
+        ASSERT_EQ(p[4] == 0x84 && p[5] == 5 && p[6] == 0x54 && p[7] == 1, 1, "CALL: self-relative");
+        ASSERT_EQ(p[8] == 0x84 && p[9] == 8 && p[10] == 0x54 && p[11] == 1, 1, "LOOP: self-relative");
+        ASSERT_EQ(p[12] == 0xC4 && p[13] == 12 && p[14] == 0x54 && p[15] == 1, 1,
+                  "MOV AX, start: segment-relative");
+        ASSERT_EQ(get_u16(records[3].content + 3 + 2), 0, "JMP addend is the label offset");
+    }
+
+    util_free(data);
+    subas_context_destroy(ctx);
+}
+
+/*
+ * 变长代码之后的 PUBLIC 标签：PUBDEF、MODEND 与修正的加数都取机器码的实际偏移
+ * （第一遍按 DB 与指令的估计长度给出的地址与之不同）
+ */
+static void test_objfile_emitted_offsets(void) {
+    printf("\n=== ObjFile: Publics After Variable-Length Code ===\n");
+
+    /* msg 0..4，start 5（4 字节 MOV），JMP 字段 10，MOV BX 字段 14，done 16 */
+    const char* source =
+        "PUBLIC start, done\n"
+        "msg DB 1, 2, 3, 4, 5\n"
+        "start: MOV AX, 1234H\n"
+        "    JMP done\n"
+        "    MOV BX, done\n"
+        "done: INT 20h\n"
+        "END start\n";
+    AsmContext* ctx = create_context(SUBAS_FORMAT_OBJ, 1);
+    Record records[MAX_RECORDS];
+    u32 count = 0;
+    u8* data = NULL_PTR;
+    u32 size = 0;
+    char name[256];
+
+    ASSERT_EQ(build_module(ctx, source, "late.asm", &data, &size), 0, "module built");
+    ASSERT_EQ(split_records(data, size, records, &count), 0, "lengths and checksums valid");
+    ASSERT_EQ(count, 7, "seven records");
+    if (count == 7) {
+        const u8* p = records[3].content;
+        ASSERT_EQ(records[3].type, OMF_PUBDEF, "publics");
+        ASSERT_STR_EQ(get_name(p + 2, name), "start", "first public");
+        ASSERT_EQ(get_u16(p + 8), 5, "start offset follows the data");
+        ASSERT_STR_EQ(get_name(p + 11, name), "done", "second public");
+        ASSERT_EQ(get_u16(p + 16), 16, "done offset follows the 4-byte MOV");
+
+        p = records[4].content;
+        ASSERT_EQ(records[4].length, 3 + 18, "whole image in one LEDATA");
+        ASSERT_EQ(p[3 + 16], 0xCD, "INT 20h is at the public offset");
+        ASSERT_EQ(get_u16(p + 3 + 10), 16, "JMP addend is the emitted offset");
+        ASSERT_EQ(get_u16(p + 3 + 14), 16, "MOV BX addend is the emitted offset");
+
+        p = records[5].content;
+        ASSERT_EQ(p[0] == 0x84 && p[1] == 10, 1, "JMP: self-relative at its field");
+        ASSERT_EQ(p[4] == 0xC4 && p[5] == 14, 1, "MOV BX, done: segment-relative at its field");
+
+        p = records[6].content;
+        ASSERT_EQ(p[0] == 0xC1 && get_u16(p + 4) == 5, 1, "start address is the emitted offset");
+    }
+
+    util_free(data);
+    subas_context_destroy(ctx);
+}
+
+static void test_objfile_errors(void) {
+    printf("\n=== ObjFile: Declaration Errors ===\n");
+
+    AsmContext* ctx = create_context(SUBAS_FORMAT_COM, 1);
+    AsmOutput output;
+    const ErrorRecord* diagnostics;
+    u32 count = 0;
+
+    ASSERT_EQ(subas_assemble(ctx, module_source, util_strlen(module_source), &output), -1,
+              "external references rejected for .COM");
+    diagnostics = subas_get_diagnostics(ctx, &count);
+    ASSERT_EQ(count == 1 && diagnostics[0].code == ERR_PARSE_EXTERN_REF && diagnostics[0].line == 5, 1,
+              "E2007 on the first reference");
+    subas_context_destroy(ctx);
+
+    ctx = create_context(SUBAS_FORMAT_EXE, 1);
+    ASSERT_EQ(subas_assemble(ctx, module_source, util_strlen(module_source), &output), -1,
+              "external references rejected for .EXE");
+    diagnostics = subas_get_diagnostics(ctx, &count);
+    ASSERT_EQ(count == 1 && diagnostics[0].code == ERR_PARSE_EXTERN_REF, 1, "E2007 for .EXE");
+    subas_context_destroy(ctx);
+
+    /* 未被引用的 EXTRN 不影响 .COM 输出 */
+    const char* unused = "EXTRN spare\nMOV AX, 1\n";
+    ctx = create_context(SUBAS_FORMAT_COM, 1);
+    ASSERT_EQ(subas_assemble(ctx, unused, util_strlen(unused), &output), 0, "unused EXTRN accepted");
+    ASSERT_EQ(output.size, 3, "EXTRN emits no code");
+    subas_context_destroy(ctx);
+
+    const char* duplicate = "EXTRN foo\nfoo: NOP\nEXTRN bar, bar\n";
+    ctx = create_context(SUBAS_FORMAT_OBJ, 1);
+    ASSERT_EQ(subas_assemble(ctx, duplicate, util_strlen(duplicate), &output), -1,
+              "duplicate declarations rejected");
+    diagnostics = subas_get_diagnostics(ctx, &count);
+    ASSERT_EQ(count == 2 && diagnostics[0].code == ERR_PARSE_DUP_LABEL && diagnostics[0].line == 2 &&
+              diagnostics[1].code == ERR_PARSE_DUP_LABEL && diagnostics[1].line == 3, 1,
+              "E2004 for a label and a repeated EXTRN");
+    subas_context_destroy(ctx);
+
+    const char* not_a_name = "EXTRN AX\n";
+    ctx = create_context(SUBAS_FORMAT_OBJ, 1);
+    ASSERT_EQ(subas_assemble(ctx, not_a_name, util_strlen(not_a_name), &output), -1,
+              "register in EXTRN rejected");
+    diagnostics = subas_get_diagnostics(ctx, &count);
+    ASSERT_EQ(count == 1 && diagnostics[0].code == ERR_PARSE_EXPECTED_OP, 1, "E2001 for EXTRN AX");
+    subas_context_destroy(ctx);
+
+    /* PUBLIC 的名字必须在本模块中定义 */
+    const char* bad_public = "EXTRN ext\nPUBLIC ext, start, nowhere\nstart: NOP\n";
+    ErrorBuffer captured;
+    u8* data = NULL_PTR;
+    u32 size = 0;
+    ctx = create_context(SUBAS_FORMAT_OBJ, 1);
+    error_buffer_init(&captured);
+    error_capture_begin(&captured);
+    ASSERT_EQ(build_module(ctx, bad_public, "bad.asm", &data, &size), -1, "invalid PUBLIC rejected");
+    error_capture_end();
+    ASSERT_EQ(captured.count, 2, "external and undefined names reported");
+    if (captured.count == 2) {
+        ASSERT_EQ(captured.records[0].code == ERR_PARSE_UNDEFINED_LBL && captured.records[0].line == 2, 1,
+                  "E2005 for the external name");
+        ASSERT_STR_EQ(captured.records[1].detail, "nowhere", "E2005 for the undefined name");
+    }
+    ASSERT_EQ(data == NULL_PTR && size == 0, 1, "no module on failure");
+    error_buffer_dispose(&captured);
+    subas_context_destroy(ctx);
+}
+
+static void test_objfile_paths(void) {
+    printf("\n=== ObjFile: Parallel, IR and Incremental ===\n");
+
+    /* 足以分成多块的源文本：EXTRN 位于中部，引用在末尾 */
+    static char source[200000];
+    u32 len = 0;
+    for (u32 i = 0; i < 30000; i++) {
+        const char* line = (i == 15000) ? "EXTRN far_away\n" : "NOP\n";
+        for (u32 k = 0; line[k] != '\0'; k++) {
+            source[len++] = line[k];
+        }
+    }
+    const char* tail = "PUBLIC last\nlast: MOV AX, far_away\n";
+    for (u32 k = 0; tail[k] != '\0'; k++) {
+        source[len++] = tail[k];
+    }
+    source[len] = '\0';
+
+    AsmContext* serial = create_context(SUBAS_FORMAT_OBJ, 1);
+    AsmContext* parallel = create_context(SUBAS_FORMAT_OBJ, 4);
+    u8* serial_data = NULL_PTR;
+    u8* parallel_data = NULL_PTR;
+    u32 serial_size = 0;
+    u32 parallel_size = 0;
+
+    ASSERT_EQ(build_module(serial, source, "big.asm", &serial_data, &serial_size), 0, "serial module built");
+    ASSERT_EQ(build_module(parallel, source, "big.asm", &parallel_data, &parallel_size), 0,
+              "parallel module built");
+    int same = (serial_size == parallel_size && serial_size > 0);
+    for (u32 i = 0; same && i < serial_size; i++) {
+        same = (serial_data[i] == parallel_data[i]);
+    }
+    ASSERT_EQ(same, 1, "parallel pass one gives the same module");
+    const SymbolInfo* info = symtab_lookup(subas_get_pass_one(parallel)->symtab, "far_away");
+    ASSERT_EQ(info != NULL_PTR && info->type == SYM_EXTERNAL && info->line_defined == 15001, 1,
+              "external merged from its chunk");
+
+    /* IR 保留外部符号：由 IR 执行第二遍扫描得到同一模块 */
+    ASSERT_EQ(irfile_write(subas_get_pass_one(serial), TEST_IR), 0, "IR written");
+    AsmOutput output;
+    ASSERT_EQ(subas_assemble_ir(parallel, TEST_IR, &output), 0, "assembled from IR");
+    ObjModule module;
+    module.source = "big.asm";
+    module.pass_one = subas_get_pass_one(parallel);
+    module.code = output.code;
+    module.size = output.size;
+    module.offsets = output.instruction_offsets;
+    module.relocations = output.relocations;
+    module.relocation_count = output.relocation_count;
+    ASSERT_EQ(objfile_write(TEST_OBJ, &module), 0, "module written from IR");
+
+    FILE* fp = fopen(TEST_OBJ, "rb");
+    u32 got = 0;
+    same = 0;
+    if (fp != NULL_PTR) {
+        u8* buffer = (u8*)util_malloc(serial_size + 1);
+        if (buffer != NULL_PTR) {
+            got = (u32)fread(buffer, 1, serial_size + 1, fp);
+            same = (got == serial_size);
+            for (u32 i = 0; same && i < got; i++) {
+                same = (buffer[i] == serial_data[i]);
+            }
+            util_free(buffer);
+        }
+        fclose(fp);
+    }
+    ASSERT_EQ(same, 1, "IR path gives the same file");
+    remove(TEST_OBJ);
+    remove(TEST_IR);
+
+    util_free(serial_data);
+    util_free(parallel_data);
+    subas_context_destroy(serial);
+    subas_context_destroy(parallel);
+
+    /* 增量汇编维护 .COM 映像：编辑涉及 EXTRN 行时退回完整汇编 */
+    const char* text = "EXTRN ext\nNOP\n";
+    IncrementalAsm* inc = incremental_create(text, util_strlen(text));
+    ASSERT_EQ(incremental_has_errors(inc), 0, "unused EXTRN assembles incrementally");
+    incremental_edit(inc, 10, 3, "MOV AX, ext", 11);
+    ASSERT_EQ(incremental_has_errors(inc), 1, "new external reference reported");
+    incremental_edit(inc, 10, 11, "NOP", 3);
+    ASSERT_EQ(incremental_has_errors(inc), 0, "reference removed");
+    u32 full_builds = incremental_get_stats(inc)->full_builds;
+    incremental_edit(inc, 0, 10, "", 0);
+    ASSERT_EQ(incremental_get_stats(inc)->full_builds, full_builds + 1, "removing EXTRN rebuilds");
+    incremental_edit(inc, 0, 0, "MOV AX, ext\n", 12);
+    ASSERT_EQ(incremental_has_errors(inc), 1, "removed external is undefined");
+    incremental_destroy(inc);
+}
+
+/* =========================================================================
+ * 主测试入口
+ * ========================================================================= */
+
+int main(void) {
+    printf("========================================\n");
+    printf("  OBJ FILE MODULE UNIT TESTS\n");
+    printf("========================================\n");
+
+    test_objfile_records();
+    test_objfile_blocks();
+    test_objfile_displacements();
+    test_objfile_emitted_offsets();
+    test_objfile_errors();
+    test_objfile_paths();
+
+    printf("\n========================================\n");
+    printf("TEST RESULTS SUMMARY\n");
+    printf("========================================\n");
+    printf("Passed: %u\n", test_passed);
+    printf("Failed: %u\n", test_failed);
+    printf("Total:  %u\n", test_passed + test_failed);
+
+    if (test_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
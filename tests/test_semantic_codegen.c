@@ -11,8 +11,9 @@
  * 编译命令（在项目根目录）：
  *   gcc -o tests/test_semantic_codegen tests/test_semantic_codegen.c \
  *       src/semantic.c src/codegen.c src/tables.c src/symtab.c \
- *       src/lexer.c src/utils/memory.c src/utils/string.c \
- *       src/utils/hash.c src/error.c -I. -Wall -Wextra
+ *       src/pipeline.c src/lexer.c src/utils/memory.c src/utils/string.c \
+ *       src/utils/hash.c src/utils/thread.c src/utils/queue.c src/error.c \
+ *       -I. -Wall -Wextra -lpthread
  *
  * ============================================================================
  */
@@ -21,6 +22,7 @@
 #include "../include/semantic.h"
 #include "../include/codegen.h"
 #include "../include/lexer.h"
+#include "../include/pipeline.h"
 
 #define ASSERT_EQ(actual, expected, msg) \
     do { \
@@ -44,6 +46,17 @@
         } \
     } while (0)
 
+#define ASSERT_PTR_EQ_NULL(actual, msg) \
+    do { \
+        if ((actual) != NULL_PTR) { \
+            printf("  [FAIL] %s: pointer should be NULL\n", (msg)); \
+            test_failed++; \
+        } else { \
+            printf("  [PASS] %s\n", (msg)); \
+            test_passed++; \
+        } \
+    } while (0)
+
 static u32 test_passed = 0;
 static u32 test_failed = 0;
 
@@ -428,6 +441,206 @@ static void test_full_two_pass(void) {
     }
 }
 
+/* =========================================================================
+ * 并行第一遍扫描测试
+ * ========================================================================= */
+
+/*
+ * 把源文本完整切分为 Token 数组（调用者负责释放）
+ */
+static Token* lex_all(const char* src, u32* out_count) {
+    Lexer* lx = lexer_create_from_string(src);
+    u32 capacity = 1024;
+    u32 count = 0;
+    Token* tokens = (Token*)util_malloc(sizeof(Token) * capacity);
+
+    for (;;) {
+        if (count >= capacity) {
+            Token* grown = (Token*)util_malloc(sizeof(Token) * capacity * 2);
+            for (u32 i = 0; i < count; i++) grown[i] = tokens[i];
+            util_free(tokens);
+            tokens = grown;
+            capacity *= 2;
+        }
+        tokens[count] = lexer_next_token(lx);
+        if (tokens[count++].type == TOK_EOF) break;
+    }
+
+    lexer_destroy(lx);
+    *out_count = count;
+    return tokens;
+}
+
+static void free_tokens(Token* tokens, u32 count) {
+    for (u32 i = 0; i < count; i++) token_dispose(&tokens[i]);
+    util_free(tokens);
+}
+
+/*
+ * 标签引用按机器码的实际偏移填充：DB 与 2 字节立即数使第一遍估计的地址偏离
+ */
+static void test_codegen_emitted_offsets(void) {
+    printf("\n=== CodeGen: Labels Resolve to Emitted Offsets ===\n");
+
+    const char* src =
+        "MSG:   DB 1, 2, 3, 4, 5\n"
+        "START: MOV AX, 1234H\n"
+        "NEXT:  MOV BX, MSG\n"
+        "       JMP START\n"
+        "       JMP NEXT\n";
+    u32 token_count = 0;
+    Token* tokens = lex_all(src, &token_count);
+    PassOne* pass_one = semantic_pass_one(tokens, token_count);
+    CodeGen* codegen = (pass_one != NULL) ? codegen_pass_two(pass_one) : NULL;
+
+    ASSERT_PTR_NEQ(codegen, NULL_PTR, "program assembled");
+    if (codegen != NULL) {
+        const u32* offsets = codegen_get_instruction_offsets(codegen);
+        const u8* code = codegen->code_buffer;
+
+        ASSERT_EQ(offsets[1], 5, "START follows the 5 data bytes");
+        ASSERT_EQ(offsets[2], 9, "NEXT follows the 2-byte immediate");
+        ASSERT_EQ(symtab_lookup(pass_one->symtab, "START")->address, 5, "START symbol at its emitted offset");
+        ASSERT_EQ(symtab_lookup(pass_one->symtab, "NEXT")->address, 9, "NEXT symbol at its emitted offset");
+        ASSERT_EQ(code[11] | (code[12] << 8), 0, "MOV BX, MSG refers to offset 0");
+        ASSERT_EQ(code[14] | (code[15] << 8), 5, "JMP START refers to offset 5");
+        ASSERT_EQ(code[17] | (code[18] << 8), 9, "JMP NEXT refers to offset 9");
+        ASSERT_EQ(symtab_find_by_address(pass_one->symtab, 9) == symtab_lookup(pass_one->symtab, "NEXT"), 1,
+                  "address index follows the new addresses");
+        codegen_destroy(codegen);
+    }
+
+    semantic_pass_one_destroy(pass_one);
+    free_tokens(tokens, token_count);
+}
+
+/*
+ * 生成含大量标签的源程序：每 4 行一个标签，可选在末尾重复第一个标签
+ */
+static char* build_large_source(u32 line_count, int duplicate_first) {
+    char* src = (char*)util_malloc(line_count * 32 + 64);
+    char* p = src;
+
+    for (u32 n = 0; n < line_count; n++) {
+        if (n % 4 == 0) {
+            p += sprintf(p, "L%u: MOV AX, %u\n", n, n & 0xFF);
+        } else if (n % 4 == 1) {
+            p += sprintf(p, "    DB %u\n", n & 0xFF);
+        } else {
+            p += sprintf(p, "    JMP L%u\n", n - (n % 4));
+        }
+    }
+    if (duplicate_first) {
+        p += sprintf(p, "L0: NOP\n");
+    }
+    *p = '\0';
+    return src;
+}
+
+static void test_semantic_pass_one_parallel(void) {
+    printf("\n=== Semantic: Parallel Pass One ===\n");
+
+    char* src = build_large_source(20000, 0);
+    u32 token_count = 0;
+    Token* tokens = lex_all(src, &token_count);
+
+    PassOne* serial = semantic_pass_one(tokens, token_count);
+    PassOne* parallel = semantic_pass_one_parallel(tokens, token_count, 4);
+    ASSERT_PTR_NEQ(serial, NULL_PTR, "serial pass one succeeded");
+    ASSERT_PTR_NEQ(parallel, NULL_PTR, "parallel pass one succeeded");
+
+    if (serial != NULL && parallel != NULL) {
+        u32 mismatches = 0;
+        ASSERT_EQ(parallel->instruction_count, serial->instruction_count, "same instruction count");
+        ASSERT_EQ(parallel->current_address, serial->current_address, "same code size");
+        ASSERT_EQ(symtab_get_symbol_count(parallel->symtab),
+                  symtab_get_symbol_count(serial->symtab), "same symbol count");
+
+        for (u32 i = 0; i < serial->instruction_count && i < parallel->instruction_count; i++) {
+            if (serial->instructions[i].address != parallel->instructions[i].address ||
+                serial->instructions[i].line != parallel->instructions[i].line) {
+                mismatches++;
+            }
+        }
+        ASSERT_EQ(mismatches, 0, "addresses and lines match serial scan");
+
+        SymbolInfo* a = symtab_lookup(serial->symtab, "L19996");
+        SymbolInfo* b = symtab_lookup(parallel->symtab, "L19996");
+        ASSERT_PTR_NEQ(b, NULL_PTR, "last label merged");
+        if (a != NULL && b != NULL) {
+            ASSERT_EQ(b->address, a->address, "rebased label address");
+            ASSERT_EQ(b->line_defined, a->line_defined, "rebased label line");
+        }
+    }
+
+    semantic_pass_one_destroy(serial);
+    semantic_pass_one_destroy(parallel);
+    free_tokens(tokens, token_count);
+    util_free(src);
+
+    /* 跨块重复标签：与串行扫描报告相同数量的错误 */
+    src = build_large_source(20000, 1);
+    tokens = lex_all(src, &token_count);
+
+    error_init();
+    serial = semantic_pass_one(tokens, token_count);
+    u32 serial_errors = error_get_count();
+    error_init();
+    parallel = semantic_pass_one_parallel(tokens, token_count, 4);
+    u32 parallel_errors = error_get_count();
+    error_init();
+
+    ASSERT_PTR_NEQ(parallel, NULL_PTR, "scan completes despite duplicate label");
+    ASSERT_EQ(parallel != NULL_PTR && parallel->has_errors, 1,
+              "duplicate label across chunks flagged");
+    ASSERT_EQ(parallel_errors, serial_errors, "same duplicate-label error count");
+
+    semantic_pass_one_destroy(serial);
+    semantic_pass_one_destroy(parallel);
+    free_tokens(tokens, token_count);
+    util_free(src);
+}
+
+static void test_pipeline_matches_serial(void) {
+    printf("\n=== Pipeline: Matches Serial Assembly ===\n");
+
+    /* 1600 行约 6400 个 Token，跨越多个流水线批次 */
+    char* src = build_large_source(1600, 0);
+    u32 token_count = 0;
+    Token* tokens = lex_all(src, &token_count);
+
+    PassOne* pass_one = semantic_pass_one(tokens, token_count);
+    CodeGen* serial = codegen_pass_two(pass_one);
+    PipelineResult piped;
+    int rc = pipeline_assemble(src, util_strlen(src), NULL_PTR, &piped);
+
+    ASSERT_PTR_NEQ(serial, NULL_PTR, "serial assembly succeeded");
+    ASSERT_EQ(rc, 0, "pipeline assembly succeeded");
+
+    if (serial != NULL && rc == 0) {
+        u32 serial_size = 0;
+        u32 piped_size = 0;
+        u8* a = codegen_get_code_buffer(serial, &serial_size);
+        u8* b = codegen_get_code_buffer(piped.codegen, &piped_size);
+        u32 mismatches = 0;
+
+        ASSERT_EQ(piped.token_count, token_count, "same token count");
+        ASSERT_EQ(piped.pass_one->instruction_count, pass_one->instruction_count,
+                  "same instruction count");
+        ASSERT_EQ(piped_size, serial_size, "same code size");
+        for (u32 i = 0; i < serial_size && i < piped_size; i++) {
+            if (a[i] != b[i]) mismatches++;
+        }
+        ASSERT_EQ(mismatches, 0, "identical machine code");
+        pipeline_result_destroy(&piped);
+    }
+
+    codegen_destroy(serial);
+    semantic_pass_one_destroy(pass_one);
+    free_tokens(tokens, token_count);
+    util_free(src);
+}
+
 /* =========================================================================
  * 主测试入口
  * ========================================================================= */
@@ -448,10 +661,15 @@ int main(void) {
     test_codegen_pass_two();
     test_codegen_label_resolve();
     test_codegen_forward_ref();
+    test_codegen_emitted_offsets();
 
     /* 集成测试 */
     test_full_two_pass();
 
+    /* 并行扫描测试 */
+    test_semantic_pass_one_parallel();
+    test_pipeline_matches_serial();
+
     printf("\n============================================\n");
     printf("TEST RESULTS SUMMARY\n");
     printf("============================================\n");
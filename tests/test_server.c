@@ -0,0 +1,300 @@
+﻿/*
+ * ============================================================================
+ * 文件名: test_server.c
+ * 描述  : 汇编服务 (server) 模块单元测试
+ *
+ * 测试覆盖范围：
+ *  - 服务端汇编结果与本地 subas_assemble 逐字节一致
+ *  - 错误应答携带错误数与诊断文本，诊断上限按请求生效
+ *  - 按路径请求由服务端读取源文件；文件不存在时报告 E3002
+ *  - 多个客户端线程并发请求
+ *  - 已有服务端在监听时拒绝再次监听；关闭后删除套接字文件
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "../include/server.h"
+
+#define ASSERT_EQ(actual, expected, msg) \
+    do { \
+        if ((actual) != (expected)) { \
+            printf("  [FAIL] %s: expected %d, got %d\n", (msg), (int)(expected), (int)(actual)); \
+            test_failed++; \
+        } else { \
+            printf("  [PASS] %s\n", (msg)); \
+            test_passed++; \
+        } \
+    } while (0)
+
+#define CLIENT_THREADS      4
+#define CLIENT_REQUESTS     25
+
+static u32 test_passed = 0;
+static u32 test_failed = 0;
+
+static char g_socket[64];
+static int g_server_result = -1;
+
+static const char* PROGRAM =
+    "ORG 100H\n"
+    "START: MOV AX, 1234H\n"
+    "       MOV BX, AX\n"
+    "LOOP1: SUB BX, 1\n"
+    "       JNZ LOOP1\n"
+    "       JMP DONE\n"
+    "MSG    DB 48H, 49H, 0\n"
+    "DONE:  INT 20H\n";
+
+static const char* BAD_PROGRAM =
+    "MOV AX, 1\n"
+    "FOO BX\n"
+    "MOV CX, MISSING\n";
+
+/* ========================================================================= */
+/* 辅助函数 */
+/* ========================================================================= */
+
+/*
+ * 服务端线程
+ */
+static void server_thread(void* arg) {
+    (void)arg;
+    g_server_result = server_run(g_socket, 2, NULL_PTR);
+}
+
+/*
+ * 文本 text（长 len）中是否含有 needle
+ */
+static int contains(const char* text, u32 len, const char* needle) {
+    u32 n = util_strlen(needle);
+
+    if (text == NULL_PTR) return 0;
+    for (u32 i = 0; i + n <= len; i++) {
+        u32 k = 0;
+        while (k < n && text[i + k] == needle[k]) k++;
+        if (k == n) return 1;
+    }
+    return 0;
+}
+
+/*
+ * 本地汇编 PROGRAM 作为参照
+ */
+static u8* assemble_locally(const char* src, u32* out_size) {
+    AsmContext* ctx = subas_context_create(NULL_PTR);
+    AsmOutput out;
+    u8* copy = NULL_PTR;
+
+    *out_size = 0;
+    if (ctx != NULL_PTR && subas_assemble(ctx, src, util_strlen(src), &out) == 0) {
+        copy = (u8*)util_malloc(out.size);
+        for (u32 i = 0; copy != NULL_PTR && i < out.size; i++) copy[i] = out.code[i];
+        *out_size = out.size;
+    }
+    subas_context_destroy(ctx);
+    return copy;
+}
+
+/*
+ * 应答中的机器码是否与参照一致
+ */
+static int same_code(const ServerReply* reply, const u8* expected, u32 size) {
+    if (reply->status != 0 || reply->code_size != size) return 0;
+    for (u32 i = 0; i < size; i++) {
+        if (reply->code[i] != expected[i]) return 0;
+    }
+    return 1;
+}
+
+/* 并发客户端 */
+typedef struct {
+    const u8* expected;
+    u32 size;
+    u32 mismatches;
+} ClientJob;
+
+static void client_thread(void* arg) {
+    ClientJob* job = (ClientJob*)arg;
+
+    for (u32 i = 0; i < CLIENT_REQUESTS; i++) {
+        ServerReply reply;
+        if (server_assemble(g_socket, SERVER_REQ_ASSEMBLE, PROGRAM, util_strlen(PROGRAM), 0,
+                            &reply) != 0 || !same_code(&reply, job->expected, job->size)) {
+            job->mismatches++;
+        }
+        server_reply_dispose(&reply);
+    }
+}
+
+/* ========================================================================= */
+/* 测试用例 */
+/* ========================================================================= */
+
+static void test_assemble(const u8* expected, u32 size) {
+    ServerReply reply;
+
+    printf("\n[TEST] Assemble request\n");
+
+    ASSERT_EQ(server_assemble(g_socket, SERVER_REQ_ASSEMBLE, PROGRAM, util_strlen(PROGRAM), 0,
+                              &reply), 0, "request answered");
+    ASSERT_EQ(reply.status, 0, "assembly succeeded");
+    ASSERT_EQ(reply.error_count, 0, "no errors");
+    ASSERT_EQ(reply.diagnostics_size, 0, "no diagnostics");
+    ASSERT_EQ(same_code(&reply, expected, size), 1, "code matches local assembly");
+    server_reply_dispose(&reply);
+}
+
+static void test_errors(void) {
+    ServerReply reply;
+
+    printf("\n[TEST] Error reply\n");
+
+    server_assemble(g_socket, SERVER_REQ_ASSEMBLE, BAD_PROGRAM, util_strlen(BAD_PROGRAM), 0,
+                    &reply);
+    ASSERT_EQ(reply.status, -1, "assembly failed");
+    ASSERT_EQ(reply.error_count, 2, "both errors counted");
+    ASSERT_EQ(reply.code_size, 0, "no code");
+    ASSERT_EQ(contains(reply.diagnostics, reply.diagnostics_size, "[Line 2] Error E2003"), 1,
+              "unknown mnemonic reported");
+    ASSERT_EQ(contains(reply.diagnostics, reply.diagnostics_size, "MISSING"), 1,
+              "undefined label reported");
+    ASSERT_EQ(contains(reply.diagnostics, reply.diagnostics_size, "2 | FOO BX"), 1,
+              "source snippet included");
+    server_reply_dispose(&reply);
+
+    /* 诊断上限按请求生效，错误总数不变 */
+    server_assemble(g_socket, SERVER_REQ_ASSEMBLE, BAD_PROGRAM, util_strlen(BAD_PROGRAM), 1,
+                    &reply);
+    ASSERT_EQ(reply.error_count, 2, "limited reply still counts every error");
+    ASSERT_EQ(contains(reply.diagnostics, reply.diagnostics_size, "MISSING"), 0,
+              "diagnostics beyond the limit omitted");
+    server_reply_dispose(&reply);
+
+    /* 失败之后同一服务端继续正常工作 */
+    server_assemble(g_socket, SERVER_REQ_ASSEMBLE, "NOP\n", 4, 0, &reply);
+    ASSERT_EQ(reply.status, 0, "next request succeeds");
+    ASSERT_EQ(reply.code_size, 1, "next request code size");
+    server_reply_dispose(&reply);
+}
+
+static void test_path(const u8* expected, u32 size) {
+    ServerReply reply;
+    char path[sizeof(g_socket) + 8];
+    FILE* fp;
+
+    printf("\n[TEST] Path request\n");
+
+    snprintf(path, sizeof(path), "%s.asm", g_socket);
+    fp = fopen(path, "w");
+    if (fp != NULL_PTR) {
+        fputs(PROGRAM, fp);
+        fclose(fp);
+    }
+    server_assemble(g_socket, SERVER_REQ_ASSEMBLE_PATH, path, util_strlen(path), 0, &reply);
+    ASSERT_EQ(same_code(&reply, expected, size), 1, "file read by server");
+    server_reply_dispose(&reply);
+    remove(path);
+
+    server_assemble(g_socket, SERVER_REQ_ASSEMBLE_PATH, path, util_strlen(path), 0, &reply);
+    ASSERT_EQ(reply.status, -1, "missing file fails");
+    ASSERT_EQ(reply.error_count, 1, "missing file error count");
+    ASSERT_EQ(contains(reply.diagnostics, reply.diagnostics_size, "E3002"), 1,
+              "missing file reported as I/O error");
+    server_reply_dispose(&reply);
+}
+
+static void test_concurrent(const u8* expected, u32 size) {
+    ClientJob jobs[CLIENT_THREADS];
+    UtilThread* threads[CLIENT_THREADS];
+    u32 mismatches = 0;
+
+    printf("\n[TEST] Concurrent clients\n");
+
+    for (u32 i = 0; i < CLIENT_THREADS; i++) {
+        jobs[i].expected = expected;
+        jobs[i].size = size;
+        jobs[i].mismatches = 0;
+        threads[i] = util_thread_create(client_thread, &jobs[i]);
+    }
+    for (u32 i = 0; i < CLIENT_THREADS; i++) {
+        util_thread_join(threads[i]);
+        mismatches += jobs[i].mismatches;
+    }
+    ASSERT_EQ(mismatches, 0, "every concurrent reply matches");
+}
+
+static void test_second_listener(void) {
+    printf("\n[TEST] Socket already served\n");
+
+    ASSERT_EQ(server_run(g_socket, 1, NULL_PTR), -1, "second server refused");
+    ASSERT_EQ(access(g_socket, F_OK), 0, "live socket left in place");
+}
+
+static void test_shutdown(UtilThread* thread) {
+    ServerReply reply;
+
+    printf("\n[TEST] Shutdown\n");
+
+    ASSERT_EQ(server_shutdown(g_socket), 0, "shutdown acknowledged");
+    util_thread_join(thread);
+    ASSERT_EQ(g_server_result, 0, "server_run returned 0");
+    ASSERT_EQ(access(g_socket, F_OK), -1, "socket file removed");
+    ASSERT_EQ(server_assemble(g_socket, SERVER_REQ_ASSEMBLE, "NOP\n", 4, 0, &reply), -1,
+              "stopped server unreachable");
+    ASSERT_EQ(server_shutdown(g_socket), -1, "shutdown of stopped server fails");
+}
+
+/* ========================================================================= */
+/* 主程序 */
+/* ========================================================================= */
+
+int main(void) {
+    UtilThread* thread;
+    ServerReply reply;
+    u8* expected;
+    u32 size;
+    int ready = 0;
+
+    printf("============================================\n");
+    printf("  ASSEMBLY SERVER UNIT TESTS\n");
+    printf("============================================\n");
+
+    snprintf(g_socket, sizeof(g_socket), "/tmp/subas_server_test.%d.sock", (int)getpid());
+    expected = assemble_locally(PROGRAM, &size);
+
+    thread = util_thread_create(server_thread, NULL_PTR);
+    for (u32 i = 0; i < 500 && !ready; i++) {
+        ready = (server_assemble(g_socket, SERVER_REQ_ASSEMBLE, "NOP\n", 4, 0, &reply) == 0);
+        server_reply_dispose(&reply);
+        if (!ready) usleep(10000);
+    }
+    ASSERT_EQ(ready, 1, "server started");
+
+    if (ready) {
+        test_assemble(expected, size);
+        test_errors();
+        test_path(expected, size);
+        test_concurrent(expected, size);
+        test_second_listener();
+        test_shutdown(thread);
+    }
+    util_free(expected);
+
+    printf("\n============================================\n");
+    printf("TEST RESULTS SUMMARY\n");
+    printf("============================================\n");
+    printf("Passed: %u\n", test_passed);
+    printf("Failed: %u\n", test_failed);
+    printf("Total:  %u\n", test_passed + test_failed);
+
+    if (test_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,350 @@
+﻿/*
+ * ============================================================================
+ * 文件名: test_subas_api.c
+ * 描述  : libsubas 公共接口单元测试
+ *
+ * 测试覆盖范围：
+ *  - 单个上下文汇编与结果复用
+ *  - 诊断按上下文隔离（不写入全局计数）
+ *  - 两个线程使用各自的上下文并发汇编
+ *  - 各阶段统计的计数与计时
+ *  - 流式输入：结果与整块输入一致，Token 缓冲区不随源文本增长
+ *
+ * 编译命令（在项目根目录）：
+ *   gcc -o tests/test_subas_api tests/test_subas_api.c src/subas.c \
+ *       src/lexer.c src/semantic.c src/codegen.c src/pipeline.c src/tables.c \
+ *       src/symtab.c src/utils/memory.c src/utils/string.c src/utils/hash.c \
+ *       src/utils/thread.c src/utils/queue.c src/utils/pool.c src/utils/clock.c \
+ *       src/cache.c src/depfile.c src/stats.c src/error.c \
+ *       -I. -Wall -Wextra -lpthread
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include "../include/subas.h"
+
+#define ASSERT_EQ(actual, expected, msg) \
+    do { \
+        if ((actual) != (expected)) { \
+            printf("  [FAIL] %s: expected %d, got %d\n", (msg), (int)(expected), (int)(actual)); \
+            test_failed++; \
+        } else { \
+            printf("  [PASS] %s\n", (msg)); \
+            test_passed++; \
+        } \
+    } while (0)
+
+#define ASSERT_PTR_NEQ(actual, expected, msg) \
+    do { \
+        if ((actual) == (expected)) { \
+            printf("  [FAIL] %s: pointer should not be NULL\n", (msg)); \
+            test_failed++; \
+        } else { \
+            printf("  [PASS] %s\n", (msg)); \
+            test_passed++; \
+        } \
+    } while (0)
+
+static u32 test_passed = 0;
+static u32 test_failed = 0;
+
+#define CONCURRENT_ROUNDS   200
+#define STREAM_LINES        3000
+
+static const char* GOOD_SOURCE =
+    "start: MOV AX, 1\n"
+    "       ADD AX, BX\n"
+    "       JMP start\n"
+    "       NOP\n";
+
+static const char* BAD_SOURCE =
+    "       MOV AX, 1\n"
+    "       JMP nowhere\n";
+
+/* ========================================================================= */
+/* 测试辅助 */
+/* ========================================================================= */
+
+/*
+ * 并发线程的工作描述
+ */
+typedef struct {
+    const char* source;         /* 要汇编的源文本 */
+    u32 expected_size;          /* 期望的机器码字节数 */
+    u32 expected_errors;        /* 期望每轮的错误数 */
+    u32 mismatches;             /* 结果不符合期望的轮数 */
+} Worker;
+
+static void worker_main(void* arg) {
+    Worker* worker = (Worker*)arg;
+    AsmContext* ctx = subas_context_create(NULL_PTR);
+    u32 len = util_strlen(worker->source);
+
+    if (ctx == NULL_PTR) {
+        worker->mismatches = CONCURRENT_ROUNDS;
+        return;
+    }
+
+    for (u32 round = 0; round < CONCURRENT_ROUNDS; round++) {
+        AsmOutput output;
+        int rc = subas_assemble(ctx, worker->source, len, &output);
+
+        if (subas_get_error_count(ctx) != worker->expected_errors) {
+            worker->mismatches++;
+        } else if (rc == 0 && output.size != worker->expected_size) {
+            worker->mismatches++;
+        }
+    }
+
+    subas_context_destroy(ctx);
+}
+
+/* ========================================================================= */
+/* 测试用例 */
+/* ========================================================================= */
+
+static void test_assemble_and_reuse(void) {
+    printf("\n=== libsubas: Assemble And Reuse Context ===\n");
+
+    AsmContext* ctx = subas_context_create(NULL_PTR);
+    ASSERT_PTR_NEQ(ctx, NULL_PTR, "context created");
+    if (ctx == NULL_PTR) {
+        return;
+    }
+
+    AsmOutput first;
+    AsmOutput second;
+    u32 first_size;
+    int rc = subas_assemble(ctx, GOOD_SOURCE, util_strlen(GOOD_SOURCE), &first);
+    ASSERT_EQ(rc, 0, "first assembly succeeded");
+    ASSERT_EQ(subas_get_error_count(ctx), 0, "no errors");
+    first_size = first.size;
+    ASSERT_EQ(first_size > 0, 1, "code generated");
+
+    rc = subas_assemble(ctx, GOOD_SOURCE, util_strlen(GOOD_SOURCE), &second);
+    ASSERT_EQ(rc, 0, "second assembly on same context succeeded");
+    ASSERT_EQ(second.size, first_size, "same code size on reuse");
+
+    subas_context_destroy(ctx);
+}
+
+static void test_diagnostics_isolated(void) {
+    printf("\n=== libsubas: Diagnostics Isolated Per Context ===\n");
+
+    AsmContext* bad = subas_context_create(NULL_PTR);
+    AsmContext* good = subas_context_create(NULL_PTR);
+    AsmOutput output;
+    u32 count = 0;
+    const ErrorRecord* records;
+
+    error_init();
+    subas_assemble(bad, BAD_SOURCE, util_strlen(BAD_SOURCE), &output);
+    ASSERT_EQ(subas_get_error_count(bad), 1, "bad context reports one error");
+    records = subas_get_diagnostics(bad, &count);
+    ASSERT_EQ(count, 1, "bad context records one diagnostic");
+    if (count > 0) {
+        ASSERT_EQ(records[0].code, ERR_PARSE_UNDEFINED_LBL, "diagnostic is undefined label");
+    }
+    ASSERT_EQ(error_get_count(), 0, "global error count untouched");
+
+    subas_assemble(good, GOOD_SOURCE, util_strlen(GOOD_SOURCE), &output);
+    ASSERT_EQ(subas_get_error_count(good), 0, "good context has no errors");
+    subas_get_diagnostics(good, &count);
+    ASSERT_EQ(count, 0, "good context records nothing");
+
+    /* 同一上下文重新汇编时清空旧诊断 */
+    subas_assemble(bad, GOOD_SOURCE, util_strlen(GOOD_SOURCE), &output);
+    ASSERT_EQ(subas_get_error_count(bad), 0, "diagnostics reset on reuse");
+
+    subas_context_destroy(bad);
+    subas_context_destroy(good);
+}
+
+static void test_concurrent_contexts(void) {
+    printf("\n=== libsubas: Concurrent Contexts ===\n");
+
+    /* 先在主线程取得期望结果 */
+    AsmContext* ctx = subas_context_create(NULL_PTR);
+    AsmOutput output;
+    subas_assemble(ctx, GOOD_SOURCE, util_strlen(GOOD_SOURCE), &output);
+    Worker good = { GOOD_SOURCE, output.size, 0, 0 };
+    Worker bad = { BAD_SOURCE, 0, 1, 0 };
+    subas_context_destroy(ctx);
+
+    UtilThread* a = util_thread_create(worker_main, &good);
+    UtilThread* b = util_thread_create(worker_main, &bad);
+    ASSERT_PTR_NEQ(a, NULL_PTR, "thread A started");
+    ASSERT_PTR_NEQ(b, NULL_PTR, "thread B started");
+    util_thread_join(a);
+    util_thread_join(b);
+
+    ASSERT_EQ(good.mismatches, 0, "good source stable under concurrency");
+    ASSERT_EQ(bad.mismatches, 0, "bad source errors stay in its own context");
+}
+
+/* 多处独立错误：一次汇编报告全部，且不产生连带错误 */
+static const char* MULTI_ERROR_SOURCE =
+    "start:  MOV AX, 1\n"
+    "        123 AX\n"
+    "broken: , BX\n"
+    "        JMP broken\n"
+    "        FOO AX\n"
+    "        JMP missing\n"
+    "        JMP missing\n"
+    "        NOP\n"
+    "        MOV @, 1\n";
+
+static void check_error_recovery(int pipeline) {
+    static const u32 expected_lines[] = { 9, 2, 3, 5, 6 };
+    static const ErrorCode expected_codes[] = {
+        ERR_LEX_INVALID_CHAR, ERR_PARSE_EXPECTED_OP, ERR_PARSE_EXPECTED_OP,
+        ERR_PARSE_UNK_MNEMONIC, ERR_PARSE_UNDEFINED_LBL
+    };
+    AsmOptions options;
+    AsmOutput output;
+    u32 count = 0;
+
+    subas_options_init(&options);
+    options.pipeline = pipeline;
+    AsmContext* ctx = subas_context_create(&options);
+    int rc = subas_assemble(ctx, MULTI_ERROR_SOURCE, util_strlen(MULTI_ERROR_SOURCE), &output);
+    const ErrorRecord* records = subas_get_diagnostics(ctx, &count);
+
+    ASSERT_EQ(rc, -1, "assembly fails");
+    ASSERT_EQ(output.size, 0, "no code returned");
+    ASSERT_EQ(count, 5, "every independent error reported once");
+    for (u32 i = 0; i < count && i < 5; i++) {
+        ASSERT_EQ(records[i].line, expected_lines[i], "error on expected line");
+        ASSERT_EQ(records[i].code, expected_codes[i], "error has expected code");
+    }
+
+    subas_context_destroy(ctx);
+}
+
+static void test_error_recovery(void) {
+    printf("\n=== libsubas: Error Recovery Across Passes ===\n");
+    check_error_recovery(0);
+
+    printf("  (pipeline mode)\n");
+    check_error_recovery(1);
+}
+
+/* 流式读取回调的输入：每次最多交出 chunk 字节 */
+typedef struct {
+    const char* text;
+    u32 len;
+    u32 pos;
+    u32 chunk;
+} StreamSource;
+
+static u32 read_chunk(void* user, char* dest, u32 capacity) {
+    StreamSource* src = (StreamSource*)user;
+    u32 n = src->len - src->pos;
+    if (n > src->chunk) n = src->chunk;
+    if (n > capacity) n = capacity;
+    for (u32 i = 0; i < n; i++) {
+        dest[i] = src->text[src->pos + i];
+    }
+    src->pos += n;
+    return n;
+}
+
+static void test_stream(void) {
+    printf("\n=== libsubas: Streaming Input ===\n");
+
+    static char text[STREAM_LINES * 16 + 32];
+    StreamSource src;
+    AsmOutput whole;
+    AsmOutput streamed;
+    u32 len = 0;
+
+    /* 远多于一批 Token 的源文本，末行引用首行的标签 */
+    util_strcpy(text, "start: NOP\n");
+    len = util_strlen(text);
+    for (u32 i = 1; i < STREAM_LINES; i++) {
+        util_strcpy(text + len, "       NOP\n");
+        len += util_strlen(text + len);
+    }
+    util_strcpy(text + len, "       JMP start\n");
+    len += util_strlen(text + len);
+
+    AsmContext* reference = subas_context_create(NULL_PTR);
+    AsmContext* ctx = subas_context_create(NULL_PTR);
+    ASSERT_EQ(subas_assemble(reference, text, len, &whole), 0, "whole source assembles");
+
+    src.text = text;
+    src.len = len;
+    src.pos = 0;
+    src.chunk = 100;
+    ASSERT_EQ(subas_assemble_stream(ctx, read_chunk, &src, &streamed), 0, "streamed source assembles");
+    int same = (streamed.size == whole.size);
+    for (u32 i = 0; same && i < whole.size; i++) {
+        same = (streamed.code[i] == whole.code[i]);
+    }
+    ASSERT_EQ(same, 1, "streamed code matches whole-buffer assembly");
+    ASSERT_EQ(subas_get_stats(ctx)->tokens, subas_get_stats(reference)->tokens, "every token counted");
+    ASSERT_EQ(subas_get_stats(ctx)->tokens > SUBAS_INITIAL_TOKENS, 1, "source exceeds the token buffer");
+    ASSERT_EQ(ctx->token_capacity, SUBAS_INITIAL_TOKENS, "token buffer did not grow");
+
+    subas_context_destroy(reference);
+    subas_context_destroy(ctx);
+}
+
+static void test_stats(void) {
+    printf("\n=== libsubas: Phase Statistics ===\n");
+
+    AsmContext* ctx = subas_context_create(NULL_PTR);
+    AsmOutput output;
+    AsmStats totals;
+
+    subas_assemble(ctx, GOOD_SOURCE, util_strlen(GOOD_SOURCE), &output);
+    const AsmStats* stats = subas_get_stats(ctx);
+
+    ASSERT_EQ(stats->tokens > 0, 1, "tokens counted");
+    ASSERT_EQ(stats->instructions, 4, "instructions counted");
+    ASSERT_EQ(stats->symbols, 1, "symbols counted");
+    ASSERT_EQ(stats->code_bytes, output.size, "code bytes counted");
+    ASSERT_EQ(stats->start_ns[STATS_PHASE_LEX] != 0, 1, "lex phase timed");
+    ASSERT_EQ(stats->start_ns[STATS_PHASE_PASS_ONE] != 0, 1, "pass one timed");
+    ASSERT_EQ(stats->start_ns[STATS_PHASE_PASS_TWO] != 0, 1, "pass two timed");
+    ASSERT_EQ(stats->start_ns[STATS_PHASE_READ], 0, "read not timed by library");
+
+    /* 汇总两次汇编：计数与耗时累加 */
+    stats_init(&totals);
+    stats_merge(&totals, stats);
+    stats_merge(&totals, stats);
+    ASSERT_EQ(totals.instructions, 8, "merge adds counts");
+    ASSERT_EQ(totals.elapsed_ns[STATS_PHASE_LEX] == 2 * stats->elapsed_ns[STATS_PHASE_LEX], 1,
+              "merge adds phase time");
+
+    subas_context_destroy(ctx);
+}
+
+int main(void) {
+    printf("============================================\n");
+    printf("  LIBSUBAS API TEST SUITE\n");
+    printf("============================================\n");
+
+    test_assemble_and_reuse();
+    test_diagnostics_isolated();
+    test_concurrent_contexts();
+    test_stats();
+    test_stream();
+    test_error_recovery();
+
+    printf("\n============================================\n");
+    printf("TEST RESULTS SUMMARY\n");
+    printf("============================================\n");
+    printf("Passed: %u\n", test_passed);
+    printf("Failed: %u\n", test_failed);
+    printf("Total:  %u\n", test_passed + test_failed);
+
+    if (test_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
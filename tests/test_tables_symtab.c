@@ -6,11 +6,13 @@
  * 测试覆盖范围：
  *  - Tables 模块：指令查找、伪指令识别、指令属性查询
  *  - Symtab 模块：符号插入、查找、地址更新、符号类型等
+ *  - Symtab 辅助索引：前缀/有序遍历、地址反查，与暴力结果随机比对
+ *  - 热路径计数器：以 COUNTERS=1 编译时校验查找与哈希表计数
  *
  * 编译命令示例（在项目根目录）：
  *   gcc -o tests/test_tables_symtab tests/test_tables_symtab.c \
  *       src/tables.c src/symtab.c src/utils/memory.c src/utils/string.c \
- *       src/utils/hash.c -I. -Wall -Wextra
+ *       src/utils/hash.c src/counters.c -I. -Wall -Wextra
  *
  * ============================================================================
  */
@@ -19,6 +21,7 @@
 #include "../include/tables.h"
 #include "../include/symtab.h"
 #include "../include/utils.h"
+#include "../include/counters.h"
 
 #define ASSERT_EQ(actual, expected, msg) \
     do { \
@@ -283,6 +286,27 @@ static void test_symtab_mark_defined(void) {
     symtab_destroy(symtab);
 }
 
+static void test_symtab_remove(void) {
+    printf("\n=== Symtab: Remove ===\n");
+
+    SymbolTable* symtab = symtab_create(16);
+
+    symtab_insert(symtab, "LABEL_A", SYM_LABEL, 0x100, 5);
+    symtab_insert(symtab, "LABEL_B", SYM_LABEL, 0x200, 6);
+
+    ASSERT_EQ(symtab_remove(symtab, "LABEL_A"), 0, "remove existing symbol");
+    ASSERT_EQ(symtab_get_symbol_count(symtab), 1, "symbol count after remove");
+    ASSERT_PTR_EQ(symtab_lookup(symtab, "LABEL_A"), NULL_PTR, "removed symbol not found");
+    ASSERT_PTR_NEQ(symtab_lookup(symtab, "LABEL_B"), NULL_PTR, "other symbol kept");
+    ASSERT_EQ(symtab_remove(symtab, "LABEL_A"), -1, "remove non-existent returns -1");
+
+    /* 删除后可重新定义 */
+    ASSERT_EQ(symtab_insert(symtab, "LABEL_A", SYM_LABEL, 0x300, 7), 0, "re-insert after remove");
+    ASSERT_EQ(symtab_lookup(symtab, "LABEL_A")->address, 0x300, "re-inserted address");
+
+    symtab_destroy(symtab);
+}
+
 static void test_symtab_lookup_not_found(void) {
     printf("\n=== Symtab: Lookup Non-existent ===\n");
 
@@ -325,6 +349,267 @@ static void test_symtab_assembly_scenario(void) {
     symtab_destroy(symtab);
 }
 
+/* 遍历回调：把访问到的名字依次拼接到缓冲区，以空格分隔 */
+typedef struct {
+    char text[512];
+    u32 length;
+    u32 stop_after;
+} NameCollector;
+
+static int collect_name(void* user, const SymbolInfo* info) {
+    NameCollector* c = (NameCollector*)user;
+    for (const char* p = info->name; *p != '\0' && c->length + 2 < sizeof(c->text); p++) {
+        c->text[c->length++] = *p;
+    }
+    c->text[c->length++] = ' ';
+    c->text[c->length] = '\0';
+    return (c->stop_after != 0 && --c->stop_after == 0);
+}
+
+static const char* collect_prefix(SymbolTable* symtab, const char* prefix, NameCollector* c, u32* visited) {
+    c->length = 0;
+    c->text[0] = '\0';
+    *visited = symtab_iterate_prefix(symtab, prefix, collect_name, c);
+    return c->text;
+}
+
+static void test_symtab_prefix_iteration(void) {
+    printf("\n=== Symtab: Prefix and Ordered Iteration ===\n");
+
+    SymbolTable* symtab = symtab_create(16);
+    NameCollector c;
+    u32 visited;
+
+    c.stop_after = 0;
+    symtab_insert(symtab, "LOOP_END", SYM_LABEL, 0x20, 3);
+    symtab_insert(symtab, "LOOP", SYM_LABEL, 0x10, 2);
+    symtab_insert(symtab, "MAIN", SYM_PROCEDURE, 0x00, 1);
+    symtab_insert(symtab, "LOOP_START", SYM_LABEL, 0x12, 4);
+    symtab_insert(symtab, "LO", SYM_LABEL, 0x30, 5);
+    symtab_insert(symtab, "buf", SYM_VARIABLE, 0x40, 6);
+
+    ASSERT_STR_EQ(collect_prefix(symtab, "", &c, &visited),
+                  "LO LOOP LOOP_END LOOP_START MAIN buf ", "empty prefix walks all names in order");
+    ASSERT_EQ(visited, 6, "six symbols visited");
+    ASSERT_STR_EQ(collect_prefix(symtab, "LOOP", &c, &visited),
+                  "LOOP LOOP_END LOOP_START ", "prefix equal to a name includes it");
+    ASSERT_STR_EQ(collect_prefix(symtab, "LOOP_S", &c, &visited),
+                  "LOOP_START ", "prefix ending inside an edge");
+    ASSERT_STR_EQ(collect_prefix(symtab, "L", &c, &visited),
+                  "LO LOOP LOOP_END LOOP_START ", "single-character prefix");
+    ASSERT_EQ(symtab_iterate_prefix(symtab, "LOOX", collect_name, &c), 0, "mismatch inside an edge");
+    ASSERT_EQ(symtab_iterate_prefix(symtab, "Z", collect_name, &c), 0, "missing first byte");
+    ASSERT_EQ(symtab_iterate_prefix(symtab, "loop", collect_name, &c), 0, "prefix match is case-sensitive");
+
+    c.stop_after = 2;
+    ASSERT_STR_EQ(collect_prefix(symtab, "", &c, &visited), "LO LOOP ", "visitor stops the walk");
+    ASSERT_EQ(visited, 2, "stopping visit is counted");
+    c.stop_after = 0;
+
+    /* 删除中间节点上的符号后，单子节点与其子节点合并 */
+    ASSERT_EQ(symtab_remove(symtab, "LOOP"), 0, "remove interior name");
+    ASSERT_STR_EQ(collect_prefix(symtab, "LOO", &c, &visited),
+                  "LOOP_END LOOP_START ", "siblings kept after interior removal");
+    ASSERT_EQ(symtab_remove(symtab, "LOOP_END"), 0, "remove leaf");
+    ASSERT_STR_EQ(collect_prefix(symtab, "LOOP_", &c, &visited),
+                  "LOOP_START ", "merged edge still matches");
+    ASSERT_EQ(symtab_insert(symtab, "LOOP", SYM_LABEL, 0x10, 7), 0, "re-insert splits merged edge");
+    ASSERT_STR_EQ(collect_prefix(symtab, "", &c, &visited),
+                  "LO LOOP LOOP_START MAIN buf ", "order after re-insert");
+
+    symtab_destroy(symtab);
+}
+
+static void test_symtab_address_lookup(void) {
+    printf("\n=== Symtab: Address-Ordered Lookup ===\n");
+
+    SymbolTable* symtab = symtab_create(16);
+    u32 count;
+
+    ASSERT_PTR_EQ(symtab_find_by_address(symtab, 0), NULL_PTR, "empty table has no nearest symbol");
+
+    symtab_insert(symtab, "DATA", SYM_VARIABLE, 0x100, 9);
+    symtab_insert(symtab, "START", SYM_LABEL, 0x10, 1);
+    symtab_insert(symtab, "MAIN", SYM_PROCEDURE, 0x10, 2);
+    symtab_insert(symtab, "NEXT", SYM_LABEL, 0x20, 3);
+
+    SymbolInfo* const* ordered = symtab_get_by_address(symtab, &count);
+    ASSERT_EQ(count, 4, "address index holds every symbol");
+    ASSERT_STR_EQ(ordered[0]->name, "START", "lowest address first");
+    ASSERT_STR_EQ(ordered[1]->name, "MAIN", "equal addresses keep insertion order");
+    ASSERT_STR_EQ(ordered[3]->name, "DATA", "highest address last");
+
+    ASSERT_PTR_EQ(symtab_find_by_address(symtab, 0x0F), NULL_PTR, "below every symbol");
+    ASSERT_STR_EQ(symtab_find_by_address(symtab, 0x10)->name, "START", "exact match returns first at address");
+    ASSERT_STR_EQ(symtab_find_by_address(symtab, 0x1F)->name, "START", "nearest symbol below");
+    ASSERT_STR_EQ(symtab_find_by_address(symtab, 0x20)->name, "NEXT", "exact match");
+    ASSERT_STR_EQ(symtab_find_by_address(symtab, 0xFFFF)->name, "DATA", "past the last symbol");
+
+    /* 更新地址后索引重新排序 */
+    symtab_update_address(symtab, "DATA", 0x18);
+    ASSERT_STR_EQ(symtab_find_by_address(symtab, 0x1F)->name, "DATA", "moved symbol found at new address");
+    ASSERT_STR_EQ(symtab_find_by_address(symtab, 0xFFFF)->name, "NEXT", "old position vacated");
+
+    symtab_remove(symtab, "START");
+    ASSERT_STR_EQ(symtab_find_by_address(symtab, 0x10)->name, "MAIN", "removed symbol leaves the index");
+    symtab_get_by_address(symtab, &count);
+    ASSERT_EQ(count, 3, "address index shrinks on remove");
+
+    symtab_destroy(symtab);
+}
+
+/* 随机插入/删除/改址，与暴力计算的字典序和地址反查结果比对 */
+#define RANDOM_NAMES 200
+
+static u32 random_state = 12345;
+
+static u32 next_random(void) {
+    random_state = random_state * 1103515245u + 12345u;
+    return (random_state >> 16) & 0x7FFF;
+}
+
+typedef struct {
+    SymbolTable* symtab;
+    const char* expected[RANDOM_NAMES];
+    u32 expected_count;
+    u32 position;
+    int mismatch;
+} OrderCheck;
+
+static int check_order(void* user, const SymbolInfo* info) {
+    OrderCheck* check = (OrderCheck*)user;
+    if (check->position >= check->expected_count ||
+        util_strcmp(check->expected[check->position], info->name) != 0) {
+        check->mismatch = 1;
+    }
+    check->position++;
+    return 0;
+}
+
+static void test_symtab_index_random(void) {
+    printf("\n=== Symtab: Randomized Index Consistency ===\n");
+
+    static const char alphabet[] = "AB_.";
+    char names[RANDOM_NAMES][8];
+    int present[RANDOM_NAMES];
+    u32 address[RANDOM_NAMES];
+    SymbolTable* symtab = symtab_create(64);
+    OrderCheck check;
+    int order_ok = 1;
+    int nearest_ok = 1;
+    int sorted_ok = 1;
+
+    /* 小字母表的短名字：共享前缀多，频繁触发拆分与合并 */
+    for (u32 i = 0; i < RANDOM_NAMES; i++) {
+        u32 len = 1 + next_random() % 6;
+        for (u32 k = 0; k < len; k++) {
+            names[i][k] = alphabet[next_random() % 4];
+        }
+        names[i][len] = '\0';
+        present[i] = 0;
+    }
+
+    for (u32 round = 0; round < 2000; round++) {
+        u32 i = next_random() % RANDOM_NAMES;
+        u32 op = next_random() % 3;
+
+        if (op == 0 && !present[i] && symtab_lookup(symtab, names[i]) == NULL_PTR) {
+            address[i] = next_random() % 64;
+            present[i] = (symtab_insert(symtab, names[i], SYM_LABEL, address[i], round) == 0);
+        } else if (op == 1 && present[i]) {
+            symtab_remove(symtab, names[i]);
+            present[i] = 0;
+        } else if (op == 2 && present[i]) {
+            address[i] = next_random() % 64;
+            symtab_update_address(symtab, names[i], address[i]);
+        }
+
+        if (round % 50 != 0) continue;
+
+        /* 暴力字典序：选择排序已登记的名字（按无符号字节比较） */
+        check.expected_count = 0;
+        for (u32 n = 0; n < RANDOM_NAMES; n++) {
+            if (present[n]) check.expected[check.expected_count++] = names[n];
+        }
+        for (u32 a = 0; a < check.expected_count; a++) {
+            for (u32 b = a + 1; b < check.expected_count; b++) {
+                if (util_strcmp(check.expected[b], check.expected[a]) < 0) {
+                    const char* t = check.expected[a];
+                    check.expected[a] = check.expected[b];
+                    check.expected[b] = t;
+                }
+            }
+        }
+        check.position = 0;
+        check.mismatch = 0;
+        u32 visited = symtab_iterate_prefix(symtab, "", check_order, &check);
+        if (check.mismatch || visited != check.expected_count) order_ok = 0;
+
+        /* 暴力地址反查：最大的不超过目标的地址 */
+        for (u32 target = 0; target < 66; target++) {
+            int best = -1;
+            for (u32 n = 0; n < RANDOM_NAMES; n++) {
+                if (present[n] && address[n] <= target && (best < 0 || address[n] > address[best])) {
+                    best = (int)n;
+                }
+            }
+            SymbolInfo* found = symtab_find_by_address(symtab, target);
+            if (best < 0 ? (found != NULL_PTR)
+                         : (found == NULL_PTR || found->address != address[best])) {
+                nearest_ok = 0;
+            }
+        }
+
+        u32 count;
+        SymbolInfo* const* ordered = symtab_get_by_address(symtab, &count);
+        if (count != symtab_get_symbol_count(symtab)) sorted_ok = 0;
+        for (u32 k = 1; k < count; k++) {
+            if (ordered[k - 1]->address > ordered[k]->address) sorted_ok = 0;
+        }
+    }
+
+    ASSERT_EQ(order_ok, 1, "name order matches sorted brute force");
+    ASSERT_EQ(nearest_ok, 1, "nearest-address lookup matches brute force");
+    ASSERT_EQ(sorted_ok, 1, "address array stays sorted and complete");
+
+    symtab_destroy(symtab);
+}
+
+static void test_hot_path_counters(void) {
+    printf("\n=== Counters: Lookup and Hash Table Instrumentation ===\n");
+
+    if (!COUNTERS_ENABLED) {
+        printf("  [SKIP] built without SUBAS_COUNTERS\n");
+        return;
+    }
+
+    counters_reset();
+    (void)tables_lookup_instruction(tables_get_instruction_by_index(2)->mnemonic);
+    ASSERT_EQ(counters_get(COUNTER_INSN_LOOKUPS), 1, "one instruction lookup counted");
+    ASSERT_EQ(counters_get(COUNTER_INSN_COMPARES), 3, "third entry takes three compares");
+    (void)tables_lookup_instruction("NOSUCH");
+    ASSERT_EQ(counters_get(COUNTER_INSN_MISSES), 1, "miss counted");
+    ASSERT_EQ(counters_get(COUNTER_INSN_COMPARES), 3 + tables_get_instruction_count(),
+              "miss compares against every entry");
+
+    /* 单桶哈希表：每次插入都追加到同一条链 */
+    UtilHashTable* table = util_ht_create(1);
+    util_ht_insert(table, "A", NULL_PTR);
+    util_ht_insert(table, "B", NULL_PTR);
+    util_ht_insert(table, "C", NULL_PTR);
+    ASSERT_EQ(counters_get(COUNTER_HT_INSERTS), 3, "three inserts counted");
+    ASSERT_EQ(counters_get(COUNTER_HT_INSERT_PROBES), 0 + 1 + 2, "insert probes walk the chain");
+    ASSERT_EQ(counters_get(COUNTER_HT_MAX_CHAIN), 3, "max chain length");
+    ASSERT_EQ(counters_get(COUNTER_HT_MAX_LOAD), 3000, "load factor x1000");
+
+    (void)util_ht_lookup(table, "A");       /* 头插法：A 位于链尾 */
+    (void)util_ht_lookup(table, "Z");
+    ASSERT_EQ(counters_get(COUNTER_HT_LOOKUPS), 2, "two lookups counted");
+    ASSERT_EQ(counters_get(COUNTER_HT_LOOKUP_PROBES), 6, "lookup probes");
+    ASSERT_EQ(counters_get(COUNTER_HT_LOOKUP_MISSES), 1, "lookup miss counted");
+    util_ht_destroy(table);
+}
+
 /* =========================================================================
  * 主测试入口
  * ========================================================================= */
@@ -350,8 +635,13 @@ int main(void) {
     test_symtab_multiple_symbols();
     test_symtab_update_address();
     test_symtab_mark_defined();
+    test_symtab_remove();
     test_symtab_lookup_not_found();
     test_symtab_assembly_scenario();
+    test_symtab_prefix_iteration();
+    test_symtab_address_lookup();
+    test_symtab_index_random();
+    test_hot_path_counters();
 
     printf("\n========================================\n");
     printf("TEST RESULTS SUMMARY\n");
@@ -4,14 +4,17 @@
  * 描述  : Utils 和 Error 模块单元测试驱动程序
  *
  * 测试覆盖范围：
- *  - Error 模块：错误初始化、错误报告、错误计数、错误检测
- *  - Utils 内存管理：malloc/free 基本操作
+ *  - Error 模块：错误初始化、错误报告、错误计数、错误检测、去重与上限、缓存输出
+ *  - Utils 内存管理：malloc/free 基本操作、分配记账（存活字节、峰值、标签、直方图）
  *  - Utils 字符串处理：strlen、strcpy、strcmp、strdup
  *  - Utils 哈希表：创建、插入、查找、销毁
+ *  - Utils SHA-256：标准测试向量、分段输入与整体输入一致
+ *  - Utils 并行循环：工作窃取调度下每个下标恰好执行一次
  *
  * 编译命令示例（在项目根目录）：
  *   gcc -o tests/test_utils_error tests/test_utils_error.c \
- *       src/error.c src/utils/memory.c src/utils/string.c src/utils/hash.c -I. -Wall -Wextra
+ *       src/error.c src/utils/memory.c src/utils/string.c src/utils/hash.c \
+ *       src/utils/thread.c src/utils/pool.c -I. -Wall -Wextra -lpthread
  *
  * ============================================================================
  */
@@ -119,6 +122,78 @@ static void test_error_types(void) {
     ASSERT_EQ(error_get_count(), 1, "system error count");
 }
 
+static void test_error_capture(void) {
+    printf("\n=== Error Module: Capture and Replay ===\n");
+    ErrorBuffer buffer;
+    char detail[8];
+
+    error_init();
+    error_buffer_init(&buffer);
+
+    util_strcpy(detail, "TMP");
+    error_capture_begin(&buffer);
+    error_report(3, ERR_PARSE_UNK_MNEMONIC, detail);
+    error_report(4, ERR_PARSE_DUP_LABEL, NULL_PTR);
+    error_capture_end();
+    util_strcpy(detail, "XXX");
+
+    ASSERT_EQ(error_get_count(), 0, "captured errors are not counted");
+    ASSERT_EQ(buffer.count, 2, "two records captured");
+    ASSERT_EQ(buffer.records[0].line, 3, "first record line");
+    ASSERT_STR_EQ(buffer.records[0].detail, "TMP", "detail copied at capture time");
+
+    error_buffer_replay(&buffer);
+    ASSERT_EQ(error_get_count(), 2, "replayed errors are counted");
+
+    error_buffer_dispose(&buffer);
+    ASSERT_EQ(buffer.count, 0, "buffer empty after dispose");
+    error_init();
+}
+
+static void test_error_dedupe_limit(void) {
+    printf("\n=== Error Module: Dedupe, Limit and Flush ===\n");
+    ErrorContext ctx;
+    ErrorContext* previous;
+    const char* source = "MOV AX, 1\nFOO BX\nBAR\n";
+    const u32 line_starts[] = { 0, 10, 17 };
+
+    error_context_init(&ctx, 1, 1);
+    ctx.limit = 3;
+    previous = error_bind(&ctx);
+
+    error_report(2, ERR_PARSE_UNK_MNEMONIC, "FOO");
+    error_report(2, ERR_PARSE_UNK_MNEMONIC, "FOO");
+    error_report(2, ERR_PARSE_UNK_MNEMONIC, NULL_PTR);
+    error_report(3, ERR_PARSE_UNK_MNEMONIC, "BAR");
+    ASSERT_EQ(ctx.kept, 3, "distinct errors kept");
+    ASSERT_EQ(ctx.duplicates, 1, "identical error deduplicated");
+    ASSERT_EQ(ctx.log.count, 3, "log holds distinct errors only");
+    ASSERT_EQ(ctx.pending.count, 3, "echoed errors buffered until flush");
+
+    error_report(3, ERR_PARSE_UNDEFINED_LBL, "X");
+    error_report(3, ERR_PARSE_UNDEFINED_LBL, "Y");
+    ASSERT_EQ(ctx.suppressed, 2, "errors beyond limit suppressed");
+    ASSERT_EQ(ctx.log.count, 3, "log capped at limit");
+    ASSERT_EQ(error_get_count(), 6, "every report counted");
+
+    printf("  Flushing (expect 3 errors with snippets and a summary):\n");
+    fflush(stdout);
+    error_set_source(source, util_strlen(source), line_starts, 3);
+    error_flush();
+    ASSERT_EQ(ctx.pending.count, 0, "pending empty after flush");
+    ASSERT_EQ(ctx.suppressed, 0, "suppressed reset after flush");
+    ASSERT_PTR_EQ(ctx.source, NULL_PTR, "source released after flush");
+    ASSERT_EQ(error_has_failed(), TRUE, "count survives flush");
+
+    error_init();
+    error_report(2, ERR_PARSE_UNK_MNEMONIC, "FOO");
+    ASSERT_EQ(ctx.duplicates, 0, "dedupe set cleared by error_init");
+    ASSERT_EQ(ctx.log.count, 1, "log restarted by error_init");
+
+    error_bind(previous);
+    error_context_dispose(&ctx);
+}
+
 /* =========================================================================
  * UTILS 字符串处理测试
  * ========================================================================= */
@@ -205,6 +280,55 @@ static void test_malloc_free(void) {
     test_passed++;
 }
 
+static void test_mem_accounting(void) {
+    printf("\n=== Utils: Allocation Accounting ===\n");
+
+    /* MEMSTATS=0 构建：没有头部，开启记账也不计数 */
+    if (!UTIL_MEM_ACCOUNTING) {
+        UtilMemStats none;
+        util_mem_accounting(1);
+        util_free(util_malloc(100));
+        util_mem_get_stats(&none);
+        util_mem_accounting(0);
+        ASSERT_EQ(none.allocs, 0, "accounting compiled out");
+        return;
+    }
+
+    /* 记账开启前的分配在释放时不参与统计 */
+    u8* early = (u8*)util_malloc(64);
+    UtilMemStats before;
+    util_mem_accounting(1);
+    util_mem_get_stats(&before);
+
+    UtilMemTag previous = util_mem_set_tag(UTIL_MEM_SYMTAB);
+    ASSERT_EQ(previous, UTIL_MEM_GENERAL, "default tag is general");
+    u8* a = (u8*)util_malloc(100);
+    u8* b = (u8*)util_malloc(4000);
+    util_mem_set_tag(previous);
+
+    UtilMemStats mid;
+    util_mem_get_stats(&mid);
+    ASSERT_EQ(mid.allocs - before.allocs, 2, "two allocations counted");
+    ASSERT_EQ(mid.live_bytes - before.live_bytes, 4100, "live bytes include both blocks");
+    ASSERT_EQ(mid.tag_live[UTIL_MEM_SYMTAB] - before.tag_live[UTIL_MEM_SYMTAB], 4100,
+              "bytes charged to symtab tag");
+    ASSERT_EQ(mid.histogram[6] - before.histogram[6], 1, "100 bytes in [64,128) bucket");
+    ASSERT_EQ(mid.histogram[11] - before.histogram[11], 1, "4000 bytes in [2048,4096) bucket");
+    ASSERT_EQ(mid.peak_bytes >= mid.live_bytes, 1, "peak >= live");
+
+    util_free(b);
+    util_free(a);
+    util_free(early);
+
+    UtilMemStats after;
+    util_mem_get_stats(&after);
+    ASSERT_EQ(after.live_bytes, before.live_bytes, "live bytes return to baseline");
+    ASSERT_EQ(after.frees - before.frees, 2, "only counted blocks are freed from stats");
+    ASSERT_EQ(after.peak_bytes, mid.peak_bytes, "peak survives frees");
+    ASSERT_STR_EQ(util_mem_tag_name(UTIL_MEM_CODEGEN), "codegen", "tag name");
+    util_mem_accounting(0);
+}
+
 /* =========================================================================
  * UTILS 哈希表测试
  * ========================================================================= */
@@ -326,6 +450,86 @@ static void test_hashtable_masm_instructions(void) {
     util_ht_destroy(instr_table);
 }
 
+/* =========================================================================
+ * Utils SHA-256 测试
+ * ========================================================================= */
+
+/* 计算 text 的摘要并与十六进制期望值比较 */
+static int sha256_matches(const char* text, u32 piece, const char* expected) {
+    static const char hex[] = "0123456789abcdef";
+    UtilSha256 sha;
+    u8 digest[UTIL_SHA256_SIZE];
+    char actual[UTIL_SHA256_SIZE * 2 + 1];
+    u32 size = util_strlen(text);
+    u32 done = 0;
+
+    util_sha256_init(&sha);
+    while (done < size) {
+        u32 n = (size - done < piece) ? size - done : piece;
+        util_sha256_update(&sha, text + done, n);
+        done += n;
+    }
+    util_sha256_final(&sha, digest);
+
+    for (u32 i = 0; i < UTIL_SHA256_SIZE; i++) {
+        actual[i * 2] = hex[digest[i] >> 4];
+        actual[i * 2 + 1] = hex[digest[i] & 0x0F];
+    }
+    actual[UTIL_SHA256_SIZE * 2] = '\0';
+    return util_strcmp(actual, expected) == 0;
+}
+
+static void test_sha256(void) {
+    printf("\n=== Utils: SHA-256 ===\n");
+
+    const char* two_blocks = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+
+    ASSERT_EQ(sha256_matches("", 1,
+              "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"), 1, "empty input");
+    ASSERT_EQ(sha256_matches("abc", 3,
+              "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"), 1, "\"abc\"");
+    ASSERT_EQ(sha256_matches(two_blocks, 56,
+              "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"), 1, "padding spills into second block");
+    ASSERT_EQ(sha256_matches(two_blocks, 5,
+              "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"), 1, "piecewise update matches");
+}
+
+/* =========================================================================
+ * Utils 并行循环测试
+ * ========================================================================= */
+
+#define PARALLEL_TASKS 10000
+
+static u8 g_task_hits[PARALLEL_TASKS];
+
+static void count_task(void* arg, u32 worker, u32 index) {
+    (void)arg;
+    (void)worker;
+    g_task_hits[index]++;
+}
+
+static void test_parallel_for(void) {
+    printf("\n=== Utils: Work-Stealing Parallel For ===\n");
+
+    u32 workers[] = { 1, 4, 0 };
+    for (u32 w = 0; w < 3; w++) {
+        u32 wrong = 0;
+        for (u32 i = 0; i < PARALLEL_TASKS; i++) {
+            g_task_hits[i] = 0;
+        }
+        util_parallel_for(PARALLEL_TASKS, workers[w], count_task, NULL_PTR);
+        for (u32 i = 0; i < PARALLEL_TASKS; i++) {
+            if (g_task_hits[i] != 1) wrong++;
+        }
+        ASSERT_EQ(wrong, 0, "every index runs exactly once");
+    }
+
+    /* 空循环不调用任务函数 */
+    g_task_hits[0] = 0;
+    util_parallel_for(0, 4, count_task, NULL_PTR);
+    ASSERT_EQ(g_task_hits[0], 0, "empty range runs nothing");
+}
+
 /* =========================================================================
  * 主测试入口
  * ========================================================================= */
@@ -339,6 +543,8 @@ int main(void) {
     test_error_init();
     test_error_report();
     test_error_types();
+    test_error_capture();
+    test_error_dedupe_limit();
 
     /* Utils 字符串测试 */
     test_strlen();
@@ -355,6 +561,11 @@ int main(void) {
     test_hashtable_update();
     test_hashtable_collision();
     test_hashtable_masm_instructions();
+    test_sha256();
+
+    /* Utils 并行循环测试 */
+    test_parallel_for();
+    test_mem_accounting();
 
     printf("\n========================================\n");
     printf("TEST RESULTS SUMMARY\n");
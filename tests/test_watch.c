@@ -0,0 +1,155 @@
+﻿/*
+ * ============================================================================
+ * 文件名: test_watch.c
+ * 描述  : 文件监视 (WatchSet) 模块单元测试
+ *
+ * 测试覆盖范围：
+ *  - 原地改写与"写临时文件再 rename"两种保存方式都能被发现
+ *  - 同一目录中未登记的文件不会结束等待；无事件时按时返回 0
+ *  - 同一次保存产生的多个事件合并为一个
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "../include/watch.h"
+
+#define ASSERT_EQ(actual, expected, msg) \
+    do { \
+        if ((actual) != (expected)) { \
+            printf("  [FAIL] %s: expected %d, got %d\n", (msg), (int)(expected), (int)(actual)); \
+            test_failed++; \
+        } else { \
+            printf("  [PASS] %s\n", (msg)); \
+            test_passed++; \
+        } \
+    } while (0)
+
+static u32 test_passed = 0;
+static u32 test_failed = 0;
+
+static char g_dir[64];
+
+/* ========================================================================= */
+/* 辅助函数 */
+/* ========================================================================= */
+
+/*
+ * 把 text 写到 g_dir 下的 name（覆盖）
+ */
+static void write_text(const char* name, const char* text) {
+    char path[128];
+    FILE* fp;
+
+    snprintf(path, sizeof(path), "%s/%s", g_dir, name);
+    fp = fopen(path, "w");
+    if (fp != NULL_PTR) {
+        fputs(text, fp);
+        fclose(fp);
+    }
+}
+
+/*
+ * 写临时文件后 rename 为 name（编辑器常用的保存方式）
+ */
+static void replace_text(const char* name, const char* text) {
+    char from[128];
+    char to[128];
+
+    write_text("save.tmp", text);
+    snprintf(from, sizeof(from), "%s/save.tmp", g_dir);
+    snprintf(to, sizeof(to), "%s/%s", g_dir, name);
+    rename(from, to);
+}
+
+static void remove_file(const char* name) {
+    char path[128];
+    snprintf(path, sizeof(path), "%s/%s", g_dir, name);
+    unlink(path);
+}
+
+/* ========================================================================= */
+/* 测试用例 */
+/* ========================================================================= */
+
+static void test_watch_changes(void) {
+    printf("\n=== Watch: File Changes ===\n");
+
+    char path[128];
+    u32 changed[4];
+    WatchSet* set = watch_create();
+    ASSERT_EQ(set != NULL_PTR, 1, "watch set created");
+    if (set == NULL_PTR) return;
+
+    write_text("a.asm", "MOV AX, 1\n");
+    write_text("b.asm", "MOV AX, 2\n");
+    snprintf(path, sizeof(path), "%s/a.asm", g_dir);
+    ASSERT_EQ(watch_add(set, path), 0, "first file registered");
+    snprintf(path, sizeof(path), "%s/b.asm", g_dir);
+    ASSERT_EQ(watch_add(set, path), 1, "second file in same directory registered");
+
+    ASSERT_EQ(watch_wait(set, 50, changed, 4), 0, "no change times out");
+
+    /* 原地改写 */
+    write_text("a.asm", "MOV AX, 3\n");
+    ASSERT_EQ(watch_wait(set, 1000, changed, 4), 1, "in-place write detected");
+    ASSERT_EQ(changed[0], 0, "changed file reported");
+
+    /* 写临时文件再 rename：临时文件本身不计入 */
+    replace_text("b.asm", "MOV AX, 4\n");
+    ASSERT_EQ(watch_wait(set, 1000, changed, 4), 1, "rename-over detected");
+    ASSERT_EQ(changed[0], 1, "replaced file reported");
+
+    /* 同一目录中未登记的文件 */
+    write_text("other.txt", "x\n");
+    ASSERT_EQ(watch_wait(set, 50, changed, 4), 0, "unrelated file ignored");
+
+    /* 多次写入合并，两个文件一并返回 */
+    write_text("b.asm", "MOV AX, 5\n");
+    write_text("a.asm", "MOV AX, 6\n");
+    write_text("a.asm", "MOV AX, 7\n");
+    ASSERT_EQ(watch_wait(set, 1000, changed, 4), 2, "events coalesced per file");
+    ASSERT_EQ(changed[0] == 0 && changed[1] == 1, 1, "changed files in registration order");
+
+    watch_destroy(set);
+}
+
+/* ========================================================================= */
+/* 主函数 */
+/* ========================================================================= */
+
+int main(void) {
+    printf("============================================\n");
+    printf("  WATCH MODULE UNIT TESTS\n");
+    printf("============================================\n");
+
+    snprintf(g_dir, sizeof(g_dir), "/tmp/subas_watch_test.XXXXXX");
+    if (mkdtemp(g_dir) == NULL_PTR) {
+        printf("Cannot create temporary directory\n");
+        return 1;
+    }
+
+    test_watch_changes();
+
+    remove_file("a.asm");
+    remove_file("b.asm");
+    remove_file("other.txt");
+    rmdir(g_dir);
+
+    printf("\n============================================\n");
+    printf("TEST RESULTS SUMMARY\n");
+    printf("============================================\n");
+    printf("Passed: %u\n", test_passed);
+    printf("Failed: %u\n", test_failed);
+    printf("Total:  %u\n", test_passed + test_failed);
+
+    if (test_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}